@@ -0,0 +1,71 @@
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <benchmark/benchmark.h>
+
+#include "utils/probabilities/process_counts.hpp"
+
+namespace {
+
+// Counts of the given number of distinct outcomes, of n_bits bits each
+std::map<std::string, int> random_counts(const int n_bits, const std::size_t n_outcomes)
+{
+    std::mt19937_64 rng(11);
+    std::map<std::string, int> counts;
+    while (counts.size() < n_outcomes) {
+        const std::uint64_t outcome = rng() & ((std::uint64_t{1} << n_bits) - 1);
+        std::string bitstring(n_bits, '0');
+        for (int bit = 0; bit < n_bits; bit++)
+            bitstring[n_bits - 1 - bit] = (outcome >> bit) & 1 ? '1' : '0';
+        counts[bitstring] += 1 + rng() % 100;
+    }
+    return counts;
+}
+
+void BM_marginalize_counts_by_regions(benchmark::State& state)
+{
+    const int n_bits = state.range(0);
+    const auto counts = random_counts(n_bits, std::min<std::size_t>(state.range(1), std::size_t{1} << n_bits));
+    const std::vector<int> region_sizes = {n_bits / 2, n_bits - n_bits / 2};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(marginalizeCountsByRegions(counts, region_sizes));
+    state.SetItemsProcessed(state.iterations() * counts.size());
+}
+BENCHMARK(BM_marginalize_counts_by_regions)->Args({10, 1 << 10})->Args({20, 1 << 14})->Args({40, 1 << 14});
+
+void BM_counts_to_probs(benchmark::State& state)
+{
+    const int n_bits = state.range(0);
+    const auto counts = random_counts(n_bits, std::min<std::size_t>(state.range(1), std::size_t{1} << n_bits));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(countsToProbs(counts));
+    state.SetItemsProcessed(state.iterations() * counts.size());
+}
+BENCHMARK(BM_counts_to_probs)->Args({10, 1 << 10})->Args({20, 1 << 14});
+
+void BM_counts_to_probs_per_qubit(benchmark::State& state)
+{
+    const int n_bits = state.range(0);
+    const auto counts = random_counts(n_bits, std::min<std::size_t>(state.range(1), std::size_t{1} << n_bits));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(countsToProbs(counts, true));
+    state.SetItemsProcessed(state.iterations() * counts.size());
+}
+BENCHMARK(BM_counts_to_probs_per_qubit)->Args({10, 1 << 10})->Args({20, 1 << 14});
+
+void BM_recombine_probs_partial(benchmark::State& state)
+{
+    const int n_qubits = state.range(0);
+    std::vector<double> probs(std::size_t{1} << n_qubits, 1.0 / (std::size_t{1} << n_qubits));
+    std::vector<int> partial;
+    for (int qubit = 0; qubit < n_qubits; qubit += 2)
+        partial.push_back(qubit);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(recombineProbs(probs, false, &partial, n_qubits));
+    state.SetItemsProcessed(state.iterations() * probs.size());
+}
+BENCHMARK(BM_recombine_probs_partial)->DenseRange(12, 24, 6);
+
+} // End of anonymous namespace
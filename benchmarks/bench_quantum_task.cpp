@@ -0,0 +1,72 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <benchmark/benchmark.h>
+
+#include "quantum_task.hpp"
+#include "utils/helpers/qasm2_to_json.hpp"
+#include "utils/helpers/json_to_qasm2.hpp"
+#include "circuits.hpp"
+
+using namespace cunqa;
+
+namespace {
+
+constexpr int N_QUBITS = 16;
+
+// Layers enough for about the given number of instructions on N_QUBITS qubits
+std::vector<JSON> instructions_of_size(const int n_instructions)
+{
+    return bench::random_layers_instructions(N_QUBITS, std::max(1, n_instructions / (2 * N_QUBITS + N_QUBITS / 2)));
+}
+
+void BM_update_circuit(benchmark::State& state)
+{
+    auto instructions = instructions_of_size(state.range(0));
+    const std::string message = bench::quantum_task(instructions, N_QUBITS, 1024);
+    QuantumTask quantum_task;
+    for (auto _ : state) {
+        quantum_task.update_circuit(message);
+        benchmark::DoNotOptimize(quantum_task.circuit.data());
+    }
+    state.SetItemsProcessed(state.iterations() * instructions.size());
+    state.SetBytesProcessed(state.iterations() * message.size());
+}
+BENCHMARK(BM_update_circuit)->RangeMultiplier(10)->Range(10, 10000);
+
+// Parameter updates of the circuit already loaded, the path of variational loops
+void BM_update_params(benchmark::State& state)
+{
+    QuantumTask quantum_task(bench::quantum_task(instructions_of_size(state.range(0)), N_QUBITS, 1024));
+    const std::size_t n_params = quantum_task.params().size();
+    std::vector<double> params(n_params, 0.1);
+    const std::string message = JSON({{"params", params}, {"shots", 1024}}).dump();
+    for (auto _ : state) {
+        quantum_task.update_circuit(message);
+        benchmark::DoNotOptimize(quantum_task.circuit.data());
+    }
+    state.SetItemsProcessed(state.iterations() * n_params);
+}
+BENCHMARK(BM_update_params)->RangeMultiplier(10)->Range(10, 10000);
+
+void BM_json_to_qasm2(benchmark::State& state)
+{
+    const JSON instructions = instructions_of_size(state.range(0));
+    const JSON config = {{"num_qubits", N_QUBITS}, {"num_clbits", N_QUBITS}};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(json_to_qasm2(instructions, config));
+    state.SetItemsProcessed(state.iterations() * instructions.size());
+}
+BENCHMARK(BM_json_to_qasm2)->RangeMultiplier(10)->Range(10, 10000);
+
+void BM_qasm2_to_json(benchmark::State& state)
+{
+    const JSON instructions = instructions_of_size(state.range(0));
+    const std::string qasm = json_to_qasm2(instructions, {{"num_qubits", N_QUBITS}, {"num_clbits", N_QUBITS}});
+    for (auto _ : state)
+        benchmark::DoNotOptimize(qasm2_to_json(qasm));
+    state.SetItemsProcessed(state.iterations() * instructions.size());
+}
+BENCHMARK(BM_qasm2_to_json)->RangeMultiplier(10)->Range(10, 10000);
+
+} // End of anonymous namespace
@@ -0,0 +1,135 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+#include <benchmark/benchmark.h>
+
+#include "quantum_task.hpp"
+#include "backends/simple_backend.hpp"
+#include "backends/simulators/AER/aer_simple_simulator.hpp"
+#include "backends/simulators/Munich/munich_simple_simulator.hpp"
+#include "backends/simulators/Maestro/maestro_simple_simulator.hpp"
+#include "backends/simulators/CUNQA/cunqa_simple_simulator.hpp"
+#include "backends/simulators/Qulacs/qulacs_simple_simulator.hpp"
+#include "backends/simulators/Qsim/qsim_simple_simulator.hpp"
+#include "backends/simulators/QuEST/quest_simple_simulator.hpp"
+#include "utils/helpers/basis_gates.hpp"
+#include "circuits.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+
+namespace {
+
+constexpr int SHOTS = 1024;
+
+// Built as setup_qpus builds the backends of the vQPUs
+template <typename Simulator>
+std::unique_ptr<SimpleBackend> make_backend()
+{
+    auto simulator = std::make_unique<Simulator>();
+    SimpleConfig config;
+    config.set_basis_gates(get_basis_gates(simulator->get_name()));
+    return std::make_unique<SimpleBackend>(config, std::move(simulator));
+}
+
+// Whole executions of the standard circuits through the backend, which reach the simulate of
+// the adapter of the simulator, and the cost per shot of the dynamic circuits, which the
+// adapters run shot by shot
+template <typename Simulator>
+void register_simulator(const std::string& simulator)
+{
+    const std::vector<std::pair<std::string, std::string>> circuits = {
+        {"ghz/20", bench::ghz(20, SHOTS)},
+        {"qft/14", bench::qft(14, SHOTS)},
+        {"random_layers/16x20", bench::random_layers(16, 20, SHOTS)},
+        {"teleportation", bench::teleportation(SHOTS)}
+    };
+    for (const auto& [circuit, task] : circuits) {
+        const std::string name = "BM_simulate/" + simulator + "/" + circuit;
+        benchmark::RegisterBenchmark(name.c_str(), [task](benchmark::State& state) {
+            auto backend = make_backend<Simulator>();
+            QuantumTask quantum_task(task);
+            for (auto _ : state)
+                benchmark::DoNotOptimize(backend->execute(quantum_task));
+            state.counters["shots_per_second"] = benchmark::Counter(state.iterations() * SHOTS, benchmark::Counter::kIsRate);
+        })->Unit(benchmark::kMillisecond);
+    }
+
+    const std::string name = "BM_dynamic_shot/" + simulator;
+    benchmark::RegisterBenchmark(name.c_str(), [](benchmark::State& state) {
+        auto backend = make_backend<Simulator>();
+        QuantumTask quantum_task(bench::teleportation(state.range(0)));
+        for (auto _ : state)
+            benchmark::DoNotOptimize(backend->execute(quantum_task));
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    })->RangeMultiplier(8)->Range(8, 4096)->Unit(benchmark::kMicrosecond);
+}
+
+// The circuits of 4 to 16 qubits of the variational algorithms, a few layers of rotations and
+// cx, where the setup of the simulation and the dispatch of the gates weigh as much as the
+// arithmetic. CUNQA runs them on the SmallStatevector of their qubits
+template <typename Simulator>
+void register_small_circuits(const std::string& simulator)
+{
+    for (const int n_qubits : {4, 8, 12, 16}) {
+        const std::string name = "BM_small_circuit/" + simulator + "/" + std::to_string(n_qubits);
+        benchmark::RegisterBenchmark(name.c_str(), [n_qubits](benchmark::State& state) {
+            auto backend = make_backend<Simulator>();
+            QuantumTask quantum_task(bench::random_layers(n_qubits, 4, SHOTS));
+            for (auto _ : state)
+                benchmark::DoNotOptimize(backend->execute(quantum_task));
+            state.SetItemsProcessed(state.iterations());
+        })->Unit(benchmark::kMicrosecond);
+    }
+}
+
+// Sweeps of 16 parameter sets of the same circuits, as QJobMapper sends a population of the
+// optimizers. CUNQA runs the sets together on the lanes of a LaneStatevector
+template <typename Simulator>
+void register_params_batch(const std::string& simulator)
+{
+    for (const int n_qubits : {4, 8, 12}) {
+        const std::string name = "BM_params_batch/" + simulator + "/" + std::to_string(n_qubits);
+        benchmark::RegisterBenchmark(name.c_str(), [n_qubits](benchmark::State& state) {
+            auto backend = make_backend<Simulator>();
+            QuantumTask quantum_task(bench::random_layers(n_qubits, 4, SHOTS));
+            JSON params_batch = JSON::array();
+            for (int set = 0; set < 16; set++) {
+                std::vector<double> params(quantum_task.param_slots().size());
+                for (std::size_t i = 0; i < params.size(); i++)
+                    params[i] = 0.1 * set + 0.01 * i;
+                params_batch.push_back(params);
+            }
+            quantum_task.update_circuit(JSON({{"params_batch", params_batch}, {"shots", SHOTS}}).dump());
+            for (auto _ : state)
+                benchmark::DoNotOptimize(backend->execute_batch(quantum_task));
+            state.SetItemsProcessed(state.iterations() * 16);
+        })->Unit(benchmark::kMicrosecond);
+    }
+}
+
+} // End of anonymous namespace
+
+int main(int argc, char** argv)
+{
+    register_simulator<AerSimpleSimulator>("Aer");
+    register_simulator<MunichSimpleSimulator>("Munich");
+    register_simulator<MaestroSimpleSimulator>("Maestro");
+    register_simulator<CunqaSimpleSimulator>("Cunqa");
+    register_simulator<QulacsSimpleSimulator>("Qulacs");
+    register_simulator<QsimSimpleSimulator>("Qsim");
+    register_simulator<QuestSimpleSimulator>("Quest");
+    register_small_circuits<CunqaSimpleSimulator>("Cunqa");
+    register_small_circuits<QulacsSimpleSimulator>("Qulacs");
+    register_small_circuits<QsimSimpleSimulator>("Qsim");
+    register_params_batch<CunqaSimpleSimulator>("Cunqa");
+    register_params_batch<QulacsSimpleSimulator>("Qulacs");
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
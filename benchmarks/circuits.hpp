@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utils/json.hpp"
+
+// Quantum tasks of the standard circuits of the benchmarks, in the JSON layout that the clients
+// send. Only h, x, z, rx, rz, cx, measure and cif, which every simulator supports
+namespace cunqa {
+namespace bench {
+
+inline JSON gate(const std::string& name, const std::vector<int>& qubits, const std::vector<double>& params = {})
+{
+    JSON instruction = {{"name", name}, {"qubits", qubits}};
+    if (!params.empty())
+        instruction["params"] = params;
+    return instruction;
+}
+
+inline void measure_all(std::vector<JSON>& instructions, const int n_qubits)
+{
+    for (int qubit = 0; qubit < n_qubits; qubit++)
+        instructions.push_back({{"name", "measure"}, {"qubits", {qubit}}, {"clbits", {qubit}}});
+}
+
+inline std::string quantum_task(const std::vector<JSON>& instructions, const int n_qubits, const int shots,
+                                const bool is_dynamic = false)
+{
+    JSON task = {
+        {"id", "benchmark"},
+        {"instructions", instructions},
+        {"config", {
+            {"shots", shots},
+            {"method", "automatic"},
+            {"avoid_parallelization", false},
+            {"num_qubits", n_qubits},
+            {"num_clbits", n_qubits},
+            {"seed", 1234},
+            {"device", {{"device_name", "CPU"}, {"target_devices", std::vector<int>()}}}
+        }},
+        {"sending_to", std::vector<std::string>()},
+        {"is_dynamic", is_dynamic}
+    };
+    return task.dump();
+}
+
+inline std::string ghz(const int n_qubits, const int shots)
+{
+    std::vector<JSON> instructions = {gate("h", {0})};
+    for (int qubit = 1; qubit < n_qubits; qubit++)
+        instructions.push_back(gate("cx", {qubit - 1, qubit}));
+    measure_all(instructions, n_qubits);
+    return quantum_task(instructions, n_qubits, shots);
+}
+
+// Controlled phases decomposed into rz and cx
+inline std::string qft(const int n_qubits, const int shots)
+{
+    std::vector<JSON> instructions;
+    for (int target = 0; target < n_qubits; target++) {
+        instructions.push_back(gate("h", {target}));
+        for (int control = target + 1; control < n_qubits; control++) {
+            const double angle = M_PI / (1 << (control - target));
+            instructions.push_back(gate("rz", {control}, {angle / 2}));
+            instructions.push_back(gate("cx", {control, target}));
+            instructions.push_back(gate("rz", {target}, {-angle / 2}));
+            instructions.push_back(gate("cx", {control, target}));
+            instructions.push_back(gate("rz", {target}, {angle / 2}));
+        }
+    }
+    measure_all(instructions, n_qubits);
+    return quantum_task(instructions, n_qubits, shots);
+}
+
+// Layers of random rotations on every qubit followed by a ladder of cx
+inline std::vector<JSON> random_layers_instructions(const int n_qubits, const int n_layers)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::vector<JSON> instructions;
+    for (int layer = 0; layer < n_layers; layer++) {
+        for (int qubit = 0; qubit < n_qubits; qubit++) {
+            instructions.push_back(gate("rx", {qubit}, {angle(rng)}));
+            instructions.push_back(gate("rz", {qubit}, {angle(rng)}));
+        }
+        for (int qubit = layer % 2; qubit + 1 < n_qubits; qubit += 2)
+            instructions.push_back(gate("cx", {qubit, qubit + 1}));
+    }
+    return instructions;
+}
+
+inline std::string random_layers(const int n_qubits, const int n_layers, const int shots)
+{
+    auto instructions = random_layers_instructions(n_qubits, n_layers);
+    measure_all(instructions, n_qubits);
+    return quantum_task(instructions, n_qubits, shots);
+}
+
+// Teleportation of a rotated qubit within a single circuit, with the corrections conditioned
+// on the measurements, so the simulators run it shot by shot
+inline std::string teleportation(const int shots)
+{
+    auto cif = [](const int clbit, const std::string& name) {
+        return JSON{{"name", "cif"}, {"clbits", {clbit}}, {"instructions", {gate(name, {2})}},
+                    {"condition", 1}, {"operation", "and"}};
+    };
+    std::vector<JSON> instructions = {
+        gate("rx", {0}, {0.3}),
+        gate("h", {1}),
+        gate("cx", {1, 2}),
+        gate("cx", {0, 1}),
+        gate("h", {0}),
+        {{"name", "measure"}, {"qubits", {0}}, {"clbits", {0}}},
+        {{"name", "measure"}, {"qubits", {1}}, {"clbits", {1}}},
+        cif(1, "x"),
+        cif(0, "z"),
+        {{"name", "measure"}, {"qubits", {2}}, {"clbits", {2}}}
+    };
+    return quantum_task(instructions, 3, shots, true);
+}
+
+} // End of bench namespace
+} // End of cunqa namespace
@@ -0,0 +1,288 @@
+#include <map>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "argparse/argparse.hpp"
+#include "quantum_task.hpp"
+#include "backends/simple_backend.hpp"
+#include "backends/simulators/AER/aer_simple_simulator.hpp"
+#include "backends/simulators/Munich/munich_simple_simulator.hpp"
+#include "backends/simulators/Maestro/maestro_simple_simulator.hpp"
+#include "backends/simulators/CUNQA/cunqa_simple_simulator.hpp"
+#include "backends/simulators/Qulacs/qulacs_simple_simulator.hpp"
+#include "backends/simulators/Qsim/qsim_simple_simulator.hpp"
+#include "backends/simulators/QuEST/quest_simple_simulator.hpp"
+#include "utils/helpers/basis_gates.hpp"
+#include "utils/helpers/result_fields.hpp"
+#include "circuits.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+
+struct CunqaArgs : public argparse::Args
+{
+    std::optional<std::string>& circuits = kwarg("circuits", "JSON file with the quantum tasks to compare, as {name: task}, instead of the standard ones.");
+    std::optional<std::vector<std::string>>& simulators = kwarg("sim,simulators", "Simulators to compare, all of them by default.").multi_argument();
+    std::string& reference               = kwarg("reference", "Simulator whose counts the others are compared with.").set_default("Aer");
+    int& shots                           = kwarg("s,shots", "Shots of every circuit.").set_default(8192);
+    int& repeats                         = kwarg("repeats", "Executions of each circuit per simulator, of which the median time is kept.").set_default(3);
+    double& tolerance                    = kwarg("tolerance", "Total-variation distance above the sampling noise for two simulators to disagree.").set_default(0.02);
+    std::optional<std::string>& output   = kwarg("o,output", "File where the runs and the recommendations are written as JSON.");
+
+    void welcome() {
+        std::cout << "Compares the time, peak memory and results of the simulators on a set of circuits." << "\n";
+    }
+};
+
+namespace {
+
+using Execute = std::function<JSON(const QuantumTask&)>;
+
+template <typename Simulator>
+Execute executor()
+{
+    return [](const QuantumTask& quantum_task) {
+        auto simulator = std::make_unique<Simulator>();
+        SimpleConfig config;
+        config.set_basis_gates(get_basis_gates(simulator->get_name()));
+        SimpleBackend backend(config, std::move(simulator));
+        return backend.execute(quantum_task);
+    };
+}
+
+const std::map<std::string, Execute> EXECUTORS = {
+    {"Aer", executor<AerSimpleSimulator>()},
+    {"Munich", executor<MunichSimpleSimulator>()},
+    {"Maestro", executor<MaestroSimpleSimulator>()},
+    {"Cunqa", executor<CunqaSimpleSimulator>()},
+    {"Qulacs", executor<QulacsSimpleSimulator>()},
+    {"Qsim", executor<QsimSimpleSimulator>()},
+    {"Quest", executor<QuestSimpleSimulator>()}
+};
+
+struct Run {
+    double seconds = 0;
+    double peak_mb = 0;
+    JSON counts;
+    std::string error;
+};
+
+// Each run goes in a child process, so that its peak memory is its own and a simulator that
+// crashes does not stop the comparison
+Run run_isolated(const Execute& execute, const std::string& task, const int repeats)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        throw std::runtime_error("Could not open a pipe for the run.");
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        JSON outcome;
+        try {
+            QuantumTask quantum_task(task);
+            std::vector<double> times;
+            JSON result;
+            for (int i = 0; i < std::max(1, repeats); i++) {
+                const auto start = std::chrono::steady_clock::now();
+                result = execute(quantum_task);
+                times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+            if (result.contains("ERROR"))
+                outcome = {{"error", result.at("ERROR")}};
+            else
+                outcome = {{"seconds", times[times.size() / 2]}, {"counts", counts_of(result)}};
+        } catch (const std::exception& e) {
+            outcome = {{"error", e.what()}};
+        }
+        const std::string message = outcome.dump();
+        for (std::size_t written = 0; written < message.size();) {
+            auto n = write(fds[1], message.data() + written, message.size() - written);
+            if (n <= 0)
+                break;
+            written += n;
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string message;
+    char buffer[1 << 16];
+    for (ssize_t n; (n = read(fds[0], buffer, sizeof(buffer))) > 0;)
+        message.append(buffer, n);
+    close(fds[0]);
+
+    int status;
+    rusage usage;
+    wait4(pid, &status, 0, &usage);
+
+    Run run;
+    run.peak_mb = usage.ru_maxrss / 1024.0;
+    if (message.empty()) {
+        run.error = "The simulator stopped the process with status " + std::to_string(status) + ".";
+        return run;
+    }
+    auto outcome = JSON::parse(message);
+    if (outcome.contains("error")) {
+        run.error = outcome.at("error").get<std::string>();
+        return run;
+    }
+    run.seconds = outcome.at("seconds");
+    run.counts = outcome.at("counts");
+    return run;
+}
+
+// Probabilities by outcome, whatever the format of the bitstrings of the simulator
+std::map<std::uint64_t, double> distribution(const JSON& counts)
+{
+    std::map<std::uint64_t, double> probabilities;
+    double total = 0;
+    for (const auto& [bitstring, count] : counts.items()) {
+        std::uint64_t outcome = 0;
+        if (bitstring.starts_with("0x")) {
+            outcome = std::stoull(bitstring.substr(2), nullptr, 16);
+        } else {
+            for (const char bit : bitstring) {
+                if (bit == '0' || bit == '1')
+                    outcome = (outcome << 1) | (bit == '1');
+            }
+        }
+        probabilities[outcome] += count.get<double>();
+        total += count.get<double>();
+    }
+    for (auto& [outcome, probability] : probabilities)
+        probability /= total;
+    return probabilities;
+}
+
+double total_variation(const JSON& a, const JSON& b)
+{
+    auto p = distribution(a), q = distribution(b);
+    double distance = 0;
+    for (const auto& [outcome, probability] : p)
+        distance += std::abs(probability - (q.contains(outcome) ? q.at(outcome) : 0.0));
+    for (const auto& [outcome, probability] : q) {
+        if (!p.contains(outcome))
+            distance += probability;
+    }
+    return distance / 2;
+}
+
+std::string with_config(const std::string& task, const int shots, const int seed)
+{
+    auto task_json = JSON::parse(task);
+    task_json["config"]["shots"] = shots;
+    task_json["config"]["seed"] = seed;
+    return task_json.dump();
+}
+
+std::vector<std::pair<std::string, std::string>> read_circuits(const CunqaArgs& args)
+{
+    if (!args.circuits) {
+        return {
+            {"ghz_12", bench::ghz(12, args.shots)},
+            {"qft_10", bench::qft(10, args.shots)},
+            {"random_layers_8x10", bench::random_layers(8, 10, args.shots)},
+            {"teleportation", bench::teleportation(args.shots)}
+        };
+    }
+    std::ifstream file(*args.circuits);
+    std::vector<std::pair<std::string, std::string>> circuits;
+    for (const auto& [name, task] : JSON::parse(file).items())
+        circuits.emplace_back(name, task.dump());
+    return circuits;
+}
+
+} // End of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    auto args = argparse::parse<CunqaArgs>(argc, argv);
+    std::vector<std::string> simulators;
+    if (args.simulators) {
+        simulators = *args.simulators;
+    } else {
+        for (const auto& [simulator, _] : EXECUTORS)
+            simulators.push_back(simulator);
+    }
+    for (const auto& simulator : simulators) {
+        if (!EXECUTORS.contains(simulator)) {
+            std::cerr << "Unknown simulator " << simulator << ".\n";
+            return 1;
+        }
+    }
+
+    JSON runs = JSON::array();
+    JSON recommendations = JSON::object();
+    std::cout << std::left << std::setw(22) << "circuit" << std::setw(10) << "simulator" << std::right
+              << std::setw(12) << "seconds" << std::setw(12) << "peak MB" << std::setw(10) << "TVD"
+              << "  agrees\n";
+
+    for (const auto& [circuit, generated] : read_circuits(args)) {
+        const std::string task = with_config(generated, args.shots, 1234);
+        const auto& reference = EXECUTORS.contains(args.reference) ? EXECUTORS.at(args.reference)
+                                                                    : EXECUTORS.at(simulators.front());
+        // The distance between two seeds of the reference is the sampling noise of the shots
+        Run baseline = run_isolated(reference, task, 1);
+        Run resampled = run_isolated(reference, with_config(generated, args.shots, 4321), 1);
+        const bool comparable = baseline.error.empty() && resampled.error.empty();
+        const double noise = comparable ? total_variation(baseline.counts, resampled.counts) : 0.0;
+
+        std::optional<std::pair<double, std::string>> fastest;
+        for (const auto& simulator : simulators) {
+            Run run = run_isolated(EXECUTORS.at(simulator), task, args.repeats);
+            JSON entry = {{"circuit", circuit}, {"simulator", simulator}, {"peak_mb", run.peak_mb}};
+            std::cout << std::left << std::setw(22) << circuit << std::setw(10) << simulator << std::right;
+            if (!run.error.empty()) {
+                entry["error"] = run.error;
+                std::cout << "  error: " << run.error << "\n";
+                runs.push_back(entry);
+                continue;
+            }
+
+            entry["seconds"] = run.seconds;
+            std::cout << std::fixed << std::setprecision(4) << std::setw(12) << run.seconds
+                      << std::setprecision(1) << std::setw(12) << run.peak_mb;
+            if (comparable) {
+                const double distance = total_variation(run.counts, baseline.counts);
+                const bool agrees = distance <= 1.5 * noise + args.tolerance;
+                entry["tvd"] = distance;
+                entry["agrees"] = agrees;
+                std::cout << std::setprecision(3) << std::setw(10) << distance << "  " << (agrees ? "yes" : "no") << "\n";
+                if (agrees && (!fastest || run.seconds < fastest->first))
+                    fastest = {run.seconds, simulator};
+            } else {
+                std::cout << std::setw(10) << "-" << "  -\n";
+            }
+            runs.push_back(entry);
+        }
+        if (fastest)
+            recommendations[circuit] = fastest->second;
+    }
+
+    std::cout << "\nFastest simulator that agrees with " << args.reference << ":\n";
+    for (const auto& [circuit, simulator] : recommendations.items())
+        std::cout << "    " << circuit << ": " << simulator.get<std::string>() << "\n";
+
+    if (args.output) {
+        std::ofstream file(*args.output);
+        file << JSON({{"reference", args.reference}, {"shots", args.shots}, {"runs", runs},
+                      {"recommendations", recommendations}}).dump(4) << "\n";
+    }
+    return 0;
+}
@@ -14,10 +14,12 @@ Top-level modules
 - result
 - qpu
 - mappers
+- cutting
 
 Public API in the main cunqa namespace
 --------------------------------------
 - get_QPUs
+- refresh_QPUs
 - qraise
 - qdrop
 """
@@ -31,14 +33,17 @@ _submodules = [
     "qjob",
     "result",
     "qpu",
-    "mappers"
+    "mappers",
+    "cutting"
 ]
 
 _lazy_symbols = {
     "get_QPUs": ("cunqa.qpu", "get_QPUs"),
+    "refresh_QPUs": ("cunqa.qpu", "refresh_QPUs"),
     "qraise": ("cunqa.qpu", "qraise"),
     "qdrop": ("cunqa.qpu", "qdrop"),
-    "gather": ("cunqa.qjob", "gather")
+    "gather": ("cunqa.qjob", "gather"),
+    "as_completed": ("cunqa.qjob", "as_completed")
 }
 
 __all__ = _submodules + list(_lazy_symbols.keys()) + ["__version__"]
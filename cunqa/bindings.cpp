@@ -3,12 +3,20 @@
 #include <pybind11/stl.h>
 
 #include <string>
+#include <chrono>
 
 #include "comm/client.hpp"
 #include "utils/helpers/qasm2_to_json.hpp"
 #include "utils/helpers/json_to_qasm2.hpp"
+#include "utils/helpers/circuit_transformations.hpp"
+#include "utils/helpers/binary_counts.hpp"
+#include "utils/helpers/binary_states.hpp"
+#include "utils/helpers/param_tape.hpp"
+#include "utils/helpers/circuit_builder.hpp"
 #include "utils/probabilities/process_counts.hpp"
+#include "utils/probabilities/circuit_cutting.hpp"
 #include "json.hpp"
+#include "circuit_transpiler.hpp"
 
  
 namespace py = pybind11;
@@ -18,25 +26,77 @@ PYBIND11_MODULE(qclient, m) {
 
     m.doc() = "TODO";
  
+    // The GIL is released while waiting for the results, so other Python threads go on meanwhile
     py::class_<FutureWrapper<Client>>(m, "FutureWrapper")
-        .def("get", &FutureWrapper<Client>::get)
-        .def("valid", &FutureWrapper<Client>::valid);
+        .def("get", [](FutureWrapper<Client> &f) -> py::object {
+            std::string result;
+            {
+                py::gil_scoped_release release;
+                result = f.get();
+            }
+            if (cunqa::is_binary_states(result)) {
+                // Binary states come as (result JSON, doubles), with the array viewing the message
+                auto* message = new std::string(std::move(result));
+                py::capsule owner(message, [](void* m) { delete static_cast<std::string*>(m); });
+                auto view = cunqa::view_binary_states(*message);
+                return py::make_tuple(
+                    py::str(view.result.data(), view.result.size()),
+                    py::array_t<double>(view.n_doubles, view.doubles, owner)
+                );
+            }
+            if (!cunqa::is_binary_counts(result))
+                return py::str(result);
+
+            // Binary counts come as (result JSON, outcomes, counts, num_clbits), with both arrays
+            // viewing the message, which lives as long as either of them
+            auto* message = new std::string(std::move(result));
+            py::capsule owner(message, [](void* m) { delete static_cast<std::string*>(m); });
+            auto view = cunqa::view_binary_counts(*message);
+            return py::make_tuple(
+                py::str(view.result.data(), view.result.size()),
+                py::array_t<std::uint64_t>(view.n_outcomes, view.outcomes, owner),
+                py::array_t<std::uint64_t>(view.n_outcomes, view.counts, owner),
+                view.num_clbits
+            );
+        })
+        .def("valid", &FutureWrapper<Client>::valid)
+        .def("ready", &FutureWrapper<Client>::ready, py::call_guard<py::gil_scoped_release>())
+        .def("wait_for", [](FutureWrapper<Client> &f, const double timeout) {
+            auto timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::duration<double>(timeout));
+            return f.wait_for(timeout_ms);
+        }, py::arg("timeout"), py::call_guard<py::gil_scoped_release>())
+        .def("partial", [](FutureWrapper<Client> &f) -> py::object {
+            auto partial = f.partial();
+            if (partial.empty())
+                return py::none();
+            return py::str(partial);
+        })
+        .def("stop", &FutureWrapper<Client>::stop)
+        .def("cancel", &FutureWrapper<Client>::cancel);
 
     py::class_<Client>(m, "QClient")
  
-        .def(py::init<>())
+        .def(py::init<bool>(), py::arg("multiplexed") = false)
 
         .def("connect", [](Client &c, const std::string& endpoint) { 
             c.connect(endpoint); 
         })
+
+        .def("connect", [](Client &c, const std::string& endpoint, const std::string& local_endpoint, const std::string& nodename) { 
+            c.connect(endpoint, local_endpoint, nodename); 
+        })
  
         .def("send_circuit", [](Client &c, const std::string& circuit) { 
             return FutureWrapper<Client>(c.send_circuit(circuit)); 
-        })
+        }, py::call_guard<py::gil_scoped_release>())
 
         .def("send_parameters", [](Client &c, const std::string& parameters) { 
             return FutureWrapper<Client>(c.send_parameters(parameters)); 
-        });
+        }, py::call_guard<py::gil_scoped_release>())
+
+        .def("send_status", [](Client &c) { 
+            return FutureWrapper<Client>(c.send_status()); 
+        }, py::call_guard<py::gil_scoped_release>());
 
     m.def("qasm2_to_json", [](const std::string& circuit_qasm) {
         return qasm2_to_json(circuit_qasm).dump();
@@ -47,6 +107,105 @@ PYBIND11_MODULE(qclient, m) {
         return json_to_qasm2(circuit_json["instructions"], circuit_json["config"]);
     });
 
+    // Passes of cunqa.circuit.transformations, "null" if the circuits have symbolic parameters.
+    // The circuits cross as JSON once, and the passes run without the GIL
+    m.def("hsplit_instructions", [](const std::string& instructions, const std::vector<int>& initial_qubits,
+                                    const std::vector<std::string>& ids) {
+        return cunqa::transformations::hsplit(JSON::parse(instructions), initial_qubits, ids).dump();
+    }, py::call_guard<py::gil_scoped_release>());
+    m.def("union_instructions", [](const std::string& circuits) {
+        return cunqa::transformations::union_circuits(JSON::parse(circuits)).dump();
+    }, py::call_guard<py::gil_scoped_release>());
+    m.def("add_instructions", [](const std::string& circuits) {
+        return cunqa::transformations::add_circuits(JSON::parse(circuits)).dump();
+    }, py::call_guard<py::gil_scoped_release>());
+    m.def("transpile_instructions", [](const std::string& instructions, const std::vector<std::string>& basis_gates,
+                                       const std::vector<std::vector<int>>& coupling_map, const int n_qubits,
+                                       const int n_physical_qubits, const std::vector<int>& initial_layout, const std::uint64_t seed) {
+        auto circuit = JSON::parse(instructions).get<std::vector<JSON>>();
+        const auto report = cunqa::transpile_circuit(circuit, {
+            .basis_gates = {basis_gates.begin(), basis_gates.end()},
+            .coupling_map = coupling_map,
+            .n_qubits = n_qubits,
+            .n_physical_qubits = n_physical_qubits,
+            .initial_layout = initial_layout,
+            .seed = seed
+        });
+        return JSON({{"instructions", circuit}, {"num_qubits", report.n_qubits}, {"report", report.to_json()}}).dump();
+    }, py::call_guard<py::gil_scoped_release>());
+
+    // Binary layout of a quantum task built by QJob, written from its instructions without a
+    // Python object per field. None if any instruction is more than a name, qubits, clbits and
+    // numeric params, so that the task is sent as JSON
+    m.def("to_binary_task", [](const py::dict& quantum_task) -> py::object {
+        cunqa::CircuitBuilder builder;
+        std::vector<int32_t> qubits, clbits;
+        std::vector<double> params;
+        try {
+            for (const auto& item : quantum_task["instructions"].cast<py::list>()) {
+                const auto instruction = item.cast<py::dict>();
+                uint16_t flags = 0;
+                qubits.clear();
+                clbits.clear();
+                params.clear();
+                for (const auto& [key, value] : instruction) {
+                    const auto field = key.cast<std::string_view>();
+                    if (field == "name")
+                        continue;
+                    if (field == "qubits") {
+                        flags |= cunqa::HAS_QUBITS;
+                        for (const auto& qubit : value)
+                            qubits.push_back(qubit.cast<int32_t>());
+                    } else if (field == "clbits") {
+                        flags |= cunqa::HAS_CLBITS;
+                        for (const auto& clbit : value)
+                            clbits.push_back(clbit.cast<int32_t>());
+                    } else if (field == "params") {
+                        flags |= cunqa::HAS_PARAMS;
+                        // Through __float__, as the Param objects of the parametric circuits
+                        for (const auto& param : value)
+                            params.push_back(py::float_(py::reinterpret_borrow<py::object>(param)).cast<double>());
+                    } else {
+                        return py::none();
+                    }
+                }
+                if (!builder.add(instruction["name"].cast<std::string_view>(), qubits, clbits, params, flags))
+                    return py::none();
+            }
+        } catch (const py::error_already_set&) {
+            return py::none(); // Nested or symbolic params
+        } catch (const py::cast_error&) {
+            return py::none();
+        }
+
+        const auto config = py::module_::import("json").attr("dumps")(quantum_task["config"], py::arg("default") =
+                                py::module_::import("cunqa.circuit.parameter").attr("encoder")).cast<std::string>();
+        std::vector<std::string> sending_to;
+        if (quantum_task.contains("sending_to"))
+            sending_to = quantum_task["sending_to"].cast<std::vector<std::string>>();
+        const bool is_dynamic = quantum_task.contains("is_dynamic") && quantum_task["is_dynamic"].cast<bool>();
+        return py::bytes(builder.binary_task(py::str(quantum_task["id"]).cast<std::string>(), config, is_dynamic, sending_to));
+    }, py::arg("quantum_task"));
+
+    // Parameter expressions lowered by cunqa.circuit.parameter.ParamBinder, evaluated for an
+    // array of values of their free symbols into the array of the parameters of the circuit
+    py::class_<cunqa::ParamTape>(m, "ParamTape")
+        .def(py::init([](const std::vector<std::tuple<int, int, double>>& operations, const std::size_t n_symbols) {
+            std::vector<cunqa::ParamTape::Operation> tape;
+            tape.reserve(operations.size());
+            for (const auto& [opcode, arg, value] : operations)
+                tape.push_back({opcode, arg, value});
+            return cunqa::ParamTape(std::move(tape), n_symbols);
+        }), py::arg("operations"), py::arg("n_symbols"))
+        .def_property_readonly("n_params", &cunqa::ParamTape::n_params)
+        .def("evaluate", [](const cunqa::ParamTape& tape, py::array_t<double, py::array::c_style | py::array::forcecast> symbols) {
+            if (static_cast<std::size_t>(symbols.size()) != tape.n_symbols())
+                throw std::invalid_argument("The tape takes " + std::to_string(tape.n_symbols()) + " symbols, not " + std::to_string(symbols.size()) + ".");
+            py::array_t<double> params(tape.n_params());
+            tape.evaluate(symbols.data(), params.mutable_data());
+            return params;
+        }, py::arg("symbols"));
+
 }
 
 PYBIND11_MODULE(counts_and_probs, m) {
@@ -88,6 +247,47 @@ PYBIND11_MODULE(counts_and_probs, m) {
         )pbdoc"
     );
 
+    m.def("counts_to_probs",
+        [](py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast> outcomes,
+           py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast> counts,
+           int num_qubits,
+           bool per_qubit = false,
+           const std::optional<std::vector<int>>& partial = std::nullopt) {
+            auto result = countsToProbs(
+                std::span<const std::uint64_t>(outcomes.data(), outcomes.size()),
+                std::span<const std::uint64_t>(counts.data(), counts.size()),
+                num_qubits,
+                per_qubit,
+                partial.has_value() ? &partial.value() : nullptr
+            );
+            if (per_qubit) {
+                int size = result.size() / 2;
+                std::vector<size_t> shape = {static_cast<size_t>(size), 2};
+                return py::array_t<double>(shape, result.data());
+            } else {
+                return py::array_t<double>(result.size(), result.data());
+            }
+        },
+        py::arg("outcomes"),
+        py::arg("counts"),
+        py::arg("num_qubits"),
+        py::arg("per_qubit") = false,
+        py::arg("partial") = py::none(),
+        R"pbdoc(
+            Convert measurement counts given as integer outcomes to probabilities.
+            
+            Args:
+                outcomes: Array of outcomes, the bitstrings read as integers
+                counts: Array with the counts of each outcome
+                num_qubits: Number of bits of the outcomes
+                per_qubit: If True, marginalize to per-qubit probabilities
+                partial: Optional list of qubit indices to marginalize over
+                
+            Returns:
+                List of probabilities corresponding to bitstrings
+        )pbdoc"
+    );
+
     m.def("recombine_probs",
         [](const std::vector<double>& probs,
            bool per_qubit,
@@ -159,4 +359,111 @@ PYBIND11_MODULE(counts_and_probs, m) {
                 #                  {"01": 146, "11": 1700}
         )pbdoc"
     );
+
+    m.def("merge_counts",
+        [](const std::vector<py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast>>& outcomes,
+           const std::vector<py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast>>& counts,
+           int num_bits) {
+            std::vector<std::span<const std::uint64_t>> outcome_spans, count_spans;
+            for (const auto& array : outcomes)
+                outcome_spans.emplace_back(array.data(), static_cast<std::size_t>(array.size()));
+            for (const auto& array : counts)
+                count_spans.emplace_back(array.data(), static_cast<std::size_t>(array.size()));
+
+            IntCounts merged;
+            {
+                py::gil_scoped_release release;
+                merged = mergeOutcomes(outcome_spans, count_spans, num_bits);
+            }
+            return py::make_tuple(py::array_t<std::uint64_t>(merged.outcomes.size(), merged.outcomes.data()),
+                                  py::array_t<std::uint64_t>(merged.counts.size(), merged.counts.data()));
+        },
+        py::arg("outcomes"),
+        py::arg("counts"),
+        py::arg("num_bits"),
+        R"pbdoc(
+            Sum of the counts of several results, given as integer outcomes.
+
+            Args:
+                outcomes: Array of outcomes of each result, the bitstrings read as integers
+                counts: Array with the counts of the outcomes of each result
+                num_bits: Number of bits of the outcomes, at most 64
+
+            Returns:
+                Arrays of the outcomes, ascending, and of their summed counts
+        )pbdoc"
+    );
+
+    m.def("fold_cut_counts",
+        [](py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast> outcomes,
+           py::array_t<std::uint64_t, py::array::c_style | py::array::forcecast> counts,
+           const std::vector<int>& output_bits,
+           const std::vector<int>& sign_bits) {
+            auto result = foldCutCounts(
+                std::span<const std::uint64_t>(outcomes.data(), outcomes.size()),
+                std::span<const std::uint64_t>(counts.data(), counts.size()),
+                output_bits,
+                sign_bits
+            );
+            return py::array_t<double>(result.size(), result.data());
+        },
+        py::arg("outcomes"),
+        py::arg("counts"),
+        py::arg("output_bits"),
+        py::arg("sign_bits"),
+        R"pbdoc(
+            Quasi-probabilities of the output bits of a variant of a cut fragment.
+
+            Args:
+                outcomes: Array of outcomes, the bitstrings read as integers
+                counts: Array with the counts of each outcome
+                output_bits: Bits of the outcomes kept, the first one as bit 0 of the result
+                sign_bits: Bits of the measurements of the cuts, each count weighed by their parity
+
+            Returns:
+                Array of 2^len(output_bits) quasi-probabilities
+        )pbdoc"
+    );
+
+    m.def("reconstruct_cut_probs",
+        [](const std::vector<py::array_t<double, py::array::c_style | py::array::forcecast>>& tensors,
+           const std::vector<std::vector<int>>& cuts,
+           const std::vector<std::vector<int>>& output_bits,
+           const std::vector<std::vector<double>>& coefficients,
+           int num_bits) {
+            if (tensors.size() != cuts.size() || tensors.size() != output_bits.size()) {
+                throw std::invalid_argument("tensors, cuts and output_bits differ in length");
+            }
+            std::vector<CutFragmentTensor> fragments;
+            for (std::size_t f = 0; f < tensors.size(); ++f)
+                fragments.push_back({cuts[f], output_bits[f], {tensors[f].data(), static_cast<std::size_t>(tensors[f].size())}});
+
+            std::vector<double> result;
+            {
+                py::gil_scoped_release release;
+                result = reconstructCutProbs(fragments, coefficients, num_bits);
+            }
+            return py::array_t<double>(result.size(), result.data());
+        },
+        py::arg("tensors"),
+        py::arg("cuts"),
+        py::arg("output_bits"),
+        py::arg("coefficients"),
+        py::arg("num_bits"),
+        R"pbdoc(
+            Distribution of a cut circuit from the quasi-probabilities of its fragments.
+
+            Args:
+                tensors: Array of each fragment with the quasi-probabilities of its output bits
+                    for every assignment of labels to its cuts, the label of its first cut the
+                    fastest index
+                cuts: Cuts of each fragment
+                output_bits: Bits of the distribution given by the output bits of each fragment
+                coefficients: Coefficients of the labels of each cut
+                num_bits: Number of bits of the distribution
+
+            Returns:
+                Array of 2^num_bits probabilities, which may be slightly negative from sampling
+        )pbdoc"
+    );
 }
\ No newline at end of file
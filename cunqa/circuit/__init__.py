@@ -13,6 +13,7 @@ _lazy_symbols = {
     "add": ("cunqa.circuit.transformations", "add"),
     "union": ("cunqa.circuit.transformations", "union"),
     "hsplit": ("cunqa.circuit.transformations", "hsplit"),
+    "transpile": ("cunqa.circuit.transformations", "transpile"),
     "to_ir": ("cunqa.circuit.ir", "to_ir"),
     "CunqaCircuit": ("cunqa.circuit.core", "CunqaCircuit"),
 }
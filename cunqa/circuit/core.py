@@ -4,6 +4,7 @@ from __future__ import annotations
 
 import numpy as np
 import copy
+import numbers
 from typing import Union, Optional
 from sympy.core.sympify import sympify, SympifyError
 
@@ -406,7 +407,10 @@ class CunqaCircuit:
 
                     return new_instr
 
-                
+                # Plain numbers are kept as they are, without the cost of sympify for each gate
+                if all(isinstance(p, numbers.Real) for p in instruction["params"]):
+                    return instruction
+
                 # Converting the string to a symbolic expression
                 try:
                     exprs = sympify(instruction["params"])
@@ -436,6 +440,47 @@ class CunqaCircuit:
                 new_instr = handle_params(instr)
                 self.instructions.append(new_instr)
                     
+    def layer(
+            self, 
+            gate: str, 
+            qubits: Optional[Union[list, np.ndarray]] = None, 
+            params: Optional[Union[list, np.ndarray]] = None
+        ) -> None:
+        """
+        Class method to apply the same gate at once over many qubits, or groups of qubits, with 
+        numeric parameters taken from an array, as the layers of variational circuits. It adds 
+        the same instructions as calling the method of the gate for each of them, without its 
+        cost per gate, so that circuits of many thousands of gates are built quickly.
+
+            >>> circuit.layer("rz", params=np.random.rand(circuit.num_qubits))
+            >>> circuit.layer("cx", qubits=[[0, 1], [2, 3]])
+
+        Args:
+            gate (str): name of the gate, as that of its method.
+            qubits (list | np.ndarray): qubits of each gate, one row per gate for the gates of several 
+                                        qubits. By default a gate on each qubit of the circuit.
+            params (list | np.ndarray): numeric parameters of each gate, one row per gate, or one 
+                                        value per gate for the gates of a single parameter. Symbolic 
+                                        parameters go through the method of the gate.
+        """
+        if not callable(getattr(CunqaCircuit, gate, None)):
+            raise ValueError(f"Unknown gate {gate}.")
+
+        qubits = np.arange(self.num_qubits) if qubits is None else np.asarray(qubits, dtype=np.int64)
+        qubits = qubits.reshape(len(qubits), -1).tolist()
+        if params is None:
+            self.instructions.extend({"name": gate, "qubits": gate_qubits} for gate_qubits in qubits)
+            return
+
+        params = np.asarray(params, dtype=np.float64)
+        if params.ndim == 0 or len(params) != len(qubits):
+            raise ValueError(f"{len(params)} sets of parameters given for {len(qubits)} gates.")
+        params = params.reshape(len(qubits), -1).tolist()
+        self.instructions.extend(
+            {"name": gate, "qubits": gate_qubits, "params": gate_params} 
+            for gate_qubits, gate_params in zip(qubits, params)
+        )
+
     def add_q_register(self, name: str, num_qubits: int):
         """
         Class method to add a quantum register to the circuit. A quantum register is understood as 
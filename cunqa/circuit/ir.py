@@ -1,12 +1,25 @@
 from __future__ import annotations
 from functools import singledispatch
+from typing import Optional
+from array import array
 import copy
+import hashlib
+import json
+import os
+import struct
+import sys
 
 from cunqa.constants import CUNQA_USE_QISKIT_PY
 from cunqa.circuit import CunqaCircuit
+from cunqa.circuit.parameter import encoder
 from cunqa.utils import generate_id
 from cunqa.logger import logger
 
+try:
+    import cunqa.qclient as _qclient
+except ImportError:
+    _qclient = None
+
 SUPPORTED_QISKIT_OPERATIONS = {
     'unitary','ryy', 'rz', 'z', 'p', 'rxx', 'rx', 'cx', 'id', 'x', 'sxdg', 'u1', 
     'ccy', 'rzz', 'rzx', 'ry', 's', 'cu', 'crz', 'ecr', 't', 'ccx', 'y', 'cswap', 
@@ -34,6 +47,129 @@ def _(c: dict) -> dict:
     return c
 
 
+# Binary layout of a quantum task, kept in sync with QuantumTask::update_from_binary_ 
+BINARY_TASK_MAGIC = b"\x00CQB"
+BINARY_TASK_VERSION = 1
+_BINARY_INSTRUCTION_KEYS = {"name", "qubits", "clbits", "params"}
+_HAS_QUBITS, _HAS_CLBITS, _HAS_PARAMS = 1, 2, 4
+_MAX_FIELD_SIZE = 0xFFFF
+
+def _pack_str(value: str) -> bytes:
+    data = value.encode()
+    return struct.pack("<I", len(data)) + data
+
+def _little_endian(values: array) -> bytes:
+    if sys.byteorder != "little":
+        values = array(values.typecode, values)
+        values.byteswap()
+    return values.tobytes()
+
+def to_binary_task(quantum_task: dict) -> Optional[bytes]:
+    """
+    Encodes a quantum task into the compact binary layout accepted by the vQPUs, avoiding the 
+    serialization and parsing of the instructions as JSON text. Instructions are stored as a 
+    fixed-layout table (name index, flags, number of qubits, clbits and parameters) followed by 
+    the flat qubit, clbit and parameter arrays.
+
+    Only instructions made of a name, qubits, clbits and numeric parameters can be encoded. If 
+    any other instruction is found (classically controlled blocks, matrices, remote gates...), 
+    ``None`` is returned and the task has to be sent as JSON.
+
+    Args:
+        quantum_task (dict): quantum task as built by :py:class:`~cunqa.qjob.QJob`.
+
+    Return:
+        Bytes with the encoded task or ``None`` if it cannot be encoded.
+    """
+    # Written in C++ when the module is built, with the same layout
+    native = getattr(_qclient, "to_binary_task", None)
+    if native is not None:
+        return native(quantum_task)
+
+    names = {}
+    table = array("H")
+    qubits, clbits, params = array("i"), array("i"), array("d")
+
+    for instruction in quantum_task["instructions"]:
+        if not _BINARY_INSTRUCTION_KEYS.issuperset(instruction):
+            return None
+
+        flags = 0
+        inst_qubits = instruction.get("qubits")
+        inst_clbits = instruction.get("clbits")
+        inst_params = instruction.get("params")
+        try:
+            if inst_qubits is not None:
+                flags |= _HAS_QUBITS
+                qubits.extend(inst_qubits)
+            if inst_clbits is not None:
+                flags |= _HAS_CLBITS
+                clbits.extend(inst_clbits)
+            if inst_params is not None:
+                flags |= _HAS_PARAMS
+                params.extend(float(param) for param in inst_params)
+        except (TypeError, ValueError, OverflowError):
+            return None # Nested or symbolic parameters
+
+        n_qubits = len(inst_qubits or [])
+        n_clbits = len(inst_clbits or [])
+        n_params = len(inst_params or [])
+        name_index = names.setdefault(instruction["name"], len(names))
+        if max(n_qubits, n_clbits, n_params, name_index) > _MAX_FIELD_SIZE:
+            return None
+
+        table.extend((name_index, flags, n_qubits, n_clbits, n_params))
+
+    header = [
+        struct.pack("<4sI", BINARY_TASK_MAGIC, BINARY_TASK_VERSION),
+        _pack_str(str(quantum_task["id"])),
+        _pack_str(json.dumps(quantum_task["config"], default=encoder)),
+        struct.pack("<BI", bool(quantum_task.get("is_dynamic", False)), len(quantum_task.get("sending_to", []))),
+        *[_pack_str(target) for target in quantum_task.get("sending_to", [])],
+        struct.pack("<I", len(names)),
+        *[_pack_str(name) for name in names],
+        struct.pack("<IIII", len(table) // 5, len(qubits), len(clbits), len(params)),
+    ]
+
+    return b"".join(header) + _little_endian(table) + _little_endian(qubits) + \
+           _little_endian(clbits) + _little_endian(params)
+
+
+def store_circuit(instructions: list[dict], directory: Optional[str] = None) -> str:
+    """
+    Writes the instructions of a circuit to the circuit store of the vQPUs, once, and returns the 
+    hash under which the quantum tasks refer to them as ``"circuit_ref"`` instead of carrying them, 
+    see `circuit_store` in :py:meth:`~cunqa.qpu.QPU.execute`. The circuit is kept in the binary 
+    layout if it fits in it, and as JSON otherwise; its file is named by the SHA-256 of that 
+    content, so a circuit already in the store is not written again.
+
+    Args:
+        instructions (list[dict]): instructions of the circuit, as in its IR.
+        directory (str): directory of the store, that of ``qraise --circuit-store``. By default, 
+                         ``CUNQA_CIRCUIT_STORE`` or else ``$STORE/.cunqa/circuits``.
+
+    Return:
+        Hexadecimal hash of the stored circuit.
+    """
+    if directory is None:
+        directory = os.getenv("CUNQA_CIRCUIT_STORE") or os.path.join(os.getenv("STORE", ""), ".cunqa", "circuits")
+
+    content = to_binary_task({"id": "", "config": {}, "instructions": instructions, "is_dynamic": False, "sending_to": []})
+    if content is None:
+        content = json.dumps(instructions, default=encoder).encode()
+    ref = hashlib.sha256(content).hexdigest()
+
+    path = os.path.join(directory, ref)
+    if not os.path.exists(path):
+        os.makedirs(directory, exist_ok=True)
+        # Written aside and renamed, so that a vQPU never maps a circuit half written
+        tmp = f"{path}.{os.getpid()}.tmp"
+        with open(tmp, "wb") as file:
+            file.write(content)
+        os.replace(tmp, path)
+    return ref
+
+
 if CUNQA_USE_QISKIT_PY:
 
     from qiskit import QuantumCircuit
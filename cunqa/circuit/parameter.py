@@ -1,5 +1,6 @@
-from sympy import Symbol
-from typing import Any
+import numpy as np
+from sympy import Symbol, Basic
+from typing import Any, Union
 
 class Param:
     """
@@ -52,6 +53,82 @@ class Param:
     def __repr__(self):
         return f"Param({self.expr!r}, {self._value!r})"
         
+# Operations of the tapes of cunqa.qclient.ParamTape, see src/utils/helpers/param_tape.hpp
+_CONST, _SYMBOL, _ADD, _MUL, _POW, _FUNC, _STORE = range(7)
+_FUNCTIONS = {
+    "sin": 0, "cos": 1, "tan": 2, "asin": 3, "acos": 4, "atan": 5, 
+    "sinh": 6, "cosh": 7, "tanh": 8, "exp": 9, "log": 10, "Abs": 11
+}
+
+
+def lower_params(params: list[Param], symbols: list[str]) -> list[tuple[int, int, float]]:
+    """
+    Tape of postfix operations that evaluates the expressions of the parameters, in their order, 
+    from the values of the free symbols, given by name in `symbols`. Raises 
+    ``NotImplementedError`` for the expressions that are not made of numbers, symbols, sums, 
+    products, powers and the elementary functions.
+    """
+    index = {name: i for i, name in enumerate(symbols)}
+    operations = []
+
+    def lower(expr):
+        if not isinstance(expr, Basic):
+            raise NotImplementedError(f"Expression {expr!r} is not symbolic.")
+        if expr.is_Symbol:
+            operations.append((_SYMBOL, index[expr.name], 0.0))
+        elif expr.is_number:
+            operations.append((_CONST, 0, float(expr)))
+        elif expr.is_Add or expr.is_Mul:
+            for arg in expr.args:
+                lower(arg)
+            operations.append((_ADD if expr.is_Add else _MUL, len(expr.args), 0.0))
+        elif expr.is_Pow:
+            lower(expr.base)
+            lower(expr.exp)
+            operations.append((_POW, 2, 0.0))
+        elif expr.func.__name__ in _FUNCTIONS and len(expr.args) == 1:
+            lower(expr.args[0])
+            operations.append((_FUNC, _FUNCTIONS[expr.func.__name__], 0.0))
+        else:
+            raise NotImplementedError(f"Expression {expr} cannot be lowered to a tape.")
+
+    for param in params:
+        lower(param.expr)
+        operations.append((_STORE, 0, 0.0))
+    return operations
+
+
+class ParamBinder:
+    """
+    Evaluates the expressions of all the parameters of a circuit at once, in C++, from the values 
+    of their free symbols, instead of substituting them symbolically one by one. The expressions 
+    are lowered once into a tape, so that binding new values in an optimization loop costs a 
+    single pass over it:
+
+        >>> binder = ParamBinder(circuit.params)
+        >>> binder.symbols
+        ['phi', 'theta']
+        >>> binder.bind({"theta": 0.1, "phi": 0.2})
+        array([0.1, 0.3])
+    """
+    symbols: list[str] # Names of the free symbols, in the order that bind takes their values
+
+    def __init__(self, params: list[Param]):
+        from cunqa.qclient import ParamTape # Compiled module, only needed once a circuit is bound
+
+        self.symbols = sorted({symbol.name for param in params for symbol in param.variables})
+        self._tape = ParamTape(lower_params(params, self.symbols), len(self.symbols))
+
+    def bind(self, values: Union[dict[str, float], np.ndarray, list[float]]) -> np.ndarray:
+        """
+        Values of the parameters, given those of the free symbols either by name or as an array 
+        in the order of :py:attr:`symbols`. Raises ``KeyError`` if a symbol is missing.
+        """
+        if isinstance(values, dict):
+            values = [values[name] for name in self.symbols]
+        return self._tape.evaluate(np.asarray(values, dtype=np.float64))
+
+
 def encoder(obj):
     if isinstance(obj, Param):
         return float(obj)
@@ -1,5 +1,6 @@
-from typing import Union
+from typing import Union, Optional
 import copy
+import json
 import numpy as np
 from itertools import accumulate
 
@@ -7,6 +8,36 @@ from cunqa.logger import logger
 from cunqa.circuit.core import CunqaCircuit
 from cunqa.constants import REMOTE_GATES
 
+try:
+    import cunqa.qclient as _qclient
+except ImportError:
+    _qclient = None
+
+def _run_native(pass_name: str, payload: Union[dict, list], *args) -> Optional[Union[dict, list]]:
+    """
+    Runs the native version of a pass over the payload serialized as JSON. None if there is no 
+    native pass or the instructions have symbolic parameters, which only the Python passes handle.
+    """
+    native = getattr(_qclient, pass_name, None)
+    if native is None:
+        return None
+    try:
+        serialized = json.dumps(payload)
+    except (TypeError, ValueError):
+        return None
+    return json.loads(native(serialized, *args))
+
+def _blocks_with_comms(circuits: list[CunqaCircuit]) -> list[str]:
+    """Which of the circuit blocks have communications, for the exception in the run method."""
+    blocks_with_comms = []
+    for circ in circuits:
+        if (circ.has_cc or circ.has_qc):
+            if len(circ.blocks_with_comms) !=0:
+                blocks_with_comms += circ.blocks_with_comms
+            else:
+                blocks_with_comms.append(circ.id)
+    return blocks_with_comms
+
 def vsplit():
     """TODO: Vertical split of a quantum circuit."""
     pass # TODO
@@ -52,6 +83,21 @@ def hsplit(circuit: CunqaCircuit, qubits_or_sections: Union[list[int], int]) ->
                          (Nsections - extras) * [Neach_section])
         initial_qubits = [0] + [int(x) for x in np.cumsum(section_sizes)]
 
+    ids = [circuit.info["id"] + f"_{i}" for i in range(Nsections)]
+    sections = _run_native("hsplit_instructions", circuit.instructions, initial_qubits, ids)
+    if sections is not None:
+        sub_circuits = []
+        for i, section in enumerate(sections):
+            sub_circuit = CunqaCircuit(initial_qubits[i + 1] - initial_qubits[i], id=ids[i])
+            if section["num_clbits"]:
+                sub_circuit.add_cl_register("subcl_0", section["num_clbits"])
+            # Their parameters are numbers, which add_instructions would leave as they are
+            sub_circuit.instructions.extend(section["instructions"])
+            if section["exposes"]:
+                sub_circuit.is_dynamic = True; sub_circuit.has_qc = True
+            sub_circuits.append(sub_circuit)
+        return sub_circuits
+
     def get_subcircuits(circuit, initial_qubits, Nsections):
         sub_circuits = []
         measures = {}
@@ -60,6 +106,8 @@ def hsplit(circuit: CunqaCircuit, qubits_or_sections: Union[list[int], int]) ->
         for i in range(Nsections):
             num_qubits_i = initial_qubits[i + 1] - initial_qubits[i]
             sub_circuits.append(CunqaCircuit(num_qubits_i, id= circuit.info["id"] + f"_{i}"))
+            clbits[i] = []
+            measures[i] = []
 
         def find_index(array, value):
             for i, elem in enumerate(array):
@@ -69,8 +117,6 @@ def hsplit(circuit: CunqaCircuit, qubits_or_sections: Union[list[int], int]) ->
         for inst in circuit.instructions[:]:
             i = find_index(initial_qubits, inst["qubits"][0])
             sub_circuit = sub_circuits[i]
-            clbits[i] = []
-            measures[i] = []
             
             if inst["name"] == "measure":
                 # Measure and clbits processing
@@ -109,8 +155,8 @@ def hsplit(circuit: CunqaCircuit, qubits_or_sections: Union[list[int], int]) ->
             else:
                 raise ValueError("Three qubits gates cannot be partitioned.")
         
-        if len(clbits):
-            for i, sub_circuit in enumerate(sub_circuits):
+        for i, sub_circuit in enumerate(sub_circuits):
+            if len(clbits[i]):
                 sub_circuit.add_cl_register(f"subcl_0", len(clbits[i]))
                 for j, measure_i, in enumerate(measures[i]):
                     measure_i["clbits"] = [clbits[i].index(clbit) for clbit in measure_i["clbits"]]
@@ -147,6 +193,21 @@ def union(circuits: list[CunqaCircuit]) -> CunqaCircuit:
         logger.warning("Not enough circuits to perform a union, returning the original circuit.")
         return circuits[0]
 
+    joined = _run_native("union_instructions", [
+        {"id": c.id, "num_qubits": c.num_qubits, "num_clbits": c.num_clbits, "instructions": c.instructions}
+        for c in circuits
+    ])
+    if joined is not None:
+        union_circuit = CunqaCircuit(
+            num_qubits=sum(c.num_qubits for c in circuits),
+            num_clbits=sum(c.num_clbits for c in circuits),
+            id="|".join(c.id for c in circuits),
+        )
+        union_circuit.is_dynamic = union_circuit.is_dynamic or joined["is_dynamic"]
+        union_circuit.blocks_with_comms = _blocks_with_comms(circuits)
+        union_circuit.instructions.extend(joined["instructions"])
+        return union_circuit
+
     circuits = copy.deepcopy(circuits) # avoid aliasing
 
     qubit_offsets = [0] + list(accumulate(c.num_qubits for c in circuits[:-1]))
@@ -270,15 +331,7 @@ def union(circuits: list[CunqaCircuit]) -> CunqaCircuit:
             if consumed:
                 advance(idx)
 
-    # Store which of the circuit blocks have communications for exception in run method
-    blocks_with_comms = []
-    for circ in circuits:
-        if (circ.has_cc or circ.has_qc):
-            if len(circ.blocks_with_comms) !=0:
-                blocks_with_comms += circ.blocks_with_comms
-            else:
-                blocks_with_comms.append(circ.id)
-    union_circuit.blocks_with_comms = blocks_with_comms
+    union_circuit.blocks_with_comms = _blocks_with_comms(circuits)
 
     union_circuit.add_instructions(union_instructions)
     return union_circuit
@@ -303,6 +356,17 @@ def add(circuits: list[CunqaCircuit]) -> CunqaCircuit:
         logger.warning("Not enough circuits to perform an addition, returning the original circuit.")
         return circuits[0]
 
+    added = _run_native("add_instructions", [{"id": c.id, "instructions": c.instructions} for c in circuits])
+    if added is not None:
+        addition_circuit = CunqaCircuit(
+            num_qubits=max(c.num_qubits for c in circuits),
+            num_clbits=max(c.num_clbits for c in circuits),
+            id="+".join(c.id for c in circuits),
+        )
+        addition_circuit.blocks_with_comms = _blocks_with_comms(circuits)
+        addition_circuit.instructions.extend(added)
+        return addition_circuit
+
     circuits = copy.deepcopy(circuits)
     circuit_ids = {c.id for c in circuits}
 
@@ -322,16 +386,61 @@ def add(circuits: list[CunqaCircuit]) -> CunqaCircuit:
                         raise ValueError("Cannot add two circuits that communicate with eachother.")
             addition_instructions.append(instr)
 
-    # Store which of the circuit blocks have communications for exception in run method
-    blocks_with_comms = []
-    for circ in circuits:
-        if (circ.has_cc or circ.has_qc):
-            if len(circ.blocks_with_comms) !=0:
-                blocks_with_comms += circ.blocks_with_comms
-            else:
-                blocks_with_comms.append(circ.id)
-    addition_circuit.blocks_with_comms = blocks_with_comms
+    addition_circuit.blocks_with_comms = _blocks_with_comms(circuits)
 
     addition_circuit.add_instructions(addition_instructions)
     return addition_circuit        
 
+
+
+def transpile(
+    circuit: CunqaCircuit,
+    backend: Union[dict, "QPU"],
+    initial_layout: Optional[list[int]] = None,
+    seed: int = 0
+) -> CunqaCircuit:
+    """
+    Translates a circuit into the basis gates of a backend and routes it onto its coupling map, 
+    natively and without Qiskit. The gates outside the basis are decomposed, the two-qubit gates 
+    between qubits that are not coupled are preceded by the SWAPs that SABRE chooses, and the 
+    chains of single-qubit gates are resynthesized into the rotations of the basis. The qubits of 
+    the result are the physical qubits of the backend, ``initial_layout[i]`` for the qubit ``i`` 
+    if given. The vQPUs run the same pass on the circuits sent with ``transpile=True``. The 
+    layout and swaps of the last circuits are kept, so a circuit with the same gates on the same 
+    qubits, as those of a variational loop, is not routed again.
+
+        >>> transpiled = transpile(circuit, qpu)
+
+    Args:
+        circuit (~cunqa.circuit.core.CunqaCircuit): circuit to transpile, with its parameters 
+                                                    assigned.
+        backend (~cunqa.qpu.Backend | ~cunqa.qpu.QPU): backend, or QPU of the backend, whose 
+                                                       ``basis_gates``, ``coupling_map`` and 
+                                                       ``n_qubits`` it targets.
+        initial_layout (list[int]): physical qubit of each qubit, chosen by SABRE if None.
+        seed (int): seed of the random layouts that SABRE tries.
+    """
+    backend = getattr(backend, "backend", backend)
+    transpiled = _run_native(
+        "transpile_instructions",
+        circuit.instructions,
+        list(backend.get("basis_gates", [])),
+        [list(edge) for edge in backend.get("coupling_map", [])],
+        circuit.num_qubits,
+        backend.get("n_qubits", 0),
+        list(initial_layout or []),
+        seed
+    )
+    if transpiled is None:
+        raise ValueError("Only circuits with their parameters assigned are transpiled, and with the "
+                         "native module of cunqa installed.")
+
+    transpiled_circuit = CunqaCircuit(
+        transpiled["num_qubits"],
+        circuit.num_clbits,
+        id=circuit.id + "_transpiled"
+    )
+    transpiled_circuit.instructions.extend(transpiled["instructions"])
+    transpiled_circuit.is_dynamic = circuit.is_dynamic
+    logger.debug(f"Circuit {circuit.id} transpiled with {transpiled['report']['swaps']} swaps.")
+    return transpiled_circuit
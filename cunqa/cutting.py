@@ -0,0 +1,422 @@
+"""
+    Runs circuits wider than the vQPUs of a family by cutting them into fragments.
+
+    **Circuit cutting** [#]_ replaces the gates and wires that join groups of qubits with sums of
+    local operations, so that each group, a *fragment*, is simulated on its own as a set of
+    smaller circuits, its *variants*. The distribution of the whole circuit is recovered afterwards
+    from the counts of all the variants, without communications between the vQPUs, so a circuit
+    of 40 qubits can run as fragments of up to 30 on simple vQPUs:
+
+    .. code-block:: python
+
+        >>> plan = plan_cuts(circuit, max_qubits=30)
+        >>> plan.num_fragments, plan.num_cuts, len(plan.variants())
+        (2, 1, 10)
+        >>> probs = cut_run(circuit, get_QPUs(), max_qubits=30, shots=10000, clbits=[0, 1, 39])
+
+    - :py:func:`plan_cuts` assigns the qubits to fragments, contiguous groups by default, and cuts
+      the two-qubit gates between them. The controlled phases and :math:`ZZ` rotations (``cx``,
+      ``cz``, ``cp``, ``cu1``, ``crz`` and ``rzz``) are cut as gates, in six terms; any other gate
+      across fragments moves its qubits into one of them with a wire cut, in four terms, as long as
+      that fragment keeps within the width.
+
+    - :py:class:`CutPlan` builds the variants and reconstructs from their results the
+      distribution of all the classical bits, or the marginal of some of them, a tensor
+      contraction done in parallel in C++.
+
+    - :py:func:`cut_run` does both, sending the variants to the least loaded vQPUs.
+
+    The variants grow exponentially with the cuts, 5 per side of a gate cut and 3 or 4 per side of
+    a wire cut, and so does the sampling overhead. Only circuits measured at the end, without
+    classical control, communications or symbolic parameters, are cut.
+
+    *References*:
+
+    .. [#] `Constructing a virtual two-qubit gate by sampling single-qubit operations
+       <https://arxiv.org/abs/2007.10917>`_ and `Simulating large quantum circuits on a small
+       quantum computer <https://arxiv.org/abs/1904.00102>`_.
+"""
+import math
+import itertools
+import numbers
+from typing import Optional, Union, Any
+
+import numpy as np
+
+from cunqa.logger import logger
+from cunqa.constants import REMOTE_GATES
+from cunqa.circuit import CunqaCircuit, to_ir
+from cunqa.qpu import QPU, run
+from cunqa.qjob import gather
+from cunqa.result import Result
+from cunqa.counts_and_probs import fold_cut_counts, reconstruct_cut_probs # Implemented on C++ for speed
+
+
+# Gates cut as exp(i theta Z Z), with the local gates before and after it: (theta, pre, post)
+def _zz_form(name: str, qubits: list[int], params: list[float]):
+    control, target = qubits
+    if name == "cz":
+        return math.pi / 4, [], [("s", control, []), ("s", target, [])]
+    if name == "cx":
+        return (math.pi / 4, [("h", target, [])],
+                [("s", control, []), ("s", target, []), ("h", target, [])])
+    if name in ("cp", "cu1"):
+        return params[0] / 4, [], [("rz", control, [params[0] / 2]), ("rz", target, [params[0] / 2])]
+    if name == "crz":
+        return params[0] / 4, [], [("rz", target, [params[0] / 2])]
+    if name == "rzz":
+        return -params[0] / 2, [], []
+    return None
+
+_GATE_CUTS = {"cx", "cz", "cp", "cu1", "crz", "rzz"}
+
+# Operations that cannot be cut, besides those with classical bits
+_NOT_CUT = {"reset", "save_state", "cif", "copy", *REMOTE_GATES}
+
+# Local operations of each choice of a cut site, and the choices and signs of each of its labels.
+# The measuring choices write a sign bit, by whose parity the counts are weighed when signed.
+#
+# Wire cut, labels I, X, Y, Z: the upstream side measures in the basis of the label and the
+# downstream one prepares the states whose combination is the Pauli of the label
+_WIRE_UP = [[], [("h", [])], [("sdg", []), ("h", [])]]
+_WIRE_UP_LABELS = [[(0, 1.0, False)], [(1, 1.0, True)], [(2, 1.0, True)], [(0, 1.0, True)]]
+_WIRE_DOWN = [[], [("x", [])], [("h", [])], [("h", []), ("s", [])]]
+_WIRE_DOWN_LABELS = [[(0, 1.0, False), (1, 1.0, False)],
+                     [(2, 2.0, False), (0, -1.0, False), (1, -1.0, False)],
+                     [(3, 2.0, False), (0, -1.0, False), (1, -1.0, False)],
+                     [(0, 1.0, False), (1, -1.0, False)]]
+# Gate cut of exp(i theta Z Z), labels of coefficients c^2, s^2, cs, -cs, cs, -cs: choices I, Z, S,
+# Sdg and the measurement of Z
+_GATE_SIDE = [[], [("z", [])], [("s", [])], [("sdg", [])], None]
+_GATE_A_LABELS = [[(0, 1.0, False)], [(1, 1.0, False)], [(4, 1.0, True)], [(4, 1.0, True)],
+                  [(3, 1.0, False)], [(2, 1.0, False)]]
+_GATE_B_LABELS = [[(0, 1.0, False)], [(1, 1.0, False)], [(3, 1.0, False)], [(2, 1.0, False)],
+                  [(4, 1.0, True)], [(4, 1.0, True)]]
+
+_SITES = {
+    "wire_up": (_WIRE_UP, _WIRE_UP_LABELS, True),
+    "wire_down": (_WIRE_DOWN, _WIRE_DOWN_LABELS, False),
+    "gate_a": (_GATE_SIDE, _GATE_A_LABELS, True),
+    "gate_b": (_GATE_SIDE, _GATE_B_LABELS, True),
+}
+
+
+class _Fragment:
+    def __init__(self):
+        self.num_slots = 0
+        self.ops = [] # ("gate", instruction) or ("site", site index)
+        self.outputs = [] # (clbit of the circuit, slot)
+        self.sites = [] # (kind, cut, slot)
+
+    @property
+    def num_clbits(self) -> int:
+        return len(self.outputs) + sum(1 for kind, _, _ in self.sites if _SITES[kind][2])
+
+    def sign_clbit(self, site: int) -> int:
+        return len(self.outputs) + sum(1 for kind, _, _ in self.sites[:site] if _SITES[kind][2])
+
+    @property
+    def num_variants(self) -> int:
+        return math.prod(len(_SITES[kind][0]) for kind, _, _ in self.sites)
+
+    def choices(self, variant: int) -> list[int]:
+        choices = []
+        for kind, _, _ in self.sites:
+            variant, choice = divmod(variant, len(_SITES[kind][0]))
+            choices.append(choice)
+        return choices
+
+    def variant_index(self, choices: list[int]) -> int:
+        index = 0
+        for (kind, _, _), choice in zip(reversed(self.sites), reversed(choices)):
+            index = index * len(_SITES[kind][0]) + choice
+        return index
+
+    def circuit(self, variant: int) -> CunqaCircuit:
+        choices = self.choices(variant)
+        circuit = CunqaCircuit(self.num_slots, max(self.num_clbits, 1))
+        instructions = []
+        for op, value in self.ops:
+            if op == "gate":
+                instructions.append(value)
+                continue
+            kind, _, slot = self.sites[value]
+            local = _SITES[kind][0][choices[value]]
+            if local is None:
+                circuit.is_dynamic = True
+                local = []
+            instructions.extend({"name": name, "qubits": [slot], "params": params}
+                                for name, params in local)
+            if kind == "wire_up" or (kind.startswith("gate") and choices[value] == 4):
+                instructions.append({"name": "measure", "qubits": [slot],
+                                     "clbits": [self.sign_clbit(value)]})
+        instructions.extend({"name": "measure", "qubits": [slot], "clbits": [position]}
+                            for position, (_, slot) in enumerate(self.outputs))
+        circuit.add_instructions([instr if instr.get("params") else
+                                  {k: v for k, v in instr.items() if k != "params"}
+                                  for instr in instructions])
+        return circuit
+
+
+class CutPlan:
+    """
+    Fragments and cuts of a circuit, as planned by :py:func:`plan_cuts`. Its variants are run
+    with the same number of shots each, and their results given back in the same order to
+    :py:meth:`reconstruct`.
+    """
+    num_clbits: int #: Number of classical bits of the cut circuit.
+    coefficients: list[list[float]] #: Coefficients of the labels of each cut.
+
+    def __init__(self, fragments: list[_Fragment], coefficients: list[list[float]], num_clbits: int):
+        self._fragments = fragments
+        self.coefficients = coefficients
+        self.num_clbits = num_clbits
+
+    @property
+    def num_fragments(self) -> int:
+        """Number of fragments."""
+        return len(self._fragments)
+
+    @property
+    def num_cuts(self) -> int:
+        """Number of wire and gate cuts."""
+        return len(self.coefficients)
+
+    @property
+    def fragment_qubits(self) -> list[int]:
+        """Number of qubits of each fragment, which includes those moved into it by wire cuts."""
+        return [fragment.num_slots for fragment in self._fragments]
+
+    @property
+    def num_variants(self) -> int:
+        """Number of circuits that :py:meth:`variants` gives."""
+        return sum(fragment.num_variants for fragment in self._fragments)
+
+    def variants(self) -> list[CunqaCircuit]:
+        """
+        Circuits to run, the variants of the first fragment followed by those of the next ones.
+        """
+        return [fragment.circuit(variant)
+                for fragment in self._fragments for variant in range(fragment.num_variants)]
+
+    def reconstruct(self, results: list[Result], clbits: Optional[list[int]] = None) -> np.ndarray:
+        """
+        Probabilities of the outcomes of the cut circuit, estimated from the results of its
+        variants. Bit ``j`` of the index of the array is the classical bit ``clbits[j]`` of the
+        circuit, so the marginal of a few of them is reconstructed without the cost of the whole
+        distribution. The estimates may be slightly negative, from the finite shots.
+
+        Args:
+            results (list[~cunqa.result.Result]): results of the circuits of :py:meth:`variants`,
+                                                  in the same order.
+            clbits (list[int]): classical bits of the distribution, all of them by default.
+
+        Return:
+            Array of ``2 ** len(clbits)`` probabilities.
+        """
+        if len(results) != self.num_variants:
+            raise ValueError(f"The plan has {self.num_variants} variants, but {len(results)} "
+                             f"results were given.")
+        clbits = list(range(self.num_clbits)) if clbits is None else list(clbits)
+        measured = {clbit for fragment in self._fragments for clbit, _ in fragment.outputs}
+        if len(set(clbits)) != len(clbits) or not set(clbits) <= measured:
+            raise ValueError(f"The classical bits {clbits} are repeated or not measured in the "
+                             f"circuit.")
+        position = {clbit: j for j, clbit in enumerate(clbits)}
+
+        tensors, cuts, output_bits = [], [], []
+        first = 0
+        for fragment in self._fragments:
+            counts = [_counts_arrays(result) for result in results[first:first + fragment.num_variants]]
+            first += fragment.num_variants
+
+            kept = [(local, position[clbit]) for local, (clbit, _) in enumerate(fragment.outputs)
+                    if clbit in position]
+            local_bits = [local for local, _ in kept]
+            folded = {}
+            def fold(choices, signs):
+                key = (tuple(choices), signs)
+                if key not in folded:
+                    outcomes, values = counts[fragment.variant_index(choices)]
+                    folded[key] = fold_cut_counts(outcomes, values, local_bits, list(signs))
+                return folded[key]
+
+            # The label of the first site is the fastest index of the entries
+            site_labels = [range(len(_SITES[kind][1])) for kind, _, _ in fragment.sites]
+            entries = []
+            for labels in itertools.product(*reversed(site_labels)):
+                labels = labels[::-1]
+                entry = np.zeros(1 << len(local_bits))
+                terms = [_SITES[kind][1][label] for (kind, _, _), label in zip(fragment.sites, labels)]
+                for combination in itertools.product(*terms):
+                    weight = math.prod(w for _, w, _ in combination)
+                    signs = tuple(fragment.sign_clbit(site)
+                                  for site, (_, _, signed) in enumerate(combination) if signed)
+                    entry += weight * fold([choice for choice, _, _ in combination], signs)
+                entries.append(entry)
+
+            tensors.append(np.concatenate(entries))
+            cuts.append([cut for _, cut, _ in fragment.sites])
+            output_bits.append([bit for _, bit in kept])
+
+        return reconstruct_cut_probs(tensors, cuts, output_bits, self.coefficients, len(clbits))
+
+
+def _counts_arrays(result: Result) -> tuple[np.ndarray, np.ndarray]:
+    arrays = result.counts_arrays
+    if arrays is not None:
+        return arrays
+    counts = result.counts
+    outcomes = np.array([int(bitstring.replace(" ", ""), 2) for bitstring in counts], dtype=np.uint64)
+    return outcomes, np.array(list(counts.values()), dtype=np.uint64)
+
+
+def plan_cuts(
+        circuit: Union[dict, CunqaCircuit, 'QuantumCircuit'],
+        max_qubits: int,
+        sections: Optional[list[list[int]]] = None
+    ) -> CutPlan:
+    """
+    Cuts a circuit into fragments of at most ``max_qubits`` qubits each.
+
+    Args:
+        circuit (dict | ~cunqa.circuit.core.CunqaCircuit | ~qiskit.QuantumCircuit): circuit to cut,
+                                                                                     measured at the end.
+        max_qubits (int): qubits of the largest fragment, those of the vQPUs that run them.
+        sections (list[list[int]]): qubits of each fragment, which may take more of them through
+                                    wire cuts. By default, the fewest contiguous groups of qubits
+                                    of similar size.
+
+    Return:
+        The :py:class:`CutPlan` of the circuit.
+    """
+    circuit_ir = to_ir(circuit)
+    num_qubits = circuit_ir["num_qubits"]
+    if max_qubits < 1:
+        raise ValueError(f"Fragments need at least one qubit, not {max_qubits}.")
+
+    if sections is None:
+        num_sections = max(1, math.ceil(num_qubits / max_qubits))
+        bounds = [round(i * num_qubits / num_sections) for i in range(num_sections + 1)]
+        sections = [list(range(lo, hi)) for lo, hi in zip(bounds, bounds[1:])]
+    if sorted(q for section in sections for q in section) != list(range(num_qubits)):
+        raise ValueError("The sections do not hold each qubit of the circuit once.")
+    if any(len(section) > max_qubits for section in sections):
+        raise ValueError(f"A section has more than {max_qubits} qubits.")
+
+    fragments = [_Fragment() for _ in sections]
+    place = {}
+    for f, section in enumerate(sections):
+        for q in section:
+            place[q] = (f, fragments[f].num_slots)
+            fragments[f].num_slots += 1
+
+    coefficients = []
+    measured_qubits, measured_clbits = set(), set()
+    for instr in circuit_ir["instructions"]:
+        name, qubits = instr["name"], instr.get("qubits", [])
+        if name == "barrier":
+            continue
+        if measured_qubits.intersection(qubits):
+            raise ValueError("Only circuits measured at the end are cut, there are operations after "
+                             "a measurement.")
+        if name == "measure":
+            clbit = instr["clbits"][0]
+            if clbit in measured_clbits:
+                raise ValueError(f"Classical bit {clbit} is measured more than once.")
+            measured_qubits.add(qubits[0]); measured_clbits.add(clbit)
+            f, slot = place[qubits[0]]
+            fragments[f].outputs.append((clbit, slot))
+            continue
+        if name in _NOT_CUT or instr.get("clbits"):
+            raise ValueError(f"Operation {name} cannot be cut, only unitary gates and final "
+                             f"measurements are.")
+        params = instr.get("params", [])
+        if not all(isinstance(p, numbers.Real) for p in params):
+            raise ValueError("Circuits with symbolic parameters are cut once they are assigned.")
+
+        owners = {place[q][0] for q in qubits}
+        if len(owners) > 1 and name in _GATE_CUTS:
+            theta, pre, post = _zz_form(name, qubits, params)
+            cut = len(coefficients)
+            c, s = math.cos(theta), math.sin(theta)
+            coefficients.append([c * c, s * s, c * s, -c * s, c * s, -c * s])
+            for gate, q, gate_params in pre:
+                _append_gate(fragments, place, gate, [q], gate_params)
+            for q, kind in zip(qubits, ("gate_a", "gate_b")):
+                f, slot = place[q]
+                fragments[f].ops.append(("site", len(fragments[f].sites)))
+                fragments[f].sites.append((kind, cut, slot))
+            for gate, q, gate_params in post:
+                _append_gate(fragments, place, gate, [q], gate_params)
+            continue
+
+        if len(owners) > 1:
+            # Into the fragment holding most of its qubits that has room for the rest
+            held = {f: sum(place[q][0] == f for q in qubits) for f in owners}
+            room = [f for f in sorted(owners, key=lambda f: -held[f])
+                    if fragments[f].num_slots + len(qubits) - held[f] <= max_qubits]
+            if not room:
+                raise ValueError(f"Gate {name} on qubits {qubits} cannot be cut: no fragment has "
+                                 f"room for its qubits.")
+            target = room[0]
+            for q in qubits:
+                f, slot = place[q]
+                if f == target:
+                    continue
+                cut = len(coefficients)
+                coefficients.append([0.5] * 4)
+                fragments[f].ops.append(("site", len(fragments[f].sites)))
+                fragments[f].sites.append(("wire_up", cut, slot))
+                new_slot = fragments[target].num_slots
+                fragments[target].num_slots += 1
+                fragments[target].ops.append(("site", len(fragments[target].sites)))
+                fragments[target].sites.append(("wire_down", cut, new_slot))
+                place[q] = (target, new_slot)
+
+        _append_gate(fragments, place, name, qubits, params, instr)
+
+    # Fragments left without outputs or cuts do not change the distribution
+    fragments = [fragment for fragment in fragments if fragment.outputs or fragment.sites]
+    plan = CutPlan(fragments, coefficients, circuit_ir.get("num_clbits", 0))
+    logger.debug(f"Circuit cut into {plan.num_fragments} fragments of {plan.fragment_qubits} "
+                 f"qubits with {plan.num_cuts} cuts, {plan.num_variants} variants.")
+    return plan
+
+
+def _append_gate(fragments, place, name, qubits, params, instr: Optional[dict] = None):
+    f = place[qubits[0]][0]
+    new_instr = dict(instr) if instr is not None else {"name": name, "params": params}
+    new_instr["qubits"] = [place[q][1] for q in qubits]
+    fragments[f].ops.append(("gate", new_instr))
+
+
+def cut_run(
+        circuit: Union[dict, CunqaCircuit, 'QuantumCircuit'],
+        qpus: list[QPU],
+        max_qubits: int,
+        clbits: Optional[list[int]] = None,
+        sections: Optional[list[list[int]]] = None,
+        **run_args: Any
+    ) -> np.ndarray:
+    """
+    Cuts a circuit with :py:func:`plan_cuts`, runs its variants on the least loaded of the given
+    vQPUs and reconstructs its distribution, or the marginal of ``clbits``, with
+    :py:meth:`CutPlan.reconstruct`.
+
+    Args:
+        circuit (dict | ~cunqa.circuit.core.CunqaCircuit | ~qiskit.QuantumCircuit): circuit to run.
+        qpus (list[~cunqa.qpu.QPU]): vQPUs of at least ``max_qubits`` qubits, without communications.
+        max_qubits (int): qubits of the largest fragment.
+        clbits (list[int]): classical bits of the distribution, all of them by default.
+        sections (list[list[int]]): qubits of each fragment, see :py:func:`plan_cuts`.
+        run_args: run parameters of the variants, such as ``shots``.
+
+    Return:
+        Array of ``2 ** len(clbits)`` probabilities.
+    """
+    plan = plan_cuts(circuit, max_qubits, sections)
+    qjobs = run(plan.variants(), qpus, dispatch="least_loaded", **run_args)
+    if not isinstance(qjobs, list):
+        qjobs = [qjobs]
+    return plan.reconstruct(gather(qjobs), clbits)
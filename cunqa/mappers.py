@@ -42,7 +42,7 @@
 from cunqa.logger import logger
 from cunqa.qjob import gather
 from cunqa.circuit import CunqaCircuit
-from cunqa.qpu import QPU, run
+from cunqa.qpu import QPU, run, least_loaded
 from cunqa.qjob import QJob
 
 from qiskit import QuantumCircuit
@@ -112,6 +112,17 @@ class QJobMapper:
             List of outputs of the function applied to the results of each job for the given 
             population.
         """
+        if len(population) > len(self.qjobs):
+            # Each job evaluates its share of the population in a single request
+            n_qjobs = len(self.qjobs)
+            for i, qjob in enumerate(self.qjobs):
+                qjob.upgrade_parameters_batch([list(params) for params in population[i::n_qjobs]])
+
+            results = [None] * len(population)
+            for i, qjob in enumerate(self.qjobs):
+                results[i::n_qjobs] = qjob.result_batch
+            return [func(result) for result in results]
+
         qjobs_ = []
         for qjob, params in zip(self.qjobs, population):
             qjob.upgrade_parameters(list(params))
@@ -134,7 +145,8 @@ class QPUCircuitMapper:
     for the provided function *func* for the result of each simulation.
 
     Its use is pretty similar to :py:class:`~cunqa.mappers.QJobMapper`, though creating 
-    :py:class:`~cunqa.qjob.QJob` objects ahead is not needed.
+    :py:class:`~cunqa.qjob.QJob` objects ahead is not needed. Each member of the population goes 
+    to the vQPU expected to finish it first, see :py:func:`~cunqa.qpu.least_loaded`.
 
     >>> qpus = get_QPUs(...)
     >>>
@@ -222,8 +234,7 @@ class QPUCircuitMapper:
         qjobs = []
         if isinstance(self.circuit, QuantumCircuit):
             try:
-                for i, params in enumerate(population):
-                    qpu = self.qpus[i % len(self.qpus)]
+                for params, qpu in zip(population, least_loaded(self.qpus, len(population))):
                     circuit_assembled = self.circuit.assign_parameters(params)
                     qjobs.append(run(circuit_assembled, qpu, **self.run_parameters))
                 results = gather(qjobs)
@@ -232,13 +243,18 @@ class QPUCircuitMapper:
                 raise RuntimeError(f"Error while assigning parameters to Qiskit's QuantumCircuit: {error}.")
         elif isinstance(self.circuit, CunqaCircuit):
             try:
-                for i, params in enumerate(population):
-                    qpu = self.qpus[i % len(self.qpus)]
-                    if not isinstance(params, list):
-                        try:
-                            params = params.tolist()
-                        except Exception as error:
-                            raise RuntimeError(f"Cannot convert {type(params)} to list.")
+                population = [params if isinstance(params, list) else params.tolist() 
+                              for params in population]
+            except Exception as error:
+                raise RuntimeError(f"Error while assigning parameters to CUNQA's CunqaCircuit: "
+                                   f"Cannot convert population members to list ({error}).")
+
+            # More members than QPUs: each QPU evaluates its share in a single request
+            if len(population) > len(self.qpus):
+                return [func(result) for result in self._run_batches(population)]
+
+            try:
+                for params, qpu in zip(population, least_loaded(self.qpus, len(population))):
                     qjobs.append(run(self.circuit, qpu, params, **self.run_parameters))
                 results = gather(qjobs)
                 return [func(result) for result in results]
@@ -246,3 +262,28 @@ class QPUCircuitMapper:
                 raise RuntimeError(f"Error while assigning parameters to CUNQA's CunqaCircuit: {error}.")
         else:
             raise RuntimeError(f"QPUCircuitMapper does not support circuit {type(self.circuit)}.")
+
+    def _run_batches(self, population):
+        """
+        Sends the circuit once to each QPU with the first member of its share of the population, 
+        and the rest of the share as a single batch of parameters.
+        """
+        n_qpus = len(self.qpus)
+        try:
+            qjobs = [
+                run(self.circuit, qpu, population[i], **self.run_parameters) 
+                for i, qpu in enumerate(self.qpus)
+            ]
+            results = [None] * len(population)
+            results[:n_qpus] = gather(qjobs)
+
+            shares = [population[i + n_qpus::n_qpus] for i in range(n_qpus)]
+            for qjob, share in zip(qjobs, shares):
+                if share:
+                    qjob.upgrade_parameters_batch(share)
+            for i, (qjob, share) in enumerate(zip(qjobs, shares)):
+                if share:
+                    results[i + n_qpus::n_qpus] = qjob.result_batch
+            return results
+        except Exception as error:
+            raise RuntimeError(f"Error while assigning parameters to CUNQA's CunqaCircuit: {error}.")
@@ -116,6 +116,16 @@ def probabilities(
 
         # State not available: estimate probabilities from count frequencies
         else: 
+            # Counts sent in binary are used as they are, without building their bit strings
+            if result._binary_counts is not None and len(result._registers) <= 1:
+                outcomes, counts, num_qubits = result._binary_counts
+                probs = counts_to_probs(outcomes, counts, num_qubits)
+
+                if (per_qubit or partial is not None):
+                    probs = recombine_probs(probs, per_qubit, partial, num_qubits= num_qubits)
+
+                return probs
+
             logger.debug(f"Estimating probabilities from the available counts. First ten counts: "
                          f"{ {k: result.counts[k] for k in list(result.counts.keys())[:10]} }")
             
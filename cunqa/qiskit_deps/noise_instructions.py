@@ -2,12 +2,12 @@ import os, sys
 import glob
 import argparse
 import json
-import fcntl
 
 # Append to path to access CUNQA installation 
 sys.path.append(os.getenv("HOME"))
 
 from cunqa.logger import logger
+from cunqa.constants import CUNQA_PATH
 from cunqa.qiskit_deps.cunqabackend import CunqaBackend
 from qiskit_aer.noise import NoiseModel
 
@@ -25,6 +25,7 @@ def create_parser():
     parser.add_argument("gate_error", type=int, help="Whether gate error is added")
     parser.add_argument("family_name", type=str, help="Family name for QPUs")
     parser.add_argument("fakeqmio", type=int, help="FakeQmio noise properties provided")
+    parser.add_argument("--output", type=str, default=None, help="Path of the generated backend file")
     
     return parser
 
@@ -163,22 +164,21 @@ def prepare_backend_json(backend, args, noise_model, noise_properties_path):
 
 def write_backend_json(backend_json, tmp_file):
     """
-    Write backend JSON to a temporary file with file locking.
+    Write backend JSON to a file, through a temporary one renamed when complete, so that it is 
+    never read half written.
     
     Args:
         backend_json (dict): Backend configuration JSON
-        tmp_file (str): Path to temporary file
+        tmp_file (str): Path to the file
     """
     os.makedirs(os.path.dirname(tmp_file), exist_ok=True)
     
-    with open(tmp_file, 'w') as file:
-        fcntl.flock(file.fileno(), fcntl.LOCK_EX)
-        try:
-            json.dump(backend_json, file, indent=2)
-            file.flush()
-            os.fsync(file.fileno())
-        finally:
-            fcntl.flock(file.fileno(), fcntl.LOCK_UN)
+    partial_file = f"{tmp_file}.{os.getpid()}.partial"
+    with open(partial_file, 'w') as file:
+        json.dump(backend_json, file)
+        file.flush()
+        os.fsync(file.fileno())
+    os.replace(partial_file, tmp_file)
 
 def main(args=None):
     """
@@ -230,9 +230,9 @@ def main(args=None):
             args.noise_properties_path
         )
         
-        # Generate temporary file path
+        # Generate temporary file path, unless the vQPUs give the path of their cache
         slurm_job_id = os.getenv("SLURM_JOB_ID", "unknown")
-        tmp_file = os.path.join(CUNQA_PATH, f"tmp_noisy_backend_{slurm_job_id}.json")
+        tmp_file = args.output or os.path.join(CUNQA_PATH, f"tmp_noisy_backend_{slurm_job_id}.json")
         backend_json["noise_path"] = tmp_file
         
         # Write backend JSON
@@ -12,9 +12,11 @@
         - When submmiting the circuit, set `transpile` as ``True`` and provide the rest of 
           transpilation instructions:
 
-            >>> qpu.run(circuit, transpile = True, ...)
+            >>> qpu.run(circuit, transpile = True, initial_layout = [0, 2], seed = 1, ...)
 
-          This option is ``False`` by default.
+          This option is ``False`` by default. The vQPU then transpiles the circuit natively, 
+          without Qiskit, as :py:func:`~cunqa.circuit.transformations.transpile` does on the 
+          client.
 
         - Use :py:func:`transpiler` function before sending the circuit:
 
@@ -26,8 +28,10 @@
         will not be coherent.
     
 """
-from typing import Union
+from typing import Union, Optional
+from collections import OrderedDict
 import copy
+import json
 
 from cunqa.qiskit_deps.cunqabackend import CunqaBackend
 from cunqa.logger import logger
@@ -40,6 +44,7 @@ from qiskit_aer.library import default_qubits
 from qiskit import QuantumCircuit, transpile
 from qiskit.transpiler import TranspilerError
 from qiskit.circuit import (
+    ControlFlowOp,
     QuantumRegister, 
     ClassicalRegister, 
     CircuitInstruction, 
@@ -68,6 +73,11 @@ def transpiler(
     `qiskit.transpiler.compiler.transpile <https://quantum.cloud.ibm.com/docs/api/qiskit/1.2/compiler#qiskit.compiler.transpile>`_,
     since it is used in the process.
 
+    The circuit is transpiled with a parameter in place of each of its numeric ones, and kept 
+    as a template for the backend, so that a circuit of the same gates on the same qubits, as 
+    those of a variational loop, only has its parameters bound to the template. Not for 
+    circuits with classical control, matrices or symbolic parameters, transpiled every time.
+
     Args:
         circuit (dict | qiskit.QuantumCircuit | ~cunqa.circuit.CunqaCircuit): circuit to be 
                                                                               transpiled.
@@ -116,14 +126,37 @@ def transpiler(
     # transpilation
     try:
         backend = backend.backend if isinstance(backend, QPU) else backend
-        cunqabackend = CunqaBackend(backend = backend)
-        qc_transpiled = transpile(
-            qc, 
-            cunqabackend, 
-            initial_layout=initial_layout, 
-            optimization_level=opt_level, 
-            seed_transpiler=seed
-        )
+        key = _template_key(qc, backend, opt_level, initial_layout, seed)
+        if key is None:
+            qc_transpiled = transpile(
+                qc, 
+                CunqaBackend(backend = backend), 
+                initial_layout=initial_layout, 
+                optimization_level=opt_level, 
+                seed_transpiler=seed
+            )
+        else:
+            if key in _transpiled_templates:
+                _transpiled_templates.move_to_end(key)
+                logger.debug("Transpiled template of the circuit reused.")
+            else:
+                template, template_parameters = _parametrized(qc)
+                _transpiled_templates[key] = (transpile(
+                    template, 
+                    CunqaBackend(backend = backend), 
+                    initial_layout=initial_layout, 
+                    optimization_level=opt_level, 
+                    seed_transpiler=seed
+                ), template_parameters)
+                if len(_transpiled_templates) > _TEMPLATE_CACHE_SIZE:
+                    _transpiled_templates.popitem(last=False)
+            transpiled_template, parameters = _transpiled_templates[key]
+            values = [value for instruction in qc.data for value in instruction.operation.params]
+            # The optimization may have dropped some of them with their gates
+            qc_transpiled = transpiled_template.assign_parameters({
+                parameter: value for parameter, value in zip(parameters, values) 
+                if parameter in transpiled_template.parameters
+            })
     
     except TranspilerError as error:
         logger.error(f"Some error occured with transpilation.")
@@ -159,6 +192,62 @@ def transpiler(
 
 
 
+# Transpiled templates of the last circuits, by their structure and target
+_TEMPLATE_CACHE_SIZE = 32
+_transpiled_templates: "OrderedDict[tuple, tuple[QuantumCircuit, list[Parameter]]]" = OrderedDict()
+
+
+def _template_key(
+    qc: QuantumCircuit, 
+    backend: Backend, 
+    opt_level: int, 
+    initial_layout: Optional[list[int]], 
+    seed: Optional[int]
+) -> Optional[tuple]:
+    """
+    Key of the transpiled template of a circuit: its gates and their qubits and clbits, but not 
+    the values of their parameters, with the backend and the transpilation instructions. None 
+    for the circuits that cannot be templates.
+    """
+    structure = []
+    for instruction in qc.data:
+        operation = instruction.operation
+        if isinstance(operation, ControlFlowOp) or getattr(operation, "condition", None) is not None:
+            return None
+        if not all(isinstance(param, (int, float)) and not isinstance(param, bool) for param in operation.params):
+            return None
+        structure.append((
+            operation.name, 
+            len(operation.params),
+            tuple(qc.find_bit(qubit).index for qubit in instruction.qubits),
+            tuple(qc.find_bit(clbit).index for clbit in instruction.clbits)
+        ))
+    registers = tuple((register.name, register.size) for register in qc.qregs + qc.cregs)
+    target = json.dumps(backend, sort_keys=True, default=str)
+    layout = tuple(initial_layout) if initial_layout is not None else None
+    return (tuple(structure), registers, target, opt_level, layout, seed)
+
+
+def _parametrized(qc: QuantumCircuit) -> tuple[QuantumCircuit, list[Parameter]]:
+    """
+    Copy of a circuit with a parameter in place of each of its numeric ones, and those 
+    parameters in the order of its gates.
+    """
+    template = qc.copy_empty_like()
+    parameters = []
+    for instruction in qc.data:
+        operation = instruction.operation
+        if operation.params:
+            operation = operation.copy()
+            new_params = []
+            for value in operation.params:
+                parameters.append(Parameter(f"_template_{len(parameters)}"))
+                new_params.append(parameters[-1])
+            operation.params = new_params
+        template.append(operation, instruction.qubits, instruction.clbits)
+    return template, parameters
+
+
 SUPPORTED_QISKIT_OPERATIONS = {
     'unitary','ryy', 'rz', 'z', 'p', 'rxx', 'rx', 'cx', 'id', 'x', 'sxdg', 'u1', 'ccy', 'rzz', 
     'rzx', 'ry', 's', 'cu', 'crz', 'ecr', 't', 'ccx', 'y', 'cswap', 'r', 'sdg', 'csx', 'crx', 'ccz', 
@@ -18,18 +18,196 @@
         >>> qjob_2 = run(circuit_2, qpu_2)
         >>> gather([qjob_1, qjob_2])
         [<cunqa.result.Result object at XXXXXXXX>, <cunqa.result.Result object at XXXXXXXX>]
+
+    Several static circuits for the same vQPU can go in a single request with 
+    :py:func:`~cunqa.qjob.submit_batch`, each of them still with its own :py:class:`QJob`.
+
+    The shots of a single circuit can be split among several vQPUs with ``dispatch="sharded"`` 
+    in :py:func:`~cunqa.qpu.run`, which gives a :py:class:`~cunqa.qjob.ShardedQJob` whose result 
+    adds up the counts of its shards.
+
+    The vQPU can also keep the final state of a job run with ``retain=True``, which is then 
+    queried through its :py:class:`~cunqa.qjob.RetainedState` without simulating it again.
+
+    When the results are better handled as soon as each of them arrives, 
+    :py:func:`~cunqa.qjob.as_completed` yields the jobs in the order they finish:
+
+        >>> for qjob in as_completed([qjob_1, qjob_2]):
+        ...     print(qjob.result.counts)
     """
 
 import json
-from typing import  Optional, Any, Union
+import time
+from typing import  Optional, Any, Union, Iterable, Iterator
 
 from cunqa.logger import logger
-from cunqa.result import Result
+from cunqa.result import Result, merge_shards
 from cunqa.qclient import QClient, FutureWrapper
 from sympy import Symbol
-from cunqa.circuit.parameter import encoder, Param
+from cunqa.circuit.parameter import encoder, Param, ParamBinder
+from cunqa.circuit.ir import to_binary_task, store_circuit
 from cunqa.real_qpus.qmioclient import QMIOClient, QMIOFuture
 
+# Seconds of each wait for a result before checking the Python signals, or the other jobs
+_WAIT_SLICE = 0.05
+
+
+def _to_pauli_terms(observables) -> list:
+    """
+    Observables as the vQPU reads them: Pauli strings or lists of ``[pauli, coefficient]`` 
+    terms. Objects with a ``to_list`` method, as Qiskit's ``SparsePauliOp``, are also accepted, and 
+    only the real part of the coefficients is kept.
+    """
+    if isinstance(observables, str) or hasattr(observables, "to_list"):
+        observables = [observables]
+
+    pauli_terms = []
+    for observable in observables:
+        if isinstance(observable, str):
+            pauli_terms.append(observable)
+            continue
+        terms = observable.to_list() if hasattr(observable, "to_list") else observable
+        pauli_terms.append([[str(pauli), complex(coefficient).real] for pauli, coefficient in terms])
+    return pauli_terms
+
+
+def _select_clbits(cregisters: dict, selection: dict) -> tuple[list[int], dict]:
+    """
+    Clbits whose counts the vQPU sends for the `registers` or `clbits` run parameters in 
+    `selection`, and the registers of those counts, renumbered from the first clbit kept. The 
+    registers asked for keep the order of the circuit, and the clbits given on their own make a 
+    single register.
+    """
+    if selection.get("registers") is None:
+        clbits = [int(clbit) for clbit in selection["clbits"]]
+        return clbits, {"clbits": list(range(len(clbits)))}
+
+    unknown = [name for name in selection["registers"] if name not in cregisters]
+    if unknown:
+        raise ValueError(f"The circuit has no classical registers {unknown}.")
+    clbits, registers = [], {}
+    for name, register_clbits in cregisters.items():
+        if name in selection["registers"]:
+            registers[name] = list(range(len(clbits), len(clbits) + len(register_clbits)))
+            clbits.extend(register_clbits)
+    return clbits, registers
+
+
+class _BatchReply:
+    """Reply of the vQPU to the circuits sent together by :py:func:`submit_batch`, read once."""
+    def __init__(self, future: Union[FutureWrapper, QMIOFuture], size: int):
+        self._future = future
+        self._size = size
+        self._results = None
+
+    def ready(self) -> bool:
+        return self._results is not None or self._future.ready()
+
+    def wait_for(self, timeout: float) -> bool:
+        return self._results is not None or self._future.wait_for(timeout)
+
+    def get(self, index: int) -> str:
+        if self._results is None:
+            reply = json.loads(self._future.get())
+            if "batch" in reply:
+                results = reply["batch"]
+                for result in results:
+                    if "queue" in reply:
+                        result["queue"] = reply["queue"]
+            else: # An error of the whole request is that of each of its circuits
+                results = [reply] * self._size
+            self._results = [json.dumps(result) for result in results]
+        return self._results[index]
+
+
+class _BatchItem:
+    """Future of one of the circuits of a :py:class:`_BatchReply`, as the QJobs read it."""
+    def __init__(self, reply: _BatchReply, index: int):
+        self._reply = reply
+        self._index = index
+
+    def ready(self) -> bool:
+        return self._reply.ready()
+
+    def wait_for(self, timeout: float) -> bool:
+        return self._reply.wait_for(timeout)
+
+    def get(self) -> str:
+        return self._reply.get(self._index)
+
+
+class RetainedState:
+    """
+    Final state of a circuit that a vQPU keeps after running it with ``retain=True``, obtained 
+    with :py:attr:`QJob.retained`. Each query is answered from the state, without simulating 
+    the circuit again, and blocks until the answer arrives:
+
+        >>> qjob = qpu.execute(circuit, shots=1000, retain=True)
+        >>> state = qjob.retained
+        >>> state.sample(100000).counts
+        {'00': 50112, '11': 49888}
+        >>> state.expectation_values(["ZZ", "XX"])
+        [1.0, 1.0]
+        >>> state.release()
+        True
+
+    The vQPU drops the states that have not been used for a while, and the least recently used 
+    when the new ones do not fit; querying one of them then raises.
+    """
+    handle: str
+    num_qubits: int
+
+    def __init__(self, qclient: Union[QClient, QMIOClient], retained: dict, circuit_id: str, registers: dict):
+        self._qclient = qclient
+        self._circuit_id = circuit_id
+        self._registers = registers
+        self.handle = retained["handle"]
+        self.num_qubits = retained["num_qubits"]
+
+    def _query(self, **query) -> dict:
+        answer = json.loads(self._qclient.send_circuit(json.dumps({"retained": {"handle": self.handle, **query}})).get())
+        if "ERROR" in answer:
+            raise RuntimeError(f"Error in the query on the retained state {self.handle}: {answer['ERROR']}")
+        return answer
+
+    def sample(self, shots: int, seed: Optional[int] = None) -> Result:
+        """
+        Counts of `shots` more shots of the circuit, sampled from its state.
+
+        Args:
+            shots (int): number of shots.
+            seed (int): seed of the sampling, for reproducible counts.
+        """
+        query = {"shots": shots} if seed is None else {"shots": shots, "seed": seed}
+        return Result(self._query(**query), circ_id=self._circuit_id, registers=self._registers)
+
+    def expectation_values(self, observables) -> list[float]:
+        """
+        Exact expectation values of the observables on the state, given as in the `observables` 
+        run parameter.
+        """
+        return self._query(observables=_to_pauli_terms(observables))["expectation_values"]
+
+    def marginal(self, qubits: list[int]) -> dict[str, float]:
+        """
+        Probabilities of the outcomes of the qubits, the first of them being the last bit of the 
+        bitstrings. The outcomes that never happen are left out.
+        """
+        return self._query(marginal=list(qubits))["marginal"]
+
+    def amplitudes(self, indices: list[int]) -> list[complex]:
+        """
+        Amplitudes of the state at the indices, the qubit 0 being the least significant bit.
+        """
+        return [complex(real, imag) for real, imag in self._query(amplitudes=list(indices))["amplitudes"]]
+
+    def release(self) -> bool:
+        """
+        Drops the state from the vQPU, and returns whether it still kept it.
+        """
+        return self._query(release=True)["released"]
+
+
 class QJob:
     """
     Class to handle jobs sent to vQPUs. A :py:class:`QJob` object is created as the output 
@@ -53,6 +231,19 @@ class QJob:
 
     .. automethod:: upgrade_parameters
 
+    When several sets of parameters have to be evaluated at once, as the population of a genetic 
+    algorithm, they can be sent in a single request with :py:meth:`~QJob.upgrade_parameters_batch` 
+    and their results obtained with :py:attr:`QJob.result_batch`.
+
+    .. automethod:: upgrade_parameters_batch
+    .. autoattribute:: result_batch
+
+    The results are received in the background, so whether a job has finished can be checked, or 
+    waited for a while, without blocking on it with :py:meth:`~QJob.done` and :py:meth:`~QJob.wait`.
+
+    .. automethod:: done
+    .. automethod:: wait
+
     *References*:
 
     .. [#] `Variational Quantum Algorithms arXiv <https://arxiv.org/abs/2012.09265>`_ .
@@ -67,22 +258,33 @@ class QJob:
     _result: Optional[Result]
     _quantum_task: dict
     _params: list[Param]
+    _binary_task: bool
+    _circuit_store: Union[bool, str, None]
+    _is_batch: bool
+    _batch_results: Optional[list[Result]]
+    _queue: Optional[dict]
 
     def __init__(
             self, 
             qclient: Union[QClient, QMIOClient], 
             device: dict, 
             circuit_ir: dict, 
+            binary_task: bool = False,
             **run_parameters: Any
     ):
         self._qclient = qclient
+        self._binary_task = binary_task
         self._device = device
         self._circuit_id = circuit_ir["id"]
         self._cregisters = circuit_ir["classical_registers"]
         self._params = circuit_ir["params"]
+        self._binder = None
         self._updated = False
         self._future = None
         self._result = None
+        self._is_batch = False
+        self._batch_results = None
+        self._queue = None
 
         run_config = {
             "shots": 1024, 
@@ -101,6 +303,21 @@ class QJob:
         else:
             logger.warning("Error when reading `run_parameters`, default were set.")
 
+        if "observables" in run_config:
+            run_config["observables"] = _to_pauli_terms(run_config["observables"])
+
+        # Only tells how the circuit is sent, so it does not go to the vQPU
+        self._circuit_store = run_config.pop("circuit_store", None)
+
+        # The vQPU sends the counts of these clbits alone, which make the registers of the result
+        self._circuit_cregisters = self._cregisters
+        self._clbit_selection = None
+        if "registers" in run_config or "clbits" in run_config:
+            if "registers" in run_config and "clbits" in run_config:
+                raise ValueError("Either the `registers` or the `clbits` are selected, not both.")
+            self._clbit_selection = {"registers": run_config.pop("registers", None), "clbits": run_config.get("clbits")}
+            run_config["clbits"], self._cregisters = _select_clbits(self._cregisters, self._clbit_selection)
+
         self._quantum_task = {
             "config": run_config, 
             "instructions": circuit_ir["instructions"],
@@ -128,28 +345,139 @@ class QJob:
             recieved from the corresponding server the outcome of the job. The result is not sent 
             from the server to the :py:class:`QClient` until this method is called.
         
-        .. warning::
-            Because of how the client-server comunication is built, the user must be careful and call 
-            for the results in the same order in which the jobs where submited. If the order is not 
-            respected, no errors would be raised but results will not correspond to the job -
-            a mix up would happen. This is because the server follows the FIFO rule (*First in 
-            first out*): if we want to receive the second result, the first one has to be out.
+        .. note::
+            Every job carries a request identifier that the vQPU sends back with its result, so 
+            results can be requested in any order: those that finish earlier are kept by the 
+            :py:class:`QClient` until their :py:class:`QJob` asks for them.
 
         """
+        if self._is_batch:
+            raise RuntimeError("The last parameters were sent as a batch, use result_batch instead.")
+
         if self._future is not None:
             if (self._result is not None and not self._updated) or (self._result is None):
                 res = self._future.get()
+                binary_counts = None
+                binary_states = None
+                if isinstance(res, tuple) and len(res) == 2: # States sent in binary
+                    res, binary_states = res
+                elif isinstance(res, tuple): # Counts sent in binary
+                    res, outcomes, counts, num_clbits = res
+                    binary_counts = (outcomes, counts, num_clbits)
                 self._result = Result(
                     json.loads(res), 
                     circ_id=self._circuit_id[0], 
-                    registers=self._cregisters
+                    registers=self._cregisters,
+                    binary_counts=binary_counts,
+                    binary_states=binary_states
                 )
+                self._queue = self._result.queue
                 self._updated = True
         else:
             raise RuntimeError("self._future is None which means that the QJob has not "
                                "been submitted.")
         return self._result
 
+    @property
+    def retained(self) -> RetainedState:
+        """
+        State that the vQPU kept of a job run with the `retain` run parameter, on which more 
+        shots, expectation values, marginals or amplitudes are asked, see 
+        :py:class:`RetainedState`. As :py:attr:`result`, this is a blocking call.
+        """
+        retained = self.result.retained
+        if retained is None:
+            raise RuntimeError("The vQPU did not retain the state of this job, run it with retain=True "
+                               "on a vQPU raised with retained_states.")
+        # The queries on the state are of all the clbits
+        return RetainedState(self._qclient, retained, self._circuit_id[0], self._circuit_cregisters)
+
+    @property
+    def queue(self) -> Optional[dict]:
+        """
+        Load of the vQPU when it sent the last result read from the job, see 
+        :py:attr:`~cunqa.result.Result.queue`, or None if none was read yet. This is a 
+        non-blocking call.
+        """
+        return self._queue
+
+    @property
+    def partial_result(self) -> Optional[Result]:
+        """
+        Last intermediate result of a job run with the `stream_shots` run parameter, or None if 
+        none arrived yet. The vQPU runs the shots in chunks of `stream_shots`, and each partial 
+        result holds the counts of all the chunks done so far, their number in its ``"shots"``.
+        This is a non-blocking call.
+
+            >>> qjob = qpu.execute(circuit, shots=1000000, stream_shots=10000)
+            >>> qjob.partial_result.counts
+            {'000': 4987, '111': 5013}
+        """
+        if self._future is None:
+            raise RuntimeError("self._future is None which means that the QJob has not "
+                               "been submitted.")
+        if self._updated or not hasattr(self._future, "partial"):
+            return None
+        partial = self._future.partial()
+        if partial is None:
+            return None
+        return Result(json.loads(partial), circ_id=self._circuit_id[0], registers=self._cregisters)
+
+    def stop(self) -> None:
+        """
+        Asks the vQPU to finish a job run with the `stream_shots` run parameter after the chunk 
+        it is running, so that :py:attr:`result` holds the counts of the shots done until then, 
+        with ``"stopped"`` set. Jobs that are not streaming, or that already finished, go on.
+        """
+        if self._future is None:
+            raise RuntimeError("self._future is None which means that the QJob has not "
+                               "been submitted.")
+        if not self._updated and hasattr(self._future, "stop"):
+            self._future.stop()
+
+    def cancel(self) -> None:
+        """
+        Asks the vQPU to drop the job. If it is still queued it is never run, and if it is 
+        streaming it ends at the next chunk; either way :py:attr:`result` raises with the error 
+        ``"Request cancelled."``. Jobs that are running without streaming, or that already 
+        finished, go on.
+        """
+        if self._future is None:
+            raise RuntimeError("self._future is None which means that the QJob has not "
+                               "been submitted.")
+        if not self._updated and hasattr(self._future, "cancel"):
+            self._future.cancel()
+
+    def done(self) -> bool:
+        """
+        Whether the result of the last request sent has arrived, so that :py:attr:`result` or 
+        :py:attr:`result_batch` return without waiting. This is a non-blocking call.
+        """
+        if self._future is None:
+            raise RuntimeError("self._future is None which means that the QJob has not "
+                               "been submitted.")
+        return self._updated or self._future.ready()
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        """
+        Waits for the result of the last request sent, for at most `timeout` seconds if given, 
+        and returns whether it arrived. Other Python threads run while it waits.
+
+        Args:
+            timeout (float): maximum seconds to wait. If None, waits until the result arrives.
+        """
+        if self._future is None:
+            raise RuntimeError("self._future is None which means that the QJob has not "
+                               "been submitted.")
+        if self._updated:
+            return True
+        if timeout is not None:
+            return self._future.wait_for(timeout)
+        # In slices, so that a KeyboardInterrupt is not delayed until the result arrives
+        while not self._future.wait_for(_WAIT_SLICE):
+            pass
+        return True
+
     def submit(
         self, 
         param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]]] = None
@@ -179,14 +507,30 @@ class QJob:
             if param_values is not None:
                 self.assign_parameters_(param_values)
             
-            self._future = self._qclient.send_circuit(
-                json.dumps(
-                    self._quantum_task,
-                    default=encoder
+            # The binary encoding is skipped for instructions it cannot represent
+            binary_task = to_binary_task(self._quantum_task) if self._binary_task and not self._circuit_store else None
+            if self._circuit_store:
+                self._future = self._qclient.send_circuit(json.dumps(self._task_to_send(), default=encoder))
+            elif binary_task is not None:
+                self._future = self._qclient.send_circuit(binary_task)
+            else:
+                self._future = self._qclient.send_circuit(
+                    json.dumps(
+                        self._quantum_task,
+                        default=encoder
+                    )
                 )
-            )
             
             logger.debug("Circuit was sent.")
+
+    def _task_to_send(self) -> dict:
+        """The quantum task, with the hash of its circuit in the circuit store if it is sent by reference."""
+        if not self._circuit_store:
+            return self._quantum_task
+        directory = None if self._circuit_store is True else self._circuit_store
+        task = {key: value for key, value in self._quantum_task.items() if key != "instructions"}
+        task["circuit_ref"] = store_circuit(self._quantum_task["instructions"], directory)
+        return task
             
     def upgrade_parameters(
         self, 
@@ -222,11 +566,14 @@ class QJob:
             shots (int): number of shots for the next circuit execution
         """
 
+        if isinstance(self._future, _BatchItem):
+            raise RuntimeError("The vQPU does not keep the circuits sent with submit_batch(), submit "
+                               "the circuit on its own to upgrade its parameters.")
+
         if self._result is None: 
             if self._future is not None:
-                # TODO: Improve this by having a queue of results
                 logger.warning("You have not obtained the previous results. They will be discarded.")
-                self._future.get() # we get the previous result because if not it stays in queue
+                self._future.get() # we get the previous result because if not the client keeps it
             else:
                 raise RuntimeError("No circuit was sent before calling update_parameters().")
 
@@ -243,10 +590,153 @@ class QJob:
             message = """{{"params":{}, "shots": {}}}""".format(premessage, shots).replace("'", '"')
             self._future = self._qclient.send_parameters(message)
             self._updated = False
+            self._is_batch = False
         except Exception as error:
             logger.error(f"Some error occured when sending the new parameters to "
                          f"circuit {self._circuit_id} [{type(error).__name__}].")
             self._updated = True
+
+    def upgrade_parameters_batch(
+        self,
+        param_batch: list[Union[dict[Symbol, Union[float, int]], list[Union[float, int]]]],
+        shots: int = None
+    ) -> None:
+        """
+        Method to evaluate several sets of parameters of a previously submitted parametric circuit 
+        in a single request. The vQPU runs the circuit once per set of parameters, without the 
+        communication and parsing overhead of sending each of them with 
+        :py:meth:`upgrade_parameters`. Each set follows the same rules as in that method. Results 
+        are obtained, in the same order, with :py:attr:`result_batch`.
+
+            >>> qjob.upgrade_parameters_batch([[0.1, 0.2], [0.3, 0.4], [0.5, 0.6]])
+            >>> results = qjob.result_batch
+
+        Args:
+            param_batch (list[dict | list]): sets of parameters to assign to the circuit.
+            shots (int): number of shots for each of the executions.
+        """
+        if self._future is None:
+            raise RuntimeError("No circuit was sent before calling upgrade_parameters_batch().")
+        if isinstance(self._future, _BatchItem):
+            raise RuntimeError("The vQPU does not keep the circuits sent with submit_batch(), submit "
+                               "the circuit on its own to upgrade its parameters.")
+
+        if not len(param_batch):
+            raise AttributeError("No parameter batch has been provided to the "
+                                 "upgrade_parameters_batch method.")
+
+        if not self._updated:
+            logger.warning("You have not obtained the previous results. They will be discarded.")
+            self._future.get()
+
+        batch = []
+        for param_values in param_batch:
+            self.assign_parameters_(param_values if isinstance(param_values, dict) else list(param_values))
+            batch.append([float(param) for param in self._params])
+
+        if shots is None:
+            shots = self._quantum_task["config"]["shots"]
+        try:
+            message = json.dumps({"params_batch": batch, "shots": shots})
+            self._future = self._qclient.send_parameters(message)
+            self._updated = False
+            self._is_batch = True
+        except Exception as error:
+            logger.error(f"Some error occured when sending the batch of parameters to "
+                         f"circuit {self._circuit_id} [{type(error).__name__}].")
+            self._updated = True
+
+    def upgrade_circuit(self, circuit_ir: dict, shots: int = None) -> None:
+        """
+        Sends a new version of the circuit of the job, of which the vQPU only gets the 
+        instructions after those that it shares with the last version sent, so that a circuit 
+        that grows by a few gates at each iteration, as in ADAPT-VQE or in layerwise training, 
+        is not sent and parsed again in full. The result is obtained as usual with 
+        :py:attr:`result`, and the parameters of the new circuit can be upgraded afterwards.
+
+            >>> qjob = qpu.execute(circuit.info)
+            >>> circuit.rx(theta, 0)
+            >>> qjob.upgrade_circuit(circuit.info)
+            >>> qjob.result.counts
+
+        Args:
+            circuit_ir (dict): circuit IR of the new version of the circuit.
+            shots (int): number of shots for the next circuit execution.
+        """
+        if self._future is None:
+            raise RuntimeError("No circuit was sent before calling upgrade_circuit().")
+        if isinstance(self._future, _BatchItem):
+            raise RuntimeError("The vQPU does not keep the circuits sent with submit_batch(), submit "
+                               "the circuit on its own to upgrade it.")
+
+        if not self._updated:
+            logger.warning("You have not obtained the previous results. They will be discarded.")
+            self._future.get()
+
+        # Compared as sent, so that the parameters count by their values
+        sent = [json.dumps(instruction, default=encoder) for instruction in self._quantum_task["instructions"]]
+        instructions = circuit_ir["instructions"]
+        at = 0
+        while at < min(len(sent), len(instructions)) and sent[at] == json.dumps(instructions[at], default=encoder):
+            at += 1
+
+        config = {"num_qubits": circuit_ir["num_qubits"], "num_clbits": circuit_ir["num_clbits"]}
+        if shots is not None:
+            config["shots"] = shots
+        cregisters = circuit_ir["classical_registers"]
+        if self._clbit_selection is not None:
+            config["clbits"], cregisters = _select_clbits(cregisters, self._clbit_selection)
+        append = {
+            "instructions": instructions[at:],
+            "at": at,
+            "config": config,
+            "sending_to": circuit_ir["sending_to"],
+            "is_dynamic": circuit_ir["is_dynamic"]
+        }
+        try:
+            self._future = self._qclient.send_circuit(json.dumps({"append": append}, default=encoder))
+            self._updated = False
+            self._is_batch = False
+        except Exception as error:
+            logger.error(f"Some error occured when sending the upgrade of circuit "
+                         f"{self._circuit_id} [{type(error).__name__}].")
+            self._updated = True
+            return
+
+        self._quantum_task["instructions"] = instructions
+        self._quantum_task["sending_to"] = circuit_ir["sending_to"]
+        self._quantum_task["is_dynamic"] = circuit_ir["is_dynamic"]
+        self._quantum_task["config"].update(config)
+        self._circuit_cregisters = circuit_ir["classical_registers"]
+        self._cregisters = cregisters
+        self._params = circuit_ir["params"]
+        self._binder = None
+        logger.debug(f"Circuit upgraded from its instruction {at}.")
+
+    @property
+    def result_batch(self) -> list[Result]:
+        """
+        Results of the last batch sent with :py:meth:`upgrade_parameters_batch`, one 
+        :py:class:`~cunqa.result.Result` per set of parameters and in the same order. As 
+        :py:attr:`result`, this is a blocking call.
+        """
+        if not self._is_batch:
+            raise RuntimeError("No parameter batch has been sent to this QJob.")
+
+        if not self._updated:
+            res = json.loads(self._future.get())
+            if "batch" not in res:
+                Result(res, circ_id=self._circuit_id[0], registers=self._cregisters) # Raises the error
+                raise RuntimeError(f"Unexpected answer to a parameter batch: {res}")
+
+            self._batch_results = [
+                Result(result, circ_id=self._circuit_id[0], registers=self._cregisters) 
+                for result in res["batch"]
+            ]
+            self._queue = res.get("queue")
+            self._updated = True
+
+        return self._batch_results
             
     def assign_parameters_(
         self, 
@@ -254,6 +744,13 @@ class QJob:
     ):
         """Fuction responsible of assigning the values to the circuit parameter."""    
         if isinstance(param_values, dict):
+            # All the expressions at once when every free symbol has a value, as in optimizer loops
+            binder = self._param_binder()
+            if binder is not None and all(param_values.get(name) is not None for name in binder.symbols):
+                for param, value in zip(self._params, binder.bind(param_values)):
+                    param.assign_value(float(value))
+                return
+
             for param in self._params:
                 # I filter the free parameters that are employed in the symbolic expression 
                 values_i = {k.name: param_values.get(k.name) 
@@ -275,6 +772,127 @@ class QJob:
                 for param, value in zip(self._params, param_values):
                     param.assign_value(value)
 
+    def _param_binder(self) -> Optional[ParamBinder]:
+        """Binder of the parameters of the circuit, or None if they are only evaluated with sympy."""
+        if self._binder is None:
+            try:
+                self._binder = ParamBinder(self._params)
+            except (ImportError, NotImplementedError) as error:
+                logger.debug(f"Parameters of circuit {self._circuit_id} evaluated with sympy: {error}")
+                self._binder = False
+        return self._binder or None
+
+
+def split_shots(shots: int, n_shards: int) -> list[int]:
+    """Shots of each of `n_shards` shards that add up to `shots`, the first ones taking the rest."""
+    return [shots // n_shards + (i < shots % n_shards) for i in range(n_shards)]
+
+
+class ShardedQJob:
+    """
+    Job whose shots were split among several vQPUs, each of them running its share with its own 
+    seed, created by :py:func:`~cunqa.qpu.run` with ``dispatch="sharded"``. It is used as a 
+    :py:class:`QJob`: its :py:attr:`result` is a single :py:class:`~cunqa.result.Result` with the 
+    counts of every shard added up, whose :py:attr:`~cunqa.result.Result.shards` tells what each 
+    vQPU ran.
+
+        >>> qjob = run(circuit, qpus, dispatch="sharded", shots=2_000_000, seed=7)
+        >>> qjob.result.counts
+        {'00': 1000340, '11': 999660}
+    """
+    def __init__(self, qjobs: list[QJob], qpu_ids: list[str], shots: list[int], seeds: list[int]):
+        self._qjobs = qjobs
+        self._shards = [{"qpu": qpu_id, "shots": n, "seed": seed} for qpu_id, n, seed in zip(qpu_ids, shots, seeds)]
+        self._result = None
+
+    @property
+    def qjobs(self) -> list[QJob]:
+        """Jobs of the shards, one per vQPU."""
+        return self._qjobs
+
+    @property
+    def result(self) -> Result:
+        """Result with the counts of every shard added up, waiting for all of them."""
+        if self._result is None:
+            first = self._qjobs[0]
+            self._result = merge_shards([qjob.result for qjob in self._qjobs], first._circuit_id[0], 
+                                        first._cregisters, self._shards)
+        return self._result
+
+    def done(self) -> bool:
+        """Whether the results of every shard have arrived. This is a non-blocking call."""
+        return all(qjob.done() for qjob in self._qjobs)
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        """
+        Waits for the results of every shard, for at most `timeout` seconds in total if given, 
+        and returns whether all of them arrived.
+        """
+        deadline = None if timeout is None else time.monotonic() + timeout
+        for qjob in self._qjobs:
+            remaining = None if deadline is None else max(deadline - time.monotonic(), 0)
+            if not qjob.wait(remaining):
+                return False
+        return True
+
+    def cancel(self) -> None:
+        """Asks every vQPU to drop its shard, see :py:meth:`QJob.cancel`."""
+        for qjob in self._qjobs:
+            qjob.cancel()
+
+    def upgrade_parameters(
+        self, 
+        param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]]],
+        shots: int = None
+    ) -> None:
+        """
+        Sends new parameters to every shard, see :py:meth:`QJob.upgrade_parameters`. New shots 
+        are split among them as those of :py:func:`~cunqa.qpu.run`.
+        """
+        shard_shots = [None] * len(self._qjobs) if shots is None else split_shots(shots, len(self._qjobs))
+        if 0 in shard_shots:
+            raise ValueError(f"{shots} shots cannot be split among {len(self._qjobs)} shards.")
+        for qjob, shard, n in zip(self._qjobs, self._shards, shard_shots):
+            qjob.upgrade_parameters(param_values, shots=n)
+            if n is not None:
+                shard["shots"] = n
+        self._result = None
+
+
+def submit_batch(qjobs: list[QJob]) -> None:
+    """
+        Submits several jobs not submitted yet, all of them for the same vQPU, in a single 
+        request. The vQPU runs their circuits together, which Aer does in a single execution that 
+        spreads them over its threads, and answers all of them at once; each job gets its own 
+        result as if it had been submitted on its own.
+
+            >>> qjobs = [QJob(qclient, device, circuit_ir, shots=1000) for circuit_ir in circuits_ir]
+            >>> submit_batch(qjobs)
+            >>> results = gather(qjobs)
+
+        Only static circuits, without classically controlled gates nor communications, and without 
+        observables, are batched. The vQPU does not keep their circuits, so their parameters cannot 
+        be upgraded afterwards.
+
+        Args:
+            qjobs (list[QJob]): jobs to submit, created with the :py:class:`QClient` of the vQPU.
+    """
+    if not qjobs:
+        raise AttributeError("qjobs in submit_batch cannot be none.")
+
+    qclient = qjobs[0]._qclient
+    if any(qjob._qclient is not qclient for qjob in qjobs):
+        raise ValueError("The jobs of a batch have to be sent to the same vQPU.")
+    if any(qjob._future is not None for qjob in qjobs):
+        raise RuntimeError("Some QJob of the batch has already been submitted.")
+
+    message = json.dumps({"tasks": [qjob._task_to_send() for qjob in qjobs]}, default=encoder)
+    reply = _BatchReply(qclient.send_circuit(message), len(qjobs))
+    for i, qjob in enumerate(qjobs):
+        qjob._future = _BatchItem(reply, i)
+
+    logger.debug(f"Batch of {len(qjobs)} circuits was sent.")
+
 
 def gather(qjobs: list[QJob]) -> list[Result]:
     """
@@ -288,9 +906,6 @@ def gather(qjobs: list[QJob]) -> list[Result]:
         simultaneously, even if the first one on the list takes the longest, when it finishes the 
         rest would have been done, so just the small overhead from calling them will be added.
 
-        .. warning::
-            Since this is mainly a for loop, the order must be respected when submiting jobs to the 
-            same vQPU.
 
         Args:
             qjobs (list[QJob]): list of objects to get the result from.
@@ -303,3 +918,40 @@ def gather(qjobs: list[QJob]) -> list[Result]:
         return [q.result for q in qjobs]
     else: 
         raise AttributeError("qjobs in gather cannot be none.")    
+
+
+def as_completed(qjobs: Iterable[QJob], timeout: Optional[float] = None) -> Iterator[QJob]:
+    """
+        Generator yielding the given :py:class:`QJob` objects as their results arrive, whatever 
+        the order they were sent in. The results of the jobs it yields can be read without waiting:
+
+            >>> for qjob in as_completed(qjobs):
+            ...     process(qjob.result)
+
+        Args:
+            qjobs (list[QJob]): submitted jobs to wait for.
+            timeout (float): maximum seconds to wait for all of them. If None, there is no limit.
+
+        Raises:
+            TimeoutError: if some jobs did not finish within the timeout.
+    """
+    if not qjobs:
+        raise AttributeError("qjobs in as_completed cannot be none.")
+
+    pending = list(qjobs)
+    deadline = None if timeout is None else time.monotonic() + timeout
+    while pending:
+        finished = [qjob for qjob in pending if qjob.done()]
+        for qjob in finished:
+            pending.remove(qjob)
+            yield qjob
+        if not pending:
+            break
+
+        wait = _WAIT_SLICE
+        if deadline is not None:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                raise TimeoutError(f"{len(pending)} QJob(s) did not finish within {timeout} s.")
+            wait = min(wait, remaining)
+        pending[0].wait(wait)
@@ -15,10 +15,11 @@ into two subgroups:
 """
 
 import os
-import time
 import json
+import time
 import subprocess
 import re
+import secrets
 from typing import Union, Any, Optional, TypedDict
 from sympy import Symbol
 
@@ -27,9 +28,10 @@ from collections import Counter
 from cunqa.qclient import QClient
 from cunqa.circuit import CunqaCircuit, to_ir
 from cunqa.real_qpus.qmioclient import QMIOClient
-from cunqa.qjob import QJob
+from cunqa.qjob import QJob, ShardedQJob, submit_batch, split_shots
 from cunqa.logger import logger
-from cunqa.constants import QPUS_FILEPATH, REMOTE_GATES
+from cunqa.utils import init_registry, read_registry
+from cunqa.constants import QPUS_REGISTRY, REMOTE_GATES
 
 class Backend(TypedDict):
     """
@@ -42,6 +44,7 @@ class Backend(TypedDict):
     .. autoattribute:: name
     .. autoattribute:: noise_properties_path
     .. autoattribute:: simulator
+    .. autoattribute:: simulator_config
     .. autoattribute:: version
     """
     basis_gates: list[str] #: Native gates that the Backend accepts. If others are used, they must be translated into the native gates.
@@ -53,6 +56,7 @@ class Backend(TypedDict):
     name: str #: Name assigned to the Backend.
     noise_properties_path: str #: Path to the noise model json file gathering the noise instructions needed for the simulator.
     simulator: str #: Name of the simulator that simulates the circuits accordingly to the Backend.
+    simulator_config: dict #: Options of the simulator, such as the ``dd_memory_limit`` (MiB) and ``dd_garbage_collection`` policy of Munich.
     version: str #: Version of the Backend.
 
 class QPU:
@@ -79,19 +83,43 @@ class QPU:
     _family: str
     _qclient: Union[QClient, QMIOClient]
     _device: dict
-
-    def __init__(self, id: int, backend: Backend, device: dict, family: str, endpoint: str):
+    _binary_tasks: bool
+    _last_qjob: Optional[QJob]
+    _queue: Optional[dict]
+
+    def __init__(
+            self, 
+            id: int, 
+            backend: Backend, 
+            device: dict, 
+            family: str, 
+            endpoint: str, 
+            encodings: Optional[list[str]] = None,
+            local_endpoint: Optional[str] = None,
+            nodename: Optional[str] = None
+    ):
         self._id = id
         self._backend = backend
         self._device = device
         self._family = family
+        self._last_qjob = None
+        self._queue = None
         
-        if (device['device_name'] == 'QPU'):
+        # The C++ linker of QMIO serves the tasks as a vQPU does, and advertises its encodings as it
+        if (device['device_name'] == 'QPU' and encodings is None):
             self._qclient = QMIOClient() # TODO: Generalize QPU
+            self._binary_tasks = False
+            self._qclient.connect(endpoint)
         else:
-            self._qclient = QClient()
-
-        self._qclient.connect(endpoint)
+            # With many vQPUs, a single socket and thread of the process can serve all of them
+            self._qclient = QClient(multiplexed=os.getenv("CUNQA_MULTIPLEXED_CLIENT") == "1")
+            # Quantum tasks are sent in binary only if the vQPU advertises it
+            self._binary_tasks = encodings is not None and "binary" in encodings
+            # A vQPU on the same node is reached through its Unix domain socket instead of loopback TCP
+            if local_endpoint is not None:
+                self._qclient.connect(endpoint, local_endpoint, nodename or "")
+            else:
+                self._qclient.connect(endpoint)
         logger.debug(f"Object for QPU {id} created and connected to endpoint {endpoint}.")
 
     @property
@@ -112,6 +140,38 @@ class QPU:
         """Name of the family to which the corresponding vQPU belongs."""
         return self._family
 
+    @property
+    def queue(self) -> Optional[dict]:
+        """
+        Load of the vQPU as reported with the last result read from it, see 
+        :py:attr:`~cunqa.result.Result.queue`, or None if no result was read yet.
+        """
+        if self._last_qjob is not None and self._last_qjob.queue is not None:
+            self._queue = self._last_qjob.queue
+        return self._queue
+
+    def status(self, timeout: float = 1.0) -> Optional[dict]:
+        """
+        Asks the vQPU for its load, as in :py:attr:`~cunqa.result.Result.queue`, together with its 
+        ``"name"``, ``"n_workers"`` and ``"device"``. The vQPU answers without queueing the 
+        query behind its tasks. None if it does not answer within `timeout` seconds, or if the 
+        communications do not support it.
+
+            >>> qpu.status()
+            {'depth': 3, 'running': 1, 'task_seconds': 0.5, 'throughput': 2.0, 'eta': 2.0, ...}
+        """
+        if not hasattr(self._qclient, "send_status"):
+            return None
+        try:
+            future = self._qclient.send_status()
+            if not future.wait_for(timeout):
+                return None
+            self._queue = json.loads(future.get())
+        except Exception as error:
+            logger.debug(f"No status from QPU {self._id} [{type(error).__name__}]: {error}")
+            return None
+        return self._queue
+
     def execute(
         self, 
         circuit_ir: dict, 
@@ -120,8 +180,8 @@ class QPU:
     ) -> QJob:
         """
         Class method responsible of executing a circuit into the corresponding vQPU that this class 
-        connects to. Possible instructions to add as `**run_parameters` are simulator dependant, 
-        with `shots` and `method` being the most common ones.
+        connects to. The run parameters are simulator dependant, with `shots` and `method` being 
+        the most common ones.
 
         Args:
             circuit_ir (dict): circuit IR to be simulated at the vQPU.
@@ -129,21 +189,167 @@ class QPU:
                                         parametrized circuit or a dictionary with keys being the 
                                         free parameters' names and its values being its 
                                         corresponding new values.
-            **run_parameters: any other simulation instructions.
+            **run_parameters: any other simulation instructions, see below.
+
+        Run parameters:
+            shots (int): number of shots of the circuit.
+            method (str): simulation method. ``"matrix_product_state"`` also runs the circuits with 
+                          communications on Aer and Maestro, and ``"sparse"`` keeps only the 
+                          populated basis states on CUNQA.
+            seed (int): seed of the simulation, and of the layouts tried by `transpile`.
+            precision (str): ``"single"`` or ``"double"``, precision of the amplitudes among those 
+                             of the simulator, see :py:func:`qraise`.
+            observables (list): Pauli strings or ``[(pauli, coefficient), ...]`` terms whose 
+                                expectation values are returned instead of the counts, see 
+                                :py:attr:`~cunqa.result.Result.expectation_values`.
+            gradient (bool): if ``True``, also the gradients of the `observables` by the 
+                             parameters of the circuit, see 
+                             :py:attr:`~cunqa.result.Result.gradients`.
+            deadline (float): seconds after reaching the vQPU within which the job has to start, 
+                              or its result is an error.
+            priority (int): jobs of higher priority run first. Default is 0.
+            timings (bool): if ``True``, the result tells the seconds spent in each stage, see 
+                            :py:attr:`~cunqa.result.Result.timings`.
+            perf_counters (bool): if ``True``, the result tells the hardware counters of the 
+                                  simulation, see :py:attr:`~cunqa.result.Result.perf_counters`.
+            optimize (bool): if ``True``, the circuit is simplified first, see 
+                             :py:attr:`~cunqa.result.Result.optimization`.
+            transpile (bool): if ``True``, the circuit is translated into the basis gates and 
+                              routed onto the coupling map of the backend, see 
+                              :py:attr:`~cunqa.result.Result.transpilation`.
+            initial_layout (list): layout that `transpile` starts from.
+            defer_measurements (bool): if ``False``, the circuits whose classically controlled 
+                                       gates only depend on their own measurements do not run as 
+                                       static ones, see 
+                                       :py:attr:`~cunqa.result.Result.deferred_measurements`.
+            sample_terminal_measurements (bool): if ``False``, the dynamic circuits measured only 
+                                                 at the end are not sampled as static ones.
+            matrix_product_state_max_bond_dimension (int): bound of the bond dimension of the 
+                                                           matrix product states.
+            matrix_product_state_truncation_threshold (float): threshold under which the matrix 
+                                                               product states are truncated.
+            factorized_state (bool): if ``True``, the CUNQA vQPUs run the circuits with quantum 
+                                     communications on a statevector per circuit.
+            shot_block (int): shots of the CUNQA vQPUs with classical communications that 
+                              exchange their measurements in a single message. The vQPUs that 
+                              talk to each other need the same `shots` and `shot_block`.
+            speculation (bool): if ``True``, a CUNQA vQPU of up to 20 qubits guesses the bits of a 
+                                `recv` instead of waiting for them, see ``"speculation"`` in the 
+                                result.
+            batched_shots_gpu (bool): if ``False``, the Aer vQPUs on GPU do not run many shots of 
+                                      a dynamic circuit at once.
+            batched_shots_gpu_max_qubits (int): widest circuit of `batched_shots_gpu`. Default 
+                                                is 20.
+            fusion_allow_superop (bool): if ``False``, the noisy Aer vQPUs with 
+                                         ``method="density_matrix"`` do not fuse the gates with 
+                                         their noise.
+            merge_diagonals (bool): if ``False``, the runs of diagonal gates are not applied as a 
+                                    single `diagonal`.
+            target_standard_error (float): the `shots` become a ceiling, and the shots stop once 
+                                           no frequency of the counts has a larger standard 
+                                           error, see :py:attr:`~cunqa.result.Result.convergence`.
+            convergence_block (int): shots between the checks of `target_standard_error`. Default 
+                                     is 1000.
+            retain (bool): if ``True``, the vQPU keeps the final state of a static circuit 
+                           measured at the end, see :py:attr:`~cunqa.qjob.QJob.retained`.
+            registers (list): names of the classical registers whose counts alone are sent.
+            clbits (list): clbits whose counts alone are sent, as a single register.
+            checkpoint (str): name under which the counts so far are kept after each chunk of 
+                              shots, so that the same job sent again resumes from them, see 
+                              `checkpoint_dir` in :py:func:`qraise`.
+            checkpoint_shots (int): shots of each chunk of `checkpoint`. Default is a tenth of 
+                                    them.
+            circuit_store (bool | str): if ``True``, or the directory of the store, the circuit is 
+                                        sent by its hash through the circuit store of the vQPUs, 
+                                        see :py:func:`~cunqa.circuit.ir.store_circuit`.
         """
-        qjob = QJob(self._qclient, self._device, circuit_ir, **run_parameters)
+        qjob = QJob(
+            self._qclient, 
+            self._device, 
+            circuit_ir, 
+            binary_task=self._binary_tasks, 
+            **run_parameters
+        )
         qjob.submit(param_values)
         logger.debug(f"Qjob submitted to QPU {self._id}.")
+        self._last_qjob = qjob
 
         return qjob
 
+    def execute_batch(self, circuits_ir: list[dict], **run_parameters: Any) -> list[QJob]:
+        """
+        Executes several static circuits in the vQPU with a single request, see 
+        :py:func:`~cunqa.qjob.submit_batch`, with the same `**run_parameters` as 
+        :py:meth:`execute`. Aer runs them in a single execution instead of one after the other, 
+        which pays off for many small circuits, as the terms of an observable measured in several 
+        bases.
+
+            >>> qjobs = qpu.execute_batch([circuit_ir_1, circuit_ir_2], shots=1000)
+            >>> results = gather(qjobs)
+
+        Args:
+            circuits_ir (list[dict]): circuits IR to be simulated at the vQPU.
+            **run_parameters: any other simulation instructions.
+        """
+        qjobs = [
+            QJob(self._qclient, self._device, circuit_ir, **run_parameters) 
+            for circuit_ir in circuits_ir
+        ]
+        submit_batch(qjobs)
+        logger.debug(f"Batch of {len(qjobs)} QJobs submitted to QPU {self._id}.")
+        self._last_qjob = qjobs[-1]
+
+        return qjobs
+
+
+def least_loaded(qpus: list[QPU], n_jobs: int, refresh: bool = True) -> list[QPU]:
+    """
+    QPU for each of `n_jobs` jobs, each one to the vQPU that would finish it first given the 
+    load it reports and its recent seconds per task, so that faster vQPUs, such as those on 
+    GPUs, take more of them. The load is asked with :py:meth:`QPU.status` if `refresh`, or 
+    taken from the last result read otherwise (:py:attr:`QPU.queue`). If some vQPU has not 
+    reported it, the jobs take turns among the vQPUs in order. The vQPUs that report they are 
+    being drained get no jobs.
+
+        >>> qjobs = [qpu.execute(circuit) for qpu in least_loaded(qpus, 100)]
+
+    Args:
+        qpus (list[~cunqa.qpu.QPU]): vQPUs to choose from.
+        n_jobs (int): number of jobs to assign.
+        refresh (bool): whether to ask the vQPUs for their current load.
+    """
+    queues = []
+    for qpu in qpus:
+        queue = qpu.status() if refresh and hasattr(qpu, "status") else None
+        queues.append(queue if queue is not None else getattr(qpu, "queue", None))
+    # Those being drained refuse new jobs
+    kept = [i for i, queue in enumerate(queues) if not (isinstance(queue, dict) and queue.get("draining", False))]
+    if 0 < len(kept) < len(qpus):
+        qpus, queues = [qpus[i] for i in kept], [queues[i] for i in kept]
+    if not all(isinstance(queue, dict) for queue in queues):
+        return [qpus[i % len(qpus)] for i in range(n_jobs)]
+
+    finish = [queue["eta"] for queue in queues]
+    # vQPUs that ran nothing yet are taken as slow as the slowest known one
+    known = [queue["task_seconds"] for queue in queues if queue["task_seconds"] > 0]
+    default_seconds = max(known) if known else 1.0
+    seconds = [queue["task_seconds"] if queue["task_seconds"] > 0 else default_seconds 
+               for queue in queues]
+    assigned = []
+    for _ in range(n_jobs):
+        i = min(range(len(qpus)), key=lambda j: finish[j] + seconds[j])
+        finish[i] += seconds[i]
+        assigned.append(qpus[i])
+    return assigned
+
 
 def run(
         circuits: Union[list[Union[dict, 'QuantumCircuit', CunqaCircuit]], Union[dict, 'QuantumCircuit', CunqaCircuit]], 
         qpus: Union[list[QPU], QPU], 
         param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]]] = None,
+        dispatch: str = "in_order",
         **run_args: Any
-    ) -> Union[list[QJob], QJob]:
+    ) -> Union[list[QJob], QJob, list[ShardedQJob], ShardedQJob]:
     """
     Function responsible of sending circuits to several vQPUs. Each circuit will be sent to each 
     QPU in order, therefore, both lists should be the same size. If they are not, but the number of 
@@ -178,6 +384,15 @@ def run(
                                     parametrized circuit or a dictionary with keys being the 
                                     free parameters' names and its values being its 
                                     corresponding new values.
+        dispatch (str): ``"in_order"`` sends each circuit to the QPU in the same position, and 
+                        ``"least_loaded"`` to the QPU chosen by :py:func:`least_loaded`, which 
+                        may take several of them, so there can be more circuits than QPUs. 
+                        The latter is only for circuits without communications. 
+                        ``"sharded"`` splits the shots of each circuit among all the QPUs, as 
+                        those of a family, each of them with its own seed derived from the 
+                        `seed` run argument, and gives a :py:class:`~cunqa.qjob.ShardedQJob` 
+                        per circuit whose result adds up their counts. It is only for circuits 
+                        without communications that are sampled.
         run_args: any other run arguments and parameters.
     """
 
@@ -214,6 +429,17 @@ def run(
     if not isinstance(qpus, list):
         qpus = [qpus]
 
+    if dispatch == "sharded":
+        return _run_sharded(circuits_ir, qpus, param_values, run_args)
+
+    if dispatch == "least_loaded":
+        if any(_has_comms(circuit) for circuit in circuits_ir):
+            raise ValueError("Circuits with communications are sent to their QPUs in order, "
+                             "the least_loaded dispatch is only for independent circuits.")
+        qpus = least_loaded(qpus, len(circuits_ir))
+    elif dispatch != "in_order":
+        raise ValueError(f"Unknown dispatch {dispatch}, use in_order, least_loaded or sharded.")
+
     # check wether there are enough qpus and create an allocation dict that for every 
     # circuit id has the info of the QPU to which it will be sent
     if len(circuits_ir) > len(qpus):
@@ -249,47 +475,69 @@ def run(
     return qjobs
 
 
-def _acquire_lockfile(lockfile: str, timeout: float = 5.0, retry_interval: float = 0.001):
-    """Acquire atomic lockfile, raises if timeout exceeded."""
-    start = time.time()
-    while True:
-        try:
-            fd = os.open(lockfile, os.O_CREAT | os.O_EXCL | os.O_WRONLY, 0o644)
-            os.close(fd)
-            return  # Lock acquired
-        except FileExistsError:
-            if time.time() - start > timeout:
-                raise TimeoutError(f"Timeout waiting for lockfile: {lockfile}")
-            time.sleep(retry_interval)
-
-def _release_lockfile(lockfile: str):
-    """Release atomic lockfile."""
-    try:
-        os.unlink(lockfile)
-    except FileNotFoundError:
-        pass  # Already released
+def _has_comms(circuit_ir: dict) -> bool:
+    return bool(circuit_ir["sending_to"]) or any(instr["name"] in REMOTE_GATES for instr in circuit_ir["instructions"])
 
-def get_QPUs(co_located: bool = False, family: Optional[str] = None) -> list[QPU]:
-    """
-    Returns :py:class:`~cunqa.qpu.QPU` objects corresponding to the vQPUs raised by the user. It 
-    will use the two args `co_located` and `family` to filter from all the QPUs available.
 
-    Args:
-        co_located (bool): if ``False``, filters by the vQPUs available at the local node.
-        family (str): filters vQPUs by their family name.    
+def _shard_seeds(seed: Optional[int], n_shards: int) -> list[int]:
     """
-    lockfile = QPUS_FILEPATH + ".lock"
-    _acquire_lockfile(lockfile)
-    try:
-        with open(QPUS_FILEPATH, "r") as f:
-            qpus_json = json.load(f)
-            if len(qpus_json) == 0:
-                logger.warning(f"No QPUs were found.")
-                return None
-    finally:
-        _release_lockfile(lockfile)
+    Seeds of the shards of a job, that of the run mixed with the index of each one as SplitMix64 
+    does, so that they are far apart and the counts of the shards are independent.
+    """
+    if seed is None:
+        seed = secrets.randbits(63)
+    mask = (1 << 64) - 1
+    seeds = []
+    for i in range(1, n_shards + 1):
+        z = (seed + i * 0x9E3779B97F4A7C15) & mask
+        z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & mask
+        z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & mask
+        seeds.append((z ^ (z >> 31)) >> 1) # Non negative for the simulators
+    return seeds
+
+
+def _run_sharded(circuits_ir: list[dict], qpus: list[QPU], param_values, run_args: dict) -> Union[list[ShardedQJob], ShardedQJob]:
+    """Sends each circuit to every QPU with a share of its shots, see the `dispatch` of :py:func:`run`."""
+    if any(_has_comms(circuit) for circuit in circuits_ir):
+        raise ValueError("Circuits with communications cannot be sharded, their shots are run "
+                         "together with those of the circuits they communicate with.")
+    unsupported = [arg for arg in ("observables", "retain", "stream_shots", "checkpoint") if run_args.get(arg)]
+    if unsupported:
+        raise ValueError(f"The sharded dispatch only adds up counts, it does not take {unsupported}.")
+
+    run_parameters = dict(run_args)
+    shots = run_parameters.pop("shots", 1024)
+    seed = run_parameters.pop("seed", None)
+    n_shards = min(len(qpus), shots)
+    if n_shards == 0:
+        raise ValueError("The sharded dispatch needs at least one QPU and one shot.")
+
+    sharded_qjobs = []
+    for circuit in circuits_ir:
+        seeds = _shard_seeds(seed, n_shards)
+        shard_shots = split_shots(shots, n_shards)
+        qjobs = [
+            qpu.execute(dict(circuit, id=(circuit["id"], qpu.id)), param_values, shots=n, seed=s, **run_parameters)
+            for qpu, n, s in zip(qpus, shard_shots, seeds)
+        ]
+        sharded_qjobs.append(ShardedQJob(qjobs, [qpu.id for qpu in qpus[:n_shards]], shard_shots, seeds))
+        seed = None if seed is None else seed + 1 # Other shards for the next circuit
+
+    if len(circuits_ir) == 1:
+        return sharded_qjobs[0]
+    return sharded_qjobs
+
+
+def _registered_targets(co_located: bool, family: Optional[str]) -> Optional[dict]:
+    """Entries of the registry that get_QPUs takes, by id, or None if there are none."""
+    qpus_json = read_registry(QPUS_REGISTRY)
+    if len(qpus_json) == 0:
+        logger.warning(f"No QPUs were found.")
+        return None
 
-    # Rest of the function unchanged...
+    # Those being drained take no more tasks, and those on standby wait to be adopted by a qraise
+    qpus_json = {qpu_id: info for qpu_id, info in qpus_json.items() 
+                 if not info.get("draining", False) and "standby" not in info}
     local_node = os.getenv("SLURMD_NODENAME")
     if co_located:
         targets = {
@@ -310,29 +558,75 @@ def get_QPUs(co_located: bool = False, family: Optional[str] = None) -> list[QPU
                     (family is None or info.get("family") == family))
             }
 
-    qpus = [
-        QPU(
-            id = id,
-            backend = info['backend'],
-            device = info['net']['device'],
-            family = info['family'],
-            endpoint = info['net']['endpoint']
-        ) for id, info in targets.items()
-    ]
-
-    if len(qpus) != 0:
-        logger.debug(f"{len(qpus)} QPU objects were created.")
-        return qpus
-    else:
+    if len(targets) == 0:
         logger.warning(f"No QPUs where found with the characteristics provided: "
                        f"co_located={co_located}, family_name={family}.")
         return None
+    return targets
+
+
+def _qpu_of(id: str, info: dict) -> QPU:
+    return QPU(
+        id = id,
+        backend = info['backend'],
+        device = info['net']['device'],
+        family = info['family'],
+        endpoint = info['net']['endpoint'],
+        encodings = info['net'].get('encodings'),
+        local_endpoint = info['net'].get('local_endpoint'),
+        nodename = info['net'].get('nodename')
+    )
+
+
+def get_QPUs(co_located: bool = False, family: Optional[str] = None) -> list[QPU]:
+    """
+    Returns :py:class:`~cunqa.qpu.QPU` objects corresponding to the vQPUs raised by the user. It 
+    will use the two args `co_located` and `family` to filter from all the QPUs available. The 
+    vQPUs being drained (``qdrop --shrink``) are left out.
+
+    Args:
+        co_located (bool): if ``False``, filters by the vQPUs available at the local node.
+        family (str): filters vQPUs by their family name.    
+    """
+    targets = _registered_targets(co_located, family)
+    if targets is None:
+        return None
+
+    qpus = [_qpu_of(id, info) for id, info in targets.items()]
+    logger.debug(f"{len(qpus)} QPU objects were created.")
+    return qpus
+
+
+def refresh_QPUs(qpus: list[QPU], co_located: bool = False, family: Optional[str] = None) -> list[QPU]:
+    """
+    The vQPUs that :py:func:`get_QPUs` would return now, for a family that grows 
+    (``qraise --grow``) or shrinks (``qdrop --shrink``) while it is used. The objects of `qpus` 
+    that are still registered are kept, with their connections, and objects are only created 
+    for the new vQPUs.
+
+        >>> qpus = get_QPUs(family="elastic")
+        >>> ...
+        >>> qpus = refresh_QPUs(qpus, family="elastic")
+
+    Args:
+        qpus (list[~cunqa.qpu.QPU]): vQPUs returned before by :py:func:`get_QPUs`.
+        co_located (bool): as in :py:func:`get_QPUs`.
+        family (str): as in :py:func:`get_QPUs`.
+    """
+    targets = _registered_targets(co_located, family) or {}
+    known = {qpu.id: qpu for qpu in (qpus or [])}
+    refreshed = [known[id] if id in known else _qpu_of(id, info) for id, info in targets.items()]
+    logger.debug(f"{len(refreshed)} QPUs after the refresh, "
+                 f"{sum(1 for id in targets if id not in known)} of them new.")
+    return refreshed
 
 
 def qraise(n, t, *, 
            classical_comm = False, 
+           cc_mpi = False,
            quantum_comm = False,  
            simulator = None, 
+           precision = None,
            backend = None, 
            noise_properties_path = None, 
            no_thermal_relaxation = False,
@@ -342,13 +636,40 @@ def qraise(n, t, *,
            family = None, 
            co_located = True, 
            cores_per_qpu = None, 
+           workers_per_qpu = None, 
+           qpus_per_process = None,
+           queue_depth = None,
+           queue_memory = None,
            mem_per_qpu = None, 
            n_nodes = None, 
            node_list = None, 
            qpus_per_node= None,
            partition=None,
            gpu=False,
-           qmio=False
+           gpus_per_qpu=None,
+           gpu_sharing=None,
+           qpus_per_gpu=None,
+           gpu_qubits=None,
+           mig_profile=None,
+           qmio=False,
+           distributed=None,
+           prewarm=False,
+           result_cache=None,
+           result_cache_ttl=None,
+           retained_states=None,
+           retained_states_ttl=None,
+           checkpoint_dir=None,
+           circuit_store=None,
+           circuit_store_cache=None,
+           numa=False,
+           huge_pages=None,
+           io_cores=None,
+           zmq_io_threads=None,
+           zmq_hwm=None,
+           zmq_tcp_buffer=None,
+           grow=False,
+           standby=False,
+           no_standby=False
         ) -> str:
     """
     Raises vQPUs and returns the family name associated them. This function raises 
@@ -359,9 +680,16 @@ def qraise(n, t, *,
         t (str): maximun time that the classical resources will be reserved for the job. Format: 
                  'D-HH:MM:SS'.
         classical_comm (bool): if ``True``, vQPUs will allow classical communications.
+        cc_mpi (bool): if ``True``, the classical communications between the vQPUs of the job go 
+                       through MPI instead of ZMQ. CUNQA must be compiled with ``USE_MPI_BTW_QPU``.
         quantum_comm (bool): if ``True``, vQPUs will allow quantum communications.
         simulator (str): name of the desired simulator to use. Default is `Aer 
                          <https://github.com/Qiskit/qiskit-aer>`_.
+        precision (str): ``"single"`` or ``"double"``, precision of the amplitudes of the tasks 
+                         that do not set a `precision` of their own. Single precision halves the 
+                         memory of the statevector. Aer and Qsim run both, QuEST the one it was 
+                         compiled with (``QUEST_SINGLE_PRECISION``) and the rest only double. 
+                         Default is that of the simulator.
         backend (str): path to a file containing the backend information.
         noise_properties_path (str): Path to the noise properties json file, only supported for 
                                 simulator Aer. Default: None
@@ -377,14 +705,89 @@ def qraise(n, t, *,
                            nodes.
         cores_per_qpu (str): number of cores per vQPU, the total for the SLURM job will be 
                      `n*cores_per_qpu`.
+        workers_per_qpu (str): number of circuits that each vQPU simulates at the same time. The 
+                               cores of the vQPU are shared among its workers. Only available for 
+                               vQPUs without communications.
+        qpus_per_process (int): number of vQPUs hosted by each process of the job, sharing the 
+                                simulator libraries and the noise model. Only available for vQPUs 
+                                without communications on CPU.
+        queue_depth (int): number of tasks that each vQPU queues at most. Beyond it, the vQPU 
+                           answers right away that it is busy, see 
+                           :py:class:`~cunqa.result.QPUBusyError`.
+        queue_memory (int): MB of tasks that each vQPU queues at most, as `queue_depth`.
         mem_per_qpu (str): memory to allocate for each vQPU in GB, format to use is "XXG".
         n_nodes (str): number of nodes for the SLURM job.
         node_list (str): list of nodes in which the vQPUs will be deployed.
         qpus_per_node (str): sets the number of vQPUs deployed on each node.
         partition (str): partition of the nodes in which the QPUs are going to be executed.
         gpu (bool): enable execution in GPU. CUNQA must be previously compiled to support GPU execution.
+        gpus_per_qpu (int): number of GPUs over which each vQPU splits its statevector, with ``gpu``. 
+                            Not for vQPUs with quantum communications.
+        gpu_sharing (str): how several vQPUs share a GPU, with ``gpu``: ``"mps"`` to run those of a 
+                           GPU at once through CUDA MPS, each with its part of the memory and of the 
+                           SMs, or ``"mig"`` for a MIG slice per vQPU. The vQPUs refuse the tasks 
+                           whose statevector does not fit in their part.
+        qpus_per_gpu (int): vQPUs that share each GPU with ``gpu_sharing="mps"``. If not given, as 
+                            many as fit with ``gpu_qubits``.
+        gpu_qubits (int): qubits of the largest circuits of the vQPUs, from which they are packed 
+                          onto the GPUs, and checked to fit in their part of them.
+        mig_profile (str): profile of the MIG slices, as ``"1g.5gb"``, with ``gpu_sharing="mig"``.
         qmio (bool): deploy QMIO, the quantum computer at CESGA, as a vQPU to interact with it.
+        distributed (int): number of SLURM tasks, a power of two, that share the statevector of a 
+                           single vQPU simulated with QuEST. ``n`` must be 1. CUNQA must be compiled 
+                           with ``QUEST_DISTRIBUTED``, and also with ``QUEST_GPU`` to take a GPU per task 
+                           with ``gpu``.
+        prewarm (bool): if ``True``, each vQPU runs a small circuit on its simulator before it 
+                        registers, so that the first task does not pay for the initialization of 
+                        the simulator (GPU context, QuEST environment...). Not for vQPUs with 
+                        quantum communications.
+        result_cache (int): number of results that each vQPU keeps of the deterministic tasks, those 
+                            with a ``seed`` or of exact expectation values, to answer them at once 
+                            when they are sent again. Off if not given.
+        result_cache_ttl (int): seconds during which a cached result is used, with ``result_cache``.
+        retained_states (int): memory (in GB) that each vQPU takes for the final states of the 
+                               circuits run with ``retain=True``, on which more shots, expectation 
+                               values, marginals or amplitudes are then asked. Off if not given.
+        retained_states_ttl (int): seconds after its last use at which a retained state is dropped, 
+                                   with ``retained_states``.
+        checkpoint_dir (str): directory where the vQPUs keep the checkpoints of the jobs run with 
+                              a ``checkpoint``, ``$STORE/.cunqa/checkpoints`` by default. One on 
+                              the local disk of the nodes is faster, but only the vQPUs of the 
+                              same node resume the jobs checkpointed there.
+        circuit_store (str): directory of the circuits that the jobs run with ``circuit_store`` send 
+                             by their hash, ``$STORE/.cunqa/circuits`` by default. One in 
+                             ``/dev/shm`` keeps them in the memory of the node. The clients write 
+                             to ``CUNQA_CIRCUIT_STORE``, or else to the same default.
+        circuit_store_cache (int): circuits of the store that each vQPU keeps decoded, 8 if not given.
+        numa (bool): if ``True``, the cores of each vQPU are bound within a NUMA domain, its memory 
+                     to that domain and its OpenMP threads to its cores.
+        huge_pages (str): ``"thp"``, ``"2M"`` or ``"1G"``, huge pages on which the vQPUs allocate 
+                          their statevectors: transparent huge pages, or those that the nodes 
+                          reserve of that size. CUNQA and Qsim take all of them, QuEST only 
+                          ``"thp"``.
+        io_cores (int): cores of each SLURM task reserved for the threads that receive the tasks 
+                        of its vQPUs, whose simulations take the rest of the cores.
+        zmq_io_threads (int): threads of the ZMQ context of each vQPU that move its tasks and results, 
+                              one if not given.
+        zmq_hwm (int): messages that the ZMQ socket of each vQPU queues per client before holding 
+                       the next ones, the default of ZMQ if not given.
+        zmq_tcp_buffer (int): KB of the kernel buffers of the TCP connections of each vQPU, those 
+                              of the OS if not given.
+        grow (bool): if ``True``, the `n` vQPUs join the running `family` as a new SLURM job, 
+                     instead of raising a new family. Only for vQPUs without communications. 
+                     The clients take them with :py:func:`refresh_QPUs`.
+        standby (bool): if ``True``, the `n` vQPUs are raised as a standby pool, a SLURM job array 
+                        of a vQPU per task, that are initialized and wait unassigned. The qraise of 
+                        plain vQPUs (without communications, noise, backend or tuning options) of 
+                        the same simulator, device, mode, cores and memory then adopts them at once 
+                        into its family, and the pool raises a new vQPU for each one adopted. The 
+                        adopted vQPUs keep the time left of their jobs. Returns the job of the pool 
+                        without waiting for it.
+        no_standby (bool): if ``True``, new vQPUs are raised even if there are standby vQPUs to 
+                           adopt.
     """
+    if grow and family is None:
+        raise ValueError("The family to grow has to be given.")
     logger.debug("Setting up the requested QPUs...")
     command = f"qraise -n {n} -t {t}"
 
@@ -400,16 +803,28 @@ def qraise(n, t, *,
         command = command + " --fakeqmio"
     if classical_comm:
         command = command + " --classical_comm"
+    if cc_mpi:
+        command = command + " --cc_mpi"
     if quantum_comm:
         command = command + " --quantum_comm"
     if simulator is not None:
         command = command + f" --simulator={str(simulator)}"
+    if precision is not None:
+        command = command + f" --precision={str(precision)}"
     if family is not None:
         command = command + f" --family_name={str(family)}"
     if co_located:
         command = command + " --co-located"
     if cores_per_qpu is not None:
         command = command + f" --cores-per-qpu={str(cores_per_qpu)}"
+    if workers_per_qpu is not None:
+        command = command + f" --workers-per-qpu={str(workers_per_qpu)}"
+    if qpus_per_process is not None:
+        command = command + f" --qpus-per-process={str(qpus_per_process)}"
+    if queue_depth is not None:
+        command = command + f" --queue-depth={str(queue_depth)}"
+    if queue_memory is not None:
+        command = command + f" --queue-memory={str(queue_memory)}"
     if mem_per_qpu is not None:
         command = command + f" --mem-per-qpu={str(mem_per_qpu)}G"
     if n_nodes is not None:
@@ -424,12 +839,56 @@ def qraise(n, t, *,
         command = command + f" --partition={str(partition)}"
     if gpu:
         command = command + " --gpu"
+    if gpus_per_qpu is not None:
+        command = command + f" --gpus-per-qpu={str(gpus_per_qpu)}"
+    if gpu_sharing is not None:
+        command = command + f" --gpu-sharing={str(gpu_sharing)}"
+    if qpus_per_gpu is not None:
+        command = command + f" --qpus-per-gpu={str(qpus_per_gpu)}"
+    if gpu_qubits is not None:
+        command = command + f" --gpu-qubits={str(gpu_qubits)}"
+    if mig_profile is not None:
+        command = command + f" --mig-profile={str(mig_profile)}"
     if qmio:
         command = command + " --qmio"
-
-    if not os.path.exists(QPUS_FILEPATH):
-        with open(QPUS_FILEPATH, "w") as file:
-            file.write("{}")
+    if distributed is not None:
+        command = command + f" --distributed={str(distributed)}"
+    if prewarm:
+        command = command + " --prewarm"
+    if result_cache is not None:
+        command = command + f" --result-cache={str(result_cache)}"
+    if result_cache_ttl is not None:
+        command = command + f" --result-cache-ttl={str(result_cache_ttl)}"
+    if retained_states is not None:
+        command = command + f" --retained-states={str(retained_states)}"
+    if retained_states_ttl is not None:
+        command = command + f" --retained-states-ttl={str(retained_states_ttl)}"
+    if checkpoint_dir is not None:
+        command = command + f" --checkpoint-dir={str(checkpoint_dir)}"
+    if circuit_store is not None:
+        command = command + f" --circuit-store={str(circuit_store)}"
+    if circuit_store_cache is not None:
+        command = command + f" --circuit-store-cache={str(circuit_store_cache)}"
+    if numa:
+        command = command + " --numa"
+    if huge_pages is not None:
+        command = command + f" --huge-pages={str(huge_pages)}"
+    if io_cores is not None:
+        command = command + f" --io-cores={str(io_cores)}"
+    if zmq_io_threads is not None:
+        command = command + f" --zmq-io-threads={str(zmq_io_threads)}"
+    if zmq_hwm is not None:
+        command = command + f" --zmq-hwm={str(zmq_hwm)}"
+    if zmq_tcp_buffer is not None:
+        command = command + f" --zmq-tcp-buffer={str(zmq_tcp_buffer)}"
+    if grow:
+        command = command + " --grow"
+    if standby:
+        command = command + " --standby"
+    if no_standby:
+        command = command + " --no-standby"
+
+    init_registry(QPUS_REGISTRY)
 
     print(f"Requested QPUs with command:\n\t{command}")
 
@@ -455,6 +914,14 @@ def qraise(n, t, *,
     output = cmd_result.stdout.rstrip("\n")
     job_id = output.split(";", 1)[0]
 
+    # Adopted from a standby pool, already registered
+    if first_line.endswith(";standby"):
+        print("QPUs adopted from the standby pool \U00002705")
+        return family if family is not None else str(job_id)
+    if standby:
+        print(f"Standby pool requested, job {job_id}.")
+        return str(job_id)
+
     cmd_getstate = ["squeue", "-h", "-j", job_id, "-o", "%T"]
     
     while True:
@@ -465,11 +932,7 @@ def qraise(n, t, *,
             check = True
         ).stdout.strip()
         if state == "RUNNING":
-            try:     
-                with open(QPUS_FILEPATH, "r") as file:
-                    data = json.load(file)
-            except json.JSONDecodeError:
-                continue
+            data = read_registry(QPUS_REGISTRY)
             count = sum(1 for key in data if key.startswith(job_id))
             if count == n:
                 break
@@ -482,7 +945,8 @@ def qraise(n, t, *,
     return family if family is not None else str(job_id)
     
 
-def qdrop(families: Union[str, list[str]] = [], remove_logs: bool = False):
+def qdrop(families: Union[str, list[str]] = [], remove_logs: bool = False, shrink: Optional[int] = None,
+          timeout: Optional[int] = None):
     """
     Same functionality as the `qdrop` bash command, with the peculiarity that it only takes as 
     argument the vQPU family names (and it does not accept the job ID as the bash command). This is 
@@ -490,8 +954,19 @@ def qdrop(families: Union[str, list[str]] = [], remove_logs: bool = False):
 
     If no families are provided, all vQPUs deployed by the user will be dropped.
 
+    With `shrink`, the family is not dropped but that many of its vQPUs are drained instead: they 
+    finish the tasks they queued and take no more, and the SLURM jobs left with every vQPU drained 
+    are cancelled. :py:func:`refresh_QPUs` leaves them out.
+
+    Otherwise the vQPUs answer the tasks they still queue with a 
+    :py:class:`~cunqa.result.QPUUnavailableError`, so they can be sent to other vQPUs, and leave 
+    before their jobs are cancelled, waiting for them at most `timeout` seconds.
+
     Args:
         families (str): family names of the groups of vQPUs to be dropped.
+        shrink (int): number of vQPUs of the family to drain, for a single family.
+        timeout (int): seconds that the vQPUs get to leave, 10 by default. With 0 the jobs are 
+                       cancelled right away.
     """
     if isinstance(families, str):
         families = [families]
@@ -508,6 +983,14 @@ def qdrop(families: Union[str, list[str]] = [], remove_logs: bool = False):
             family_str += (',' + str(family))
         cmd.append(family_str)
 
+    if shrink is not None:
+        if len(families) != 1:
+            raise ValueError("A single family is shrunk at a time.")
+        cmd.append(f"--shrink={shrink}")
+
+    if timeout is not None:
+        cmd.append(f"--timeout={timeout}")
+
     if remove_logs:
         cmd.append('--rm')
 
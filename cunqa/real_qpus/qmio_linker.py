@@ -11,8 +11,8 @@ import threading
 from queue import Queue
 from typing import Optional
 
-from cunqa.constants import QPUS_FILEPATH, LIBS_DIR
-from cunqa.utils import write_json
+from cunqa.constants import QPUS_REGISTRY, LIBS_DIR
+from cunqa.utils import write_registry_entry
 from cunqa.qclient import json_to_qasm2
 from cunqa.logger import logger
 
@@ -135,8 +135,7 @@ class QMIOLinker:
 
         name = f"{os.getenv('SLURM_JOB_ID')}_{os.getenv('SLURM_TASK_PID')}"
         qmio_config = _get_qmio_config(family, self.endpoint)
-        payload = {name: qmio_config}
-        write_json(QPUS_FILEPATH, payload)
+        write_registry_entry(QPUS_REGISTRY, name, qmio_config)
 
     def run(self):
         """
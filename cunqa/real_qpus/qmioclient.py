@@ -169,6 +169,12 @@ class QMIOFuture:
     
     def valid(self) -> bool:
         return True
+
+    def ready(self) -> bool:
+        return self.socket is None or self.socket.poll(0) != 0
+
+    def wait_for(self, timeout: float) -> bool:
+        return self.socket is None or self.socket.poll(int(timeout * 1000)) != 0
     
     def get(self) -> str:
         if self.socket is not None:
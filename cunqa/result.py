@@ -15,12 +15,38 @@
         {'000':34, '111':66}
         >>> result.time_taken
         0.056
+
+    With the run parameter ``counts_format="binary"`` the vQPU sends the counts as two arrays, 
+    which :py:attr:`~cunqa.result.Result.counts_arrays` gives as NumPy arrays without building 
+    a bit string per outcome. :py:attr:`~cunqa.result.Result.counts` still works, but builds them.
+
+    With the run parameter ``state_format="binary"`` the vQPU sends the states saved with 
+    `.save_state()` as raw doubles instead of JSON text, and :py:attr:`~cunqa.result.Result.statevector` 
+    and :py:attr:`~cunqa.result.Result.density_matrix` give NumPy arrays that view them without 
+    copying. The counts of these results are sent in the JSON.
 """
 import numpy as np
-from typing import Union
+from typing import Union, Optional
 from itertools import accumulate
 from collections import Counter
 
+class QPUBusyError(RuntimeError):
+    """
+    Raised for the tasks that a vQPU refused because its queue was full, see the ``queue_depth`` 
+    and ``queue_memory`` arguments of :py:func:`~cunqa.qpu.qraise`. Its :py:attr:`queue` holds 
+    the load of the vQPU, as :py:attr:`Result.queue`, so the task can be sent to another one.
+    """
+    def __init__(self, message: str, queue: Optional[dict] = None):
+        super().__init__(message)
+        self.queue = queue
+
+class QPUUnavailableError(QPUBusyError):
+    """
+    Raised for the tasks of a vQPU that is leaving, drained or dropped with ``qdrop`` before it ran 
+    them, or whose connection was lost before their results arrived. Unlike a full queue, it does 
+    not clear, so the task is better sent to another vQPU right away.
+    """
+
 class CunqaCounts(Counter):
     """
     Modified Counter that eliminates the word 'Counter' from its string representation.
@@ -28,6 +54,20 @@ class CunqaCounts(Counter):
     def __str__(self):
         return str(dict(self))
 
+def _with_binary_states(value, doubles: np.ndarray):
+    """
+    Replaces the placeholders of the states sent in binary with views of their doubles, shaped 
+    as their JSON arrays would be.
+    """
+    if isinstance(value, dict):
+        if len(value) == 1 and "binary_state" in value:
+            offset, shape = value["binary_state"]["offset"], value["binary_state"]["shape"]
+            return doubles[offset:offset + int(np.prod(shape))].reshape(shape)
+        return {k: _with_binary_states(v, doubles) for k, v in value.items()}
+    if isinstance(value, list):
+        return [_with_binary_states(v, doubles) for v in value]
+    return value
+
 class Result:
     """
     Class to describe the result of a simulation. 
@@ -44,8 +84,16 @@ class Result:
     _result: dict
     id: str
     _registers: dict
+    _binary_counts: Optional[tuple[np.ndarray, np.ndarray, int]]
     
-    def __init__(self, result: dict, circ_id: str, registers: dict):
+    def __init__(
+            self, 
+            result: dict, 
+            circ_id: str, 
+            registers: dict, 
+            binary_counts: Optional[tuple[np.ndarray, np.ndarray, int]] = None,
+            binary_states: Optional[np.ndarray] = None
+    ):
         """
         Initializes the Result class.
 
@@ -56,18 +104,31 @@ class Result:
 
             registers (dict): dictionary specifying the classical registers defined for the circuit. 
             This is neccessary for the correct formating of the counts bit strings.
+
+            binary_counts (tuple): outcomes, counts and number of bits of the outcomes, when the 
+            counts were sent in binary and so are missing from `result`.
+
+            binary_states (np.ndarray): doubles of the states, when they were sent in binary and 
+            so `result` only holds where they are in it.
         """
 
         self._result = {}
         self.id = circ_id
         self._registers = registers
+        self._binary_counts = binary_counts
         
         if result is None or len(result) == 0:
             raise ValueError(f"Empty object passed, result is {None}.")
+        elif "ERROR" in result and result.get("unavailable", False):
+            raise QPUUnavailableError(result["ERROR"], result.get("queue"))
+        elif "ERROR" in result and result.get("busy", False):
+            raise QPUBusyError(result["ERROR"], result.get("queue"))
         elif "ERROR" in result:
             message = result["ERROR"]
             raise RuntimeError(f"Error during simulation, please check availability of QPUs, run "
                                f"arguments syntax and circuit syntax: {message}")
+        elif binary_states is not None:
+            self._result = _with_binary_states(result, binary_states)
         else:
             self._result = result
 
@@ -77,6 +138,9 @@ class Result:
         YELLOW = "\033[33m"
         RESET = "\033[0m"   
         GREEN = "\033[32m"
+        if "expectation_values" in self._result:
+            return (f"{YELLOW}{self.id}:{RESET} {'{'}expectation_values: {self.expectation_values}, "
+                    f"\n\t time_taken: {GREEN}{self.time_taken} s{RESET}{'}'}\n")
         return (f"{YELLOW}{self.id}:{RESET} {'{'}counts: {self.counts}, \n\t "
                f"time_taken: {GREEN}{self.time_taken} s{RESET}{'}'}\n")
 
@@ -106,7 +170,11 @@ class Result:
                 >>> result.counts
                 {'001 11':23, '110 10':77}
         """
-        if "qmio_results" in list(self._result.keys()): 
+        if self._binary_counts is not None:
+            outcomes, values, num_clbits = self._binary_counts
+            counts = {format(outcome, f"0{num_clbits}b"): count 
+                      for outcome, count in zip(outcomes.tolist(), values.tolist())}
+        elif "qmio_results" in list(self._result.keys()): 
             counts = self._result["qmio_results"]["c"] #TODO: More registers? 
         elif "results" in list(self._result.keys()): # aer
             counts = self._result["results"][0]["data"]["counts"]
@@ -126,6 +194,216 @@ class Result:
         return CunqaCounts({' '.join(bitstring[i:j] for i, j in zip(cuts, cuts[1:])): 
                 count for bitstring, count in counts.items()})
 
+    @property
+    def counts_arrays(self) -> Optional[tuple[np.ndarray, np.ndarray]]:
+        """
+        Outcomes and their counts as two ``uint64`` arrays, if the counts were sent in binary, 
+        or None otherwise. Each outcome is its bit string read as an integer, with all the 
+        classical registers together:
+
+                >>> outcomes, counts = result.counts_arrays
+                >>> outcomes, counts
+                (array([0, 7], dtype=uint64), array([34, 66], dtype=uint64))
+        """
+        if self._binary_counts is None:
+            return None
+        return self._binary_counts[0], self._binary_counts[1]
+
+    @property
+    def expectation_values(self) -> list[float]:
+        """
+        Expectation values of the `observables` given as run parameter, in the same order. They 
+        are exact if the circuit saves its state and the simulator returns it, and estimated from 
+        the counts otherwise, measuring each group of qubit-wise commuting terms once:
+
+            >>> qjob = qpu.execute(circuit, observables=["ZZ", [("XX", 0.5), ("ZI", 0.5)]])
+            >>> qjob.result.expectation_values
+            [1.0, 0.498046875]
+        """
+        if "expectation_values" not in self._result:
+            raise RuntimeError("There are no expectation values in the result, run the circuit "
+                               "with the `observables` parameter.")
+        return self._result["expectation_values"]
+
+    @property
+    def gradients(self) -> list[list[float]]:
+        """
+        Gradient of each of the `observables` given as run parameter, with `gradient` set to True: 
+        the derivatives of its expectation value by each parameter of the circuit, in the order 
+        that :py:meth:`~cunqa.qjob.QJob.upgrade_parameters` takes them. The vQPU computes them 
+        exactly from the state by adjoint differentiation, so they take a single job instead of 
+        two circuits per parameter of the parameter-shift rule. Only the Cunqa simulator 
+        computes them:
+
+            >>> qjob = qpu.execute(circuit, observables=["ZZ"], gradient=True)
+            >>> qjob.result.gradients
+            [[-0.479425538604203, 0.0]]
+        """
+        if "gradients" not in self._result:
+            raise RuntimeError("There are no gradients in the result, run the circuit with the "
+                               "`observables` and `gradient` parameters.")
+        return self._result["gradients"]
+
+    @property
+    def queue(self) -> Optional[dict]:
+        """
+        Load of the vQPU when it sent the result: the tasks queued (``"depth"``) and running 
+        (``"running"``), the recent seconds per task (``"task_seconds"``) and tasks per second 
+        (``"throughput"``), and the seconds it needs to get through all of them (``"eta"``). 
+        None for results without it.
+
+            >>> result.queue
+            {'depth': 3, 'running': 1, 'task_seconds': 0.5, 'throughput': 2.0, 'eta': 2.0}
+        """
+        return self._result.get("queue")
+
+    @property
+    def timings(self) -> Optional[dict]:
+        """
+        Seconds that the job spent in each stage on the vQPU, for jobs run with ``timings=True``: 
+        reaching the worker (``"receive"``), waiting in the queue (``"queue"``), decoding the 
+        task (``"parse"``), running it on the backend (``"execute"``), and, for the simulators 
+        that report them, translating the circuit (``"translate"``) and simulating it 
+        (``"simulate"``). JSON results also tell the time taken to encode them (``"serialize"``, 
+        without the time encoding the timings themselves). None for results without them.
+
+            >>> result.timings
+            {'execute': 0.0121, 'parse': 2.1e-05, 'queue': 0.0003, 'simulate': 0.0115, ...}
+        """
+        return self._result.get("timings")
+
+    @property
+    def memory(self) -> Optional[dict]:
+        """
+        Memory of the job on the vQPU: the bytes that its state was estimated to take from its 
+        qubits and method (``"estimated_bytes"``, 0 when they do not tell it) and the peak 
+        resident memory of the vQPU while it ran (``"peak_resident_bytes"``), which also counts 
+        the jobs that ran along with it. vQPUs refuse the jobs whose estimate does not fit in 
+        their memory, so the peak tells the ``--mem-per-qpu`` that a job needs. None for results 
+        without it.
+
+            >>> result.memory
+            {'estimated_bytes': 17179869184, 'peak_resident_bytes': 17402945536}
+        """
+        return self._result.get("memory")
+
+    @property
+    def perf_counters(self) -> Optional[dict]:
+        """
+        Hardware counters of the simulation, for jobs run with ``perf_counters=True`` on vQPUs 
+        built with ``CUNQA_PERF_COUNTERS``: the ``"cycles"``, ``"instructions"`` and last-level 
+        cache misses (``"llc_misses"``) over its ``"seconds"``, with the 
+        ``"instructions_per_cycle"`` and the ``"memory_bandwidth_gbs"`` estimated from the misses. 
+        A low ratio of instructions per cycle with a bandwidth near that of the node means that 
+        the simulation is bound by the memory. None for results without them.
+
+            >>> result.perf_counters
+            {'cycles': 812345678, 'instructions': 401234567, 'instructions_per_cycle': 0.49, ...}
+        """
+        return self._result.get("perf_counters")
+
+    @property
+    def shards(self) -> Optional[list[dict]]:
+        """
+        Shards of a job whose shots were split among several vQPUs, run with 
+        ``dispatch="sharded"``: the vQPU of each one, its shots, its seed and the seconds it 
+        took. The counts of the result are the sum of theirs, and its time taken that of the 
+        slowest. None for results without them.
+
+            >>> result.shards
+            [{'qpu': 'qpu_0', 'seed': 8017, 'shots': 500000, 'time_taken': 2.1}, ...]
+        """
+        return self._result.get("shards")
+
+    @property
+    def transpilation(self) -> Optional[dict]:
+        """
+        What the vQPU did to fit the circuit to its backend, for jobs run with 
+        ``transpile=True``: the gates before and after, the SWAPs inserted to bring together the 
+        qubits of two-qubit gates that are not coupled, and the physical qubit of each qubit 
+        before (``"initial_layout"``) and after them (``"final_layout"``), which the counts, 
+        kept on the classical bits, do not need. With ``"cached_routing"`` the layout and swaps 
+        were those of an earlier circuit with the same gates on the same qubits, only its 
+        parameters different. None for results without it.
+
+            >>> result.transpilation
+            {'cached_routing': False, 'final_layout': [1, 2, 0], 'gates_after': 41, 'gates_before': 12, 'initial_layout': [0, 1, 2], 'swaps': 2}
+        """
+        return self._result.get("transpilation")
+
+    @property
+    def optimization(self) -> Optional[dict]:
+        """
+        Gates of the circuit before and after the vQPU optimized it, for jobs run with 
+        ``optimize=True``: adjacent inverse gates cancel out, consecutive rotations merge, 
+        identities, barriers and the gates that no measurement depends on are dropped, and, on 
+        the simulators that take ``unitary`` gates, chains of single-qubit gates are folded into 
+        one (``"fused_gates"``). For jobs that only return counts, the qubits outside the 
+        lightcone of the measurements are not simulated at all (``"pruned_qubits"``), which 
+        shrinks the state of wide circuits that measure a few qubits. The counts are those of 
+        the original circuit. None for results without it.
+
+            >>> result.optimization
+            {'fused_gates': 3, 'gates_after': 6, 'gates_before': 19, 'pruned_qubits': 2, 'removed_gates': 13}
+        """
+        return self._result.get("optimization")
+
+    @property
+    def simulation_method(self) -> Optional[str]:
+        """
+        Method the vQPU chose for a job run with ``method="automatic"``, the default: 
+        ``"stabilizer"`` for Clifford circuits, ``"matrix_product_state"`` for wide circuits of 
+        gates between neighbouring qubits, ``"sparse"`` for wide circuits with few gates that put 
+        qubits into superposition, ``"density_matrix"`` for small noisy ones and 
+        ``"statevector"`` otherwise, each one only if the simulator of the vQPU runs it. None for 
+        results without it.
+
+            >>> result.simulation_method
+            'stabilizer'
+        """
+        return self._result.get("simulation_method")
+
+    @property
+    def deferred_measurements(self) -> Optional[dict]:
+        """
+        Ancillas that the vQPU added to run a circuit with classically controlled gates on its own
+        measurements as a static one: those gates become controlled by the measured qubits, copied
+        into an ancilla if they change afterwards, and the measurements go to the end, so that the
+        shots are sampled at once instead of simulated one by one. The counts are those of the
+        original circuit. The vQPUs without noise nor quantum communications do it when the
+        ancillas take fewer simulations than the shots, unless the job sets
+        ``defer_measurements=False``. None for results without it.
+
+            >>> result.deferred_measurements
+            {'ancilla_qubits': 1}
+        """
+        return self._result.get("deferred_measurements")
+
+    @property
+    def convergence(self) -> Optional[dict]:
+        """
+        Shots that the vQPU ran of a job sent with ``target_standard_error``, whose shots are then
+        a ceiling, along with the largest standard error of the frequencies of its counts at the
+        end and whether it reached the target. None for results without it.
+
+            >>> result.convergence
+            {'converged': True, 'shots': 3000, 'standard_error': 0.0091}
+        """
+        return self._result.get("convergence")
+
+    @property
+    def retained(self) -> Optional[dict]:
+        """
+        Handle of the final state that the vQPU kept of a job run with ``retain=True``, along with 
+        its qubits, its bytes and the seconds after its last use at which it is dropped (0 for 
+        never). Queries on it go through :py:attr:`~cunqa.qjob.QJob.retained`. None for results 
+        without it.
+
+            >>> result.retained
+            {'handle': '5f0c...', 'num_qubits': 20, 'bytes': 16777216, 'ttl': 600}
+        """
+        return self._result.get("retained")
+
     @property
     def time_taken(self) -> str:
         """
@@ -135,7 +413,7 @@ class Result:
             >>> result.time_taken
             0.056
         """
-        if "qmio_results" in list(self._result.keys()):
+        if "qmio_results" in list(self._result.keys()) or "expectation_values" in self._result:
             time = self._result["time_taken"]
             return time
         elif "results" in list(self._result.keys()): # aer
@@ -144,6 +422,8 @@ class Result:
         elif "counts" in list(self._result.keys()): # munich and cunqa
             time = self._result["time_taken"]          
             return time
+        elif "time_taken" in self._result: # counts sent in binary, or merged from shards
+            return self._result["time_taken"]
         else:
             raise RuntimeError(f"The result format is unknown: no time_taken in it.")
         
@@ -161,7 +441,7 @@ class Result:
                     statevector = {} # Dict because we can store multiple statevecs with labels different from "statevector"
                     for k, v in self._result["results"][0]["metadata"]["result_types"].items():
                         if v == "save_statevector":
-                            statevector[k] = np.array(self._result["results"][0]["data"][k]).view(np.complex128)
+                            statevector[k] = np.asarray(self._result["results"][0]["data"][k]).view(np.complex128)
 
                     if len(statevector) == 1:
                         statevector = list(statevector.values())[0] # Extract the statevector if we only have one
@@ -171,9 +451,9 @@ class Result:
                 statevector = self._result["statevector"]
                 if isinstance(statevector, dict):
                     for k, v in statevector.items():
-                        statevector[k] = np.array(v).view(np.complex128)
+                        statevector[k] = np.asarray(v).view(np.complex128)
                 else:
-                    statevector = np.array(statevector).view(np.complex128)
+                    statevector = np.asarray(statevector).view(np.complex128)
 
             else:
                 raise RuntimeError(f"Statevector not found, try using circuit.save_state() at some "
@@ -201,7 +481,7 @@ class Result:
                 density_matrix = {} # Dict because we can store multiple densmats with labels different from "density_matrix"
                 for k, v in self._result["results"][0]["metadata"]["result_types"].items():
                     if v == "save_density_matrix":
-                        density_matrix[k] = np.array(self._result["results"][0]["data"][k]).view(np.complex128)
+                        density_matrix[k] = np.asarray(self._result["results"][0]["data"][k]).view(np.complex128)
 
                 if len(density_matrix) == 1:
                     density_matrix = list(density_matrix.values())[0] # Extract the statevector if we only have one
@@ -215,3 +495,45 @@ class Result:
                                f"[{type(error).__name__}]: {error}.")
         
         return density_matrix
+
+
+def merge_shards(results: list[Result], circ_id: str, registers: dict, shards: list[dict]) -> Result:
+    """
+    Single result of the shards of a job, with the sum of their counts, which are added on C++ 
+    as integer outcomes when they fit in 64 bits. Its time taken is that of the slowest shard.
+
+    Args:
+        results (list[Result]): results of the shards.
+        circ_id (str): circuit identificator.
+        registers (dict): classical registers of the circuit.
+        shards (list[dict]): vQPU, shots and seed of each shard, in the order of `results`.
+    """
+    from cunqa.counts_and_probs import merge_counts # Implemented on C++ for speed
+
+    raw_counts = []
+    for result in results:
+        if result.counts_arrays is None:
+            raw_counts.append({bitstring.replace(" ", ""): count for bitstring, count in result.counts.items()})
+    num_bits = max([result._binary_counts[2] for result in results if result._binary_counts is not None] + 
+                   [len(bitstring) for counts in raw_counts for bitstring in counts] + [0])
+
+    merged = {
+        "time_taken": max(result.time_taken for result in results),
+        "shards": [dict(shard, time_taken=result.time_taken) for shard, result in zip(shards, results)]
+    }
+    if num_bits > 64:
+        total = Counter()
+        for counts in raw_counts:
+            total.update(counts)
+        merged["counts"] = dict(total)
+        return Result(merged, circ_id=circ_id, registers=registers)
+
+    outcomes, counts = [], []
+    for result in results:
+        if result.counts_arrays is not None:
+            outcomes.append(result.counts_arrays[0]); counts.append(result.counts_arrays[1])
+    for raw in raw_counts:
+        outcomes.append(np.fromiter((int(bitstring, 2) for bitstring in raw), dtype=np.uint64, count=len(raw)))
+        counts.append(np.fromiter(raw.values(), dtype=np.uint64, count=len(raw)))
+    merged_outcomes, merged_counts = merge_counts(outcomes, counts, num_bits)
+    return Result(merged, circ_id=circ_id, registers=registers, binary_counts=(merged_outcomes, merged_counts, num_bits))
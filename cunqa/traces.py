@@ -0,0 +1,79 @@
+"""
+    Merges the traces that the QPUs and executors raised with ``qraise --trace`` write under
+    ``$STORE/.cunqa/traces``, one Chrome trace-event file per process, into a single timeline
+    that Perfetto or ``chrome://tracing`` open.
+
+    The times of each file count from the start of its Slurm job, and its ``process_name`` event
+    carries the offset of that start to the epoch, so that files of different jobs are aligned by
+    shifting them to the earliest start among them.
+"""
+from __future__ import annotations
+
+import os
+import json
+import glob
+from typing import Optional
+
+from cunqa.constants import CUNQA_PATH
+from cunqa.logger import logger
+
+TRACES_DIR = CUNQA_PATH + "/traces"
+
+
+def _read_events(filepath: str) -> list[dict]:
+    """
+    Reads the events of a trace file. A process killed with its job leaves the file without its
+    closing bracket, and the events written until then are kept.
+    """
+    with open(filepath, "r", encoding="utf-8") as f:
+        text = f.read().strip()
+    if not text.endswith("]"):
+        text = text.rstrip(",\n") + "\n]"
+    try:
+        return json.loads(text)
+    except json.JSONDecodeError:
+        logger.warning(f"Skipping unreadable trace file: {filepath}")
+        return []
+
+
+def merge(job_ids: Optional[list[str]] = None, output: Optional[str] = None) -> str:
+    """
+    Merges the trace files of the given Slurm jobs, or all of them, into one.
+
+    Args:
+        job_ids (list[str]): jobs whose traces are merged. By default, every file in the traces directory.
+        output (str): path of the merged trace. By default, ``merged.json`` in the traces directory.
+
+    Return:
+        The path of the merged trace.
+    """
+    filepaths = []
+    if job_ids is None:
+        filepaths = glob.glob(os.path.join(TRACES_DIR, "*.json"))
+    else:
+        for job_id in job_ids:
+            filepaths += glob.glob(os.path.join(TRACES_DIR, f"{job_id}_*.json"))
+    output = output or os.path.join(TRACES_DIR, "merged.json")
+    filepaths = [f for f in filepaths if os.path.abspath(f) != os.path.abspath(output)]
+
+    files = []
+    for filepath in sorted(filepaths):
+        events = _read_events(filepath)
+        offset = next((e["args"].get("clock_offset_us", 0) for e in events
+                       if e.get("ph") == "M" and e.get("name") == "process_name"), 0)
+        files.append((offset, events))
+
+    if not files:
+        logger.warning(f"No trace files were found in {TRACES_DIR}.")
+
+    origin = min((offset for offset, _ in files), default=0)
+    merged = []
+    for offset, events in files:
+        for event in events:
+            if "ts" in event:
+                event["ts"] += offset - origin
+            merged.append(event)
+
+    with open(output, "w", encoding="utf-8") as f:
+        json.dump({"traceEvents": merged, "displayTimeUnit": "ms"}, f)
+    return output
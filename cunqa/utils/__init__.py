@@ -1,2 +1,3 @@
 from cunqa.utils.file_utils import read_json, write_json
-from cunqa.utils.id_utils import generate_id
\ No newline at end of file
+from cunqa.utils.id_utils import generate_id
+from cunqa.utils.registry import init_registry, read_registry, write_registry_entry
\ No newline at end of file
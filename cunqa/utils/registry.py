@@ -0,0 +1,150 @@
+# registry.py
+"""
+Access to the registries where the vQPUs publish their info, with the same backends as the C++
+side (``src/utils/registry.hpp``), chosen with the ``CUNQA_REGISTRY`` environment variable:
+
+- ``"dir"`` (default): a directory with a ``<id>.json`` file per entry.
+- ``"file"``: every entry in a single ``<registry>.json`` file. Its writers take turns through a
+  lockfile and rename the new content over it, so it is read without any lock.
+
+Reads keep what they parsed, and a file is parsed again only when its inode, modification time or
+size change, so repeated reads of an unchanged registry cost a ``stat`` per file.
+"""
+from __future__ import annotations
+
+import json
+import os
+import tempfile
+import time
+
+from cunqa.logger import logger
+
+
+def _backend() -> str:
+    backend = os.getenv("CUNQA_REGISTRY", "dir")
+    if backend not in ("dir", "file"):
+        raise ValueError(f"Unknown registry backend: {backend}")
+    return backend
+
+
+# Parsed files by path, along with the stat they were parsed at
+_parsed: dict[str, tuple[tuple, dict]] = {}
+
+
+def _load(path: str) -> dict:
+    """Contents of the JSON file, parsed again only if it changed. Raises as ``open`` and ``json.load``."""
+    st = os.stat(path)
+    version = (st.st_ino, st.st_mtime_ns, st.st_size)
+    cached = _parsed.get(path)
+    if cached is not None and cached[0] == version:
+        return cached[1]
+    with open(path, "r") as f:
+        content = json.load(f)
+    _parsed[path] = (version, content)
+    return content
+
+
+def _replace(path: str, content: dict) -> None:
+    """Writes the content aside and renames it over the file, so readers never find it partial."""
+    directory, name = os.path.split(path)
+    fd, tmp_path = tempfile.mkstemp(prefix=f".{name}.", suffix=".tmp", dir=directory or ".", text=True)
+    try:
+        with os.fdopen(fd, "w", encoding="utf-8") as tmp_f:
+            json.dump(content, tmp_f, indent=4)
+            tmp_f.flush()
+            os.fsync(tmp_f.fileno())
+        os.replace(tmp_path, path)
+    except BaseException:
+        try:
+            os.remove(tmp_path)
+        except FileNotFoundError:
+            pass
+        raise
+
+
+def _acquire_lockfile(lockfile: str, timeout: float = 5.0, retry_interval: float = 0.001):
+    """Acquire atomic lockfile, raises if timeout exceeded."""
+    start = time.time()
+    while True:
+        try:
+            fd = os.open(lockfile, os.O_CREAT | os.O_EXCL | os.O_WRONLY, 0o644)
+            os.close(fd)
+            return  # Lock acquired
+        except FileExistsError:
+            if time.time() - start > timeout:
+                raise TimeoutError(f"Timeout waiting for lockfile: {lockfile}")
+            time.sleep(retry_interval)
+
+
+def _release_lockfile(lockfile: str):
+    """Release atomic lockfile."""
+    try:
+        os.unlink(lockfile)
+    except FileNotFoundError:
+        pass  # Already released
+
+
+def init_registry(registry: str) -> None:
+    """Creates the registry if it does not exist yet."""
+    if _backend() == "dir":
+        os.makedirs(registry, exist_ok=True)
+    elif not os.path.exists(registry + ".json"):
+        with open(registry + ".json", "w") as file:
+            file.write("{}")
+
+
+def read_registry(registry: str) -> dict:
+    """
+    Returns every entry of the registry by id. Entries being written or removed at the same time
+    are skipped, and a missing or corrupted registry is empty. The entries are shared with the
+    later reads, so they are not to be modified.
+    """
+    if _backend() == "file":
+        try:
+            return dict(_load(registry + ".json"))
+        except (FileNotFoundError, json.JSONDecodeError):
+            return {}
+
+    entries = {}
+    try:
+        names = os.listdir(registry)
+    except FileNotFoundError:
+        return entries
+
+    for name in names:
+        if name.startswith(".") or not name.endswith(".json"):
+            continue
+        try:
+            entries[name[:-len(".json")]] = _load(os.path.join(registry, name))
+        except (FileNotFoundError, json.JSONDecodeError):
+            continue
+    # Those of the entries removed are not kept
+    for path in list(_parsed):
+        if os.path.dirname(path) == registry and os.path.basename(path) not in names:
+            del _parsed[path]
+    return entries
+
+
+def write_registry_entry(registry: str, id: str, entry: dict) -> None:
+    """Writes, or replaces, the entry of the given id."""
+    if _backend() == "file":
+        lockfile = registry + ".json.lock"
+        _acquire_lockfile(lockfile)
+        try:
+            try:
+                entries = _load(registry + ".json")
+            except (FileNotFoundError, json.JSONDecodeError):
+                entries = {}
+            entries = dict(entries)
+            entries[id] = entry
+            _replace(registry + ".json", entries)
+        finally:
+            _release_lockfile(lockfile)
+        return
+
+    os.makedirs(registry, exist_ok=True)
+    try:
+        _replace(os.path.join(registry, id + ".json"), entry)
+    except Exception as e:
+        logger.exception(f"Failed writing the registry entry {id}: {e}")
+        raise
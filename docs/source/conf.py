@@ -29,7 +29,7 @@ os.environ['STORE'] = ''
 
 mock_constants = types.ModuleType("cunqa.constants")
 mock_constants.LIBS_DIR = ""
-mock_constants.QPUS_FILEPATH = ""
+mock_constants.QPUS_REGISTRY = ""
 mock_constants.CUNQA_PATH = ""
 mock_constants.REMOTE_GATES = ""
 sys.modules["cunqa.constants"] = mock_constants
@@ -72,6 +72,7 @@ add_function_parentheses = False
 
 napoleon_google_docstring = True
 napoleon_numpy_docstring = False
+napoleon_custom_sections = [("Run parameters", "params_style")]
 add_module_names = False
 
 
@@ -3,6 +3,7 @@
 
 #include "comm/client.hpp"
 #include "utils/json.hpp"
+#include "utils/registry.hpp"
 #include "utils/constants.hpp"
 
 std::string circuit1 = R"(
@@ -70,25 +71,9 @@ std::string circuit2 = R"(
 using namespace std::string_literals;
 using namespace cunqa::comm;
 
-cunqa::JSON read_file(const std::string& filename)
-{
-    std::ifstream in(filename);
-
-    if (!in.is_open()) {
-        throw std::runtime_error("Error opening the communications file.");
-    }
-
-    cunqa::JSON j;
-    if (in.peek() != std::ifstream::traits_type::eof())
-        in >> j;
-    in.close();
-    return j;
-}
-
-
 int main()
 {
-    cunqa::JSON qpus = read_file(cunqa::constants::QPUS_FILEPATH);
+    cunqa::JSON qpus = cunqa::open_registry(cunqa::constants::QPUS_REGISTRY)->read();
 
     std::vector<Client> clients(3);
     std::vector<std::string> circuits{circuit1, circuit2, std::string()};
@@ -4,11 +4,13 @@
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <vector>
 #include <optional>
 
 #include "quantum_task.hpp"
 
 #include "utils/json.hpp"
+#include "utils/helpers/result_writer.hpp"
 
 namespace cunqa {
 namespace sim {
@@ -19,6 +21,42 @@ public:
     virtual inline JSON execute(const QuantumTask& quantum_task) const = 0;
     virtual JSON to_json() const = 0;
 
+    // Writes the result into the reply. Backends whose simulators keep the counts as integers
+    // override it to write them without building them as JSON
+    virtual void execute_into(const QuantumTask& quantum_task, ResultWriter& writer) const
+    {
+        writer.write(execute(quantum_task));
+    }
+
+    // Runs the circuit once per parameter vector of the pending batch. Backends able to reuse 
+    // the simulator-native circuit between parameter sets can override it
+    virtual JSON execute_batch(QuantumTask& quantum_task) const
+    {
+        JSON results = JSON::array();
+        for (const auto& params : quantum_task.params_batch) {
+            quantum_task.assign_params(params);
+            results.push_back(execute(quantum_task));
+        }
+        return {{"batch", results}};
+    }
+
+    // Runs each circuit of a batch of tasks, in order. Backends whose simulators take several
+    // circuits at once override it to simulate them together
+    virtual JSON execute_tasks(const std::vector<QuantumTask>& quantum_tasks) const
+    {
+        JSON results = JSON::array();
+        for (const auto& quantum_task : quantum_tasks)
+            results.push_back(execute(quantum_task));
+        return {{"batch", results}};
+    }
+
+    // Expectation values of the observables of the config and their gradient by the parameters of
+    // the circuit. Backends whose simulators compute it from the state override it
+    virtual JSON execute_gradient([[maybe_unused]] const QuantumTask& quantum_task) const
+    {
+        return {{"ERROR", "The gradients are only computed by the vQPUs without communications."}};
+    }
+
     JSON config;
 };
 
@@ -23,6 +23,7 @@ struct CCConfig {
     std::vector<std::string> basis_gates;
     std::string custom_instructions;
     std::vector<std::string> gates;
+    JSON simulator_config = JSON::object(); // Options of the simulator, optional in the backend file
 
     void set_basis_gates(const std::vector<std::string> basis_gates)
     {
@@ -39,6 +40,8 @@ struct CCConfig {
         j.at("basis_gates").get_to(obj.basis_gates);
         j.at("custom_instructions").get_to(obj.custom_instructions);
         j.at("gates").get_to(obj.gates);
+        if (j.contains("simulator_config"))
+            j.at("simulator_config").get_to(obj.simulator_config);
     }
 
     friend void to_json(JSON& j, const CCConfig& obj)
@@ -52,6 +55,7 @@ struct CCConfig {
             {"basis_gates", obj.basis_gates}, 
             {"custom_instructions", obj.custom_instructions},
             {"gates", obj.gates},
+            {"simulator_config", obj.simulator_config},
         };
     }
 };
@@ -74,6 +78,11 @@ public:
         return simulator_->execute(*this, quantum_task);
     }
 
+    inline void execute_into(const QuantumTask& quantum_task, ResultWriter& writer) const override
+    {
+        simulator_->execute_into(*this, quantum_task, writer);
+    }
+
     // TODO: Achieve this using the JSON adl serializer
     JSON to_json() const override 
     {
@@ -23,6 +23,7 @@ struct SimpleConfig {
     std::vector<std::string> basis_gates;
     std::string custom_instructions;
     std::vector<std::string> gates;
+    JSON simulator_config = JSON::object(); // Options of the simulator, optional in the backend file
     JSON noise_model = {};
     std::string noise_properties_path;
     std::string noise_path;
@@ -42,6 +43,8 @@ struct SimpleConfig {
         j.at("basis_gates").get_to(obj.basis_gates);
         j.at("custom_instructions").get_to(obj.custom_instructions);
         j.at("gates").get_to(obj.gates);
+        if (j.contains("simulator_config"))
+            j.at("simulator_config").get_to(obj.simulator_config);
         j.at("noise_model").get_to(obj.noise_model);
         j.at("noise_properties_path").get_to(obj.noise_properties_path);
         j.at("noise_path").get_to(obj.noise_path);
@@ -58,6 +61,7 @@ struct SimpleConfig {
             {"basis_gates", obj.basis_gates}, 
             {"custom_instructions", obj.custom_instructions},
             {"gates", obj.gates},
+            {"simulator_config", obj.simulator_config},
             {"noise_model", obj.noise_path},
             {"noise_properties_path", obj.noise_properties_path}
         };
@@ -74,7 +78,9 @@ public:
         simulator_{std::move(simulator)}
     { 
         config = simple_config;
-        config["noise_model"] = simple_config.noise_model; // Not in to_json() to avoid the writing on qpus.json
+        // The simulator keeps the noise model parsed into its own structures, so it is not kept as JSON
+        simulator_->configure(*this);
+        this->simple_config.noise_model = JSON();
     }
 
     SimpleBackend(SimpleBackend& simple_backend) = default;
@@ -84,6 +90,26 @@ public:
         return simulator_->execute(*this, quantum_task);
     }
 
+    inline void execute_into(const QuantumTask& quantum_task, ResultWriter& writer) const override
+    {
+        simulator_->execute_into(*this, quantum_task, writer);
+    }
+
+    inline JSON execute_batch(QuantumTask& quantum_task) const override
+    {
+        return simulator_->execute_batch(*this, quantum_task);
+    }
+
+    inline JSON execute_gradient(const QuantumTask& quantum_task) const override
+    {
+        return simulator_->execute_gradient(*this, quantum_task);
+    }
+
+    inline JSON execute_tasks(const std::vector<QuantumTask>& quantum_tasks) const override
+    {
+        return simulator_->execute_tasks(*this, quantum_tasks);
+    }
+
     // TODO: Achieve this using the JSON adl serializer
     JSON to_json() const override 
     {
@@ -12,8 +12,8 @@ public:
     AerComputationAdapter(const QuantumTask quantum_task) : 
         quantum_tasks{quantum_task}
     { }
-    AerComputationAdapter(const std::vector<QuantumTask> quantum_tasks) : 
-        quantum_tasks{quantum_tasks}
+    AerComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
@@ -1,11 +1,9 @@
 
-#include <unordered_map>
-#include <stack>
-#include <queue>
+#include <span>
 #include <chrono>
-#include <functional>
 #include <cstdlib>
 #include <vector>
+#include <memory>
 #include <optional>
 
 #include "aer_simulator_adapter.hpp"
@@ -22,813 +20,194 @@
 
 #include "utils/constants.hpp"
 
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/matrix_cache.hpp"
+#include "backends/simulators/dynamic_engine.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+#include "backends/simulators/mps_options.hpp"
+#include "utils/helpers/stage_timings.hpp"
+
 #include "logger.hpp"
 
 namespace {
 using namespace cunqa;
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
-struct CommunicationQubitsPair {
-    int q0;
-    int q1;
-    bool idle = true;
-    std::string sendr_qpu; // QSEND and EXPOSE
-    std::string recvr_qpu; // QRECV and RCONTROL
-    std::string qcomm_protocol;
-    int label;
-};
-
-struct TaskState {
-    std::string id;
-    int local_n_clbits = 0;
-    std::vector<constants::CUNQAInstruction>::const_iterator it, end;
-    unsigned long zero_qubit = 0;
-    unsigned long zero_clbit = 0;
-    bool finished = false;
-    bool blocked_by_teledata = false;
-    bool blocked_by_telegate = false;
-    bool blocked_by_cc = false;
-    bool cat_entangled = false;
-};
-
-struct GlobalState {
-    unsigned long n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::queue<uint_t>> qc_meas_td;
-    std::unordered_map<std::string, std::queue<uint_t>> qc_meas_tg;
-    std::vector<CommunicationQubitsPair> communication_pairs;
-    std::unordered_map<LocalCCIDs, std::queue<uint_t>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
-};
-
-std::vector<int> find_idle_communication_pairs(GlobalState& G, const size_t n_pairs)
+// Unitary in the column-major order of the matrices of Aer, controlled by an extra qubit, the
+// first one of the instruction, if it is a CUNITARY
+matrix<complex_t> aer_unitary(const CUNQAMatrix& cunqa_matrix, const bool controlled)
 {
-    std::vector<int> indices_idle_pairs;
-    size_t count = 0;
-    for (int index = 0; index < G.communication_pairs.size() && count < n_pairs; index++) {
-        if (G.communication_pairs[index].idle) {
-            indices_idle_pairs.push_back(index);
-            count++;
-        } 
-    } 
-
-    if (count < n_pairs) 
-        return std::vector<int>();
-
-    for (const auto& index : indices_idle_pairs) {
-        G.communication_pairs[index].idle = false;
-    }
-
-    return indices_idle_pairs;
+    const size_t dim = cunqa_matrix.size();
+    const size_t offset = controlled ? dim : 0;
+    const size_t aer_dim = dim + offset;
+
+    matrix<complex_t> aer_matrix(aer_dim, aer_dim);
+    // Identity on the block where the control is |0>
+    for (size_t i = 0; i < offset; i++)
+        aer_matrix(i, i) = complex_t(1.0, 0.0);
+    for (size_t i = 0; i < dim; i++)
+        for (size_t j = 0; j < dim; j++)
+            aer_matrix(offset + i, offset + j) = complex_t(cunqa_matrix[i][j][0], cunqa_matrix[i][j][1]);
+    return aer_matrix;
 }
 
-std::vector<int> find_my_communication_pairs(const GlobalState& G, const std::string& sendr, const std::string recvr, const std::string qcomm_protocol, size_t n_pairs = 0)
-{
-    std::vector<int> comm_pairs;
-    size_t count = 0;
-    if (n_pairs == 0) n_pairs = G.communication_pairs.size();
-    for (int index = 0; index < G.communication_pairs.size(); index++) {
-        if (count == n_pairs) return comm_pairs;
-        if (!G.communication_pairs[index].idle &&
-            G.communication_pairs[index].sendr_qpu == sendr && 
-            G.communication_pairs[index].recvr_qpu == recvr &&
-            G.communication_pairs[index].qcomm_protocol == qcomm_protocol) {
-                comm_pairs.push_back(index);
-                count++;
-        } 
-    } 
-
-    return comm_pairs;
-}
+// Unitaries and diagonals of the tasks converted once for all the shots
+struct AerMatrices {
+    sim::MatrixCache<matrix<complex_t>> unitaries; // UNITARY and CUNITARY
+    sim::MatrixCache<cvector_t> diagonals;
 
-std::unordered_map<std::string, std::string> execute_shot_(
-    AER::AerState* state, 
-    std::vector<StructuredQuantumTask>& st_qtasks,
-    comm::ClassicalChannel* classical_channel,
-    const bool allows_qc,
-    const size_t& n_comm_qubits
-)
-{
-    std::unordered_map<std::string, TaskState> Ts;
-    GlobalState G;
-
-    for (const auto &quantum_task : st_qtasks) {
-        TaskState T;
-        T.id = quantum_task.id;
-        T.local_n_clbits = quantum_task.n_clbits;
-        T.zero_qubit = G.n_qubits;
-        T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.instructions.begin();
-        T.end = quantum_task.instructions.end();
-        T.blocked_by_teledata = false;
-        T.blocked_by_telegate = false;
-        T.blocked_by_cc = false;
-        T.finished = false;
-        Ts[quantum_task.id] = T;
-        
-        G.n_qubits += quantum_task.n_qubits;
-        G.n_clbits += quantum_task.n_clbits;
-    }
-    
-    // Here we add the communication qubits
-    if (n_comm_qubits != 0) {
-        G.n_qubits += n_comm_qubits;
-        for (int i = 0; i < n_comm_qubits; i+=2) {
-            CommunicationQubitsPair cqp = {
-                .q0 = G.n_qubits - n_comm_qubits + i,
-                .q1 = G.n_qubits - n_comm_qubits + i + 1
-            };
-            G.communication_pairs.push_back(cqp);
+    explicit AerMatrices(const std::vector<StructuredQuantumTask>& st_qtasks)
+    {
+        for (const auto& quantum_task : st_qtasks) {
+            unitaries.add(quantum_task.instructions, {constants::UNITARY, constants::CUNITARY}, [](const CUNQAInstruction& inst) {
+                return aer_unitary(inst.matrix[0], inst.type == constants::CUNITARY);
+            });
+            diagonals.add(quantum_task.instructions, {constants::DIAGONAL}, [](const CUNQAInstruction& inst) {
+                cvector_t aer_diagonal;
+                sim::convert_cunqadiagonal_to_aerdiagonal(inst.diagonal[0], aer_diagonal);
+                return aer_diagonal;
+            });
         }
     }
+};
 
-    auto generate_entanglement_ = [&](const size_t n_pairs) {
-        std::vector<int> indices = find_idle_communication_pairs(G, n_pairs);
+// Qubits of the whole state as the registers of AerState
+inline reg_t aer_qubits(std::span<const int> qubits)
+{
+    return reg_t(qubits.begin(), qubits.end());
+}
 
-        if (!indices.empty()) {
-            for (auto& index : indices) {
-                state->apply_reset({static_cast<unsigned long>(G.communication_pairs[index].q1)});
-                state->apply_reset({static_cast<unsigned long>(G.communication_pairs[index].q0)});
-                state->apply_h(G.communication_pairs[index].q0);
-                state->apply_mcx({static_cast<unsigned long>(G.communication_pairs[index].q0), static_cast<unsigned long>(G.communication_pairs[index].q1)});
-            }
-        }
+// The state of a shot worker as the backend of the dynamic engine
+struct AerBackend {
+    AER::AerState* state;
+    const AerMatrices& matrices;
 
-        return indices;
-    };
+    using Gate = void (*)(AerBackend&, const CUNQAInstruction&, std::span<const int>);
 
+    inline int measure(const int qubit) { return state->apply_measure({static_cast<uint_t>(qubit)}); }
+    inline void reset(const int qubit) { state->apply_reset({static_cast<uint_t>(qubit)}); }
+    inline void x(const int qubit) { state->apply_x(qubit); }
+    inline void z(const int qubit) { state->apply_z(qubit); }
+    inline void h(const int qubit) { state->apply_h(qubit); }
+    inline void cx(const int control, const int target) { state->apply_mcx({static_cast<uint_t>(control), static_cast<uint_t>(target)}); }
+    inline void swap(const int a, const int b) { state->apply_mcswap({static_cast<uint_t>(a), static_cast<uint_t>(b)}); }
+    // Execute operations to empty the buffer
+    inline void flush() { state->flush_ops(); }
 
-    std::function<void(TaskState&, const std::optional<constants::CUNQAInstruction>&, const std::vector<int>)> apply_next_instr = 
-        [&](TaskState& T, const std::optional<constants::CUNQAInstruction>& instruction = std::nullopt, const std::vector<int> comm_indices = {}) 
+    static Gate gate(const CUNQAInstruction& inst)
     {
-        const CUNQAInstruction inst = !instruction.has_value() ? *T.it : instruction.value();
-        auto inst_type = INSTRUCTIONS_MAP.at(inst.name);
-
-        switch (inst_type)
-        {
-        case constants::MEASURE:
-        {
-            uint_t measurement = state->apply_measure({inst.qubits[0] + T.zero_qubit});
-            G.creg[inst.clbits[0] + T.zero_clbit] = (measurement == 1);
-            break;
-        }
-        case constants::COPY:
+        switch (inst.type)
         {
-            if(inst.l_clbits.size() != inst.r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < inst.l_clbits.size(); ++i)
-                G.creg[inst.l_clbits[i] + T.zero_clbit] = G.creg[inst.r_clbits[i] + T.zero_clbit];
-                
-            break;
-        }
         case constants::X:
-            state->apply_x(inst.qubits[0] + T.zero_qubit);
-            break;
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_x(qubits[0]); };
         case constants::Y:
-            state->apply_y(inst.qubits[0] + T.zero_qubit);
-            break;
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_y(qubits[0]); };
         case constants::Z:
-            state->apply_z(inst.qubits[0] + T.zero_qubit);
-            break;
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_z(qubits[0]); };
         case constants::H:
-            state->apply_h(inst.qubits[0] + T.zero_qubit);
-            break;
-        case constants::SX:
-            state->apply_mcsx({inst.qubits[0] + T.zero_qubit});
-            break;
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_h(qubits[0]); };
         case constants::RESET:
-            state->apply_reset({inst.qubits[0] + T.zero_qubit});
-            break;
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.reset(qubits[0]); };
+        case constants::U3:
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.state->apply_u(qubits[0], inst.params[0], inst.params[1], inst.params[2]);
+            };
+        case constants::SX:
+        case constants::CSX:
+        case constants::MCSX:
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_mcsx(aer_qubits(qubits)); };
         case constants::RX:
-        {
-            state->apply_mcrx({inst.qubits[0] + T.zero_qubit}, inst.params[0]);
-            break;
-        }
+        case constants::CRX:
+        case constants::MCRX:
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.state->apply_mcrx(aer_qubits(qubits), inst.params[0]); };
         case constants::RY:
-        {
-            state->apply_mcry({inst.qubits[0] + T.zero_qubit}, inst.params[0]);
-            break;
-        }
+        case constants::CRY:
+        case constants::MCRY:
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.state->apply_mcry(aer_qubits(qubits), inst.params[0]); };
         case constants::RZ:
-        {
-            state->apply_mcrz({inst.qubits[0] + T.zero_qubit}, inst.params[0]);
-            break;
-        }
-        case constants::U3:
-        {
-            state->apply_u(inst.qubits[0] + T.zero_qubit, inst.params[0], inst.params[1], inst.params[2]);
-            break;
-        }
+        case constants::CRZ:
+        case constants::MCRZ:
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.state->apply_mcrz(aer_qubits(qubits), inst.params[0]); };
         case constants::SWAP:
-        {
-            state->apply_mcswap({inst.qubits[0] + T.zero_qubit, inst.qubits[1] + T.zero_qubit});
-            break;
-        }
+        case constants::CSWAP:
+        case constants::MCSWAP:
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_mcswap(aer_qubits(qubits)); };
         case constants::CX:
         case constants::MCX:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcx(unsigned_qubits);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_mcx(aer_qubits(qubits)); };
         case constants::CY:
         case constants::MCY:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcy(unsigned_qubits);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_mcy(aer_qubits(qubits)); };
         case constants::CZ:
         case constants::MCZ:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcz(unsigned_qubits);
-            break;
-        }
-        case constants::CSX:
-        case constants::MCSX:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcsx(unsigned_qubits);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.state->apply_mcz(aer_qubits(qubits)); };
         case constants::CP:
         case constants::MCP:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcphase(unsigned_qubits, inst.params[0]);
-            break;
-        }
-        case constants::CRX:
-        case constants::MCRX:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcrx(unsigned_qubits, inst.params[0]);
-            break;
-        }
-        case constants::CRY:
-        case constants::MCRY:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcry(unsigned_qubits, inst.params[0]);
-            break;
-        }
-        case constants::CRZ:
-        case constants::MCRZ:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcrz(unsigned_qubits, inst.params[0]);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.state->apply_mcphase(aer_qubits(qubits), inst.params[0]); };
         case constants::CU:
         case constants::MCU:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcu(unsigned_qubits, inst.params[0], inst.params[1], inst.params[2], inst.params[3]);
-            break;
-        }
-        case constants::CSWAP:
-        case constants::MCSWAP:
-        {
-            reg_t unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-            state->apply_mcswap(unsigned_qubits);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.state->apply_mcu(aer_qubits(qubits), inst.params[0], inst.params[1], inst.params[2], inst.params[3]);
+            };
         case constants::GLOBALP:
-        {
-            state->apply_global_phase(inst.params[0]);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int>) { b.state->apply_global_phase(inst.params[0]); };
         case constants::UNITARY:
-        {
-            auto cunqa_matrix = inst.matrix[0];
-            size_t dim = cunqa_matrix.size();
-
-            // Fill in column-major order as required by the matrix class
-            CUNQAComplexVector matrix_data(dim * dim);
-            for (size_t i = 0; i < dim; i++)
-                for (size_t j = 0; j < dim; j++)
-                    matrix_data[j * dim + i] = complex_t(cunqa_matrix[i][j][0], cunqa_matrix[i][j][1]);
-
-            // copy_from_buffer actually copies the data, avoiding dangling pointer
-            matrix<complex_t> aer_matrix = matrix<complex_t>::copy_from_buffer(dim, dim, matrix_data.data());
-
-            reg_t unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::reverse(unsigned_qubits.begin(), unsigned_qubits.end());
-            state->apply_unitary(unsigned_qubits, aer_matrix);
-            break;
-        }
         case constants::CUNITARY:
-        {
-            auto cunqa_matrix = inst.matrix[0];
-            size_t dim = cunqa_matrix.size();
-            size_t ctrl_dim = 2 * dim;
-
-            // Fill controlled matrix in column-major order
-            CUNQAComplexVector ctrl_matrix_data(ctrl_dim * ctrl_dim, complex_t(0.0, 0.0));
-
-            // Top-left block: Identity (control = |0>), column-major: j * ctrl_dim + i
-            for (size_t i = 0; i < dim; i++) {
-                ctrl_matrix_data[i * ctrl_dim + i] = complex_t(1.0, 0.0);
-            }
-
-            // Bottom-right block: U (control = |1>), column-major: j * ctrl_dim + i
-            for (size_t j = 0; j < dim; j++) {
-                for (size_t i = 0; i < dim; i++) {
-                    ctrl_matrix_data[(dim + j) * ctrl_dim + (dim + i)] = complex_t(cunqa_matrix[i][j][0], cunqa_matrix[i][j][1]);
-                }
-            }
-
-            // copy_from_buffer copies the data, avoiding dangling pointer
-            matrix<complex_t> aer_ctrl_matrix = matrix<complex_t>::copy_from_buffer(ctrl_dim, ctrl_dim, ctrl_matrix_data.data());
-
-            reg_t unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::reverse(unsigned_qubits.begin(), unsigned_qubits.end());
-
-            state->apply_unitary(unsigned_qubits, aer_ctrl_matrix);
-            break;
-        }
+            // The control of a CUNITARY is its first qubit, the highest one of the matrix once reversed
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                reg_t unsigned_qubits(qubits.rbegin(), qubits.rend());
+                b.state->apply_unitary(unsigned_qubits, b.matrices.unitaries.at(inst));
+            };
         case constants::DIAGONAL:
-        {
-            auto cunqa_diagonal = inst.diagonal[0];
-            AER::cvector_t aer_diagonal;
-            sim::convert_cunqadiagonal_to_aerdiagonal(cunqa_diagonal, aer_diagonal);
-            reg_t unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            state->apply_diagonal_matrix(unsigned_qubits, aer_diagonal);
-            break;
-        }
+            return [](AerBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.state->apply_diagonal_matrix(aer_qubits(qubits), b.matrices.diagonals.at(inst));
+            };
         case constants::MULTIPLEXER:
-        {
-            LOGGER_ERROR("Multiplexer instruction is not supported in CUNQA-AER");
-            break;
-        }
-        case constants::SEND:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[inst.qpus[0]].id
-                };  
-                for (auto& clbit : inst.clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
-                }
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    classical_channel->send_measure(G.creg[clbit + T.zero_clbit], inst.qpus[0]);
-                }
-            }
-            break;
-        }
-        case constants::RECV:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[inst.qpus[0]].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
-                    state->flush_ops(); // Execute operations to empty the buffer 
-                    for (const auto& clbit: inst.clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
-                    }
-                    T.blocked_by_cc = false;
-                } else {
-                    T.blocked_by_cc = true;
-                }   
-            } else {
-                state->flush_ops(); // Execute operations to empty the buffer 
-                for (const auto& clbit: inst.clbits) {
-                    int measurement = classical_channel->recv_measure(inst.qpus[0]);
-                    G.creg[clbit + T.zero_clbit] = (measurement == 1);
-                }
-            }
-            break;
-        }
-        case constants::CIF:
-        {
-            bool init = (static_cast<bool>(inst.condition)) ? G.creg[inst.clbits[0] + T.zero_clbit] : !G.creg[inst.clbits[0] + T.zero_clbit];
-            // Applies the specified operation to the sequence of bits provided
-            // If there is only one value, result = G.creg[inst.clbits[0] + T.zero_clbit] when checking inst.condition == result
-            bool result = std::accumulate(inst.clbits.begin() + 1, inst.clbits.end(), 
-                           init,
-                           [&](bool acc, int clbit) { 
-                               return constants::cif_ops[inst.operation](acc, G.creg[clbit + T.zero_clbit]); 
-                           });
-            result = (static_cast<bool>(inst.condition)) ? result : !result;
-
-            if (static_cast<bool>(inst.condition) == result) {
-                for(const auto& sub_inst: inst.instructions) {
-                    apply_next_instr(T, sub_inst, {});
-                }
-            }
-            break;
-        }
-        case constants::QSEND:
-        {
-            std::vector<int> indices = generate_entanglement_(1);
-            if (indices.empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            T.blocked_by_teledata = false;
-            int index = indices[0];
-            G.communication_pairs[index].qcomm_protocol = "teledata";
-
-            // CX to the entangled pair
-            state->apply_mcx({inst.qubits[0] + T.zero_qubit, static_cast<unsigned long>(G.communication_pairs[index].q0)});
-
-            // H to the sent qubit
-            state->apply_h(inst.qubits[0] + T.zero_qubit);
-
-            uint_t result = state->apply_measure({inst.qubits[0] + T.zero_qubit});
-            G.qc_meas_td[T.id].push(result);
-            G.qc_meas_td[T.id].push(state->apply_measure({static_cast<unsigned long>(G.communication_pairs[index].q0)}));
-
-            if (result) {
-                state->apply_reset({inst.qubits[0] + T.zero_qubit});
-            }
-
-            // Unlock QRECV
-            Ts[inst.qpus[0]].blocked_by_teledata = false;
-
-            // Update communication pair
-            G.communication_pairs[index].sendr_qpu = T.id;
-            G.communication_pairs[index].recvr_qpu = inst.qpus[0];
-
-            break;
-        }
-        case constants::QRECV:
-        {
-            if (!G.qc_meas_td.contains(inst.qpus[0]) || G.qc_meas_td[inst.qpus[0]].empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            if (T.blocked_by_teledata) return;
-
-            // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-            std::size_t meas2 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "teledata", 1);
-            int index = indices[0];
-
-            // Apply, conditioned to the measurement, the X and Z gates
-            if (meas1) {
-                state->apply_x(G.communication_pairs[index].q1);
-            }
-            if (meas2) {
-                state->apply_z(G.communication_pairs[index].q1);
-            }
-
-            // Swap the value to the desired qubit
-            state->apply_mcswap({static_cast<unsigned long>(G.communication_pairs[index].q1), inst.qubits[0] + T.zero_qubit});
-
-            G.communication_pairs[index].idle = true;
-            break;
-        }
-        case constants::EXPOSE:
-        {
-            if (!T.cat_entangled) {
-                std::vector<int> indices = generate_entanglement_(inst.qubits.size());
-                if (indices.empty()) {
-                    T.blocked_by_telegate = true;
-                    return;
-                }
-
-                int qid = 0;
-                for (auto& index : indices) {
-                    G.communication_pairs[index].qcomm_protocol = "telegate";
-                    G.communication_pairs[index].label = -(qid + 1);
-
-                    // CX to the entangled pair
-                    state->apply_mcx({inst.qubits[qid] + T.zero_qubit, static_cast<unsigned long>(G.communication_pairs[index].q0)});
-
-                    uint_t result = state->apply_measure({static_cast<unsigned long>(G.communication_pairs[index].q0)});
-
-                    G.qc_meas_tg[T.id].push(result);
-                    T.cat_entangled = true;
-                    T.blocked_by_telegate = true;
-                    Ts[inst.qpus[0]].blocked_by_telegate = false;
-
-                    // Update communication pair
-                    G.communication_pairs[index].sendr_qpu = T.id;
-                    G.communication_pairs[index].recvr_qpu = inst.qpus[0];
-
-                    qid++;
-                }
-                return;
-            } else {
-                for (int i = 0; i < inst.qubits.size(); i++) {
-                    uint_t meas = G.qc_meas_tg[inst.qpus[0]].front();
-                    G.qc_meas_tg[inst.qpus[0]].pop();
-
-                    if (meas) {
-                        state->apply_z(inst.qubits[i] + T.zero_qubit); 
-                    }
-                }
-
-                T.cat_entangled = false;
-
-                std::vector<int> indices = find_my_communication_pairs(G, T.id, inst.qpus[0], "telegate", inst.qubits.size());
-                for (auto& index : indices) {
-                    G.communication_pairs[index].idle = true;
-                }
-            }
-            break;
-        }
-        case constants::RCONTROL:
-        {
-            if (!G.qc_meas_tg.contains(inst.qpus[0]) || G.qc_meas_tg[inst.qpus[0]].empty()) {
-                T.blocked_by_telegate = true;
-                return;
-            }
-            if (T.blocked_by_telegate) return;
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "telegate");
-            
-            for (auto& index : indices) {
-                uint_t meas2 = G.qc_meas_tg[inst.qpus[0]].front();
-                G.qc_meas_tg[inst.qpus[0]].pop();
-
-                if (meas2) {
-                    state->apply_mcx({static_cast<unsigned long>(G.communication_pairs[index].q1)});
-                }
-            }
-
-            for(const auto& sub_inst: inst.instructions) {
-                apply_next_instr(T, sub_inst, indices);
-            }
-
-            for (auto& index : indices) {
-                state->apply_h(G.communication_pairs[index].q1);
-
-                uint_t result = state->apply_measure({static_cast<unsigned long>(G.communication_pairs[index].q1)});
-                G.qc_meas_tg[T.id].push(result);
-            }
-
-            Ts[inst.qpus[0]].blocked_by_telegate = false;
-            T.blocked_by_telegate = false;
-            break;
-        }
+            return [](AerBackend&, const CUNQAInstruction&, std::span<const int>) {
+                LOGGER_ERROR("Multiplexer instruction is not supported in CUNQA-AER");
+            };
         default:
-            std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.name << "\n";
-        } // End switch
-    };
-
-    while (!G.ended)
-    {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
-        {
-            if (T.finished)
-                continue;
-            else if (T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, std::nullopt, {});
-
-            if (!(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc))
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
-                T.finished = true;
+            return nullptr;
         }
-
-    } // End one shot
-
-    std::unordered_map<std::string, std::string> shot_bits;
-    for (auto& [id, T]: Ts) {
-        std::string bitstring(T.local_n_clbits, '0');
-        for (const auto &[bitIndex, value] : G.creg) {
-            if (T.zero_clbit <= bitIndex && bitIndex < (T.zero_clbit + T.local_n_clbits)) {
-                bitstring[T.local_n_clbits + T.zero_clbit - bitIndex - 1] = value ? '1' : '0';
-            }
-        }
-        shot_bits[id] = bitstring;
     }
-
-    return shot_bits;
-}
-
-void update_meas_counter(std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>& meas_counter, const std::unordered_map<std::string, std::string>& shot_bitstrings)
-{
-    for (const auto& [circ_id, bitstring] : shot_bitstrings) {
-        meas_counter[circ_id][bitstring]++;
-    }
-}
+};
 
 } // End of anonymous namespace
 
 namespace cunqa {
 namespace sim {
 
-JSON AerSimulatorAdapter::simulate(const Backend* backend)
+JSON AerSimulatorAdapter::simulate(const AER::Noise::NoiseModel& noise_model)
 {
     LOGGER_DEBUG("Aer usual simulation");
     try {
         auto quantum_task = qc.quantum_tasks[0];
 
-        JSON aer_quantum_task = quantum_task_to_AER(quantum_task);
-        int n_clbits = quantum_task.config.at("num_clbits");
-
-        Circuit circuit(aer_quantum_task);
+        JSON aer_quantum_task;
         std::vector<std::shared_ptr<Circuit>> circuits;
-        circuits.push_back(std::make_shared<Circuit>(circuit));
+        {
+            ScopedStage translate("translate");
+            aer_quantum_task = quantum_task_to_AER(quantum_task);
+            circuits.push_back(std::make_shared<Circuit>(aer_quantum_task));
+        }
+        int n_clbits = quantum_task.config.at("num_clbits");
 
         JSON run_config_json(aer_quantum_task.at("config").get<JSON>());
         if (quantum_task.config.contains("seed")) {
             run_config_json["seed_simulator"] = quantum_task.config.at("seed");
         }
         Config aer_config(run_config_json);
-        Noise::NoiseModel noise_model;
-        if (backend->config.contains("noise_model")) {
-            noise_model.load_from_json(backend->config.at("noise_model").get<JSON>());
-        }
-
-        Result result = controller_execute<Controller>(circuits, noise_model, aer_config);
 
-        JSON result_json = result.to_json();
+        JSON result_json;
+        {
+            ScopedStage simulate("simulate");
+            // AER enables other representations of the errors in the model it runs, so it takes a
+            // copy of the one that the simulators share, cheaper than parsing it again
+            Noise::NoiseModel task_noise_model = noise_model;
+            Result result = controller_execute<Controller>(circuits, task_noise_model, aer_config);
+            result_json = result.to_json();
+        }
         convert_standard_results_Aer(result_json, n_clbits);
 
         return result_json;
@@ -841,11 +220,138 @@ JSON AerSimulatorAdapter::simulate(const Backend* backend)
     return {};
 }
 
+JSON AerSimulatorAdapter::simulate_batch(const AER::Noise::NoiseModel& noise_model)
+{
+    LOGGER_DEBUG("Aer simulation of a batch of {} circuits", qc.quantum_tasks.size());
+    try {
+        JSON run_config_json;
+        std::vector<std::shared_ptr<Circuit>> circuits;
+        {
+            ScopedStage translate("translate");
+            for (auto& quantum_task : qc.quantum_tasks) {
+                // The shots, seed and memory slots of each circuit are read from its own config
+                JSON aer_quantum_task = quantum_task_to_AER(quantum_task);
+                if (circuits.empty())
+                    run_config_json = aer_quantum_task.at("config");
+                circuits.push_back(std::make_shared<Circuit>(aer_quantum_task));
+            }
+        }
+        run_config_json.erase("seed_simulator");
+        // Aer runs the experiments one after the other unless it is told otherwise, and then as
+        // many at once as fit in the memory and the threads
+        if (!run_config_json.contains("max_parallel_experiments"))
+            run_config_json["max_parallel_experiments"] = 0;
+        Config aer_config(run_config_json);
+
+        JSON result_json;
+        {
+            ScopedStage simulate("simulate");
+            Noise::NoiseModel task_noise_model = noise_model;
+            Result result = controller_execute<Controller>(circuits, task_noise_model, aer_config);
+            result_json = result.to_json();
+        }
+
+        // Each experiment as the result of a single circuit, along with what is common to all
+        JSON experiments = std::move(result_json.at("results"));
+        result_json.erase("results");
+        JSON batch = JSON::array();
+        for (std::size_t i = 0; i < experiments.size(); i++) {
+            JSON experiment_json = result_json;
+            experiment_json["results"] = JSON::array({std::move(experiments[i])});
+            convert_standard_results_Aer(experiment_json, qc.quantum_tasks[i].config.at("num_clbits"));
+            batch.push_back(std::move(experiment_json));
+        }
+        return {{"batch", batch}};
+
+    } catch (const std::exception& e) {
+        LOGGER_ERROR("Error executing the batch of circuits in the AER simulator.");
+        return {{"ERROR", std::string(e.what())}};
+    }
+}
+
+// Largest dynamic task that runs with the batched shots of Aer on GPU, unless it sets its own
+constexpr int BATCHED_SHOTS_GPU_MAX_QUBITS = 20;
+
+std::optional<JSON> AerSimulatorAdapter::simulate_batched()
+{
+    auto& quantum_task = qc.quantum_tasks[0];
+    auto& config = quantum_task.config;
+    // The batched shots run all at once, so those of a job with a target standard error go one by
+    // one to stop at it
+    if (config.at("device").at("device_name") != "GPU" || !config.value("batched_shots_gpu", true)
+        || ShotConvergence::from_config(config, false).enabled())
+        return std::nullopt;
+    const int max_qubits = config.value("batched_shots_gpu_max_qubits", BATCHED_SHOTS_GPU_MAX_QUBITS);
+    if (config.at("num_qubits").get<int>() > max_qubits
+        || !to_aer_conditionals(quantum_task.circuit, config.at("num_clbits").get<int>()))
+        return std::nullopt;
+
+    LOGGER_DEBUG("Aer batched simulation of the shots of a dynamic circuit on GPU");
+    config["batched_shots_gpu"] = true;
+    config["batched_shots_gpu_max_qubits"] = max_qubits;
+    static const Noise::NoiseModel noiseless;
+    return simulate(noiseless);
+}
+
 AER::AerState get_configured_aer_state(const JSON& config);
+void configure_shot_seed(AER::AerState& state, const std::uint64_t seed, const std::size_t shot);
+
+// Up to these qubits, resetting them one at a time costs less than setting up the state again,
+// above all on GPU, where it creates the buffers of the state on the devices
+constexpr std::size_t REUSED_STATE_MAX_QUBITS = 16;
+constexpr std::size_t REUSED_GPU_STATE_MAX_QUBITS = 26;
+
+// State on which a worker runs its shots. The small ones are allocated, seeded and set on their
+// GPUs on the first shot of the worker, and reset for the next ones, whose measurements go on
+// with its random stream. The large ones are set up again for each shot, with its own seed
+class WorkerAerState {
+public:
+    WorkerAerState(const JSON& config, const std::size_t n_qubits, const reg_t& target_gpus, const std::uint64_t seed) :
+        state_{get_configured_aer_state(config)},
+        n_qubits_{n_qubits},
+        target_gpus_{target_gpus},
+        seed_{seed},
+        reused_{n_qubits <= (target_gpus.empty() ? REUSED_STATE_MAX_QUBITS : REUSED_GPU_STATE_MAX_QUBITS)}
+    { }
+
+    // In |0...0>, for the given shot
+    AER::AerState* start_shot(const std::size_t shot)
+    {
+        if (!ready_) {
+            qubit_ids_ = state_.allocate_qubits(n_qubits_);
+            configure_shot_seed(state_, seed_, shot);
+            state_.initialize();
+            /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
+            state_.set_target_gpus(target_gpus_);
+            ready_ = true;
+        }
+        return &state_;
+    }
+
+    void end_shot()
+    {
+        if (reused_) {
+            for (const auto qubit : qubit_ids_)
+                state_.apply_reset({qubit});
+        } else {
+            state_.clear();
+            ready_ = false;
+        }
+    }
+
+private:
+    AER::AerState state_;
+    std::size_t n_qubits_;
+    reg_t target_gpus_;
+    std::uint64_t seed_;
+    bool reused_;
+    bool ready_ = false;
+    reg_t qubit_ids_;
+};
+
 JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
 {
     LOGGER_DEBUG("Aer dynamic simulation");
-    std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>  meas_counter;
     
     JSON qt_config = qc.quantum_tasks[0].config;
     auto shots = qt_config.at("shots").get<std::size_t>();
@@ -858,70 +364,55 @@ JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, co
         st_qtasks.push_back(from_quantum_task_to_structuredqtask(quantum_task));
         n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
     }
+    MeasCounter meas_counter(st_qtasks);
     
-    size_t n_comm_qubits = 0;
-    if (qc.quantum_tasks.size() > 1) { // Quantum Communications 
-        if (qc.quantum_tasks[0].config.contains("n_communication_qubits")) {
-            n_comm_qubits = qc.quantum_tasks[0].config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-        } else {
-            n_comm_qubits = 2;
-        }
-
-        n_qubits += n_comm_qubits;
-    }    
+    const size_t n_comm_qubits = n_communication_qubits(qc.quantum_tasks);
+    n_qubits += n_comm_qubits;    
     
+    // Built once the tasks are in place, as they point into their instructions
+    const DynamicEngine<AerBackend> engine(st_qtasks, n_comm_qubits);
+    const AerMatrices matrices(st_qtasks);
+    std::size_t blocked_iterations = 0;
+    const std::uint64_t seed = simulation_seed(qt_config);
+    const ShotConvergence convergence = ShotConvergence::from_config(qt_config, classical_channel != nullptr);
+    ShotProgress progress;
     auto start = std::chrono::high_resolution_clock::now();
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
+    // Quantum communications, or a single circuit small enough to split its shots among the threads
+    if (size(qc.quantum_tasks) > 1 || (device != "GPU" && parallelize_shots(qt_config, n_qubits, shots))) {
         #pragma omp parallel
         {
-            std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>> local_counter;
-
-            AER::AerState state = get_configured_aer_state(qt_config);
-
-            #pragma omp for
-            for (std::size_t i = 0; i < shots; i++) {
-                reg_t qubit_ids = state.allocate_qubits(n_qubits);
-                state.initialize();
-                /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
-                state.set_target_gpus(target_gpus);
-                update_meas_counter(local_counter, execute_shot_(&state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-                state.clear();
-            }
+            WorkerAerState state(qt_config, n_qubits, target_gpus, seed);
+
+            auto shot = engine.shot();
+            convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+                AerBackend backend{state.start_shot(i), matrices};
+                counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+                state.end_shot();
+            });
 
             #pragma omp critical
-            for (const auto& [id, bitstrings_counter] : local_counter) {
-                for (const auto& [bitstring, counts] : bitstrings_counter) {
-                    meas_counter[id][bitstring] += counts;
-                } 
-            }
+            blocked_iterations += shot.blocked_iterations;
         }
     } else { // As if OPENMP_IN_QC not enabled
-        AER::AerState state = get_configured_aer_state(qt_config);
-        reg_t qubit_ids;
-        for (std::size_t i = 0; i < shots; i++) {
-            qubit_ids = state.allocate_qubits(n_qubits);
-            state.initialize();
-            /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
-            state.set_target_gpus(target_gpus);
-            update_meas_counter(meas_counter, execute_shot_(&state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-            state.clear();
-        } // End all shots
+        WorkerAerState state(qt_config, n_qubits, target_gpus, seed);
+        auto shot = engine.shot();
+        convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+            AerBackend backend{state.start_shot(i), matrices};
+            counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+            state.end_shot();
+        });
+        blocked_iterations = shot.blocked_iterations;
     }
 #else
-    AER::AerState state = get_configured_aer_state(qt_config);
-    reg_t qubit_ids;
-    for (std::size_t i = 0; i < shots; i++) {
-        qubit_ids = state.allocate_qubits(n_qubits);
-        state.initialize();
-        /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
-        state.set_target_gpus(target_gpus);
-        update_meas_counter(meas_counter, execute_shot_(&state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-        state.clear();
-    } // End all shots
+    WorkerAerState state(qt_config, n_qubits, target_gpus, seed);
+    auto shot = engine.shot();
+    convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+        AerBackend backend{state.start_shot(i), matrices};
+        counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+        state.end_shot();
+    });
+    blocked_iterations = shot.blocked_iterations;
 #endif
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> duration = end - start;
@@ -931,6 +422,10 @@ JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, co
     JSON result_json = {
         {"id_counts", meas_counter},
         {"time_taken", time_taken}};
+    if (n_comm_qubits != 0)
+        result_json["scheduler"] = {{"communication_qubits", n_comm_qubits}, {"blocked_iterations", blocked_iterations}};
+    if (convergence.enabled())
+        result_json["convergence"] = convergence.report(progress);
     return result_json;
 }
 
@@ -943,7 +438,9 @@ AER::AerState get_configured_aer_state(const JSON& config)
     std::string device = config.at("device")["device_name"];
     state.configure("method", sim_method);
     state.configure("device", device);
-    state.configure("precision", "double");
+    state.configure("precision", config.value("precision", std::string("double")));
+    if (sim_method == "matrix_product_state")
+        configure_mps(config, [&state](const std::string& key, const std::string& value) { state.configure(key, value); });
     if (config.contains("seed")) {
         state.configure("seed_simulator", std::to_string(config.at("seed").get<int>()));
     }
@@ -951,5 +448,12 @@ AER::AerState get_configured_aer_state(const JSON& config)
     return state;
 }
 
+// Each state set up again takes a seed of its own, or its shots would repeat those of the first
+void configure_shot_seed(AER::AerState& state, const std::uint64_t seed, const std::size_t shot)
+{
+    auto shot_seed = ShotRng(seed, shot)() >> 33; // Fits in an int
+    state.configure("seed_simulator", std::to_string(shot_seed));
+}
+
 } // End of sim namespace
 } // End of cunqa namespace
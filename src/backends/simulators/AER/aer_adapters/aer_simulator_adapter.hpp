@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <optional>
 
 #include "quantum_task.hpp"
 #include "classical_channel/classical_channel.hpp"
@@ -9,6 +10,12 @@
 
 #include "utils/json.hpp"
 
+namespace AER {
+namespace Noise {
+class NoiseModel;
+}
+}
+
 namespace cunqa {
 namespace sim {
 
@@ -16,10 +23,20 @@ class AerSimulatorAdapter
 {
 public:
     AerSimulatorAdapter() = default;
-    AerSimulatorAdapter(AerComputationAdapter& qc) : qc{qc} {}
+    AerSimulatorAdapter(AerComputationAdapter qc) : qc{std::move(qc)} {}
     
-    JSON simulate(const Backend* backend);
+    JSON simulate(const AER::Noise::NoiseModel& noise_model);
+    // All the static tasks of qc in a single execution, whose experiments Aer parallelizes, with
+    // the run options of the first one. Their results as {"batch": [...]}, in order
+    JSON simulate_batch(const AER::Noise::NoiseModel& noise_model);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    // A dynamic task without communications on GPU, of up to batched_shots_gpu_max_qubits (20 by
+    // default), through the batched shots of Aer: thousands of statevectors in a single array of
+    // the device, each instruction a kernel over all of them, with the measurements of each shot
+    // and its c_if as a mask. Without noise, as the shots run one by one. Its result as that of a
+    // static task, or nullopt for the tasks that have to go shot by shot, see to_aer_conditionals,
+    // or that set batched_shots_gpu to false
+    std::optional<JSON> simulate_batched();
 
     AerComputationAdapter qc;
 
@@ -16,13 +16,16 @@ AerCCSimulator::AerCCSimulator() :
 // Distributed AerSimulator
 JSON AerCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
 
     AerComputationAdapter aer_ca(quantum_task);
-    AerSimulatorAdapter aer_sa(aer_ca);
+    AerSimulatorAdapter aer_sa(std::move(aer_ca));
     if (quantum_task.is_dynamic) {
-        JSON result = aer_sa.simulate(&classical_channel);
+        if (!channel) {
+            if (auto result = aer_sa.simulate_batched())
+                return *result;
+        }
+        JSON result = aer_sa.simulate(channel);
         return {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
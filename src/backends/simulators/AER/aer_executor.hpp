@@ -1,21 +1,16 @@
 #pragma once
 
-#include <string>
-#include "classical_channel/classical_channel.hpp"
+#include "backends/simulators/qc_executor.hpp"
 
 namespace cunqa {
 namespace sim {
 
-class AerExecutor {
+class AerExecutor : public QCExecutor {
 public:
-    AerExecutor(const std::size_t& n_qpus);
-    ~AerExecutor() = default;
+    using QCExecutor::QCExecutor;
 
-    void run();
-private:
-    comm::ClassicalChannel classical_channel;
-    std::vector<std::string> qpu_ids;
-    std::unordered_map<std::string, std::string> qpu_quantumtask_map;
+protected:
+    JSON simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) override;
 };
 
 } // End of sim namespace
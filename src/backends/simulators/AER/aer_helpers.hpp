@@ -1,12 +1,14 @@
 #pragma once
 
-#include <regex>
+#include <bit>
 #include <string>
+#include <algorithm>
 #include <bitset>
 #include <chrono>
 #include <vector>
 
 #include "logger.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
 
 using namespace std::string_literals;
 using namespace AER;
@@ -90,6 +92,18 @@ const std::vector<std::string> AER_CONFIG_KEYS = {
 namespace cunqa {
 namespace sim {
 
+inline void rename_key(JSON& instruction, const std::string& key, const std::string& new_key)
+{
+    auto it = instruction.find(key);
+    if (it == instruction.end())
+        return;
+
+    JSON value = std::move(*it);
+    instruction.erase(it);
+    instruction[new_key] = std::move(value);
+}
+
+// Leaves the circuit of the quantum task moved into the returned one
 JSON quantum_task_to_AER(QuantumTask& quantum_task)
 {
     JSON new_config;
@@ -115,6 +129,24 @@ JSON quantum_task_to_AER(QuantumTask& quantum_task)
     std::vector<int> target_gpus = (device == "GPU") ? quantum_task.config.at("device")["target_devices"].get<std::vector<int>>() : std::vector<int>();
     new_config["target_gpus"] = target_gpus;
 
+    // With several GPUs, Aer splits the statevector in chunks of blocking_qubits, one per GPU
+    // (or more if the circuit is smaller than them), unless the task sets the chunks itself
+    if (target_gpus.size() > 1 && !new_config.contains("blocking_enable")) {
+        const int n_qubits = quantum_task.config.at("num_qubits").get<int>();
+        const int gpu_qubits = std::bit_width(target_gpus.size()) - 1;
+        if (n_qubits > gpu_qubits) {
+            new_config["blocking_enable"] = true;
+            new_config["blocking_qubits"] = n_qubits - gpu_qubits;
+        }
+    }
+
+    // Aer applies the noise of a density matrix as superoperators, which its fusion only merges with
+    // the gates around them when it is allowed to. Otherwise every noisy gate and each of its
+    // channels take a sweep of their own over the 4^n entries of the state
+    const std::string method = quantum_task.config.value("method", "automatic");
+    if ((method == "density_matrix" || method == "superop") && !new_config.contains("fusion_allow_superop"))
+        new_config["fusion_allow_superop"] = true;
+
     // memory_slots = num_clbits
     int mem_slots = quantum_task.config.at("num_clbits").get<int>();
     new_config["memory_slots"] = mem_slots;
@@ -126,19 +158,99 @@ JSON quantum_task_to_AER(QuantumTask& quantum_task)
             new_config["max_parallel_threads"] = 1;
         }
     }
+    // Aer sizes its threads once per controller, so it is given those the vQPU left to the task
+    if (!new_config.contains("max_parallel_threads"))
+        new_config["max_parallel_threads"] = sim::available_threads();
 
-    //JSON Object because if not it generates an array
+    // Aer names the classical bits "memory" and takes the matrices as "params"
     for (auto& instruction : quantum_task.circuit) {
-        instruction = JSON::parse(std::regex_replace(std::regex_replace(instruction.dump(), std::regex("clbits"), "memory"), std::regex("matrix"), "params"));
+        rename_key(instruction, "clbits", "memory");
+        rename_key(instruction, "matrix", "params");
     }
+    //JSON Object because if not it generates an array
     JSON new_circuit = {
         {"config", new_config},
-        {"instructions", quantum_task.circuit}
+        {"instructions", std::move(quantum_task.circuit)}
     };
 
     return new_circuit;
 }
 
+// Bits of a register as a hex string of Aer, the lowest one last
+inline std::string aer_hex(const std::vector<bool>& bits)
+{
+    std::string hex;
+    for (std::size_t i = 0; i < bits.size(); i += 4) {
+        int digit = 0;
+        for (std::size_t j = 0; j < 4 && i + j < bits.size(); j++)
+            digit |= bits[i + j] << j;
+        hex.insert(hex.begin(), "0123456789abcdef"[digit]);
+    }
+    return "0x" + (hex.empty() ? "0" : hex);
+}
+
+// Rewrites the c_if of a dynamic circuit as the bfunc and conditional operations of Aer: each one
+// a bfunc that evaluates its condition on the register into a bit after the clbits, which the
+// instructions of its block are conditioned on, with the measurements also written into the
+// register, which is what the bfuncs read. AND conditions compare the clbits with their values
+// and OR ones with the opposite. Returns false, leaving the circuit as it was, for what Aer does
+// not run: communications, copies, nested c_if and XOR conditions
+inline bool to_aer_conditionals(std::vector<JSON>& circuit, const int n_clbits)
+{
+    static const std::vector<std::string> unsupported = {"send", "recv", "qsend", "qrecv", "expose", "rcontrol", "copy", "cif"};
+    const auto runs_in_aer = [](const JSON& instruction) {
+        return std::find(unsupported.begin(), unsupported.end(), instruction.at("name").get<std::string>()) == unsupported.end();
+    };
+    const auto with_register = [](JSON instruction) {
+        if (instruction.at("name") == "measure")
+            instruction["register"] = instruction.at("clbits");
+        return instruction;
+    };
+
+    std::vector<JSON> translated;
+    int n_registers = n_clbits;
+    for (const auto& instruction : circuit) {
+        if (instruction.at("name") != "cif") {
+            if (!runs_in_aer(instruction))
+                return false;
+            translated.push_back(with_register(instruction));
+            continue;
+        }
+
+        const auto clbits = instruction.at("clbits").get<std::vector<int>>();
+        const CifCondition cif = compile_cif(clbits, instruction.value("operation", std::string("and")), instruction.value("condition", 1));
+        if (cif.operation == CifOperation::XOR)
+            return false;
+
+        std::vector<bool> mask(n_clbits, false), value(n_clbits, false);
+        for (std::size_t i = 0; i < clbits.size(); i++) {
+            if (clbits[i] >= n_clbits || mask[clbits[i]])
+                return false;
+            mask[clbits[i]] = true;
+            const bool expected = i == 0 ? static_cast<bool>(instruction.value("condition", 1)) : !cif.negated;
+            value[clbits[i]] = cif.operation == CifOperation::AND ? expected : !expected;
+        }
+
+        const int reg = n_registers++;
+        translated.push_back({
+            {"name", "bfunc"},
+            {"mask", aer_hex(mask)},
+            {"relation", cif.operation == CifOperation::AND ? "==" : "!="},
+            {"val", aer_hex(value)},
+            {"register", reg}
+        });
+        for (const auto& block_instruction : instruction.at("instructions")) {
+            if (!runs_in_aer(block_instruction))
+                return false;
+            JSON conditioned = with_register(block_instruction);
+            conditioned["conditional"] = reg;
+            translated.push_back(std::move(conditioned));
+        }
+    }
+
+    circuit = std::move(translated);
+    return true;
+}
 
 void convert_standard_results_Aer(JSON& res, const int& num_clbits) 
 {
@@ -21,12 +21,12 @@ AerQCSimulator::AerQCSimulator() :
 
 JSON AerQCSimulator::execute([[maybe_unused]] const QCBackend& backend, const QuantumTask& quantum_task)
 {
-    auto circuit = to_string(quantum_task);
-    
+    auto circuit = rounds.message(quantum_task);
+
     classical_channel.send_info(circuit, executor_id);
     if (circuit != "") {
         auto results = classical_channel.recv_info(executor_id);
-        return JSON::parse(results);
+        return rounds.check(JSON::parse(results));
     }
     return JSON();
 }
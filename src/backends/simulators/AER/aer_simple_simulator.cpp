@@ -2,23 +2,97 @@
 #include "aer_adapters/aer_computation_adapter.hpp"
 #include "aer_adapters/aer_simulator_adapter.hpp"
 
+#include <map>
+#include <mutex>
+#include <functional>
+
+#include "noise/noise_model.hpp"
+
 namespace cunqa {
 namespace sim {
 
-JSON AerSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task) 
+namespace {
+
+// The noise models parsed in this process, by the hash of their JSON, alive while a simulator holds them
+std::shared_ptr<const AER::Noise::NoiseModel> parsed_noise_model(const JSON& noise_model_json)
+{
+    static std::mutex mutex;
+    static std::map<std::size_t, std::weak_ptr<const AER::Noise::NoiseModel>> parsed;
+
+    const std::size_t key = std::hash<std::string>{}(noise_model_json.dump());
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto noise_model = parsed[key].lock())
+        return noise_model;
+    auto noise_model = std::make_shared<AER::Noise::NoiseModel>();
+    noise_model->load_from_json(noise_model_json);
+    parsed[key] = noise_model;
+    return noise_model;
+}
+
+// What Aer takes for the whole execution, so that only the tasks that agree on it run together
+std::string run_options(const QuantumTask& quantum_task)
+{
+    JSON options = quantum_task.config;
+    for (const auto& key : {"shots", "seed", "num_qubits", "num_clbits"})
+        options.erase(key);
+    return options.dump();
+}
+
+} // End of anonymous namespace
+
+AerSimpleSimulator::AerSimpleSimulator() : noise_model_{std::make_shared<const AER::Noise::NoiseModel>()} {}
+
+AerSimpleSimulator::~AerSimpleSimulator() = default;
+
+void AerSimpleSimulator::configure(const SimpleBackend& backend)
+{
+    const auto& noise_model = backend.simple_config.noise_model;
+    if (!noise_model.is_null() && !noise_model.empty()) {
+        LOGGER_DEBUG("Loading the noise model of the backend.");
+        noise_model_ = parsed_noise_model(noise_model);
+    }
+}
+
+JSON AerSimpleSimulator::execute([[maybe_unused]] const SimpleBackend& backend, const QuantumTask& quantum_task) 
 {
     AerComputationAdapter aer_ca(quantum_task);
-    AerSimulatorAdapter aer_sa(aer_ca);
+    AerSimulatorAdapter aer_sa(std::move(aer_ca));
 
     if (quantum_task.is_dynamic) {
+        if (auto result = aer_sa.simulate_batched())
+            return *result;
         JSON result = aer_sa.simulate();
-        return {
+        JSON simple_result = {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
         };
+        if (result.contains("convergence"))
+            simple_result["convergence"] = result.at("convergence");
+        return simple_result;
     } else {
-        return aer_sa.simulate(&backend);
+        return aer_sa.simulate(*noise_model_);
+    }
+}
+
+JSON AerSimpleSimulator::execute_tasks([[maybe_unused]] const SimpleBackend& backend, const std::vector<QuantumTask>& quantum_tasks)
+{
+    std::map<std::string, std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < quantum_tasks.size(); i++)
+        groups[run_options(quantum_tasks[i])].push_back(i);
+
+    JSON results(quantum_tasks.size(), nullptr);
+    for (const auto& [options, indices] : groups) {
+        std::vector<QuantumTask> group;
+        group.reserve(indices.size());
+        for (const auto i : indices)
+            group.push_back(quantum_tasks[i]);
+
+        AerSimulatorAdapter aer_sa(AerComputationAdapter(std::move(group)));
+        JSON group_results = aer_sa.simulate_batch(*noise_model_);
+        for (std::size_t j = 0; j < indices.size(); j++)
+            results[indices[j]] = group_results.contains("ERROR") ? group_results : std::move(group_results.at("batch")[j]);
     }
+    return {{"batch", results}};
 }
 
 } // End namespace sim
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "quantum_task.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
@@ -7,16 +10,29 @@
 #include "utils/json.hpp"
 #include "logger.hpp"
 
+namespace AER {
+namespace Noise {
+class NoiseModel;
+}
+}
+
 namespace cunqa {
 namespace sim {
 
 class AerSimpleSimulator final : public SimulatorStrategy<SimpleBackend> {
 public:
-    AerSimpleSimulator() = default;
-    ~AerSimpleSimulator() = default;
+    AerSimpleSimulator();
+    ~AerSimpleSimulator();
 
     inline std::string get_name() const override {return "Aer";} 
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    JSON execute_tasks(const SimpleBackend& backend, const std::vector<QuantumTask>& quantum_tasks) override;
+    void configure(const SimpleBackend& backend) override;
+
+private:
+    // Parsed once per process, as it holds the Kraus matrices of every error of the calibrations,
+    // and shared by the workers and the QPUs of the process with the same backend
+    std::shared_ptr<const AER::Noise::NoiseModel> noise_model_;
 };
 
 } // End of sim namespace
@@ -12,8 +12,8 @@ public:
     CunqaComputationAdapter(const QuantumTask quantum_task) : 
         quantum_tasks{quantum_task}
     { }
-    CunqaComputationAdapter(const std::vector<QuantumTask> quantum_tasks) : 
-        quantum_tasks{quantum_tasks}
+    CunqaComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
@@ -0,0 +1,151 @@
+#include <algorithm>
+
+#include "cunqa_factorized_statevector.hpp"
+#include "utils/constants.hpp"
+
+namespace cunqa {
+namespace sim {
+
+FactorizedStatevector::FactorizedStatevector(const std::vector<std::size_t>& task_qubits, const std::size_t n_comm_qubits)
+{
+    int n_qubits = 0;
+    for (const auto size : task_qubits) {
+        std::vector<int> qubits(size);
+        for (auto& qubit : qubits)
+            qubit = n_qubits++;
+        initial_.push_back(std::move(qubits));
+    }
+    first_comm_qubit_ = n_qubits;
+    for (std::size_t i = 0; i < n_comm_qubits; i += 2) {
+        initial_.push_back({n_qubits, n_qubits + 1});
+        n_qubits += 2;
+    }
+    factor_of_.resize(n_qubits);
+    local_of_.resize(n_qubits);
+    restart_statevector();
+}
+
+// The statevectors that were not merged along the shot are only zeroed
+void FactorizedStatevector::restart_statevector()
+{
+    factors_.resize(std::max(factors_.size(), initial_.size()));
+    for (std::size_t i = 0; i < initial_.size(); i++) {
+        auto& factor = factors_[i];
+        if (factor && factor->qubits == initial_[i])
+            factor->state.restart_statevector();
+        else
+            factor.emplace(Factor{CunqaStatevector(initial_[i].size()), initial_[i]});
+        index_(i);
+        max_qubits_ = std::max(max_qubits_, initial_[i].size());
+    }
+    factors_.resize(initial_.size());
+}
+
+void FactorizedStatevector::apply_gate(const int type, std::span<const int> qubits)
+{
+    const int factor = merge_(qubits);
+    local_.clear();
+    for (const auto qubit : qubits)
+        local_.push_back(local_of_[qubit]);
+    factors_[factor]->state.apply_gate(type, local_);
+}
+
+void FactorizedStatevector::apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params)
+{
+    const int factor = merge_(qubits);
+    local_.clear();
+    for (const auto qubit : qubits)
+        local_.push_back(local_of_[qubit]);
+    factors_[factor]->state.apply_parametric_gate(type, local_, params);
+}
+
+int FactorizedStatevector::apply_measure(std::span<const int> qubits)
+{
+    const int qubit = qubits[0];
+    auto& factor = *factors_[factor_of_[qubit]];
+    const int outcome = factor.state.measure_with(local_of_[qubit], rng_.uniform());
+    if (qubit >= first_comm_qubit_ && factor.qubits.size() > 1)
+        split_(qubit, outcome);
+    return outcome;
+}
+
+// Measuring a qubit that is not used again leaves the rest in one of the states of the mixture
+// that tracing it out would give, so the statistics of the other qubits do not change
+void FactorizedStatevector::discard(const int qubit)
+{
+    auto& factor = *factors_[factor_of_[qubit]];
+    if (factor.qubits.size() == 1)
+        return;
+    split_(qubit, factor.state.measure_with(local_of_[qubit], rng_.uniform()));
+}
+
+void FactorizedStatevector::copy_to(FactorizedStatevector& copy)
+{
+    copy.initial_ = initial_;
+    copy.first_comm_qubit_ = first_comm_qubit_;
+    copy.factors_.resize(factors_.size());
+    for (std::size_t i = 0; i < factors_.size(); i++) {
+        if (!factors_[i]) {
+            copy.factors_[i].reset();
+            continue;
+        }
+        if (!copy.factors_[i])
+            copy.factors_[i].emplace();
+        factors_[i]->state.copy_to(copy.factors_[i]->state);
+        copy.factors_[i]->qubits = factors_[i]->qubits;
+    }
+    copy.factor_of_ = factor_of_;
+    copy.local_of_ = local_of_;
+    copy.rng_ = rng_;
+    copy.max_qubits_ = max_qubits_;
+}
+
+int FactorizedStatevector::merge_(std::span<const int> qubits)
+{
+    const int target = factor_of_[qubits[0]];
+    for (const auto qubit : qubits.subspan(1)) {
+        const int other = factor_of_[qubit];
+        if (other == target)
+            continue;
+
+        auto& merged = *factors_[target];
+        auto& high = *factors_[other];
+        merged.state = merged.state.kron(high.state);
+        merged.qubits.insert(merged.qubits.end(), high.qubits.begin(), high.qubits.end());
+        factors_[other].reset();
+        index_(target);
+        max_qubits_ = std::max(max_qubits_, merged.qubits.size());
+    }
+    return target;
+}
+
+void FactorizedStatevector::index_(const int factor)
+{
+    const auto& qubits = factors_[factor]->qubits;
+    for (std::size_t i = 0; i < qubits.size(); i++) {
+        factor_of_[qubits[i]] = factor;
+        local_of_[qubits[i]] = i;
+    }
+}
+
+// The measured qubit is in a basis state, out of the product with the rest
+void FactorizedStatevector::split_(const int qubit, const int outcome)
+{
+    const int from = factor_of_[qubit];
+    auto& factor = *factors_[from];
+    factor.state = factor.state.without(local_of_[qubit], outcome);
+    factor.qubits.erase(factor.qubits.begin() + local_of_[qubit]);
+    index_(from);
+
+    CunqaStatevector state(1);
+    if (outcome)
+        state.apply_gate(constants::X, {0});
+    auto free = std::find_if(factors_.begin(), factors_.end(), [](const auto& f) { return !f.has_value(); });
+    if (free == factors_.end())
+        free = factors_.insert(free, std::nullopt);
+    free->emplace(Factor{std::move(state), {qubit}});
+    index_(free - factors_.begin());
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
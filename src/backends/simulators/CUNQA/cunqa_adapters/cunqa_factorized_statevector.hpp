@@ -0,0 +1,71 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <initializer_list>
+
+#include "cunqa_statevector.hpp"
+#include "backends/simulators/shot_rng.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// State of the tasks of a shot with quantum communications as a product of statevectors: one per
+// task and one per pair of communication qubits when the shot starts, so the tasks run on states
+// of their own size until a protocol entangles them. A gate on qubits of several statevectors
+// merges them first, as the Kronecker product of their amplitudes. The communication qubits are
+// measured and reset whenever a protocol takes or frees their pair, so a measured one is split
+// off its statevector again, which keeps the pairs from piling up into the states of the tasks.
+// So are the qubits discarded by the engine, those of the finished tasks and the entangled qubit
+// of a pair freed by a teledata, which then no longer weigh on the gates of the tasks still
+// running. The qubits are those of the whole state, as for CunqaStatevector
+class FactorizedStatevector {
+public:
+    // The qubits of each task one after the other, and the pairs of communication qubits after them
+    FactorizedStatevector(const std::vector<std::size_t>& task_qubits, const std::size_t n_comm_qubits);
+    // Empty, to copy another one into
+    FactorizedStatevector() = default;
+
+    void restart_statevector();
+    // The measurements of every statevector draw from the stream of the shot
+    inline void seed_shot(const std::uint64_t seed, const std::size_t shot) { rng_ = ShotRng(seed, shot); }
+
+    void apply_gate(const int type, std::span<const int> qubits);
+    void apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params);
+    int apply_measure(std::span<const int> qubits);
+
+    inline void apply_gate(const int type, std::initializer_list<int> qubits) { apply_gate(type, std::span(qubits.begin(), qubits.size())); }
+    inline int apply_measure(std::initializer_list<int> qubits) { return apply_measure(std::span(qubits.begin(), qubits.size())); }
+    // Splits off a qubit that is no longer used, measured with no record of it
+    void discard(const int qubit);
+    // Copies the statevectors, reusing those of the copy that have the same size
+    void copy_to(FactorizedStatevector& copy);
+
+    // Qubits of the largest statevector it has held, the memory the shots actually took
+    inline std::size_t max_qubits() const { return max_qubits_; }
+
+private:
+    struct Factor {
+        CunqaStatevector state;
+        std::vector<int> qubits; // Of the whole state, in their order in this one
+    };
+
+    std::vector<std::vector<int>> initial_; // Qubits of each statevector at the start of a shot
+    int first_comm_qubit_ = 0;
+    std::vector<std::optional<Factor>> factors_; // Those merged into others are empty
+    std::vector<int> factor_of_; // Statevector of each qubit
+    std::vector<int> local_of_;  // And its position in it
+    std::vector<int> local_;     // Qubits of a gate in their statevector
+    ShotRng rng_{0, 0};
+    std::size_t max_qubits_ = 0;
+
+    // Statevector that holds all the qubits, merging those that hold them
+    int merge_(std::span<const int> qubits);
+    void index_(const int factor);
+    void split_(const int qubit, const int outcome);
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,199 @@
+#include <bit>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cunqa_lane_statevector.hpp"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::sim;
+
+// The pairs of amplitudes (a[k], b[k]) of a run of n, each pair in every lane. The entries of the
+// matrix in m are those of LaneStatevector::matrix_, each a row of the lanes
+inline void lanes_scalar(double* ar, double* ai, double* br, double* bi, const std::uint64_t n, const double* m,
+                         const std::size_t lanes)
+{
+    for (std::uint64_t k = 0; k < n; k++) {
+        for (std::size_t l = 0; l < lanes; l++) {
+            const std::size_t j = k * lanes + l;
+            const double xr = ar[j], xi = ai[j], yr = br[j], yi = bi[j];
+            const double r00 = m[l], i00 = m[lanes + l], r01 = m[2 * lanes + l], i01 = m[3 * lanes + l];
+            const double r10 = m[4 * lanes + l], i10 = m[5 * lanes + l], r11 = m[6 * lanes + l], i11 = m[7 * lanes + l];
+            ar[j] = r00 * xr - i00 * xi + r01 * yr - i01 * yi;
+            ai[j] = r00 * xi + i00 * xr + r01 * yi + i01 * yr;
+            br[j] = r10 * xr - i10 * xi + r11 * yr - i11 * yi;
+            bi[j] = r10 * xi + i10 * xr + r11 * yi + i11 * yr;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+
+// A vector holds the same part of an amplitude in consecutive lanes, so the products are those of
+// the scalar kernel with no shuffles
+
+__attribute__((target("avx2,fma")))
+void lanes_avx2(double* ar, double* ai, double* br, double* bi, const std::uint64_t n, const double* m, const std::size_t lanes)
+{
+    // The matrix of a vector of lanes is loaded once for the whole run
+    for (std::size_t l = 0; l < lanes; l += 4) {
+        const __m256d r00 = _mm256_loadu_pd(m + l), i00 = _mm256_loadu_pd(m + lanes + l);
+        const __m256d r01 = _mm256_loadu_pd(m + 2 * lanes + l), i01 = _mm256_loadu_pd(m + 3 * lanes + l);
+        const __m256d r10 = _mm256_loadu_pd(m + 4 * lanes + l), i10 = _mm256_loadu_pd(m + 5 * lanes + l);
+        const __m256d r11 = _mm256_loadu_pd(m + 6 * lanes + l), i11 = _mm256_loadu_pd(m + 7 * lanes + l);
+        for (std::uint64_t k = 0; k < n; k++) {
+            const std::size_t j = k * lanes + l;
+            const __m256d xr = _mm256_load_pd(ar + j), xi = _mm256_load_pd(ai + j);
+            const __m256d yr = _mm256_load_pd(br + j), yi = _mm256_load_pd(bi + j);
+            _mm256_store_pd(ar + j, _mm256_fnmadd_pd(i01, yi, _mm256_fmadd_pd(r01, yr, _mm256_fnmadd_pd(i00, xi, _mm256_mul_pd(r00, xr)))));
+            _mm256_store_pd(ai + j, _mm256_fmadd_pd(i01, yr, _mm256_fmadd_pd(r01, yi, _mm256_fmadd_pd(i00, xr, _mm256_mul_pd(r00, xi)))));
+            _mm256_store_pd(br + j, _mm256_fnmadd_pd(i11, yi, _mm256_fmadd_pd(r11, yr, _mm256_fnmadd_pd(i10, xi, _mm256_mul_pd(r10, xr)))));
+            _mm256_store_pd(bi + j, _mm256_fmadd_pd(i11, yr, _mm256_fmadd_pd(r11, yi, _mm256_fmadd_pd(i10, xr, _mm256_mul_pd(r10, xi)))));
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+void lanes_avx512(double* ar, double* ai, double* br, double* bi, const std::uint64_t n, const double* m, const std::size_t lanes)
+{
+    // The matrix of a vector of lanes is loaded once for the whole run
+    for (std::size_t l = 0; l < lanes; l += 8) {
+        const __m512d r00 = _mm512_loadu_pd(m + l), i00 = _mm512_loadu_pd(m + lanes + l);
+        const __m512d r01 = _mm512_loadu_pd(m + 2 * lanes + l), i01 = _mm512_loadu_pd(m + 3 * lanes + l);
+        const __m512d r10 = _mm512_loadu_pd(m + 4 * lanes + l), i10 = _mm512_loadu_pd(m + 5 * lanes + l);
+        const __m512d r11 = _mm512_loadu_pd(m + 6 * lanes + l), i11 = _mm512_loadu_pd(m + 7 * lanes + l);
+        for (std::uint64_t k = 0; k < n; k++) {
+            const std::size_t j = k * lanes + l;
+            const __m512d xr = _mm512_load_pd(ar + j), xi = _mm512_load_pd(ai + j);
+            const __m512d yr = _mm512_load_pd(br + j), yi = _mm512_load_pd(bi + j);
+            _mm512_store_pd(ar + j, _mm512_fnmadd_pd(i01, yi, _mm512_fmadd_pd(r01, yr, _mm512_fnmadd_pd(i00, xi, _mm512_mul_pd(r00, xr)))));
+            _mm512_store_pd(ai + j, _mm512_fmadd_pd(i01, yr, _mm512_fmadd_pd(r01, yi, _mm512_fmadd_pd(i00, xr, _mm512_mul_pd(r00, xi)))));
+            _mm512_store_pd(br + j, _mm512_fnmadd_pd(i11, yi, _mm512_fmadd_pd(r11, yr, _mm512_fnmadd_pd(i10, xi, _mm512_mul_pd(r10, xr)))));
+            _mm512_store_pd(bi + j, _mm512_fmadd_pd(i11, yr, _mm512_fmadd_pd(r11, yi, _mm512_fmadd_pd(i10, xr, _mm512_mul_pd(r10, xi)))));
+        }
+    }
+}
+
+#endif
+
+void apply_lanes(double* ar, double* ai, double* br, double* bi, const std::uint64_t n, const double* m, const std::size_t lanes)
+{
+#if defined(__x86_64__)
+    // Read here rather than at start up, as the kernels of CunqaStatevector are chosen in another unit
+    static const std::string_view simd = CunqaStatevector::simd();
+    if (simd == "avx512" && lanes % 8 == 0)
+        return lanes_avx512(ar, ai, br, bi, n, m, lanes);
+    if (simd != "scalar" && lanes % 4 == 0)
+        return lanes_avx2(ar, ai, br, bi, n, m, lanes);
+#endif
+    lanes_scalar(ar, ai, br, bi, n, m, lanes);
+}
+
+const GateMatrix X_MATRIX = {0.0, 1.0, 1.0, 0.0};
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+// Aligned to the cache lines, which the AVX-512 loads of 8 lanes fill whole
+constexpr std::size_t LANE_AMPLITUDES_ALIGNMENT = 64;
+
+LaneStatevector::LaneStatevector(const std::size_t n_qubits, const std::size_t lanes) :
+    n_qubits_{n_qubits},
+    lanes_{lanes},
+    dim_{std::uint64_t(1) << n_qubits},
+    amplitudes_{2 * dim_ * lanes * sizeof(double), LANE_AMPLITUDES_ALIGNMENT},
+    matrix_(8 * lanes)
+{
+    if (dim_ * lanes > LANE_STATEVECTOR_MAX_AMPLITUDES)
+        throw std::runtime_error("The lanes of the CUNQA statevector take " + std::to_string(LANE_STATEVECTOR_MAX_AMPLITUDES) +
+                                 " amplitudes at most, " + std::to_string(lanes) + " lanes of " + std::to_string(n_qubits) + " qubits were asked for.");
+    restart_statevector();
+}
+
+void LaneStatevector::restart_statevector()
+{
+    std::fill(real_(), real_() + 2 * dim_ * lanes_, 0.0);
+    std::fill(real_(), real_() + lanes_, 1.0);
+}
+
+void LaneStatevector::apply_gate(const int type, std::span<const int> qubits)
+{
+    switch (type)
+    {
+    case constants::ID:
+        return;
+    case constants::CX:
+    case constants::CY:
+    case constants::CZ:
+    {
+        const GateMatrix m = gate_matrix(type == constants::CX ? constants::X : type == constants::CY ? constants::Y : constants::Z);
+        for (std::size_t lane = 0; lane < lanes_; lane++)
+            set_matrix_(lane, m);
+        return apply_matrix_(qubits[1], std::uint64_t(1) << qubits[0]);
+    }
+    case constants::SWAP:
+        for (std::size_t lane = 0; lane < lanes_; lane++)
+            set_matrix_(lane, X_MATRIX);
+        apply_matrix_(qubits[1], std::uint64_t(1) << qubits[0]);
+        apply_matrix_(qubits[0], std::uint64_t(1) << qubits[1]);
+        return apply_matrix_(qubits[1], std::uint64_t(1) << qubits[0]);
+    default:
+    {
+        const GateMatrix m = gate_matrix(type);
+        for (std::size_t lane = 0; lane < lanes_; lane++)
+            set_matrix_(lane, m);
+        return apply_matrix_(qubits[0]);
+    }
+    }
+}
+
+void LaneStatevector::apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> thetas)
+{
+    if (thetas.size() != lanes_)
+        throw std::out_of_range("Parametric gate with " + std::to_string(thetas.size()) + " angles for " + std::to_string(lanes_) + " lanes.");
+    for (std::size_t lane = 0; lane < lanes_; lane++)
+        set_matrix_(lane, rotation_matrix(type, thetas[lane]));
+    if (type == constants::CRX || type == constants::CRY || type == constants::CRZ)
+        apply_matrix_(qubits[1], std::uint64_t(1) << qubits[0]);
+    else
+        apply_matrix_(qubits[0]);
+}
+
+void LaneStatevector::set_matrix_(const std::size_t lane, const GateMatrix& m)
+{
+    const Amplitude entries[] = {m.m00, m.m01, m.m10, m.m11};
+    for (std::size_t e = 0; e < 4; e++) {
+        matrix_[2 * e * lanes_ + lane] = entries[e].real();
+        matrix_[(2 * e + 1) * lanes_ + lane] = entries[e].imag();
+    }
+}
+
+// The pairs of the target whose controls are all set, in runs of contiguous pairs as long as the
+// lowest of the target and the controls allows, as the sweeps of CunqaStatevector
+void LaneStatevector::apply_matrix_(const std::size_t target, const std::uint64_t control_mask)
+{
+    const std::uint64_t half = dim_ / 2;
+    const std::uint64_t stride = std::uint64_t(1) << target;
+    const std::size_t lowest_control = control_mask ? std::countr_zero(control_mask) : n_qubits_;
+    const std::uint64_t run = std::uint64_t(1) << std::min(target, lowest_control);
+
+    double* re = real_();
+    double* im = imag_();
+    for (std::uint64_t r = 0; r < half; r += run) {
+        // Run r of the amplitudes with the target off, with a zero inserted at the target
+        const std::uint64_t i = ((r >> target) << (target + 1)) | (r & (stride - 1));
+        if ((i & control_mask) == control_mask)
+            apply_lanes(re + i * lanes_, im + i * lanes_, re + (i + stride) * lanes_, im + (i + stride) * lanes_, run, matrix_.data(), lanes_);
+    }
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+
+#include "utils/constants.hpp"
+#include "backends/simulators/huge_pages.hpp"
+#include "cunqa_statevector.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Most amplitudes of all the lanes of a LaneStatevector, 512 KB that stay in the L2 cache. Past
+// them the lanes run slower than their parameter sets one by one on a SmallStatevector
+constexpr std::uint64_t LANE_STATEVECTOR_MAX_AMPLITUDES = std::uint64_t(1) << 15;
+
+// Statevector of a circuit under several sets of parameters at once, one lane per set, for the
+// parameter sweeps of the variational algorithms. The real and imaginary parts are kept apart,
+// and each of them holds the amplitude of a basis state for all the lanes next to each other, so
+// a vector loads the same amplitude of several lanes and a gate applies to each lane the matrix
+// of its own parameters, without the permutes of the interleaved complex numbers. The fixed gates
+// take the same matrix in every lane and the rotations an angle per lane. The kernels are AVX-512
+// for multiples of 8 lanes and AVX2 for multiples of 4, chosen as CunqaStatevector chooses its own
+class LaneStatevector {
+public:
+    LaneStatevector(const std::size_t n_qubits, const std::size_t lanes);
+
+    void restart_statevector();
+
+    void apply_gate(const int type, std::span<const int> qubits);
+    // With the angle of each lane in thetas
+    void apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> thetas);
+
+    inline double probability(const std::size_t lane, const std::uint64_t i) const
+    {
+        const double re = real_()[i * lanes_ + lane], im = imag_()[i * lanes_ + lane];
+        return re * re + im * im;
+    }
+
+    inline std::uint64_t dim() const { return dim_; }
+    inline std::size_t lanes() const { return lanes_; }
+    inline std::size_t n_qubits() const { return n_qubits_; }
+
+private:
+    std::size_t n_qubits_;
+    std::size_t lanes_;
+    std::uint64_t dim_;
+    StateBuffer amplitudes_; // The dim_ * lanes_ real parts followed by the imaginary ones
+    std::vector<double> matrix_; // Real and imaginary parts of m00, m01, m10 and m11, each for all the lanes
+
+    inline double* real_() const { return amplitudes_.data<double>(); }
+    inline double* imag_() const { return amplitudes_.data<double>() + dim_ * lanes_; }
+
+    void set_matrix_(const std::size_t lane, const GateMatrix& m);
+    void apply_matrix_(const std::size_t target, const std::uint64_t control_mask = 0);
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
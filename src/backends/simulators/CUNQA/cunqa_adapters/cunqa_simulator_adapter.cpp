@@ -1,532 +1,467 @@
 #include <string>
 #include <unordered_map>
-#include <stack>
-#include <queue>
 #include <chrono>
-#include <functional>
+#include <span>
 #include <cstdlib>
+#include <algorithm>
 #include <optional>
+#include <numeric>
+#include <exception>
 
 #include "cunqa_simulator_adapter.hpp"
+#include "cunqa_statevector.hpp"
+#include "cunqa_small_statevector.hpp"
+#include "cunqa_lane_statevector.hpp"
+#include "cunqa_factorized_statevector.hpp"
+#include "cunqa_sparse_statevector.hpp"
 
+#include "observables.hpp"
 #include "result_cunqasim.hpp"
 #include "executor.hpp"
 #include "utils/types_cunqasim.hpp"
 
 #include "utils/constants.hpp"
 
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/dynamic_engine.hpp"
+#include "backends/simulators/diagonal_runs.hpp"
+#include "backends/simulators/pauli_kernels.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+#include "backends/simulators/sample_histogram.hpp"
+
 #include "logger.hpp"
 
 namespace {
 using namespace cunqa;
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
-struct CommunicationQubitsPair {
-    int q0;
-    int q1;
-    bool idle = true;
-    std::string sendr_qpu; // QSEND and EXPOSE
-    std::string recvr_qpu; // QRECV and RCONTROL
-    std::string qcomm_protocol;
-    int label;
-};
-
-struct TaskState {
-    std::string id;
-    int local_n_clbits = 0;
-    std::vector<constants::CUNQAInstruction>::const_iterator it, end;
-    int zero_qubit = 0;
-    int zero_clbit = 0;
-    bool finished = false;
-    bool blocked_by_teledata = false;
-    bool blocked_by_telegate = false;
-    bool blocked_by_cc = false;
-    bool cat_entangled = false;
-    std::stack<int> telep_meas;
-};
-
-struct GlobalState {
-    int n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::queue<int>> qc_meas_td;
-    std::unordered_map<std::string, std::queue<int>> qc_meas_tg;
-    std::vector<CommunicationQubitsPair> communication_pairs;
-    std::unordered_map<LocalCCIDs, std::queue<int>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
-    cunqa::comm::ClassicalChannel* chan = nullptr;
-};
-
-
-std::vector<int> find_idle_communication_pairs(GlobalState& G, const size_t n_pairs)
+// Applies a "diagonal", as those that the runs of diagonal gates are merged into, with its entries
+// as complex numbers
+template <typename State>
+void apply_diagonal(State& state, const CUNQAInstruction& inst, std::span<const int> qubits)
 {
-    std::vector<int> indices_idle_pairs;
-    size_t count = 0;
-    for (int index = 0; index < G.communication_pairs.size() && count < n_pairs; index++) {
-        if (G.communication_pairs[index].idle) {
-            indices_idle_pairs.push_back(index);
-            count++;
-        } 
-    } 
-
-    if (count < n_pairs) 
-        return std::vector<int>();
-
-    for (const auto& index : indices_idle_pairs) {
-        G.communication_pairs[index].idle = false;
-    }
-
-    return indices_idle_pairs;
+    thread_local std::vector<sim::Amplitude> diagonal;
+    diagonal.clear();
+    for (const auto& entry : inst.diagonal[0])
+        diagonal.emplace_back(entry[0], entry[1]);
+    state.apply_diagonal(qubits, diagonal);
 }
 
-std::vector<int> find_my_communication_pairs(const GlobalState& G, const std::string& sendr, const std::string recvr, const std::string qcomm_protocol, size_t n_pairs = 0)
+// Applies a Pauli string or a rotation about it in a single sweep of the amplitudes, instead of
+// going through the Executor or being left out of the dynamic circuits
+template <typename State>
+void apply_pauli(State& state, const CUNQAInstruction& inst, std::span<const int> qubits)
 {
-    std::vector<int> comm_pairs;
-    size_t count = 0;
-    if (n_pairs == 0) n_pairs = G.communication_pairs.size();
-    for (int index = 0; index < G.communication_pairs.size(); index++) {
-        if (count == n_pairs) return comm_pairs;
-        if (!G.communication_pairs[index].idle &&
-            G.communication_pairs[index].sendr_qpu == sendr && 
-            G.communication_pairs[index].recvr_qpu == recvr &&
-            G.communication_pairs[index].qcomm_protocol == qcomm_protocol) {
-                comm_pairs.push_back(index);
-                count++;
-        } 
-    } 
-
-    return comm_pairs;
+    sim::apply_pauli_instruction(state.mutable_data(), state.n_qubits(), inst, qubits);
 }
 
+// The statevector of a shot worker as the backend of the dynamic engine, whole or factorized
+template <typename State>
+struct CunqaBackend {
+    State& state;
+    std::optional<State> saved{}; // Of the speculation on a RECV
 
-std::unordered_map<std::string, std::string> execute_shot_(
-    Executor& executor, 
-    std::vector<StructuredQuantumTask>& st_qtasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
-    const bool allows_qc, 
-    const size_t& n_comm_qubits
-)
-{
-    std::unordered_map<std::string, TaskState> Ts;
-    GlobalState G;
-
-    for (const auto &quantum_task : st_qtasks) {
-        TaskState T;
-        T.id = quantum_task.id;
-        T.local_n_clbits = quantum_task.n_clbits;
-        T.zero_qubit = G.n_qubits;
-        T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.instructions.begin();
-        T.end = quantum_task.instructions.end();
-        T.blocked_by_teledata = false;
-        T.blocked_by_telegate = false;
-        T.blocked_by_cc = false;
-        T.finished = false;
-        Ts[quantum_task.id] = T;
-        
-        G.n_qubits += quantum_task.n_qubits;
-        G.n_clbits += quantum_task.n_clbits;
-    }
-    
-    // Here we add the communication qubits
-    if (n_comm_qubits != 0) {
-        G.n_qubits += n_comm_qubits;
-        for (int i = 0; i < n_comm_qubits; i+=2) {
-            CommunicationQubitsPair cqp = {
-                .q0 = G.n_qubits - n_comm_qubits + i,
-                .q1 = G.n_qubits - n_comm_qubits + i + 1
-            };
-            G.communication_pairs.push_back(cqp);
-        }
-    }
-    
-    auto generate_entanglement_ = [&](const size_t n_pairs) {
-        std::vector<int> indices = find_idle_communication_pairs(G, n_pairs);
-
-        if (!indices.empty()) {
-            for (auto& index : indices) {
-                int meas1 = executor.apply_measure({G.communication_pairs[index].q1});
-                if (meas1) {
-                    executor.apply_gate("x", {G.communication_pairs[index].q1});
-                } 
-                int meas2 = executor.apply_measure({G.communication_pairs[index].q0});
-                if (meas2) {
-                    executor.apply_gate("x", {G.communication_pairs[index].q0});
-                }
-                executor.apply_gate("h", {G.communication_pairs[index].q0});
-                executor.apply_gate("cx", {G.communication_pairs[index].q0, G.communication_pairs[index].q1});
-            }
-        }
 
-        return indices;
-    };
+    using Gate = void (*)(CunqaBackend&, const CUNQAInstruction&, std::span<const int>);
 
-    std::function<void(TaskState&, const std::optional<constants::CUNQAInstruction>&, const std::vector<int>)> apply_next_instr = 
-        [&](TaskState& T, const std::optional<constants::CUNQAInstruction>& instruction = std::nullopt, const std::vector<int> comm_indices = {}) 
+    inline int measure(const int qubit) { return state.apply_measure({qubit}); }
+    inline void reset(const int qubit)
+    {
+        if constexpr (requires { state.apply_reset(qubit); })
+            state.apply_reset(qubit);
+        else if (state.apply_measure({qubit}))
+            state.apply_gate(constants::X, {qubit});
+    }
+    inline void bell_pair(const int q0, const int q1) requires requires { state.apply_bell_pair(q0, q1); }
     {
-        const CUNQAInstruction inst = !instruction.has_value() ? *T.it : instruction.value();
-        auto inst_type = INSTRUCTIONS_MAP.at(inst.name);
+        state.apply_bell_pair(q0, q1);
+    }
+    inline void x(const int qubit) { state.apply_gate(constants::X, {qubit}); }
+    inline void z(const int qubit) { state.apply_gate(constants::Z, {qubit}); }
+    inline void h(const int qubit) { state.apply_gate(constants::H, {qubit}); }
+    inline void cx(const int control, const int target) { state.apply_gate(constants::CX, {control, target}); }
+    inline void swap(const int a, const int b) { state.apply_gate(constants::SWAP, {a, b}); }
+    inline void discard(const int qubit) requires requires { state.discard(qubit); } { state.discard(qubit); }
+    inline void snapshot()
+    {
+        if (!saved)
+            saved.emplace();
+        state.copy_to(*saved);
+    }
+    inline void restore() { saved->copy_to(state); }
 
-        switch (inst_type)
-        {
-        case constants::MEASURE:
-        {
-            int measurement = executor.apply_measure({inst.qubits[0] + T.zero_qubit});
-            G.creg[inst.clbits[0] + T.zero_clbit] = (measurement == 1);
-            break;
-        }
-        case constants::COPY:
+    static Gate gate(const CUNQAInstruction& inst)
+    {
+        switch (inst.type)
         {
-            if(inst.l_clbits.size() != inst.r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < inst.l_clbits.size(); ++i)
-                G.creg[inst.l_clbits[i] + T.zero_clbit] = G.creg[inst.r_clbits[i] + T.zero_clbit];
-                
-            break;
-        }
         case constants::ID:
         case constants::X:
         case constants::Y:
         case constants::Z:
         case constants::H:
+        case constants::S:
+        case constants::SDG:
+        case constants::T:
+        case constants::TDG:
         case constants::SX:
-            executor.apply_gate(inst.name, {inst.qubits[0] + T.zero_qubit});
-            break;
+        case constants::SXDG:
         case constants::CX:
         case constants::CY:
         case constants::CZ:
-        {
-            std::vector<int> tmp_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            tmp_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    tmp_qubits[i] = inst.qubits[i] + T.zero_qubit;
-
-                }
-            }
-            executor.apply_gate(inst.name, {tmp_qubits[0], tmp_qubits[1]});
-            break;
-        }
+        case constants::SWAP:
+            return [](CunqaBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.state.apply_gate(inst.type, qubits);
+            };
+        case constants::DIAGONAL:
+            if constexpr (requires (State& state) { state.apply_diagonal(std::span<const int>{}, std::span<const sim::Amplitude>{}); })
+                return [](CunqaBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { apply_diagonal(b.state, inst, qubits); };
+            else
+                return nullptr;
+        case constants::PAULISTR:
+        case constants::CPAULISTR:
+        case constants::MCPAULISTR:
+        case constants::PAULIGADGET:
+        case constants::CPAULIGADGET:
+        case constants::MCPAULIGADGET:
+            if constexpr (requires (State& state) { state.mutable_data(); })
+                return sim::is_pauli_instruction(inst) ? [](CunqaBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                    apply_pauli(b.state, inst, qubits);
+                } : Gate{nullptr};
+            else
+                return nullptr;
         case constants::ECR:
             // TODO
-            break;
+            return [](CunqaBackend&, const CUNQAInstruction&, std::span<const int>) {};
         case constants::RX:
         case constants::RY:
         case constants::RZ:
-        {
-            Params params = inst.params;
-            executor.apply_parametric_gate(inst.name, {inst.qubits[0] + T.zero_qubit}, params);
-            break;
-        }
+        case constants::P:
+        case constants::U1:
         case constants::CRX:
         case constants::CRY:
         case constants::CRZ:
-        {
-            Params params = inst.params;
-            std::vector<int> tmp_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            tmp_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    tmp_qubits[i] = inst.qubits[i] + T.zero_qubit;
-
-                }
-            }
-            executor.apply_parametric_gate(inst.name, {tmp_qubits[0], tmp_qubits[1]}, params);
-            break;
-        }
-        case constants::SWAP:
-        {
-            executor.apply_gate(inst.name, {inst.qubits[0] + T.zero_qubit, inst.qubits[1] + T.zero_qubit});
-            break;
+            return [](CunqaBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.state.apply_parametric_gate(inst.type, qubits, inst.params);
+            };
+        default:
+            return nullptr;
         }
-        case constants::SEND:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[inst.qpus[0]].id
-                };  
-                for (auto& clbit : inst.clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
-                }
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    classical_channel->send_measure(G.creg[clbit] + T.zero_clbit, inst.qpus[0]);
-                }
-            }
-            break;
+    }
+};
+
+// Circuits of the gates of the native statevector measured at their end, into clbits that fit a
+// Histogram, which are simulated once and sampled instead of going through the Executor. The
+// Pauli strings and gadgets only with pauli, as the lanes and the gradients do not take them
+bool runs_natively(const std::vector<JSON>& circuit, std::vector<CUNQAInstruction>& instructions, const bool pauli = false)
+{
+    try {
+        instructions = from_json_instructions_to_cunqainstructions(circuit);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    std::vector<bool> measured;
+    for (const auto& inst : instructions) {
+        if (inst.type == constants::BARRIER)
+            continue;
+        if (inst.type == constants::MEASURE) {
+            if (inst.clbits[0] >= 64)
+                return false;
+            if (inst.qubits[0] >= static_cast<int>(measured.size()))
+                measured.resize(inst.qubits[0] + 1, false);
+            measured[inst.qubits[0]] = true;
+            continue;
         }
-        case constants::RECV:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[inst.qpus[0]].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
-                    for (const auto& clbit: inst.clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
-                    }
-                    T.blocked_by_cc = false;
-                } else {
-                    T.blocked_by_cc = true;
-                }    
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    int measurement = classical_channel->recv_measure(inst.qpus[0]);
-                    G.creg[clbit + T.zero_clbit] = (measurement == 1);
-                }
-            }
-            break;
+        if (pauli && sim::is_pauli_instruction(inst)) {
+            // The string acts on the qubits of its length besides those of the instruction
+            const auto end = measured.begin() + std::min(inst.paulistr.size(), measured.size());
+            if (std::find(measured.begin(), end, true) != end)
+                return false;
+        } else if (!sim::CunqaStatevector::supports(inst.type)) {
+            return false;
         }
-        case constants::CIF:
-        {
-            bool init = (static_cast<bool>(inst.condition)) ? G.creg[inst.clbits[0] + T.zero_clbit] : !G.creg[inst.clbits[0] + T.zero_clbit];
-            // Operates on the values provided, with the specified operation.
-            // If there is only one value, sum = G.creg[inst.clbits[0] + T.zero_clbit]
-            bool result = std::accumulate(inst.clbits.begin() + 1, inst.clbits.end(), 
-                           init,
-                           [&](bool acc, int clbit) { 
-                               return constants::cif_ops[inst.operation](acc, G.creg[clbit + T.zero_clbit]); 
-                           });
-            result = (static_cast<bool>(inst.condition)) ? result : !result;
-
-            if (static_cast<bool>(inst.condition) == result) {
-                for(const auto& sub_inst: inst.instructions) {
-                    apply_next_instr(T, sub_inst, {});
-                }
-            }
-            break;
+        for (const auto qubit : inst.qubits) {
+            if (qubit < static_cast<int>(measured.size()) && measured[qubit])
+                return false;
         }
-        case constants::QSEND:
-        {
-            std::vector<int> indices = generate_entanglement_(1);
-            if (indices.empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            T.blocked_by_teledata = false;
-            int index = indices[0];
-            G.communication_pairs[index].qcomm_protocol = "teledata";
-
-            // CX to the entangled pair
-            executor.apply_gate("cx", {inst.qubits[0] + T.zero_qubit, G.communication_pairs[index].q0});
-
-            // H to the sent qubit
-            executor.apply_gate("h", {inst.qubits[0] + T.zero_qubit});
+    }
+    return true;
+}
 
-            int result = executor.apply_measure({inst.qubits[0] + T.zero_qubit});
+// Drops the swaps of a circuit that runs natively, with the qubits of the instructions after them
+// relabeled as the DynamicEngine does, and gives the measurements the qubits that hold the
+// measured ones at the end, as no gate touches them after they are measured. Without
+// measurements, the whole register is measured in the order of the qubits of the circuit. The
+// circuits of the Pauli strings, which act on the whole register, keep their swaps
+void relabel_swaps(std::vector<CUNQAInstruction>& instructions, std::vector<std::pair<std::uint64_t, std::size_t>>& measures,
+                   const int n_qubits)
+{
+    if (std::any_of(instructions.begin(), instructions.end(), sim::needs_ordered_qubits))
+        return;
+    std::vector<int> layout(n_qubits);
+    std::iota(layout.begin(), layout.end(), 0);
+    const std::size_t n_instructions = instructions.size();
+    std::vector<CUNQAInstruction> relabeled;
+    relabeled.reserve(n_instructions);
+    for (auto& inst : instructions) {
+        if (sim::relabel_swap(inst, layout))
+            continue;
+        for (auto& qubit : inst.qubits) {
+            if (qubit >= 0 && qubit < n_qubits)
+                qubit = layout[qubit];
+        }
+        relabeled.push_back(std::move(inst));
+    }
+    instructions = std::move(relabeled);
+    if (instructions.size() == n_instructions)
+        return;
 
-            G.qc_meas_td[T.id].push(result);
-            G.qc_meas_td[T.id].push(executor.apply_measure({G.communication_pairs[index].q0}));
+    if (measures.empty()) {
+        for (int qubit = 0; qubit < n_qubits; qubit++)
+            measures.emplace_back(qubit, qubit);
+    }
+    for (auto& [qubit, clbit] : measures) {
+        if (qubit < static_cast<std::uint64_t>(n_qubits))
+            qubit = layout[qubit];
+    }
+}
 
-            if (result) {
-                executor.apply_gate("x", {inst.qubits[0] + T.zero_qubit});
-            }
+// Whether the circuits that fit run on the SmallStatevector of their qubits, unless
+// CUNQA_SMALL_STATEVECTOR=0
+bool detect_small_statevector()
+{
+    const char* small = std::getenv("CUNQA_SMALL_STATEVECTOR");
+    return !small || std::string(small) != "0";
+}
 
-            // Unlock QRECV
-            Ts[inst.qpus[0]].blocked_by_teledata = false;
+const bool SMALL_STATEVECTOR = detect_small_statevector();
 
-            // Update communication pair
-            G.communication_pairs[index].sendr_qpu = T.id;
-            G.communication_pairs[index].recvr_qpu = inst.qpus[0];
+// Whether the parameter sweeps of the circuits that fit run on the lanes of a LaneStatevector,
+// unless CUNQA_LANE_STATEVECTOR=0
+bool detect_lane_statevector()
+{
+    const char* lanes = std::getenv("CUNQA_LANE_STATEVECTOR");
+    return !lanes || std::string(lanes) != "0";
+}
 
-            break;
-        }
-        case constants::QRECV:
-        {
-            if (!G.qc_meas_td.contains(inst.qpus[0]) || G.qc_meas_td[inst.qpus[0]].empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            if (T.blocked_by_teledata) return;
+const bool LANE_STATEVECTOR = detect_lane_statevector();
 
-            // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-            std::size_t meas2 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
+// Parameter sets run together, the most of them that the sets left fill and that fit the lanes of
+// the circuit. The last sets of a batch go in a group of 4 padded with the last one
+constexpr std::size_t LANE_GROUPS[] = {16, 8, 4};
 
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "teledata", 1);
-            int index = indices[0];
+// Largest dynamic circuits run on a SmallStatevector, as each shot thread keeps it in its stack
+// along with the copy of the speculation, 512 KB at most
+constexpr std::size_t SMALL_SHOTS_MAX_QUBITS = 14;
 
-            // Apply, conditioned to the measurement, the X and Z gates
-            if (meas1) {
-                executor.apply_gate("x", {G.communication_pairs[index].q1});
+// Applies the gates of a circuit that runs natively, and samples its measured qubits, or all of
+// them if it measures none
+template <typename State>
+sim::Histogram sample_natively(State& state, const std::vector<CUNQAInstruction>& instructions,
+                               const std::vector<std::pair<std::uint64_t, std::size_t>>& measures,
+                               const std::uint64_t dim, const int shots, const std::uint64_t seed)
+{
+    for (const auto& inst : instructions) {
+        if (inst.type == constants::MEASURE || inst.type == constants::BARRIER)
+            continue;
+        if constexpr (requires { state.apply_diagonal(inst.qubits, std::span<const sim::Amplitude>{}); }) {
+            if (inst.type == constants::DIAGONAL) {
+                apply_diagonal(state, inst, inst.qubits);
+                continue;
             }
-            if (meas2) {
-                executor.apply_gate("z", {G.communication_pairs[index].q1});
+        }
+        if constexpr (requires { state.mutable_data(); }) {
+            if (sim::is_pauli_instruction(inst)) {
+                apply_pauli(state, inst, inst.qubits);
+                continue;
             }
-
-            // Swap the value to the desired qubit
-            executor.apply_gate("swap", {G.communication_pairs[index].q1, inst.qubits[0] + T.zero_qubit});
-
-            G.communication_pairs[index].idle = true;
-            break;
         }
-        case constants::EXPOSE:
-        {
-            if (!T.cat_entangled) {
-                std::vector<int> indices = generate_entanglement_(inst.qubits.size());
-                if (indices.empty()) {
-                    T.blocked_by_telegate = true;
-                    return;
-                }
+        if (inst.params.empty())
+            state.apply_gate(inst.type, inst.qubits);
+        else
+            state.apply_parametric_gate(inst.type, inst.qubits, inst.params);
+    }
 
-                int qid = 0;
-                for (auto& index : indices) {
-                    G.communication_pairs[index].qcomm_protocol = "telegate";
-                    G.communication_pairs[index].label = -(qid + 1);
+    // The sparse states draw from their populated basis states alone
+    if constexpr (requires { state.sample(measures, shots, seed); }) {
+        return state.sample(measures, shots, seed);
+    } else {
+        const auto* amplitudes = state.data();
+        auto probability = [amplitudes](const std::uint64_t i) { return std::norm(amplitudes[i]); };
+        return measures.empty() ? sim::sample_histogram(dim, probability, shots, seed)
+                                : sim::sample_measured(dim, probability, measures, shots, seed);
+    }
+}
 
-                    // CX to the entangled pair
-                    executor.apply_gate("cx", {inst.qubits[qid] + T.zero_qubit, G.communication_pairs[index].q0});
+// Applies the inverse of a gate that runs natively, the same gate for the self-inverse ones
+void apply_inverse(sim::CunqaStatevector& state, const CUNQAInstruction& inst)
+{
+    if (!inst.params.empty()) {
+        const double theta = -inst.params[0];
+        return state.apply_parametric_gate(inst.type, inst.qubits, std::span(&theta, 1));
+    }
+    switch (inst.type)
+    {
+    case constants::S:
+        return state.apply_gate(constants::SDG, inst.qubits);
+    case constants::SDG:
+        return state.apply_gate(constants::S, inst.qubits);
+    case constants::T:
+        return state.apply_gate(constants::TDG, inst.qubits);
+    case constants::TDG:
+        return state.apply_gate(constants::T, inst.qubits);
+    case constants::SX:
+        return state.apply_gate(constants::SXDG, inst.qubits);
+    case constants::SXDG:
+        return state.apply_gate(constants::SX, inst.qubits);
+    default:
+        return state.apply_gate(inst.type, inst.qubits);
+    }
+}
 
-                    int result = executor.apply_measure({G.communication_pairs[index].q0});
+// <bra|m|ket> for the matrix m on the target where the controls are all set and 0 elsewhere, as
+// the derivative of a controlled rotation
+sim::Amplitude matrix_element(const sim::Amplitude* bra, const sim::Amplitude* ket, const std::uint64_t dim,
+                              const int target, const sim::GateMatrix& m, const std::uint64_t control_mask)
+{
+    const std::uint64_t stride = std::uint64_t(1) << target;
+    sim::Amplitude element = 0.0;
+    for (std::uint64_t i = 0; i < dim; i++) {
+        if ((i & stride) || (i & control_mask) != control_mask)
+            continue;
+        const sim::Amplitude x = ket[i], y = ket[i + stride];
+        element += std::conj(bra[i]) * (m.m00 * x + m.m01 * y) + std::conj(bra[i + stride]) * (m.m10 * x + m.m11 * y);
+    }
+    return element;
+}
 
-                    G.qc_meas_tg[T.id].push(result);
-                    T.cat_entangled = true;
-                    T.blocked_by_telegate = true;
-                    Ts[inst.qpus[0]].blocked_by_telegate = false;
+// Counts of the shots of a dynamic simulation
+struct Shots {
+    sim::MeasCounter meas_counter;
+    std::size_t blocked_iterations = 0;
+    std::size_t max_qubits = 0; // Of the largest statevector of a factorized state
+    std::size_t speculation_hits = 0;
+    std::size_t speculation_misses = 0;
+    std::size_t shots = 0; // Run, fewer than those asked if they converged before
+    double standard_error = 0.0;
+};
 
-                    // Update communication pair
-                    G.communication_pairs[index].sendr_qpu = T.id;
-                    G.communication_pairs[index].recvr_qpu = inst.qpus[0];
+// Largest statevector that the speculation on the RECVs copies before each guess
+constexpr std::size_t SPECULATION_MAX_QUBITS = 20;
 
-                    qid++;
-                }
-                return;
-            } else {
-                for (int i = 0; i < inst.qubits.size(); i++) {
-                    int meas = G.qc_meas_tg[inst.qpus[0]].front();
-                    G.qc_meas_tg[inst.qpus[0]].pop();
-
-                    if (meas) {
-                        executor.apply_gate("z", {inst.qubits[0] + T.zero_qubit}); 
-                    }
-                }
+// Runs the shots of the tasks in blocks of shot_block, shot major, each shot of a block on a
+// state of its own made by make_state. The shots keep their seeds, so they draw as one by one
+template <typename State, typename MakeState>
+Shots run_shot_blocks(const sim::DynamicEngine<CunqaBackend<State>>& engine, const std::vector<StructuredQuantumTask>& st_qtasks,
+                      const int shots, const std::size_t shot_block, const std::uint64_t seed, const bool parallel,
+                      comm::ClassicalChannel* classical_channel, MakeState make_state)
+{
+    Shots result{sim::MeasCounter(st_qtasks)};
+    const std::size_t block = std::min(shot_block, static_cast<std::size_t>(shots));
+    std::vector<State> states;
+    states.reserve(block); // The backends point into it
+    std::vector<CunqaBackend<State>> backends;
+    std::vector<typename sim::DynamicEngine<CunqaBackend<State>>::Shot> block_shots;
+    for (std::size_t i = 0; i < block; i++) {
+        states.push_back(make_state());
+        backends.push_back({states.back()});
+        block_shots.push_back(engine.shot());
+    }
 
-                T.cat_entangled = false;
+    sim::ShotExchange exchange;
+    for (std::size_t first = 0; first < static_cast<std::size_t>(shots); first += block) {
+        // The last block may be smaller
+        const std::size_t n = std::min(block, shots - first);
+        while (backends.size() > n)
+            backends.pop_back();
+        block_shots.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+            states[i].seed_shot(seed, first + i);
+
+        engine.run_block(backends, block_shots, classical_channel, exchange, parallel, [&](const std::size_t i, const auto& creg) {
+            result.meas_counter.add(creg);
+            states[i].restart_statevector();
+        });
+    }
 
-                std::vector<int> indices = find_my_communication_pairs(G, T.id, inst.qpus[0], "telegate", inst.qubits.size());
-                for (auto& index : indices) {
-                    G.communication_pairs[index].idle = true;
-                }
-            }
-            break;
-        }
-        case constants::RCONTROL:
-        {
-            if (!G.qc_meas_tg.contains(inst.qpus[0]) || G.qc_meas_tg[inst.qpus[0]].empty()) {
-                T.blocked_by_telegate = true;
-                return;
-            }
-            if (T.blocked_by_telegate) return;
+    for (const auto& shot : block_shots)
+        result.blocked_iterations += shot.blocked_iterations;
+    if constexpr (requires { states[0].max_qubits(); }) {
+        for (const auto& state : states)
+            result.max_qubits = std::max(result.max_qubits, state.max_qubits());
+    }
+    return result;
+}
 
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "telegate");
+// Runs the shots of the tasks, each thread on a state of its own made by make_state. Under a
+// ShotConvergence they go block by block, with the counts of each block merged before the check
+template <typename State, typename MakeState>
+Shots run_shots(const std::vector<StructuredQuantumTask>& st_qtasks, const std::size_t n_comm_qubits, const int shots,
+                const std::size_t shot_block, const bool speculate, const std::uint64_t seed, [[maybe_unused]] const bool parallel,
+                comm::ClassicalChannel* classical_channel, const bool allows_qc, MakeState make_state, const sim::ShotConvergence& convergence = {})
+{
+    // Built once the tasks are in place, as it points into their instructions
+    const sim::DynamicEngine<CunqaBackend<State>> engine(st_qtasks, n_comm_qubits);
+    if (!allows_qc && shot_block > 1 && engine.runs_shot_major()) {
+        Shots result = run_shot_blocks(engine, st_qtasks, shots, shot_block, seed, parallel, classical_channel, make_state);
+        result.shots = shots;
+        return result;
+    }
 
-            for (auto& index : indices) {
-                int meas2 = G.qc_meas_tg[inst.qpus[0]].front();
-                G.qc_meas_tg[inst.qpus[0]].pop();
+    Shots result{sim::MeasCounter(st_qtasks)};
+    const int block = static_cast<int>(std::min<std::size_t>(convergence.block_of(shots), shots));
+    bool converged = false;
+    std::exception_ptr error; // The first one a shot threw, rethrown once the threads are done
+    bool failed = false; // Set with converged, so that every thread leaves after the same block
 
-                if (meas2) {
-                    executor.apply_gate("x", {G.communication_pairs[index].q1});
+    #pragma omp parallel if (parallel)
+    {
+        sim::MeasCounter local_counter(st_qtasks);
+        State state = make_state();
+        CunqaBackend<State> backend{state};
+        auto shot = engine.shot();
+        shot.speculate = speculate;
+        // Every thread goes through the same blocks, as converged is only set between them
+        for (int first = 0; first < shots && !converged && !failed; first += block) {
+            const int last = std::min(shots - first, block) + first;
+            #pragma omp for
+            for (int i = first; i < last; i++) {
+                try {
+                    state.seed_shot(seed, i);
+                    local_counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+                    state.restart_statevector();
+                } catch (...) {
+                    #pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
                 }
             }
 
-            for(const auto& sub_inst: inst.instructions) {
-                apply_next_instr(T, sub_inst, indices);
-            }
-
-            for (auto& index : indices) {
-                executor.apply_gate("h", {G.communication_pairs[index].q1});
-
-                int result = executor.apply_measure({G.communication_pairs[index].q1});
-                G.qc_meas_tg[T.id].push(result);
+            #pragma omp critical
+            result.meas_counter.merge(local_counter);
+            local_counter = sim::MeasCounter(st_qtasks);
+            #pragma omp barrier
+            #pragma omp single
+            {
+                result.shots = last;
+                result.standard_error = result.meas_counter.max_standard_error(last);
+                converged = convergence.converged(result.standard_error);
+                failed = error != nullptr;
             }
-
-            Ts[inst.qpus[0]].blocked_by_telegate = false;
-            T.blocked_by_telegate = false;
-            break;
         }
-        default:
-            std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.name << "\n";
-        } // End switch
-    };
 
-    while (!G.ended)
-    {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        #pragma omp critical
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, std::nullopt, {});
-
-            if (!(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc))
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
-                T.finished = true;
+            result.blocked_iterations += shot.blocked_iterations;
+            result.speculation_hits += shot.speculation_hits;
+            result.speculation_misses += shot.speculation_misses;
+            if constexpr (requires { state.max_qubits(); })
+                result.max_qubits = std::max(result.max_qubits, state.max_qubits());
         }
-
-    } // End one shot
-
-    std::unordered_map<std::string, std::string> shot_bits;
-    for (auto& [id, T]: Ts) {
-        std::string bitstring(T.local_n_clbits, '0');
-        for (const auto &[bitIndex, value] : G.creg) {
-            if (T.zero_clbit <= bitIndex && bitIndex < (T.zero_clbit + T.local_n_clbits)) {
-                bitstring[T.local_n_clbits + T.zero_clbit - bitIndex - 1] = value ? '1' : '0';
-            }
-        }
-        shot_bits[id] = bitstring;
-    }
-
-    return shot_bits;
-}
-
-void update_meas_counter(std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>& meas_counter, const std::unordered_map<std::string, std::string>& shot_bitstrings)
-{
-    for (const auto& [circ_id, bitstring] : shot_bitstrings) {
-        meas_counter[circ_id][bitstring]++;
     }
+    if (error)
+        std::rethrow_exception(error);
+    return result;
 }
 
 } // End of anonymous namespace
@@ -535,32 +470,230 @@ namespace cunqa {
 namespace sim {
 
 JSON CunqaSimulatorAdapter::simulate([[maybe_unused]] const Backend* backend)
+{
+    ResultWriter writer;
+    simulate(backend, writer);
+    return writer.to_json();
+}
+
+void CunqaSimulatorAdapter::simulate([[maybe_unused]] const Backend* backend, ResultWriter& writer)
 {
     LOGGER_DEBUG("Cunqa usual simulation");
     try
     { 
         auto n_qubits = qc.quantum_tasks[0].config.at("num_qubits").get<int>();
         auto shots = qc.quantum_tasks[0].config.at("shots").get<int>();
+
+        std::vector<CUNQAInstruction> instructions;
+        // The sparse statevector takes the gates but neither the Pauli strings nor the diagonals
+        const bool sparse = qc.quantum_tasks[0].config.value("method", std::string()) == "sparse";
+        if (sparse && runs_natively(qc.quantum_tasks[0].circuit, instructions)) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto measures = measured_bits(qc.quantum_tasks[0].circuit);
+            const bool measured = !measures.empty();
+            relabel_swaps(instructions, measures, n_qubits);
+            SparseStatevector state(n_qubits);
+            Histogram histogram = sample_natively(state, instructions, measures, 0, shots, simulation_seed(qc.quantum_tasks[0].config));
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<float> duration = end - start;
+
+            writer.counts(std::move(histogram), measured ? qc.quantum_tasks[0].config.at("num_clbits").get<size_t>() : n_qubits);
+            writer["time_taken"] = duration.count();
+            writer["sparse"] = {{"populated_states", state.size()}, {"dense", state.is_dense()}};
+            return;
+        }
+        if (runs_natively(qc.quantum_tasks[0].circuit, instructions, true)) {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto measures = measured_bits(qc.quantum_tasks[0].circuit);
+            const bool measured = !measures.empty();
+            relabel_swaps(instructions, measures, n_qubits);
+            const std::uint64_t seed = simulation_seed(qc.quantum_tasks[0].config);
+            const std::uint64_t dim = std::uint64_t(1) << n_qubits;
+            Histogram histogram;
+            const bool small = SMALL_STATEVECTOR && visit_small_statevector(n_qubits, [&]<typename State>(std::type_identity<State>) {
+                State state;
+                histogram = sample_natively(state, instructions, measures, dim, shots, seed);
+            });
+            if (!small) {
+                // The small states gain nothing from the sweeps saved
+                if (qc.quantum_tasks[0].config.value("merge_diagonals", true))
+                    merge_diagonal_runs(instructions);
+                CunqaStatevector state(n_qubits);
+                histogram = sample_natively(state, instructions, measures, dim, shots, seed);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<float> duration = end - start;
+
+            writer.counts(std::move(histogram), measured ? qc.quantum_tasks[0].config.at("num_clbits").get<size_t>() : n_qubits);
+            writer["time_taken"] = duration.count();
+            return;
+        }
+
         Executor executor(n_qubits);
         QuantumCircuit circuit = qc.quantum_tasks[0].circuit;
-        JSON result = executor.run(circuit, shots);
-
-        return result;
+        writer.write(executor.run(circuit, shots));
     } 
     catch (const std::exception &e)
     {
         // TODO: specify the circuit format in the docs.
         LOGGER_ERROR("Error executing the circuit in the Cunqa simulator.");
-        return {{"ERROR", std::string(e.what()) + ". Try checking the format of the circuit sent."}};
+        writer.write({{"ERROR", std::string(e.what()) + ". Try checking the format of the circuit sent."}});
+    }
+
+}
+
+std::optional<JSON> CunqaSimulatorAdapter::simulate_batch(const std::vector<std::vector<double>>& params_batch)
+{
+    const auto& quantum_task = qc.quantum_tasks[0];
+    const auto n_qubits = quantum_task.config.at("num_qubits").get<std::size_t>();
+    const std::uint64_t dim = std::uint64_t(1) << n_qubits;
+    std::vector<CUNQAInstruction> instructions;
+    // The scalar kernels gain nothing from the lanes
+    if (!LANE_STATEVECTOR || CunqaStatevector::simd() == "scalar" || dim * LANE_GROUPS[2] > LANE_STATEVECTOR_MAX_AMPLITUDES || !runs_natively(quantum_task.circuit, instructions))
+        return std::nullopt;
+    LOGGER_DEBUG("Cunqa simulation of {} parameter sets on lanes", params_batch.size());
+
+    const auto shots = quantum_task.config.at("shots").get<int>();
+    const auto measures = measured_bits(quantum_task.circuit);
+    const std::uint64_t seed = simulation_seed(quantum_task.config);
+    const std::size_t num_clbits = measures.empty() ? n_qubits : quantum_task.config.at("num_clbits").get<std::size_t>();
+
+    // Position in the sets of the angle of each rotation, -1 for those that keep their own
+    std::vector<std::int64_t> swept(instructions.size(), -1);
+    const auto& slots = quantum_task.param_slots();
+    for (std::size_t i = 0; i < slots.size(); i++) {
+        if (slots[i].param == 0)
+            swept[slots[i].instruction] = i;
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> groups; // First set and lanes
+    for (std::size_t first = 0; first < params_batch.size();) {
+        const std::size_t left = params_batch.size() - first;
+        const std::size_t lanes = *std::find_if(std::begin(LANE_GROUPS), std::end(LANE_GROUPS) - 1, [left, dim](const std::size_t lanes) {
+            return lanes <= left && dim * lanes <= LANE_STATEVECTOR_MAX_AMPLITUDES;
+        });
+        groups.emplace_back(first, lanes);
+        first += lanes;
     }
-    return {};
 
+    std::vector<JSON> results(params_batch.size());
+    #pragma omp parallel for schedule(dynamic) if (groups.size() > 1)
+    for (std::size_t g = 0; g < groups.size(); g++) {
+        const auto [first, lanes] = groups[g];
+        const std::size_t n_sets = std::min(lanes, params_batch.size() - first);
+        auto start = std::chrono::high_resolution_clock::now();
+
+        LaneStatevector state(n_qubits, lanes);
+        std::vector<double> thetas(lanes);
+        for (std::size_t k = 0; k < instructions.size(); k++) {
+            const auto& inst = instructions[k];
+            if (inst.type == constants::MEASURE || inst.type == constants::BARRIER)
+                continue;
+            if (inst.params.empty()) {
+                state.apply_gate(inst.type, inst.qubits);
+                continue;
+            }
+            for (std::size_t lane = 0; lane < lanes; lane++)
+                thetas[lane] = swept[k] < 0 ? inst.params[0] : params_batch[first + std::min(lane, n_sets - 1)][swept[k]];
+            state.apply_parametric_gate(inst.type, inst.qubits, thetas);
+        }
+
+        std::vector<Histogram> histograms(n_sets);
+        for (std::size_t lane = 0; lane < n_sets; lane++) {
+            auto probability = [&state, lane](const std::uint64_t i) { return state.probability(lane, i); };
+            histograms[lane] = measures.empty() ? sample_histogram(dim, probability, shots, seed)
+                                                : sample_measured(dim, probability, measures, shots, seed);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<float> duration = end - start;
+
+        // Each set takes its share of the time of the group
+        for (std::size_t lane = 0; lane < n_sets; lane++) {
+            ResultWriter writer;
+            writer.counts(std::move(histograms[lane]), num_clbits);
+            writer["time_taken"] = duration.count() / n_sets;
+            results[first + lane] = writer.to_json();
+        }
+    }
+    return JSON{{"batch", results}};
+}
+
+JSON CunqaSimulatorAdapter::simulate_gradient()
+{
+    LOGGER_DEBUG("Cunqa adjoint differentiation");
+    try
+    {
+        const auto& quantum_task = qc.quantum_tasks[0];
+        const auto n_qubits = quantum_task.config.at("num_qubits").get<std::size_t>();
+        const auto observables = read_observables(quantum_task.config.at("observables"));
+        std::vector<CUNQAInstruction> instructions;
+        if (quantum_task.is_dynamic || !runs_natively(quantum_task.circuit, instructions))
+            throw std::runtime_error("Gradients are only computed for the circuits of the gates of the CUNQA statevector, "
+                                     "without classical conditions and measured at their end");
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // The derivative of each rotation goes to the parameter of its slot
+        std::vector<std::int64_t> slot_of(instructions.size(), -1);
+        const auto& slots = quantum_task.param_slots();
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].param == 0)
+                slot_of[slots[i].instruction] = i;
+        }
+
+        // Forward: the state, and each observable applied to it, from which the pass backward
+        // takes off the gates one by one
+        CunqaStatevector state(n_qubits);
+        for (const auto& inst : instructions) {
+            if (inst.type == constants::MEASURE || inst.type == constants::BARRIER)
+                continue;
+            if (inst.params.empty())
+                state.apply_gate(inst.type, inst.qubits);
+            else
+                state.apply_parametric_gate(inst.type, inst.qubits, inst.params);
+        }
+        const std::uint64_t dim = state.dim();
+        std::vector<double> values(observables.size());
+        std::vector<CunqaStatevector> adjoints;
+        for (std::size_t o = 0; o < observables.size(); o++) {
+            adjoints.emplace_back(n_qubits);
+            apply_observable(std::span(state.data(), dim), std::span(adjoints[o].mutable_data(), dim), observables[o]);
+            values[o] = matrix_element(state.data(), adjoints[o].data(), dim, 0, {1.0, 0.0, 0.0, 1.0}, 0).real();
+        }
+
+        // Backward: d<O>/dθ = 2 Re <λ|dU/dθ|ψ>, with ψ the state before the gate and λ the
+        // observable applied to the final state and brought back by the gates after it
+        std::vector<std::vector<double>> gradients(observables.size(), std::vector<double>(slots.size(), 0.0));
+        for (std::size_t k = instructions.size(); k-- > 0;) {
+            const auto& inst = instructions[k];
+            if (inst.type == constants::MEASURE || inst.type == constants::BARRIER || inst.type == constants::ID)
+                continue;
+            apply_inverse(state, inst);
+            if (slot_of[k] >= 0) {
+                const bool controlled = inst.type == constants::CRX || inst.type == constants::CRY || inst.type == constants::CRZ;
+                const auto derivative = rotation_derivative(inst.type, inst.params[0]);
+                const int target = controlled ? inst.qubits[1] : inst.qubits[0];
+                const std::uint64_t control_mask = controlled ? std::uint64_t(1) << inst.qubits[0] : 0;
+                for (std::size_t o = 0; o < observables.size(); o++)
+                    gradients[o][slot_of[k]] += 2 * matrix_element(adjoints[o].data(), state.data(), dim, target, derivative, control_mask).real();
+            }
+            for (auto& adjoint : adjoints)
+                apply_inverse(adjoint, inst);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<float> duration = end - start;
+
+        return {{"expectation_values", values}, {"gradients", gradients}, {"method", "adjoint"}, {"time_taken", duration.count()}};
+    }
+    catch (const std::exception &e)
+    {
+        LOGGER_ERROR("Error computing the gradients in the Cunqa simulator.");
+        return {{"ERROR", std::string(e.what()) + "."}};
+    }
 }
 
 JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
 {
     LOGGER_DEBUG("Cunqa dynamic simulation");
-    std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>  meas_counter;
 
     auto shots = qc.quantum_tasks[0].config.at("shots").get<int>();
     std::string method = qc.quantum_tasks[0].config.at("method").get<std::string>();
@@ -572,66 +705,73 @@ JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
         n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
     }
 
-    size_t n_comm_qubits = 0;
-    if (qc.quantum_tasks.size() > 1) { // Quantum Communications 
-        if (qc.quantum_tasks[0].config.contains("n_communication_qubits")) {
-            n_comm_qubits = qc.quantum_tasks[0].config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-        } else {
-            n_comm_qubits = 2;
-        }
-
-        n_qubits += n_comm_qubits;
-    }
+    const size_t n_comm_qubits = n_communication_qubits(qc.quantum_tasks);
+    n_qubits += n_comm_qubits;
 
 
-    auto start = std::chrono::high_resolution_clock::now();
+    const std::uint64_t seed = simulation_seed(qc.quantum_tasks[0].config);
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
-        #pragma omp parallel
-        {
-            std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>> local_counter;
-            
-            Executor executor(n_qubits);
+    // Quantum communications, or a single circuit small enough to split its shots among the threads
+    const bool parallel = size(qc.quantum_tasks) > 1 || parallelize_shots(qc.quantum_tasks[0].config, n_qubits, shots);
+#else
+    const bool parallel = false;
+#endif
+    // With factorized_state the tasks of the quantum communications start on statevectors of
+    // their own, merged only as the protocols entangle them
+    const bool factorized = allows_qc && size(qc.quantum_tasks) > 1 && qc.quantum_tasks[0].config.value("factorized_state", false);
 
-            #pragma omp for
-            for (std::size_t i = 0; i < shots; i++) {
-                update_meas_counter(local_counter, execute_shot_(executor, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-                executor.restart_statevector();
-            }
+    // With classical communications, shot_block shots advance together from one RECV to the next
+    // and exchange their measurements in a frame per target
+    const std::size_t shot_block = classical_channel && !allows_qc ? qc.quantum_tasks[0].config.value("shot_block", 1) : 1;
+    // With speculation, the RECVs of one or two clbits guess them instead of waiting, on states
+    // small enough to copy before each guess
+    const bool speculate = classical_channel && !allows_qc && n_qubits <= SPECULATION_MAX_QUBITS
+                           && qc.quantum_tasks[0].config.value("speculation", false);
 
-            #pragma omp critical
-            for (const auto& [id, bitstrings_counter] : local_counter) {
-                for (const auto& [bitstring, counts] : bitstrings_counter) {
-                    meas_counter[id][bitstring] += counts;
-                } 
-            }
+    const ShotConvergence convergence = ShotConvergence::from_config(qc.quantum_tasks[0].config, classical_channel != nullptr);
+
+    std::vector<std::size_t> task_qubits;
+    for (const auto& quantum_task : st_qtasks)
+        task_qubits.push_back(quantum_task.n_qubits);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::optional<Shots> shots_run;
+    // Each shot thread keeps the amplitudes of a small circuit in its own stack
+    const bool small = !factorized && method != "sparse" && SMALL_STATEVECTOR && n_qubits <= SMALL_SHOTS_MAX_QUBITS && visit_small_statevector(n_qubits, [&]<typename State>(std::type_identity<State>) {
+        shots_run = run_shots<State>(st_qtasks, n_comm_qubits, shots, shot_block, speculate, seed, parallel, classical_channel, allows_qc,
+                                     [] { return State(); }, convergence);
+    });
+    // The sparse state goes on the same, as it moves to a whole statevector by itself once it fills
+    const bool sparse = !factorized && method == "sparse";
+    if (sparse)
+        shots_run = run_shots<SparseStatevector>(st_qtasks, n_comm_qubits, shots, shot_block, speculate, seed, parallel, classical_channel, allows_qc,
+                                                 [&] { return SparseStatevector(n_qubits); }, convergence);
+    else if (factorized)
+        shots_run = run_shots<FactorizedStatevector>(st_qtasks, n_comm_qubits, shots, shot_block, speculate, seed, parallel, classical_channel, allows_qc,
+                                                     [&] { return FactorizedStatevector(task_qubits, n_comm_qubits); }, convergence);
+    else if (!small) {
+        if (qc.quantum_tasks[0].config.value("merge_diagonals", true)) {
+            for (auto& st_qtask : st_qtasks)
+                merge_diagonal_runs(st_qtask);
         }
-    } else { // As if OPENMP_IN_QC not enabled
-        Executor executor(n_qubits);
-        for (int i = 0; i < shots; i++) {
-            update_meas_counter(meas_counter, execute_shot_(executor, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-            executor.restart_statevector();
-            
-        } // End all shots
+        shots_run = run_shots<CunqaStatevector>(st_qtasks, n_comm_qubits, shots, shot_block, speculate, seed, parallel, classical_channel, allows_qc,
+                                                [&] { return CunqaStatevector(n_qubits); }, convergence);
     }
-#else
-    Executor executor(n_qubits);
-    for (int i = 0; i < shots; i++) {
-        update_meas_counter(meas_counter, execute_shot_(executor, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-        executor.restart_statevector();
-        
-    } // End all shots
-#endif
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> duration = end - start;
     float time_taken = duration.count();
 
     JSON result_json = {
-        {"id_counts", meas_counter},
+        {"id_counts", shots_run->meas_counter},
         {"time_taken", time_taken}};
+    if (n_comm_qubits != 0)
+        result_json["scheduler"] = {{"communication_qubits", n_comm_qubits}, {"blocked_iterations", shots_run->blocked_iterations}};
+    if (factorized)
+        result_json["scheduler"]["max_statevector_qubits"] = shots_run->max_qubits;
+    if (convergence.enabled())
+        result_json["convergence"] = convergence.report(shots_run->shots, shots_run->standard_error);
+    if (speculate)
+        result_json["speculation"] = {{"hits", shots_run->speculation_hits}, {"misses", shots_run->speculation_misses}};
     return result_json;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <optional>
 
 #include "quantum_task.hpp"
 #include "classical_channel/classical_channel.hpp"
@@ -16,10 +17,18 @@ class CunqaSimulatorAdapter
 {
 public:
     CunqaSimulatorAdapter() = default;
-    CunqaSimulatorAdapter(CunqaComputationAdapter& qc) : qc{qc} {}
+    CunqaSimulatorAdapter(CunqaComputationAdapter qc) : qc{std::move(qc)} {}
 
     JSON simulate([[maybe_unused]] const Backend* backend);
+    // The same, with the counts sampled natively written into the reply as integers
+    void simulate([[maybe_unused]] const Backend* backend, ResultWriter& writer);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    // The results of the circuit under each parameter set of a batch, as {"batch": [...]}, with the
+    // sets run together on the lanes of a LaneStatevector. Nothing if the circuit does not run on one
+    std::optional<JSON> simulate_batch(const std::vector<std::vector<double>>& params_batch);
+    // Expectation values of the observables of the config and their gradients by the parameters,
+    // by adjoint differentiation: a pass forward and one backward over the circuit
+    JSON simulate_gradient();
 
     CunqaComputationAdapter qc;
 
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <initializer_list>
+
+#include "utils/constants.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "cunqa_statevector.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Largest circuits run on a SmallStatevector, whose 2^16 amplitudes take 1 MB
+constexpr std::size_t SMALL_STATEVECTOR_MAX_QUBITS = 16;
+
+// Statevector of a fixed number of qubits, for the small circuits of the variational algorithms,
+// where the dispatch of each gate and the setup of the general statevector cost more than the
+// arithmetic. The amplitudes live in an aligned array inside the object, with no allocation, and
+// there is a kernel per target, whose stride, mask and loop bounds are constants that the
+// compiler unrolls and vectorizes. Gates are applied at once, on a single thread, without the
+// queue of the cache blocking. Same interface as CunqaStatevector for the CUNQA adapter
+template <std::size_t N>
+class SmallStatevector {
+    static_assert(N >= 1 && N <= SMALL_STATEVECTOR_MAX_QUBITS);
+
+public:
+    SmallStatevector() { restart_statevector(); }
+
+    inline void restart_statevector()
+    {
+        amplitudes_.fill(0.0);
+        amplitudes_[0] = 1.0;
+    }
+    inline void seed_shot(const std::uint64_t seed, const std::size_t shot) { rng_ = ShotRng(seed, shot); }
+
+    void apply_gate(const int type, std::span<const int> qubits)
+    {
+        switch (type)
+        {
+        case constants::ID:
+            break;
+        case constants::CX:
+        case constants::CY:
+        case constants::CZ:
+            apply_matrix_(qubits[1], gate_matrix(type == constants::CX ? constants::X : type == constants::CY ? constants::Y : constants::Z),
+                          std::uint64_t(1) << qubits[0]);
+            break;
+        case constants::SWAP:
+            apply_matrix_(qubits[1], X_, std::uint64_t(1) << qubits[0]);
+            apply_matrix_(qubits[0], X_, std::uint64_t(1) << qubits[1]);
+            apply_matrix_(qubits[1], X_, std::uint64_t(1) << qubits[0]);
+            break;
+        default:
+            apply_matrix_(qubits[0], gate_matrix(type));
+        }
+    }
+
+    void apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params)
+    {
+        if (params.empty())
+            throw std::out_of_range("Parametric gate without parameters.");
+        const GateMatrix m = rotation_matrix(type, params[0]);
+        if (type == constants::CRX || type == constants::CRY || type == constants::CRZ)
+            apply_matrix_(qubits[1], m, std::uint64_t(1) << qubits[0]);
+        else
+            apply_matrix_(qubits[0], m);
+    }
+
+    inline int apply_measure(std::span<const int> qubits) { return measure_with(qubits[0], rng_.uniform()); }
+
+    int measure_with(const int qubit, const double draw)
+    {
+        const std::uint64_t stride = std::uint64_t(1) << qubit;
+        double p1 = 0.0;
+        for (std::uint64_t i = 0; i < DIM; i++) {
+            if (i & stride)
+                p1 += std::norm(amplitudes_[i]);
+        }
+
+        const int outcome = draw < p1 ? 1 : 0;
+        const double norm = 1.0 / std::sqrt(outcome ? p1 : 1.0 - p1);
+        for (std::uint64_t i = 0; i < DIM; i++) {
+            if (((i & stride) != 0) == (outcome == 1))
+                amplitudes_[i] *= norm;
+            else
+                amplitudes_[i] = 0.0;
+        }
+        return outcome;
+    }
+
+    inline void copy_to(SmallStatevector& copy) const
+    {
+        copy.amplitudes_ = amplitudes_;
+        copy.rng_ = rng_;
+    }
+
+    inline void apply_gate(const int type, std::initializer_list<int> qubits) { apply_gate(type, std::span(qubits.begin(), qubits.size())); }
+    inline void apply_parametric_gate(const int type, std::initializer_list<int> qubits, std::span<const double> params)
+    {
+        apply_parametric_gate(type, std::span(qubits.begin(), qubits.size()), params);
+    }
+    inline int apply_measure(std::initializer_list<int> qubits) { return apply_measure(std::span(qubits.begin(), qubits.size())); }
+
+    inline const Amplitude* data() const { return amplitudes_.data(); }
+    inline Amplitude* mutable_data() { return amplitudes_.data(); }
+    static constexpr std::uint64_t dim() { return DIM; }
+    static constexpr std::size_t n_qubits() { return N; }
+
+private:
+    static constexpr std::uint64_t DIM = std::uint64_t(1) << N;
+    static constexpr std::uint64_t SIMD_RUN = 2;
+    static constexpr GateMatrix X_ = {0.0, 1.0, 1.0, 0.0};
+
+    using Kernel = void (*)(Amplitude*, const GateMatrix&, const std::uint64_t);
+
+    // The pairs of the target, those whose controls are all set if the gate has any. The runs of
+    // SIMD_RUN amplitudes or more go to the SIMD kernels of CunqaStatevector, and the rest are
+    // unrolled here
+    template <std::size_t Target, bool Controlled>
+    static void kernel_(Amplitude* a, const GateMatrix& m, const std::uint64_t control_mask)
+    {
+        constexpr std::uint64_t STRIDE = std::uint64_t(1) << Target;
+        if constexpr (!Controlled && Target == 0) {
+            return apply_pairs_kernel(a, DIM / 2, m);
+        } else if constexpr (STRIDE >= SIMD_RUN) {
+            // The controls below the target cut its runs
+            const std::uint64_t run = std::min(STRIDE, control_mask & (STRIDE - 1) ? control_mask & -control_mask : STRIDE);
+            if (run >= SIMD_RUN) {
+                for (std::uint64_t i = 0; i < DIM; i += 2 * STRIDE) {
+                    for (std::uint64_t j = i; j < i + STRIDE; j += run) {
+                        if (!Controlled || (j & control_mask) == control_mask)
+                            apply_run_kernel(a + j, a + j + STRIDE, run, m);
+                    }
+                }
+                return;
+            }
+        }
+
+        // Real arithmetic, as the products of std::complex check for infinities
+        const double r00 = m.m00.real(), i00 = m.m00.imag(), r01 = m.m01.real(), i01 = m.m01.imag();
+        const double r10 = m.m10.real(), i10 = m.m10.imag(), r11 = m.m11.real(), i11 = m.m11.imag();
+        for (std::uint64_t i = 0; i < DIM; i += 2 * STRIDE) {
+            for (std::uint64_t j = i; j < i + STRIDE; j++) {
+                if constexpr (Controlled) {
+                    if ((j & control_mask) != control_mask)
+                        continue;
+                }
+                const double xr = a[j].real(), xi = a[j].imag(), yr = a[j + STRIDE].real(), yi = a[j + STRIDE].imag();
+                a[j] = {r00 * xr - i00 * xi + r01 * yr - i01 * yi, r00 * xi + i00 * xr + r01 * yi + i01 * yr};
+                a[j + STRIDE] = {r10 * xr - i10 * xi + r11 * yr - i11 * yi, r10 * xi + i10 * xr + r11 * yi + i11 * yr};
+            }
+        }
+    }
+
+    template <bool Controlled, std::size_t... Targets>
+    static constexpr std::array<Kernel, N> kernels_(std::index_sequence<Targets...>)
+    {
+        return {&kernel_<Targets, Controlled>...};
+    }
+
+    static constexpr std::array<Kernel, N> KERNELS = kernels_<false>(std::make_index_sequence<N>{});
+    static constexpr std::array<Kernel, N> CONTROLLED_KERNELS = kernels_<true>(std::make_index_sequence<N>{});
+
+    alignas(64) std::array<Amplitude, DIM> amplitudes_;
+    ShotRng rng_{0, 0};
+
+    inline void apply_matrix_(const std::size_t target, const GateMatrix& m, const std::uint64_t control_mask = 0)
+    {
+        if (control_mask)
+            CONTROLLED_KERNELS[target](amplitudes_.data(), m, control_mask);
+        else
+            KERNELS[target](amplitudes_.data(), m, 0);
+    }
+};
+
+// Calls f with the std::type_identity of the SmallStatevector of n_qubits, and returns whether
+// there is one
+template <typename F>
+bool visit_small_statevector(const std::size_t n_qubits, F&& f)
+{
+    return [&]<std::size_t... Ns>(std::index_sequence<Ns...>) {
+        return ((n_qubits == Ns + 1 && (f(std::type_identity<SmallStatevector<Ns + 1>>{}), true)) || ...);
+    }(std::make_index_sequence<SMALL_STATEVECTOR_MAX_QUBITS>{});
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,275 @@
+#include <map>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+#include "cunqa_sparse_statevector.hpp"
+#include "utils/constants.hpp"
+#include "utils/helpers/memory_usage.hpp"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::sim;
+
+// Fraction of the basis states populated past which the whole statevector is faster, unless
+// CUNQA_SPARSE_MAX_FILL sets another
+double detect_max_fill()
+{
+    const char* fill = std::getenv("CUNQA_SPARSE_MAX_FILL");
+    return fill ? std::strtod(fill, nullptr) : 1.0 / 16;
+}
+
+const double MAX_FILL = detect_max_fill();
+
+const std::optional<std::uint64_t> MEMORY_LIMIT = memory_limit();
+
+// Amplitudes whose probability is below this are taken as cancelled out and dropped
+constexpr double PRUNE_NORM = 1e-30;
+
+const GateMatrix X_MATRIX = {0.0, 1.0, 1.0, 0.0};
+const GateMatrix Y_MATRIX = {0.0, Amplitude(0.0, -1.0), Amplitude(0.0, 1.0), 0.0};
+const GateMatrix Z_MATRIX = {1.0, 0.0, 0.0, -1.0};
+
+inline void keep(std::unordered_map<std::uint64_t, Amplitude>& amplitudes, const std::uint64_t state, const Amplitude amplitude)
+{
+    if (std::norm(amplitude) > PRUNE_NORM)
+        amplitudes.emplace(state, amplitude);
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+SparseStatevector::SparseStatevector(const std::size_t n_qubits) :
+    n_qubits_{n_qubits},
+    // Beyond 2^48 states the whole statevector never fits
+    max_entries_{n_qubits <= 48 ? static_cast<std::uint64_t>(MAX_FILL * static_cast<double>(std::uint64_t(1) << n_qubits))
+                                : std::numeric_limits<std::uint64_t>::max()}
+{
+    if (n_qubits > 64)
+        throw std::runtime_error("The sparse statevector holds at most 64 qubits.");
+    restart_statevector();
+}
+
+void SparseStatevector::restart_statevector()
+{
+    dense_.reset();
+    amplitudes_.clear();
+    amplitudes_.emplace(0, 1.0);
+}
+
+void SparseStatevector::apply_gate(const int type, std::span<const int> qubits)
+{
+    if (dense_)
+        return dense_->apply_gate(type, qubits);
+    switch (type)
+    {
+    case constants::ID:
+        break;
+    case constants::CX:
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::CY:
+        apply_matrix_(qubits[1], Y_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::CZ:
+        apply_matrix_(qubits[1], Z_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::SWAP:
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        apply_matrix_(qubits[0], X_MATRIX, std::uint64_t(1) << qubits[1]);
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    default:
+        apply_matrix_(qubits[0], gate_matrix(type));
+    }
+}
+
+void SparseStatevector::apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params)
+{
+    if (dense_)
+        return dense_->apply_parametric_gate(type, qubits, params);
+    if (params.empty())
+        throw std::out_of_range("Parametric gate without parameters.");
+    const GateMatrix m = rotation_matrix(type, params[0]);
+    if (type == constants::CRX || type == constants::CRY || type == constants::CRZ)
+        apply_matrix_(qubits[1], m, std::uint64_t(1) << qubits[0]);
+    else
+        apply_matrix_(qubits[0], m);
+}
+
+// The draws are those of the sparse state also once it moved to the whole statevector, so a shot
+// keeps a single stream
+int SparseStatevector::apply_measure(std::span<const int> qubits)
+{
+    if (dense_)
+        return dense_->measure_with(qubits[0], rng_.uniform());
+    const double p1 = probability_one_(qubits[0]);
+    const int outcome = rng_.uniform() < p1 ? 1 : 0;
+    collapse_(qubits[0], outcome, 1.0 / std::sqrt(outcome ? p1 : 1.0 - p1), false);
+    return outcome;
+}
+
+int SparseStatevector::apply_reset(const int qubit)
+{
+    if (dense_) {
+        const int outcome = dense_->measure_with(qubit, rng_.uniform());
+        if (outcome)
+            dense_->apply_gate(constants::X, {qubit});
+        return outcome;
+    }
+    const double p1 = probability_one_(qubit);
+    const int outcome = rng_.uniform() < p1 ? 1 : 0;
+    collapse_(qubit, outcome, 1.0 / std::sqrt(outcome ? p1 : 1.0 - p1), true);
+    return outcome;
+}
+
+void SparseStatevector::copy_to(SparseStatevector& copy)
+{
+    copy.n_qubits_ = n_qubits_;
+    copy.max_entries_ = max_entries_;
+    copy.rng_ = rng_;
+    copy.amplitudes_ = amplitudes_;
+    if (!dense_) {
+        copy.dense_.reset();
+        return;
+    }
+    if (!copy.dense_)
+        copy.dense_.emplace();
+    dense_->copy_to(*copy.dense_);
+}
+
+Histogram SparseStatevector::sample(const std::vector<std::pair<std::uint64_t, std::size_t>>& measures, const std::size_t shots,
+                                    const std::uint64_t seed)
+{
+    if (dense_) {
+        const Amplitude* a = dense_->data();
+        auto probability = [a](const std::uint64_t i) { return std::norm(a[i]); };
+        return measures.empty() ? sample_histogram(dense_->dim(), probability, shots, seed)
+                                : sample_measured(dense_->dim(), probability, measures, shots, seed);
+    }
+
+    std::vector<std::pair<std::uint64_t, Amplitude>> populated(amplitudes_.begin(), amplitudes_.end());
+    std::sort(populated.begin(), populated.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    const auto sampled = sample_histogram(populated.size(), [&populated](const std::uint64_t i) { return std::norm(populated[i].second); },
+                                          shots, seed);
+    if (measures.empty()) {
+        Histogram histogram;
+        for (const auto& [i, count] : sampled)
+            histogram.emplace_back(populated[i].first, count);
+        return histogram;
+    }
+
+    std::map<std::uint64_t, std::size_t> registers;
+    for (const auto& [i, count] : sampled) {
+        std::uint64_t creg = 0;
+        for (const auto& [qubit, clbit] : measures)
+            creg |= ((populated[i].first >> qubit) & 1) << clbit;
+        registers[creg] += count;
+    }
+    return Histogram(registers.begin(), registers.end());
+}
+
+void SparseStatevector::apply_matrix_(const std::size_t target, const GateMatrix& m, const std::uint64_t control_mask)
+{
+    const std::uint64_t bit = std::uint64_t(1) << target;
+
+    // Diagonal: each amplitude only scaled, and dropped if the gate projects it out
+    if (m.m01 == 0.0 && m.m10 == 0.0) {
+        for (auto it = amplitudes_.begin(); it != amplitudes_.end();) {
+            if ((it->first & control_mask) == control_mask) {
+                it->second *= (it->first & bit) ? m.m11 : m.m00;
+                if (std::norm(it->second) <= PRUNE_NORM) {
+                    it = amplitudes_.erase(it);
+                    continue;
+                }
+            }
+            ++it;
+        }
+        return;
+    }
+
+    next_.clear();
+    if (m.m00 == 0.0 && m.m11 == 0.0) {
+        // Antidiagonal: each amplitude moves to the state with the target flipped
+        for (const auto& [state, amplitude] : amplitudes_) {
+            if ((state & control_mask) != control_mask)
+                next_.emplace(state, amplitude);
+            else
+                keep(next_, state ^ bit, amplitude * ((state & bit) ? m.m01 : m.m10));
+        }
+    } else {
+        // Each pair once, from its state with the target off or from the other one if that is empty
+        for (const auto& [state, amplitude] : amplitudes_) {
+            if ((state & control_mask) != control_mask) {
+                next_.emplace(state, amplitude);
+                continue;
+            }
+            Amplitude x = 0.0, y = 0.0;
+            if (state & bit) {
+                if (amplitudes_.contains(state ^ bit))
+                    continue;
+                y = amplitude;
+            } else {
+                x = amplitude;
+                if (const auto other = amplitudes_.find(state | bit); other != amplitudes_.end())
+                    y = other->second;
+            }
+            keep(next_, state & ~bit, m.m00 * x + m.m01 * y);
+            keep(next_, state | bit, m.m10 * x + m.m11 * y);
+        }
+    }
+    std::swap(amplitudes_, next_);
+
+    if (amplitudes_.size() > max_entries_)
+        densify_();
+}
+
+void SparseStatevector::collapse_(const int qubit, const int outcome, const double norm, const bool reset)
+{
+    const std::uint64_t bit = std::uint64_t(1) << qubit;
+    const std::uint64_t kept = outcome ? bit : 0;
+    next_.clear();
+    for (const auto& [state, amplitude] : amplitudes_) {
+        if ((state & bit) == kept)
+            next_.emplace(reset ? state & ~bit : state, amplitude * norm);
+    }
+    std::swap(amplitudes_, next_);
+}
+
+// The admission of the task counts nothing for the sparse state, so the whole statevector is
+// checked against the memory of the vQPU before it is allocated
+void SparseStatevector::densify_()
+{
+    if (MEMORY_LIMIT) {
+        const std::uint64_t needed = sizeof(Amplitude) << n_qubits_;
+        const std::uint64_t in_use = resident_bytes();
+        if (in_use + needed > *MEMORY_LIMIT)
+            throw std::runtime_error(not_enough_memory(needed, in_use, *MEMORY_LIMIT));
+    }
+    dense_.emplace(n_qubits_);
+    Amplitude* a = dense_->mutable_data();
+    a[0] = 0.0;
+    for (const auto& [state, amplitude] : amplitudes_)
+        a[state] = amplitude;
+    amplitudes_.clear();
+    next_.clear();
+}
+
+double SparseStatevector::probability_one_(const int qubit) const
+{
+    const std::uint64_t bit = std::uint64_t(1) << qubit;
+    double p1 = 0.0;
+    for (const auto& [state, amplitude] : amplitudes_) {
+        if (state & bit)
+            p1 += std::norm(amplitude);
+    }
+    return p1;
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
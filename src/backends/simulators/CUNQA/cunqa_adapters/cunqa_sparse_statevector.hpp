@@ -0,0 +1,80 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <initializer_list>
+
+#include "cunqa_statevector.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/sample_histogram.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Statevector of the circuits that keep few basis states populated, as the arithmetic, the
+// oracles and the state preparations, with only the nonzero amplitudes kept in a hash map by
+// their basis state, so its memory and the cost of a gate follow from them and not from 2^n.
+// The gates are those of CunqaStatevector, with the same qubits: a diagonal one scales the
+// amplitudes in place, an X or a Y moves them to the states with the target flipped, and any
+// other pairs each amplitude with that of the flipped state, the amplitudes that cancel out
+// being dropped. Once more than a fraction of the 2^n states are populated (1/16, or
+// CUNQA_SPARSE_MAX_FILL), the hash map weighs more and is slower than the whole statevector, so
+// the state moves to a CunqaStatevector and goes on there until it restarts, or throws if that
+// does not fit in the memory of the vQPU
+class SparseStatevector {
+public:
+    explicit SparseStatevector(const std::size_t n_qubits);
+    // Of no qubits, to copy another one into
+    SparseStatevector() : SparseStatevector(0) {}
+
+    void restart_statevector();
+    inline void seed_shot(const std::uint64_t seed, const std::size_t shot) { rng_ = ShotRng(seed, shot); }
+
+    void apply_gate(const int type, std::span<const int> qubits);
+    void apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params);
+    // Measures the first qubit and collapses the state onto the outcome
+    int apply_measure(std::span<const int> qubits);
+    // Measures the qubit and leaves it in 0, with the draw of a measurement, and returns the outcome
+    int apply_reset(const int qubit);
+    // Copies the amplitudes and the stream of draws, for a state to go back to
+    void copy_to(SparseStatevector& copy);
+
+    inline void apply_gate(const int type, std::initializer_list<int> qubits) { apply_gate(type, std::span(qubits.begin(), qubits.size())); }
+    inline void apply_parametric_gate(const int type, std::initializer_list<int> qubits, std::span<const double> params)
+    {
+        apply_parametric_gate(type, std::span(qubits.begin(), qubits.size()), params);
+    }
+    inline int apply_measure(std::initializer_list<int> qubits) { return apply_measure(std::span(qubits.begin(), qubits.size())); }
+
+    // Histogram of the measured qubits, pairs of qubit and clbit, or of all of them if there are
+    // none, drawn from the populated states in the order of their index, as sample_histogram
+    Histogram sample(const std::vector<std::pair<std::uint64_t, std::size_t>>& measures, const std::size_t shots,
+                     const std::uint64_t seed);
+
+    inline std::size_t n_qubits() const { return n_qubits_; }
+    // Basis states populated, or all of them once it moved to the whole statevector
+    inline std::uint64_t size() const { return dense_ ? dense_->dim() : amplitudes_.size(); }
+    inline bool is_dense() const { return dense_.has_value(); }
+
+    static bool supports(const int type) { return CunqaStatevector::supports(type); }
+
+private:
+    std::size_t n_qubits_;
+    std::uint64_t max_entries_; // Past which it moves to the whole statevector
+    std::unordered_map<std::uint64_t, Amplitude> amplitudes_;
+    std::unordered_map<std::uint64_t, Amplitude> next_; // Those a gate writes, kept for their buckets
+    std::optional<CunqaStatevector> dense_;
+    ShotRng rng_{0, 0};
+
+    void apply_matrix_(const std::size_t target, const GateMatrix& m, const std::uint64_t control_mask = 0);
+    // Keeps the amplitudes of the outcome, scaled by norm, with the qubit flipped to 0 for a reset
+    void collapse_(const int qubit, const int outcome, const double norm, const bool reset);
+    void densify_();
+    double probability_one_(const int qubit) const;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
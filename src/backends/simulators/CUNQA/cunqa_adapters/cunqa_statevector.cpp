@@ -0,0 +1,650 @@
+#include <bit>
+#include <array>
+#include <cmath>
+#include <string>
+#include <cstdlib>
+#include <numbers>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "cunqa_statevector.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::sim;
+
+enum class Simd { scalar, avx2, avx512 };
+
+// Amplitudes of the pieces in which the runs are split, so that even a single run, as that of
+// the highest target, spreads over the threads
+constexpr std::uint64_t MAX_RUN = std::uint64_t(1) << 12;
+
+// The pairs (a[k], b[k]) of a run of n amplitudes
+inline void run_scalar(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m)
+{
+    for (std::uint64_t k = 0; k < n; k++) {
+        const double xr = a[k].real(), xi = a[k].imag(), yr = b[k].real(), yi = b[k].imag();
+        a[k] = {m.m00.real() * xr - m.m00.imag() * xi + m.m01.real() * yr - m.m01.imag() * yi,
+                m.m00.real() * xi + m.m00.imag() * xr + m.m01.real() * yi + m.m01.imag() * yr};
+        b[k] = {m.m10.real() * xr - m.m10.imag() * xi + m.m11.real() * yr - m.m11.imag() * yi,
+                m.m10.real() * xi + m.m10.imag() * xr + m.m11.real() * yi + m.m11.imag() * yr};
+    }
+}
+
+// The pairs (a[2k], a[2k+1]) of a target 0, n pairs
+inline void pairs_scalar(Amplitude* a, const std::uint64_t n, const GateMatrix& m)
+{
+    for (std::uint64_t k = 0; k < n; k++)
+        run_scalar(a + 2 * k, a + 2 * k + 1, 1, m);
+}
+
+#if defined(__x86_64__)
+
+// Each vector holds whole amplitudes, real and imaginary parts interleaved. The products by the
+// matrix add the real parts of its entries times the amplitudes and subtract (even lanes) or
+// add (odd lanes) their imaginary parts times the amplitudes with the parts swapped
+
+__attribute__((target("avx2,fma")))
+void run_avx2(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m)
+{
+    double* pa = reinterpret_cast<double*>(a);
+    double* pb = reinterpret_cast<double*>(b);
+    const __m256d r00 = _mm256_set1_pd(m.m00.real()), i00 = _mm256_set1_pd(m.m00.imag());
+    const __m256d r01 = _mm256_set1_pd(m.m01.real()), i01 = _mm256_set1_pd(m.m01.imag());
+    const __m256d r10 = _mm256_set1_pd(m.m10.real()), i10 = _mm256_set1_pd(m.m10.imag());
+    const __m256d r11 = _mm256_set1_pd(m.m11.real()), i11 = _mm256_set1_pd(m.m11.imag());
+
+    const std::uint64_t vectorized = n & ~std::uint64_t(1);
+    for (std::uint64_t k = 0; k < 2 * vectorized; k += 4) {
+        const __m256d x = _mm256_loadu_pd(pa + k), y = _mm256_loadu_pd(pb + k);
+        const __m256d xs = _mm256_permute_pd(x, 0b0101), ys = _mm256_permute_pd(y, 0b0101);
+        const __m256d na = _mm256_fmadd_pd(r00, x, _mm256_fmaddsub_pd(r01, y, _mm256_fmadd_pd(i00, xs, _mm256_mul_pd(i01, ys))));
+        const __m256d nb = _mm256_fmadd_pd(r10, x, _mm256_fmaddsub_pd(r11, y, _mm256_fmadd_pd(i10, xs, _mm256_mul_pd(i11, ys))));
+        _mm256_storeu_pd(pa + k, na);
+        _mm256_storeu_pd(pb + k, nb);
+    }
+    run_scalar(a + vectorized, b + vectorized, n - vectorized, m);
+}
+
+// One pair per vector: the amplitudes times the diagonal plus the swapped ones times the rest
+__attribute__((target("avx2,fma")))
+void pairs_avx2(Amplitude* a, const std::uint64_t n, const GateMatrix& m)
+{
+    double* p = reinterpret_cast<double*>(a);
+    const __m256d dr = _mm256_setr_pd(m.m00.real(), m.m00.real(), m.m11.real(), m.m11.real());
+    const __m256d di = _mm256_setr_pd(m.m00.imag(), m.m00.imag(), m.m11.imag(), m.m11.imag());
+    const __m256d or_ = _mm256_setr_pd(m.m01.real(), m.m01.real(), m.m10.real(), m.m10.real());
+    const __m256d oi = _mm256_setr_pd(m.m01.imag(), m.m01.imag(), m.m10.imag(), m.m10.imag());
+
+    for (std::uint64_t k = 0; k < 4 * n; k += 4) {
+        const __m256d v = _mm256_loadu_pd(p + k);
+        const __m256d vs = _mm256_permute2f128_pd(v, v, 1);
+        const __m256d t = _mm256_fmadd_pd(di, _mm256_permute_pd(v, 0b0101), _mm256_mul_pd(oi, _mm256_permute_pd(vs, 0b0101)));
+        _mm256_storeu_pd(p + k, _mm256_fmadd_pd(dr, v, _mm256_fmaddsub_pd(or_, vs, t)));
+    }
+}
+
+__attribute__((target("avx512f")))
+void run_avx512(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m)
+{
+    double* pa = reinterpret_cast<double*>(a);
+    double* pb = reinterpret_cast<double*>(b);
+    const __m512d r00 = _mm512_set1_pd(m.m00.real()), i00 = _mm512_set1_pd(m.m00.imag());
+    const __m512d r01 = _mm512_set1_pd(m.m01.real()), i01 = _mm512_set1_pd(m.m01.imag());
+    const __m512d r10 = _mm512_set1_pd(m.m10.real()), i10 = _mm512_set1_pd(m.m10.imag());
+    const __m512d r11 = _mm512_set1_pd(m.m11.real()), i11 = _mm512_set1_pd(m.m11.imag());
+
+    const std::uint64_t vectorized = n & ~std::uint64_t(3);
+    for (std::uint64_t k = 0; k < 2 * vectorized; k += 8) {
+        const __m512d x = _mm512_loadu_pd(pa + k), y = _mm512_loadu_pd(pb + k);
+        const __m512d xs = _mm512_permute_pd(x, 0x55), ys = _mm512_permute_pd(y, 0x55);
+        const __m512d na = _mm512_fmadd_pd(r00, x, _mm512_fmaddsub_pd(r01, y, _mm512_fmadd_pd(i00, xs, _mm512_mul_pd(i01, ys))));
+        const __m512d nb = _mm512_fmadd_pd(r10, x, _mm512_fmaddsub_pd(r11, y, _mm512_fmadd_pd(i10, xs, _mm512_mul_pd(i11, ys))));
+        _mm512_storeu_pd(pa + k, na);
+        _mm512_storeu_pd(pb + k, nb);
+    }
+    run_scalar(a + vectorized, b + vectorized, n - vectorized, m);
+}
+
+// Two pairs per vector
+__attribute__((target("avx512f")))
+void pairs_avx512(Amplitude* a, const std::uint64_t n, const GateMatrix& m)
+{
+    double* p = reinterpret_cast<double*>(a);
+    const __m512d dr = _mm512_setr_pd(m.m00.real(), m.m00.real(), m.m11.real(), m.m11.real(), m.m00.real(), m.m00.real(), m.m11.real(), m.m11.real());
+    const __m512d di = _mm512_setr_pd(m.m00.imag(), m.m00.imag(), m.m11.imag(), m.m11.imag(), m.m00.imag(), m.m00.imag(), m.m11.imag(), m.m11.imag());
+    const __m512d or_ = _mm512_setr_pd(m.m01.real(), m.m01.real(), m.m10.real(), m.m10.real(), m.m01.real(), m.m01.real(), m.m10.real(), m.m10.real());
+    const __m512d oi = _mm512_setr_pd(m.m01.imag(), m.m01.imag(), m.m10.imag(), m.m10.imag(), m.m01.imag(), m.m01.imag(), m.m10.imag(), m.m10.imag());
+
+    const std::uint64_t vectorized = n & ~std::uint64_t(1);
+    for (std::uint64_t k = 0; k < 4 * vectorized; k += 8) {
+        const __m512d v = _mm512_loadu_pd(p + k);
+        const __m512d vs = _mm512_permutex_pd(v, 0x4E);
+        const __m512d t = _mm512_fmadd_pd(di, _mm512_permute_pd(v, 0x55), _mm512_mul_pd(oi, _mm512_permute_pd(vs, 0x55)));
+        _mm512_storeu_pd(p + k, _mm512_fmadd_pd(dr, v, _mm512_fmaddsub_pd(or_, vs, t)));
+    }
+    pairs_scalar(a + 2 * vectorized, n - vectorized, m);
+}
+
+#endif
+
+Simd detect_simd()
+{
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    const bool avx512 = __builtin_cpu_supports("avx512f");
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    // A forced set of kernels is only taken if the CPU runs it
+    if (const char* forced = std::getenv("CUNQA_SIMD")) {
+        const std::string name(forced);
+        if (name == "scalar")
+            return Simd::scalar;
+        if (name == "avx2" && avx2)
+            return Simd::avx2;
+        if (name == "avx512" && avx512)
+            return Simd::avx512;
+    }
+    if (avx512)
+        return Simd::avx512;
+    if (avx2)
+        return Simd::avx2;
+#endif
+    return Simd::scalar;
+}
+
+const Simd SIMD = detect_simd();
+
+bool detect_cache_blocking()
+{
+    const char* blocking = std::getenv("CUNQA_CACHE_BLOCKING");
+    return !blocking || std::string(blocking) != "0";
+}
+
+const bool CACHE_BLOCKING = detect_cache_blocking();
+
+// Gates queued before a flush is forced, to bound the queue of circuits that never leave the
+// low qubits
+constexpr std::size_t MAX_PENDING = 256;
+
+void apply_run(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m)
+{
+#if defined(__x86_64__)
+    if (SIMD == Simd::avx512 && n >= 4)
+        return run_avx512(a, b, n, m);
+    if (SIMD != Simd::scalar && n >= 2)
+        return run_avx2(a, b, n, m);
+#endif
+    run_scalar(a, b, n, m);
+}
+
+void apply_pairs(Amplitude* a, const std::uint64_t n, const GateMatrix& m)
+{
+#if defined(__x86_64__)
+    if (SIMD == Simd::avx512)
+        return pairs_avx512(a, n, m);
+    if (SIMD == Simd::avx2)
+        return pairs_avx2(a, n, m);
+#endif
+    pairs_scalar(a, n, m);
+}
+
+// The pairs of the target whose controls are all set, in the 2^n_qubits amplitudes from a. The
+// controls below the target cut its runs of contiguous pairs, and the kernels take one run at a
+// time
+void sweep(Amplitude* a, const std::size_t n_qubits, const std::size_t target, const GateMatrix& m,
+           const std::uint64_t control_mask, const bool parallel)
+{
+    const std::uint64_t half = std::uint64_t(1) << (n_qubits - 1);
+    const std::size_t lowest_control = control_mask ? std::countr_zero(control_mask) : n_qubits;
+
+    if (target == 0) {
+        // Pair k is (2k, 2k+1), so control c is bit c - 1 of k
+        const std::uint64_t run = std::min(lowest_control < n_qubits ? std::uint64_t(1) << (lowest_control - 1) : half, MAX_RUN);
+        #pragma omp parallel for if (parallel)
+        for (std::int64_t k = 0; k < static_cast<std::int64_t>(half); k += run) {
+            if (((2 * static_cast<std::uint64_t>(k)) & control_mask) == control_mask)
+                apply_pairs(a + 2 * k, run, m);
+        }
+        return;
+    }
+
+    const std::uint64_t stride = std::uint64_t(1) << target;
+    const std::uint64_t run = std::min(std::uint64_t(1) << std::min(target, lowest_control), MAX_RUN);
+    #pragma omp parallel for if (parallel)
+    for (std::int64_t r = 0; r < static_cast<std::int64_t>(half); r += run) {
+        // Run r of the amplitudes with the target off, with a zero inserted at the target
+        const std::uint64_t i = ((static_cast<std::uint64_t>(r) >> target) << (target + 1)) | (static_cast<std::uint64_t>(r) & (stride - 1));
+        if ((i & control_mask) == control_mask)
+            apply_run(a + i, a + i + stride, run, m);
+    }
+}
+
+// Index r with a zero inserted at the bit of the qubit
+inline std::uint64_t insert_zero(const std::int64_t r, const int qubit)
+{
+    const std::uint64_t k = static_cast<std::uint64_t>(r);
+    return ((k >> qubit) << (qubit + 1)) | (k & ((std::uint64_t(1) << qubit) - 1));
+}
+
+// Entry of a diagonal on the qubits, in increasing order, that a basis state takes, its bits
+// gathered a byte of the index at a time
+class BitGather {
+public:
+    explicit BitGather(std::span<const int> sorted_qubits)
+    {
+        if (!sorted_qubits.empty())
+            bytes_.resize(sorted_qubits.back() / 8 + 1);
+        for (std::size_t m = 0; m < sorted_qubits.size(); m++) {
+            for (std::uint32_t value = 0; value < 256; value++) {
+                if ((value >> (sorted_qubits[m] % 8)) & 1)
+                    bytes_[sorted_qubits[m] / 8][value] |= std::uint32_t(1) << m;
+            }
+        }
+    }
+
+    inline std::uint32_t operator()(const std::uint64_t i) const
+    {
+        std::uint32_t entry = 0;
+        for (std::size_t b = 0; b < bytes_.size(); b++)
+            entry |= bytes_[b][(i >> (8 * b)) & 0xFF];
+        return entry;
+    }
+
+private:
+    std::vector<std::array<std::uint32_t, 256>> bytes_;
+};
+
+// Product b·a, the matrix of a followed by b
+GateMatrix compose(const GateMatrix& b, const GateMatrix& a)
+{
+    return {b.m00 * a.m00 + b.m01 * a.m10, b.m00 * a.m01 + b.m01 * a.m11,
+            b.m10 * a.m00 + b.m11 * a.m10, b.m10 * a.m01 + b.m11 * a.m11};
+}
+
+const Amplitude I(0.0, 1.0);
+const double SQRT1_2 = 1.0 / std::sqrt(2.0);
+
+const GateMatrix X_MATRIX = {0.0, 1.0, 1.0, 0.0};
+const GateMatrix Y_MATRIX = {0.0, -I, I, 0.0};
+const GateMatrix Z_MATRIX = {1.0, 0.0, 0.0, -1.0};
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+GateMatrix gate_matrix(const int type)
+{
+    switch (type)
+    {
+    case constants::X:
+        return X_MATRIX;
+    case constants::Y:
+        return Y_MATRIX;
+    case constants::Z:
+        return Z_MATRIX;
+    case constants::H:
+        return {SQRT1_2, SQRT1_2, SQRT1_2, -SQRT1_2};
+    case constants::S:
+        return {1.0, 0.0, 0.0, I};
+    case constants::SDG:
+        return {1.0, 0.0, 0.0, -I};
+    case constants::T:
+        return {1.0, 0.0, 0.0, std::polar(1.0, std::numbers::pi / 4)};
+    case constants::TDG:
+        return {1.0, 0.0, 0.0, std::polar(1.0, -std::numbers::pi / 4)};
+    case constants::SX:
+        return {Amplitude(0.5, 0.5), Amplitude(0.5, -0.5), Amplitude(0.5, -0.5), Amplitude(0.5, 0.5)};
+    case constants::SXDG:
+        return {Amplitude(0.5, -0.5), Amplitude(0.5, 0.5), Amplitude(0.5, 0.5), Amplitude(0.5, -0.5)};
+    default:
+        throw std::runtime_error("Gate " + std::to_string(type) + " is not a fixed gate of the CUNQA statevector");
+    }
+}
+
+GateMatrix rotation_matrix(const int type, const double theta)
+{
+    const double c = std::cos(theta / 2), s = std::sin(theta / 2);
+    switch (type)
+    {
+    case constants::RX:
+    case constants::CRX:
+        return {c, Amplitude(0.0, -s), Amplitude(0.0, -s), c};
+    case constants::RY:
+    case constants::CRY:
+        return {c, -s, s, c};
+    case constants::RZ:
+    case constants::CRZ:
+        return {std::polar(1.0, -theta / 2), 0.0, 0.0, std::polar(1.0, theta / 2)};
+    case constants::P:
+    case constants::U1:
+        return {1.0, 0.0, 0.0, std::polar(1.0, theta)};
+    default:
+        throw std::runtime_error("Gate " + std::to_string(type) + " is not a rotation of the CUNQA statevector");
+    }
+}
+
+GateMatrix rotation_derivative(const int type, const double theta)
+{
+    const double c = std::cos(theta / 2) / 2, s = std::sin(theta / 2) / 2;
+    switch (type)
+    {
+    case constants::RX:
+    case constants::CRX:
+        return {-s, Amplitude(0.0, -c), Amplitude(0.0, -c), -s};
+    case constants::RY:
+    case constants::CRY:
+        return {-s, -c, c, -s};
+    case constants::RZ:
+    case constants::CRZ:
+        return {Amplitude(0.0, -0.5) * std::polar(1.0, -theta / 2), 0.0, 0.0, Amplitude(0.0, 0.5) * std::polar(1.0, theta / 2)};
+    case constants::P:
+    case constants::U1:
+        return {0.0, 0.0, 0.0, I * std::polar(1.0, theta)};
+    default:
+        throw std::runtime_error("Gate " + std::to_string(type) + " is not a rotation of the CUNQA statevector");
+    }
+}
+
+void apply_run_kernel(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m)
+{
+    apply_run(a, b, n, m);
+}
+
+void apply_pairs_kernel(Amplitude* a, const std::uint64_t n, const GateMatrix& m)
+{
+    apply_pairs(a, n, m);
+}
+
+// Aligned to the cache lines, which the AVX-512 loads also fill whole
+constexpr std::size_t AMPLITUDES_ALIGNMENT = 64;
+
+CunqaStatevector::CunqaStatevector(const std::size_t n_qubits) :
+    n_qubits_{n_qubits},
+    dim_{std::uint64_t(1) << n_qubits},
+    amplitudes_{dim_ * sizeof(Amplitude), AMPLITUDES_ALIGNMENT}
+{
+    restart_statevector();
+}
+
+void CunqaStatevector::restart_statevector()
+{
+    pending_.clear();
+    const std::int64_t dim = dim_;
+    Amplitude* a = amplitudes_.data<Amplitude>();
+    #pragma omp parallel for schedule(static) if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i++)
+        a[i] = 0.0;
+    a[0] = 1.0;
+}
+
+bool CunqaStatevector::supports(const int type)
+{
+    switch (type)
+    {
+    case constants::ID: case constants::X: case constants::Y: case constants::Z: case constants::H:
+    case constants::S: case constants::SDG: case constants::T: case constants::TDG:
+    case constants::SX: case constants::SXDG:
+    case constants::CX: case constants::CY: case constants::CZ: case constants::SWAP:
+    case constants::RX: case constants::RY: case constants::RZ: case constants::P: case constants::U1:
+    case constants::CRX: case constants::CRY: case constants::CRZ:
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::string_view CunqaStatevector::simd()
+{
+    return SIMD == Simd::avx512 ? "avx512" : SIMD == Simd::avx2 ? "avx2" : "scalar";
+}
+
+void CunqaStatevector::apply_gate(const int type, std::span<const int> qubits)
+{
+    switch (type)
+    {
+    case constants::ID:
+        break;
+    case constants::CX:
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::CY:
+        apply_matrix_(qubits[1], Y_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::CZ:
+        apply_matrix_(qubits[1], Z_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    case constants::SWAP:
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        apply_matrix_(qubits[0], X_MATRIX, std::uint64_t(1) << qubits[1]);
+        apply_matrix_(qubits[1], X_MATRIX, std::uint64_t(1) << qubits[0]);
+        break;
+    default:
+        apply_matrix_(qubits[0], gate_matrix(type));
+    }
+}
+
+void CunqaStatevector::apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params)
+{
+    if (params.empty())
+        throw std::out_of_range("Parametric gate without parameters.");
+    const GateMatrix m = rotation_matrix(type, params[0]);
+    if (type == constants::CRX || type == constants::CRY || type == constants::CRZ)
+        apply_matrix_(qubits[1], m, std::uint64_t(1) << qubits[0]);
+    else
+        apply_matrix_(qubits[0], m);
+}
+
+int CunqaStatevector::apply_measure(std::span<const int> qubits)
+{
+    return measure_with(qubits[0], rng_.uniform());
+}
+
+int CunqaStatevector::measure_with(const int qubit, const double draw)
+{
+    const double p1 = probability_one_(qubit);
+    const int outcome = draw < p1 ? 1 : 0;
+    const double norm = 1.0 / std::sqrt(outcome ? p1 : 1.0 - p1);
+    // The projection onto the outcome is a gate, which the cache blocking applies along with those
+    // after it
+    apply_matrix_(qubit, outcome ? GateMatrix{0.0, 0.0, 0.0, norm} : GateMatrix{norm, 0.0, 0.0, 0.0});
+    return outcome;
+}
+
+int CunqaStatevector::apply_reset(const int qubit)
+{
+    const double p1 = probability_one_(qubit);
+    const int outcome = rng_.uniform() < p1 ? 1 : 0;
+    const double norm = 1.0 / std::sqrt(outcome ? p1 : 1.0 - p1);
+    // The projection followed by the X that takes a 1 back to 0
+    apply_matrix_(qubit, outcome ? GateMatrix{0.0, norm, 0.0, 0.0} : GateMatrix{norm, 0.0, 0.0, 0.0});
+    return outcome;
+}
+
+void CunqaStatevector::apply_bell_pair(const int q0, const int q1)
+{
+    flush_();
+    const std::uint64_t bit0 = std::uint64_t(1) << q0, bit1 = std::uint64_t(1) << q1;
+    const int low = std::min(q0, q1), high = std::max(q0, q1);
+    const std::int64_t quarter = dim_ / 4;
+    Amplitude* a = amplitudes_.data<Amplitude>();
+
+    // Probabilities of the values of q1 and q0, in that order
+    double p00 = 0.0, p01 = 0.0, p10 = 0.0, p11 = 0.0;
+    #pragma omp parallel for reduction(+:p00, p01, p10, p11) if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t r = 0; r < quarter; r++) {
+        const std::uint64_t base = insert_zero(insert_zero(r, low), high);
+        p00 += std::norm(a[base]);
+        p01 += std::norm(a[base | bit0]);
+        p10 += std::norm(a[base | bit1]);
+        p11 += std::norm(a[base | bit0 | bit1]);
+    }
+
+    // The draws of the resets of q1 and then of q0 that it replaces
+    const int outcome1 = rng_.uniform() < p10 + p11 ? 1 : 0;
+    const double p0_given = outcome1 ? p11 / (p10 + p11) : p01 / (p00 + p01);
+    const int outcome0 = rng_.uniform() < p0_given ? 1 : 0;
+    const double p = outcome1 ? (outcome0 ? p11 : p10) : (outcome0 ? p01 : p00);
+    const std::uint64_t kept = (outcome0 ? bit0 : 0) | (outcome1 ? bit1 : 0);
+    const double norm = 1.0 / std::sqrt(2.0 * p);
+
+    #pragma omp parallel for if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t r = 0; r < quarter; r++) {
+        const std::uint64_t base = insert_zero(insert_zero(r, low), high);
+        const Amplitude amplitude = a[base | kept] * norm;
+        a[base] = amplitude;
+        a[base | bit0] = 0.0;
+        a[base | bit1] = 0.0;
+        a[base | bit0 | bit1] = amplitude;
+    }
+}
+
+void CunqaStatevector::apply_diagonal(std::span<const int> qubits, std::span<const Amplitude> diagonal)
+{
+    flush_();
+    // The entries reordered for the qubits in increasing order, as BitGather reads them
+    std::vector<int> sorted(qubits.begin(), qubits.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<std::size_t> positions;
+    for (const auto qubit : qubits)
+        positions.push_back(std::lower_bound(sorted.begin(), sorted.end(), qubit) - sorted.begin());
+    std::vector<Amplitude> phases(diagonal.size());
+    for (std::size_t j = 0; j < phases.size(); j++) {
+        std::size_t entry = 0;
+        for (std::size_t m = 0; m < positions.size(); m++)
+            entry |= ((j >> positions[m]) & 1) << m;
+        phases[j] = diagonal[entry];
+    }
+
+    // The amplitudes that only differ below the lowest qubit take the same entry, and each run
+    // of them is multiplied by it
+    const BitGather gather(sorted);
+    const std::uint64_t run = std::min(sorted.empty() ? dim_ : std::uint64_t(1) << sorted.front(), MAX_RUN);
+    const std::int64_t dim = dim_;
+    Amplitude* a = amplitudes_.data<Amplitude>();
+    #pragma omp parallel for if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i += run) {
+        const Amplitude phase = phases[gather(i)];
+        const double pr = phase.real(), pi = phase.imag();
+        double* p = reinterpret_cast<double*>(a + i);
+        for (std::uint64_t k = 0; k < 2 * run; k += 2) {
+            const double re = p[k], im = p[k + 1];
+            p[k] = pr * re - pi * im;
+            p[k + 1] = pr * im + pi * re;
+        }
+    }
+}
+
+// Only the half of the amplitudes with the qubit set is read
+double CunqaStatevector::probability_one_(const int qubit)
+{
+    flush_();
+    const std::uint64_t stride = std::uint64_t(1) << qubit;
+    const std::int64_t half = dim_ / 2;
+    const Amplitude* a = amplitudes_.data<Amplitude>();
+
+    double p1 = 0.0;
+    #pragma omp parallel for reduction(+:p1) if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t r = 0; r < half; r++) {
+        const Amplitude amplitude = a[insert_zero(r, qubit) | stride];
+        p1 += amplitude.real() * amplitude.real() + amplitude.imag() * amplitude.imag();
+    }
+    return p1;
+}
+
+CunqaStatevector CunqaStatevector::kron(CunqaStatevector& high)
+{
+    flush_();
+    high.flush_();
+    CunqaStatevector product(n_qubits_ + high.n_qubits_);
+    const Amplitude* low_a = amplitudes_.data<Amplitude>();
+    const Amplitude* high_a = high.amplitudes_.data<Amplitude>();
+    Amplitude* a = product.amplitudes_.data<Amplitude>();
+    const std::uint64_t low_mask = dim_ - 1;
+    const std::int64_t dim = product.dim_;
+    #pragma omp parallel for schedule(static) if (product.n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i++)
+        a[i] = low_a[static_cast<std::uint64_t>(i) & low_mask] * high_a[static_cast<std::uint64_t>(i) >> n_qubits_];
+    return product;
+}
+
+void CunqaStatevector::copy_to(CunqaStatevector& copy)
+{
+    flush_();
+    if (copy.dim_ != dim_)
+        copy = CunqaStatevector(n_qubits_);
+    copy.pending_.clear();
+    copy.rng_ = rng_;
+    const Amplitude* from = amplitudes_.data<Amplitude>();
+    Amplitude* a = copy.amplitudes_.data<Amplitude>();
+    const std::int64_t dim = dim_;
+    #pragma omp parallel for schedule(static) if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i++)
+        a[i] = from[i];
+}
+
+CunqaStatevector CunqaStatevector::without(const int qubit, const int outcome)
+{
+    flush_();
+    CunqaStatevector rest(n_qubits_ - 1);
+    const Amplitude* from = amplitudes_.data<Amplitude>();
+    Amplitude* a = rest.amplitudes_.data<Amplitude>();
+    const std::uint64_t low_mask = (std::uint64_t(1) << qubit) - 1;
+    const std::uint64_t bit = static_cast<std::uint64_t>(outcome) << qubit;
+    const std::int64_t dim = rest.dim_;
+    #pragma omp parallel for schedule(static) if (rest.n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t j = 0; j < dim; j++) {
+        const std::uint64_t k = static_cast<std::uint64_t>(j);
+        a[j] = from[((k & ~low_mask) << 1) | bit | (k & low_mask)];
+    }
+    return rest;
+}
+
+void CunqaStatevector::apply_matrix_(const std::size_t target, const GateMatrix& m, const std::uint64_t control_mask)
+{
+    if (!CACHE_BLOCKING || n_qubits_ <= BLOCK_QUBITS || target >= BLOCK_QUBITS) {
+        flush_();
+        sweep(amplitudes_.data<Amplitude>(), n_qubits_, target, m, control_mask, n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS);
+        return;
+    }
+
+    // Consecutive gates on the same target and controls are fused into a single matrix
+    if (!pending_.empty() && pending_.back().target == target && pending_.back().control_mask == control_mask)
+        pending_.back().m = compose(m, pending_.back().m);
+    else
+        pending_.push_back({target, m, control_mask});
+
+    if (pending_.size() >= MAX_PENDING)
+        flush_();
+}
+
+// Each block has its high bits fixed, so the controls among them either hold for the whole
+// block or skip the gate in it, and the rest of the gate is applied inside the block
+void CunqaStatevector::flush_()
+{
+    if (pending_.empty())
+        return;
+
+    Amplitude* a = amplitudes_.data<Amplitude>();
+    const std::uint64_t low_mask = (std::uint64_t(1) << BLOCK_QUBITS) - 1;
+    const std::int64_t n_blocks = std::int64_t(1) << (n_qubits_ - BLOCK_QUBITS);
+    #pragma omp parallel for if (n_qubits_ >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t b = 0; b < n_blocks; b++) {
+        const std::uint64_t base = static_cast<std::uint64_t>(b) << BLOCK_QUBITS;
+        for (const auto& gate : pending_) {
+            const std::uint64_t high_controls = gate.control_mask & ~low_mask;
+            if ((base & high_controls) == high_controls)
+                sweep(a + base, BLOCK_QUBITS, gate.target, gate.m, gate.control_mask & low_mask, false);
+        }
+    }
+    pending_.clear();
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <string_view>
+#include <initializer_list>
+
+#include "utils/constants.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/huge_pages.hpp"
+
+namespace cunqa {
+namespace sim {
+
+using Amplitude = std::complex<double>;
+
+struct GateMatrix {
+    Amplitude m00, m01, m10, m11;
+};
+
+// Matrices of the fixed gates and of the rotations of one qubit, or of the target of their
+// controlled versions. Throw std::runtime_error for the rest
+GateMatrix gate_matrix(const int type);
+GateMatrix rotation_matrix(const int type, const double theta);
+// Derivative of rotation_matrix with respect to the angle, for the gradients
+GateMatrix rotation_derivative(const int type, const double theta);
+
+// Kernels of the statevector, with the SIMD instructions chosen for the CPU: on the pairs
+// (a[k], b[k]) of a run of n amplitudes, and on the n pairs (a[2k], a[2k+1]) of a target 0
+void apply_run_kernel(Amplitude* a, Amplitude* b, const std::uint64_t n, const GateMatrix& m);
+void apply_pairs_kernel(Amplitude* a, const std::uint64_t n, const GateMatrix& m);
+
+// Statevector of the CUNQA dynamic simulations, with the gates dispatched on the opcodes of
+// constants::INSTRUCTIONS instead of on their names. Each gate is a 2x2 matrix applied to the
+// pairs of amplitudes of its target, with AVX2 or AVX-512 kernels chosen once from the flags of
+// the CPU (CUNQA_SIMD=scalar|avx2|avx512 forces one). The pairs are walked in runs of contiguous
+// amplitudes, as long as the lowest of the target and the controls allows, so a high target
+// streams whole vectors and a target 0 packs its pairs in the lanes of a vector.
+// Gates whose target lies in the lowest BLOCK_QUBITS are not applied at once but queued, and the
+// queue is applied block by block of 2^BLOCK_QUBITS amplitudes, which fit in the L2 cache, so a
+// sequence of them costs one trip to memory instead of one per gate (CUNQA_CACHE_BLOCKING=0
+// turns it off). The queue is flushed before a gate on a higher target and before the amplitudes
+// are read.
+// The amplitudes are allocated untouched and zeroed by the same threads, and in the same static
+// partition, as the gates sweep them, so each page lands on the NUMA domain of its thread. They
+// go on huge pages if the QPU asks for them (CUNQA_HUGE_PAGES)
+class CunqaStatevector {
+public:
+    explicit CunqaStatevector(const std::size_t n_qubits);
+    // Of no qubits, to copy another one into
+    CunqaStatevector() : CunqaStatevector(0) {}
+
+    void restart_statevector();
+    // The measurements of a shot draw from its own stream, as in the other dynamic simulators
+    inline void seed_shot(const std::uint64_t seed, const std::size_t shot) { rng_ = ShotRng(seed, shot); }
+
+    // The qubits are taken as spans so the shot loops pass them without building a vector per gate
+    void apply_gate(const int type, std::span<const int> qubits);
+    void apply_parametric_gate(const int type, std::span<const int> qubits, std::span<const double> params);
+    // Measures the first qubit and collapses the state onto the outcome
+    int apply_measure(std::span<const int> qubits);
+    // The same with a uniform draw from elsewhere, for the states that share the stream of a shot
+    int measure_with(const int qubit, const double draw);
+    // Measures the qubit and leaves it in 0, with the draw of a measurement, and returns the outcome
+    int apply_reset(const int qubit);
+    // Resets both qubits, with the draws of q1 and then of q0, and entangles them in the Bell state
+    // (|00> + |11>)/√2, in two sweeps instead of those of two resets, an H and a CX
+    void apply_bell_pair(const int q0, const int q1);
+    // Multiplies each amplitude by the entry of the diagonal at the bits of the qubits, the first
+    // of them the lowest bit of the entry, in a single sweep whatever the qubits, for the runs of
+    // diagonal gates merged into one
+    void apply_diagonal(std::span<const int> qubits, std::span<const Amplitude> diagonal);
+
+    // State of the qubits of this one followed by those of high, their Kronecker product
+    CunqaStatevector kron(CunqaStatevector& high);
+    // State of the rest of the qubits once one of them was measured with that outcome, those
+    // above it shifted down by one
+    CunqaStatevector without(const int qubit, const int outcome);
+    // Copies the amplitudes and the stream of draws, for a state to go back to
+    void copy_to(CunqaStatevector& copy);
+
+    inline void apply_gate(const int type, std::initializer_list<int> qubits) { apply_gate(type, std::span(qubits.begin(), qubits.size())); }
+    inline void apply_parametric_gate(const int type, std::initializer_list<int> qubits, std::span<const double> params)
+    {
+        apply_parametric_gate(type, std::span(qubits.begin(), qubits.size()), params);
+    }
+    inline int apply_measure(std::initializer_list<int> qubits) { return apply_measure(std::span(qubits.begin(), qubits.size())); }
+
+    inline const Amplitude* data() { flush_(); return amplitudes_.data<Amplitude>(); }
+    // The amplitudes to write, for a state that is computed elsewhere
+    inline Amplitude* mutable_data() { flush_(); return amplitudes_.data<Amplitude>(); }
+    inline std::uint64_t dim() const { return dim_; }
+    inline std::size_t n_qubits() const { return n_qubits_; }
+
+    // Whether apply_gate or apply_parametric_gate run the instruction
+    static bool supports(const int type);
+    // Kernels in use: "avx512", "avx2" or "scalar"
+    static std::string_view simd();
+
+    static constexpr std::size_t BLOCK_QUBITS = 14;
+
+private:
+    struct PendingGate {
+        std::size_t target;
+        GateMatrix m;
+        std::uint64_t control_mask;
+    };
+
+    std::size_t n_qubits_;
+    std::uint64_t dim_;
+    StateBuffer amplitudes_;
+    std::vector<PendingGate> pending_;
+    ShotRng rng_{0, 0};
+
+    void apply_matrix_(const std::size_t target, const GateMatrix& m, const std::uint64_t control_mask = 0);
+    void flush_();
+    double probability_one_(const int qubit);
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -1,6 +1,7 @@
 #include "cunqa_cc_simulator.hpp"
 #include "cunqa_adapters/cunqa_computation_adapter.hpp"
 #include "cunqa_adapters/cunqa_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 using namespace std::string_literals;
 
@@ -15,13 +16,15 @@ CunqaCCSimulator::CunqaCCSimulator() :
 
 JSON CunqaCCSimulator::execute([[maybe_unused]] const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
+
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, channel);
 
     CunqaComputationAdapter cunqa_ca(quantum_task);
-    CunqaSimulatorAdapter cunqa_sa(cunqa_ca);
+    CunqaSimulatorAdapter cunqa_sa(std::move(cunqa_ca));
     if (quantum_task.is_dynamic) {
-        JSON result = cunqa_sa.simulate(&classical_channel);
+        JSON result = cunqa_sa.simulate(channel);
         return {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
@@ -23,12 +23,12 @@ CunqaQCSimulator::CunqaQCSimulator():
 
 JSON CunqaQCSimulator::execute(const QCBackend& backend, const QuantumTask& quantum_task)
 {
-    auto circuit = to_string(quantum_task);
+    auto circuit = rounds.message(quantum_task);
 
     classical_channel.send_info(circuit, executor_id);
     if (circuit != "") {
         auto results = classical_channel.recv_info(executor_id);
-        return JSON::parse(results);
+        return rounds.check(JSON::parse(results));
     }
     return JSON();
 }
@@ -2,6 +2,7 @@
 
 #include "cunqa_adapters/cunqa_computation_adapter.hpp"
 #include "cunqa_adapters/cunqa_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 namespace cunqa {
 namespace sim {
@@ -10,19 +11,58 @@ CunqaSimpleSimulator::~CunqaSimpleSimulator() = default;
 
 JSON CunqaSimpleSimulator::execute([[maybe_unused]] const SimpleBackend& backend, const QuantumTask& quantum_task)
 {
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task);
+
     CunqaComputationAdapter cunqa_ca(quantum_task);
-    CunqaSimulatorAdapter cunqa_sa(cunqa_ca);
+    CunqaSimulatorAdapter cunqa_sa(std::move(cunqa_ca));
     
     if (quantum_task.is_dynamic) {
         JSON result = cunqa_sa.simulate();
-        return {
+        JSON simple_result = {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
         };
+        if (result.contains("convergence"))
+            simple_result["convergence"] = result.at("convergence");
+        return simple_result;
     } else {
         return cunqa_sa.simulate(&backend);
     }
 }
 
+void CunqaSimpleSimulator::execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer)
+{
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, writer);
+    if (quantum_task.is_dynamic)
+        return writer.write(execute(backend, quantum_task));
+
+    CunqaComputationAdapter cunqa_ca(quantum_task);
+    CunqaSimulatorAdapter cunqa_sa(std::move(cunqa_ca));
+    cunqa_sa.simulate(&backend, writer);
+}
+
+JSON CunqaSimpleSimulator::execute_batch(const SimpleBackend& backend, QuantumTask& quantum_task)
+{
+    if (!quantum_task.is_dynamic && quantum_task.params_batch.size() > 1) {
+        CunqaComputationAdapter cunqa_ca(quantum_task);
+        CunqaSimulatorAdapter cunqa_sa(std::move(cunqa_ca));
+        if (auto results = cunqa_sa.simulate_batch(quantum_task.params_batch)) {
+            // As the sets one by one leave it
+            quantum_task.assign_params(quantum_task.params_batch.back());
+            return *results;
+        }
+    }
+    return SimulatorStrategy::execute_batch(backend, quantum_task);
+}
+
+JSON CunqaSimpleSimulator::execute_gradient([[maybe_unused]] const SimpleBackend& backend, const QuantumTask& quantum_task)
+{
+    CunqaComputationAdapter cunqa_ca(quantum_task);
+    CunqaSimulatorAdapter cunqa_sa(std::move(cunqa_ca));
+    return cunqa_sa.simulate_gradient();
+}
+
 } // End namespace sim
 } // End namespace cunqa
\ No newline at end of file
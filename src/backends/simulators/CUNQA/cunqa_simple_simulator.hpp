@@ -20,6 +20,10 @@ public:
 
     // TODO: The [[maybe_unused]] annotation is a temporary approach while CunqaSimulator does not take into account the backend info
     JSON execute([[maybe_unused]] const SimpleBackend& backend, const QuantumTask& quantum_task) override;
+    void execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer) override;
+    // The sweeps of the static circuits that fit run their parameter sets together, a set per lane
+    JSON execute_batch(const SimpleBackend& backend, QuantumTask& quantum_task) override;
+    JSON execute_gradient(const SimpleBackend& backend, const QuantumTask& quantum_task) override;
 
 };
 
@@ -12,8 +12,8 @@ public:
     MaestroComputationAdapter(const QuantumTask& quantum_task) :
         quantum_tasks{quantum_task}
     { }
-    MaestroComputationAdapter(const std::vector<QuantumTask>& quantum_tasks) :
-        quantum_tasks{quantum_tasks}
+    MaestroComputationAdapter(std::vector<QuantumTask> quantum_tasks) :
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
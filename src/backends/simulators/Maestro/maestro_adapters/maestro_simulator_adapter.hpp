@@ -16,7 +16,7 @@ class MaestroSimulatorAdapter
 {
 public:
     MaestroSimulatorAdapter();
-    MaestroSimulatorAdapter(MaestroComputationAdapter& qc);
+    MaestroSimulatorAdapter(MaestroComputationAdapter qc);
 
     JSON simulate(const Backend* backend);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
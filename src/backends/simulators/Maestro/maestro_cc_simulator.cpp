@@ -16,13 +16,12 @@ MaestroCCSimulator::MaestroCCSimulator() :
 // Distributed MaestroSimulator
 JSON MaestroCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
 
     MaestroComputationAdapter maestro_ca(quantum_task);
-    MaestroSimulatorAdapter maestro_sa(maestro_ca);
+    MaestroSimulatorAdapter maestro_sa(std::move(maestro_ca));
     if (quantum_task.is_dynamic) {
-        JSON result = maestro_sa.simulate(&classical_channel);
+        JSON result = maestro_sa.simulate(channel);
         return {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
@@ -3,6 +3,7 @@
 #include "quantum_task.hpp"
 #include "backends/qc_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
+#include "backends/simulators/executor_rounds.hpp"
 #include "classical_channel/classical_channel.hpp"
 
 #include "utils/json.hpp"
@@ -23,6 +24,7 @@ public:
 private:
     std::string executor_id;
     comm::ClassicalChannel classical_channel;
+    ExecutorRounds rounds;
 };
 
 } // End namespace sim
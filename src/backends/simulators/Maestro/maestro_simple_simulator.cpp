@@ -11,14 +11,17 @@ MaestroSimpleSimulator::~MaestroSimpleSimulator() = default;
 JSON MaestroSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task)
 {
     MaestroComputationAdapter maestro_ca(quantum_task);
-    MaestroSimulatorAdapter maestro_sa(maestro_ca);
+    MaestroSimulatorAdapter maestro_sa(std::move(maestro_ca));
 
     if (quantum_task.is_dynamic) {
         JSON result = maestro_sa.simulate();
-        return {
+        JSON simple_result = {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
         };
+        if (result.contains("convergence"))
+            simple_result["convergence"] = result.at("convergence");
+        return simple_result;
     } else {
         return maestro_sa.simulate(&backend);
     }
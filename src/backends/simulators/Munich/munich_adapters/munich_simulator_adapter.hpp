@@ -3,12 +3,30 @@
 #include "quantum_computation_adapter.hpp"
 #include "classical_channel/classical_channel.hpp"
 #include "backends/backend.hpp"
+#include "backends/simulators/meas_counter.hpp"
 
 #include "utils/json.hpp"
 
 namespace cunqa {
 namespace sim {
 
+// Noise of the stochastic simulator of MQT, read once from the "noise_model" of the backend
+struct MunichNoiseModel {
+    double noise_prob;
+    double noise_prob_t1;
+    double noise_prob_multi;
+    double step_fidelity;
+    std::size_t approx_steps;
+
+    friend void from_json(const JSON& j, MunichNoiseModel& obj)
+    {
+        j.at("noise_prob").get_to(obj.noise_prob);
+        j.at("noise_prob_t1").get_to(obj.noise_prob_t1);
+        j.at("noise_prob_multi").get_to(obj.noise_prob_multi);
+        j.at("step_fidelity").get_to(obj.step_fidelity);
+        j.at("approx_steps").get_to(obj.approx_steps);
+    }
+};
 
 class MunichSimulatorAdapter : public CircuitSimulator
 {
@@ -20,7 +38,8 @@ public:
         CircuitSimulator(std::unique_ptr<QuantumComputationAdapter>(std::move(qc_)))
     {}
 
-    inline void initializeSimulationAdapter(std::size_t nQubits) { initializeSimulation(nQubits); }
+    // The root edge of the previous shot is released, so its nodes can be collected
+    inline void initializeSimulationAdapter(std::size_t nQubits) { dd->decRef(rootEdge); initializeSimulation(nQubits); }
     inline void applyOperationToStateAdapter(std::unique_ptr<qc::Operation>&& op) { applyOperationToState(op); }
     inline void applyresetadapter(NonUnitaryOperation& op) { reset(&op); }
     inline char measureAdapter(dd::Qubit i) { return measure(i); }
@@ -30,18 +49,38 @@ public:
         reset(new qc::NonUnitaryOperation(target_qubits));
     }
 
-    JSON simulate(const Backend* backend);
+    JSON simulate(const Backend* backend, const MunichNoiseModel* noise_model = nullptr);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
-private:
-
-    std::unordered_map<std::string, std::string> execute_shot_(
-        std::vector<StructuredQuantumTask>& st_qtasks, 
-        comm::ClassicalChannel* classical_channel,
-        const bool allows_qc,
-        const size_t& n_comm_qubits
-    );
-    
+
+    // Loads the circuits of the next request, keeping the decision diagram package of the previous
+    // ones so its unique and compute tables stay warm
+    void load(std::unique_ptr<QuantumComputationAdapter>&& qc_);
+
+    // Garbage collection between requests, driven by the "dd_garbage_collection" policy of the
+    // simulator_config of the backend ("auto" or "always"). Returns false when the process outgrew
+    // its "dd_memory_limit", in MiB, and the package should be dropped
+    bool collect_garbage(const JSON& config);
+
+    static constexpr std::size_t DEFAULT_DD_MEMORY_LIMIT = 4096;
+
 };
 
+// Adapter that a simulator keeps along its requests. It is built on the first one, loaded with
+// the circuits of each, and dropped when collect_garbage says so
+inline MunichSimulatorAdapter& reuse_adapter(std::unique_ptr<MunichSimulatorAdapter>& munich_sa, std::unique_ptr<QuantumComputationAdapter>&& p_qca)
+{
+    if (munich_sa)
+        munich_sa->load(std::move(p_qca));
+    else
+        munich_sa = std::make_unique<MunichSimulatorAdapter>(std::move(p_qca));
+    return *munich_sa;
+}
+
+inline void release_adapter(std::unique_ptr<MunichSimulatorAdapter>& munich_sa, const JSON& config)
+{
+    if (!munich_sa->collect_garbage(config))
+        munich_sa.reset();
+}
+
 } // End of sim namespace
 } // End of cunqa namespace
\ No newline at end of file
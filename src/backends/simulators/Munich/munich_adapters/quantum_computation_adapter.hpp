@@ -25,13 +25,9 @@ public:
     { 
         n_qubits = quantum_task.config.at("num_qubits").get<size_t>();
     }
-    QuantumComputationAdapter(const std::vector<QuantumTask>& quantum_tasks) : 
-        QuantumComputation(get_num_qubits_(quantum_tasks), get_num_clbits_(quantum_tasks)),
-        quantum_tasks{quantum_tasks}
-    { 
-        n_qubits = get_num_qubits_(quantum_tasks);
-        n_comm_qubits = get_num_comm_qubits_(quantum_tasks);
-    }
+    QuantumComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        QuantumComputationAdapter(std::move(quantum_tasks), n_communication_qubits(quantum_tasks))
+    { }
 
     std::vector<QuantumTask> quantum_tasks;
     size_t n_qubits;
@@ -39,24 +35,22 @@ public:
 
 private:
 
+    // The size of the communication pool comes from a dry run of the tasks, done only once
+    QuantumComputationAdapter(std::vector<QuantumTask>&& quantum_tasks, const std::size_t pool_qubits) :
+        QuantumComputation(get_num_qubits_(quantum_tasks) + pool_qubits, get_num_clbits_(quantum_tasks)),
+        quantum_tasks{std::move(quantum_tasks)},
+        n_qubits{get_num_qubits_(this->quantum_tasks) + pool_qubits},
+        n_comm_qubits{pool_qubits}
+    { }
+
     std::size_t get_num_qubits_(const std::vector<QuantumTask>& quantum_tasks) 
     {
-        size_t tmp_n_qubits;
+        size_t tmp_n_qubits = 0;
         for (auto& quantum_task : quantum_tasks) {
             tmp_n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
         }
 
-        if (quantum_tasks[0].config.contains("n_communication_qubits")) {
-            size_t n_comm_qubits = quantum_tasks[0].config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-            tmp_n_qubits += n_comm_qubits;
-        } else {
-            tmp_n_qubits += 2;
-        }
-
-        return tmp_n_qubits; 
+        return tmp_n_qubits;
     }
 
     std::size_t get_num_clbits_(const std::vector<QuantumTask>& quantum_tasks) 
@@ -68,19 +62,6 @@ private:
         return num_clbits;
     }
 
-    std::size_t get_num_comm_qubits_(const std::vector<QuantumTask>& quantum_tasks) 
-    {
-        if (quantum_tasks[0].config.contains("n_communication_qubits")) {
-            size_t n_comm_qubits = quantum_tasks[0].config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-            return n_comm_qubits;
-        } else {
-            return 2;
-        }
-    }
-
 };
 
 
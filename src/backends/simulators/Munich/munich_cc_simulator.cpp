@@ -3,6 +3,7 @@
 #include "munich_cc_simulator.hpp"
 #include "munich_adapters/munich_simulator_adapter.hpp"
 #include "munich_adapters/quantum_computation_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 #include "utils/constants.hpp"
 
@@ -18,22 +19,30 @@ MunichCCSimulator::MunichCCSimulator() :
     classical_channel.publish();
 };
 
+MunichCCSimulator::~MunichCCSimulator() = default;
+
 JSON MunichCCSimulator::execute([[maybe_unused]] const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
-    
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
+
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, channel);
+
     auto p_qca = std::make_unique<QuantumComputationAdapter>(quantum_task);
-    MunichSimulatorAdapter csa(std::move(p_qca));
+    MunichSimulatorAdapter& csa = reuse_adapter(munich_sa_, std::move(p_qca));
+
+    JSON result;
     if (quantum_task.is_dynamic) {
-        JSON result = csa.simulate(&classical_channel);
-        return {
-            {"counts", result.at("id_counts").at(quantum_task.id)},
-            {"time_taken", result.at("time_taken")}
+        JSON dynamic_result = csa.simulate(channel);
+        result = {
+            {"counts", dynamic_result.at("id_counts").at(quantum_task.id)},
+            {"time_taken", dynamic_result.at("time_taken")}
         };
     } else {
-        return csa.simulate(&backend);
+        result = csa.simulate(&backend);
     }
+    release_adapter(munich_sa_, backend.config.at("simulator_config"));
+    return result;
 }
 
 } // End namespace sim
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <chrono>
+#include <memory>
 
 #include "quantum_task.hpp"
 #include "backends/cc_backend.hpp"
@@ -12,16 +13,19 @@
 namespace cunqa {
 namespace sim {
 
+class MunichSimulatorAdapter;
+
 class MunichCCSimulator final : public SimulatorStrategy<CCBackend> {
 public:
     MunichCCSimulator();
-    ~MunichCCSimulator() = default;
+    ~MunichCCSimulator();
 
     inline std::string get_name() const override {return "Munich";}
     JSON execute([[maybe_unused]] const CCBackend& backend, const QuantumTask& circuit) override;
 
 private:
     comm::ClassicalChannel classical_channel;
+    std::unique_ptr<MunichSimulatorAdapter> munich_sa_; // Kept along the requests, with its decision diagram package
 };
 
 } // End namespace sim
@@ -1,21 +1,24 @@
 #pragma once
 
-#include <string>
-#include "classical_channel/classical_channel.hpp"
+#include <memory>
+#include <vector>
+#include "backends/simulators/qc_executor.hpp"
 
 namespace cunqa {
 namespace sim {
 
-class MunichExecutor {
+class MunichSimulatorAdapter;
+
+class MunichExecutor : public QCExecutor {
 public:
     MunichExecutor(const std::size_t& n_qpus);
-    ~MunichExecutor() = default;
+    ~MunichExecutor();
+
+protected:
+    JSON simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) override;
 
-    void run();
 private:
-    comm::ClassicalChannel classical_channel;
-    std::vector<std::string> qpu_ids;
-    std::unordered_map<std::string, std::string> qpu_quantumtask_map;
+    std::vector<std::unique_ptr<MunichSimulatorAdapter>> munich_sas_; // By pipeline worker, kept along the requests with their decision diagram packages
 };
 
 } // End of sim namespace
@@ -1,6 +1,7 @@
 #include "munich_simple_simulator.hpp"
 #include "munich_adapters/munich_simulator_adapter.hpp"
 #include "munich_adapters/quantum_computation_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 #include <chrono>
 
@@ -10,22 +11,48 @@
 namespace cunqa {
 namespace sim {
 
+MunichSimpleSimulator::MunichSimpleSimulator() = default;
+MunichSimpleSimulator::~MunichSimpleSimulator() = default;
+
+void MunichSimpleSimulator::configure(const SimpleBackend& backend)
+{
+    const auto& noise_model = backend.simple_config.noise_model;
+    if (!noise_model.is_null() && !noise_model.empty())
+        noise_model_ = std::make_unique<MunichNoiseModel>(noise_model.get<MunichNoiseModel>());
+}
+
 JSON MunichSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task)
 {
+    // The tableau has no noise, so noisy QPUs keep the simulator of their noise model
+    if (!noise_model_ && runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task);
+
     auto p_qca = std::make_unique<QuantumComputationAdapter>(quantum_task);
-    MunichSimulatorAdapter csa(std::move(p_qca));
+    MunichSimulatorAdapter& csa = reuse_adapter(munich_sa_, std::move(p_qca));
 
+    JSON result;
     if (quantum_task.is_dynamic) {
-        JSON result = csa.simulate();
-        return {
-            {"counts", result.at("id_counts").at(quantum_task.id)},
-            {"time_taken", result.at("time_taken")}
+        JSON dynamic_result = csa.simulate();
+        result = {
+            {"counts", dynamic_result.at("id_counts").at(quantum_task.id)},
+            {"time_taken", dynamic_result.at("time_taken")}
         };
+        if (dynamic_result.contains("convergence"))
+            result["convergence"] = dynamic_result.at("convergence");
     } else {
-        return csa.simulate(&backend);
+        result = csa.simulate(&backend, noise_model_.get());
     }
+    release_adapter(munich_sa_, backend.config.at("simulator_config"));
+    return result;
 } 
 
+void MunichSimpleSimulator::execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer)
+{
+    if (!noise_model_ && runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, writer);
+    writer.write(execute(backend, quantum_task));
+}
+
 } // End of sim namespace
 } // End of cunqa namespace
 
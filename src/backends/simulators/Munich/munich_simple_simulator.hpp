@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "quantum_task.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
@@ -11,13 +13,22 @@
 namespace cunqa {
 namespace sim {
 
+class MunichSimulatorAdapter;
+struct MunichNoiseModel;
+
 class MunichSimpleSimulator final : public SimulatorStrategy<SimpleBackend> {
 public:
-    MunichSimpleSimulator() = default;
-    ~MunichSimpleSimulator() = default;
+    MunichSimpleSimulator();
+    ~MunichSimpleSimulator();
 
     inline std::string get_name() const override {return "Munich";}
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    void execute_into(const SimpleBackend& backend, const QuantumTask& circuit, ResultWriter& writer) override;
+    void configure(const SimpleBackend& backend) override;
+
+private:
+    std::unique_ptr<MunichSimulatorAdapter> munich_sa_; // Kept along the requests, with its decision diagram package
+    std::unique_ptr<MunichNoiseModel> noise_model_;    // Read once from the backend, if it is noisy
 };
 
 } // End of sim namespace
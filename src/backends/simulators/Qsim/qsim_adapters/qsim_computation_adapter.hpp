@@ -12,8 +12,8 @@ public:
     QsimComputationAdapter(const QuantumTask quantum_task) : 
         quantum_tasks{quantum_task}
     { }
-    QsimComputationAdapter(const std::vector<QuantumTask> quantum_tasks) : 
-        quantum_tasks{quantum_tasks}
+    QsimComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "qsim_computation_adapter.hpp"
+#include "classical_channel/classical_channel.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Vector instruction sets of the qsim simulators. The SIMD ones only come in single precision, so
+// double precision always runs on the basic simulator
+enum class QsimSimd { BASIC, SSE, AVX2, AVX512 };
+
+// Widest instruction set of the CPU, detected on the first call
+QsimSimd detect_qsim_simd();
+
+// qsim simulator of each instruction set and precision, given where it is instantiated
+template <QsimSimd simd, typename fp_type>
+struct QsimSimulatorOf;
+
+// Simulation on one qsim simulator. Each instantiation lives in a translation unit of its own,
+// built with the flags of its instruction set, so the rest of the library runs on any CPU
+template <QsimSimd simd, typename fp_type>
+class QsimSimdAdapter
+{
+public:
+    static JSON simulate(const QsimComputationAdapter& qc);
+    static JSON simulate(const QsimComputationAdapter& qc, comm::ClassicalChannel* classical_channel, const bool allows_qc);
+};
+
+extern template class QsimSimdAdapter<QsimSimd::BASIC, float>;
+extern template class QsimSimdAdapter<QsimSimd::BASIC, double>;
+#ifdef QSIM_SIMD
+extern template class QsimSimdAdapter<QsimSimd::SSE, float>;
+extern template class QsimSimdAdapter<QsimSimd::AVX2, float>;
+extern template class QsimSimdAdapter<QsimSimd::AVX512, float>;
+#endif
+
+} // End of sim namespace
+} // End of cunqa namespace
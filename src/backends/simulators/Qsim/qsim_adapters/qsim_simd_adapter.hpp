@@ -0,0 +1,605 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <stack>
+#include <queue>
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+
+#include "qsim_simd.hpp"
+
+#include "seqfor.h"
+#include "parfor.h"
+#include <gates_qsim.h>
+#include <gate_appl.h>
+#include <fuser_mqubit.h>
+#include <io.h>
+
+#include "utils/constants.hpp"
+
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/dynamic_engine.hpp"
+#include "backends/simulators/matrix_cache.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/huge_pages.hpp"
+
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+template <typename fp_type>
+qsim::Matrix<fp_type> cunqamatrix_to_qsimmatrix(const CUNQAMatrix& cunqa_matrix)
+{
+    size_t n = cunqa_matrix.size();
+    if (n == 0) return {};
+
+    qsim::Matrix<fp_type> qsim_mat;
+    qsim_mat.resize(2 * n * n);
+
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            const auto& complex_val = cunqa_matrix[i][j];
+            
+            size_t base_idx = 2 * (n * i + j);
+
+            if (complex_val.size() >= 2) {
+                qsim_mat[base_idx]     = static_cast<fp_type>(complex_val[0]); // Real
+                qsim_mat[base_idx + 1] = static_cast<fp_type>(complex_val[1]); // Imag
+            } else if (complex_val.size() == 1) {
+                qsim_mat[base_idx]     = static_cast<fp_type>(complex_val[0]);
+                qsim_mat[base_idx + 1] = 0;
+            }
+        }
+    }
+
+    return qsim_mat;
+}
+
+
+// Defaults of the gate fusion, named after the ones of AER
+constexpr unsigned FUSION_MAX_QUBIT = 4;
+constexpr unsigned FUSION_THRESHOLD = 14;
+
+// Qubits of the fused gates: 0 when the config disables the fusion or the circuit is too small
+// for the fewer sweeps over the state to pay the fusion off
+unsigned fused_gates_width(const JSON& config, const unsigned n_qubits)
+{
+    if (!config.value("fusion_enable", true) || n_qubits < config.value("fusion_threshold", FUSION_THRESHOLD))
+        return 0;
+    return config.value("fusion_max_qubit", FUSION_MAX_QUBIT);
+}
+
+// State of qsim on huge pages if the QPU asks for them, with its amplitudes in the buffer, which has
+// to outlive it. Otherwise qsim allocates it
+template <typename Simulator>
+typename Simulator::State create_state(const typename Simulator::StateSpace& state_space, const unsigned n_qubits, sim::StateBuffer& buffer)
+{
+    using StateSpace = typename Simulator::StateSpace;
+    using fp_type = typename Simulator::fp_type;
+    if (sim::huge_pages() == sim::HugePages::none)
+        return state_space.Create(n_qubits);
+    buffer = sim::StateBuffer(sizeof(fp_type) * StateSpace::MinSize(n_qubits));
+    return StateSpace::Create(buffer.data<fp_type>(), n_qubits);
+}
+
+// Gates waiting to be applied to the state, fused into matrices of up to max_fused_size qubits.
+// It has to be flushed before anything reads the state, so no fused gate crosses a measurement
+template <typename Simulator>
+class FusedGateBuffer
+{
+public:
+    using Gate = qsim::GateQSim<typename Simulator::fp_type>;
+    using Fuser = qsim::MultiQubitGateFuser<qsim::IO, Gate>;
+
+    FusedGateBuffer(const Simulator& simulator, typename Simulator::State& state, const unsigned n_qubits, const unsigned max_fused_size) :
+        simulator_{simulator}, state_{state}, n_qubits_{n_qubits}, max_fused_size_{max_fused_size}
+    { }
+
+    void apply(Gate&& gate)
+    {
+        // Without fusion gates go straight to the state, and so do global phases, which commute with everything
+        if (max_fused_size_ < 2 || gate.qubits.empty()) {
+            qsim::ApplyGate(simulator_, gate, state_);
+            return;
+        }
+        gate.time = gates_.size();
+        gates_.push_back(std::move(gate));
+    }
+
+    void flush()
+    {
+        if (gates_.empty())
+            return;
+
+        typename Fuser::Parameter param;
+        param.max_fused_size = max_fused_size_;
+        for (const auto& fused_gate : Fuser::FuseGates(param, n_qubits_, gates_))
+            qsim::ApplyFusedGate(simulator_, fused_gate, state_);
+        gates_.clear();
+    }
+
+    inline void clear() { gates_.clear(); }
+
+private:
+    const Simulator& simulator_;
+    typename Simulator::State& state_;
+    unsigned n_qubits_;
+    unsigned max_fused_size_;
+    std::vector<Gate> gates_; // Kept between flushes, so its capacity is reused along the shots
+};
+
+// Unitary of a UNITARY or a CUNITARY, the latter controlled by its first qubit, in the layout of
+// qsim. Kept in double, as the shots copy it anyway into the gate, of either precision
+qsim::Matrix<double> qsim_unitary(const CUNQAInstruction& inst)
+{
+    const auto& cunqa_matrix = inst.matrix[0];
+    if (inst.type != constants::CUNITARY)
+        return cunqamatrix_to_qsimmatrix<double>(cunqa_matrix);
+
+    size_t dim = cunqa_matrix.size();
+    size_t ctrl_dim = 2 * dim;
+
+    // Build controlled-U as a CUNQAMatrix, reusing cunqamatrix_to_qsimmatrix
+    CUNQAMatrix ctrl_cunqa_matrix(ctrl_dim,
+        std::vector<std::vector<double>>(ctrl_dim, {0.0, 0.0}));
+
+    // Top-left block: Identity (control = |0>)
+    for (size_t i = 0; i < dim; i++) {
+        ctrl_cunqa_matrix[i][i] = {1.0, 0.0};
+    }
+
+    // Bottom-right block: U (control = |1>)
+    for (size_t i = 0; i < dim; i++) {
+        for (size_t j = 0; j < dim; j++) {
+            ctrl_cunqa_matrix[dim + i][dim + j] = cunqa_matrix[i][j];
+        }
+    }
+
+    return cunqamatrix_to_qsimmatrix<double>(ctrl_cunqa_matrix);
+}
+
+// Gates of the dynamic engine on a shot worker of qsim, through the buffer of fused gates, which
+// measurements flush
+template <typename Simulator>
+struct QsimBackend {
+    using fp_type = typename Simulator::fp_type;
+    using Gate = void (*)(QsimBackend&, const CUNQAInstruction&, std::span<const int>);
+
+    typename Simulator::StateSpace& state_space;
+    typename Simulator::State& state;
+    FusedGateBuffer<Simulator>& gates;
+    sim::ShotRng rgen;
+    const sim::MatrixCache<qsim::Matrix<double>>& unitaries;
+
+    inline int measure(const int qubit)
+    {
+        gates.flush();
+        return state_space.Measure({static_cast<unsigned>(qubit)}, rgen, state).bitstring[0];
+    }
+    inline void reset(const int qubit)
+    {
+        if (measure(qubit))
+            x(qubit);
+    }
+    inline void x(const int qubit) { gates.apply(qsim::GateX<fp_type>::Create(0, qubit)); }
+    inline void z(const int qubit) { gates.apply(qsim::GateZ<fp_type>::Create(0, qubit)); }
+    inline void h(const int qubit) { gates.apply(qsim::GateHd<fp_type>::Create(0, qubit)); }
+    inline void cx(const int control, const int target) { gates.apply(qsim::GateCNot<fp_type>::Create(0, control, target)); }
+    inline void swap(const int a, const int b) { gates.apply(qsim::GateSwap<fp_type>::Create(0, a, b)); }
+
+    static Gate gate(const CUNQAInstruction& inst)
+    {
+        switch (inst.type)
+        {
+        case constants::ID:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateId1<fp_type>::Create(0, qubits[0])); };
+        case constants::X:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateX<fp_type>::Create(0, qubits[0])); };
+        case constants::Y:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateY<fp_type>::Create(0, qubits[0])); };
+        case constants::Z:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateZ<fp_type>::Create(0, qubits[0])); };
+        case constants::H:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateHd<fp_type>::Create(0, qubits[0])); };
+        case constants::S:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateS<fp_type>::Create(0, qubits[0])); };
+        case constants::T:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateT<fp_type>::Create(0, qubits[0])); };
+        case constants::SX:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateX2<fp_type>::Create(0, qubits[0])); };
+        case constants::SY:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateY2<fp_type>::Create(0, qubits[0])); };
+        case constants::HZ2:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateHZ2<fp_type>::Create(0, qubits[0])); };
+        case constants::RX:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateRX<fp_type>::Create(0, qubits[0], inst.params[0]));
+            };
+        case constants::RY:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateRY<fp_type>::Create(0, qubits[0], inst.params[0]));
+            };
+        case constants::RZ:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateRZ<fp_type>::Create(0, qubits[0], inst.params[0]));
+            };
+        case constants::RXY:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateRXY<fp_type>::Create(0, qubits[0], inst.params[0], inst.params[1]));
+            };
+        case constants::ID2:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateId2<fp_type>::Create(0, qubits[0], qubits[1])); };
+        case constants::CX:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateCNot<fp_type>::Create(0, qubits[0], qubits[1])); };
+        case constants::CZ:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateCZ<fp_type>::Create(0, qubits[0], qubits[1])); };
+        case constants::SWAP:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateSwap<fp_type>::Create(0, qubits[0], qubits[1])); };
+        case constants::ISWAP:
+            return [](QsimBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.gates.apply(qsim::GateIS<fp_type>::Create(0, qubits[0], qubits[1])); };
+        case constants::CP:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateCP<fp_type>::Create(0, qubits[0], qubits[1], inst.params[0]));
+            };
+        case constants::FS:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                b.gates.apply(qsim::GateFS<fp_type>::Create(0, qubits[0], qubits[1], inst.params[0], inst.params[1]));
+            };
+        case constants::GLOBALP:
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int>) { b.gates.apply(qsim::GateGPh<fp_type>::Create(0, inst.params[0])); };
+        case constants::UNITARY:
+        case constants::CUNITARY:
+            // The control of a CUNITARY is its first qubit, which GateMatrix2 takes as the first one
+            // of the matrix, as it does for a UNITARY
+            return [](QsimBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                const auto& cached_matrix = b.unitaries.at(inst);
+                qsim::Matrix<fp_type> qsim_matrix(cached_matrix.begin(), cached_matrix.end());
+                if (qubits.size() > 1)
+                    b.gates.apply(qsim::GateMatrix2<fp_type>::Create(0, qubits[0], qubits[1], std::move(qsim_matrix)));
+                else
+                    b.gates.apply(qsim::GateMatrix1<fp_type>::Create(0, qubits[0], std::move(qsim_matrix)));
+            };
+        default:
+            return nullptr;
+        }
+    }
+};
+
+template <typename Simulator>
+void update_qsim_state(const JSON& circuit_json, FusedGateBuffer<Simulator>& gates)
+{
+    using fp_type = typename Simulator::fp_type;
+
+    for (const auto& instruction : circuit_json) {
+        auto inst_type = INSTRUCTIONS_MAP.at(instruction.at("name").get<std::string>());
+        std::vector<unsigned> qubits = instruction.at("qubits").get<std::vector<unsigned>>();
+
+        switch (inst_type)
+        {
+        case constants::MEASURE:
+            LOGGER_DEBUG("Measure in Qsim usual simulation performed by sampling. Skiping.");
+            break;
+        case constants::ID:
+            gates.apply(qsim::GateId1<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::X:
+            gates.apply(qsim::GateX<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::Y:
+            gates.apply(qsim::GateY<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::Z:
+            gates.apply(qsim::GateZ<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::H:
+            gates.apply(qsim::GateHd<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::S:
+            gates.apply(qsim::GateS<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::T:
+            gates.apply(qsim::GateT<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::SX:
+            gates.apply(qsim::GateX2<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::SY:
+            gates.apply(qsim::GateY2<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::HZ2:
+            gates.apply(qsim::GateHZ2<fp_type>::Create(0, qubits[0]));
+            break;
+        case constants::RX: 
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateRX<fp_type>::Create(0, qubits[0], params[0]));
+            break;
+        }
+        case constants::RY: 
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateRY<fp_type>::Create(0, qubits[0], params[0]));
+            break;
+        }
+        case constants::RZ: 
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateRZ<fp_type>::Create(0, qubits[0], params[0]));
+            break;
+        }
+        case constants::ID2:
+        gates.apply(qsim::GateId2<fp_type>::Create(0, qubits[0], qubits[1]));
+        break;
+        case constants::CX:
+        gates.apply(qsim::GateCNot<fp_type>::Create(0, qubits[0], qubits[1]));
+        break;
+        case constants::CZ:
+        gates.apply(qsim::GateCZ<fp_type>::Create(0, qubits[0], qubits[1]));
+        break;
+        case constants::SWAP:
+        gates.apply(qsim::GateSwap<fp_type>::Create(0, qubits[0], qubits[1]));
+        break;
+        case constants::ISWAP:
+        {
+            gates.apply(qsim::GateIS<fp_type>::Create(0, qubits[0], qubits[1]));
+            break;
+        }
+        case constants::CP:
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateCP<fp_type>::Create(0, qubits[0], qubits[1], params[0]));
+            break;
+        }
+        case constants::RXY: 
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateRXY<fp_type>::Create(0, qubits[0], params[0], params[1]));
+            break;
+        }
+        case constants::FS:
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateFS<fp_type>::Create(0, qubits[0], qubits[1], params[0], params[1]));
+            break;
+        }
+        case constants::GLOBALP:
+        {
+            auto params = instruction.at("params").get<std::vector<fp_type>>();
+            gates.apply(qsim::GateGPh<fp_type>::Create(0, params[0]));
+            break;
+        }
+        case constants::UNITARY:
+        {
+            auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
+            qsim::Matrix<fp_type> qsim_matrix = cunqamatrix_to_qsimmatrix<fp_type>(cunqa_matrix);
+
+            if (qubits.size() > 1) {
+                gates.apply(qsim::GateMatrix2<fp_type>::Create(0, qubits[0], qubits[1], std::move(qsim_matrix)));
+            } else {
+                gates.apply(qsim::GateMatrix1<fp_type>::Create(0, qubits[0], std::move(qsim_matrix)));
+            }
+            break;
+        }
+        case constants::CUNITARY:
+        {
+            auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
+            size_t dim = cunqa_matrix.size();
+            size_t ctrl_dim = 2 * dim;
+
+            CUNQAMatrix ctrl_cunqa_matrix(ctrl_dim,
+                std::vector<std::vector<double>>(ctrl_dim, {0.0, 0.0}));
+
+            for (size_t i = 0; i < dim; i++) {
+                ctrl_cunqa_matrix[i][i] = {1.0, 0.0};
+            }
+
+            for (size_t i = 0; i < dim; i++) {
+                for (size_t j = 0; j < dim; j++) {
+                    ctrl_cunqa_matrix[dim + i][dim + j] = cunqa_matrix[i][j]; 
+                }
+            }
+
+            qsim::Matrix<fp_type> ctrl_qsim_matrix = cunqamatrix_to_qsimmatrix<fp_type>(ctrl_cunqa_matrix);
+
+            gates.apply(qsim::GateMatrix2<fp_type>::Create(0, qubits[0], qubits[1], std::move(ctrl_qsim_matrix)));
+            break;
+        }
+        default:
+            std::cerr << "Instruction not suported!\nInstruction that failed: " << instruction.at("name") << "\n";
+        };
+    }
+
+}
+
+JSON convert_qsim_result(const std::vector<uint64_t>& sample, const int n_qubits) {
+    std::unordered_map<uint64_t, int> counts;
+    for (uint64_t v : sample)
+        counts[v]++;
+
+    JSON result_json;
+    for (const auto& [value, count] : counts) {
+        std::string bitstring(n_qubits, '0');
+        for (int i = 0; i < n_qubits; ++i)
+            bitstring[n_qubits - 1 - i] = ((value >> i) & 1) ? '1' : '0';
+
+        result_json[bitstring] = count;
+    }
+    return result_json;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+template <QsimSimd simd, typename fp_type>
+JSON QsimSimdAdapter<simd, fp_type>::simulate(const QsimComputationAdapter& qc)
+{
+    using Simulator = typename QsimSimulatorOf<simd, fp_type>::type;
+
+    LOGGER_DEBUG("Qsim usual simulation");
+    try
+    { 
+        auto quantum_task = qc.quantum_tasks[0];
+        auto n_qubits = quantum_task.config.at("num_qubits").get<unsigned>();
+        auto shots = quantum_task.config.at("shots").get<uint64_t>();
+        unsigned seed = 0;
+        if (quantum_task.config.contains("seed")) {
+            seed = quantum_task.config.at("seed").get<unsigned>();
+        }
+        // Those that the vQPU gives to this task, as many as its state keeps busy
+        const unsigned num_threads = sim::available_threads();
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        typename Simulator::StateSpace state_space(num_threads);
+        sim::StateBuffer state_buffer;
+        typename Simulator::State state = create_state<Simulator>(state_space, n_qubits, state_buffer);
+        state_space.SetStateZero(state);
+        Simulator simulator(num_threads);
+        FusedGateBuffer<Simulator> gates(simulator, state, n_qubits, fused_gates_width(quantum_task.config, n_qubits));
+        
+        JSON circuit_json = quantum_task.circuit;
+        update_qsim_state(circuit_json, gates);
+        gates.flush();
+        std::vector<uint64_t> results = state_space.Sample(state, shots, seed);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<float> duration = end - start;
+        float time_taken = duration.count();
+
+        JSON counts_json = convert_qsim_result(results, n_qubits);
+        
+        JSON result_json = {
+            {"counts", counts_json},
+            {"time_taken", time_taken}};
+
+        return result_json;
+    } 
+    catch (const std::exception &e)
+    {
+        // TODO: specify the circuit format in the docs.
+        LOGGER_ERROR("Error executing the circuit in the Qsim simulator.");
+        return {{"ERROR", std::string(e.what()) + ". Try checking the format of the circuit sent."}};
+    }
+    return JSON();
+}
+
+template <QsimSimd simd, typename fp_type>
+JSON QsimSimdAdapter<simd, fp_type>::simulate(const QsimComputationAdapter& qc, comm::ClassicalChannel* classical_channel, const bool allows_qc)
+{
+    using Simulator = typename QsimSimulatorOf<simd, fp_type>::type;
+
+    LOGGER_DEBUG("Qsim dynamic simulation");
+
+    JSON config = qc.quantum_tasks[0].config;
+    auto shots = config.at("shots").get<int>();
+
+    std::vector<StructuredQuantumTask> st_qtasks;
+    size_t n_qubits = 0;
+    for (auto& quantum_task : qc.quantum_tasks) {
+        st_qtasks.push_back(from_quantum_task_to_structuredqtask(quantum_task));
+        n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
+    }
+    MeasCounter meas_counter(st_qtasks);
+
+    const size_t n_comm_qubits = n_communication_qubits(qc.quantum_tasks);
+    n_qubits += n_comm_qubits;
+
+    unsigned seed = 0;
+    if (config.contains("seed")) {
+        seed = config.at("seed").get<unsigned>();
+    }
+
+    const unsigned num_threads = sim::available_threads();
+
+
+    const unsigned fusion_width = fused_gates_width(config, n_qubits);
+    const DynamicEngine<QsimBackend<Simulator>> engine(st_qtasks, n_comm_qubits);
+    sim::MatrixCache<qsim::Matrix<double>> unitaries;
+    for (const auto& quantum_task : st_qtasks)
+        unitaries.add(quantum_task.instructions, {constants::UNITARY, constants::CUNITARY}, qsim_unitary);
+    std::size_t blocked_iterations = 0;
+    const sim::ShotConvergence convergence = sim::ShotConvergence::from_config(config, classical_channel != nullptr);
+    sim::ShotProgress progress;
+    auto start = std::chrono::high_resolution_clock::now();
+#ifdef OPENMP_IN_QC
+    // Quantum communications, or a single circuit small enough to split its shots among the threads
+    if (size(qc.quantum_tasks) > 1 || parallelize_shots(config, n_qubits, shots)) {
+        #pragma omp parallel
+        {
+            typename Simulator::StateSpace state_space(num_threads);
+            sim::StateBuffer state_buffer;
+            typename Simulator::State state = create_state<Simulator>(state_space, n_qubits, state_buffer);
+            Simulator simulator(num_threads);
+            FusedGateBuffer<Simulator> gates(simulator, state, n_qubits, fusion_width);
+            
+            QsimBackend<Simulator> backend{state_space, state, gates, ShotRng(seed, 0), unitaries};
+            auto shot = engine.shot();
+            convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+                state_space.SetStateZero(state);
+                backend.rgen = ShotRng(seed, i);
+                counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+                // Gates after the last measurement do not change the counts
+                gates.clear();
+            });
+
+            #pragma omp critical
+            blocked_iterations += shot.blocked_iterations;
+        }
+    } else { // As if OPENMP_IN_QC not enabled
+        typename Simulator::StateSpace state_space(num_threads);
+        sim::StateBuffer state_buffer;
+        typename Simulator::State state = create_state<Simulator>(state_space, n_qubits, state_buffer);
+        Simulator simulator(num_threads);
+        FusedGateBuffer<Simulator> gates(simulator, state, n_qubits, fusion_width);
+        QsimBackend<Simulator> backend{state_space, state, gates, ShotRng(seed, 0), unitaries};
+        auto shot = engine.shot();
+        convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+            state_space.SetStateZero(state);
+            backend.rgen = ShotRng(seed, i);
+            counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+            gates.clear();
+        });
+        blocked_iterations = shot.blocked_iterations;
+    }
+#else
+    typename Simulator::StateSpace state_space(num_threads);
+    sim::StateBuffer state_buffer;
+    typename Simulator::State state = create_state<Simulator>(state_space, n_qubits, state_buffer);
+    Simulator simulator(num_threads);
+    FusedGateBuffer<Simulator> gates(simulator, state, n_qubits, fusion_width);
+    QsimBackend<Simulator> backend{state_space, state, gates, ShotRng(seed, 0), unitaries};
+    auto shot = engine.shot();
+    convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+        state_space.SetStateZero(state);
+        backend.rgen = ShotRng(seed, i);
+        counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+        gates.clear();
+    });
+    blocked_iterations = shot.blocked_iterations;
+#endif
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<float> duration = end - start;
+    float time_taken = duration.count();
+
+    JSON result_json = {
+        {"id_counts", meas_counter},
+        {"time_taken", time_taken}};
+    if (n_comm_qubits != 0)
+        result_json["scheduler"] = {{"communication_qubits", n_comm_qubits}, {"blocked_iterations", blocked_iterations}};
+    if (convergence.enabled())
+        result_json["convergence"] = convergence.report(progress);
+    return result_json;
+}
+
+
+} // End of sim namespace
+} // End of cunqa namespace
\ No newline at end of file
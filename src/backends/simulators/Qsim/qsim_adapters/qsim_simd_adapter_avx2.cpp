@@ -0,0 +1,14 @@
+#include <simulator_avx.h>
+
+#include "qsim_simd_adapter.hpp"
+
+namespace cunqa {
+namespace sim {
+
+template <>
+struct QsimSimulatorOf<QsimSimd::AVX2, float> { using type = qsim::SimulatorAVX<qsim::ParallelFor>; };
+
+template class QsimSimdAdapter<QsimSimd::AVX2, float>;
+
+} // End of sim namespace
+} // End of cunqa namespace
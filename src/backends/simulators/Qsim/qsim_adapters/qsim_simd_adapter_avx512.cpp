@@ -0,0 +1,14 @@
+#include <simulator_avx512.h>
+
+#include "qsim_simd_adapter.hpp"
+
+namespace cunqa {
+namespace sim {
+
+template <>
+struct QsimSimulatorOf<QsimSimd::AVX512, float> { using type = qsim::SimulatorAVX512<qsim::ParallelFor>; };
+
+template class QsimSimdAdapter<QsimSimd::AVX512, float>;
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,15 @@
+#include <simulator_basic.h>
+
+#include "qsim_simd_adapter.hpp"
+
+namespace cunqa {
+namespace sim {
+
+template <typename fp_type>
+struct QsimSimulatorOf<QsimSimd::BASIC, fp_type> { using type = qsim::SimulatorBasic<qsim::ParallelFor, fp_type>; };
+
+template class QsimSimdAdapter<QsimSimd::BASIC, float>;
+template class QsimSimdAdapter<QsimSimd::BASIC, double>;
+
+} // End of sim namespace
+} // End of cunqa namespace
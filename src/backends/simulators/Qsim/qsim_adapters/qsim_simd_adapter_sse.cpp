@@ -0,0 +1,14 @@
+#include <simulator_sse.h>
+
+#include "qsim_simd_adapter.hpp"
+
+namespace cunqa {
+namespace sim {
+
+template <>
+struct QsimSimulatorOf<QsimSimd::SSE, float> { using type = qsim::SimulatorSSE<qsim::ParallelFor>; };
+
+template class QsimSimdAdapter<QsimSimd::SSE, float>;
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -15,7 +15,7 @@ class QsimSimulatorAdapter
 {
 public:
     QsimSimulatorAdapter() = default;
-    QsimSimulatorAdapter(QsimComputationAdapter& qc) : qc{qc} {}
+    QsimSimulatorAdapter(QsimComputationAdapter qc) : qc{std::move(qc)} {}
 
     JSON simulate(const Backend* backend);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
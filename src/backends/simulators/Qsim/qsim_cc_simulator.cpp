@@ -1,6 +1,7 @@
 #include "qsim_cc_simulator.hpp"
 #include "qsim_adapters/qsim_computation_adapter.hpp"
 #include "qsim_adapters/qsim_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 using namespace std::string_literals;
 
@@ -16,13 +17,15 @@ QsimCCSimulator::QsimCCSimulator() :
 // Distributed QsimSimulator
 JSON QsimCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
+
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, channel);
 
     QsimComputationAdapter qsim_ca(quantum_task);
-    QsimSimulatorAdapter qsim_sa(qsim_ca);
+    QsimSimulatorAdapter qsim_sa(std::move(qsim_ca));
     if (quantum_task.is_dynamic) {
-        JSON result = qsim_sa.simulate(&classical_channel);
+        JSON result = qsim_sa.simulate(channel);
         return {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
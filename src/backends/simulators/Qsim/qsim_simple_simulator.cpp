@@ -1,25 +1,39 @@
 #include "qsim_simple_simulator.hpp"
 #include "qsim_adapters/qsim_computation_adapter.hpp"
 #include "qsim_adapters/qsim_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 namespace cunqa {
 namespace sim {
 
 JSON QsimSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task) 
 {
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task);
+
     QsimComputationAdapter qsim_ca(quantum_task);
-    QsimSimulatorAdapter qsim_sa(qsim_ca);
+    QsimSimulatorAdapter qsim_sa(std::move(qsim_ca));
 
     if (quantum_task.is_dynamic) {
         JSON result = qsim_sa.simulate();
-        return {
+        JSON simple_result = {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
         };
+        if (result.contains("convergence"))
+            simple_result["convergence"] = result.at("convergence");
+        return simple_result;
     } else {
         return qsim_sa.simulate(&backend);
     }
 }
 
+void QsimSimpleSimulator::execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer)
+{
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, writer);
+    writer.write(execute(backend, quantum_task));
+}
+
 } // End namespace sim
 } // End namespace cunqa
\ No newline at end of file
@@ -18,6 +18,7 @@ public:
 
     inline std::string get_name() const override {return "Qsim";} 
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    void execute_into(const SimpleBackend& backend, const QuantumTask& circuit, ResultWriter& writer) override;
 };
 
 } // End of sim namespace
@@ -12,8 +12,8 @@ public:
     QuestComputationAdapter(const QuantumTask quantum_task) : 
         quantum_tasks{quantum_task}
     { }
-    QuestComputationAdapter(const std::vector<QuantumTask> quantum_tasks) : 
-        quantum_tasks{quantum_tasks}
+    QuestComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
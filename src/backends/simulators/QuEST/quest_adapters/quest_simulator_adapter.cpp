@@ -1,3 +1,4 @@
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <stack>
@@ -8,110 +9,30 @@
 #include <optional>
 #include <random>
 #include <stdexcept>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <algorithm>
 
 #include "quest_simulator_adapter.hpp"
 
 #include "quest.h"
 
 #include "utils/constants.hpp"
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/dynamic_engine.hpp"
+#include "backends/simulators/matrix_cache.hpp"
+#include "backends/simulators/diagonal_runs.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/huge_pages.hpp"
+
 #include "logger.hpp"
 
 namespace {
 using namespace cunqa;
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
-struct CommunicationQubitsPair {
-    int q0;
-    int q1;
-    bool idle = true;
-    std::string sendr_qpu; // QSEND and EXPOSE
-    std::string recvr_qpu; // QRECV and RCONTROL
-    std::string qcomm_protocol;
-    int label;
-};
-
-struct TaskState {
-    std::string id;
-    int local_n_clbits = 0;
-    std::vector<constants::CUNQAInstruction>::const_iterator it, end;
-    int zero_qubit = 0;
-    int zero_clbit = 0;
-    bool finished = false;
-    bool blocked_by_teledata = false;
-    bool blocked_by_telegate = false;
-    bool blocked_by_cc = false;
-    bool cat_entangled = false;
-    std::stack<int> telep_meas;
-};
-
-struct GlobalState {
-    int n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::queue<int>> qc_meas_td;
-    std::unordered_map<std::string, std::queue<int>> qc_meas_tg;
-    std::vector<CommunicationQubitsPair> communication_pairs;
-    std::unordered_map<LocalCCIDs, std::queue<int>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
-    cunqa::comm::ClassicalChannel* chan = nullptr;
-};
-
-
-std::vector<int> find_idle_communication_pairs(GlobalState& G, const size_t n_pairs)
-{
-    std::vector<int> indices_idle_pairs;
-    size_t count = 0;
-    for (int index = 0; index < G.communication_pairs.size() && count < n_pairs; index++) {
-        if (G.communication_pairs[index].idle) {
-            indices_idle_pairs.push_back(index);
-            count++;
-        } 
-    } 
-
-    if (count < n_pairs) 
-        return std::vector<int>();
-
-    for (const auto& index : indices_idle_pairs) {
-        G.communication_pairs[index].idle = false;
-    }
-
-    return indices_idle_pairs;
-}
-
-std::vector<int> find_my_communication_pairs(const GlobalState& G, const std::string& sendr, const std::string recvr, const std::string qcomm_protocol, size_t n_pairs = 0)
-{
-    std::vector<int> comm_pairs;
-    size_t count = 0;
-    if (n_pairs == 0) n_pairs = G.communication_pairs.size();
-    for (int index = 0; index < G.communication_pairs.size(); index++) {
-        if (count == n_pairs) return comm_pairs;
-        if (!G.communication_pairs[index].idle &&
-            G.communication_pairs[index].sendr_qpu == sendr && 
-            G.communication_pairs[index].recvr_qpu == recvr &&
-            G.communication_pairs[index].qcomm_protocol == qcomm_protocol) {
-                comm_pairs.push_back(index);
-                count++;
-        } 
-    } 
-
-    return comm_pairs;
-}
-
 std::vector<std::vector<qcomp>> cunqamatrix_to_questmatrix(const CUNQAMatrix& cunqa_matrix)
 {
     size_t n = cunqa_matrix.size();
@@ -130,1301 +51,527 @@ std::vector<std::vector<qcomp>> cunqamatrix_to_questmatrix(const CUNQAMatrix& cu
     return quest_mat;
 }
 
-std::unordered_map<std::string, std::string> execute_shot_(
-    Qureg& qubits_state,
-    std::vector<StructuredQuantumTask>& st_qtasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
-    const bool allows_qc, 
-    const size_t& n_comm_qubits
-)
+// CompMatr of a UNITARY or the target block of a CUNITARY, created once for all the shots and
+// destroyed along with its cache
+struct CompMatrDeleter {
+    void operator()(CompMatr* quest_matrix) const
+    {
+        destroyCompMatr(*quest_matrix);
+        delete quest_matrix;
+    }
+};
+using QuestMatrix = std::unique_ptr<CompMatr, CompMatrDeleter>;
+
+QuestMatrix quest_unitary(const CUNQAInstruction& inst)
 {
-    std::unordered_map<std::string, TaskState> Ts;
-    GlobalState G;
+    const int n_targets = inst.type == constants::CUNITARY ? inst.qubits.size() - 1 : inst.qubits.size();
+    QuestMatrix quest_matrix(new CompMatr(createCompMatr(n_targets)));
+    // Using this constructor setCompMatr(CompMatr out, std::vector<std::vector<qcomp>> in);
+    setCompMatr(*quest_matrix, cunqamatrix_to_questmatrix(inst.matrix[0]));
+    return quest_matrix;
+}
 
-    for (const auto &quantum_task : st_qtasks) {
-        TaskState T;
-        T.id = quantum_task.id;
-        T.local_n_clbits = quantum_task.n_clbits;
-        T.zero_qubit = G.n_qubits;
-        T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.instructions.begin();
-        T.end = quantum_task.instructions.end();
-        T.blocked_by_teledata = false;
-        T.blocked_by_telegate = false;
-        T.blocked_by_cc = false;
-        T.finished = false;
-        Ts[quantum_task.id] = T;
-        
-        G.n_qubits += quantum_task.n_qubits;
-        G.n_clbits += quantum_task.n_clbits;
-    }
-    
-    // Here we add the communication qubits
-    if (n_comm_qubits != 0) {
-        G.n_qubits += n_comm_qubits;
-        for (int i = 0; i < n_comm_qubits; i+=2) {
-            CommunicationQubitsPair cqp = {
-                .q0 = G.n_qubits - n_comm_qubits + i,
-                .q1 = G.n_qubits - n_comm_qubits + i + 1
-            };
-            G.communication_pairs.push_back(cqp);
-        }
+// DiagMatr of a DIAGONAL, as those that the runs of diagonal gates are merged into, created and
+// destroyed as the CompMatr of the unitaries
+struct DiagMatrDeleter {
+    void operator()(DiagMatr* quest_diagonal) const
+    {
+        destroyDiagMatr(*quest_diagonal);
+        delete quest_diagonal;
     }
-    
-    auto generate_entanglement_ = [&](const size_t n_pairs) {
-        std::vector<int> indices = find_idle_communication_pairs(G, n_pairs);
+};
+using QuestDiagonal = std::unique_ptr<DiagMatr, DiagMatrDeleter>;
 
-        if (!indices.empty()) {
-            for (auto& index : indices) {
-                int meas1 = applyQubitMeasurement(qubits_state, G.communication_pairs[index].q1);
-                if (meas1) {
-                    applyPauliX(qubits_state, G.communication_pairs[index].q1);
-                } 
-                int meas2 = applyQubitMeasurement(qubits_state, G.communication_pairs[index].q0);
-                if (meas2) {
-                    applyPauliX(qubits_state, G.communication_pairs[index].q0);
-                }
-                applyHadamard(qubits_state, G.communication_pairs[index].q0);
-                applyControlledPauliX(qubits_state, G.communication_pairs[index].q0, G.communication_pairs[index].q1);
-            }
-        }
+QuestDiagonal quest_diagonal(const CUNQAInstruction& inst)
+{
+    QuestDiagonal quest_diagonal(new DiagMatr(createDiagMatr(inst.qubits.size())));
+    std::vector<qcomp> entries;
+    entries.reserve(inst.diagonal[0].size());
+    for (const auto& entry : inst.diagonal[0])
+        entries.emplace_back(entry[0], entry[1]);
+    setDiagMatr(*quest_diagonal, entries);
+    return quest_diagonal;
+}
 
-        return indices;
-    };
+// Measurement drawn from the generator of the shot instead of the global one of QuEST
+int measure_qubit_(Qureg& qubits_state, sim::ShotRng& rng, const int qubit)
+{
+    qreal prob0 = calcProbOfQubitOutcome(qubits_state, qubit, 0);
+    int outcome = rng.uniform() < prob0 ? 0 : 1;
+    applyForcedQubitMeasurement(qubits_state, qubit, outcome);
+    return outcome;
+}
+
+// Gates of the dynamic engine on the Qureg of a shot worker. The controls of the gates with
+// states are conditioned on them instead of on |1>
+struct QuestBackend {
+    Qureg& state;
+    sim::ShotRng rng;
+    const sim::MatrixCache<QuestMatrix>& unitaries;
+    const sim::MatrixCache<QuestDiagonal>& diagonals;
 
-    std::function<void(TaskState&, const std::optional<constants::CUNQAInstruction>&, const std::vector<int>)> apply_next_instr = 
-        [&](TaskState& T, const std::optional<constants::CUNQAInstruction>& instruction = std::nullopt, const std::vector<int> comm_indices = {}) 
+    using Gate = void (*)(QuestBackend&, const CUNQAInstruction&, std::span<const int>);
+
+    inline int measure(const int qubit) { return measure_qubit_(state, rng, qubit); }
+    inline void reset(const int qubit)
     {
-        const CUNQAInstruction inst = !instruction.has_value() ? *T.it : instruction.value();
-        auto inst_type = INSTRUCTIONS_MAP.at(inst.name);
-        
-        switch (inst_type)
-        {
-        case constants::MEASURE:
+        if (measure(qubit))
+            applyPauliX(state, qubit);
+    }
+    inline void x(const int qubit) { applyPauliX(state, qubit); }
+    inline void z(const int qubit) { applyPauliZ(state, qubit); }
+    inline void h(const int qubit) { applyHadamard(state, qubit); }
+    inline void cx(const int control, const int target) { applyControlledPauliX(state, control, target); }
+    inline void swap(const int a, const int b) { applySwap(state, a, b); }
+
+    static Gate gate(const CUNQAInstruction& inst)
+    {
+        switch (inst.type)
         {
-            int measurement = applyQubitMeasurement(qubits_state, inst.qubits[0] + T.zero_qubit);
-            G.creg[inst.clbits[0] + T.zero_clbit] = (measurement == 1);
-            break;
-        }
         case constants::RESET:
-        {
-            initZeroState(qubits_state);
-            break;
-        }
-        case constants::COPY:
-        {
-            if(inst.l_clbits.size() != inst.r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < inst.l_clbits.size(); ++i)
-                G.creg[inst.l_clbits[i] + T.zero_clbit] = G.creg[inst.r_clbits[i] + T.zero_clbit];
-                
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.reset(qubits[0]); };
         case constants::X:
-        {
-            applyPauliX(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyPauliX(b.state, qubits[0]); };
         case constants::Y:
-        {
-            applyPauliY(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyPauliY(b.state, qubits[0]); };
         case constants::Z:
-        {
-            applyPauliZ(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyPauliZ(b.state, qubits[0]); };
         case constants::H:
-        {
-            applyHadamard(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyHadamard(b.state, qubits[0]); };
         case constants::S:
-        {
-            applyS(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyS(b.state, qubits[0]); };
         case constants::T:
-        {
-            applyT(qubits_state, inst.qubits[0] + T.zero_qubit);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applyT(b.state, qubits[0]); };
         case constants::P:
-        {
-            applyPhaseShift(qubits_state, inst.qubits[0] + T.zero_qubit, inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { applyPhaseShift(b.state, qubits[0], inst.params[0]); };
         case constants::RX:
-        {
-            applyRotateX(qubits_state, inst.qubits[0] + T.zero_qubit, inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { applyRotateX(b.state, qubits[0], inst.params[0]); };
         case constants::RY:
-        {
-            applyRotateY(qubits_state, inst.qubits[0] + T.zero_qubit, inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { applyRotateY(b.state, qubits[0], inst.params[0]); };
         case constants::RZ:
-        {
-            applyRotateZ(qubits_state, inst.qubits[0] + T.zero_qubit, inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { applyRotateZ(b.state, qubits[0], inst.params[0]); };
         case constants::RAXIS:
-        {
-            applyRotateAroundAxis(qubits_state, inst.qubits[0] + T.zero_qubit, inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyRotateAroundAxis(b.state, qubits[0], inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
+            };
         // Two qubits
         case constants::SWAP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            applySwap(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applySwap(b.state, qubits.front(), qubits.back()); };
         case constants::SQRTSWAP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            applySqrtSwap(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { applySqrtSwap(b.state, qubits.front(), qubits.back()); };
         case constants::CX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPauliX(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPauliX(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledPauliX(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledPauliX(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CY:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPauliY(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPauliY(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledPauliY(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledPauliY(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CZ:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPauliZ(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPauliZ(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledPauliZ(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledPauliZ(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CH:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledHadamard(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledHadamard(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledHadamard(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledHadamard(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CS:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledS(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledS(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledS(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledS(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CT:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledT(b.state, control, inst.states.value(), qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledT(b.state, qubits[0], qubits.back());
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledT(qubits_state, control, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyControlledT(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::CP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-
-            applyTwoQubitPhaseShift(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back(), inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyTwoQubitPhaseShift(b.state, qubits.front(), qubits.back(), inst.params[0]);
+            };
         case constants::CRX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledRotateX(b.state, control, inst.states.value(), qubits.back(), inst.params[0]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledRotateX(b.state, qubits[0], qubits.back(), inst.params[0]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledRotateX(qubits_state, control, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyControlledRotateX(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            };
         case constants::CRY:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledRotateY(b.state, control, inst.states.value(), qubits.back(), inst.params[0]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledRotateY(b.state, qubits[0], qubits.back(), inst.params[0]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledRotateY(qubits_state, control, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyControlledRotateY(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            };
         case constants::CRZ:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledRotateZ(b.state, control, inst.states.value(), qubits.back(), inst.params[0]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledRotateZ(b.state, qubits[0], qubits.back(), inst.params[0]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledRotateZ(qubits_state, control, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyControlledRotateZ(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            };
         case constants::CRAXIS:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledRotateAroundAxis(b.state, control, inst.states.value(), qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledRotateAroundAxis(b.state, qubits[0], qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledRotateAroundAxis(qubits_state, control, inst.states.value(), unsigned_qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
-            } else {
-                applyControlledRotateAroundAxis(qubits_state, *unsigned_qubits.begin(), unsigned_qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
-            }
-            break;
-        }
+            };
         // Several qubits
         case constants::CSWAP:
-        {   
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledSwap(b.state, control, inst.states.value(), qubits[1], qubits[2]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledSwap(b.state, qubits[0], qubits[1], qubits[2]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledSwap(qubits_state, control, inst.states.value(), unsigned_qubits[1], unsigned_qubits[2]);
-            } else {
-                applyControlledSwap(qubits_state, unsigned_qubits[0], unsigned_qubits[1], unsigned_qubits[2]);
-            }
-            break;
-        }
+            };
         case constants::CSQRTSWAP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledSwap(b.state, control, inst.states.value(), qubits[1], qubits[2]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledSqrtSwap(b.state, qubits[0], qubits[1], qubits[2]);
                 }
-            }
-            if (inst.states){
-                std::vector<int> control = {*unsigned_qubits.begin()};
-                applyMultiStateControlledSwap(qubits_state, control, inst.states.value(), unsigned_qubits[1], unsigned_qubits[2]);
-            } else {
-                applyControlledSqrtSwap(qubits_state, unsigned_qubits[0], unsigned_qubits[1], unsigned_qubits[2]);
-            }
-            break;
-        }
+            };
         case constants::PAULISTR:
-        {
-            applyPauliStr(qubits_state, getPauliStr(inst.paulistr));
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int>) { applyPauliStr(b.state, getPauliStr(inst.paulistr)); };
         case constants::PAULIGADGET:
-        {
-            applyPauliGadget(qubits_state, getPauliStr(inst.paulistr), inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int>) {
+                applyPauliGadget(b.state, getPauliStr(inst.paulistr), inst.params[0]);
+            };
         case constants::NONUNITARYPAULIGADGET:
-        {
-            applyNonUnitaryPauliGadget(qubits_state, getPauliStr(inst.paulistr), inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int>) {
+                applyNonUnitaryPauliGadget(b.state, getPauliStr(inst.paulistr), inst.params[0]);
+            };
         case constants::PHASEGADGET:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyPhaseGadget(b.state, std::vector<int>(qubits.begin(), qubits.end()), inst.params[0]);
+            };
+        case constants::CPAULISTR:
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPauliStr(b.state, control, inst.states.value(), getPauliStr(inst.paulistr));
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPauliStr(b.state, qubits[0], getPauliStr(inst.paulistr));
                 }
-            }
-            applyPhaseGadget(qubits_state, unsigned_qubits, inst.params[0]);
-            break;
-        }
-        case constants::CPAULISTR:
-        {   
-            if (inst.states){
-                std::vector<int> control = {inst.qubits[0]};
-                applyMultiStateControlledPauliStr(qubits_state, control, inst.states.value(), getPauliStr(inst.paulistr));
-            } else {
-                applyControlledPauliStr(qubits_state, inst.qubits[0], getPauliStr(inst.paulistr));
-            }
-            break;
-        }
+            };
         case constants::CPAULIGADGET:
-        {   
-            if (inst.states){
-                std::vector<int> control = {inst.qubits[0]};
-                applyMultiStateControlledPauliGadget(qubits_state, control, inst.states.value(), getPauliStr(inst.paulistr), inst.params[0]);
-            } else {
-                applyControlledPauliGadget(qubits_state, inst.qubits[0], getPauliStr(inst.paulistr), inst.params[0]);
-            }
-            break;
-        }
-        case constants::CPHASEGADGET:
-        {
-            std::vector<int> targets(inst.qubits.begin() + 1, inst.qubits.end());
-            if (inst.states){
-                std::vector<int> control = {inst.qubits[0]};
-                applyMultiStateControlledPhaseGadget(qubits_state, control, inst.states.value(), targets, inst.params[0]);
-            } else {
-                applyControlledPhaseGadget(qubits_state, inst.qubits[0], targets, inst.params[0]);
-            }
-            break;
-        }
-        //Multicontrolled
-        case constants::MCX:
-        {   
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPauliGadget(b.state, control, inst.states.value(), getPauliStr(inst.paulistr), inst.params[0]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPauliGadget(b.state, qubits[0], getPauliStr(inst.paulistr), inst.params[0]);
                 }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledPauliX(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledPauliX(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
-        case constants::MCY:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            };
+        case constants::CPHASEGADGET:
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> targets(qubits.begin() + 1, qubits.end());
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledPhaseGadget(b.state, control, inst.states.value(), targets, inst.params[0]);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledPhaseGadget(b.state, qubits[0], targets, inst.params[0]);
                 }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledPauliY(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledPauliY(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
+            };
+        // Multicontrolled
+        case constants::MCX:
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledPauliX(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledPauliX(b.state, controls, qubits.back());
+            };
+        case constants::MCY:
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledPauliY(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledPauliY(b.state, controls, qubits.back());
+            };
         case constants::MCZ:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledPauliZ(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledPauliZ(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledPauliZ(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledPauliZ(b.state, controls, qubits.back());
+            };
         case constants::MCH:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledHadamard(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledHadamard(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledHadamard(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledHadamard(b.state, controls, qubits.back());
+            };
         case constants::MCS:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledS(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledS(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledS(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledS(b.state, controls, qubits.back());
+            };
         case constants::MCT:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledT(qubits_state, controls, inst.states.value(), unsigned_qubits.back());
-            } else {
-                applyMultiControlledT(qubits_state, controls, unsigned_qubits.back());
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledT(b.state, controls, inst.states.value(), qubits.back());
+                else
+                    applyMultiControlledT(b.state, controls, qubits.back());
+            };
         case constants::MCP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            applyMultiQubitPhaseShift(qubits_state, unsigned_qubits, inst.params[0]);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyMultiQubitPhaseShift(b.state, std::vector<int>(qubits.begin(), qubits.end()), inst.params[0]);
+            };
         case constants::MCRX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledRotateX(qubits_state, controls, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyMultiControlledRotateX(qubits_state, controls, unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledRotateX(b.state, controls, inst.states.value(), qubits.back(), inst.params[0]);
+                else
+                    applyMultiControlledRotateX(b.state, controls, qubits.back(), inst.params[0]);
+            };
         case constants::MCRY:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledRotateY(qubits_state, controls, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyMultiControlledRotateY(qubits_state, controls, unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledRotateY(b.state, controls, inst.states.value(), qubits.back(), inst.params[0]);
+                else
+                    applyMultiControlledRotateY(b.state, controls, qubits.back(), inst.params[0]);
+            };
         case constants::MCRZ:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledRotateZ(qubits_state, controls, inst.states.value(), unsigned_qubits.back(), inst.params[0]);
-            } else {
-                applyMultiControlledRotateZ(qubits_state, controls, unsigned_qubits.back(), inst.params[0]);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledRotateZ(b.state, controls, inst.states.value(), qubits.back(), inst.params[0]);
+                else
+                    applyMultiControlledRotateZ(b.state, controls, qubits.back(), inst.params[0]);
+            };
         case constants::MCRAXIS:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-1);
-            if (inst.states){
-                applyMultiStateControlledRotateAroundAxis(qubits_state, controls, inst.states.value(), unsigned_qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
-            } else {
-                applyMultiControlledRotateAroundAxis(qubits_state, controls, unsigned_qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 1);
+                if (inst.states)
+                    applyMultiStateControlledRotateAroundAxis(b.state, controls, inst.states.value(), qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
+                else
+                    applyMultiControlledRotateAroundAxis(b.state, controls, qubits.back(), inst.params[0], inst.axis[0], inst.axis[1], inst.axis[2]);
+            };
         case constants::MCSWAP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-2);
-            if (inst.states){
-                applyMultiStateControlledSwap(qubits_state, controls, inst.states.value(), *(unsigned_qubits.end()-2), unsigned_qubits.back());
-            } else {
-                applyMultiControlledSwap(qubits_state, controls, *(unsigned_qubits.end()-2), unsigned_qubits.back());
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 2);
+                if (inst.states)
+                    applyMultiStateControlledSwap(b.state, controls, inst.states.value(), qubits.end()[-2], qubits.back());
+                else
+                    applyMultiControlledSwap(b.state, controls, qubits.end()[-2], qubits.back());
+            };
         case constants::MCSQRTSWAP:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end() - 2);
+                if (inst.states) {
+                    // Using different arg types due to bug on overloaded function
+                    std::vector<int> states = inst.states.value();
+                    applyMultiStateControlledSqrtSwap(b.state, controls.data(), states.data(), controls.size(), qubits.end()[-2], qubits.back());
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyMultiControlledSqrtSwap(b.state, controls, qubits.end()[-2], qubits.back());
                 }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(), unsigned_qubits.end()-2);
-            if (inst.states){
-                // Using different arg types due to bug on overloaded function
-                std::vector<int> states = inst.states.value();
-                applyMultiStateControlledSqrtSwap(qubits_state, controls.data(), states.data(), controls.size(), *(unsigned_qubits.end()-2), unsigned_qubits.back());
-            } else {
-                applyMultiControlledSqrtSwap(qubits_state, controls, *(unsigned_qubits.end()-2), unsigned_qubits.back());
-            }
-            break;
-        }
+            };
         case constants::MCPAULISTR:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            if (inst.states){
-                applyMultiStateControlledPauliStr(qubits_state, unsigned_qubits, inst.states.value(), getPauliStr(inst.paulistr));
-            } else {
-                applyMultiControlledPauliStr(qubits_state, unsigned_qubits, getPauliStr(inst.paulistr));
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end());
+                if (inst.states)
+                    applyMultiStateControlledPauliStr(b.state, controls, inst.states.value(), getPauliStr(inst.paulistr));
+                else
+                    applyMultiControlledPauliStr(b.state, controls, getPauliStr(inst.paulistr));
+            };
         case constants::MCPAULIGADGET:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            if (inst.states){
-                applyMultiStateControlledPauliGadget(qubits_state, unsigned_qubits, inst.states.value(), getPauliStr(inst.paulistr), inst.params[0]);
-            } else {
-                applyMultiControlledPauliGadget(qubits_state, unsigned_qubits, getPauliStr(inst.paulistr), inst.params[0]);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.end());
+                if (inst.states)
+                    applyMultiStateControlledPauliGadget(b.state, controls, inst.states.value(), getPauliStr(inst.paulistr), inst.params[0]);
+                else
+                    applyMultiControlledPauliGadget(b.state, controls, getPauliStr(inst.paulistr), inst.params[0]);
+            };
         case constants::MCPHASEGADGET:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(),                        unsigned_qubits.begin() + inst.num_controls + 1);
-            std::vector<int> targets(unsigned_qubits.begin() + inst.num_controls + 1, unsigned_qubits.end());
-            if (inst.states){
-                applyMultiStateControlledPhaseGadget(qubits_state, controls, inst.states.value(), targets, inst.params[0]);
-            } else {
-                applyMultiControlledPhaseGadget(qubits_state, controls, targets, inst.params[0]);
-            }
-            break;
-        }
-        // --- Multi-qubit X ---
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.begin() + inst.num_controls + 1);
+                std::vector<int> targets(qubits.begin() + inst.num_controls + 1, qubits.end());
+                if (inst.states)
+                    applyMultiStateControlledPhaseGadget(b.state, controls, inst.states.value(), targets, inst.params[0]);
+                else
+                    applyMultiControlledPhaseGadget(b.state, controls, targets, inst.params[0]);
+            };
+        // Multi-qubit X
         case constants::MX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            applyMultiQubitNot(qubits_state, unsigned_qubits);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction&, std::span<const int> qubits) {
+                applyMultiQubitNot(b.state, std::vector<int>(qubits.begin(), qubits.end()));
+            };
         case constants::CMX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> targets(qubits.begin() + 1, qubits.end());
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledMultiQubitNot(b.state, control, inst.states.value(), targets);
                 } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledMultiQubitNot(b.state, qubits[0], targets);
                 }
-            }
-            std::vector<int> targets(unsigned_qubits.begin()+1, unsigned_qubits.end());
-            std::vector<int> control = {unsigned_qubits[0]};
-            if (inst.states){
-                applyMultiStateControlledMultiQubitNot(qubits_state, control, inst.states.value(), targets);
-            } else {
-                applyControlledMultiQubitNot(qubits_state, unsigned_qubits[0], targets);
-            }
-            break;
-        }
+            };
         case constants::MCMX:
-        {
-            std::vector<int> unsigned_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            std::vector<int> controls(unsigned_qubits.begin(),                        unsigned_qubits.begin() + inst.num_controls + 1);
-            std::vector<int> targets(unsigned_qubits.begin() + inst.num_controls + 1, unsigned_qubits.end());
-            if (inst.states){
-                applyMultiStateControlledMultiQubitNot(qubits_state, controls, inst.states.value(), targets);
-            } else {
-                applyMultiControlledMultiQubitNot(qubits_state, controls, targets);
-            }
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<int> controls(qubits.begin(), qubits.begin() + inst.num_controls + 1);
+                std::vector<int> targets(qubits.begin() + inst.num_controls + 1, qubits.end());
+                if (inst.states)
+                    applyMultiStateControlledMultiQubitNot(b.state, controls, inst.states.value(), targets);
+                else
+                    applyMultiControlledMultiQubitNot(b.state, controls, targets);
+            };
         case constants::UNITARY:
-        {
-            auto cunqa_matrix = inst.matrix[0];
-            CompMatr quest_matrix = createCompMatr(inst.qubits.size());
-            // Using this constructor setCompMatr(CompMatr out, std::vector<std::vector<qcomp>> in);
-            setCompMatr(quest_matrix, cunqamatrix_to_questmatrix(cunqa_matrix));
-            std::vector<int> int_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            int_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
-                } else {
-                    int_qubits.push_back(inst.qubits[i] + T.zero_qubit);
-                }
-            }
-            applyCompMatr(qubits_state, int_qubits, quest_matrix);
-            break;
-        }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyCompMatr(b.state, std::vector<int>(qubits.begin(), qubits.end()), *b.unitaries.at(inst));
+            };
+        case constants::DIAGONAL:
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                applyDiagMatr(b.state, std::vector<int>(qubits.begin(), qubits.end()), *b.diagonals.at(inst));
+            };
         case constants::CUNITARY:
-        {
-            auto cunqa_matrix = inst.matrix[0];
-            CompMatr quest_matrix = createCompMatr(inst.qubits.size() - 1);
-            // Using this constructor setCompMatr(CompMatr out, std::vector<std::vector<qcomp>> in);
-            setCompMatr(quest_matrix, cunqamatrix_to_questmatrix(cunqa_matrix));
-            std::vector<int> int_qubits;
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            int_qubits.push_back(G.communication_pairs[index].q1);
-                            break;
-                        }
-                    }
+            return [](QuestBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                const CompMatr& quest_matrix = *b.unitaries.at(inst);
+                std::vector<int> targets(qubits.begin() + 1, qubits.end());
+                if (inst.states) {
+                    std::vector<int> control = {qubits[0]};
+                    applyMultiStateControlledCompMatr(b.state, control, inst.states.value(), targets, quest_matrix);
                 } else {
-                    int_qubits.push_back(inst.qubits[i] + T.zero_qubit);
+                    applyControlledCompMatr(b.state, qubits[0], targets, quest_matrix);
                 }
-            }
-            std::vector<int> targets(int_qubits.begin() + 1, int_qubits.end());
-            if (inst.states){
-                std::vector<int> control = {int_qubits[0]};
-                applyMultiStateControlledCompMatr(qubits_state, control, inst.states.value(), targets, quest_matrix);
-            } else {
-                applyControlledCompMatr(qubits_state, int_qubits[0], targets, quest_matrix);
-            }
-            break;
-        }
-        case constants::SEND:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[inst.qpus[0]].id
-                };  
-                for (auto& clbit : inst.clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
-                }
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    classical_channel->send_measure(G.creg[clbit + T.zero_clbit], inst.qpus[0]);
-                }
-            }
-            break;
-        }
-        case constants::RECV:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[inst.qpus[0]].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
-                    for (const auto& clbit: inst.clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
-                    }
-                    T.blocked_by_cc = false;
-                } else {
-                    T.blocked_by_cc = true;
-                }    
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    int measurement = classical_channel->recv_measure(inst.qpus[0]);
-                    G.creg[clbit + T.zero_clbit] = (measurement == 1);
-                }
-            }
-            break;
-        }
-        case constants::CIF:
-        {   
-            bool init = (static_cast<bool>(inst.condition)) ? G.creg[inst.clbits[0] + T.zero_clbit] : !G.creg[inst.clbits[0] + T.zero_clbit];
-            // Operates on the values provided, with the specified operation.
-            // If there is only one value, sum = G.creg[inst.clbits[0] + T.zero_clbit]
-            bool result = std::accumulate(inst.clbits.begin() + 1, inst.clbits.end(), 
-                           init,
-                           [&](bool acc, int clbit) { 
-                               return constants::cif_ops[inst.operation](acc, G.creg[clbit + T.zero_clbit]); 
-                           });
-            result = (static_cast<bool>(inst.condition)) ? result : !result;
-
-            if (static_cast<bool>(inst.condition) == result) {
-                for(const auto& sub_inst: inst.instructions) {
-                    apply_next_instr(T, sub_inst, {});
-                }
-            }
-            break;
-        }
-        case constants::QSEND:
-        {
-            std::vector<int> indices = generate_entanglement_(1);
-            if (indices.empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            T.blocked_by_teledata = false;
-            int index = indices[0];
-            G.communication_pairs[index].qcomm_protocol = "teledata";
-
-            // CX to the entangled pair
-            applyControlledPauliX(qubits_state, inst.qubits[0] + T.zero_qubit, G.communication_pairs[index].q0);
-
-            // H to the sent qubit
-            applyHadamard(qubits_state, inst.qubits[0] + T.zero_qubit);
-
-            int result1 = applyQubitMeasurement(qubits_state, inst.qubits[0] + T.zero_qubit);
-            G.qc_meas_td[T.id].push(result1);
-            int result2 = applyQubitMeasurement(qubits_state, G.communication_pairs[index].q0);
-            G.qc_meas_td[T.id].push(result2);
-
-            // Reset origin qubit
-            if (result1) {
-                applyPauliX(qubits_state, inst.qubits[0] + T.zero_qubit);
-            }
-
-            // Unlock QRECV
-            Ts[inst.qpus[0]].blocked_by_teledata = false;
-
-            // Update communication pair
-            G.communication_pairs[index].sendr_qpu = T.id;
-            G.communication_pairs[index].recvr_qpu = inst.qpus[0];
-
-            break;
-        }
-        case constants::QRECV:
-        {
-            if (!G.qc_meas_td.contains(inst.qpus[0]) || G.qc_meas_td[inst.qpus[0]].empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            if (T.blocked_by_teledata) return;
-
-            // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-            std::size_t meas2 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "teledata", 1);
-            int index = indices[0];
-
-            // Apply, conditioned to the measurement, the X and Z gates
-            if (meas1) {
-                applyPauliX(qubits_state, G.communication_pairs[index].q1);
-            }
-            if (meas2) {
-                applyPauliZ(qubits_state, G.communication_pairs[index].q1);
-            }
-
-            // Swap the value to the desired qubit
-            applySwap(qubits_state, G.communication_pairs[index].q1, inst.qubits[0] + T.zero_qubit);
-
-            G.communication_pairs[index].idle = true;
-            break;
-        }
-        case constants::EXPOSE:
-        {
-            if (!T.cat_entangled) {
-                std::vector<int> indices = generate_entanglement_(inst.qubits.size());
-                if (indices.empty()) {
-                    T.blocked_by_telegate = true;
-                    return;
-                }
-
-                int qid = 0;
-                for (auto& index : indices) {
-                    G.communication_pairs[index].qcomm_protocol = "telegate";
-                    G.communication_pairs[index].label = -(qid + 1);
-
-                    // CX to the entangled pair
-                    applyControlledPauliX(qubits_state, inst.qubits[qid] + T.zero_qubit, G.communication_pairs[index].q0);
-                    int result = applyQubitMeasurement(qubits_state, G.communication_pairs[index].q0);
-
-                    G.qc_meas_tg[T.id].push(result);
-                    T.cat_entangled = true;
-                    T.blocked_by_telegate = true;
-                    Ts[inst.qpus[0]].blocked_by_telegate = false;
-
-                    // Update communication pair
-                    G.communication_pairs[index].sendr_qpu = T.id;
-                    G.communication_pairs[index].recvr_qpu = inst.qpus[0];
-
-                    qid++;
-                }
-                return;
-            } else {
-                for (int i = 0; i < inst.qubits.size(); i++) {
-                    int meas = G.qc_meas_tg[inst.qpus[0]].front();
-                    G.qc_meas_tg[inst.qpus[0]].pop();
-
-                    if (meas) {
-                        applyPauliZ(qubits_state, inst.qubits[0] + T.zero_qubit);
-                    }
-                }
-
-                T.cat_entangled = false;
-
-                std::vector<int> indices = find_my_communication_pairs(G, T.id, inst.qpus[0], "telegate", inst.qubits.size());
-                for (auto& index : indices) {
-                    G.communication_pairs[index].idle = true;
-                }
-            }
-            break;
-        }
-        case constants::RCONTROL:
-        {
-            if (!G.qc_meas_tg.contains(inst.qpus[0]) || G.qc_meas_tg[inst.qpus[0]].empty()) {
-                T.blocked_by_telegate = true;
-                return;
-            }
-            if (T.blocked_by_telegate) return;
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "telegate");
-
-            for (auto& index : indices) {
-                int meas2 = G.qc_meas_tg[inst.qpus[0]].front();
-                G.qc_meas_tg[inst.qpus[0]].pop();
-
-                if (meas2) {
-                    applyPauliX(qubits_state, G.communication_pairs[index].q1);
-                }
-            }
-
-            for(const auto& sub_inst: inst.instructions) {
-                apply_next_instr(T, sub_inst, indices);
-            }
-
-            for (auto& index : indices) {
-                applyHadamard(qubits_state, G.communication_pairs[index].q1);
-
-                int result = applyQubitMeasurement(qubits_state, G.communication_pairs[index].q1);
-                G.qc_meas_tg[T.id].push(result);
-            }
-
-            Ts[inst.qpus[0]].blocked_by_telegate = false;
-            T.blocked_by_telegate = false;
-            break;
-        }
+            };
         default:
+            // Refused before the first shot instead of halfway through it
             std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.name << "\n";
             throw std::invalid_argument("Unknown instruction type");
-        } // End switch
-    };
+        }
+    }
+};
 
-    while (!G.ended)
-    {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
-        {
-            if (T.finished)
-                continue;
-            else if(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc) {
-                G.ended = false;
-                continue;
-            }
+} // End of anonymous namespace
 
-            apply_next_instr(T, std::nullopt, {});
+namespace cunqa {
+namespace sim {
 
-            if (!(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc))
-                ++T.it;
+struct QuregPool::Impl {
+    struct IdleQureg {
+        Qureg qureg;
+        std::chrono::steady_clock::time_point since;
+    };
 
-            if (T.it != T.end)
-                G.ended = false;
-            else
-                T.finished = true;
-        }
+    std::chrono::seconds idle_timeout;
+    std::vector<IdleQureg> idle;
+    std::mutex mutex; // Taken by the threads of the shots
 
-    } // End one shot
+    Impl(const std::chrono::seconds idle_timeout) : idle_timeout{idle_timeout} {}
 
-    std::unordered_map<std::string, std::string> shot_bits;
-    for (auto& [id, T]: Ts) {
-        std::string bitstring(T.local_n_clbits, '0');
-        for (const auto &[bitIndex, value] : G.creg) {
-            if (T.zero_clbit <= bitIndex && bitIndex < (T.zero_clbit + T.local_n_clbits)) {
-                bitstring[T.local_n_clbits + T.zero_clbit - bitIndex - 1] = value ? '1' : '0';
-            }
-        }
-        shot_bits[id] = bitstring;
+    ~Impl()
+    {
+        for (auto& idle_qureg : idle)
+            destroyQureg(idle_qureg.qureg);
     }
 
-    return shot_bits;
-}
+    Qureg acquire(const int n_qubits, const int is_density_matrix, const int use_distribution, const int use_gpu, const int use_multithread)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        evict_idle_();
+
+        auto it = std::find_if(idle.begin(), idle.end(), [&](const IdleQureg& idle_qureg) {
+            const Qureg& qureg = idle_qureg.qureg;
+            return qureg.numQubits == n_qubits && qureg.isDensityMatrix == is_density_matrix &&
+                   qureg.isDistributed == use_distribution && qureg.isGpuAccelerated == use_gpu && 
+                   qureg.isMultithreaded == use_multithread;
+        });
+        if (it != idle.end()) {
+            Qureg qureg = it->qureg;
+            idle.erase(it);
+            return qureg;
+        }
+
+        LOGGER_DEBUG("Creating a Qureg of {} qubits for the pool", n_qubits);
+        Qureg qureg = createCustomQureg(n_qubits, is_density_matrix, use_distribution, use_gpu, use_multithread);
+        // QuEST allocates the amplitudes itself, so they can only be advised onto transparent huge
+        // pages, which khugepaged then gathers the pages already touched into
+        if (!qureg.isGpuAccelerated)
+            advise_huge_pages(qureg.cpuAmps, qureg.numAmpsPerNode * sizeof(qcomp));
+        return qureg;
+    }
 
-void update_meas_counter(std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>& meas_counter, const std::unordered_map<std::string, std::string>& shot_bitstrings)
-{
-    for (const auto& [circ_id, outcome] : shot_bitstrings) {
-        meas_counter[circ_id][outcome]++;
+    void release(const Qureg& qureg)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back({qureg, std::chrono::steady_clock::now()});
+        evict_idle_();
     }
-}
 
-} // End of anonymous namespace
+private:
+    // Must be called with the mutex locked. The GPU of a QPU is its own, so the quregs on it are
+    // kept as its device memory pool, instead of allocating it again for the next requests
+    void evict_idle_()
+    {
+        auto now = std::chrono::steady_clock::now();
+        std::erase_if(idle, [&](IdleQureg& idle_qureg) {
+            if (idle_qureg.qureg.isGpuAccelerated || now - idle_qureg.since <= idle_timeout)
+                return false;
+            destroyQureg(idle_qureg.qureg);
+            return true;
+        });
+    }
+};
 
-namespace cunqa {
-namespace sim {
+QuregPool::QuregPool(const std::chrono::seconds idle_timeout) :
+    pimpl_{std::make_unique<Impl>(idle_timeout)}
+{ }
+
+QuregPool::~QuregPool() = default;
 
-QuestSimulatorAdapter::QuestSimulatorAdapter(QuestComputationAdapter& qc): qc{qc} 
+QuestSimulatorAdapter::QuestSimulatorAdapter(QuestComputationAdapter qc): qc{std::move(qc)} 
 {
     const char* num_threads_char = std::getenv("OMP_NUM_THREADS");
     unsigned num_threads = 1;
@@ -1438,10 +585,9 @@ QuestSimulatorAdapter::QuestSimulatorAdapter(QuestComputationAdapter& qc): qc{qc
     }
 } 
 
-JSON QuestSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
+JSON QuestSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc, QuregPool* qureg_pool)
 {
     LOGGER_DEBUG("Quest dynamic simulation");
-    std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>  meas_counter;
 
     JSON config = qc.quantum_tasks[0].config;
     auto shots = config.at("shots").get<int>();
@@ -1450,27 +596,17 @@ JSON QuestSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     size_t n_qubits = 0;
     for (auto& quantum_task : qc.quantum_tasks) {
         st_qtasks.push_back(from_quantum_task_to_structuredqtask(quantum_task));
+        // Each run of diagonal gates becomes a DiagMatr, a single pass over the state
+        if (quantum_task.config.value("merge_diagonals", true))
+            merge_diagonal_runs(st_qtasks.back());
         n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
     }
+    MeasCounter meas_counter(st_qtasks);
 
-    size_t n_comm_qubits = 0;
-    if (qc.quantum_tasks.size() > 1) { // Quantum Communications 
-        if (config.contains("n_communication_qubits")) {
-            n_comm_qubits = config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-        } else {
-            n_comm_qubits = 2;
-        }
-
-        n_qubits += n_comm_qubits;
-    }
+    const size_t n_comm_qubits = n_communication_qubits(qc.quantum_tasks);
+    n_qubits += n_comm_qubits;
 
-    unsigned seed = 0;
-    if (config.contains("seed")) {
-        seed = config.at("seed").get<unsigned>();
-    }
+    const std::uint64_t seed = simulation_seed(config);
 
     int vec_or_mat{};
     std::string method = config.at("method").get<std::string>();
@@ -1483,32 +619,44 @@ JSON QuestSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
         throw std::invalid_argument{"QuEST simulator only supports statevector or density matrix simulation"};
     }
 
+    // Without the pool of a simulator the Quregs only live along this simulation
+    QuregPool local_pool;
+    auto& pool = (qureg_pool != nullptr) ? *qureg_pool->pimpl_ : *local_pool.pimpl_;
+    // Set by the distributed simulator, that initializes the environment before the adapter
+    int use_distribution = getQuESTEnv().isDistributed;
+    int use_gpu = getQuESTEnv().isGpuAccelerated;
+
     float time_taken = 0.0f;
+    const DynamicEngine<QuestBackend> engine(st_qtasks, n_comm_qubits);
+    sim::MatrixCache<QuestMatrix> unitaries;
+    for (const auto& quantum_task : st_qtasks)
+        unitaries.add(quantum_task.instructions, {constants::UNITARY, constants::CUNITARY}, quest_unitary);
+    sim::MatrixCache<QuestDiagonal> diagonals;
+    for (const auto& quantum_task : st_qtasks)
+        diagonals.add(quantum_task.instructions, {constants::DIAGONAL}, quest_diagonal);
+    std::size_t blocked_iterations = 0;
+    const ShotConvergence convergence = ShotConvergence::from_config(config, classical_channel != nullptr);
+    ShotProgress progress;
     auto start = std::chrono::high_resolution_clock::now();
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
+    // Quantum communications, or a single circuit small enough to split its shots among the threads.
+    // A statevector on GPU runs its shots one after another, and so does a distributed one, whose
+    // collective calls come from a single thread
+    if (!use_gpu && !use_distribution && (size(qc.quantum_tasks) > 1 || parallelize_shots(config, n_qubits, shots))) {
         #pragma omp parallel
         {
-            std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>  local_counter;
-
-            if (config.contains("seed")) {
-                setSeeds(&seed, 1);
-            }
-            
-            Qureg qubits_state = createCustomQureg(n_qubits, vec_or_mat, 0, 0, 1);
-            #pragma omp for
-            for (size_t i = 0; i < shots; i++) {
+            Qureg qubits_state = pool.acquire(n_qubits, vec_or_mat, use_distribution, 0, 1);
+            QuestBackend backend{qubits_state, ShotRng(seed, 0), unitaries, diagonals};
+            auto shot = engine.shot();
+            convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
                 LOGGER_DEBUG("shot= {}", std::to_string(i));
                 initZeroState(qubits_state);
-                update_meas_counter(local_counter, execute_shot_(qubits_state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));
-            }
+                backend.rng = ShotRng(seed, i);
+                counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+            });
 
             #pragma omp critical
-            for (const auto& [id, bitstrings_counter] : local_counter) {
-                for (const auto& [bitstring, counts] : bitstrings_counter) {
-                    meas_counter[id][bitstring] += counts;
-                } 
-            }
+            blocked_iterations += shot.blocked_iterations;
             auto end = std::chrono::high_resolution_clock::now();
             #pragma omp critical
             {
@@ -1516,43 +664,48 @@ JSON QuestSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
             }
             
             #pragma omp barrier
-            destroyQureg(qubits_state);
+            pool.release(qubits_state);
         }
     } else { // As if OPENMP_IN_QC not enabled
         
-        if (config.contains("seed")) {
-            setSeeds(&seed, 1);
-        }
-
-        Qureg qubits_state = createCustomQureg(n_qubits, vec_or_mat, 0, 0, 0);
-        for (int i = 0; i < shots; i++) {
+        Qureg qubits_state = pool.acquire(n_qubits, vec_or_mat, use_distribution, use_gpu, 0);
+        QuestBackend backend{qubits_state, ShotRng(seed, 0), unitaries, diagonals};
+        auto shot = engine.shot();
+        convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
             initZeroState(qubits_state);
-            update_meas_counter(meas_counter, execute_shot_(qubits_state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));            
-        } // End all shots
+            backend.rng = ShotRng(seed, i);
+            counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+        });
+        blocked_iterations = shot.blocked_iterations;
         auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<float> duration = end - start;
         time_taken = duration.count();
 
-        destroyQureg(qubits_state);
+        pool.release(qubits_state);
     }
 #else
-    if (config.contains("seed")) {
-        setSeeds(&seed, 1);
-    }
-    Qureg qubits_state = createCustomQureg(n_qubits, vec_or_mat, 0, 0, 0);
-    for (int i = 0; i < shots; i++) {
+    Qureg qubits_state = pool.acquire(n_qubits, vec_or_mat, use_distribution, use_gpu, 0);
+    QuestBackend backend{qubits_state, ShotRng(seed, 0), unitaries, diagonals};
+    auto shot = engine.shot();
+    convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
         initZeroState(qubits_state);
-        update_meas_counter(meas_counter, execute_shot_(qubits_state, st_qtasks, classical_channel, allows_qc, n_comm_qubits));        
-    } // End all shots
+        backend.rng = ShotRng(seed, i);
+        counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+    });
+    blocked_iterations = shot.blocked_iterations;
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> duration = end - start;
     time_taken = duration.count();
 
-    destroyQureg(qubits_state);
+    pool.release(qubits_state);
 #endif
     JSON result_json = {
         {"id_counts", meas_counter},
         {"time_taken", time_taken}};
+    if (n_comm_qubits != 0)
+        result_json["scheduler"] = {{"communication_qubits", n_comm_qubits}, {"blocked_iterations", blocked_iterations}};
+    if (convergence.enabled())
+        result_json["convergence"] = convergence.report(progress);
     return result_json;
 }
 
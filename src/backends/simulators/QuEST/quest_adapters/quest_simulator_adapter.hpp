@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "quest_computation_adapter.hpp"
+#include "qureg_pool.hpp"
 #include "quantum_task.hpp"
 #include "classical_channel/classical_channel.hpp"
 #include "backends/backend.hpp"
@@ -15,10 +16,10 @@ class QuestSimulatorAdapter
 {
 public:
     QuestSimulatorAdapter() = default;
-    QuestSimulatorAdapter(QuestComputationAdapter& qc);
+    QuestSimulatorAdapter(QuestComputationAdapter qc);
 
     JSON simulate(const Backend* backend);
-    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false, QuregPool* qureg_pool = nullptr);
 
     QuestComputationAdapter qc;
 };
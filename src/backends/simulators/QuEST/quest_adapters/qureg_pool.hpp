@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <chrono>
+
+namespace cunqa {
+namespace sim {
+
+// Quregs of previous simulations, reused by the next ones with the same number of qubits and
+// kind of state, so a circuit sent back to back only pays initZeroState. The ones idle for longer
+// than the timeout are destroyed the next time the pool is used, except those on GPU. The QuEST types stay in the
+// implementation, next to the adapter, so the simulators holding a pool do not see them.
+class QuregPool {
+public:
+    static constexpr std::chrono::seconds DEFAULT_IDLE_TIMEOUT{60};
+
+    QuregPool(const std::chrono::seconds idle_timeout = DEFAULT_IDLE_TIMEOUT);
+    ~QuregPool();
+
+private:
+    friend class QuestSimulatorAdapter;
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -1,6 +1,7 @@
 #include "quest_cc_simulator.hpp"
 #include "quest_adapters/quest_computation_adapter.hpp"
 #include "quest_adapters/quest_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 using namespace std::string_literals;
 
@@ -16,14 +17,16 @@ QuestCCSimulator::QuestCCSimulator() :
 // Distributed QuestSimulator
 JSON QuestCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
+
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, channel);
 
     QuestComputationAdapter quest_ca(quantum_task);
-    QuestSimulatorAdapter quest_sa(quest_ca);
+    QuestSimulatorAdapter quest_sa(std::move(quest_ca));
 
     // Dynamic simulation always
-    JSON result = quest_sa.simulate(&classical_channel);
+    JSON result = quest_sa.simulate(channel, false, &qureg_pool_);
     return {
         {"counts", result.at("id_counts").at(quantum_task.id)},
         {"time_taken", result.at("time_taken")}
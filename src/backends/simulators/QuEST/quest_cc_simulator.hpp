@@ -4,6 +4,7 @@
 #include "backends/cc_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
 #include "classical_channel/classical_channel.hpp"
+#include "quest_adapters/qureg_pool.hpp"
 
 #include "utils/json.hpp"
 #include "logger.hpp"
@@ -21,6 +22,7 @@ public:
 
 private:
     comm::ClassicalChannel classical_channel;
+    QuregPool qureg_pool_; // Statevectors of previous executions, reused by the next ones
 };
 
 } // End namespace sim
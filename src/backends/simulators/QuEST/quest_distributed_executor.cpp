@@ -0,0 +1,77 @@
+#include "quest_distributed_executor.hpp"
+#include "quest_distributed_simulator.hpp"
+#include "quest_adapters/quest_computation_adapter.hpp"
+#include "quest_adapters/quest_simulator_adapter.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "quantum_task.hpp"
+
+#include <string>
+
+#include "quest.h"
+#include "utils/json.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::sim;
+
+// The tasks of a round travel as a JSON array of the tasks as the QPUs send them
+std::vector<QuantumTask> tasks_of(const std::string& message)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& quantum_task : JSON::parse(message))
+        quantum_tasks.emplace_back(quantum_task.get<std::string>());
+    return quantum_tasks;
+}
+
+// The communications between the QPUs of the round are simulated within the statevector, so the
+// classical channel is never used
+JSON simulate_round(std::vector<QuantumTask>&& quantum_tasks, QuregPool& qureg_pool)
+{
+    QuestComputationAdapter qc(std::move(quantum_tasks));
+    QuestSimulatorAdapter quest_sa(std::move(qc));
+    return quest_sa.simulate(nullptr, true, &qureg_pool);
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+JSON QuestDistributedExecutor::simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel*, std::size_t)
+{
+    init_distributed_env();
+
+    // Every rank has to draw the same measurements, so they share the seed of the round
+    const auto seed = simulation_seed(quantum_tasks.front().config);
+    JSON round = JSON::array();
+    for (auto& quantum_task : quantum_tasks) {
+        quantum_task.config["seed"] = seed;
+        round.push_back(to_string(quantum_task));
+    }
+
+    std::string message = round.dump();
+    broadcast(message);
+    return simulate_round(std::move(quantum_tasks), qureg_pool_);
+}
+
+void QuestDistributedExecutor::follow()
+{
+    init_distributed_env();
+    LOGGER_DEBUG("Rank {} following the distributed executor.", getQuESTEnv().rank);
+
+    QuregPool qureg_pool;
+    std::string message;
+    while (true) {
+        broadcast(message);
+        try {
+            simulate_round(tasks_of(message), qureg_pool);
+        } catch (const std::exception& e) {
+            // Rank 0 fails with the same round and reports the error to the QPUs
+            LOGGER_ERROR("Error simulating the distributed round: {}", e.what());
+        }
+    }
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
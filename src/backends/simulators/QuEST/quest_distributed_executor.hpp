@@ -0,0 +1,31 @@
+#pragma once
+
+#include "backends/simulators/qc_executor.hpp"
+#include "quest_adapters/qureg_pool.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Executor of the QPUs with quantum communications whose combined statevector is spread over the
+// MPI ranks of the Slurm tasks of the executor, so the register of all the QPUs and their
+// communication qubits is not bound by the memory of one node. Rank 0 meets the QPUs and
+// broadcasts each round it simulates, and the other ranks follow it through the same, collective,
+// QuEST calls.
+class QuestDistributedExecutor : public QCExecutor {
+public:
+    using QCExecutor::QCExecutor;
+
+    // Loop of the ranks other than 0, which never returns
+    static void follow();
+
+protected:
+    // The QuEST calls of each rank come from a single thread, one round at a time
+    std::size_t n_workers() const override { return 1; }
+    JSON simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) override;
+
+private:
+    QuregPool qureg_pool_; // Statevectors of previous rounds, reused by the next ones
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
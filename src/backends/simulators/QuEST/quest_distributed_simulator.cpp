@@ -0,0 +1,95 @@
+#include "quest_distributed_simulator.hpp"
+#include "quest_adapters/quest_computation_adapter.hpp"
+#include "quest_adapters/quest_simulator_adapter.hpp"
+#include "backends/simulators/shot_rng.hpp"
+
+#include <string>
+#include <cstdlib>
+
+#include <mpi.h>
+#include "quest.h"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::sim;
+
+JSON simulate(const QuantumTask& quantum_task, QuregPool& qureg_pool)
+{
+    QuestComputationAdapter quest_ca(quantum_task);
+    QuestSimulatorAdapter quest_sa(std::move(quest_ca));
+
+    // Dynamic simulation always
+    JSON result = quest_sa.simulate(nullptr, false, &qureg_pool);
+    JSON simple_result = {
+        {"counts", result.at("id_counts").at(quantum_task.id)},
+        {"time_taken", result.at("time_taken")}
+    };
+    if (result.contains("convergence"))
+        simple_result["convergence"] = result.at("convergence");
+    return simple_result;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+// Initializes MPI on its first call. On rank 0 that happens on the thread that simulates, the
+// compute worker of the QPU or the single worker of the executor, the only thread that calls MPI
+// in the process. Each rank takes the GPU that Slurm gives to its task, if any, and
+// the ranks exchange their chunks of the statevector GPU to GPU through CUDA-aware MPI
+void init_distributed_env()
+{
+    if (isQuESTEnvInit())
+        return;
+
+    const char* num_threads_char = std::getenv("OMP_NUM_THREADS");
+    int use_multithread = (num_threads_char != nullptr && std::stoi(num_threads_char) > 1) ? 1 : 0;
+    int use_gpu = (std::getenv("CUDA_VISIBLE_DEVICES") != nullptr) ? 1 : 0;
+    initCustomQuESTEnv(1, use_gpu, use_gpu ? 0 : use_multithread);
+    LOGGER_DEBUG("Distributed QuEST environment initialized on rank {} of {}{}.", getQuESTEnv().rank, getQuESTEnv().numNodes, use_gpu ? " on GPU" : "");
+}
+
+void broadcast(std::string& message)
+{
+    unsigned long long size = message.size();
+    MPI_Bcast(&size, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+    message.resize(size);
+    MPI_Bcast(message.data(), static_cast<int>(size), MPI_CHAR, 0, MPI_COMM_WORLD);
+}
+
+JSON QuestDistributedSimulator::execute([[maybe_unused]] const SimpleBackend& backend, const QuantumTask& quantum_task)
+{
+    init_distributed_env();
+
+    // Every rank has to draw the same measurements, and the QuEST calls of each rank must come
+    // from a single thread, so the ranks share the seed and do not split the shots
+    QuantumTask distributed_task = quantum_task;
+    distributed_task.config["seed"] = simulation_seed(quantum_task.config);
+    distributed_task.config["shot_parallel"] = false;
+
+    std::string message = to_string(distributed_task);
+    broadcast(message);
+    return simulate(distributed_task, qureg_pool_);
+}
+
+void QuestDistributedSimulator::follow()
+{
+    init_distributed_env();
+    LOGGER_DEBUG("Rank {} following the distributed QPU.", getQuESTEnv().rank);
+
+    QuregPool qureg_pool;
+    std::string message;
+    while (true) {
+        broadcast(message);
+        try {
+            simulate(QuantumTask(message), qureg_pool);
+        } catch (const std::exception& e) {
+            // Rank 0 fails with the same task and reports the error to the client
+            LOGGER_ERROR("Error simulating the distributed task: {}", e.what());
+        }
+    }
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
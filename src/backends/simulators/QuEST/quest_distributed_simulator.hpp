@@ -0,0 +1,39 @@
+#pragma once
+
+#include "quantum_task.hpp"
+#include "backends/simple_backend.hpp"
+#include "backends/simulators/simulator_strategy.hpp"
+#include "quest_adapters/qureg_pool.hpp"
+
+#include "utils/json.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Initializes MPI and the distributed QuEST environment on its first call
+void init_distributed_env();
+// Rank 0 sends the message, the other ranks receive it
+void broadcast(std::string& message);
+
+// QuEST simulator of a QPU whose statevector is spread over the MPI ranks of the Slurm tasks of
+// the job. Rank 0 serves the QPU and broadcasts each task it executes, and the other ranks follow
+// it through the same, collective, QuEST calls.
+class QuestDistributedSimulator final : public SimulatorStrategy<SimpleBackend> {
+public:
+
+    QuestDistributedSimulator() = default;
+    ~QuestDistributedSimulator() = default;
+
+    inline std::string get_name() const override {return "Quest";}
+    JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+
+    // Loop of the ranks other than 0, which never returns
+    static void follow();
+
+private:
+    QuregPool qureg_pool_; // Statevectors of previous executions, reused by the next ones
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -1,21 +1,20 @@
 #pragma once
 
-#include <string>
-#include "classical_channel/classical_channel.hpp"
+#include "backends/simulators/qc_executor.hpp"
+#include "quest_adapters/qureg_pool.hpp"
 
 namespace cunqa {
 namespace sim {
 
-class QuestExecutor {
+class QuestExecutor : public QCExecutor {
 public:
-    QuestExecutor(const std::size_t& n_qpus);
-    ~QuestExecutor() = default;
+    using QCExecutor::QCExecutor;
+
+protected:
+    JSON simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) override;
 
-    void run();
 private:
-    comm::ClassicalChannel classical_channel;
-    std::vector<std::string> qpu_ids;
-    std::unordered_map<std::string, std::string> qpu_quantumtask_map;
+    QuregPool qureg_pool_; // Statevectors of previous executions, reused by the next ones
 };
 
 } // End of sim namespace
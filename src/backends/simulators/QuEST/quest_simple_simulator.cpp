@@ -1,6 +1,7 @@
 #include "quest_simple_simulator.hpp"
 #include "quest_adapters/quest_computation_adapter.hpp"
 #include "quest_adapters/quest_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 #include "quest.h"
 
@@ -9,18 +10,31 @@ namespace sim {
 
 JSON QuestSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task) 
 {
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task);
+
     QuestComputationAdapter quest_ca(quantum_task);
-    QuestSimulatorAdapter quest_sa(quest_ca);
+    QuestSimulatorAdapter quest_sa(std::move(quest_ca));
 
 
     // Dynamic simulation always
-    JSON result = quest_sa.simulate();
-    return {
+    JSON result = quest_sa.simulate(nullptr, false, &qureg_pool_);
+    JSON simple_result = {
         {"counts", result.at("id_counts").at(quantum_task.id)},
         {"time_taken", result.at("time_taken")}
     };
+    if (result.contains("convergence"))
+        simple_result["convergence"] = result.at("convergence");
+    return simple_result;
     
 }
 
+void QuestSimpleSimulator::execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer)
+{
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, writer);
+    writer.write(execute(backend, quantum_task));
+}
+
 } // End namespace sim
 } // End namespace cunqa
\ No newline at end of file
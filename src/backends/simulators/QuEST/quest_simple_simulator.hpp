@@ -3,6 +3,7 @@
 #include "quantum_task.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
+#include "quest_adapters/qureg_pool.hpp"
 
 #include "utils/json.hpp"
 #include "logger.hpp"
@@ -18,6 +19,10 @@ public:
 
     inline std::string get_name() const override {return "Quest";} 
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    void execute_into(const SimpleBackend& backend, const QuantumTask& circuit, ResultWriter& writer) override;
+
+private:
+    QuregPool qureg_pool_; // Statevectors of previous executions, reused by the next ones
 };
 
 } // End of sim namespace
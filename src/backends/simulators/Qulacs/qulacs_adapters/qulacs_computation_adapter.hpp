@@ -12,8 +12,8 @@ public:
     QulacsComputationAdapter(const QuantumTask quantum_task) : 
         quantum_tasks{quantum_task}
     { }
-    QulacsComputationAdapter(const std::vector<QuantumTask> quantum_tasks) : 
-        quantum_tasks{quantum_tasks}
+    QulacsComputationAdapter(std::vector<QuantumTask> quantum_tasks) : 
+        quantum_tasks{std::move(quantum_tasks)}
     { }
 
     std::vector<QuantumTask> quantum_tasks;
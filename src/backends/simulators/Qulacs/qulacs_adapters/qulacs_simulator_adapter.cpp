@@ -1,11 +1,13 @@
 
-#include <unordered_map>
-#include <stack>
-#include <queue>
+#include <map>
+#include <span>
 #include <chrono>
-#include <functional>
 #include <cstdlib>
 #include <optional>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <cmath>
 
 #include "qulacs_simulator_adapter.hpp"
 
@@ -16,18 +18,27 @@
 #include "qulacs_utils.hpp"
 #include "utils/constants.hpp"
 
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/matrix_cache.hpp"
+#include "backends/simulators/dynamic_engine.hpp"
+#include "backends/simulators/diagonal_runs.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/sample_histogram.hpp"
+#include "utils/helpers/stage_timings.hpp"
+
 #include "logger.hpp"
 
 namespace {
 using namespace cunqa;
 
-UINT measure_adapter(QuantumState& state, UINT target_index)
+UINT measure_adapter(QuantumState& state, UINT target_index, sim::ShotRng& rng)
 {
-    Random random;
     auto gate0 = gate::P0(target_index);
     auto gate1 = gate::P1(target_index);
     std::vector<QuantumGateBase*> _gate_list = {gate0, gate1};
-    double r = random.uniform();
+    double r = rng.uniform();
 
     double sum = 0.;
     double org_norm = state.get_squared_norm();
@@ -55,774 +66,576 @@ UINT measure_adapter(QuantumState& state, UINT target_index)
     return index;
 }
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
+// Custom matrices of the tasks converted once for all the shots
+struct QulacsMatrices {
+    sim::MatrixCache<ComplexMatrix> dense; // UNITARY and CUNITARY
+    sim::MatrixCache<SparseComplexMatrix> sparse;
+    sim::MatrixCache<ComplexVector> diagonals;
 
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
+    QulacsMatrices() = default;
+    explicit QulacsMatrices(const std::vector<StructuredQuantumTask>& st_qtasks) { add(st_qtasks); }
 
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
+    void add(const std::vector<StructuredQuantumTask>& st_qtasks)
+    {
+        for (const auto& quantum_task : st_qtasks) {
+            dense.add(quantum_task.instructions, {constants::UNITARY, constants::CUNITARY}, [](const CUNQAInstruction& inst) {
+                return sim::cunqamatrix_to_qulacsdensematrix(inst.matrix[0]);
+            });
+            sparse.add(quantum_task.instructions, {constants::SPARSEMATRIX}, [](const CUNQAInstruction& inst) {
+                return sim::cunqamatrix_to_sparse(inst.matrix[0]);
+            });
+            diagonals.add(quantum_task.instructions, {constants::DIAGONAL}, [](const CUNQAInstruction& inst) {
+                return sim::cunqadiagonal_to_qulacsdiagonal(inst.diagonal[0]);
+            });
+        }
     }
 };
 
-struct CommunicationQubitsPair {
-    int q0;
-    int q1;
-    bool idle = true;
-    std::string sendr_qpu; // QSEND and EXPOSE
-    std::string recvr_qpu; // QRECV and RCONTROL
-    std::string qcomm_protocol;
-    int label;
-};
-
-struct TaskState {
-    std::string id;
-    int local_n_clbits = 0;
-    std::vector<constants::CUNQAInstruction>::const_iterator it, end;
-    UINT zero_qubit = 0;
-    UINT zero_clbit = 0;
-    bool finished = false;
-    bool blocked_by_teledata = false;
-    bool blocked_by_telegate = false;
-    bool blocked_by_cc = false;
-    bool cat_entangled = false;
-};
-
-struct GlobalState {
-    unsigned long n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::queue<UINT>> qc_meas_td;
-    std::unordered_map<std::string, std::queue<UINT>> qc_meas_tg;
-    std::vector<CommunicationQubitsPair> communication_pairs;
-    std::unordered_map<LocalCCIDs, std::queue<UINT>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
-};
-
-std::vector<int> find_idle_communication_pairs(GlobalState& G, const size_t n_pairs)
+std::vector<UINT> qulacs_qubits(std::span<const int> qubits)
 {
-    std::vector<int> indices_idle_pairs;
-    size_t count = 0;
-    for (int index = 0; index < G.communication_pairs.size() && count < n_pairs; index++) {
-        if (G.communication_pairs[index].idle) {
-            indices_idle_pairs.push_back(index);
-            count++;
-        } 
-    } 
-
-    if (count < n_pairs) 
-        return std::vector<int>();
-
-    for (const auto& index : indices_idle_pairs) {
-        G.communication_pairs[index].idle = false;
-    }
-
-    return indices_idle_pairs;
+    return std::vector<UINT>(qubits.begin(), qubits.end());
 }
 
-std::vector<int> find_my_communication_pairs(const GlobalState& G, const std::string& sendr, const std::string recvr, const std::string qcomm_protocol, size_t n_pairs = 0)
-{
-    std::vector<int> comm_pairs;
-    size_t count = 0;
-    if (n_pairs == 0) n_pairs = G.communication_pairs.size();
-    for (int index = 0; index < G.communication_pairs.size(); index++) {
-        if (count == n_pairs) return comm_pairs;
-        if (!G.communication_pairs[index].idle &&
-            G.communication_pairs[index].sendr_qpu == sendr && 
-            G.communication_pairs[index].recvr_qpu == recvr &&
-            G.communication_pairs[index].qcomm_protocol == qcomm_protocol) {
-                comm_pairs.push_back(index);
-                count++;
-        } 
-    } 
-
-    return comm_pairs;
-}
- 
-
-std::unordered_map<std::string, std::string> execute_shot_(
-    QuantumState& state, 
-    std::vector<StructuredQuantumTask>& st_qtasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
-    const bool allows_qc,
-    const size_t& n_comm_qubits
-)
-{
-    std::unordered_map<std::string, TaskState> Ts;
-    GlobalState G;
-
-    for (const auto &quantum_task : st_qtasks) {
-        TaskState T;
-        T.id = quantum_task.id;
-        T.local_n_clbits = quantum_task.n_clbits;
-        T.zero_qubit = G.n_qubits;
-        T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.instructions.begin();
-        T.end = quantum_task.instructions.end();
-        T.blocked_by_teledata = false;
-        T.blocked_by_telegate = false;
-        T.blocked_by_cc = false;
-        T.finished = false;
-        Ts[quantum_task.id] = T;
-        
-        G.n_qubits += quantum_task.n_qubits;
-        G.n_clbits += quantum_task.n_clbits;
-
-    }
-    
-    // Here we add the communication qubits
-    if (n_comm_qubits != 0) {
-        G.n_qubits += n_comm_qubits;
-        for (int i = 0; i < n_comm_qubits; i+=2) {
-            CommunicationQubitsPair cqp = {
-                .q0 = G.n_qubits - n_comm_qubits + i,
-                .q1 = G.n_qubits - n_comm_qubits + i + 1
-            };
-            G.communication_pairs.push_back(cqp);
-        }
-    }
-
-    auto generate_entanglement_ = [&](const size_t n_pairs) {
-        std::vector<int> indices = find_idle_communication_pairs(G, n_pairs);
+// The state of a shot worker as the backend of the dynamic engine. The gates of the factory are
+// applied and released at once
+struct QulacsBackend {
+    QuantumState& state;
+    sim::ShotRng rng;
+    const QulacsMatrices& matrices;
 
-        if (!indices.empty()) {
-            for (auto& index : indices) {
-                UINT meas1 = measure_adapter(state, G.communication_pairs[index].q1);
-                if (meas1) {
-                    gate::X(G.communication_pairs[index].q1)->update_quantum_state(&state);
-                }
-                UINT meas2 = measure_adapter(state, G.communication_pairs[index].q0);
-                if (meas2) {
-                    gate::X(G.communication_pairs[index].q0)->update_quantum_state(&state);
-                }
-                gate::H(G.communication_pairs[index].q0)->update_quantum_state(&state);
-                gate::CNOT(G.communication_pairs[index].q0, G.communication_pairs[index].q1)->update_quantum_state(&state);
-            }
-        }
-        
-        return indices;
-    };
+    using Gate = void (*)(QulacsBackend&, const CUNQAInstruction&, std::span<const int>);
 
+    inline void apply(QuantumGateBase* gate) { std::unique_ptr<QuantumGateBase>(gate)->update_quantum_state(&state); }
 
-    std::function<void(TaskState&, const std::optional<constants::CUNQAInstruction>&, const std::vector<int>)> apply_next_instr = 
-        [&](TaskState& T, const std::optional<constants::CUNQAInstruction>& instruction = std::nullopt, const std::vector<int> comm_indices = {}) 
+    inline int measure(const int qubit) { return measure_adapter(state, qubit, rng); }
+    inline void reset(const int qubit)
     {
-        const CUNQAInstruction inst = !instruction.has_value() ? *T.it : instruction.value();
-        auto inst_type = INSTRUCTIONS_MAP.at(inst.name);
+        if (measure(qubit))
+            x(qubit);
+    }
+    inline void x(const int qubit) { apply(gate::X(qubit)); }
+    inline void z(const int qubit) { apply(gate::Z(qubit)); }
+    inline void h(const int qubit) { apply(gate::H(qubit)); }
+    inline void cx(const int control, const int target) { apply(gate::CNOT(control, target)); }
+    inline void swap(const int a, const int b) { apply(gate::SWAP(a, b)); }
 
-        switch (inst_type)
-        {
-        case constants::MEASURE:
-        {
-            UINT measurement = measure_adapter(state, inst.qubits[0] + T.zero_qubit);
-            G.creg[inst.clbits[0] + T.zero_clbit] = (measurement == 1);
-            break;
-        }
-        case constants::COPY:
+    static Gate gate(const CUNQAInstruction& inst)
+    {
+        switch (inst.type)
         {
-            if(inst.l_clbits.size() != inst.r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < inst.l_clbits.size(); ++i)
-                G.creg[inst.l_clbits[i] + T.zero_clbit] = G.creg[inst.r_clbits[i] + T.zero_clbit];
-                
-            break;
-        }
         case constants::ID:
-            gate::Identity(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::Identity(qubits[0])); };
         case constants::X:
-            gate::X(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::X(qubits[0])); };
         case constants::Y:
-            gate::Y(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::Y(qubits[0])); };
         case constants::Z:
-            gate::Z(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::Z(qubits[0])); };
         case constants::H:
-            gate::H(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::H(qubits[0])); };
         case constants::S:
-            gate::S(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::S(qubits[0])); };
         case constants::SDG:
-            gate::Sdag(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::Sdag(qubits[0])); };
         case constants::T:
-            gate::T(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::T(qubits[0])); };
         case constants::TDG:
-            gate::Tdag(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::Tdag(qubits[0])); };
         case constants::SX:
-            gate::sqrtX(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::sqrtX(qubits[0])); };
         case constants::SXDG:
-            gate::sqrtXdag(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::sqrtXdag(qubits[0])); };
         case constants::SY:
-            gate::sqrtY(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::sqrtY(qubits[0])); };
         case constants::SYDG:
-            gate::sqrtYdag(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::sqrtYdag(qubits[0])); };
         case constants::P0:
-            gate::P0(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::P0(qubits[0])); };
         case constants::P1:
-            gate::P1(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case constants::U1: 
-        {
-            gate::U1(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::RX: 
-        {
-            gate::RX(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::RY: 
-        {
-            gate::RY(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::RZ: 
-        {
-            gate::RZ(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTINVX: 
-        {
-            gate::RotInvX(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTINVY: 
-        {
-            gate::RotInvY(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTINVZ: 
-        {
-            gate::RotInvZ(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTX: 
-        {
-            gate::RotX(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTY: 
-        {
-            gate::RotY(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::ROTZ: 
-        {
-            gate::RotZ(inst.qubits[0] + T.zero_qubit, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
-        case constants::U2: 
-        {
-            gate::U2(inst.qubits[0] + T.zero_qubit, inst.params[0], inst.params[1])->update_quantum_state(&state);
-            break;
-        }
-        case constants::U3: 
-        {
-            gate::U3(inst.qubits[0] + T.zero_qubit, inst.params[0], inst.params[1], inst.params[2])->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::P1(qubits[0])); };
+        case constants::U1:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::U1(qubits[0], inst.params[0])); };
+        case constants::RX:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RX(qubits[0], inst.params[0])); };
+        case constants::RY:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RY(qubits[0], inst.params[0])); };
+        case constants::RZ:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RZ(qubits[0], inst.params[0])); };
+        case constants::ROTINVX:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotInvX(qubits[0], inst.params[0])); };
+        case constants::ROTINVY:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotInvY(qubits[0], inst.params[0])); };
+        case constants::ROTINVZ:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotInvZ(qubits[0], inst.params[0])); };
+        case constants::ROTX:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotX(qubits[0], inst.params[0])); };
+        case constants::ROTY:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotY(qubits[0], inst.params[0])); };
+        case constants::ROTZ:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::RotZ(qubits[0], inst.params[0])); };
+        case constants::U2:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::U2(qubits[0], inst.params[0], inst.params[1])); };
+        case constants::U3:
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::U3(qubits[0], inst.params[0], inst.params[1], inst.params[2])); };
         case constants::CX:
-        {
-            std::vector<UINT> tmp_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            tmp_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    tmp_qubits[i] = inst.qubits[i] + T.zero_qubit;
-
-                }
-            }
-            gate::CNOT(tmp_qubits[0], tmp_qubits[1])->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::CNOT(qubits[0], qubits[1])); };
         case constants::CZ:
-        {
-            std::vector<UINT> tmp_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            tmp_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    tmp_qubits[i] = inst.qubits[i] + T.zero_qubit;
-
-                }
-            }
-            gate::CZ(tmp_qubits[0], tmp_qubits[1])->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::CZ(qubits[0], qubits[1])); };
         case constants::ECR:
-        {
-            gate::ECR(inst.qubits[0] + T.zero_qubit, inst.qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::ECR(qubits[0], qubits[1])); };
         case constants::SWAP:
-        {
-            gate::SWAP(inst.qubits[0] + T.zero_qubit, inst.qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction&, std::span<const int> qubits) { b.apply(gate::SWAP(qubits[0], qubits[1])); };
         case constants::FUSEDSWAP:
-        {
-            gate::FusedSWAP(inst.qubits[0] + T.zero_qubit, inst.qubits[1] + T.zero_qubit, inst.block_size[0])->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::FusedSWAP(qubits[0], qubits[1], inst.block_size[0])); };
         case constants::MULTIPAULI:
-        {
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (int i = 0; i < inst.qubits.size(); i++) {
-                unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-            }
-            gate::Pauli(unsigned_qubits, inst.pauli_id_list)->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::Pauli(qulacs_qubits(qubits), inst.pauli_id_list)); };
         case constants::MULTIPAULIROTATION:
-        {
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (int i = 0; i < inst.qubits.size(); i++) {
-                unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-            }
-            gate::PauliRotation(unsigned_qubits, inst.pauli_id_list, inst.params[0])->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::PauliRotation(qulacs_qubits(qubits), inst.pauli_id_list, inst.params[0])); };
         case constants::UNITARY:
-        {
-            ComplexMatrix qulacs_matrix = sim::cunqamatrix_to_qulacsdensematrix(inst.matrix[0]);
-
-            if (inst.qubits.size() > 1) {
-                std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-                for (size_t i = 0; i < inst.qubits.size(); i++) {
-                    if (inst.qubits[i] < 0) {
-                        for (auto& index : comm_indices) {
-                            if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                                unsigned_qubits[i] = G.communication_pairs[index].q1;
-                                break;
-                            }
-                        }
-                    } else {
-                        unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                    }
-                }
-                gate::DenseMatrix(unsigned_qubits, qulacs_matrix)->update_quantum_state(&state);
-            } else {
-                gate::DenseMatrix(inst.qubits[0] + T.zero_qubit, qulacs_matrix)->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                const ComplexMatrix& qulacs_matrix = b.matrices.dense.at(inst);
+                if (qubits.size() > 1)
+                    b.apply(gate::DenseMatrix(qulacs_qubits(qubits), qulacs_matrix));
+                else
+                    b.apply(gate::DenseMatrix(qubits[0], qulacs_matrix));
+            };
         case constants::CUNITARY:
-        {
-            ComplexMatrix qulacs_matrix = sim::cunqamatrix_to_qulacsdensematrix(inst.matrix[0]);
-
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                std::vector<TargetQubitInfo> target_qubits;
+                for (size_t i = 1; i < qubits.size(); i++) {
+                    target_qubits.emplace_back(qubits[i], 0);
                 }
-            }
 
-            std::vector<TargetQubitInfo> target_qubits;
-            for (size_t i = 1; i < unsigned_qubits.size(); i++) {
-                target_qubits.emplace_back(unsigned_qubits[i], 0);
-            }
+                std::vector<ControlQubitInfo> control_qubits = {
+                    ControlQubitInfo(qubits[0], 1)  // control value = 1
+                };
 
-            std::vector<ControlQubitInfo> control_qubits = {
-                ControlQubitInfo(unsigned_qubits[0], 1)  // control value = 1
+                b.apply(new QuantumGateMatrix(target_qubits, b.matrices.dense.at(inst), control_qubits));
             };
-
-            auto gate = new QuantumGateMatrix(target_qubits, &qulacs_matrix, control_qubits);
-            gate->update_quantum_state(&state);
-            delete gate;
-            break;
-}
         case constants::SPARSEMATRIX:
-        {
-            SparseComplexMatrix qulacs_sparse = sim::cunqamatrix_to_sparse(inst.matrix[0]);
-
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (int i = 0; i < inst.qubits.size(); i++) {
-                unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-            }
-            gate::SparseMatrix(unsigned_qubits, qulacs_sparse)->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::SparseMatrix(qulacs_qubits(qubits), b.matrices.sparse.at(inst))); };
         case constants::DIAGONAL:
-        {   
-            ComplexVector qulacs_diagonal = sim::cunqadiagonal_to_qulacsdiagonal(inst.diagonal[0]);
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (size_t i = 0; i < inst.qubits.size(); i++) {
-                if (inst.qubits[i] < 0) {
-                    for (auto& index : comm_indices) {
-                        if (!G.communication_pairs[index].idle && G.communication_pairs[index].label == inst.qubits[i]) {
-                            unsigned_qubits[i] = G.communication_pairs[index].q1;
-                            break;
-                        }
-                    }
-                } else {
-                    unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-                }
-            }
-
-            gate::DiagonalMatrix(unsigned_qubits, qulacs_diagonal)->update_quantum_state(&state);
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) { b.apply(gate::DiagonalMatrix(qulacs_qubits(qubits), b.matrices.diagonals.at(inst))); };
         case constants::RANDOMUNITARY:
-        {
-            std::vector<unsigned int> unsigned_qubits(inst.qubits.size());
-            for (int i = 0; i < inst.qubits.size(); i++) {
-                unsigned_qubits[i] = inst.qubits[i] + T.zero_qubit;
-            }
-            if (inst.seed != 0) {
-                gate::RandomUnitary(unsigned_qubits, inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::RandomUnitary(unsigned_qubits)->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::RandomUnitary(qulacs_qubits(qubits), inst.seed));
+                else
+                    b.apply(gate::RandomUnitary(qulacs_qubits(qubits)));
+            };
         case constants::BITFLIPNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::BitFlipNoise(inst.qubits[0], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::BitFlipNoise(inst.qubits[0], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::BitFlipNoise(qubits[0], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::BitFlipNoise(qubits[0], inst.params[0]));
+            };
         case constants::DEPHASINGNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::DephasingNoise(inst.qubits[0], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::DephasingNoise(inst.qubits[0], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::DephasingNoise(qubits[0], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::DephasingNoise(qubits[0], inst.params[0]));
+            };
         case constants::INDEPENDENTXZNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::IndependentXZNoise(inst.qubits[0], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::IndependentXZNoise(inst.qubits[0], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::IndependentXZNoise(qubits[0], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::IndependentXZNoise(qubits[0], inst.params[0]));
+            };
         case constants::DEPOLARIZINGNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::DepolarizingNoise(inst.qubits[0], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::DepolarizingNoise(inst.qubits[0], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::DepolarizingNoise(qubits[0], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::DepolarizingNoise(qubits[0], inst.params[0]));
+            };
         case constants::TWOQUBITDEPOLARIZINGNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::TwoQubitDepolarizingNoise(inst.qubits[0], inst.qubits[1], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::TwoQubitDepolarizingNoise(inst.qubits[0], inst.qubits[1], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], inst.params[0]));
+            };
         case constants::AMPLITUDEDAMPINGNOISE:
-        {
-            if (inst.seed != 0) {
-                gate::AmplitudeDampingNoise(inst.qubits[0], inst.params[0], inst.seed)->update_quantum_state(&state);
-            } else {
-                gate::AmplitudeDampingNoise(inst.qubits[0], inst.params[0])->update_quantum_state(&state);
-            }
-            break;
-        }
-        case constants::SEND:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[inst.qpus[0]].id
-                };  
-                for (auto& clbit : inst.clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
-                }
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    classical_channel->send_measure(G.creg[clbit + T.zero_clbit], inst.qpus[0]);
-                }
-            }
-            break;
-        }
-        case constants::RECV:
-        {
-            if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[inst.qpus[0]].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
-                    for (const auto& clbit: inst.clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
-                    }
-                    T.blocked_by_cc = false;
-                } else {
-                    T.blocked_by_cc = true;
-                }
-            } else {
-                for (const auto& clbit: inst.clbits) {
-                    int measurement = classical_channel->recv_measure(inst.qpus[0]);
-                    G.creg[clbit + T.zero_clbit] = (measurement == 1);
-                }
-            }
-            break;
-        }
-        case constants::CIF:
-        {   
-            bool init = (static_cast<bool>(inst.condition)) ? G.creg[inst.clbits[0] + T.zero_clbit] : !G.creg[inst.clbits[0] + T.zero_clbit];
-            // Operates on the values provided, with the specified operation.
-            // If there is only one value, sum = G.creg[inst.clbits[0] + T.zero_clbit]
-            bool result = std::accumulate(inst.clbits.begin() + 1, inst.clbits.end(), 
-                           init,
-                           [&](bool acc, int clbit) { 
-                               return constants::cif_ops[inst.operation](acc, G.creg[clbit + T.zero_clbit]); 
-                           });
-            result = (static_cast<bool>(inst.condition)) ? result : !result;
-
-            if (static_cast<bool>(inst.condition) == result) {
-                for(const auto& sub_inst: inst.instructions) {
-                    apply_next_instr(T, sub_inst, {});
-                }
-            }
-            break;
+            return [](QulacsBackend& b, const CUNQAInstruction& inst, std::span<const int> qubits) {
+                if (inst.seed != 0)
+                    b.apply(gate::AmplitudeDampingNoise(qubits[0], inst.params[0], inst.seed));
+                else
+                    b.apply(gate::AmplitudeDampingNoise(qubits[0], inst.params[0]));
+            };
+        default:
+            return nullptr;
         }
-        case constants::QSEND:
-        {
-            std::vector<int> indices = generate_entanglement_(1);
-            if (indices.empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-            T.blocked_by_teledata = false;
-            int index = indices[0];
-            G.communication_pairs[index].qcomm_protocol = "teledata";
-
-            // CX to the entangled pair
-            gate::CNOT(inst.qubits[0] + T.zero_qubit, G.communication_pairs[index].q0)->update_quantum_state(&state);
+    }
+};
 
-            // H to the sent qubit
-            gate::H(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
+// Part of a circuit simulated by branching the shots at its measurements
+struct BranchStep {
+    int type; // MEASURE, CIF, or ID for a segment of deterministic gates
+    CUNQAInstruction instruction; // Measurement or c_if
+    std::vector<StructuredQuantumTask> segment; // Gates of the segment or of the c_if
+};
 
-            UINT result = measure_adapter(state, inst.qubits[0] + T.zero_qubit);
+// Splits a circuit in BranchSteps. Returns nullopt if it has instructions other than gates, 
+// measurements and c_ifs of gates, which need the shot by shot simulation
+std::optional<std::vector<BranchStep>> branch_steps(const StructuredQuantumTask& st_qtask)
+{
+    std::vector<BranchStep> steps;
+    auto segment_step = [&st_qtask](int type, std::vector<CUNQAInstruction> instructions) {
+        return BranchStep{type, {}, {{
+            .id = st_qtask.id, 
+            .n_qubits = st_qtask.n_qubits, 
+            .n_clbits = st_qtask.n_clbits, 
+            .instructions = std::move(instructions)
+        }}};
+    };
 
-            G.qc_meas_td[T.id].push(result);
-            G.qc_meas_td[T.id].push(measure_adapter(state, G.communication_pairs[index].q0));
+    std::vector<CUNQAInstruction> gates;
+    for (const auto& instruction : st_qtask.instructions) {
+        if (is_deterministic(instruction.type)) {
+            gates.push_back(instruction);
+            continue;
+        }
+        if (!gates.empty()) {
+            steps.push_back(segment_step(constants::ID, std::move(gates)));
+            gates.clear();
+        }
+
+        if (instruction.type == constants::MEASURE) {
+            steps.push_back(BranchStep{constants::MEASURE, instruction, {}});
+        } else if (instruction.type == constants::CIF) {
+            bool only_gates = std::all_of(instruction.instructions.begin(), instruction.instructions.end(), 
+                [](const CUNQAInstruction& sub_inst) { return is_deterministic(sub_inst.type); });
+            if (!only_gates)
+                return std::nullopt;
+            steps.push_back(segment_step(constants::CIF, instruction.instructions));
+            steps.back().instruction = instruction;
+        } else {
+            return std::nullopt;
+        }
+    }
+    if (!gates.empty())
+        steps.push_back(segment_step(constants::ID, std::move(gates)));
 
-            if (result) {
-                gate::X(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            }
+    return steps;
+}
 
-            // Unlock QRECV
-            Ts[inst.qpus[0]].blocked_by_teledata = false;
+void project_(QuantumState& state, const UINT qubit, const bool outcome, const double probability)
+{
+    std::unique_ptr<QuantumGateBase> projector(outcome ? gate::P1(qubit) : gate::P0(qubit));
+    projector->update_quantum_state(&state);
+    state.normalize(probability);
+}
 
-            // Update communication pair
-            G.communication_pairs[index].sendr_qpu = T.id;
-            G.communication_pairs[index].recvr_qpu = inst.qpus[0];
+// Runs all the shots together, splitting them at each measurement according to the probability
+// of each outcome, so the gates are applied once per branch instead of once per shot. Branches
+// are run depth first to keep alive at most one pending state per measurement.
+void execute_branching_(
+    sim::MeasCounter& meas_counter,
+    std::vector<BranchStep>& steps, 
+    const StructuredQuantumTask& st_qtask, 
+    const std::size_t shots, 
+    std::mt19937_64& rng
+)
+{
+    struct Branch {
+        std::unique_ptr<QuantumState> state;
+        sim::ClassicalRegister creg;
+        std::size_t shots;
+        std::size_t step;
+    };
 
-            break;
+    // The trailing measurements are sampled at once from the final state of each branch
+    std::size_t terminal = steps.size();
+    while (terminal > 0 && steps[terminal - 1].type == constants::MEASURE)
+        terminal--;
+
+    // The segments of gates are run by every branch, so their engines are built once
+    std::vector<sim::DynamicEngine<QulacsBackend>> engines;
+    QulacsMatrices matrices;
+    engines.reserve(steps.size());
+    for (auto& step : steps) {
+        engines.emplace_back(step.segment, 0);
+        matrices.add(step.segment);
+    }
+    sim::DynamicEngine<QulacsBackend>::Shot shot;
+    const ShotRng segment_rng(rng(), 0); // The segments do not measure
+
+    std::vector<Branch> pending;
+    pending.push_back({std::make_unique<QuantumState>(st_qtask.n_qubits), {}, shots, 0});
+    while (!pending.empty()) {
+        Branch branch = std::move(pending.back());
+        pending.pop_back();
+
+        for (; branch.step < terminal; branch.step++) {
+            auto& step = steps[branch.step];
+            if (step.type == constants::MEASURE) {
+                UINT qubit = step.instruction.qubits[0];
+                std::size_t clbit = step.instruction.clbits[0];
+                double p0 = std::clamp(branch.state->get_zero_probability(qubit), 0.0, 1.0);
+                std::size_t shots0 = std::binomial_distribution<std::size_t>(branch.shots, p0)(rng);
+
+                if (shots0 > 0 && shots0 < branch.shots) {
+                    Branch branch1{std::unique_ptr<QuantumState>(branch.state->copy()), branch.creg, branch.shots - shots0, branch.step + 1};
+                    project_(*branch1.state, qubit, true, 1.0 - p0);
+                    branch1.creg[clbit] = true;
+                    pending.push_back(std::move(branch1));
+                    branch.shots = shots0;
+                }
+                bool outcome = shots0 == 0;
+                project_(*branch.state, qubit, outcome, outcome ? 1.0 - p0 : p0);
+                branch.creg[clbit] = outcome;
+            } else if (step.type != constants::CIF || sim::cif_holds(step.instruction, branch.creg)) {
+                QulacsBackend backend{*branch.state, segment_rng, matrices};
+                engines[branch.step].run(backend, shot, nullptr, false);
+            }
+        }
+
+        if (terminal == steps.size()) {
+            meas_counter.add(branch.creg, branch.shots);
+            continue;
+        }
+        // Bit i of the sampled outcomes is the i-th trailing measurement, or the whole register
+        // if they do not fit in the 64 bits of an outcome
+        const bool marginal = steps.size() - terminal <= 64;
+        std::vector<std::pair<std::uint64_t, std::size_t>> measures;
+        for (std::size_t i = terminal; i < steps.size(); i++)
+            measures.emplace_back(steps[i].instruction.qubits[0], i - terminal);
+        const auto* amplitudes = branch.state->data_cpp();
+        auto probability = [amplitudes](const std::uint64_t i) { return std::norm(amplitudes[i]); };
+        const auto histogram = marginal ? sample_measured(branch.state->dim, probability, measures, branch.shots, rng())
+                                        : sample_histogram(branch.state->dim, probability, branch.shots, rng());
+        for (const auto& [sample, count] : histogram) {
+            auto creg = branch.creg;
+            for (const auto& [qubit, i] : measures)
+                creg[steps[terminal + i].instruction.clbits[0]] = (sample >> (marginal ? i : qubit)) & 1;
+            meas_counter.add(creg, count);
         }
-        case constants::QRECV:
-        {
-            if (!G.qc_meas_td.contains(inst.qpus[0]) || G.qc_meas_td[inst.qpus[0]].empty()) {
-                T.blocked_by_teledata = true;
-                return;
-            }
-
-            // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-            std::size_t meas2 = G.qc_meas_td[inst.qpus[0]].front();
-            G.qc_meas_td[inst.qpus[0]].pop();
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "teledata", 1);
-            int index = indices[0];
-
-            // Apply, conditioned to the measurement, the X and Z gates
-            if (meas1) {
-                gate::X(G.communication_pairs[index].q1)->update_quantum_state(&state);
-            }
-            if (meas2) {
-                gate::Z(G.communication_pairs[index].q1)->update_quantum_state(&state);
-            }
+    }
+}
 
-            // Swap the value to the desired qubit
-            gate::SWAP(G.communication_pairs[index].q1, inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
+sim::QulacsCachedCircuit build_cached_circuit(const JSON& circuit_json, const size_t n_qubits)
+{
+    sim::QulacsCachedCircuit cached{std::make_unique<QuantumCircuit>(n_qubits), {}};
+    for (std::size_t i = 0; i < circuit_json.size(); i++) {
+        const auto& instruction = circuit_json[i];
+        UINT gate_index = cached.circuit->gate_list.size();
+        sim::add_qulacs_instruction(*cached.circuit, instruction);
+
+        if (instruction.contains("params") && cached.circuit->gate_list.size() > gate_index)
+            cached.param_gates.push_back({i, gate_index, instruction.at("params").get<std::vector<double>>()});
+    }
+    return cached;
+}
 
-            G.communication_pairs[index].idle = true;
-            break;
-        }
-        case constants::EXPOSE:
-        {
-            if (!T.cat_entangled) {
-                std::vector<int> indices = generate_entanglement_(inst.qubits.size());
-                if (indices.empty()) {
-                    T.blocked_by_telegate = true;
-                    return;
-                }
+// Replaces the gates whose parameters changed. False if any of them cannot be rebuilt alone
+bool patch_cached_circuit(sim::QulacsCachedCircuit& cached, const JSON& circuit_json)
+{
+    for (auto& param_gate : cached.param_gates) {
+        const auto& instruction = circuit_json[param_gate.instruction];
+        auto params = instruction.at("params").get<std::vector<double>>();
+        if (params == param_gate.params)
+            continue;
+
+        auto gate = sim::qulacs_parametric_gate(instruction);
+        if (gate == nullptr)
+            return false;
+        cached.circuit->remove_gate(param_gate.gate);
+        cached.circuit->add_gate(gate, param_gate.gate);
+        param_gate.params = std::move(params);
+    }
+    return true;
+}
 
-                int qid = 0;
-                for (auto& index : indices) {
-                    G.communication_pairs[index].qcomm_protocol = "telegate";
-                    G.communication_pairs[index].label = -(qid + 1);
+QuantumCircuit& cached_circuit(sim::QulacsCircuitCache& circuit_cache, const QuantumTask& quantum_task, const size_t n_qubits)
+{
+    auto structure = sim::structure_hash(quantum_task.circuit, n_qubits);
+    auto cached = circuit_cache.find(quantum_task.id, structure);
+    if (cached != nullptr && patch_cached_circuit(*cached, quantum_task.circuit))
+        return *cached->circuit;
+
+    LOGGER_DEBUG("Building the Qulacs circuit {} for the cache.", quantum_task.id);
+    return *circuit_cache.insert(quantum_task.id, structure, quantum_task.circuit.size(), 
+                                 build_cached_circuit(quantum_task.circuit, n_qubits)).circuit;
+}
 
-                    // CX to the entangled pair
-                    gate::CNOT(inst.qubits[qid] + T.zero_qubit, G.communication_pairs[index].q0)->update_quantum_state(&state);
+// Noise instruction of a static circuit, whose Kraus branch is drawn in each trajectory
+struct NoiseChannel {
+    int type;
+    std::vector<UINT> qubits;
+    double probability;
+};
 
-                    UINT result = measure_adapter(state, G.communication_pairs[index].q0);
+// Static circuit with noise, as the Qulacs circuits of the gates between its noise instructions.
+// segments[i] runs before channels[i], and the last segment after the last channel
+struct NoisyProgram {
+    std::vector<std::unique_ptr<QuantumCircuit>> segments;
+    std::vector<NoiseChannel> channels;
+};
 
-                    G.qc_meas_tg[T.id].push(result);
-                    T.cat_entangled = true;
-                    T.blocked_by_telegate = true;
-                    Ts[inst.qpus[0]].blocked_by_telegate = false;
+bool is_noise(const int type)
+{
+    switch (type) {
+        case constants::AMPLITUDEDAMPINGNOISE:
+        case constants::BITFLIPNOISE:
+        case constants::DEPHASINGNOISE:
+        case constants::DEPOLARIZINGNOISE:
+        case constants::INDEPENDENTXZNOISE:
+        case constants::TWOQUBITDEPOLARIZINGNOISE:
+            return true;
+        default:
+            return false;
+    }
+}
 
-                    // Update communication pair
-                    G.communication_pairs[index].sendr_qpu = T.id;
-                    G.communication_pairs[index].recvr_qpu = inst.qpus[0];
+bool has_noise(const std::vector<JSON>& circuit)
+{
+    return std::any_of(circuit.begin(), circuit.end(), [](const JSON& instruction) {
+        const auto it = INSTRUCTIONS_MAP.find(instruction.at("name").get<std::string>());
+        return it != INSTRUCTIONS_MAP.end() && is_noise(it->second);
+    });
+}
 
-                    qid++;
-                }
-                return;
-            } else {
-                for (int i = 0; i < inst.qubits.size(); i++) {
-                    UINT meas = G.qc_meas_tg[inst.qpus[0]].front();
-                    G.qc_meas_tg[inst.qpus[0]].pop();
-
-                    if (meas) {
-                        gate::Z(inst.qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-                    }
-                }
+NoisyProgram noisy_program(const std::vector<JSON>& circuit, const std::size_t n_qubits)
+{
+    NoisyProgram program;
+    program.segments.push_back(std::make_unique<QuantumCircuit>(n_qubits));
+    for (const auto& instruction : circuit) {
+        const int type = INSTRUCTIONS_MAP.at(instruction.at("name").get<std::string>());
+        if (!is_noise(type)) {
+            sim::add_qulacs_instruction(*program.segments.back(), instruction);
+            continue;
+        }
+        program.channels.push_back({type, instruction.at("qubits").get<std::vector<UINT>>(), instruction.at("params")[0].get<double>()});
+        program.segments.push_back(std::make_unique<QuantumCircuit>(n_qubits));
+    }
+    return program;
+}
 
-                T.cat_entangled = false;
+void apply_pauli_(QuantumState& state, const UINT qubit, const int pauli)
+{
+    std::unique_ptr<QuantumGateBase> gate;
+    switch (pauli) {
+        case 1: gate.reset(gate::X(qubit)); break;
+        case 2: gate.reset(gate::Y(qubit)); break;
+        case 3: gate.reset(gate::Z(qubit)); break;
+        default: return;
+    }
+    gate->update_quantum_state(&state);
+}
 
-                std::vector<int> indices = find_my_communication_pairs(G, T.id, inst.qpus[0], "telegate", inst.qubits.size());
-                for (auto& index : indices) {
-                    G.communication_pairs[index].idle = true;
-                }
+// Applies the Kraus operator of the channel drawn for this trajectory. The Pauli channels are
+// drawn without looking at the state, and most draws are the identity, which costs nothing; only
+// the amplitude damping reads the probability of its qubit to weigh its two branches
+void apply_noise_(QuantumState& state, const NoiseChannel& channel, sim::ShotRng& rng)
+{
+    const double p = channel.probability;
+    const double u = rng.uniform();
+    switch (channel.type) {
+        case constants::BITFLIPNOISE:
+            if (u < p)
+                apply_pauli_(state, channel.qubits[0], 1);
+            break;
+        case constants::DEPHASINGNOISE:
+            if (u < p)
+                apply_pauli_(state, channel.qubits[0], 3);
+            break;
+        case constants::INDEPENDENTXZNOISE:
+            if (u < p)
+                apply_pauli_(state, channel.qubits[0], 1);
+            if (rng.uniform() < p)
+                apply_pauli_(state, channel.qubits[0], 3);
+            break;
+        case constants::DEPOLARIZINGNOISE:
+            if (u < p)
+                apply_pauli_(state, channel.qubits[0], 1 + std::min(2, static_cast<int>(u / p * 3)));
+            break;
+        case constants::TWOQUBITDEPOLARIZINGNOISE:
+            if (u < p) {
+                // One of the 15 Pauli pairs other than the identity
+                const int pair = 1 + std::min(14, static_cast<int>(u / p * 15));
+                apply_pauli_(state, channel.qubits[0], pair % 4);
+                apply_pauli_(state, channel.qubits[1], pair / 4);
             }
             break;
-        }
-        case constants::RCONTROL:
+        case constants::AMPLITUDEDAMPINGNOISE:
         {
-            if (!G.qc_meas_tg.contains(inst.qpus[0]) || G.qc_meas_tg[inst.qpus[0]].empty()) {
-                T.blocked_by_telegate = true;
-                return;
-            }
-            if (T.blocked_by_telegate) return;
-
-            std::vector<int> indices = find_my_communication_pairs(G, inst.qpus[0], T.id, "telegate");
-
-            for (auto& index : indices) {
-                UINT meas2 = G.qc_meas_tg[inst.qpus[0]].front();
-                G.qc_meas_tg[inst.qpus[0]].pop();
-
-                if (meas2) {
-                    gate::X(G.communication_pairs[index].q1)->update_quantum_state(&state);
-                }
-            }
-
-            for(const auto& sub_inst: inst.instructions) {
-                apply_next_instr(T, sub_inst, indices);
-            }
-
-            for (auto& index : indices) {
-                gate::H(G.communication_pairs[index].q1)->update_quantum_state(&state);
-
-                UINT result = measure_adapter(state, G.communication_pairs[index].q1);
-                G.qc_meas_tg[T.id].push(result);
-            }
-
-            Ts[inst.qpus[0]].blocked_by_telegate = false;
-            T.blocked_by_telegate = false;
+            const double decay = p * (1.0 - state.get_zero_probability(channel.qubits[0]));
+            ComplexMatrix kraus(2, 2);
+            if (u < decay)
+                kraus << 0.0, std::sqrt(p), 0.0, 0.0;
+            else
+                kraus << 1.0, 0.0, 0.0, std::sqrt(1 - p);
+            std::unique_ptr<QuantumGateBase>(gate::DenseMatrix(channel.qubits[0], kraus))->update_quantum_state(&state);
+            state.normalize(u < decay ? decay : 1.0 - decay);
             break;
         }
-        default:
-            std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.name << "\n";
-        } // End switch
-    };
+    }
+}
+
+// Monte Carlo trajectories of a static circuit with noise instructions: each one draws a Kraus
+// branch at every noise instruction and samples its share of the shots from its final state, and
+// their histograms are merged. The "trajectories" of the config, by default one per shot as in a
+// shot by shot simulation, are split among the threads with a state each, and the gates before
+// the first noise instruction are applied once for all of them
+JSON simulate_trajectories(const QuantumTask& quantum_task)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+    const std::size_t n_qubits = quantum_task.config.at("num_qubits").get<std::size_t>();
+    const std::size_t shots = quantum_task.config.at("shots").get<std::size_t>();
+    const std::size_t n_trajectories = std::clamp<std::size_t>(quantum_task.config.value("trajectories", shots), 1, std::max<std::size_t>(shots, 1));
+    const std::uint64_t seed = sim::simulation_seed(quantum_task.config);
+    const auto measures = sim::measured_bits(quantum_task.circuit);
+    LOGGER_DEBUG("Simulating circuit {} with noise as {} trajectories", quantum_task.id, n_trajectories);
+
+    QuantumState prefix(n_qubits);
+    {
+        ScopedStage simulate("simulate");
+        noisy_program(quantum_task.circuit, n_qubits).segments[0]->update_quantum_state(&prefix);
+    }
 
-    while (!G.ended)
+    std::map<std::uint64_t, std::size_t> merged;
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        ScopedStage simulate("simulate");
+        #pragma omp parallel if(sim::parallelize_shots(quantum_task.config, n_qubits, n_trajectories))
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, std::nullopt, {});
-
-            if (!(T.blocked_by_teledata || T.blocked_by_telegate || T.blocked_by_cc))
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
-                T.finished = true;
-        }
-
-    } // End one shot
+            // Built by each thread, so that no Qulacs gate is shared among them
+            const NoisyProgram program = noisy_program(quantum_task.circuit, n_qubits);
+            QuantumState state(n_qubits);
+            std::map<std::uint64_t, std::size_t> local;
+
+            #pragma omp for schedule(dynamic)
+            for (std::size_t t = 0; t < n_trajectories; t++) {
+                sim::ShotRng rng(seed, t);
+                state.load(&prefix);
+                for (std::size_t i = 0; i < program.channels.size(); i++) {
+                    apply_noise_(state, program.channels[i], rng);
+                    program.segments[i + 1]->update_quantum_state(&state);
+                }
 
-    std::unordered_map<std::string, std::string> shot_bits;
-    for (auto& [id, T]: Ts) {
-        std::string bitstring(T.local_n_clbits, '0');
-        for (const auto &[bitIndex, value] : G.creg) {
-            if (T.zero_clbit <= bitIndex && bitIndex < (T.zero_clbit + T.local_n_clbits)) {
-                bitstring[T.local_n_clbits + T.zero_clbit - bitIndex - 1] = value ? '1' : '0';
+                const std::size_t trajectory_shots = shots / n_trajectories + (t < shots % n_trajectories ? 1 : 0);
+                const auto* amplitudes = state.data_cpp();
+                auto probability = [amplitudes](const std::uint64_t i) { return std::norm(amplitudes[i]); };
+                const auto histogram = measures.empty() ? sim::sample_histogram(state.dim, probability, trajectory_shots, rng())
+                                                        : sim::sample_measured(state.dim, probability, measures, trajectory_shots, rng());
+                for (const auto& [outcome, count] : histogram)
+                    local[outcome] += count;
             }
+
+            #pragma omp critical
+            for (const auto& [outcome, count] : local)
+                merged[outcome] += count;
         }
-        shot_bits[id] = bitstring;
     }
 
-    return shot_bits;
-}
-
-void update_meas_counter(std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>& meas_counter, const std::unordered_map<std::string, std::string>& shot_bitstrings)
-{
-    for (const auto& [circ_id, bitstring] : shot_bitstrings) {
-        meas_counter[circ_id][bitstring]++;
-    }
+    std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+    const sim::Histogram histogram(merged.begin(), merged.end());
+    return {
+        {"counts", sim::histogram_to_counts(histogram, measures.empty() ? n_qubits : quantum_task.config.at("num_clbits").get<std::size_t>())},
+        {"time_taken", duration.count()}
+    };
 }
 
 } // End of anonymous namespace
@@ -830,29 +643,56 @@ void update_meas_counter(std::unordered_map<std::string, std::unordered_map<std:
 namespace cunqa {
 namespace sim {
 
-JSON QulacsSimulatorAdapter::simulate(const Backend* backend)
+JSON QulacsSimulatorAdapter::simulate(const Backend* backend, QulacsCircuitCache* circuit_cache)
 {
     LOGGER_DEBUG("Qulacs usual simulation");
     try {
-        auto quantum_task = qc.quantum_tasks[0];
+        const auto& quantum_task = qc.quantum_tasks[0];
+
+        // Each shot may take a different branch of the noise, so the state is not sampled once
+        if (has_noise(quantum_task.circuit))
+            return simulate_trajectories(quantum_task);
 
         size_t n_qubits = quantum_task.config.at("num_qubits").get<size_t>();
         auto shots = qc.quantum_tasks[0].config.at("shots").get<size_t>();
-        JSON circuit_json = quantum_task.circuit;
-
-        QuantumCircuit circuit(n_qubits);
-        update_qulacs_circuit(circuit, circuit_json);
 
         QuantumState state(n_qubits);
-        circuit.update_quantum_state(&state);
+        if (circuit_cache != nullptr) {
+            QuantumCircuit* circuit;
+            {
+                ScopedStage translate("translate");
+                circuit = &cached_circuit(*circuit_cache, quantum_task, n_qubits);
+            }
+            ScopedStage simulate("simulate");
+            circuit->update_quantum_state(&state);
+        } else {
+            QuantumCircuit circuit(n_qubits);
+            {
+                ScopedStage translate("translate");
+                update_qulacs_circuit(circuit, quantum_task.circuit);
+            }
+            ScopedStage simulate("simulate");
+            circuit.update_quantum_state(&state);
+        }
 
+        // Drawn straight into a histogram, without a sample per shot, of the measured qubits if
+        // the circuit measures, or else of the whole register
+        const auto measures = measured_bits(quantum_task.circuit);
+        Histogram histogram;
         auto start = std::chrono::high_resolution_clock::now();
-        std::vector<ITYPE> samples = state.sampling(shots);
+        {
+            ScopedStage simulate("simulate");
+            const auto* amplitudes = state.data_cpp();
+            auto probability = [amplitudes](const std::uint64_t i) { return std::norm(amplitudes[i]); };
+            const std::uint64_t seed = simulation_seed(quantum_task.config);
+            histogram = measures.empty() ? sample_histogram(state.dim, probability, shots, seed)
+                                         : sample_measured(state.dim, probability, measures, shots, seed);
+        }
         auto end = std::chrono::high_resolution_clock::now();
         std::chrono::duration<float> duration = end - start;
         float time_taken = duration.count();
 
-        JSON counts = convert_to_counts(samples, n_qubits);
+        JSON counts = histogram_to_counts(histogram, measures.empty() ? n_qubits : quantum_task.config.at("num_clbits").get<size_t>());
 
         JSON result_json = 
         {
@@ -874,7 +714,6 @@ JSON QulacsSimulatorAdapter::simulate(const Backend* backend)
 JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
 {
     LOGGER_DEBUG("Qulacs dynamic simulation");
-    std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>>  meas_counter;
     
     auto shots = qc.quantum_tasks[0].config.at("shots").get<std::size_t>();
 
@@ -882,58 +721,123 @@ JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     size_t n_qubits = 0;
     for (auto& quantum_task : qc.quantum_tasks) {
         st_qtasks.push_back(from_quantum_task_to_structuredqtask(quantum_task));
+        // Each run of diagonal gates becomes a DiagonalMatrix, a single pass over the state
+        if (quantum_task.config.value("merge_diagonals", true))
+            merge_diagonal_runs(st_qtasks.back());
         n_qubits += quantum_task.config.at("num_qubits").get<size_t>();
     }
+    MeasCounter meas_counter(st_qtasks);
 
-    size_t n_comm_qubits = 0;
-    if (qc.quantum_tasks.size() > 1) { // Quantum Communications 
-        if (qc.quantum_tasks[0].config.contains("n_communication_qubits")) {
-            n_comm_qubits = qc.quantum_tasks[0].config.at("n_communication_qubits").get<size_t>();
-            if (n_comm_qubits % 2 != 0) { // Ensure communication qubits always in pairs
-                n_comm_qubits++;
-            }
-        } else {
-            n_comm_qubits = 2;
-        }
-
-        n_qubits += n_comm_qubits;
-    }    
+    const size_t n_comm_qubits = n_communication_qubits(qc.quantum_tasks);
+    n_qubits += n_comm_qubits;    
 
+    const std::uint64_t seed = simulation_seed(qc.quantum_tasks[0].config);
+    const ShotConvergence convergence = ShotConvergence::from_config(qc.quantum_tasks[0].config, classical_channel != nullptr);
+    ShotProgress progress;
     auto start = std::chrono::high_resolution_clock::now();
+
+    bool shot_branching = !qc.quantum_tasks[0].config.contains("shot_branching") || 
+                          qc.quantum_tasks[0].config.at("shot_branching").get<bool>();
+    auto steps = (shot_branching && st_qtasks.size() == 1) ? branch_steps(st_qtasks[0]) : std::nullopt;
+    if (steps.has_value()) {
+        LOGGER_DEBUG("Simulating the shots of circuit {} by branching them at the measurements", st_qtasks[0].id);
+        std::mt19937_64 rng(seed);
+        execute_branching_(meas_counter, *steps, st_qtasks[0], shots, rng);
+
+        std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+        JSON result_json = {
+            {"id_counts", meas_counter},
+            {"time_taken", duration.count()}};
+        // The branches take all the shots at the cost of a few, which is reported as it is
+        if (convergence.enabled())
+            result_json["convergence"] = convergence.report(shots, meas_counter.max_standard_error(shots));
+        return result_json;
+    }
+
+    // The instructions before the first non deterministic one are the same in every shot, so they 
+    // are applied once and each shot starts from a copy of that state
+    bool snapshot_prefix = !qc.quantum_tasks[0].config.contains("snapshot_prefix") || 
+                           qc.quantum_tasks[0].config.at("snapshot_prefix").get<bool>();
+    bool from_prefix = snapshot_prefix && std::any_of(st_qtasks.begin(), st_qtasks.end(), 
+        [](const StructuredQuantumTask& st_qtask) { return st_qtask.deterministic_prefix > 0; });
+
+    std::unique_ptr<QuantumState> prefix_state;
+    if (from_prefix) {
+        // Every task is kept, even with an empty prefix, so that the qubits of each one do not move.
+        // Whether a task relabels its swaps depends on all its instructions, not only on the prefix
+        std::vector<StructuredQuantumTask> prefix_qtasks;
+        std::vector<bool> relabel_tasks;
+        for (const auto& st_qtask : st_qtasks) {
+            prefix_qtasks.push_back({
+                .id = st_qtask.id,
+                .n_qubits = st_qtask.n_qubits,
+                .n_clbits = st_qtask.n_clbits,
+                .instructions = {st_qtask.instructions.begin(), st_qtask.instructions.begin() + st_qtask.deterministic_prefix}
+            });
+            relabel_tasks.push_back(relabels_swaps(st_qtask.instructions));
+        }
+
+        LOGGER_DEBUG("Applying the deterministic prefix of the circuits once for all the shots");
+        prefix_state = std::make_unique<QuantumState>(n_qubits);
+        const DynamicEngine<QulacsBackend> prefix_engine(prefix_qtasks, n_comm_qubits, false, relabel_tasks);
+        const QulacsMatrices prefix_matrices(prefix_qtasks);
+        auto shot = prefix_engine.shot();
+        QulacsBackend backend{*prefix_state, ShotRng(seed, shots), prefix_matrices}; // The prefix does not measure
+        prefix_engine.run(backend, shot, classical_channel, allows_qc);
+    }
+    auto restart_state = [&](QuantumState& state) {
+        if (from_prefix)
+            state.load(prefix_state.get());
+        else
+            state.set_zero_state();
+    };
+    // Built once the tasks are in place, as they point into their instructions
+    const DynamicEngine<QulacsBackend> engine(st_qtasks, n_comm_qubits, from_prefix);
+    const QulacsMatrices matrices(st_qtasks);
+    std::size_t blocked_iterations = 0;
+
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
+    // Quantum communications, or a single circuit small enough to split its shots among the threads
+    if (size(qc.quantum_tasks) > 1 || parallelize_shots(qc.quantum_tasks[0].config, n_qubits, shots)) {
         #pragma omp parallel
         {
-            std::unordered_map<std::string, std::unordered_map<std::string, std::size_t>> local_counter;
-            
             QuantumState state(n_qubits);
+            restart_state(state);
 
-            #pragma omp for
-            for (std::size_t i = 0; i < shots; i++) {
-                update_meas_counter(local_counter, execute_shot_(state, st_qtasks, classical_channel, allows_qc,n_comm_qubits));
-                state.set_zero_state();
-            }
+            QulacsBackend backend{state, ShotRng(seed, 0), matrices};
+            auto shot = engine.shot();
+            convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+                backend.rng = ShotRng(seed, i);
+                counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+                restart_state(state);
+            });
 
             #pragma omp critical
-            for (const auto& [id, bitstrings_counter] : local_counter) {
-                for (const auto& [bitstring, counts] : bitstrings_counter) {
-                    meas_counter[id][bitstring] += counts;
-                } 
-            }
+            blocked_iterations += shot.blocked_iterations;
         }
     } else { // As if OPENMP_IN_QC not enabled
         QuantumState state(n_qubits);
-        for (std::size_t i = 0; i < shots; i++) {
-            update_meas_counter(meas_counter, execute_shot_(state, st_qtasks, classical_channel, allows_qc,n_comm_qubits));
-            state.set_zero_state();
-        } // End all shots
+        restart_state(state);
+        QulacsBackend backend{state, ShotRng(seed, 0), matrices};
+        auto shot = engine.shot();
+        convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+            backend.rng = ShotRng(seed, i);
+            counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+            restart_state(state);
+        });
+        blocked_iterations = shot.blocked_iterations;
     }
 #else
     QuantumState state(n_qubits);
-    for (std::size_t i = 0; i < shots; i++) {
-        update_meas_counter(meas_counter, execute_shot_(state, st_qtasks, classical_channel, allows_qc,n_comm_qubits));
-        state.set_zero_state();
-    } // End all shots
+    restart_state(state);
+    QulacsBackend backend{state, ShotRng(seed, 0), matrices};
+    auto shot = engine.shot();
+    convergence.run_blocks(st_qtasks, shots, meas_counter, progress, [&](const std::size_t i, MeasCounter& counter) {
+        backend.rng = ShotRng(seed, i);
+        counter.add(engine.run(backend, shot, classical_channel, allows_qc));
+        restart_state(state);
+    });
+    blocked_iterations = shot.blocked_iterations;
 #endif
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> duration = end - start;
@@ -942,6 +846,10 @@ JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     JSON result_json = {
         {"id_counts", meas_counter},
         {"time_taken", time_taken}};
+    if (n_comm_qubits != 0)
+        result_json["scheduler"] = {{"communication_qubits", n_comm_qubits}, {"blocked_iterations", blocked_iterations}};
+    if (convergence.enabled())
+        result_json["convergence"] = convergence.report(progress);
     return result_json;
 }
 
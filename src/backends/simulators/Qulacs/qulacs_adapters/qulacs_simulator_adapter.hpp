@@ -1,23 +1,41 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+
+#include "cppsim/circuit.hpp"
 
 #include "qulacs_computation_adapter.hpp"
 #include "quantum_task.hpp"
 #include "classical_channel/classical_channel.hpp"
 #include "backends/backend.hpp"
+#include "backends/simulators/circuit_cache.hpp"
 #include "utils/json.hpp"
 
 namespace cunqa {
 namespace sim {
 
+// Circuit kept between executions, with the position of its parametric gates to patch them
+struct QulacsCachedCircuit {
+    struct ParamGate {
+        std::size_t instruction;
+        UINT gate;
+        std::vector<double> params;
+    };
+
+    std::unique_ptr<QuantumCircuit> circuit;
+    std::vector<ParamGate> param_gates;
+};
+
+using QulacsCircuitCache = CircuitCache<QulacsCachedCircuit>;
+
 class QulacsSimulatorAdapter
 {
 public:
     QulacsSimulatorAdapter() = default;
-    QulacsSimulatorAdapter(QulacsComputationAdapter& qc) : qc{qc} {}
+    QulacsSimulatorAdapter(QulacsComputationAdapter qc) : qc{std::move(qc)} {}
 
-    JSON simulate(const Backend* backend);
+    JSON simulate(const Backend* backend, QulacsCircuitCache* circuit_cache = nullptr);
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
 
     QulacsComputationAdapter qc;
@@ -1,6 +1,7 @@
 #include "qulacs_cc_simulator.hpp"
 #include "qulacs_adapters/qulacs_computation_adapter.hpp"
 #include "qulacs_adapters/qulacs_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 using namespace std::string_literals;
 
@@ -16,13 +17,15 @@ QulacsCCSimulator::QulacsCCSimulator() :
 // Distributed QulacsSimulator
 JSON QulacsCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantum_task)
 {
-    for(const auto& qpu_id: quantum_task.sending_to)
-        classical_channel.connect(qpu_id);
+    comm::ClassicalChannel* channel = uses_classical_communications(quantum_task) ? &classical_channel : nullptr;
+
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, channel);
 
     QulacsComputationAdapter qulacs_ca(quantum_task);
-    QulacsSimulatorAdapter qulacs_sa(qulacs_ca);
+    QulacsSimulatorAdapter qulacs_sa(std::move(qulacs_ca));
     if (quantum_task.is_dynamic) {
-        JSON result = qulacs_sa.simulate(&classical_channel);
+        JSON result = qulacs_sa.simulate(channel);
         return {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
@@ -1,25 +1,39 @@
 #include "qulacs_simple_simulator.hpp"
 #include "qulacs_adapters/qulacs_computation_adapter.hpp"
 #include "qulacs_adapters/qulacs_simulator_adapter.hpp"
+#include "backends/simulators/stabilizer/stabilizer_simulator.hpp"
 
 namespace cunqa {
 namespace sim {
 
 JSON QulacsSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task) 
 {
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task);
+
     QulacsComputationAdapter qulacs_ca(quantum_task);
-    QulacsSimulatorAdapter qulacs_sa(qulacs_ca);
+    QulacsSimulatorAdapter qulacs_sa(std::move(qulacs_ca));
 
     if (quantum_task.is_dynamic) {
         JSON result = qulacs_sa.simulate();
-        return {
+        JSON simple_result = {
             {"counts", result.at("id_counts").at(quantum_task.id)},
             {"time_taken", result.at("time_taken")}
         };
+        if (result.contains("convergence"))
+            simple_result["convergence"] = result.at("convergence");
+        return simple_result;
     } else {
-        return qulacs_sa.simulate(&backend);
+        return qulacs_sa.simulate(&backend, &circuit_cache_);
     }
 }
 
+void QulacsSimpleSimulator::execute_into(const SimpleBackend& backend, const QuantumTask& quantum_task, ResultWriter& writer)
+{
+    if (runs_on_stabilizer(quantum_task))
+        return simulate_stabilizer(quantum_task, writer);
+    writer.write(execute(backend, quantum_task));
+}
+
 } // End namespace sim
 } // End namespace cunqa
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "quantum_task.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
+#include "qulacs_adapters/qulacs_simulator_adapter.hpp"
 
 #include "utils/json.hpp"
 #include "logger.hpp"
@@ -18,6 +19,10 @@ public:
 
     inline std::string get_name() const override {return "Qulacs";} 
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    void execute_into(const SimpleBackend& backend, const QuantumTask& circuit, ResultWriter& writer) override;
+
+private:
+    QulacsCircuitCache circuit_cache_; // Circuits of previous executions, patched on parameter updates
 };
 
 } // End of sim namespace
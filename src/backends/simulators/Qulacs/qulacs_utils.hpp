@@ -2,7 +2,6 @@
 
 #include <string>
 #include <vector>
-#include <bitset>
 
 #include "cppsim/circuit.hpp"
 #include "cppsim/gate_factory.hpp"
@@ -64,233 +63,258 @@ inline ComplexVector cunqadiagonal_to_qulacsdiagonal(const CUNQADiagonalMatrix&
 }
 
 
-inline void update_qulacs_circuit(QuantumCircuit& circuit, const JSON& circuit_json)
+inline void add_qulacs_instruction(QuantumCircuit& circuit, const JSON& instruction)
 {
-    for (const auto& instruction : circuit_json) {
-
-        auto inst_type = INSTRUCTIONS_MAP.at(instruction.at("name").get<std::string>());
-        std::vector<UINT> qubits = instruction.at("qubits").get<std::vector<UINT>>();
-
-        switch (inst_type)
-        {
-        case constants::MEASURE:
-            break;
-        case constants::X:
-            circuit.add_X_gate(qubits[0]);
-            break;
-        case constants::Y:
-            circuit.add_Y_gate(qubits[0]);
-            break;
-        case constants::Z:
-            circuit.add_Z_gate(qubits[0]);
-            break;
-        case constants::H:
-            circuit.add_H_gate(qubits[0]);
-            break;
-        case constants::S:
-            circuit.add_S_gate(qubits[0]);
-            break;
-        case constants::SDG:
-            circuit.add_Sdag_gate(qubits[0]);
-            break;
-        case constants::T:
-            circuit.add_T_gate(qubits[0]);
-            break;
-        case constants::TDG:
-            circuit.add_Tdag_gate(qubits[0]);
-            break;
-        case constants::SX:
-            circuit.add_sqrtX_gate(qubits[0]);
-            break;
-        case constants::SXDG:
-            circuit.add_sqrtXdag_gate(qubits[0]);
-            break;
-        case constants::SY:
-            circuit.add_sqrtY_gate(qubits[0]);
-            break;
-        case constants::SYDG:
-            circuit.add_sqrtYdag_gate(qubits[0]);
-            break;
-        case constants::P0:
-            circuit.add_P0_gate(qubits[0]);
-            break;
-        case constants::P1:
-            circuit.add_P1_gate(qubits[0]);
-            break;
-        case constants::U1: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_U1_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::RX: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RX_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::RY: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RY_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::RZ: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RZ_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTINVX: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotInvX_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTINVY: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotInvY_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTINVZ: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotInvZ_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTX: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotX_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTY: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotY_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::ROTZ: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_RotZ_gate(qubits[0], params[0]);
-            break;
-        }
-        case constants::U2: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_U2_gate(qubits[0], params[0], params[1]);
-            break;
-        }
-        case constants::U3: 
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            circuit.add_U3_gate(qubits[0], params[0], params[1], params[2]);
-            break;
-        }
-        case constants::CX:
-            circuit.add_CNOT_gate(qubits[0], qubits[1]);
-            break;
-        case constants::CZ:
-            circuit.add_CZ_gate(qubits[0], qubits[1]);
-            break;
-        case constants::ECR:
-            circuit.add_ECR_gate(qubits[0], qubits[1]);
-            break;
-        case constants::SWAP:
-            circuit.add_SWAP_gate(qubits[0], qubits[1]);
-            break;
-        case constants::FUSEDSWAP:
-        {
-            auto block_size = instruction.at("block_size").get<UINT>();
-            circuit.add_FusedSWAP_gate(qubits[0], qubits[1], block_size);
-            break;
-        }
-        case constants::MULTIPAULI:
-        {
-            auto pauli_id_list = instruction.at("pauli_id_list").get<std::vector<unsigned int>>();
-            circuit.add_multi_Pauli_gate(qubits, pauli_id_list);
-            break;
-        }
-        case constants::MULTIPAULIROTATION:
-        {
-            auto params = instruction.at("params").get<std::vector<double>>();
-            auto pauli_id_list = instruction.at("pauli_id_list").get<std::vector<unsigned int>>();
-            circuit.add_multi_Pauli_rotation_gate(qubits, pauli_id_list, params[0]);
-            break;
-        }
-        case constants::UNITARY:
-        {
-            auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
-            ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
-
-            if (qubits.size() > 1) {
-                circuit.add_dense_matrix_gate(qubits, qulacs_matrix);
-            } else {
-                circuit.add_dense_matrix_gate(qubits[0], qulacs_matrix);
-            }
-            break;
-        }
-        case constants::CUNITARY:
-        {
-            auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
-            ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
-
-            std::vector<TargetQubitInfo> target_qubits;
-            for (size_t i = 1; i < qubits.size(); i++) {
-                target_qubits.emplace_back(qubits[i], 0);
-            }
-
-            std::vector<ControlQubitInfo> control_qubits = {
-                ControlQubitInfo(qubits[0], 1)
-            };
-
-            auto gate = new QuantumGateMatrix(target_qubits, &qulacs_matrix, control_qubits);
-            circuit.add_gate(gate);
-            break;
+    auto inst_type = INSTRUCTIONS_MAP.at(instruction.at("name").get<std::string>());
+    std::vector<UINT> qubits = instruction.at("qubits").get<std::vector<UINT>>();
+
+    switch (inst_type)
+    {
+    case constants::MEASURE:
+        break;
+    case constants::X:
+        circuit.add_X_gate(qubits[0]);
+        break;
+    case constants::Y:
+        circuit.add_Y_gate(qubits[0]);
+        break;
+    case constants::Z:
+        circuit.add_Z_gate(qubits[0]);
+        break;
+    case constants::H:
+        circuit.add_H_gate(qubits[0]);
+        break;
+    case constants::S:
+        circuit.add_S_gate(qubits[0]);
+        break;
+    case constants::SDG:
+        circuit.add_Sdag_gate(qubits[0]);
+        break;
+    case constants::T:
+        circuit.add_T_gate(qubits[0]);
+        break;
+    case constants::TDG:
+        circuit.add_Tdag_gate(qubits[0]);
+        break;
+    case constants::SX:
+        circuit.add_sqrtX_gate(qubits[0]);
+        break;
+    case constants::SXDG:
+        circuit.add_sqrtXdag_gate(qubits[0]);
+        break;
+    case constants::SY:
+        circuit.add_sqrtY_gate(qubits[0]);
+        break;
+    case constants::SYDG:
+        circuit.add_sqrtYdag_gate(qubits[0]);
+        break;
+    case constants::P0:
+        circuit.add_P0_gate(qubits[0]);
+        break;
+    case constants::P1:
+        circuit.add_P1_gate(qubits[0]);
+        break;
+    case constants::U1: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_U1_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::RX: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RX_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::RY: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RY_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::RZ: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RZ_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTINVX: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotInvX_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTINVY: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotInvY_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTINVZ: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotInvZ_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTX: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotX_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTY: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotY_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::ROTZ: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_RotZ_gate(qubits[0], params[0]);
+        break;
+    }
+    case constants::U2: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_U2_gate(qubits[0], params[0], params[1]);
+        break;
+    }
+    case constants::U3: 
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        circuit.add_U3_gate(qubits[0], params[0], params[1], params[2]);
+        break;
+    }
+    case constants::CX:
+        circuit.add_CNOT_gate(qubits[0], qubits[1]);
+        break;
+    case constants::CZ:
+        circuit.add_CZ_gate(qubits[0], qubits[1]);
+        break;
+    case constants::ECR:
+        circuit.add_ECR_gate(qubits[0], qubits[1]);
+        break;
+    case constants::SWAP:
+        circuit.add_SWAP_gate(qubits[0], qubits[1]);
+        break;
+    case constants::FUSEDSWAP:
+    {
+        auto block_size = instruction.at("block_size").get<UINT>();
+        circuit.add_FusedSWAP_gate(qubits[0], qubits[1], block_size);
+        break;
+    }
+    case constants::MULTIPAULI:
+    {
+        auto pauli_id_list = instruction.at("pauli_id_list").get<std::vector<unsigned int>>();
+        circuit.add_multi_Pauli_gate(qubits, pauli_id_list);
+        break;
+    }
+    case constants::MULTIPAULIROTATION:
+    {
+        auto params = instruction.at("params").get<std::vector<double>>();
+        auto pauli_id_list = instruction.at("pauli_id_list").get<std::vector<unsigned int>>();
+        circuit.add_multi_Pauli_rotation_gate(qubits, pauli_id_list, params[0]);
+        break;
+    }
+    case constants::UNITARY:
+    {
+        auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
+        ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
+
+        if (qubits.size() > 1) {
+            circuit.add_dense_matrix_gate(qubits, qulacs_matrix);
+        } else {
+            circuit.add_dense_matrix_gate(qubits[0], qulacs_matrix);
         }
-        case constants::RANDOMUNITARY:
-        {
-            if (instruction.contains("seed")) {
-                auto seed = instruction.at("seed").get<unsigned int>();
-                circuit.add_random_unitary_gate(qubits, seed);
-            } else {
-                circuit.add_random_unitary_gate(qubits);
-            }
-            break;
+        break;
+    }
+    case constants::CUNITARY:
+    {
+        auto cunqa_matrix = instruction.at("matrix").get<std::vector<CUNQAMatrix>>()[0];
+        ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
+
+        std::vector<TargetQubitInfo> target_qubits;
+        for (size_t i = 1; i < qubits.size(); i++) {
+            target_qubits.emplace_back(qubits[i], 0);
         }
-        default:
-            std::cerr << "Instruction not suported!\nInstruction that failed: " << instruction.at("name") << "\n";
+
+        std::vector<ControlQubitInfo> control_qubits = {
+            ControlQubitInfo(qubits[0], 1)
         };
+
+        auto gate = new QuantumGateMatrix(target_qubits, &qulacs_matrix, control_qubits);
+        circuit.add_gate(gate);
+        break;
+    }
+    case constants::RANDOMUNITARY:
+    {
+        if (instruction.contains("seed")) {
+            auto seed = instruction.at("seed").get<unsigned int>();
+            circuit.add_random_unitary_gate(qubits, seed);
+        } else {
+            circuit.add_random_unitary_gate(qubits);
+        }
+        break;
     }
+    default:
+        std::cerr << "Instruction not suported!\nInstruction that failed: " << instruction.at("name") << "\n";
+    };
 }
 
-inline JSON convert_to_counts(const std::vector<ITYPE>& result, int n_qubits)
+
+inline void update_qulacs_circuit(QuantumCircuit& circuit, const JSON& circuit_json)
 {
-    std::unordered_map<std::string, size_t> counts;
-    size_t max_position = (1 << n_qubits) - 1;
-
-    for (auto& value : result) {
-        std::bitset<64> bs(value);
-        std::string bitstring = bs.to_string();
-
-        if (n_qubits <= 0) {
-            bitstring = "";
-        } else if (n_qubits < 64) {
-            bitstring = bitstring.substr(64 - n_qubits);
-        } 
-        counts[bitstring]++;
-    }
+    for (const auto& instruction : circuit_json)
+        add_qulacs_instruction(circuit, instruction);
+}
 
-    JSON result_in_counts;
-    for (const auto& count : counts) {
-        result_in_counts[count.first] = count.second;
-    }
 
-    return result_in_counts;
+// Standalone gate of a parametric instruction, the same add_qulacs_instruction appends,
+// or nullptr if the instruction has no parameters
+inline QuantumGateBase* qulacs_parametric_gate(const JSON& instruction)
+{
+    auto inst_type = INSTRUCTIONS_MAP.at(instruction.at("name").get<std::string>());
+    std::vector<UINT> qubits = instruction.at("qubits").get<std::vector<UINT>>();
+    if (!instruction.contains("params"))
+        return nullptr;
+    auto params = instruction.at("params").get<std::vector<double>>();
+
+    switch (inst_type)
+    {
+    case constants::U1:
+        return gate::U1(qubits[0], params[0]);
+    case constants::RX:
+        return gate::RX(qubits[0], params[0]);
+    case constants::RY:
+        return gate::RY(qubits[0], params[0]);
+    case constants::RZ:
+        return gate::RZ(qubits[0], params[0]);
+    case constants::ROTINVX:
+        return gate::RotInvX(qubits[0], params[0]);
+    case constants::ROTINVY:
+        return gate::RotInvY(qubits[0], params[0]);
+    case constants::ROTINVZ:
+        return gate::RotInvZ(qubits[0], params[0]);
+    case constants::ROTX:
+        return gate::RotX(qubits[0], params[0]);
+    case constants::ROTY:
+        return gate::RotY(qubits[0], params[0]);
+    case constants::ROTZ:
+        return gate::RotZ(qubits[0], params[0]);
+    case constants::U2:
+        return gate::U2(qubits[0], params[0], params[1]);
+    case constants::U3:
+        return gate::U3(qubits[0], params[0], params[1], params[2]);
+    case constants::MULTIPAULIROTATION:
+    {
+        auto pauli_id_list = instruction.at("pauli_id_list").get<std::vector<unsigned int>>();
+        return gate::PauliRotation(qubits, pauli_id_list, params[0]);
+    }
+    default:
+        return nullptr;
+    };
 }
 
-
 } // End namespace cunqa
 } // End namespace sim
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Hash of everything in a circuit but its parameters, so two circuits with the same one only
+// differ in the values of their parameters
+inline std::size_t structure_hash(const JSON& circuit, std::size_t seed = 0)
+{
+    auto combine = [&seed](std::size_t value) {
+        seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+    };
+
+    combine(circuit.size());
+    for (const auto& instruction : circuit) {
+        for (auto it = instruction.begin(); it != instruction.end(); ++it) {
+            if (it.key() == "params")
+                continue;
+            combine(std::hash<std::string>{}(it.key()));
+            combine(std::hash<JSON>{}(it.value()));
+        }
+    }
+    return seed;
+}
+
+// Least recently used cache of the native circuits of a simulator, one per circuit id. An entry
+// is only returned while the structure of the circuit is unchanged; the simulator patches its
+// parameters. The bound is on the total number of instructions held, as a proxy of its memory.
+template <typename Entry>
+class CircuitCache {
+public:
+    static constexpr std::size_t DEFAULT_MAX_INSTRUCTIONS = 1 << 20;
+
+    CircuitCache(std::size_t max_instructions = DEFAULT_MAX_INSTRUCTIONS) :
+        max_instructions_{max_instructions}
+    { }
+
+    // Marks the entry as the most recently used. Returns nullptr if missing or with another structure
+    Entry* find(const std::string& id, const std::size_t structure)
+    {
+        auto it = index_.find(id);
+        if (it == index_.end() || it->second->structure != structure)
+            return nullptr;
+
+        nodes_.splice(nodes_.begin(), nodes_, it->second);
+        return &it->second->entry;
+    }
+
+    // The new entry is always kept, even if it alone exceeds the bound
+    Entry& insert(const std::string& id, const std::size_t structure, const std::size_t n_instructions, Entry entry)
+    {
+        erase(id);
+        nodes_.push_front(Node{id, structure, n_instructions, std::move(entry)});
+        index_[id] = nodes_.begin();
+        n_instructions_ += n_instructions;
+
+        while (n_instructions_ > max_instructions_ && nodes_.size() > 1) {
+            n_instructions_ -= nodes_.back().n_instructions;
+            index_.erase(nodes_.back().id);
+            nodes_.pop_back();
+        }
+        return nodes_.front().entry;
+    }
+
+    void erase(const std::string& id)
+    {
+        auto it = index_.find(id);
+        if (it == index_.end())
+            return;
+
+        n_instructions_ -= it->second->n_instructions;
+        nodes_.erase(it->second);
+        index_.erase(it);
+    }
+
+    inline std::size_t size() const { return nodes_.size(); }
+
+private:
+    struct Node {
+        std::string id;
+        std::size_t structure;
+        std::size_t n_instructions;
+        Entry entry;
+    };
+
+    std::list<Node> nodes_; // Most recently used first
+    std::unordered_map<std::string, typename std::list<Node>::iterator> index_;
+    std::size_t n_instructions_ = 0;
+    std::size_t max_instructions_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <numbers>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+
+#include "utils/constants.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Most qubits of the diagonal that a run of diagonal gates is merged into, 1024 entries that stay
+// in the L1 cache. A run that spans more qubits is cut into several
+constexpr std::size_t DIAGONAL_RUN_MAX_QUBITS = 10;
+
+// Gates that only change the phases of the basis states, on qubits of the state and not on the
+// labels of the communication pairs. The controls on a state other than |1> are left out
+inline bool is_diagonal_gate(const constants::CUNQAInstruction& inst)
+{
+    if (inst.states || std::any_of(inst.qubits.begin(), inst.qubits.end(), [](const int qubit) { return qubit < 0; }))
+        return false;
+    switch (inst.type)
+    {
+    case constants::Z: case constants::S: case constants::SDG: case constants::T: case constants::TDG:
+    case constants::CZ:
+        return true;
+    case constants::RZ: case constants::P: case constants::U1: case constants::CP: case constants::CRZ:
+    case constants::RZZ: case constants::PHASEGADGET:
+        return !inst.params.empty();
+    case constants::DIAGONAL:
+        return !inst.diagonal.empty() && inst.diagonal[0].size() == (std::size_t(1) << inst.qubits.size());
+    default:
+        return false;
+    }
+}
+
+// Diagonal of a gate of is_diagonal_gate on its own qubits, the first of them the lowest bit of
+// the index, as in the "diagonal" instructions
+inline std::vector<std::complex<double>> gate_diagonal(const constants::CUNQAInstruction& inst)
+{
+    using namespace std::complex_literals;
+    const double theta = inst.params.empty() ? 0.0 : inst.params[0];
+    const std::complex<double> minus = std::polar(1.0, -theta / 2), plus = std::polar(1.0, theta / 2);
+    switch (inst.type)
+    {
+    case constants::Z:
+        return {1.0, -1.0};
+    case constants::S:
+        return {1.0, 1i};
+    case constants::SDG:
+        return {1.0, -1i};
+    case constants::T:
+        return {1.0, std::polar(1.0, std::numbers::pi / 4)};
+    case constants::TDG:
+        return {1.0, std::polar(1.0, -std::numbers::pi / 4)};
+    case constants::RZ:
+        return {minus, plus};
+    case constants::P:
+    case constants::U1:
+        return {1.0, std::polar(1.0, theta)};
+    case constants::CZ:
+        return {1.0, 1.0, 1.0, -1.0};
+    case constants::CP:
+        return {1.0, 1.0, 1.0, std::polar(1.0, theta)};
+    case constants::CRZ: // The control is the lowest bit
+        return {1.0, minus, 1.0, plus};
+    case constants::RZZ:
+    case constants::PHASEGADGET:
+    {
+        // exp(-i theta/2 Z...Z), whose sign is the parity of the qubits
+        std::vector<std::complex<double>> diagonal(std::size_t(1) << inst.qubits.size());
+        for (std::size_t j = 0; j < diagonal.size(); j++)
+            diagonal[j] = std::popcount(j) % 2 ? plus : minus;
+        return diagonal;
+    }
+    default:
+    {
+        std::vector<std::complex<double>> diagonal;
+        diagonal.reserve(inst.diagonal[0].size());
+        for (const auto& entry : inst.diagonal[0])
+            diagonal.emplace_back(entry[0], entry[1]);
+        return diagonal;
+    }
+    }
+}
+
+// "diagonal" instruction of the gates in [first, last), on the union of their qubits in
+// increasing order. Each entry is the product of those of the gates on the bits of its index
+inline constants::CUNQAInstruction merge_diagonal_gates(std::vector<constants::CUNQAInstruction>::const_iterator first,
+                                                        std::vector<constants::CUNQAInstruction>::const_iterator last,
+                                                        std::vector<int> qubits)
+{
+    std::sort(qubits.begin(), qubits.end());
+    std::vector<std::complex<double>> diagonal(std::size_t(1) << qubits.size(), 1.0);
+    std::vector<std::size_t> positions;
+    for (auto it = first; it != last; ++it) {
+        const auto gate = gate_diagonal(*it);
+        positions.clear();
+        for (const auto qubit : it->qubits)
+            positions.push_back(std::lower_bound(qubits.begin(), qubits.end(), qubit) - qubits.begin());
+        for (std::size_t j = 0; j < diagonal.size(); j++) {
+            std::size_t local = 0;
+            for (std::size_t m = 0; m < positions.size(); m++)
+                local |= ((j >> positions[m]) & 1) << m;
+            diagonal[j] *= gate[local];
+        }
+    }
+
+    constants::CUNQADiagonalMatrix entries;
+    entries.reserve(diagonal.size());
+    for (const auto& entry : diagonal)
+        entries.push_back({entry.real(), entry.imag()});
+    return {.name = "diagonal", .type = constants::DIAGONAL, .qubits = std::move(qubits), .diagonal = {std::move(entries)}};
+}
+
+// Replaces each run of consecutive diagonal gates, on any qubits, by a single "diagonal" on the
+// union of their qubits, so that the simulator applies the phases of the whole run in one sweep of
+// the state instead of one per gate. A run ends at any other instruction, barriers included, or
+// once its qubits would be more than max_qubits, and single gates are left as they are. The gates
+// of the c_if blocks are merged too
+inline void merge_diagonal_runs(std::vector<constants::CUNQAInstruction>& instructions,
+                                const std::size_t max_qubits = DIAGONAL_RUN_MAX_QUBITS)
+{
+    std::vector<constants::CUNQAInstruction> merged;
+    merged.reserve(instructions.size());
+    std::vector<int> qubits, together;
+    for (std::size_t i = 0; i < instructions.size();) {
+        qubits.clear();
+        std::size_t end = i;
+        while (end < instructions.size() && is_diagonal_gate(instructions[end])) {
+            together = qubits;
+            for (const auto qubit : instructions[end].qubits) {
+                if (std::find(together.begin(), together.end(), qubit) == together.end())
+                    together.push_back(qubit);
+            }
+            if (together.size() > max_qubits)
+                break;
+            std::swap(qubits, together);
+            end++;
+        }
+
+        if (end - i > 1) {
+            merged.push_back(merge_diagonal_gates(instructions.cbegin() + i, instructions.cbegin() + end, qubits));
+            i = end;
+            continue;
+        }
+        merged.push_back(std::move(instructions[i++]));
+        if (merged.back().type == constants::CIF)
+            merge_diagonal_runs(merged.back().instructions, max_qubits);
+    }
+    instructions = std::move(merged);
+}
+
+// The same on the instructions of a task, whose deterministic prefix is merged on its own so that
+// it keeps ending where it did
+inline void merge_diagonal_runs(constants::StructuredQuantumTask& st_qtask, const std::size_t max_qubits = DIAGONAL_RUN_MAX_QUBITS)
+{
+    std::vector<constants::CUNQAInstruction> rest(std::make_move_iterator(st_qtask.instructions.begin() + st_qtask.deterministic_prefix),
+                                                  std::make_move_iterator(st_qtask.instructions.end()));
+    st_qtask.instructions.resize(st_qtask.deterministic_prefix);
+    merge_diagonal_runs(st_qtask.instructions, max_qubits);
+    st_qtask.deterministic_prefix = st_qtask.instructions.size();
+    merge_diagonal_runs(rest, max_qubits);
+    st_qtask.instructions.insert(st_qtask.instructions.end(), std::make_move_iterator(rest.begin()), std::make_move_iterator(rest.end()));
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
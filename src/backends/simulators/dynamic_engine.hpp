@@ -0,0 +1,907 @@
+#pragma once
+
+#include <span>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "utils/constants.hpp"
+#include "classical_channel/classical_channel.hpp"
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/flat_queue.hpp"
+#include "backends/simulators/measure_batch.hpp"
+#include "backends/simulators/shot_exchange.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Quantum communication that holds a pair of communication qubits
+enum class QCommProtocol : std::uint8_t { NONE, TELEDATA, TELEGATE };
+
+struct CommunicationQubitsPair {
+    int q0;
+    int q1;
+    bool idle = true;
+    std::size_t sendr = 0; // Task of the QSEND or the EXPOSE
+    std::size_t recvr = 0; // Task of the QRECV or the RCONTROL
+    QCommProtocol protocol = QCommProtocol::NONE;
+    int label = 0; // Qubit that stands for it in the block of a remote control
+};
+
+struct TaskState {
+    std::size_t index = 0; // Position in the task table of the shot
+    std::uint32_t pc = 0; // Next top level operation
+    std::uint32_t end = 0;
+    int zero_qubit = 0;
+    int n_qubits = 0;
+    int zero_clbit = 0;
+    bool finished = false;
+    bool blocked_by_teledata = false;
+    bool blocked_by_telegate = false;
+    bool blocked_by_cc = false;
+    bool cat_entangled = false;
+
+    inline bool blocked() const { return blocked_by_teledata || blocked_by_telegate || blocked_by_cc; }
+};
+
+struct GlobalState {
+    ClassicalRegister creg;
+    std::vector<FlatQueue<int>> qc_meas_td; // Indexed by task
+    std::vector<FlatQueue<int>> qc_meas_tg; // Indexed by task
+    std::vector<CommunicationQubitsPair> communication_pairs;
+    std::vector<FlatQueue<int>> local_cc_queue; // Indexed by sender and receiver tasks, to mimic classical communications when executing with quantum communications
+};
+
+// Takes n_pairs idle pairs, or none if there are not that many
+inline std::vector<int> find_idle_communication_pairs(GlobalState& G, const std::size_t n_pairs)
+{
+    std::vector<int> indices_idle_pairs;
+    for (std::size_t index = 0; index < G.communication_pairs.size() && indices_idle_pairs.size() < n_pairs; index++) {
+        if (G.communication_pairs[index].idle)
+            indices_idle_pairs.push_back(index);
+    }
+    if (indices_idle_pairs.size() < n_pairs)
+        return {};
+
+    for (const auto index : indices_idle_pairs)
+        G.communication_pairs[index].idle = false;
+    return indices_idle_pairs;
+}
+
+// Pairs taken for a protocol between two tasks, at most n_pairs of them if it is not 0
+inline std::vector<int> find_my_communication_pairs(const GlobalState& G, const std::size_t sendr, const std::size_t recvr,
+                                                    const QCommProtocol protocol, const std::size_t n_pairs = 0)
+{
+    std::vector<int> comm_pairs;
+    for (std::size_t index = 0; index < G.communication_pairs.size(); index++) {
+        if (n_pairs != 0 && comm_pairs.size() == n_pairs)
+            break;
+        const auto& pair = G.communication_pairs[index];
+        if (!pair.idle && pair.sendr == sendr && pair.recvr == recvr && pair.protocol == protocol)
+            comm_pairs.push_back(index);
+    }
+    return comm_pairs;
+}
+
+// Instructions that act on the whole register instead of on their qubits, as the Pauli strings,
+// or that give the state out, which need the qubits of the state in the order of those of the task
+inline bool needs_ordered_qubits(const constants::CUNQAInstruction& inst)
+{
+    switch (inst.type)
+    {
+    case constants::PAULISTR: case constants::CPAULISTR: case constants::MCPAULISTR:
+    case constants::PAULIGADGET: case constants::NONUNITARYPAULIGADGET: case constants::CPAULIGADGET: case constants::MCPAULIGADGET:
+    case constants::SAVE_STATE:
+        return true;
+    default:
+        return std::any_of(inst.instructions.begin(), inst.instructions.end(), needs_ordered_qubits);
+    }
+}
+
+// Whether the swaps of the top level of a task are relabelled instead of run, see relabel_swap
+inline bool relabels_swaps(const std::vector<constants::CUNQAInstruction>& instructions)
+{
+    return std::none_of(instructions.begin(), instructions.end(), needs_ordered_qubits);
+}
+
+// A swap, or a fused swap of two blocks, only changes which qubit of the state holds each qubit of
+// the task, so it is taken into the layout, the qubit of the state of each one, instead of moving
+// the amplitudes. Returns false, leaving the layout as it is, for the rest of instructions
+inline bool relabel_swap(const constants::CUNQAInstruction& inst, std::vector<int>& layout)
+{
+    auto in_layout = [&layout](const int qubit) { return qubit >= 0 && qubit < static_cast<int>(layout.size()); };
+    if (inst.type == constants::SWAP && inst.qubits.size() == 2 && in_layout(inst.qubits[0]) && in_layout(inst.qubits[1])) {
+        std::swap(layout[inst.qubits[0]], layout[inst.qubits[1]]);
+        return true;
+    }
+    if (inst.type == constants::FUSEDSWAP && inst.qubits.size() == 2 && !inst.block_size.empty() && inst.block_size[0] > 0) {
+        const int a = inst.qubits[0], b = inst.qubits[1], n = inst.block_size[0];
+        if (!in_layout(a) || !in_layout(b) || !in_layout(a + n - 1) || !in_layout(b + n - 1) || (a < b + n && b < a + n))
+            return false;
+        for (int k = 0; k < n; k++)
+            std::swap(layout[a + k], layout[b + k]);
+        return true;
+    }
+    return false;
+}
+
+// Shot by shot execution of the dynamic tasks of the classical and quantum communications, the
+// same for every simulator. The instructions of the tasks are decoded once into a table of
+// operations, each one with the step that runs it resolved, so a shot walks the table calling
+// them instead of switching on every instruction. The gates are run by the handlers of the
+// Backend, a thin wrapper over the state of a shot worker:
+//     int measure(int qubit)                        Collapsing the state
+//     void reset(int qubit)
+//     void x(int), z(int), h(int), cx(int, int), swap(int, int)
+//     void flush()                                  Optional. Applies the operations it holds
+//                                                   back, before a RECV
+//     void bell_pair(int q0, int q1)                Optional. Resets q1 and then q0 and leaves
+//                                                   them in (|00> + |11>)/√2, as reset, reset,
+//                                                   h and cx do
+//     void discard(int qubit)                       Optional. The qubit is not used again, as
+//                                                   those of a finished task, or not until its
+//                                                   pair of communication qubits is taken again
+//     void snapshot(), restore()                    Optional. Saves the state, with its draws,
+//                                                   and goes back to it, for Shot::speculate
+//     using Gate = void (*)(Backend&, const constants::CUNQAInstruction&, std::span<const int> qubits)
+//     static Gate gate(const constants::CUNQAInstruction&)   Or nullptr if it is not supported
+// The qubits given to the handlers are those of the whole state, with the offsets of the tasks
+// and the labels of the remote controls already resolved. The swaps of the top level of a task
+// are not run but relabel the qubits of the operations after them, see relabel_swap, so a routed
+// circuit does not sweep the state for each of them; the measurements read the qubits that hold
+// those of the task, so the counts are the same. The tasks with an instruction that
+// needs_ordered_qubits run their swaps. The engine only reads the tasks, which
+// have to outlive it, so the threads of the shots share it, each one with its Shot
+template <typename Backend>
+class DynamicEngine {
+public:
+    using Gate = typename Backend::Gate;
+
+    // Tasks and global state of a shot, set from those of the engine at its start, so the shots
+    // do not allocate once the queues have grown
+    struct Shot {
+        std::vector<TaskState> Ts;
+        GlobalState G;
+        MeasureBatch measure_batch;
+        MeasureInbox inbox; // Of a shot run shot major, whose RECVs read it instead of the channel
+        bool shot_major = false;
+        // With speculate, a RECV of classical communications waiting for its measurements goes on
+        // with the value its clbits got most often, see speculate_
+        bool speculate = false;
+        std::vector<std::array<std::uint32_t, 4>> outcomes_seen; // By RECV, along the shots
+        ClassicalRegister saved_creg;
+        std::size_t speculation_hits = 0;
+        std::size_t speculation_misses = 0;
+        std::vector<int> qubits; // Those of a gate with labels, resolved
+        std::size_t blocked_iterations = 0; // Visits of the scheduler to a blocked task, along the shots
+    };
+
+    // With from_prefix the tasks start after their deterministic_prefix, already applied to the state.
+    // relabel_tasks says, by task, whether its swaps are relabelled, and is otherwise decided from its
+    // instructions. The engine of a deterministic prefix alone takes the decision of the whole
+    // tasks, so that the engine of the rest agrees with it on the swaps of the prefix
+    DynamicEngine(const std::vector<constants::StructuredQuantumTask>& st_qtasks, const std::size_t n_comm_qubits, const bool from_prefix = false,
+                  const std::vector<bool>& relabel_tasks = {})
+    {
+        std::unordered_map<std::string, std::size_t> task_index;
+        int n_clbits = 0;
+        for (const auto& quantum_task : st_qtasks) {
+            TaskState T;
+            T.index = Ts_.size();
+            T.zero_qubit = n_qubits_;
+            T.n_qubits = quantum_task.n_qubits;
+            T.zero_clbit = n_clbits;
+            task_index[quantum_task.id] = T.index;
+            Ts_.push_back(T);
+
+            n_qubits_ += quantum_task.n_qubits;
+            n_clbits += quantum_task.n_clbits;
+        }
+
+        // The top level operations of each task one after the other, and its nested blocks after them
+        for (std::size_t i = 0; i < st_qtasks.size(); i++) {
+            auto& T = Ts_[i];
+            const auto& instructions = st_qtasks[i].instructions;
+            const std::size_t first = ops_.size();
+            std::vector<int> layout(T.n_qubits);
+            std::iota(layout.begin(), layout.end(), 0);
+            const bool relabel = relabel_tasks.empty() ? relabels_swaps(instructions) : relabel_tasks[i];
+            // The nested blocks take the layout of their operation, and their swaps are run, as
+            // they may not be
+            std::unordered_map<std::size_t, std::vector<int>> block_layouts;
+            std::size_t prefix_ops = 0; // Those of the deterministic prefix, without its swaps
+            for (std::size_t k = 0; k < instructions.size(); k++) {
+                if (k == st_qtasks[i].deterministic_prefix)
+                    prefix_ops = ops_.size() - first;
+                if (relabel && relabel_swap(instructions[k], layout))
+                    continue;
+                push_(instructions[k], T, task_index, layout);
+                if (!instructions[k].instructions.empty())
+                    block_layouts[ops_.size() - 1] = layout;
+            }
+            if (st_qtasks[i].deterministic_prefix >= instructions.size())
+                prefix_ops = ops_.size() - first;
+            T.pc = first + (from_prefix ? prefix_ops : 0);
+            T.end = ops_.size();
+            T.finished = T.pc == T.end;
+            // The blocks are appended as they are found, so the loop reaches the nested ones too
+            for (std::size_t j = first; j < ops_.size(); j++) {
+                const auto& nested = ops_[j].inst->instructions;
+                if (nested.empty())
+                    continue;
+                const std::size_t block = ops_.size();
+                const std::vector<int> block_layout = block_layouts.at(j);
+                for (const auto& instruction : nested) {
+                    push_(instruction, T, task_index, block_layout);
+                    if (!instruction.instructions.empty())
+                        block_layouts[ops_.size() - 1] = block_layout;
+                }
+                ops_[j].first = block;
+                ops_[j].count = nested.size();
+                for (std::size_t k = block; k < ops_.size(); k++)
+                    nested_recv_ |= ops_[k].step == recv_;
+            }
+        }
+
+        for (std::size_t i = 0; i < n_comm_qubits; i += 2) {
+            G_.communication_pairs.push_back({.q0 = static_cast<int>(n_qubits_ + i), .q1 = static_cast<int>(n_qubits_ + i + 1)});
+        }
+        n_qubits_ += n_comm_qubits;
+
+        G_.creg = ClassicalRegister(n_clbits);
+        G_.qc_meas_td.resize(Ts_.size());
+        G_.qc_meas_tg.resize(Ts_.size());
+        G_.local_cc_queue.resize(Ts_.size() * Ts_.size());
+    }
+
+    // Along with the communication qubits
+    inline std::size_t n_qubits() const { return n_qubits_; }
+
+    Shot shot() const
+    {
+        Shot shot;
+        shot.Ts = Ts_;
+        shot.G = G_;
+        return shot;
+    }
+
+    // Runs a shot on the state of the backend, which starts it in the state the tasks expect
+    const ClassicalRegister& run(Backend& backend, Shot& shot, comm::ClassicalChannel* classical_channel, const bool allows_qc) const
+    {
+        shot.Ts = Ts_;
+        shot.G = G_;
+        shot.shot_major = false;
+        const Context ctx{*this, backend, shot, classical_channel, allows_qc, {}};
+
+        if (!advance_(ctx))
+            throw std::runtime_error("The tasks of the shot are blocked waiting for each other.");
+
+        // The measurements sent after the last RECV
+        shot.measure_batch.flush(classical_channel);
+
+        return shot.G.creg;
+    }
+
+    // Whether the shots can run shot major, which needs the RECVs at the top level of the tasks
+    inline bool runs_shot_major() const { return !nested_recv_; }
+
+    // Runs a block of shots of classical communications shot major, see ShotExchange, each one on
+    // the state of its backend, and gives on_end the index and register of each shot at the end.
+    // With parallel, the shots of the block advance at once between the exchanges
+    template <typename OnEnd>
+    void run_block(std::vector<Backend>& backends, std::vector<Shot>& shots, comm::ClassicalChannel* classical_channel,
+                   ShotExchange& exchange, [[maybe_unused]] const bool parallel, OnEnd on_end) const
+    {
+        for (auto& shot : shots) {
+            shot.Ts = Ts_;
+            shot.G = G_;
+            shot.inbox.clear();
+            shot.shot_major = true;
+        }
+
+        std::vector<char> ended(shots.size(), false);
+        std::vector<std::string> origins;
+        std::exception_ptr error; // What a shot threw, rethrown out of the threads
+        while (true) {
+            #pragma omp parallel for if (parallel)
+            for (std::size_t i = 0; i < shots.size(); i++) {
+                try {
+                    if (!ended[i])
+                        ended[i] = advance_({*this, backends[i], shots[i], classical_channel, false, {}});
+                } catch (...) {
+                    #pragma omp critical
+                    if (!error)
+                        error = std::current_exception();
+                }
+            }
+            if (error)
+                std::rethrow_exception(error);
+            exchange.send(shots, classical_channel);
+
+            origins.clear();
+            for (std::size_t i = 0; i < shots.size(); i++) {
+                for (const auto& T : shots[i].Ts) {
+                    if (T.finished || !T.blocked_by_cc)
+                        continue;
+                    const std::string& origin = ops_[T.pc].inst->qpus[0];
+                    if (std::find(origins.begin(), origins.end(), origin) == origins.end())
+                        origins.push_back(origin);
+                }
+            }
+            if (origins.empty())
+                break;
+            exchange.recv(shots, origins, classical_channel);
+        }
+
+        for (std::size_t i = 0; i < shots.size(); i++)
+            on_end(i, std::as_const(shots[i].G.creg));
+    }
+
+private:
+    static constexpr std::uint32_t NO_TASK = UINT32_MAX;
+    static constexpr std::size_t MAX_SPECULATED_CLBITS = 2; // Values of the RECVs tracked in Shot::outcomes_seen
+
+    struct Op;
+    struct Context {
+        const DynamicEngine& engine;
+        Backend& backend;
+        Shot& shot;
+        comm::ClassicalChannel* classical_channel;
+        bool allows_qc;
+        std::span<const int> comm_indices; // Pairs of the remote control whose block is running
+    };
+    using Step = void (*)(const Context&, TaskState&, const Op&);
+
+    struct Op {
+        Step step;
+        Gate gate = nullptr;
+        const constants::CUNQAInstruction* inst;
+        std::uint32_t first_qubit = 0, n_qubits = 0; // In qubits_
+        std::uint32_t first_clbit = 0, n_clbits = 0; // In clbits_
+        std::uint32_t first = 0, count = 0; // Nested block, in ops_
+        std::uint32_t peer = NO_TASK; // Task of qpus[0], if it is one of the shot
+        bool labeled = false; // Any of its qubits is the label of a communication pair
+    };
+
+    std::vector<Op> ops_;
+    std::vector<int> qubits_; // Of the state, or labels of the communication pairs
+    std::vector<int> clbits_; // Of the register of the shot
+    std::vector<TaskState> Ts_;
+    GlobalState G_;
+    std::size_t n_qubits_ = 0;
+    bool nested_recv_ = false;
+
+    // Runs the tasks of the shot until they end, returning true, or are all blocked. A shot run
+    // shot major starts again at the RECVs left waiting for its inbox
+    bool advance_(const Context& ctx) const
+    {
+        auto& shot = ctx.shot;
+        if (shot.shot_major) {
+            for (auto& T : shot.Ts)
+                T.blocked_by_cc = false;
+        }
+
+        bool ended = false;
+        while (!ended) {
+            ended = true;
+            bool stepped = false;
+            for (auto& T : shot.Ts) {
+                if (T.finished)
+                    continue;
+                if (T.blocked()) {
+                    ended = false;
+                    shot.blocked_iterations++;
+                    continue;
+                }
+
+                const Op& op = ops_[T.pc];
+                op.step(ctx, T, op);
+                stepped = true;
+
+                if (!T.blocked())
+                    ++T.pc;
+                else
+                    shot.blocked_iterations++;
+
+                if (T.pc != T.end) {
+                    ended = false;
+                } else {
+                    T.finished = true;
+                    discard_(ctx.backend, T.zero_qubit, T.n_qubits);
+                }
+            }
+            // Blocked tasks are only freed by the steps of the others
+            if (!ended && !stepped)
+                return false;
+        }
+        return true;
+    }
+
+    void push_(const constants::CUNQAInstruction& inst, const TaskState& T, const std::unordered_map<std::string, std::size_t>& task_index,
+               const std::vector<int>& layout)
+    {
+        Op op;
+        op.inst = &inst;
+        op.first_qubit = qubits_.size();
+        op.n_qubits = inst.qubits.size();
+        for (const auto qubit : inst.qubits) {
+            if (qubit < 0)
+                qubits_.push_back(qubit);
+            else
+                qubits_.push_back((qubit < static_cast<int>(layout.size()) ? layout[qubit] : qubit) + T.zero_qubit);
+            op.labeled |= qubit < 0;
+        }
+        op.first_clbit = clbits_.size();
+        op.n_clbits = inst.clbits.size();
+        for (const auto clbit : inst.clbits)
+            clbits_.push_back(clbit + T.zero_clbit);
+        if (!inst.qpus.empty()) {
+            if (auto it = task_index.find(inst.qpus[0]); it != task_index.end())
+                op.peer = it->second;
+        }
+
+        switch (inst.type) {
+        case constants::MEASURE:
+            op.step = measure_;
+            break;
+        case constants::COPY:
+            if (inst.l_clbits.size() != inst.r_clbits.size())
+                throw std::runtime_error("The number of copied clbits and the number of clbits "
+                                         "copied on does not match.");
+            op.step = copy_;
+            break;
+        case constants::BARRIER:
+            op.step = skip_;
+            break;
+        case constants::SEND:
+            op.step = send_;
+            break;
+        case constants::RECV:
+            op.step = recv_;
+            break;
+        case constants::CIF:
+            op.step = cif_;
+            break;
+        case constants::QSEND:
+            op.step = qsend_;
+            break;
+        case constants::QRECV:
+            op.step = qrecv_;
+            break;
+        case constants::EXPOSE:
+            op.step = expose_;
+            break;
+        case constants::RCONTROL:
+            op.step = rcontrol_;
+            break;
+        default:
+            op.gate = Backend::gate(inst);
+            if (op.gate) {
+                op.step = gate_;
+            } else {
+                std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.name << "\n";
+                op.step = skip_;
+            }
+        }
+        ops_.push_back(op);
+    }
+
+    inline std::span<const int> qubits_of_(const Op& op) const { return {qubits_.data() + op.first_qubit, op.n_qubits}; }
+    inline std::span<const int> clbits_of_(const Op& op) const { return {clbits_.data() + op.first_clbit, op.n_clbits}; }
+
+    // Tasks of the shot only, as the local queues of the quantum communications
+    static std::size_t peer_(const Op& op)
+    {
+        if (op.peer == NO_TASK)
+            throw std::out_of_range("QPU " + op.inst->qpus[0] + " does not run a task of the shot.");
+        return op.peer;
+    }
+
+    static void run_block_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        for (std::uint32_t i = op.first; i < op.first + op.count; i++) {
+            const Op& sub_op = ctx.engine.ops_[i];
+            sub_op.step(ctx, T, sub_op);
+        }
+    }
+
+    static void skip_(const Context&, TaskState&, const Op&) {}
+
+    static void gate_(const Context& ctx, TaskState&, const Op& op)
+    {
+        const auto qubits = ctx.engine.qubits_of_(op);
+        if (!op.labeled) {
+            op.gate(ctx.backend, *op.inst, qubits);
+            return;
+        }
+
+        // The labels stand for the second qubit of a pair of the remote control
+        auto& resolved = ctx.shot.qubits;
+        resolved.assign(qubits.begin(), qubits.end());
+        for (auto& qubit : resolved) {
+            if (qubit >= 0)
+                continue;
+            const int label = qubit;
+            qubit = 0;
+            for (const auto index : ctx.comm_indices) {
+                const auto& pair = ctx.shot.G.communication_pairs[index];
+                if (!pair.idle && pair.label == label) {
+                    qubit = pair.q1;
+                    break;
+                }
+            }
+        }
+        op.gate(ctx.backend, *op.inst, resolved);
+    }
+
+    static void measure_(const Context& ctx, TaskState&, const Op& op)
+    {
+        const int measurement = ctx.backend.measure(ctx.engine.qubits_[op.first_qubit]);
+        ctx.shot.G.creg[ctx.engine.clbits_[op.first_clbit]] = (measurement == 1);
+    }
+
+    static void copy_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& creg = ctx.shot.G.creg;
+        for (std::size_t i = 0; i < op.inst->l_clbits.size(); ++i)
+            creg[op.inst->l_clbits[i] + T.zero_clbit] = creg[op.inst->r_clbits[i] + T.zero_clbit];
+    }
+
+    static void send_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        if (ctx.allows_qc) {
+            const std::size_t peer = peer_(op);
+            auto& cc_queue = G.local_cc_queue[T.index * ctx.shot.Ts.size() + peer];
+            for (const auto clbit : ctx.engine.clbits_of_(op))
+                cc_queue.push(G.creg.test(clbit));
+            // Unlock RECV
+            ctx.shot.Ts[peer].blocked_by_cc = false;
+        } else {
+            for (const auto clbit : ctx.engine.clbits_of_(op))
+                ctx.shot.measure_batch.add(op.inst->qpus[0], G.creg.test(clbit));
+        }
+    }
+
+    static void recv_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        const auto clbits = ctx.engine.clbits_of_(op);
+        if (ctx.allows_qc) {
+            auto& cc_queue = G.local_cc_queue[peer_(op) * ctx.shot.Ts.size() + T.index];
+            if (cc_queue.empty()) {
+                T.blocked_by_cc = true;
+                return;
+            }
+            flush_(ctx.backend);
+            for (const auto clbit : clbits) {
+                G.creg[clbit] = (cc_queue.front() == 1);
+                cc_queue.pop();
+            }
+            T.blocked_by_cc = false;
+        } else if (ctx.shot.shot_major) {
+            auto& inbox = ctx.shot.inbox.of(op.inst->qpus[0]);
+            if (inbox.size() < clbits.size()) {
+                T.blocked_by_cc = true;
+                return;
+            }
+            for (const auto clbit : clbits) {
+                G.creg[clbit] = (inbox.front() == 1);
+                inbox.pop();
+            }
+            T.blocked_by_cc = false;
+        } else {
+            // While the measurements are on their way, the operations that follow run as long as
+            // they neither touch their clbits nor receive. They keep their order, so the shot
+            // draws the same whenever the measurements arrive
+            auto& batch = ctx.shot.measure_batch;
+            const std::string& origin = op.inst->qpus[0];
+            const auto* measurements = batch.try_recv(ctx.classical_channel, origin, clbits.size());
+            std::uint32_t ahead = T.pc + 1;
+            if (&op == &ctx.engine.ops_[T.pc]) {
+                while (!measurements && ahead < T.end && ctx.engine.runs_ahead_(ctx.engine.ops_[ahead], clbits, T)) {
+                    const Op& next = ctx.engine.ops_[ahead++];
+                    next.step(ctx, T, next);
+                    measurements = batch.try_recv(ctx.classical_channel, origin, clbits.size());
+                }
+                if (!measurements && speculate_(ctx, T, origin, clbits, ahead, measurements)) {
+                    T.pc = ahead - 1;
+                    return;
+                }
+            }
+            flush_(ctx.backend);
+            if (!measurements)
+                measurements = &batch.recv(ctx.classical_channel, origin, clbits.size());
+            for (std::size_t i = 0; i < clbits.size(); i++)
+                G.creg[clbits[i]] = ((*measurements)[i] == 1);
+            // The scheduler goes on after the last one run
+            T.pc = ahead - 1;
+        }
+    }
+
+    // Runs the operations after a RECV, from ahead up to the next communication, with the value of
+    // its clbits received most often so far, while the measurements are on their way. On a
+    // mispredict the state, with its draws, and the register go back to those before them, so the
+    // shot draws the same either way. Returns whether the guess was right, with the measurements
+    // received and, if so, ahead after the operations run. Only for the backends that can take
+    // a snapshot of their state and restore it
+    static bool speculate_(const Context& ctx, TaskState& T, const std::string& origin, std::span<const int> clbits,
+                           std::uint32_t& ahead, const std::vector<std::uint8_t>*& measurements)
+    {
+        if constexpr (requires { ctx.backend.snapshot(); ctx.backend.restore(); }) {
+            auto& shot = ctx.shot;
+            const auto& ops = ctx.engine.ops_;
+            if (!shot.speculate || clbits.size() > MAX_SPECULATED_CLBITS || ahead == T.end || !ctx.engine.speculates_over_(ops[ahead]))
+                return false;
+
+            shot.outcomes_seen.resize(ops.size());
+            auto& seen = shot.outcomes_seen[T.pc];
+            const auto predicted = static_cast<unsigned>(std::max_element(seen.begin(), seen.end()) - seen.begin());
+            ctx.backend.snapshot();
+            shot.saved_creg = shot.G.creg;
+            for (std::size_t i = 0; i < clbits.size(); i++)
+                shot.G.creg[clbits[i]] = (predicted >> i) & 1;
+
+            std::uint32_t end = ahead;
+            while (!measurements && end < T.end && ctx.engine.speculates_over_(ops[end])) {
+                const Op& next = ops[end++];
+                next.step(ctx, T, next);
+                measurements = shot.measure_batch.try_recv(ctx.classical_channel, origin, clbits.size());
+            }
+            flush_(ctx.backend);
+            if (!measurements)
+                measurements = &shot.measure_batch.recv(ctx.classical_channel, origin, clbits.size());
+
+            unsigned actual = 0;
+            for (std::size_t i = 0; i < clbits.size(); i++)
+                actual |= static_cast<unsigned>((*measurements)[i] == 1) << i;
+            seen[actual]++;
+            if (actual == predicted) {
+                shot.speculation_hits++;
+                ahead = end;
+                return true;
+            }
+            shot.speculation_misses++;
+            ctx.backend.restore();
+            shot.G.creg = shot.saved_creg;
+            return false;
+        } else {
+            return false;
+        }
+    }
+
+    // Whether an operation may run on a speculated value: a gate, measure, copy or classically
+    // controlled block, which the snapshot of a backend can undo
+    bool speculates_over_(const Op& op) const
+    {
+        if (op.step != gate_ && op.step != measure_ && op.step != copy_ && op.step != cif_ && op.step != skip_)
+            return false;
+        if (op.labeled)
+            return false;
+        for (std::uint32_t i = op.first; i < op.first + op.count; i++) {
+            if (!speculates_over_(ops_[i]))
+                return false;
+        }
+        return true;
+    }
+
+    // Whether an operation may run before a RECV of the clbits pending gets its measurements:
+    // a gate, measure, copy, send or classically controlled block that does not touch them
+    bool runs_ahead_(const Op& op, std::span<const int> pending, const TaskState& T) const
+    {
+        const auto is_pending = [&](const int clbit) {
+            return std::find(pending.begin(), pending.end(), clbit) != pending.end();
+        };
+
+        if (op.step == copy_) {
+            for (std::size_t i = 0; i < op.inst->l_clbits.size(); ++i) {
+                if (is_pending(op.inst->l_clbits[i] + T.zero_clbit) || is_pending(op.inst->r_clbits[i] + T.zero_clbit))
+                    return false;
+            }
+        } else if (op.step != gate_ && op.step != measure_ && op.step != send_ && op.step != cif_ && op.step != skip_) {
+            return false;
+        }
+        if (op.labeled)
+            return false;
+        for (const auto clbit : clbits_of_(op)) {
+            if (is_pending(clbit))
+                return false;
+        }
+        for (std::uint32_t i = op.first; i < op.first + op.count; i++) {
+            if (!runs_ahead_(ops_[i], pending, T))
+                return false;
+        }
+        return true;
+    }
+
+    static void cif_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        if (cif_holds(*op.inst, ctx.shot.G.creg, T.zero_clbit))
+            run_block_(ctx, T, op);
+    }
+
+    // Takes n_pairs idle pairs and entangles each one in a Bell state
+    static std::vector<int> generate_entanglement_(const Context& ctx, const std::size_t n_pairs)
+    {
+        std::vector<int> indices = find_idle_communication_pairs(ctx.shot.G, n_pairs);
+        for (const auto index : indices) {
+            const auto& pair = ctx.shot.G.communication_pairs[index];
+            if constexpr (requires { ctx.backend.bell_pair(pair.q0, pair.q1); }) {
+                ctx.backend.bell_pair(pair.q0, pair.q1);
+            } else {
+                ctx.backend.reset(pair.q1);
+                ctx.backend.reset(pair.q0);
+                ctx.backend.h(pair.q0);
+                ctx.backend.cx(pair.q0, pair.q1);
+            }
+        }
+        return indices;
+    }
+
+    static void qsend_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        auto& backend = ctx.backend;
+        std::vector<int> indices = generate_entanglement_(ctx, 1);
+        if (indices.empty()) {
+            T.blocked_by_teledata = true;
+            return;
+        }
+        T.blocked_by_teledata = false;
+        auto& pair = G.communication_pairs[indices[0]];
+        const int qubit = ctx.engine.qubits_[op.first_qubit];
+        const std::size_t peer = peer_(op);
+
+        // CX to the entangled pair and H to the sent qubit
+        backend.cx(qubit, pair.q0);
+        backend.h(qubit);
+
+        const int result = backend.measure(qubit);
+        G.qc_meas_td[T.index].push(result);
+        G.qc_meas_td[T.index].push(backend.measure(pair.q0));
+        if (result)
+            backend.x(qubit);
+
+        // Unlock QRECV
+        ctx.shot.Ts[peer].blocked_by_teledata = false;
+
+        pair.protocol = QCommProtocol::TELEDATA;
+        pair.sendr = T.index;
+        pair.recvr = peer;
+    }
+
+    static void qrecv_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        const std::size_t peer = peer_(op);
+        auto& meas_td = G.qc_meas_td[peer];
+        if (meas_td.empty()) {
+            T.blocked_by_teledata = true;
+            return;
+        }
+        if (T.blocked_by_teledata)
+            return;
+
+        // Receive the measurements from the sender
+        const int meas1 = meas_td.front();
+        meas_td.pop();
+        const int meas2 = meas_td.front();
+        meas_td.pop();
+
+        auto& pair = G.communication_pairs[find_my_communication_pairs(G, peer, T.index, QCommProtocol::TELEDATA, 1)[0]];
+
+        // Apply, conditioned to the measurements, the X and Z gates, and swap the value to the desired qubit.
+        // The X corrects the flip read on the entangled qubit, the Z the phase read on the sent one
+        if (meas2)
+            ctx.backend.x(pair.q1);
+        if (meas1)
+            ctx.backend.z(pair.q1);
+        ctx.backend.swap(pair.q1, ctx.engine.qubits_[op.first_qubit]);
+
+        pair.idle = true;
+        // The entangled qubit now holds the one it was swapped with
+        discard_(ctx.backend, pair.q1, 1);
+    }
+
+    static void expose_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        const auto qubits = ctx.engine.qubits_of_(op);
+        const std::size_t peer = peer_(op);
+        if (!T.cat_entangled) {
+            std::vector<int> indices = generate_entanglement_(ctx, qubits.size());
+            if (indices.empty()) {
+                T.blocked_by_telegate = true;
+                return;
+            }
+
+            for (std::size_t qid = 0; qid < indices.size(); qid++) {
+                auto& pair = G.communication_pairs[indices[qid]];
+                pair.protocol = QCommProtocol::TELEGATE;
+                pair.label = -static_cast<int>(qid + 1);
+                pair.sendr = T.index;
+                pair.recvr = peer;
+
+                // CX to the entangled pair
+                ctx.backend.cx(qubits[qid], pair.q0);
+                G.qc_meas_tg[T.index].push(ctx.backend.measure(pair.q0));
+            }
+            // Waits for the remote control to end
+            T.cat_entangled = true;
+            T.blocked_by_telegate = true;
+            ctx.shot.Ts[peer].blocked_by_telegate = false;
+            return;
+        }
+
+        auto& meas_tg = G.qc_meas_tg[peer];
+        for (const auto qubit : qubits) {
+            const int meas = meas_tg.front();
+            meas_tg.pop();
+            if (meas)
+                ctx.backend.z(qubit);
+        }
+        T.cat_entangled = false;
+
+        for (const auto index : find_my_communication_pairs(G, T.index, peer, QCommProtocol::TELEGATE, qubits.size()))
+            G.communication_pairs[index].idle = true;
+    }
+
+    static void rcontrol_(const Context& ctx, TaskState& T, const Op& op)
+    {
+        auto& G = ctx.shot.G;
+        const std::size_t peer = peer_(op);
+        auto& meas_tg = G.qc_meas_tg[peer];
+        if (meas_tg.empty()) {
+            T.blocked_by_telegate = true;
+            return;
+        }
+        if (T.blocked_by_telegate)
+            return;
+
+        const std::vector<int> indices = find_my_communication_pairs(G, peer, T.index, QCommProtocol::TELEGATE);
+        for (const auto index : indices) {
+            const int meas = meas_tg.front();
+            meas_tg.pop();
+            if (meas)
+                ctx.backend.x(G.communication_pairs[index].q1);
+        }
+
+        Context block_ctx = ctx;
+        block_ctx.comm_indices = indices;
+        run_block_(block_ctx, T, op);
+
+        for (const auto index : indices) {
+            const int q1 = G.communication_pairs[index].q1;
+            ctx.backend.h(q1);
+            G.qc_meas_tg[T.index].push(ctx.backend.measure(q1));
+        }
+
+        ctx.shot.Ts[peer].blocked_by_telegate = false;
+        T.blocked_by_telegate = false;
+    }
+
+    static void flush_(Backend& backend)
+    {
+        if constexpr (requires { backend.flush(); })
+            backend.flush();
+    }
+
+    static void discard_(Backend& backend, const int first_qubit, const int n_qubits)
+    {
+        if constexpr (requires { backend.discard(first_qubit); }) {
+            for (int qubit = first_qubit; qubit < first_qubit + n_qubits; qubit++)
+                backend.discard(qubit);
+        }
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "quantum_task.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Messages of a QC vQPU to its executor. The executor keeps the last circuit of each QPU, so a
+// round with the same circuit as the one before only carries its parameters and shots, which the
+// executor applies in place instead of parsing and decoding the whole circuit again
+class ExecutorRounds {
+public:
+    inline std::string message(const QuantumTask& quantum_task)
+    {
+        if (quantum_task.circuit.empty())
+            return "";
+
+        if (sent_ == &quantum_task && quantum_task.id == sent_id_ && quantum_task.circuit_revision == sent_revision_) {
+            try {
+                return JSON{{"params", quantum_task.params()}, {"shots", quantum_task.config.at("shots")}}.dump();
+            } catch (const std::exception&) { } // Unbound parameters go as a whole circuit
+        }
+
+        sent_ = &quantum_task;
+        sent_id_ = quantum_task.id;
+        sent_revision_ = quantum_task.circuit_revision;
+        return to_string(quantum_task);
+    }
+
+    // After an error the executor may not hold the circuit, so the next round sends it whole
+    inline const JSON& check(const JSON& result)
+    {
+        if (result.contains("ERROR"))
+            sent_ = nullptr;
+        return result;
+    }
+
+private:
+    const QuantumTask* sent_ = nullptr; // The task of the worker, reused along its rounds
+    std::string sent_id_;
+    std::uint64_t sent_revision_ = 0;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
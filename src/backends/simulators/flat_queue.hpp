@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+namespace cunqa {
+namespace sim {
+
+// FIFO queue over a vector that keeps its capacity when emptied or cleared, so that queues
+// reused along many shots stop allocating once they have grown to their largest size
+template <typename T>
+class FlatQueue {
+public:
+    inline void push(const T& value) { items_.push_back(value); }
+    inline const T& front() const { return items_[head_]; }
+    inline bool empty() const { return head_ == items_.size(); }
+    inline std::size_t size() const { return items_.size() - head_; }
+
+    inline void pop()
+    {
+        if (++head_ == items_.size())
+            clear();
+    }
+
+    inline void clear()
+    {
+        items_.clear();
+        head_ = 0;
+    }
+
+private:
+    std::vector<T> items_;
+    std::size_t head_ = 0;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
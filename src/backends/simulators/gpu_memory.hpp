@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
+#if COMPILATION_FOR_GPU
+#include <cstdint>
+#include <cuda_runtime_api.h>
+#endif
+
+#include "logger.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Creates the CUDA context of each GPU of the QPU once per process, so it and the streams the
+// simulators open on it outlive the requests, and lets the default memory pool of the GPU keep
+// the memory freed by the stream-ordered allocations, which the next requests then reuse instead
+// of going back to the driver. Nothing to do on the builds without GPU
+inline void retain_gpu_memory([[maybe_unused]] const std::vector<int>& devices)
+{
+#if COMPILATION_FOR_GPU
+    static std::mutex mutex;
+    static std::vector<int> retained;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (const int device : devices) {
+        if (std::find(retained.begin(), retained.end(), device) != retained.end())
+            continue;
+        if (cudaSetDevice(device) != cudaSuccess || cudaFree(nullptr) != cudaSuccess) {
+            LOGGER_WARN("Could not create the CUDA context of GPU {}.", device);
+            continue;
+        }
+
+        cudaMemPool_t pool;
+        std::uint64_t threshold = UINT64_MAX;
+        if (cudaDeviceGetDefaultMemPool(&pool, device) == cudaSuccess)
+            cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReleaseThreshold, &threshold);
+        retained.push_back(device);
+        LOGGER_DEBUG("GPU {} keeps its context and memory pool across requests.", device);
+    }
+#endif
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
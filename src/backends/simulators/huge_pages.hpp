@@ -0,0 +1,132 @@
+#pragma once
+
+#include <new>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include "logger.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Pages of the statevectors, taken from CUNQA_HUGE_PAGES, which qraise --huge-pages sets: "thp"
+// asks the kernel for transparent huge pages, "2M" and "1G" map them from the pools of hugetlbfs.
+// A wide statevector on 4 KiB pages misses the TLB on almost every access of the high targets
+enum class HugePages { none, transparent, pool_2m, pool_1g };
+
+constexpr std::size_t HUGE_PAGE_2M = std::size_t(1) << 21;
+constexpr std::size_t HUGE_PAGE_1G = std::size_t(1) << 30;
+
+inline HugePages huge_pages()
+{
+    static const HugePages mode = [] {
+        const char* mode_char = std::getenv("CUNQA_HUGE_PAGES");
+        const std::string mode = mode_char ? mode_char : "";
+        if (mode == "thp")
+            return HugePages::transparent;
+        if (mode == "2M")
+            return HugePages::pool_2m;
+        if (mode == "1G")
+            return HugePages::pool_1g;
+        if (!mode.empty())
+            LOGGER_WARN("Unknown CUNQA_HUGE_PAGES {}, the statevectors go on regular pages.", mode);
+        return HugePages::none;
+    }();
+    return mode;
+}
+
+// Asks for transparent huge pages on the whole 2 MiB pages of a buffer, which must not have been
+// touched yet for the kernel to back it with them from the start
+inline void advise_huge_pages([[maybe_unused]] void* data, [[maybe_unused]] const std::size_t bytes)
+{
+#ifdef MADV_HUGEPAGE
+    if (huge_pages() == HugePages::none)
+        return;
+    const auto begin = (reinterpret_cast<std::uintptr_t>(data) + HUGE_PAGE_2M - 1) & ~(HUGE_PAGE_2M - 1);
+    const auto end = (reinterpret_cast<std::uintptr_t>(data) + bytes) & ~(HUGE_PAGE_2M - 1);
+    if (end > begin && madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) != 0)
+        LOGGER_DEBUG("Transparent huge pages not available, the statevector goes on regular pages.");
+#endif
+}
+
+// Buffer of a statevector, on huge pages if the QPU asks for them. When the pool of hugetlbfs is
+// not configured or has run out it falls back to transparent huge pages, and those to regular
+// pages where the kernel does not have them. Buffers smaller than a huge page go on regular ones
+class StateBuffer {
+public:
+    StateBuffer() = default;
+
+    explicit StateBuffer(const std::size_t bytes, const std::size_t alignment = 64)
+    {
+        const HugePages mode = huge_pages();
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+        if ((mode == HugePages::pool_2m || mode == HugePages::pool_1g) && bytes >= HUGE_PAGE_2M) {
+            // A 1 GiB page for the states of at least that much, which would waste most of it otherwise
+            const bool gigantic = mode == HugePages::pool_1g && bytes >= HUGE_PAGE_1G;
+            const std::size_t page = gigantic ? HUGE_PAGE_1G : HUGE_PAGE_2M;
+            const int page_flag = (gigantic ? 30 : 21) << MAP_HUGE_SHIFT;
+            const std::size_t rounded = (bytes + page - 1) / page * page;
+            void* mapped = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | page_flag, -1, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = mapped;
+                mapped_ = rounded;
+                return;
+            }
+            LOGGER_DEBUG("No huge pages of {} bytes left for a statevector of {} bytes, trying transparent huge pages.", page, bytes);
+        }
+#endif
+        const std::size_t align = (mode != HugePages::none && bytes >= HUGE_PAGE_2M) ? HUGE_PAGE_2M : alignment;
+        const std::size_t rounded = (bytes + align - 1) / align * align;
+        data_ = std::aligned_alloc(align, rounded);
+        if (!data_)
+            throw std::bad_alloc();
+        if (align == HUGE_PAGE_2M)
+            advise_huge_pages(data_, rounded);
+    }
+
+    ~StateBuffer() { release_(); }
+
+    StateBuffer(StateBuffer&& other) noexcept :
+        data_{std::exchange(other.data_, nullptr)},
+        mapped_{std::exchange(other.mapped_, 0)}
+    { }
+
+    StateBuffer& operator=(StateBuffer&& other) noexcept
+    {
+        if (this != &other) {
+            release_();
+            data_ = std::exchange(other.data_, nullptr);
+            mapped_ = std::exchange(other.mapped_, 0);
+        }
+        return *this;
+    }
+
+    StateBuffer(const StateBuffer&) = delete;
+    StateBuffer& operator=(const StateBuffer&) = delete;
+
+    template <typename T>
+    inline T* data() const { return static_cast<T*>(data_); }
+
+private:
+    void* data_ = nullptr;
+    std::size_t mapped_ = 0; // Bytes mapped from hugetlbfs, 0 if allocated on the heap
+
+    void release_()
+    {
+        if (!data_)
+            return;
+        if (mapped_ > 0)
+            munmap(data_, mapped_);
+        else
+            std::free(data_);
+        data_ = nullptr;
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <initializer_list>
+
+#include "utils/constants.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Custom matrices of the instructions of a task (unitaries, controlled unitaries, diagonals...)
+// converted once into the type of a simulator, so that the shots apply them as they are instead
+// of converting them on every application. It is filled before the shots and only read by them,
+// so the threads of the shots share it. The matrices are found by the address of their
+// instruction, which has to stay in place while the cache is in use
+template <typename Matrix>
+class MatrixCache {
+public:
+    MatrixCache() = default;
+
+    MatrixCache(const MatrixCache&) = delete;
+    MatrixCache& operator=(const MatrixCache&) = delete;
+
+    // Converts the instructions of the given types, those of the nested blocks too
+    template <typename Convert>
+    void add(const std::vector<constants::CUNQAInstruction>& instructions, std::initializer_list<int> types, const Convert& convert)
+    {
+        for (const auto& instruction : instructions) {
+            if (std::find(types.begin(), types.end(), instruction.type) != types.end())
+                matrices_.emplace(&instruction, convert(instruction));
+            if (!instruction.instructions.empty())
+                add(instruction.instructions, types, convert);
+        }
+    }
+
+    inline const Matrix& at(const constants::CUNQAInstruction& instruction) const { return matrices_.at(&instruction); }
+
+private:
+    std::unordered_map<const constants::CUNQAInstruction*, Matrix> matrices_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
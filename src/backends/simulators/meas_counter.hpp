@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+
+#include "utils/constants.hpp"
+#include "utils/json.hpp"
+#include "sample_histogram.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Classical bits of all the tasks of a shot, packed 64 per word. Like the map it replaces,
+// accessing a bit past the end grows the register with zeros
+class ClassicalRegister {
+public:
+    // A bit of the register, as std::vector<bool>::reference
+    class Reference {
+    public:
+        Reference(std::uint64_t& word, const std::size_t bit) : word_{word}, bit_{bit} {}
+
+        inline operator bool() const { return (word_ >> bit_) & 1; }
+        inline Reference& operator=(const bool value)
+        {
+            word_ = (word_ & ~(std::uint64_t(1) << bit_)) | (std::uint64_t(value) << bit_);
+            return *this;
+        }
+        inline Reference& operator=(const Reference& other) { return *this = static_cast<bool>(other); }
+
+    private:
+        std::uint64_t& word_;
+        std::size_t bit_;
+    };
+
+    ClassicalRegister() = default;
+    ClassicalRegister(const std::size_t n_clbits) : words_((n_clbits + 63) / 64, 0) {}
+
+    inline Reference operator[](const std::size_t clbit)
+    {
+        if (clbit / 64 >= words_.size())
+            words_.resize(clbit / 64 + 1, 0);
+        return {words_[clbit / 64], clbit % 64};
+    }
+
+    inline bool test(const std::size_t clbit) const { return (word_(clbit / 64) >> (clbit % 64)) & 1; }
+
+    // The 64 clbits from the given one on, the first one in the lowest bit
+    inline std::uint64_t window(const std::size_t first_clbit) const
+    {
+        const std::size_t shift = first_clbit % 64;
+        const std::uint64_t low = word_(first_clbit / 64) >> shift;
+        return shift == 0 ? low : low | (word_(first_clbit / 64 + 1) << (64 - shift));
+    }
+
+private:
+    std::vector<std::uint64_t> words_;
+
+    inline std::uint64_t word_(const std::size_t i) const { return i < words_.size() ? words_[i] : 0; }
+};
+
+// Whether the condition of a c_if holds, with the clbits of its task from zero_clbit
+inline bool cif_holds(const constants::CUNQAInstruction& inst, const ClassicalRegister& creg, const std::size_t zero_clbit = 0)
+{
+    const auto& cif = inst.cif;
+    if (cif.packed)
+        return cif.holds(creg.window(zero_clbit + cif.first_clbit));
+
+    // Clbits too far apart or repeated, one at a time
+    std::size_t matches = 0;
+    for (std::size_t i = 0; i < inst.clbits.size(); i++)
+        matches += creg.test(zero_clbit + inst.clbits[i]) == (i == 0 ? static_cast<bool>(inst.condition) : !cif.negated);
+    switch (cif.operation) {
+    case constants::CifOperation::AND: return matches == inst.clbits.size();
+    case constants::CifOperation::OR:  return matches != 0;
+    case constants::CifOperation::XOR: return matches & 1;
+    }
+    return false;
+}
+
+// Histogram of the classical registers measured in each shot, per task. Registers are counted
+// packed in integers, in a dense array when they are small, and turned into bitstrings only
+// when serialized
+class MeasCounter {
+public:
+    static constexpr std::size_t DENSE_MAX_CLBITS = 12;
+
+    MeasCounter(const std::vector<constants::StructuredQuantumTask>& st_qtasks)
+    {
+        std::size_t zero_clbit = 0;
+        for (const auto& st_qtask : st_qtasks) {
+            std::size_t n_clbits = st_qtask.n_clbits;
+            tasks_.push_back({
+                .id = st_qtask.id,
+                .zero_clbit = zero_clbit,
+                .n_clbits = n_clbits,
+                .dense = std::vector<std::size_t>(n_clbits <= DENSE_MAX_CLBITS ? std::size_t(1) << n_clbits : 0, 0)
+            });
+            zero_clbit += n_clbits;
+        }
+    }
+
+    void add(const ClassicalRegister& creg, const std::size_t n = 1)
+    {
+        for (auto& task : tasks_) {
+            if (task.n_clbits > 64) {
+                task.wide[task.bitstring(creg)] += n;
+                continue;
+            }
+
+            std::uint64_t key = creg.window(task.zero_clbit);
+            if (task.n_clbits < 64)
+                key &= (std::uint64_t(1) << task.n_clbits) - 1;
+
+            if (task.n_clbits <= DENSE_MAX_CLBITS)
+                task.dense[key] += n;
+            else
+                task.sparse[key] += n;
+        }
+    }
+
+    // Both counters must come from the same tasks, as the ones of each thread
+    void merge(const MeasCounter& other)
+    {
+        for (std::size_t t = 0; t < tasks_.size(); t++) {
+            auto& task = tasks_[t];
+            const auto& other_task = other.tasks_[t];
+            for (std::size_t key = 0; key < task.dense.size(); key++)
+                task.dense[key] += other_task.dense[key];
+            for (const auto& [key, counts] : other_task.sparse)
+                task.sparse[key] += counts;
+            for (const auto& [key, counts] : other_task.wide)
+                task.wide[key] += counts;
+        }
+    }
+
+    // Largest standard error of the frequency of an outcome of any task, sqrt(p (1 - p) / shots),
+    // as an estimate of its probability
+    double max_standard_error(const std::size_t shots) const
+    {
+        if (shots == 0)
+            return 1.0;
+        double max_variance = 0.0;
+        auto add = [&max_variance, shots](const std::size_t counts) {
+            const double p = static_cast<double>(counts) / static_cast<double>(shots);
+            max_variance = std::max(max_variance, p * (1.0 - p));
+        };
+        for (const auto& task : tasks_) {
+            for (const auto counts : task.dense)
+                add(counts);
+            for (const auto& [key, counts] : task.sparse)
+                add(counts);
+            for (const auto& [key, counts] : task.wide)
+                add(counts);
+        }
+        return std::sqrt(max_variance / static_cast<double>(shots));
+    }
+
+    // Counts of a task as integers, to be written without their bitstrings. Nothing if it has
+    // more than 64 clbits
+    std::optional<Histogram> histogram(const std::size_t t) const
+    {
+        const auto& task = tasks_[t];
+        if (task.n_clbits > 64)
+            return std::nullopt;
+        Histogram histogram;
+        for (std::size_t key = 0; key < task.dense.size(); key++) {
+            if (task.dense[key] != 0)
+                histogram.emplace_back(key, task.dense[key]);
+        }
+        histogram.insert(histogram.end(), task.sparse.begin(), task.sparse.end());
+        std::sort(histogram.begin(), histogram.end());
+        return histogram;
+    }
+
+    friend void to_json(JSON& j, const MeasCounter& obj)
+    {
+        j = JSON::object();
+        for (const auto& task : obj.tasks_) {
+            JSON counts = JSON::object();
+            for (std::size_t key = 0; key < task.dense.size(); key++) {
+                if (task.dense[key] != 0)
+                    counts[task.bitstring(key)] = task.dense[key];
+            }
+            for (const auto& [key, n] : task.sparse)
+                counts[task.bitstring(key)] = n;
+            for (const auto& [key, n] : task.wide)
+                counts[key] = n;
+            j[task.id] = counts;
+        }
+    }
+
+private:
+    struct TaskCounter {
+        std::string id;
+        std::size_t zero_clbit;
+        std::size_t n_clbits;
+        std::vector<std::size_t> dense; // Up to DENSE_MAX_CLBITS
+        std::unordered_map<std::uint64_t, std::size_t> sparse; // Up to 64 clbits
+        std::unordered_map<std::string, std::size_t> wide;
+
+        // Clbit 0 of the task is the rightmost character
+        std::string bitstring(const std::uint64_t key) const
+        {
+            std::string bits(n_clbits, '0');
+            for (std::size_t i = 0; i < n_clbits; i++)
+                bits[n_clbits - i - 1] = ((key >> i) & 1) ? '1' : '0';
+            return bits;
+        }
+
+        std::string bitstring(const ClassicalRegister& creg) const
+        {
+            std::string bits(n_clbits, '0');
+            for (std::size_t i = 0; i < n_clbits; i++)
+                bits[n_clbits - i - 1] = creg.test(zero_clbit + i) ? '1' : '0';
+            return bits;
+        }
+    };
+
+    std::vector<TaskCounter> tasks_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
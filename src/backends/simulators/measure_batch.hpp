@@ -0,0 +1,90 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "classical_channel/classical_channel.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Measurements sent to other QPUs, grouped by target until the next synchronization point of
+// the shot, a RECV or its end, where each target gets them all in a single frame. The buffers
+// keep their capacity, so a batch reused along many shots stops allocating
+class MeasureBatch {
+public:
+    inline void add(const std::string& target, const bool measurement)
+    {
+        // A shot talks to a handful of QPUs, so a linear search beats hashing the ids
+        for (auto& [pending_target, measurements] : pending_) {
+            if (pending_target == target) {
+                measurements.push_back(measurement);
+                return;
+            }
+        }
+        pending_.push_back({target, {static_cast<std::uint8_t>(measurement)}});
+    }
+
+    inline void flush(comm::ClassicalChannel* classical_channel)
+    {
+        for (auto& [target, measurements] : pending_) {
+            if (!measurements.empty()) {
+                classical_channel->send_measures(measurements, target);
+                measurements.clear();
+            }
+        }
+    }
+
+    // The measurements held back, which shot major blocks send in frames of their own
+    inline const auto& pending() const { return pending_; }
+
+    inline std::span<const std::uint8_t> pending(const std::string& target) const
+    {
+        for (const auto& [pending_target, measurements] : pending_) {
+            if (pending_target == target)
+                return measurements;
+        }
+        return {};
+    }
+
+    inline void clear()
+    {
+        for (auto& [target, measurements] : pending_)
+            measurements.clear();
+    }
+
+    // Sends the pending measurements first, as the origin may be waiting for them
+    inline const std::vector<std::uint8_t>& recv(
+        comm::ClassicalChannel* classical_channel,
+        const std::string& origin,
+        const std::size_t n_measurements
+    )
+    {
+        flush(classical_channel);
+        received_.resize(n_measurements);
+        classical_channel->recv_measures(received_, origin);
+        return received_;
+    }
+
+    // As recv, but nullptr if they have not all arrived yet
+    inline const std::vector<std::uint8_t>* try_recv(
+        comm::ClassicalChannel* classical_channel,
+        const std::string& origin,
+        const std::size_t n_measurements
+    )
+    {
+        flush(classical_channel);
+        received_.resize(n_measurements);
+        return classical_channel->try_recv_measures(received_, origin) ? &received_ : nullptr;
+    }
+
+private:
+    std::vector<std::pair<std::string, std::vector<std::uint8_t>>> pending_;
+    std::vector<std::uint8_t> received_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
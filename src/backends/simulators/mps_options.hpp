@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Controls of the matrix product state method that a task sets in its config, with the names
+// of Aer: the largest bond dimension kept between two qubits, and the singular values below
+// which the bonds are truncated. A low bond dimension bounds the memory of wide circuits whose
+// parts are barely entangled, as those of several QPUs simulated in a single register
+constexpr std::array<std::string_view, 2> MPS_CONFIG_KEYS = {
+    "matrix_product_state_max_bond_dimension",
+    "matrix_product_state_truncation_threshold"
+};
+
+// Passes each control present in the config to the simulator, as the strings that the
+// configuration interfaces of Aer and Maestro take
+template <typename Configure>
+void configure_mps(const JSON& config, Configure&& configure)
+{
+    for (const auto key : MPS_CONFIG_KEYS) {
+        const std::string name(key);
+        const auto value = config.find(name);
+        if (value != config.end())
+            configure(name, value->is_string() ? value->get<std::string>() : value->dump());
+    }
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
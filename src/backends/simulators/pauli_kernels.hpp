@@ -0,0 +1,217 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <span>
+#include <string>
+#include <complex>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+#include "utils/constants.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// A Pauli string P as the bits that it flips and those whose sign it takes, so that
+// P|i> = i^n_y (-1)^popcount(i & phase) |i ^ flip>, with each Y as iXZ. The kernels below apply
+// it, or a rotation about it, in a single sweep of the state whatever its weight, instead of the
+// changes of basis and the ladder of CNOTs of its decomposition
+struct PauliMasks {
+    std::uint64_t flip = 0;
+    std::uint64_t phase = 0;
+    unsigned n_y = 0;
+
+    // i^n_y (-1)^popcount(i & phase), the factor of the amplitude i as P moves it to i ^ flip
+    template <typename T>
+    inline std::complex<T> factor(const std::uint64_t i) const
+    {
+        const unsigned power = (n_y + 2 * (std::popcount(i & phase) % 2)) % 4;
+        return power == 0 ? std::complex<T>(1, 0) : power == 1 ? std::complex<T>(0, 1)
+             : power == 2 ? std::complex<T>(-1, 0) : std::complex<T>(0, -1);
+    }
+};
+
+// The last character of the string on the qubit 0, as in the bitstrings
+inline PauliMasks pauli_masks(std::string_view pauli)
+{
+    const std::size_t n = pauli.size();
+    if (n > 64)
+        throw std::invalid_argument("Pauli string " + std::string(pauli) + " on more than 64 qubits.");
+    PauliMasks masks;
+    for (std::size_t k = 0; k < n; k++) {
+        const char op = pauli[n - 1 - k];
+        const std::uint64_t bit = std::uint64_t(1) << k;
+        switch (op)
+        {
+        case 'I':
+            break;
+        case 'X':
+            masks.flip |= bit;
+            break;
+        case 'Y':
+            masks.flip |= bit;
+            masks.phase |= bit;
+            masks.n_y++;
+            break;
+        case 'Z':
+            masks.phase |= bit;
+            break;
+        default:
+            throw std::invalid_argument("Pauli string " + std::string(pauli) + " with a character other than I, X, Y and Z.");
+        }
+    }
+    return masks;
+}
+
+// The amplitudes of the controls, set at control_value within control_mask, are those updated.
+// Each pair (i, i ^ flip) is visited once, from the one with the highest flipped bit off
+template <typename T, typename Update>
+void for_each_pauli_pair(std::complex<T>* a, const std::size_t n_qubits, const PauliMasks& masks,
+                         const std::uint64_t control_mask, const std::uint64_t control_value, Update update)
+{
+    const std::int64_t dim = std::int64_t(1) << n_qubits;
+    if (masks.flip == 0) {
+        #pragma omp parallel for if (n_qubits >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+        for (std::int64_t i = 0; i < dim; i++) {
+            if ((i & control_mask) == control_value)
+                update(a[i], a[i], i, i);
+        }
+        return;
+    }
+    const int pivot = std::bit_width(masks.flip) - 1;
+    const std::uint64_t low = (std::uint64_t(1) << pivot) - 1;
+    #pragma omp parallel for if (n_qubits >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t r = 0; r < dim / 2; r++) {
+        const std::uint64_t i = ((r & ~low) << 1) | (r & low);
+        if ((i & control_mask) == control_value)
+            update(a[i], a[i ^ masks.flip], i, i ^ masks.flip);
+    }
+}
+
+// P|ψ>
+template <typename T>
+void apply_pauli_string(std::complex<T>* a, const std::size_t n_qubits, const PauliMasks& masks,
+                        const std::uint64_t control_mask = 0, const std::uint64_t control_value = 0)
+{
+    for_each_pauli_pair(a, n_qubits, masks, control_mask, control_value,
+                        [&masks](std::complex<T>& x, std::complex<T>& y, const std::uint64_t i, const std::uint64_t j) {
+        if (i == j) {
+            x *= masks.factor<T>(i);
+            return;
+        }
+        const std::complex<T> xi = x;
+        x = masks.factor<T>(j) * y;
+        y = masks.factor<T>(i) * xi;
+    });
+}
+
+// exp(-iθ/2 P)|ψ> = cos(θ/2)|ψ> - i sin(θ/2) P|ψ>, as the gadgets of QuEST and the rotations
+template <typename T>
+void apply_pauli_gadget(std::complex<T>* a, const std::size_t n_qubits, const PauliMasks& masks, const double theta,
+                        const std::uint64_t control_mask = 0, const std::uint64_t control_value = 0)
+{
+    const T c = std::cos(theta / 2);
+    const std::complex<T> minus_i_s(0, -std::sin(theta / 2));
+    for_each_pauli_pair(a, n_qubits, masks, control_mask, control_value,
+                        [&](std::complex<T>& x, std::complex<T>& y, const std::uint64_t i, const std::uint64_t j) {
+        if (i == j) {
+            x *= c + minus_i_s * masks.factor<T>(i);
+            return;
+        }
+        const std::complex<T> xi = x;
+        x = c * x + minus_i_s * masks.factor<T>(j) * y;
+        y = c * y + minus_i_s * masks.factor<T>(i) * xi;
+    });
+}
+
+// <ψ|P|ψ>, real as P is Hermitian
+template <typename T>
+double pauli_expectation(const std::complex<T>* a, const std::size_t n_qubits, const PauliMasks& masks)
+{
+    const std::int64_t dim = std::int64_t(1) << n_qubits;
+    double re = 0.0;
+    #pragma omp parallel for reduction(+:re) if (n_qubits >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i++)
+        re += (std::conj(a[i ^ masks.flip]) * masks.factor<T>(i) * a[i]).real();
+    return re;
+}
+
+// out += coefficient P|ψ>, for the terms of an observable applied one after another
+template <typename T>
+void add_pauli_term(const std::complex<T>* a, std::complex<T>* out, const std::size_t n_qubits, const PauliMasks& masks,
+                    const double coefficient)
+{
+    const std::int64_t dim = std::int64_t(1) << n_qubits;
+    #pragma omp parallel for if (n_qubits >= STATEVECTOR_PARALLEL_MIN_QUBITS)
+    for (std::int64_t i = 0; i < dim; i++) {
+        const std::uint64_t j = i ^ masks.flip;
+        out[i] += static_cast<T>(coefficient) * masks.factor<T>(j) * a[j];
+    }
+}
+
+// Controls of the instructions of Pauli strings and of rotations about them, whose strings act on
+// the whole register as in QuEST, the last character on the qubit 0: none for "paulistr" and
+// "pauligadget", the first qubit for the controlled ones and all of them for the multicontrolled
+inline std::size_t pauli_controls(const constants::CUNQAInstruction& inst)
+{
+    switch (inst.type)
+    {
+    case constants::CPAULISTR: case constants::CPAULIGADGET:
+        return 1;
+    case constants::MCPAULISTR: case constants::MCPAULIGADGET:
+        return inst.qubits.size();
+    default:
+        return 0;
+    }
+}
+
+// The instructions that the kernels run
+inline bool is_pauli_instruction(const constants::CUNQAInstruction& inst)
+{
+    switch (inst.type)
+    {
+    case constants::PAULISTR: case constants::CPAULISTR: case constants::MCPAULISTR:
+        break;
+    case constants::PAULIGADGET: case constants::CPAULIGADGET: case constants::MCPAULIGADGET:
+        if (inst.params.empty())
+            return false;
+        break;
+    default:
+        return false;
+    }
+    const std::size_t n_controls = pauli_controls(inst);
+    return !inst.paulistr.empty() && inst.qubits.size() >= n_controls &&
+           (inst.type == constants::PAULISTR || inst.type == constants::PAULIGADGET || n_controls > 0) &&
+           (!inst.states || inst.states->size() == n_controls);
+}
+
+// Applies an instruction of is_pauli_instruction with the controls on the qubits given, those of
+// the instruction or where the simulator placed them
+template <typename T>
+void apply_pauli_instruction(std::complex<T>* a, const std::size_t n_qubits, const constants::CUNQAInstruction& inst,
+                             std::span<const int> qubits)
+{
+    const PauliMasks masks = pauli_masks(inst.paulistr);
+    if (inst.paulistr.size() > n_qubits)
+        throw std::invalid_argument("Pauli string " + inst.paulistr + " acts on more qubits than the state has.");
+    std::uint64_t control_mask = 0, control_value = 0;
+    for (std::size_t c = 0; c < pauli_controls(inst); c++) {
+        const std::uint64_t bit = std::uint64_t(1) << qubits[c];
+        control_mask |= bit;
+        if (!inst.states || (*inst.states)[c])
+            control_value |= bit;
+    }
+    if ((masks.flip | masks.phase) & control_mask)
+        throw std::invalid_argument("The controls of the Pauli string " + inst.paulistr + " are among its qubits.");
+
+    if (inst.type == constants::PAULISTR || inst.type == constants::CPAULISTR || inst.type == constants::MCPAULISTR)
+        apply_pauli_string(a, n_qubits, masks, control_mask, control_value);
+    else
+        apply_pauli_gadget(a, n_qubits, masks, inst.params[0], control_mask, control_value);
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
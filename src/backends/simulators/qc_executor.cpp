@@ -0,0 +1,40 @@
+#include "qc_executor.hpp"
+#include "qc_pipeline.hpp"
+#include "quantum_task.hpp"
+
+#include "classical_channel/rendezvous.hpp"
+#include "logger.hpp"
+
+using namespace std::string_literals;
+
+namespace cunqa {
+namespace sim {
+
+QCExecutor::QCExecutor(const std::size_t& n_qpus) :
+    classical_channel{std::getenv("SLURM_JOB_ID") + "_executor"s}
+{
+    JSON ids = comm::Rendezvous::of_job()->wait_for(std::getenv("SLURM_JOB_ID") + "_"s, n_qpus);
+
+    classical_channel.publish();
+    for (const auto& [key, _]: ids.items()) {
+        qpu_ids.push_back(key);
+        classical_channel.connect(key);
+        classical_channel.send_info("ready", key);
+    }
+}
+
+std::size_t QCExecutor::n_workers() const
+{
+    return QCPipeline::default_workers(qpu_ids.size());
+}
+
+void QCExecutor::run()
+{
+    QCPipeline pipeline(classical_channel, qpu_ids, [this](std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) {
+        return simulate(std::move(quantum_tasks), classical_channel, worker);
+    }, n_workers());
+    pipeline.run();
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "classical_channel/classical_channel.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+class QuantumTask;
+
+namespace sim {
+
+// Executor of the QPUs of a job with quantum communications: it meets them, and simulates their
+// rounds through a QCPipeline. Each simulator only tells how to simulate the tasks of a round
+class QCExecutor {
+public:
+    QCExecutor(const std::size_t& n_qpus);
+    virtual ~QCExecutor() = default;
+
+    void run();
+
+protected:
+    comm::ClassicalChannel classical_channel;
+    std::vector<std::string> qpu_ids;
+
+    // Workers of the pipeline, for the executors that keep some state per worker or that can
+    // only simulate from one thread
+    virtual std::size_t n_workers() const;
+
+    // Simulates the tasks of a round as a single computation, returning their "id_counts". The
+    // tasks are moved into the adapters. The worker is the one of the pipeline that runs it
+    virtual JSON simulate(std::vector<QuantumTask>&& quantum_tasks, comm::ClassicalChannel* classical_channel, std::size_t worker) = 0;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
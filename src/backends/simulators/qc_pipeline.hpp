@@ -0,0 +1,281 @@
+#pragma once
+
+#include <queue>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "quantum_task.hpp"
+#include "classical_channel/classical_channel.hpp"
+#include "utils/json.hpp"
+#include "utils/helpers/trace.hpp"
+#include "utils/helpers/perf_counters.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Rounds of the executors of the quantum communications. Tasks are received from whichever QPU
+// sends first, and the tasks that communicate with each other, directly or through others, are
+// simulated together as a job as soon as all of them have arrived. Jobs share nothing, so a
+// pool of workers simulates them at the same time and a late QPU only delays its own job.
+class QCPipeline {
+public:
+    // Simulates the tasks of a job as a single computation, returning their "id_counts". The
+    // tasks are its own, to move into the adapters. The worker tells which one runs it, for the
+    // state a worker keeps along its jobs
+    using Simulate = std::function<JSON(std::vector<QuantumTask>&&, comm::ClassicalChannel*, std::size_t worker)>;
+
+    static int available_cores()
+    {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return std::max(1u, std::thread::hardware_concurrency());
+#endif
+    }
+
+    // There are never more jobs than QPUs, nor is it worth more workers than cores
+    static std::size_t default_workers(const std::size_t n_qpus)
+    {
+        return std::max<std::size_t>(1, std::min<std::size_t>(n_qpus, available_cores()));
+    }
+
+    QCPipeline(comm::ClassicalChannel& classical_channel, const std::vector<std::string>& qpu_ids, Simulate simulate) :
+        QCPipeline(classical_channel, qpu_ids, std::move(simulate), default_workers(qpu_ids.size()))
+    { }
+
+    QCPipeline(comm::ClassicalChannel& classical_channel, const std::vector<std::string>& qpu_ids, Simulate simulate,
+               const std::size_t n_workers) :
+        classical_channel_{classical_channel},
+        qpu_ids_{qpu_ids},
+        simulate_{std::move(simulate)},
+        cores_{available_cores()}
+    {
+        for (std::size_t worker_id = 0; worker_id < n_workers; worker_id++)
+            workers_.emplace_back([this, worker_id] { work_(worker_id); });
+        LOGGER_DEBUG("Executor pipeline with {} worker(s) for {} QPU(s).", n_workers, qpu_ids_.size());
+    }
+
+    ~QCPipeline()
+    {
+        {
+            std::lock_guard lock(jobs_mutex_);
+            stopping_ = true;
+        }
+        jobs_condition_.notify_all();
+        for (auto& worker : workers_)
+            worker.join();
+    }
+
+    void run()
+    {
+        while (true) {
+            auto [qpu_id, message] = classical_channel_.recv_info_any(qpu_ids_);
+            if (message.empty())
+                continue;
+
+            // The last task of each QPU stays decoded, so a round that only changes the
+            // parameters is applied in place
+            auto& quantum_task = last_tasks_[qpu_id];
+            try {
+                quantum_task.update_circuit(message);
+            } catch (const std::exception& e) {
+                LOGGER_ERROR("Error reading the task of QPU {}: {}", qpu_id, e.what());
+                last_tasks_.erase(qpu_id);
+                std::lock_guard lock(send_mutex_);
+                classical_channel_.send_info(JSON({{"ERROR", std::string(e.what())}}).dump(), qpu_id);
+                continue;
+            }
+
+            // The only copy of the task, the rest of the way it is moved
+            pending_.insert_or_assign(qpu_id, quantum_task);
+            dispatch_(qpu_id);
+        }
+    }
+
+private:
+    struct Job {
+        std::vector<std::string> qpus; // In the order of qpu_ids, as the tasks of the rounds used to be
+        std::vector<std::string> ids; // Of the tasks, which the simulation consumes
+        std::vector<QuantumTask> quantum_tasks;
+    };
+
+    comm::ClassicalChannel& classical_channel_;
+    std::vector<std::string> qpu_ids_;
+    Simulate simulate_;
+    int cores_;
+
+    std::unordered_map<std::string, QuantumTask> last_tasks_; // Last task received from each QPU
+    std::unordered_map<std::string, QuantumTask> pending_; // Tasks waiting for their peers, by QPU
+    std::unordered_map<std::string, std::vector<std::string>> peers_;
+
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_condition_;
+    std::queue<Job> jobs_;
+    std::size_t running_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    std::mutex send_mutex_; // The channel sends from one thread at a time
+
+    // QPUs of the executor that the task sends to or receives from
+    std::vector<std::string> peers_of_(const QuantumTask& quantum_task) const
+    {
+        std::unordered_set<std::string> peers(quantum_task.sending_to.begin(), quantum_task.sending_to.end());
+        for (const auto& instruction : quantum_task.instructions)
+            peers.insert(instruction.qpus.begin(), instruction.qpus.end());
+        for (const auto& instruction : quantum_task.circuit) {
+            if (instruction.contains("qpus"))
+                for (const auto& qpu : instruction.at("qpus"))
+                    peers.insert(qpu.get<std::string>());
+        }
+
+        std::vector<std::string> in_executor;
+        for (const auto& qpu_id : qpu_ids_) {
+            if (peers.contains(qpu_id))
+                in_executor.push_back(qpu_id);
+        }
+        return in_executor;
+    }
+
+    // Queues the job of the QPU if every task it communicates with has arrived. Communications
+    // go both ways, so a task also belongs with the pending ones that name it
+    void dispatch_(const std::string& qpu_id)
+    {
+        peers_[qpu_id] = peers_of_(pending_.at(qpu_id));
+
+        std::unordered_set<std::string> group{qpu_id};
+        std::vector<std::string> to_visit{qpu_id};
+        while (!to_visit.empty()) {
+            auto current = std::move(to_visit.back());
+            to_visit.pop_back();
+
+            std::vector<std::string> neighbours = peers_.at(current);
+            for (const auto& [other, _] : pending_) {
+                const auto& other_peers = peers_.at(other);
+                if (std::find(other_peers.begin(), other_peers.end(), current) != other_peers.end())
+                    neighbours.push_back(other);
+            }
+
+            for (const auto& neighbour : neighbours) {
+                if (!pending_.contains(neighbour))
+                    return;
+                if (group.insert(neighbour).second)
+                    to_visit.push_back(neighbour);
+            }
+        }
+
+        Job job;
+        for (std::size_t i = 0; i < qpu_ids_.size(); i++) {
+            if (!group.contains(qpu_ids_[i]))
+                continue;
+
+            auto quantum_task = std::move(pending_.at(qpu_ids_[i]));
+            pending_.erase(qpu_ids_[i]);
+            peers_.erase(qpu_ids_[i]);
+
+            // Results are told apart by task id, so repeated ids get the position of their QPU
+            for (const auto& other : job.ids) {
+                if (other == quantum_task.id) {
+                    quantum_task.id += "_" + std::to_string(i);
+                    break;
+                }
+            }
+            job.qpus.push_back(qpu_ids_[i]);
+            job.ids.push_back(quantum_task.id);
+            job.quantum_tasks.push_back(std::move(quantum_task));
+        }
+
+        {
+            std::lock_guard lock(jobs_mutex_);
+            jobs_.push(std::move(job));
+        }
+        jobs_condition_.notify_one();
+    }
+
+    void work_(const std::size_t worker_id)
+    {
+        while (true) {
+            Job job;
+            std::size_t running;
+            {
+                std::unique_lock lock(jobs_mutex_);
+                jobs_condition_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_)
+                    return;
+                job = std::move(jobs_.front());
+                jobs_.pop();
+                running = ++running_;
+            }
+
+#ifdef _OPENMP
+            // The cores are shared among the jobs running when this one starts
+            omp_set_num_threads(std::max(1, cores_ / static_cast<int>(running)));
+#endif
+            const auto started = Trace::Clock::now();
+            std::optional<PerfCounters> perf_counters;
+            if (std::any_of(job.quantum_tasks.begin(), job.quantum_tasks.end(), [](const auto& quantum_task) {
+                    return quantum_task.config.value("perf_counters", false);
+                }))
+                perf_counters.emplace();
+            JSON result = simulate_job_(job, worker_id);
+            if (perf_counters)
+                result["perf_counters"] = perf_counters->stop();
+            if (Trace::enabled())
+                Trace::of_process().span("round", "executor", started, Trace::Clock::now(), {{"qpus", job.qpus}});
+            send_results_(job, result);
+
+            std::lock_guard lock(jobs_mutex_);
+            running_--;
+        }
+    }
+
+    JSON simulate_job_(Job& job, const std::size_t worker_id)
+    {
+        try {
+            return simulate_(std::move(job.quantum_tasks), &classical_channel_, worker_id);
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Error simulating the tasks of {} QPU(s): {}", job.qpus.size(), e.what());
+            return {{"ERROR", std::string(e.what())}};
+        }
+    }
+
+    void send_results_(const Job& job, const JSON& result)
+    {
+        std::lock_guard lock(send_mutex_);
+        for (std::size_t i = 0; i < job.qpus.size(); i++) {
+            JSON qpu_result = result;
+            if (!result.contains("ERROR")) {
+                try {
+                    qpu_result = {
+                        {"counts", result.at("id_counts").at(job.ids[i])},
+                        {"time_taken", result.at("time_taken")}
+                    };
+                    if (result.contains("scheduler"))
+                        qpu_result["scheduler"] = result.at("scheduler");
+                    if (result.contains("perf_counters"))
+                        qpu_result["perf_counters"] = result.at("perf_counters");
+                } catch (const std::exception& e) {
+                    qpu_result = {{"ERROR", std::string(e.what())}};
+                }
+            }
+            classical_channel_.send_info(qpu_result.dump(), job.qpus[i]);
+        }
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
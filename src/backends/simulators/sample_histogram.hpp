@@ -0,0 +1,193 @@
+#pragma once
+
+#include <bit>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Outcomes of a sampling, in increasing order, with the number of shots of each
+using Histogram = std::vector<std::pair<std::uint64_t, std::size_t>>;
+
+// Uniforms in [0, 1) generated already sorted, one after another (Bentley and Saxe), so that
+// sampling does not store nor sort a vector as long as the shots
+class SortedUniforms {
+public:
+    SortedUniforms(const std::size_t n, const std::uint64_t seed) : remaining_{n}, rng_{seed} {}
+
+    inline bool empty() const { return remaining_ == 0; }
+
+    inline double next()
+    {
+        // The complement of the smallest of the n left is the largest of n uniforms, U^(1/n)
+        complement_ *= std::pow(1.0 - uniform_(rng_), 1.0 / static_cast<double>(remaining_--));
+        return 1.0 - complement_;
+    }
+
+private:
+    std::size_t remaining_;
+    double complement_ = 1.0;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+};
+
+// Draws the outcomes of measuring all the qubits in `shots` shots from the probabilities of
+// the basis states, given by index, in a single sweep of their cumulative probability. Only
+// the distinct outcomes are kept, and the shots that rounding leaves past the total
+// probability go to the last outcome that can happen
+template <typename Probability>
+Histogram sample_histogram(const std::uint64_t n_states, Probability&& probability, const std::size_t shots, const std::uint64_t seed)
+{
+    Histogram histogram;
+    SortedUniforms uniforms(shots, seed);
+    std::size_t left = shots;
+    double next = uniforms.empty() ? 0.0 : uniforms.next();
+    double cumulative = 0.0;
+    std::uint64_t last = 0;
+
+    for (std::uint64_t state = 0; state < n_states && left > 0; state++) {
+        const double p = probability(state);
+        if (p <= 0.0)
+            continue;
+        last = state;
+        cumulative += p;
+
+        std::size_t count = 0;
+        while (left > 0 && next < cumulative) {
+            count++;
+            if (--left > 0)
+                next = uniforms.next();
+        }
+        if (count > 0)
+            histogram.emplace_back(state, count);
+    }
+
+    if (left > 0) {
+        if (!histogram.empty() && histogram.back().first == last)
+            histogram.back().second += left;
+        else
+            histogram.emplace_back(last, left);
+    }
+    return histogram;
+}
+
+// Probabilities of the outcomes of measuring the given qubits, bit j of each outcome being the
+// measurement of qubits[j], reduced in a single parallel pass over the basis states. The index
+// of each state is mapped to its outcome a byte at a time, with a table per byte
+template <typename Probability>
+std::vector<double> marginal_probabilities(const std::uint64_t n_states, Probability&& probability, const std::vector<std::uint64_t>& qubits)
+{
+    const std::size_t n_bytes = (std::bit_width(n_states > 1 ? n_states - 1 : 1) + 7) / 8;
+    std::vector<std::array<std::uint64_t, 256>> tables(n_bytes, std::array<std::uint64_t, 256>{});
+    for (std::size_t j = 0; j < qubits.size(); j++) {
+        if (qubits[j] / 8 >= n_bytes)
+            continue;
+        for (std::uint64_t byte = 0; byte < 256; byte++)
+            tables[qubits[j] / 8][byte] |= ((byte >> (qubits[j] % 8)) & 1) << j;
+    }
+
+    std::vector<double> marginal(std::size_t(1) << qubits.size(), 0.0);
+    #pragma omp parallel if (n_states >= (std::uint64_t(1) << 16))
+    {
+        std::vector<double> local(marginal.size(), 0.0);
+        #pragma omp for nowait
+        for (std::int64_t i = 0; i < static_cast<std::int64_t>(n_states); i++) {
+            std::uint64_t outcome = 0;
+            for (std::size_t b = 0; b < n_bytes; b++)
+                outcome |= tables[b][(static_cast<std::uint64_t>(i) >> (8 * b)) & 0xff];
+            local[outcome] += probability(static_cast<std::uint64_t>(i));
+        }
+        #pragma omp critical
+        {
+            for (std::size_t k = 0; k < marginal.size(); k++)
+                marginal[k] += local[k];
+        }
+    }
+    return marginal;
+}
+
+// Qubits measured at most for a marginal, whose 2^k outcomes are reduced per thread
+constexpr std::size_t MARGINAL_MAX_QUBITS = 20;
+
+// Histogram of the classical register, of at most 64 clbits, after the measurements at the end
+// of a circuit, pairs of qubit and clbit. The shots are drawn from the marginal of the measured
+// qubits when they are few, instead of from the 2^n basis states
+template <typename Probability>
+Histogram sample_measured(const std::uint64_t n_states, Probability&& probability,
+                          const std::vector<std::pair<std::uint64_t, std::size_t>>& measures,
+                          const std::size_t shots, const std::uint64_t seed)
+{
+    std::vector<std::uint64_t> qubits;
+    std::vector<std::pair<std::size_t, std::size_t>> bits; // Bit of the sampled outcome of each clbit
+    for (const auto& [qubit, clbit] : measures) {
+        const auto position = std::find(qubits.begin(), qubits.end(), qubit) - qubits.begin();
+        if (position == static_cast<std::ptrdiff_t>(qubits.size()))
+            qubits.push_back(qubit);
+        bits.emplace_back(position, clbit);
+    }
+
+    Histogram sampled;
+    if (qubits.size() <= MARGINAL_MAX_QUBITS && (std::uint64_t(1) << qubits.size()) < n_states) {
+        const auto marginal = marginal_probabilities(n_states, probability, qubits);
+        sampled = sample_histogram(marginal.size(), [&marginal](const std::uint64_t i) { return marginal[i]; }, shots, seed);
+    } else {
+        sampled = sample_histogram(n_states, probability, shots, seed);
+        for (auto& [bit, clbit] : bits)
+            bit = qubits[bit];
+    }
+
+    std::map<std::uint64_t, std::size_t> registers;
+    for (const auto& [outcome, count] : sampled) {
+        std::uint64_t creg = 0;
+        for (const auto& [bit, clbit] : bits)
+            creg |= ((outcome >> bit) & 1) << clbit;
+        registers[creg] += count;
+    }
+    return Histogram(registers.begin(), registers.end());
+}
+
+// Measurements of a circuit whose counts are sampled at its end, pairs of qubit and clbit, the
+// last one of each clbit. Empty if any clbit does not fit in the 64 bits of a Histogram
+inline std::vector<std::pair<std::uint64_t, std::size_t>> measured_bits(const std::vector<JSON>& circuit)
+{
+    std::map<std::size_t, std::uint64_t> qubit_of;
+    for (const auto& instruction : circuit) {
+        if (instruction.at("name") != "measure")
+            continue;
+        const auto clbit = instruction.at("clbits")[0].get<std::size_t>();
+        if (clbit >= 64)
+            return {};
+        qubit_of[clbit] = instruction.at("qubits")[0].get<std::uint64_t>();
+    }
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> measures;
+    for (const auto& [clbit, qubit] : qubit_of)
+        measures.emplace_back(qubit, clbit);
+    return measures;
+}
+
+// Counts with the outcomes as bitstrings of n_bits, bit 0 the rightmost, built once per outcome
+inline JSON histogram_to_counts(const Histogram& histogram, const std::size_t n_bits)
+{
+    JSON counts = JSON::object();
+    std::string bitstring(n_bits, '0');
+    for (const auto& [outcome, count] : histogram) {
+        for (std::size_t i = 0; i < n_bits; i++)
+            bitstring[n_bits - 1 - i] = i < 64 && ((outcome >> i) & 1) ? '1' : '0';
+        counts[bitstring] = count;
+    }
+    return counts;
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "utils/json.hpp"
+#include "backends/simulators/meas_counter.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Shots between the convergence checks of a job that does not set "convergence_block"
+constexpr std::size_t DEFAULT_CONVERGENCE_BLOCK = 1000;
+
+// Shots that a loop under a ShotConvergence has run, and the standard error of their counts
+struct ShotProgress {
+    std::size_t shots = 0;
+    double standard_error = 0.0;
+    bool converged = false;
+};
+
+// Stopping rule of the shot loops of a job sent with "target_standard_error": its shots are a
+// ceiling, run in blocks of "convergence_block", and the loop stops after the first block at whose
+// end no frequency of the counts has a larger standard error as an estimate of its probability,
+// see MeasCounter::max_standard_error. The loops of the tasks with classical communications run all
+// their shots, as the QPUs that talk to each other have to run the same
+struct ShotConvergence {
+    double target_error = 0.0; // None if not positive
+    std::size_t block = DEFAULT_CONVERGENCE_BLOCK;
+
+    static ShotConvergence from_config(const JSON& config, const bool communicates)
+    {
+        if (communicates)
+            return {};
+        return {config.value("target_standard_error", 0.0), config.value("convergence_block", DEFAULT_CONVERGENCE_BLOCK)};
+    }
+
+    inline bool enabled() const { return target_error > 0.0; }
+    // Shots of each block, all of them at once if there is no target
+    inline std::size_t block_of(const std::size_t shots) const { return enabled() ? std::max<std::size_t>(block, 1) : shots; }
+    inline bool converged(const double standard_error) const { return standard_error <= target_error; }
+
+    // What the result tells of the shots run
+    inline JSON report(const std::size_t shots, const double standard_error) const
+    {
+        return {{"shots", shots}, {"standard_error", standard_error}, {"converged", converged(standard_error)}};
+    }
+    inline JSON report(const ShotProgress& progress) const { return report(progress.shots, progress.standard_error); }
+
+    // Runs the shots through run_shot, that takes the index of a shot and the counter to add it
+    // to, block by block, and stops after the first block whose counts converge. Every thread of
+    // the parallel region it is called from, if any, calls it with the same counter and progress,
+    // takes its share of the shots of each block and merges its counts after it, so that they all
+    // leave after the same block
+    template <typename RunShot>
+    void run_blocks(const std::vector<constants::StructuredQuantumTask>& st_qtasks, const std::size_t shots, MeasCounter& counter,
+                    ShotProgress& progress, RunShot run_shot) const
+    {
+        MeasCounter local_counter(st_qtasks);
+        const std::size_t block_shots = block_of(shots);
+        for (std::size_t first = 0; first < shots && !progress.converged; first += block_shots) {
+            const std::size_t last = std::min(shots, first + block_shots);
+            #pragma omp for
+            for (std::size_t i = first; i < last; i++)
+                run_shot(i, local_counter);
+
+            #pragma omp critical
+            counter.merge(local_counter);
+            local_counter = MeasCounter(st_qtasks);
+            #pragma omp barrier
+            #pragma omp single
+            {
+                progress.shots = last;
+                progress.standard_error = counter.max_standard_error(last);
+                progress.converged = enabled() && converged(progress.standard_error);
+            }
+        }
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+
+#include "classical_channel/classical_channel.hpp"
+#include "backends/simulators/flat_queue.hpp"
+#include "backends/simulators/measure_batch.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Measurements received for the RECVs of a shot run shot major, by origin
+class MeasureInbox {
+public:
+    inline FlatQueue<std::uint8_t>& of(const std::string& origin)
+    {
+        for (auto& [inbox_origin, measurements] : inboxes_) {
+            if (inbox_origin == origin)
+                return measurements;
+        }
+        inboxes_.push_back({origin, {}});
+        return inboxes_.back().second;
+    }
+
+    inline void clear()
+    {
+        for (auto& [origin, measurements] : inboxes_)
+            measurements.clear();
+    }
+
+private:
+    std::vector<std::pair<std::string, FlatQueue<std::uint8_t>>> inboxes_;
+};
+
+// Exchange of the measurements of a block of shots run in lockstep, shot major: the vQPUs run
+// every shot of the block up to its next RECV and then send each target a single frame with the
+// measurements of all of them, so a block pays a round trip per communication point instead of
+// one per shot. A frame holds, shot by shot, the number of measurements of the shot in two bytes
+// and then the measurements, so every vQPU has to run the same shots in blocks of the same size.
+// The shots only need a measure_batch, where their SENDs leave the measurements, and an inbox
+class ShotExchange {
+public:
+    // Sends each target the measurements that the shots hold for it
+    template <typename Shots>
+    void send(Shots& shots, comm::ClassicalChannel* classical_channel)
+    {
+        targets_.clear();
+        for (const auto& shot : shots) {
+            for (const auto& [target, measurements] : shot.measure_batch.pending()) {
+                if (!measurements.empty() && std::find(targets_.begin(), targets_.end(), target) == targets_.end())
+                    targets_.push_back(target);
+            }
+        }
+
+        for (const auto& target : targets_) {
+            frame_.clear();
+            for (const auto& shot : shots) {
+                const auto measurements = shot.measure_batch.pending(target);
+                if (measurements.size() > UINT16_MAX)
+                    throw std::length_error("More than 65535 measurements sent by a shot at once.");
+                frame_.push_back(measurements.size() & 0xff);
+                frame_.push_back(measurements.size() >> 8);
+                frame_.insert(frame_.end(), measurements.begin(), measurements.end());
+            }
+            classical_channel->send_measures(frame_, target);
+        }
+        for (auto& shot : shots)
+            shot.measure_batch.clear();
+    }
+
+    // Waits for a frame from any of the origins, whichever comes first, and leaves the
+    // measurements of each shot in its inbox
+    template <typename Shots>
+    void recv(Shots& shots, std::span<const std::string> origins, comm::ClassicalChannel* classical_channel)
+    {
+        while (true) {
+            for (const auto& origin : origins) {
+                if (classical_channel->try_recv_measures(size_, origin)) {
+                    read_(shots, origin, classical_channel);
+                    return;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::vector<std::string> targets_;
+    std::vector<std::uint8_t> frame_;
+    std::vector<std::uint8_t> size_ = std::vector<std::uint8_t>(2);
+
+    // With the size of the first shot already read
+    template <typename Shots>
+    void read_(Shots& shots, const std::string& origin, comm::ClassicalChannel* classical_channel)
+    {
+        bool first = true;
+        for (auto& shot : shots) {
+            if (!first)
+                classical_channel->recv_measures(size_, origin);
+            first = false;
+
+            frame_.resize(size_[0] | (size_[1] << 8));
+            if (!frame_.empty())
+                classical_channel->recv_measures(frame_, origin);
+            auto& inbox = shot.inbox.of(origin);
+            for (const auto measurement : frame_)
+                inbox.push(measurement);
+        }
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Below this size the threads of the simulator cost more than they save on each gate
+constexpr std::size_t STATEVECTOR_PARALLEL_MIN_QUBITS = 14;
+// Above this size one statevector per thread takes too much memory
+constexpr std::size_t SHOT_PARALLEL_MAX_QUBITS = 24;
+
+// Threads that the vQPU left to the task, which the simulators that size their own pools take
+inline unsigned available_threads()
+{
+#ifdef _OPENMP
+    return std::max(1, omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
+// Whether the shots of a dynamic circuit are split among the threads, with one simulator each,
+// instead of leaving the threads to the simulator to split the statevector. The "shot_parallel"
+// option of the config overrides the choice.
+inline bool parallelize_shots(const JSON& config, const std::size_t n_qubits, const std::size_t shots)
+{
+    if (config.contains("shot_parallel"))
+        return config.at("shot_parallel").get<bool>();
+
+#ifdef _OPENMP
+    std::size_t n_threads = omp_get_max_threads();
+    if (n_threads < 2 || shots < 2)
+        return false;
+    if (n_qubits < STATEVECTOR_PARALLEL_MIN_QUBITS)
+        return true;
+    // A matrix product state grows with its bonds, not with 2^n, so even the wide ones fit once
+    // per thread
+    if (config.value("method", std::string()) == "matrix_product_state")
+        return shots >= n_threads;
+    return n_qubits <= SHOT_PARALLEL_MAX_QUBITS && shots >= n_threads;
+#else
+    return false;
+#endif
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <limits>
+#include <random>
+#include <cstdint>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Counter based generator of the random numbers of one shot. Its stream only depends on the seed
+// of the simulation and on the index of the shot, so the counts of a seeded simulation are the
+// same whatever the number of threads and the order in which they run the shots.
+class ShotRng {
+public:
+    using result_type = std::uint64_t;
+
+    ShotRng(const std::uint64_t seed, const std::size_t shot) :
+        key_{mix_(seed ^ mix_(shot + 1))}
+    { }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    inline result_type operator()() { return mix_(key_ + ++counter_ * GOLDEN_GAMMA); }
+
+    // Uniform in [0, 1)
+    inline double uniform() { return static_cast<double>(operator()() >> 11) * 0x1.0p-53; }
+
+private:
+    static constexpr std::uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+    std::uint64_t key_;
+    std::uint64_t counter_ = 0;
+
+    // SplitMix64 finalizer
+    static constexpr std::uint64_t mix_(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+};
+
+// The "seed" of the config, or a random one for unseeded simulations
+inline std::uint64_t simulation_seed(const JSON& config)
+{
+    if (config.contains("seed"))
+        return config.at("seed").get<std::uint64_t>();
+    return (static_cast<std::uint64_t>(std::random_device{}()) << 32) | std::random_device{}();
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <vector>
+
 #include "quantum_task.hpp"
 #include "utils/json.hpp"
+#include "utils/helpers/result_writer.hpp"
 
 namespace cunqa {
 namespace sim {
@@ -14,6 +17,38 @@ public:
 
     virtual inline std::string get_name() const = 0;
     virtual JSON execute(const T& backend, const QuantumTask& circuit) = 0;
+    // The result written into the reply, for the simulators that keep the counts as integers
+    virtual void execute_into(const T& backend, const QuantumTask& circuit, ResultWriter& writer)
+    {
+        writer.write(execute(backend, circuit));
+    }
+    // The results of several circuits, as {"batch": [...]}, for the simulators that run them together
+    virtual JSON execute_tasks(const T& backend, const std::vector<QuantumTask>& quantum_tasks)
+    {
+        JSON results = JSON::array();
+        for (const auto& quantum_task : quantum_tasks)
+            results.push_back(execute(backend, quantum_task));
+        return {{"batch", results}};
+    }
+    // The results of the circuit under each parameter set of its pending batch, as {"batch": [...]},
+    // for the simulators that run several sets together. The task keeps the last set
+    virtual JSON execute_batch(const T& backend, QuantumTask& quantum_task)
+    {
+        JSON results = JSON::array();
+        for (const auto& params : quantum_task.params_batch) {
+            quantum_task.assign_params(params);
+            results.push_back(execute(backend, quantum_task));
+        }
+        return {{"batch", results}};
+    }
+    // Expectation values of the observables of the config with their gradient by the parameters of
+    // the circuit, for the simulators that compute it from the state
+    virtual JSON execute_gradient([[maybe_unused]] const T& backend, [[maybe_unused]] const QuantumTask& quantum_task)
+    {
+        return {{"ERROR", "The simulator " + get_name() + " does not compute gradients, Cunqa does."}};
+    }
+    // Reads once what the simulator keeps from the backend, as its noise model, when the backend is built
+    virtual void configure([[maybe_unused]] const T& backend) {}
 };
 
 } // End of sim namespace
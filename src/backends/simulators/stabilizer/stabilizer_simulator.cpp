@@ -0,0 +1,246 @@
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include "stabilizer_simulator.hpp"
+#include "stabilizer_tableau.hpp"
+
+#include "utils/constants.hpp"
+#include "backends/simulators/meas_counter.hpp"
+#include "backends/simulators/measure_batch.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "backends/simulators/shot_convergence.hpp"
+
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+using namespace cunqa::constants;
+
+// Throws on the first instruction that the tableau cannot run, before the shots start, and tells
+// whether the circuit talks to other QPUs, in which case its shots run in order
+bool check_instructions(const std::vector<CUNQAInstruction>& instructions)
+{
+    bool communicates = false;
+    for (const auto& inst : instructions) {
+        switch (inst.type)
+        {
+        case ID: case X: case Y: case Z: case H: case S: case SDG: case SX: case SXDG:
+        case CX: case CY: case CZ: case SWAP:
+        case MEASURE: case RESET: case BARRIER:
+            break;
+        case COPY:
+            if (inst.l_clbits.size() != inst.r_clbits.size())
+                throw std::runtime_error("The number of copied clbits and the number of clbits "
+                                         "copied on does not match.");
+            break;
+        case SEND:
+        case RECV:
+            communicates = true;
+            break;
+        case CIF:
+            communicates |= check_instructions(inst.instructions);
+            break;
+        default:
+            throw std::runtime_error("Instruction " + inst.name + " is not supported by the stabilizer method");
+        }
+    }
+    return communicates;
+}
+
+struct StabilizerShot {
+    sim::StabilizerTableau tableau;
+    sim::ClassicalRegister creg;
+    sim::ShotRng rng;
+    sim::MeasureBatch* measure_batch;
+    comm::ClassicalChannel* classical_channel;
+};
+
+void apply_instruction(StabilizerShot& shot, const CUNQAInstruction& inst)
+{
+    auto& tableau = shot.tableau;
+    switch (inst.type)
+    {
+    case ID:
+    case BARRIER:
+        break;
+    case X:
+        tableau.x(inst.qubits[0]);
+        break;
+    case Y:
+        tableau.y(inst.qubits[0]);
+        break;
+    case Z:
+        tableau.z(inst.qubits[0]);
+        break;
+    case H:
+        tableau.h(inst.qubits[0]);
+        break;
+    case S:
+        tableau.s(inst.qubits[0]);
+        break;
+    case SDG:
+        tableau.sdg(inst.qubits[0]);
+        break;
+    case SX:
+        tableau.sx(inst.qubits[0]);
+        break;
+    case SXDG:
+        tableau.sxdg(inst.qubits[0]);
+        break;
+    case CX:
+        tableau.cx(inst.qubits[0], inst.qubits[1]);
+        break;
+    case CY:
+        tableau.cy(inst.qubits[0], inst.qubits[1]);
+        break;
+    case CZ:
+        tableau.cz(inst.qubits[0], inst.qubits[1]);
+        break;
+    case SWAP:
+        tableau.swap(inst.qubits[0], inst.qubits[1]);
+        break;
+    case MEASURE:
+        shot.creg[inst.clbits[0]] = tableau.measure(inst.qubits[0], shot.rng() & 1);
+        break;
+    case RESET:
+        tableau.reset(inst.qubits[0], shot.rng() & 1);
+        break;
+    case COPY:
+    {
+        for (std::size_t i = 0; i < inst.l_clbits.size(); i++)
+            shot.creg[inst.l_clbits[i]] = shot.creg.test(inst.r_clbits[i]);
+        break;
+    }
+    case SEND:
+    {
+        for (const auto& clbit : inst.clbits)
+            shot.measure_batch->add(inst.qpus[0], shot.creg.test(clbit));
+        break;
+    }
+    case RECV:
+    {
+        const auto& measurements = shot.measure_batch->recv(shot.classical_channel, inst.qpus[0], inst.clbits.size());
+        for (std::size_t i = 0; i < inst.clbits.size(); i++)
+            shot.creg[inst.clbits[i]] = (measurements[i] == 1);
+        break;
+    }
+    case CIF:
+    {
+        if (sim::cif_holds(inst, shot.creg)) {
+            for (const auto& sub_inst : inst.instructions)
+                apply_instruction(shot, sub_inst);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace sim {
+
+bool runs_on_stabilizer(const QuantumTask& quantum_task)
+{
+    const auto method = quantum_task.config.find("method");
+    return method != quantum_task.config.end() && *method == "stabilizer";
+}
+
+JSON simulate_stabilizer(const QuantumTask& quantum_task, comm::ClassicalChannel* classical_channel)
+{
+    ResultWriter writer;
+    simulate_stabilizer(quantum_task, writer, classical_channel);
+    return writer.to_json();
+}
+
+void simulate_stabilizer(const QuantumTask& quantum_task, ResultWriter& writer, comm::ClassicalChannel* classical_channel)
+{
+    LOGGER_DEBUG("Stabilizer simulation");
+    try
+    {
+        const StructuredQuantumTask st_qtask = from_quantum_task_to_structuredqtask(quantum_task);
+        const bool communicates = check_instructions(st_qtask.instructions);
+        if (communicates && classical_channel == nullptr)
+            throw std::runtime_error("Classical communications need a QPU with the classical communications enabled");
+
+        const auto shots = quantum_task.config.at("shots").get<std::size_t>();
+        const std::uint64_t seed = simulation_seed(quantum_task.config);
+        MeasCounter meas_counter({st_qtask});
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // The gates before the first measurement are the same in every shot, so they are applied
+        // once and each shot starts from a copy of the tableau
+        StabilizerTableau initial_tableau(st_qtask.n_qubits);
+        const auto first_dynamic = st_qtask.instructions.begin() + st_qtask.deterministic_prefix;
+        {
+            StabilizerShot prefix{initial_tableau, ClassicalRegister(st_qtask.n_clbits), ShotRng(seed, 0), nullptr, nullptr};
+            for (auto it = st_qtask.instructions.begin(); it != first_dynamic; it++)
+                apply_instruction(prefix, *it);
+            initial_tableau = std::move(prefix.tableau);
+        }
+
+        // Without communications the shots are independent and split among the threads, block by
+        // block under a convergence check
+        const ShotConvergence convergence = ShotConvergence::from_config(quantum_task.config, communicates);
+        const std::size_t block = convergence.block_of(shots);
+        std::size_t shots_run = 0;
+        double standard_error = 0.0;
+        bool converged = false;
+        #pragma omp parallel if (!communicates)
+        {
+            MeasCounter local_counter({st_qtask});
+            MeasureBatch measure_batch;
+            StabilizerShot shot{initial_tableau, ClassicalRegister(st_qtask.n_clbits), ShotRng(seed, 0), &measure_batch, classical_channel};
+
+            for (std::size_t first = 0; first < shots && !converged; first += block) {
+                const std::size_t last = std::min(shots, first + block);
+                #pragma omp for
+                for (std::size_t i = first; i < last; i++) {
+                    shot.tableau = initial_tableau;
+                    shot.creg = ClassicalRegister(st_qtask.n_clbits);
+                    shot.rng = ShotRng(seed, i);
+                    for (auto it = first_dynamic; it != st_qtask.instructions.end(); it++)
+                        apply_instruction(shot, *it);
+                    // The measurements sent after the last RECV
+                    if (communicates)
+                        measure_batch.flush(classical_channel);
+                    local_counter.add(shot.creg);
+                }
+
+                #pragma omp critical
+                meas_counter.merge(local_counter);
+                local_counter = MeasCounter({st_qtask});
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    shots_run = last;
+                    standard_error = meas_counter.max_standard_error(last);
+                    converged = convergence.enabled() && convergence.converged(standard_error);
+                }
+            }
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<float> duration = end - start;
+
+        if (auto histogram = meas_counter.histogram(0))
+            writer.counts(std::move(*histogram), st_qtask.n_clbits);
+        else
+            writer["counts"] = JSON(meas_counter).at(quantum_task.id);
+        writer["time_taken"] = duration.count();
+        if (convergence.enabled())
+            writer["convergence"] = convergence.report(shots_run, standard_error);
+    }
+    catch (const std::exception& e)
+    {
+        LOGGER_ERROR("Error executing the circuit with the stabilizer method.");
+        writer.write({{"ERROR", std::string(e.what()) + ". Try checking the format of the circuit sent."}});
+    }
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
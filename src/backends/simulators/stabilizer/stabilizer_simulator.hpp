@@ -0,0 +1,23 @@
+#pragma once
+
+#include "quantum_task.hpp"
+#include "classical_channel/classical_channel.hpp"
+#include "utils/json.hpp"
+#include "utils/helpers/result_writer.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// True for the tasks sent with "method": "stabilizer", which the simulators without a stabilizer
+// method of their own run on the tableau of stabilizer_tableau.hpp
+bool runs_on_stabilizer(const QuantumTask& quantum_task);
+
+// Counts of a circuit of Clifford gates, measurements, resets and classical control, simulated
+// shot by shot on a stabilizer tableau, so in time and memory polynomial in the qubits. The
+// classical communications go through the channel, which is only needed if the circuit has any
+JSON simulate_stabilizer(const QuantumTask& quantum_task, comm::ClassicalChannel* classical_channel = nullptr);
+// The same, with the counts written into the reply as they are counted
+void simulate_stabilizer(const QuantumTask& quantum_task, ResultWriter& writer, comm::ClassicalChannel* classical_channel = nullptr);
+
+} // End of sim namespace
+} // End of cunqa namespace
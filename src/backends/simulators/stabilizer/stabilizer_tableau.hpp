@@ -0,0 +1,201 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace cunqa {
+namespace sim {
+
+// Tableau of a stabilizer state of n qubits (Aaronson and Gottesman, CHP): rows 0 to n-1 are
+// the destabilizers, n to 2n-1 the stabilizers and 2n a scratch row, each one the X and Z bits
+// of a Pauli string, 64 qubits per word, and its sign. The gates touch a bit of every row, and
+// the measurements multiply whole rows a word at a time, so the memory grows as n^2 / 32 bits
+// and the simulation as n^2 per measurement, not as 2^n
+class StabilizerTableau {
+public:
+    explicit StabilizerTableau(const std::size_t n_qubits) :
+        n_{n_qubits},
+        words_{(n_qubits + 63) / 64},
+        xs_((2 * n_qubits + 1) * words_, 0),
+        zs_((2 * n_qubits + 1) * words_, 0),
+        signs_(2 * n_qubits + 1, 0)
+    {
+        reset_all();
+    }
+
+    inline std::size_t n_qubits() const { return n_; }
+
+    // |0...0>, stabilized by the Z of each qubit and destabilized by its X
+    void reset_all()
+    {
+        std::fill(xs_.begin(), xs_.end(), 0);
+        std::fill(zs_.begin(), zs_.end(), 0);
+        std::fill(signs_.begin(), signs_.end(), 0);
+        for (std::size_t q = 0; q < n_; q++) {
+            xs_[q * words_ + q / 64] |= bit_(q);
+            zs_[(n_ + q) * words_ + q / 64] |= bit_(q);
+        }
+    }
+
+    inline void h(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t& x, std::uint64_t& z, std::uint8_t& sign, const std::uint64_t b) {
+            sign ^= (x & z & b) != 0;
+            const std::uint64_t flip = (x ^ z) & b;
+            x ^= flip;
+            z ^= flip;
+        }, q);
+    }
+
+    inline void s(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t& x, std::uint64_t& z, std::uint8_t& sign, const std::uint64_t b) {
+            sign ^= (x & z & b) != 0;
+            z ^= x & b;
+        }, q);
+    }
+
+    inline void sdg(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t& x, std::uint64_t& z, std::uint8_t& sign, const std::uint64_t b) {
+            sign ^= (x & ~z & b) != 0;
+            z ^= x & b;
+        }, q);
+    }
+
+    inline void x(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t&, std::uint64_t& z, std::uint8_t& sign, const std::uint64_t b) { sign ^= (z & b) != 0; }, q);
+    }
+
+    inline void z(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t& x, std::uint64_t&, std::uint8_t& sign, const std::uint64_t b) { sign ^= (x & b) != 0; }, q);
+    }
+
+    inline void y(const std::size_t q)
+    {
+        for_each_row_([](std::uint64_t& x, std::uint64_t& z, std::uint8_t& sign, const std::uint64_t b) { sign ^= ((x ^ z) & b) != 0; }, q);
+    }
+
+    inline void sx(const std::size_t q) { h(q); s(q); h(q); }
+    inline void sxdg(const std::size_t q) { h(q); sdg(q); h(q); }
+
+    void cx(const std::size_t control, const std::size_t target)
+    {
+        const std::size_t wc = control / 64, wt = target / 64;
+        const std::uint64_t bc = bit_(control), bt = bit_(target);
+        for (std::size_t row = 0; row < 2 * n_; row++) {
+            std::uint64_t* x = &xs_[row * words_];
+            std::uint64_t* z = &zs_[row * words_];
+            const bool xc = x[wc] & bc, zc = z[wc] & bc, xt = x[wt] & bt, zt = z[wt] & bt;
+            signs_[row] ^= xc && zt && (xt == zc);
+            if (xc)
+                x[wt] ^= bt;
+            if (zt)
+                z[wc] ^= bc;
+        }
+    }
+
+    inline void cz(const std::size_t a, const std::size_t b) { h(b); cx(a, b); h(b); }
+    inline void cy(const std::size_t a, const std::size_t b) { sdg(b); cx(a, b); s(b); }
+    inline void swap(const std::size_t a, const std::size_t b) { cx(a, b); cx(b, a); cx(a, b); }
+
+    // Measures the qubit in the Z basis, drawing the outcome from the random bit if it is not
+    // determined by the state, and collapses the state onto it
+    bool measure(const std::size_t q, const bool random_bit)
+    {
+        const std::size_t w = q / 64;
+        const std::uint64_t b = bit_(q);
+
+        std::size_t p = 2 * n_;
+        for (std::size_t row = n_; row < 2 * n_; row++) {
+            if (xs_[row * words_ + w] & b) {
+                p = row;
+                break;
+            }
+        }
+
+        if (p < 2 * n_) {
+            for (std::size_t row = 0; row < 2 * n_; row++) {
+                if (row != p && (xs_[row * words_ + w] & b))
+                    rowsum_(row, p);
+            }
+            copy_row_(p - n_, p);
+            std::fill_n(&xs_[p * words_], words_, 0);
+            std::fill_n(&zs_[p * words_], words_, 0);
+            zs_[p * words_ + w] |= b;
+            signs_[p] = random_bit;
+            return random_bit;
+        }
+
+        // Determined: the product of the stabilizers of the destabilizers with an X on the qubit
+        const std::size_t scratch = 2 * n_;
+        std::fill_n(&xs_[scratch * words_], words_, 0);
+        std::fill_n(&zs_[scratch * words_], words_, 0);
+        signs_[scratch] = 0;
+        for (std::size_t row = 0; row < n_; row++) {
+            if (xs_[row * words_ + w] & b)
+                rowsum_(scratch, row + n_);
+        }
+        return signs_[scratch];
+    }
+
+    inline void reset(const std::size_t q, const bool random_bit)
+    {
+        if (measure(q, random_bit))
+            x(q);
+    }
+
+private:
+    std::size_t n_;
+    std::size_t words_;
+    std::vector<std::uint64_t> xs_, zs_;
+    std::vector<std::uint8_t> signs_;
+
+    static inline std::uint64_t bit_(const std::size_t q) { return std::uint64_t(1) << (q % 64); }
+
+    template <typename F>
+    inline void for_each_row_(F&& f, const std::size_t q)
+    {
+        const std::size_t w = q / 64;
+        const std::uint64_t b = bit_(q);
+        for (std::size_t row = 0; row < 2 * n_; row++)
+            f(xs_[row * words_ + w], zs_[row * words_ + w], signs_[row], b);
+    }
+
+    void copy_row_(const std::size_t to, const std::size_t from)
+    {
+        std::copy_n(&xs_[from * words_], words_, &xs_[to * words_]);
+        std::copy_n(&zs_[from * words_], words_, &zs_[to * words_]);
+        signs_[to] = signs_[from];
+    }
+
+    // Row h becomes the product of rows h and i. The Paulis of each qubit that anticommute add a
+    // power of i to the sign, +1 or -1 as told by their bits (as Stim tallies it)
+    void rowsum_(const std::size_t h, const std::size_t i)
+    {
+        std::uint64_t* x1 = &xs_[h * words_];
+        std::uint64_t* z1 = &zs_[h * words_];
+        const std::uint64_t* x2 = &xs_[i * words_];
+        const std::uint64_t* z2 = &zs_[i * words_];
+
+        unsigned phase = 0;
+        for (std::size_t w = 0; w < words_; w++) {
+            const std::uint64_t old_x1 = x1[w], old_z1 = z1[w];
+            x1[w] ^= x2[w];
+            z1[w] ^= z2[w];
+            const std::uint64_t x1z2 = old_x1 & z2[w];
+            const std::uint64_t anti_commutes = (x2[w] & old_z1) ^ x1z2;
+            const std::uint64_t minus = (x1[w] ^ z1[w] ^ x1z2) & anti_commutes;
+            phase += std::popcount(anti_commutes & ~minus) + 3 * std::popcount(minus);
+        }
+        signs_[h] = ((2 * signs_[h] + 2 * signs_[i] + phase) % 4) != 0;
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,113 @@
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <unistd.h>
+
+#include "checkpoints.hpp"
+#include "utils/constants.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// Only change how the result is sent or when the task runs, so the task sent again may differ in them
+const std::array<std::string, 7> UNCHECKED = {"timings", "perf_counters", "counts_format", "state_format", "priority",
+                                              "stream_shots", "deadline"};
+
+// FNV-1a of the circuit and the config, the same in every build, as the vQPU that resumes the task
+// may not be the one that checkpointed it
+std::string fingerprint(const QuantumTask& quantum_task)
+{
+    JSON config = quantum_task.config;
+    for (const auto& key : UNCHECKED)
+        config.erase(key);
+
+    std::uint64_t hash = 0xcbf29ce484222325;
+    for (const auto& text : {JSON(quantum_task.circuit).dump(), config.dump()}) {
+        for (const unsigned char c : text) {
+            hash ^= c;
+            hash *= 0x100000001b3;
+        }
+    }
+    return std::to_string(hash);
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+Checkpoints Checkpoints::from_environment()
+{
+    const char* directory = std::getenv("CUNQA_CHECKPOINT_DIR");
+    return Checkpoints(directory != nullptr && *directory != '\0' ? std::string(directory)
+                                                                  : constants::get_cunqa_path() + "/checkpoints");
+}
+
+bool Checkpoints::valid_name(const std::string& name)
+{
+    return !name.empty() && name.front() != '.' && std::all_of(name.begin(), name.end(), [](const char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.';
+    });
+}
+
+std::optional<Checkpoints::Progress> Checkpoints::load(const std::string& name, const QuantumTask& quantum_task) const
+{
+    std::ifstream file(path_(name));
+    if (!file)
+        return std::nullopt;
+    const JSON checkpoint = JSON::parse(file, nullptr, false);
+    if (!checkpoint.is_object() || !checkpoint.contains("result") || checkpoint.value("fingerprint", "") != fingerprint(quantum_task)) {
+        LOGGER_WARN("The checkpoint {} is not of this task, it starts from the first shot.", name);
+        return std::nullopt;
+    }
+    return Progress{checkpoint.value("done", 0), checkpoint.value("chunk", 0), checkpoint.value("seed", std::int64_t{0}),
+                    checkpoint.at("result")};
+}
+
+// Written aside and renamed over the last one, so that a vQPU killed while writing leaves the
+// previous checkpoint whole
+void Checkpoints::save(const std::string& name, const QuantumTask& quantum_task, const Progress& progress) const
+{
+    const JSON checkpoint = {
+        {"fingerprint", fingerprint(quantum_task)},
+        {"done", progress.done},
+        {"chunk", progress.chunk},
+        {"seed", progress.seed},
+        {"result", progress.result}
+    };
+
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    const std::string path = path_(name);
+    const std::string tmp = path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::trunc);
+        file << checkpoint.dump();
+        if (!file.flush()) {
+            LOGGER_WARN("The checkpoint {} could not be written to {}.", name, directory_);
+            std::filesystem::remove(tmp, error);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp, path, error);
+    if (error) {
+        LOGGER_WARN("The checkpoint {} could not be written to {}: {}", name, directory_, error.message());
+        std::filesystem::remove(tmp, error);
+    }
+}
+
+void Checkpoints::remove(const std::string& name) const
+{
+    std::error_code error;
+    std::filesystem::remove(path_(name), error);
+}
+
+std::string Checkpoints::path_(const std::string& name) const
+{
+    return directory_ + "/" + name + ".json";
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <optional>
+
+#include "quantum_task.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Progress of the tasks run with "checkpoint", the name under which they are kept, in chunks of
+// "checkpoint_shots" shots. After each chunk the counts so far, the shots done and the next chunk
+// are written to a file of the directory, so that the vQPU that takes the task again, once the one
+// that ran it hit the walltime of its job or was preempted, resumes it from there. Each chunk
+// samples its shots from the seed of the task plus its index, as those of "stream_shots" do, so the
+// counts of a resumed task are those of a single run. The file is removed when the task finishes
+class Checkpoints {
+public:
+    struct Progress {
+        int done = 0; // Shots
+        int chunk = 0; // The next one to run
+        std::int64_t seed = 0; // Of the first chunk, drawn if the task has none
+        JSON result; // Counts of the shots done
+    };
+
+    explicit Checkpoints(std::string directory) : directory_{std::move(directory)} { }
+
+    // In CUNQA_CHECKPOINT_DIR, or else in $STORE/.cunqa/checkpoints, where the vQPUs of any node
+    // find them
+    static Checkpoints from_environment();
+
+    // Names are kept as file names, so they only take letters, digits, '-', '_' and '.'
+    static bool valid_name(const std::string& name);
+
+    // Nothing if there is no checkpoint of the name, or if it is of another circuit or config
+    std::optional<Progress> load(const std::string& name, const QuantumTask& quantum_task) const;
+    void save(const std::string& name, const QuantumTask& quantum_task, const Progress& progress) const;
+    void remove(const std::string& name) const;
+
+private:
+    std::string directory_;
+
+    std::string path_(const std::string& name) const;
+};
+
+} // End of cunqa namespace
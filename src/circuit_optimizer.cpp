@@ -0,0 +1,431 @@
+#include <map>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "circuit_optimizer.hpp"
+#include "utils/helpers/gate_matrices.hpp"
+
+namespace {
+using namespace cunqa;
+using gates::Matrix2, gates::PI, gates::matrix_of, gates::operator*;
+
+constexpr double ANGLE_TOLERANCE = 1e-12;
+
+// Gates that undo each other when applied one after the other on the same qubits
+const std::unordered_map<std::string, std::string> INVERSES = {
+    {"x", "x"}, {"y", "y"}, {"z", "z"}, {"h", "h"},
+    {"s", "sdg"}, {"sdg", "s"}, {"t", "tdg"}, {"tdg", "t"},
+    {"sx", "sxdg"}, {"sxdg", "sx"}, {"sy", "sydg"}, {"sydg", "sy"}, {"v", "vdg"}, {"vdg", "v"},
+    {"cx", "cx"}, {"cy", "cy"}, {"cz", "cz"}, {"ch", "ch"}, {"swap", "swap"}, {"ecr", "ecr"},
+    {"cs", "csdg"}, {"csdg", "cs"}, {"csx", "csxdg"}, {"csxdg", "csx"},
+    {"ccx", "ccx"}, {"ccz", "ccz"}, {"cswap", "cswap"}, {"mcx", "mcx"}, {"mcy", "mcy"}, {"mcz", "mcz"},
+};
+
+// Rotations whose angles add up, with the angle that makes them the identity. The Pauli
+// rotations are minus the identity at 2 pi, which is not a global phase once controlled
+const std::unordered_map<std::string, double> ROTATION_PERIODS = {
+    {"rx", 4 * PI}, {"ry", 4 * PI}, {"rz", 4 * PI},
+    {"crx", 4 * PI}, {"cry", 4 * PI}, {"crz", 4 * PI}, {"mcrx", 4 * PI}, {"mcry", 4 * PI}, {"mcrz", 4 * PI},
+    {"rxx", 4 * PI}, {"ryy", 4 * PI}, {"rzz", 4 * PI}, {"rzx", 4 * PI},
+    {"p", 2 * PI}, {"u1", 2 * PI}, {"cp", 2 * PI}, {"cu1", 2 * PI}, {"mcp", 2 * PI}, {"mcu1", 2 * PI},
+};
+
+// Other unitary gates, that can be dropped once nothing measured depends on them
+const std::unordered_set<std::string> OTHER_UNITARIES = {
+    "u", "u2", "u3", "r", "iswap", "dcx", "cu", "cu2", "cu3", "cr",
+    "mcu2", "mcu3", "mcr", "mcsx", "mcswap", "unitary", "cunitary",
+};
+
+bool is_unitary(const std::string& name)
+{
+    return INVERSES.contains(name) || ROTATION_PERIODS.contains(name) || OTHER_UNITARIES.contains(name);
+}
+
+// Gates with one more control, as the first of their qubits, for the classically controlled
+// blocks whose measurements are deferred
+const std::unordered_map<std::string, std::string> CONTROLLED = {
+    {"x", "cx"}, {"y", "cy"}, {"z", "cz"}, {"h", "ch"},
+    {"s", "cs"}, {"sdg", "csdg"}, {"t", "ct"}, {"sx", "csx"}, {"sxdg", "csxdg"},
+    {"rx", "crx"}, {"ry", "cry"}, {"rz", "crz"}, {"p", "cp"}, {"u1", "cu1"},
+    {"swap", "cswap"}, {"cx", "ccx"}, {"cz", "ccz"},
+};
+
+// Left out of the controlled blocks, as they do nothing
+bool is_idle(const std::string& name)
+{
+    return name == "id" || name == "barrier";
+}
+
+// Acting only on its own qubits, unlike the instructions with nested ones, that are classically
+// controlled or communicate, or those without qubits
+bool is_local(const JSON& instruction)
+{
+    if (instruction.contains("instructions"))
+        return false;
+    auto qubits = instruction.find("qubits");
+    if (qubits == instruction.end() || qubits->empty())
+        return false;
+    return std::all_of(qubits->begin(), qubits->end(), [](const JSON& qubit) { return qubit.get<int>() >= 0; });
+}
+
+std::optional<std::vector<double>> numeric_params(const JSON& instruction)
+{
+    std::vector<double> params;
+    if (auto it = instruction.find("params"); it != instruction.end()) {
+        for (const auto& param : *it) {
+            if (!param.is_number())
+                return std::nullopt;
+            params.push_back(param.get<double>());
+        }
+    }
+    return params;
+}
+
+JSON unitary_instruction(const int qubit, const Matrix2& matrix)
+{
+    auto element = [&](const int k) { return JSON::array({matrix[k].real(), matrix[k].imag()}); };
+    JSON rows = JSON::array({JSON::array({element(0), element(1)}), JSON::array({element(2), element(3)})});
+    return {{"name", "unitary"}, {"qubits", {qubit}}, {"matrix", JSON::array({std::move(rows)})}};
+}
+
+bool is_identity_angle(const double angle, const double period)
+{
+    const double rest = std::fmod(std::abs(angle), period);
+    return rest < ANGLE_TOLERANCE || period - rest < ANGLE_TOLERANCE;
+}
+
+// Cancels the inverses and merges the rotations. Each qubit keeps the stack of the instructions
+// on it, so that cancelling a pair brings the previous one back to the top, and a non-local
+// instruction is a fence that no pair crosses
+std::vector<JSON> cancel_and_merge(std::vector<JSON>& circuit)
+{
+    std::vector<JSON> out;
+    out.reserve(circuit.size());
+    std::vector<bool> erased;
+    erased.reserve(circuit.size());
+    std::unordered_map<int, std::vector<std::size_t>> stacks;
+    std::size_t fence = 0;
+
+    auto top = [&](const int qubit) -> std::optional<std::size_t> {
+        const auto& stack = stacks[qubit];
+        if (stack.empty() || stack.back() < fence)
+            return std::nullopt;
+        return stack.back();
+    };
+
+    for (auto& instruction : circuit) {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "id" || name == "barrier")
+            continue;
+        if (!is_local(instruction)) {
+            out.push_back(std::move(instruction));
+            erased.push_back(false);
+            fence = out.size();
+            continue;
+        }
+
+        const auto qubits = instruction.at("qubits").get<std::vector<int>>();
+        const auto previous = top(qubits[0]);
+        const bool adjacent = previous && out[*previous].at("qubits") == instruction.at("qubits") &&
+            std::all_of(qubits.begin(), qubits.end(), [&](const int qubit) { return top(qubit) == previous; });
+        if (adjacent) {
+            auto& prev = out[*previous];
+            const auto& prev_name = prev.at("name").get_ref<const std::string&>();
+            bool cancelled = false;
+            if (auto inverse = INVERSES.find(name); inverse != INVERSES.end() && inverse->second == prev_name) {
+                cancelled = true;
+            } else if (auto period = ROTATION_PERIODS.find(name); period != ROTATION_PERIODS.end() && name == prev_name) {
+                auto params = numeric_params(instruction), prev_params = numeric_params(prev);
+                if (params && prev_params && params->size() == 1 && prev_params->size() == 1) {
+                    const double angle = (*params)[0] + (*prev_params)[0];
+                    if (!is_identity_angle(angle, period->second)) {
+                        prev["params"][0] = angle;
+                        continue;
+                    }
+                    cancelled = true;
+                }
+            }
+            if (cancelled) {
+                erased[*previous] = true;
+                for (const int qubit : qubits)
+                    stacks[qubit].pop_back();
+                continue;
+            }
+        }
+
+        for (const int qubit : qubits)
+            stacks[qubit].push_back(out.size());
+        out.push_back(std::move(instruction));
+        erased.push_back(false);
+    }
+
+    std::vector<JSON> kept;
+    kept.reserve(out.size());
+    for (std::size_t i = 0; i < out.size(); i++) {
+        if (!erased[i])
+            kept.push_back(std::move(out[i]));
+    }
+    return kept;
+}
+
+// Folds the chains of single-qubit gates into a "unitary" each, placed where the chain ends.
+// The gates of other qubits in between commute with it
+std::vector<JSON> fuse_single_qubit_chains(std::vector<JSON>& circuit, std::size_t& fused_gates)
+{
+    struct Chain {
+        Matrix2 matrix = {1, 0, 0, 1};
+        std::vector<JSON> gates;
+    };
+    std::vector<JSON> out;
+    out.reserve(circuit.size());
+    std::map<int, Chain> chains;
+
+    auto flush = [&](const int qubit) {
+        auto chain = chains.find(qubit);
+        if (chain == chains.end())
+            return;
+        if (chain->second.gates.size() == 1) {
+            out.push_back(std::move(chain->second.gates.front()));
+        } else {
+            out.push_back(unitary_instruction(qubit, chain->second.matrix));
+            fused_gates += chain->second.gates.size();
+        }
+        chains.erase(chain);
+    };
+    auto flush_all = [&]() {
+        while (!chains.empty())
+            flush(chains.begin()->first);
+    };
+
+    for (auto& instruction : circuit) {
+        if (!is_local(instruction)) {
+            flush_all();
+            out.push_back(std::move(instruction));
+            continue;
+        }
+        const auto qubits = instruction.at("qubits").get<std::vector<int>>();
+        if (qubits.size() == 1) {
+            const auto params = numeric_params(instruction);
+            const auto matrix = params ? matrix_of(instruction.at("name").get<std::string>(), *params) : std::nullopt;
+            if (matrix) {
+                auto& chain = chains[qubits[0]];
+                chain.matrix = *matrix * chain.matrix;
+                chain.gates.push_back(std::move(instruction));
+                continue;
+            }
+        }
+        for (const int qubit : qubits)
+            flush(qubit);
+        out.push_back(std::move(instruction));
+    }
+    flush_all();
+    return out;
+}
+
+// Drops the gates on qubits already measured that no later measurement depends on, or, within
+// the lightcone, every gate that no later measurement depends on
+std::vector<JSON> remove_dead_gates(std::vector<JSON>& circuit, const bool lightcone)
+{
+    std::vector<bool> after_measurement(circuit.size(), false);
+    std::unordered_set<int> measured;
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        if (!is_local(circuit[i]))
+            continue;
+        const auto qubits = circuit[i].at("qubits").get<std::vector<int>>();
+        after_measurement[i] = std::all_of(qubits.begin(), qubits.end(), [&](const int qubit) { return measured.contains(qubit); });
+        if (circuit[i].at("name") == "measure")
+            measured.insert(qubits.begin(), qubits.end());
+    }
+
+    std::vector<bool> dead(circuit.size(), false);
+    std::unordered_set<int> live;
+    bool all_live = false;
+    for (std::size_t i = circuit.size(); i-- > 0;) {
+        if (!is_local(circuit[i])) {
+            all_live = true;
+            continue;
+        }
+        const auto qubits = circuit[i].at("qubits").get<std::vector<int>>();
+        const bool unused = std::none_of(qubits.begin(), qubits.end(), [&](const int qubit) { return live.contains(qubit); });
+        if (!all_live && (lightcone || after_measurement[i]) && unused && is_unitary(circuit[i].at("name").get<std::string>()))
+            dead[i] = true;
+        else
+            live.insert(qubits.begin(), qubits.end());
+    }
+
+    std::vector<JSON> kept;
+    kept.reserve(circuit.size());
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        if (!dead[i])
+            kept.push_back(std::move(circuit[i]));
+    }
+    return kept;
+}
+
+// Renumbers the qubits that the instructions act on, in their order, and returns how many they
+// are. Unless an instruction is not local, as its qubits may be nested or remote
+int compact_qubits(std::vector<JSON>& circuit, const int n_qubits)
+{
+    if (!std::all_of(circuit.begin(), circuit.end(), is_local))
+        return n_qubits;
+
+    std::vector<int> used(n_qubits, 0);
+    for (const auto& instruction : circuit) {
+        for (const auto& qubit : instruction.at("qubits")) {
+            if (qubit.get<int>() >= n_qubits)
+                return n_qubits;
+            used[qubit.get<int>()] = 1;
+        }
+    }
+    std::vector<int> renumbered(n_qubits, 0);
+    int n_used = 0;
+    for (int qubit = 0; qubit < n_qubits; qubit++) {
+        if (used[qubit])
+            renumbered[qubit] = n_used++;
+    }
+    // The measurements of the circuit always leave one, and the simulators need one
+    if (n_used == n_qubits || n_used == 0)
+        return n_qubits;
+
+    for (auto& instruction : circuit) {
+        for (auto& qubit : instruction.at("qubits"))
+            qubit = renumbered[qubit.get<int>()];
+    }
+    return n_used;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+OptimizerReport optimize_circuit(std::vector<JSON>& circuit, const OptimizerOptions& options)
+{
+    OptimizerReport report;
+    report.gates_before = circuit.size();
+
+    circuit = cancel_and_merge(circuit);
+    if (options.fuse_into_unitary)
+        circuit = fuse_single_qubit_chains(circuit, report.fused_gates);
+    // The lightcone is that of the measurements, so a circuit without them keeps its gates
+    const bool lightcone = options.prune_lightcone && options.n_qubits > 0 &&
+        std::any_of(circuit.begin(), circuit.end(), [](const JSON& instruction) { return instruction.at("name") == "measure"; });
+    if (options.remove_dead_gates || lightcone)
+        circuit = remove_dead_gates(circuit, lightcone);
+    report.qubits_before = report.qubits_after = options.n_qubits;
+    if (lightcone)
+        report.qubits_after = compact_qubits(circuit, options.n_qubits);
+
+    report.gates_after = circuit.size();
+    return report;
+}
+
+std::optional<std::size_t> defer_measurements(std::vector<JSON>& circuit, const int n_qubits, const std::size_t max_ancillas,
+                                              const std::unordered_set<std::string>& basis_gates)
+{
+    for (const auto* name : {"measure", "x", "cx"}) {
+        if (!basis_gates.contains(name))
+            return std::nullopt;
+    }
+
+    // Last instruction that changes each qubit, the measurements aside, to know which ones keep
+    // their measured value until the end
+    std::unordered_map<int, std::size_t> last_change;
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        const JSON& instruction = circuit[i];
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "measure" || is_idle(name))
+            continue;
+        if (name == "cif") {
+            if (instruction.at("clbits").size() != 1)
+                return std::nullopt;
+            for (const auto& gate : instruction.at("instructions")) {
+                const auto& gate_name = gate.at("name").get_ref<const std::string&>();
+                if (is_idle(gate_name))
+                    continue;
+                const auto controlled = CONTROLLED.find(gate_name);
+                if (controlled == CONTROLLED.end() || !basis_gates.contains(controlled->second))
+                    return std::nullopt;
+                for (const auto& qubit : gate.at("qubits"))
+                    last_change[qubit.get<int>()] = i;
+            }
+        } else if (is_unitary(name) && is_local(instruction)) {
+            for (const auto& qubit : instruction.at("qubits"))
+                last_change[qubit.get<int>()] = i;
+        } else {
+            return std::nullopt; // Resets, noise, communications...
+        }
+    }
+
+    // Counted before rewriting, so that a circuit that needs too many is left as it was
+    std::size_t needed_ancillas = 0;
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        if (circuit[i].at("name") != "measure")
+            continue;
+        for (const auto& qubit : circuit[i].at("qubits")) {
+            const auto change = last_change.find(qubit.get<int>());
+            needed_ancillas += change != last_change.end() && change->second > i;
+        }
+    }
+    if (needed_ancillas > max_ancillas)
+        return std::nullopt;
+
+    std::vector<JSON> deferred;
+    deferred.reserve(circuit.size() + needed_ancillas);
+    std::map<int, int> holder; // Qubit that holds the last value measured into each clbit
+    std::size_t n_ancillas = 0;
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        JSON& instruction = circuit[i];
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "measure") {
+            const auto& qubits = instruction.at("qubits");
+            const auto& clbits = instruction.at("clbits");
+            for (std::size_t k = 0; k < qubits.size(); k++) {
+                int qubit = qubits[k].get<int>();
+                const auto change = last_change.find(qubit);
+                if (change != last_change.end() && change->second > i) {
+                    const int ancilla = n_qubits + static_cast<int>(n_ancillas++);
+                    deferred.push_back({{"name", "cx"}, {"qubits", {qubit, ancilla}}});
+                    qubit = ancilla;
+                }
+                holder[clbits[k].get<int>()] = qubit;
+            }
+        } else if (name == "cif") {
+            // With a single clbit, the block runs if the clbit equals the condition
+            const bool condition = instruction.value("condition", 1) != 0;
+            const auto control = holder.find(instruction.at("clbits")[0].get<int>());
+            if (control == holder.end()) { // Never measured, so zero
+                for (auto& gate : instruction.at("instructions")) {
+                    if (!condition && !is_idle(gate.at("name").get_ref<const std::string&>()))
+                        deferred.push_back(std::move(gate));
+                }
+                continue;
+            }
+            // Controlled on zero by flipping the control around the block
+            if (!condition)
+                deferred.push_back({{"name", "x"}, {"qubits", {control->second}}});
+            for (auto& gate : instruction.at("instructions")) {
+                if (is_idle(gate.at("name").get_ref<const std::string&>()))
+                    continue;
+                gate["name"] = CONTROLLED.at(gate.at("name").get<std::string>());
+                gate["qubits"].insert(gate["qubits"].begin(), control->second);
+                deferred.push_back(std::move(gate));
+            }
+            if (!condition)
+                deferred.push_back({{"name", "x"}, {"qubits", {control->second}}});
+        } else {
+            deferred.push_back(std::move(instruction));
+        }
+    }
+    for (const auto& [clbit, qubit] : holder)
+        deferred.push_back({{"name", "measure"}, {"qubits", {qubit}}, {"clbits", {clbit}}});
+
+    circuit = std::move(deferred);
+    return n_ancillas;
+}
+
+} // End of cunqa namespace
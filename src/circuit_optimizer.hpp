@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <optional>
+#include <unordered_set>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Passes of the optimizer that the vQPU runs over the circuits whose config sets "optimize"
+struct OptimizerOptions {
+    bool fuse_into_unitary = false; // Only for the simulators that take "unitary" gates
+    bool remove_dead_gates = true;  // Not for the circuits whose state is returned or evaluated
+    // Drops every gate outside the lightcone of the measurements, not only those after them, and
+    // the qubits left without instructions. Only for the circuits whose result are their counts
+    bool prune_lightcone = false;
+    int n_qubits = 0;
+};
+
+struct OptimizerReport {
+    std::size_t gates_before = 0;
+    std::size_t gates_after = 0;
+    std::size_t fused_gates = 0; // Single-qubit gates folded into a "unitary"
+    int qubits_before = 0;
+    int qubits_after = 0;
+
+    JSON to_json() const
+    {
+        return {{"gates_before", gates_before}, {"gates_after", gates_after},
+                {"removed_gates", gates_before - gates_after}, {"fused_gates", fused_gates},
+                {"pruned_qubits", qubits_before - qubits_after}};
+    }
+};
+
+// Rewrites the instructions of a circuit into fewer that give the same counts, in a single pass
+// of each kind along the circuit: identities and barriers are dropped, adjacent inverse gates on
+// the same qubits cancel out, consecutive rotations of the same kind add up into one (dropped
+// if the angle becomes a multiple of its period), chains of single-qubit gates are folded into
+// a "unitary", and gates after the last measurement of their qubits, that no later measurement
+// depends on, are dropped. Instructions other than the known gates are left as they are, and the
+// ones that are classically controlled or communicate stop the passes across them. With the
+// lightcone pruned, the qubits left are renumbered in their order, and the register shrinks to them
+OptimizerReport optimize_circuit(std::vector<JSON>& circuit, const OptimizerOptions& options);
+
+// Rewrites a circuit whose classical control only depends on its own measurements into one
+// without it, after the deferred measurement principle: the blocks controlled by a clbit become
+// gates controlled by the qubit that holds its value, and the measurements go to the end. A
+// qubit measured and changed afterwards is first copied into an ancilla, added after the n_qubits
+// of the circuit, and no more than max_ancillas of them are taken. The circuits with other
+// non-unitary instructions, blocks on several clbits or gates whose controlled version is not
+// among the basis_gates are left as they are. Returns the ancillas added, nothing if unchanged
+std::optional<std::size_t> defer_measurements(std::vector<JSON>& circuit, const int n_qubits, const std::size_t max_ancillas,
+                                              const std::unordered_set<std::string>& basis_gates);
+
+} // End of cunqa namespace
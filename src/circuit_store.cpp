@@ -0,0 +1,126 @@
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "circuit_store.hpp"
+#include "quantum_task.hpp"
+#include "utils/constants.hpp"
+#include "logger.hpp"
+
+namespace {
+
+// A file mapped read-only for as long as it is decoded, so that the circuit is parsed from the
+// page cache without copying it into a buffer first
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+    {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            size_ = st.st_size;
+            data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data_ == MAP_FAILED)
+                data_ = nullptr;
+            else
+                madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+    ~MappedFile()
+    {
+        if (data_ != nullptr)
+            munmap(data_, size_);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline bool mapped() const { return data_ != nullptr; }
+    inline std::string_view view() const { return {static_cast<const char*>(data_), size_}; }
+
+private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+constexpr std::size_t DEFAULT_ENTRIES = 8;
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+CircuitStore& CircuitStore::shared()
+{
+    static CircuitStore store = [] {
+        const char* directory = std::getenv("CUNQA_CIRCUIT_STORE");
+        const char* entries = std::getenv("CUNQA_CIRCUIT_STORE_CACHE");
+        return CircuitStore(directory != nullptr && *directory != '\0' ? std::string(directory)
+                                                                       : constants::get_cunqa_path() + "/circuits",
+                            entries != nullptr ? std::strtoul(entries, nullptr, 10) : DEFAULT_ENTRIES);
+    }();
+    return store;
+}
+
+bool CircuitStore::valid_ref(const std::string& ref)
+{
+    return !ref.empty() && std::all_of(ref.begin(), ref.end(), [](const char c) {
+        return std::isdigit(static_cast<unsigned char>(c)) || (c >= 'a' && c <= 'f');
+    });
+}
+
+CircuitStore::Circuit CircuitStore::load(const std::string& ref)
+{
+    if (!valid_ref(ref))
+        throw std::runtime_error("Invalid circuit reference " + ref + ", it must be the hexadecimal hash of the circuit.");
+    {
+        std::lock_guard lock(mutex_);
+        if (auto it = index_.find(ref); it != index_.end()) {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->circuit;
+        }
+    }
+
+    // Decoded out of the lock, so that a large circuit does not hold back the tasks of others
+    Circuit circuit = std::make_shared<const std::vector<JSON>>(read_(ref));
+    if (max_entries_ == 0)
+        return circuit;
+
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(ref); it != index_.end()) // Decoded meanwhile by another task
+        return it->second->circuit;
+    entries_.push_front(Entry{ref, circuit});
+    index_[entries_.front().ref] = entries_.begin();
+    while (entries_.size() > max_entries_) {
+        index_.erase(entries_.back().ref);
+        entries_.pop_back();
+    }
+    return circuit;
+}
+
+std::vector<JSON> CircuitStore::read_(const std::string& ref) const
+{
+    MappedFile file(directory_ + "/" + ref);
+    if (!file.mapped())
+        throw std::runtime_error("No circuit " + ref + " in the circuit store " + directory_ + ".");
+    LOGGER_DEBUG("Circuit {} read from the circuit store ({} bytes).", ref, file.view().size());
+
+    const std::string_view content = file.view();
+    if (content.starts_with(BINARY_TASK_MAGIC))
+        return circuit_from_binary(content);
+
+    JSON stored = JSON::parse(content.begin(), content.end());
+    if (stored.is_object() && stored.contains("instructions"))
+        stored = std::move(stored.at("instructions"));
+    if (!stored.is_array())
+        throw std::runtime_error("The circuit " + ref + " of the circuit store is not a list of instructions.");
+    return std::move(stored.get_ref<JSON::array_t&>());
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <unordered_map>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Circuits written once to a shared directory, each in a file named by the SHA-256 of its content,
+// so that a circuit sent to many vQPUs crosses the network once and the tasks carry its hash as
+// "circuit_ref" instead of the instructions. A file holds the instructions as JSON, an array or a
+// task with "instructions", or a task in the binary layout, whose id and config are left out. The
+// vQPUs memory-map the files and keep the max_entries circuits decoded last, so the tasks that
+// repeat a circuit neither read nor parse it again
+class CircuitStore {
+public:
+    using Circuit = std::shared_ptr<const std::vector<JSON>>;
+
+    CircuitStore(std::string directory, const std::size_t max_entries) :
+        directory_{std::move(directory)},
+        max_entries_{max_entries}
+    { }
+
+    // That of the vQPU: CUNQA_CIRCUIT_STORE, or else $STORE/.cunqa/circuits, which a directory of
+    // /dev/shm turns into one in the memory of the node, with CUNQA_CIRCUIT_STORE_CACHE circuits
+    // decoded, 8 by default
+    static CircuitStore& shared();
+
+    // Hashes are kept as file names, so they only take lowercase hexadecimal digits
+    static bool valid_ref(const std::string& ref);
+
+    Circuit load(const std::string& ref);
+
+private:
+    struct Entry {
+        std::string ref;
+        Circuit circuit;
+    };
+
+    std::string directory_;
+    std::size_t max_entries_;
+    std::list<Entry> entries_; // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    std::mutex mutex_;
+
+    std::vector<JSON> read_(const std::string& ref) const;
+};
+
+} // End of cunqa namespace
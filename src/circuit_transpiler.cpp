@@ -0,0 +1,933 @@
+#include <map>
+#include <deque>
+#include <mutex>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "circuit_transpiler.hpp"
+#include "utils/helpers/gate_matrices.hpp"
+
+namespace {
+using namespace cunqa;
+using gates::Complex, gates::Matrix2, gates::PI, gates::matrix_of, gates::operator*;
+
+constexpr double ANGLE_TOLERANCE = 1e-10;
+constexpr int UNREACHABLE = std::numeric_limits<int>::max() / 4;
+
+// Parameters of SABRE, as in its paper: the look-ahead on the next two-qubit gates and the decay
+// that spreads the swaps over different qubits
+constexpr std::size_t EXTENDED_SET_SIZE = 20;
+constexpr double EXTENDED_SET_WEIGHT = 0.5;
+constexpr double DECAY_INCREMENT = 0.001;
+constexpr std::size_t DECAY_RESET = 5;
+constexpr int LAYOUT_TRIALS = 4;     // The first one from a dense layout, the rest from random ones
+constexpr int LAYOUT_ITERATIONS = 2; // Routings forth and back that refine each layout
+
+// Instructions kept as they are, with their qubits mapped
+const std::unordered_set<std::string> DIRECTIVES = {"measure", "reset", "barrier"};
+// Single-qubit gates without parameters, emitted instead of their synthesis if in the basis
+const std::vector<std::string> FIXED_GATES = {"x", "sx", "sxdg", "h", "y", "z", "s", "sdg", "t", "tdg"};
+// Gates that are the same on their qubits in either order
+const std::unordered_set<std::string> SYMMETRIC = {"cz", "swap", "rzz", "rxx", "ryy", "iswap", "cp", "cu1"};
+
+JSON gate(const std::string& name, std::vector<int> qubits, std::vector<double> params = {})
+{
+    JSON instruction = {{"name", name}, {"qubits", std::move(qubits)}};
+    if (!params.empty())
+        instruction["params"] = std::move(params);
+    return instruction;
+}
+
+std::vector<double> params_of(const JSON& instruction)
+{
+    std::vector<double> params;
+    if (auto it = instruction.find("params"); it != instruction.end()) {
+        for (const auto& param : *it) {
+            if (!param.is_number())
+                throw std::invalid_argument("The parameters of the circuit must be assigned before transpiling it.");
+            params.push_back(param.get<double>());
+        }
+    }
+    return params;
+}
+
+bool in_basis(const TranspilerOptions& options, const std::string& name)
+{
+    return options.basis_gates.empty() || options.basis_gates.contains(name);
+}
+
+// Decomposition of the multi-qubit gates into CX and single-qubit gates, or into other gates
+// that decompose in turn. None for those without one
+std::optional<std::vector<JSON>> decompose(const std::string& name, const std::vector<int>& q, const std::vector<double>& p)
+{
+    auto expect = [&](const std::size_t n_qubits, const std::size_t n_params) {
+        if (q.size() != n_qubits || p.size() != n_params)
+            throw std::invalid_argument("Gate " + name + " with wrong number of qubits or parameters.");
+    };
+    if (name == "cz") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("h", {q[1]}), gate("cx", q), gate("h", {q[1]})};
+    }
+    if (name == "cy") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("sdg", {q[1]}), gate("cx", q), gate("s", {q[1]})};
+    }
+    if (name == "ch") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("s", {q[1]}), gate("h", {q[1]}), gate("t", {q[1]}), gate("cx", q),
+                                 gate("tdg", {q[1]}), gate("h", {q[1]}), gate("sdg", {q[1]})};
+    }
+    if (name == "swap") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("cx", q), gate("cx", {q[1], q[0]}), gate("cx", q)};
+    }
+    if (name == "iswap") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("s", {q[0]}), gate("s", {q[1]}), gate("h", {q[0]}), gate("cx", q),
+                                 gate("cx", {q[1], q[0]}), gate("h", {q[1]})};
+    }
+    if (name == "dcx") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("cx", q), gate("cx", {q[1], q[0]})};
+    }
+    if (name == "ecr") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("x", {q[0]}), gate("cx", q), gate("sdg", {q[0]}), gate("sxdg", {q[1]})};
+    }
+    if (name == "rzz") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("cx", q), gate("rz", {q[1]}, p), gate("cx", q)};
+    }
+    if (name == "rxx") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("h", {q[0]}), gate("h", {q[1]}), gate("rzz", q, p), gate("h", {q[0]}), gate("h", {q[1]})};
+    }
+    if (name == "ryy") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("rx", {q[0]}, {PI / 2}), gate("rx", {q[1]}, {PI / 2}), gate("rzz", q, p),
+                                 gate("rx", {q[0]}, {-PI / 2}), gate("rx", {q[1]}, {-PI / 2})};
+    }
+    if (name == "rzx") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("h", {q[1]}), gate("rzz", q, p), gate("h", {q[1]})};
+    }
+    if (name == "cp" || name == "cu1") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("p", {q[0]}, {p[0] / 2}), gate("cx", q), gate("p", {q[1]}, {-p[0] / 2}),
+                                 gate("cx", q), gate("p", {q[1]}, {p[0] / 2})};
+    }
+    if (name == "cs" || name == "csdg" || name == "ct" || name == "ctdg") {
+        expect(2, 0);
+        const double angle = (name[1] == 's' ? PI / 2 : PI / 4) * (name.ends_with("dg") ? -1 : 1);
+        return std::vector<JSON>{gate("cp", q, {angle})};
+    }
+    if (name == "csx" || name == "csxdg") {
+        expect(2, 0);
+        return std::vector<JSON>{gate("h", {q[1]}), gate("cp", q, {name == "csx" ? PI / 2 : -PI / 2}), gate("h", {q[1]})};
+    }
+    if (name == "crz") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("rz", {q[1]}, {p[0] / 2}), gate("cx", q), gate("rz", {q[1]}, {-p[0] / 2}), gate("cx", q)};
+    }
+    if (name == "cry") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("ry", {q[1]}, {p[0] / 2}), gate("cx", q), gate("ry", {q[1]}, {-p[0] / 2}), gate("cx", q)};
+    }
+    if (name == "crx") {
+        expect(2, 1);
+        return std::vector<JSON>{gate("rz", {q[1]}, {PI / 2}), gate("ry", {q[1]}, {p[0] / 2}), gate("cx", q),
+                                 gate("ry", {q[1]}, {-p[0] / 2}), gate("cx", q), gate("rz", {q[1]}, {-PI / 2})};
+    }
+    if (name == "cu3" || name == "cu" || name == "cu2") {
+        const bool cu = name == "cu";
+        expect(2, cu ? 4 : name == "cu3" ? 3 : 2);
+        const double theta = name == "cu2" ? PI / 2 : p[0];
+        const double phi = name == "cu2" ? p[0] : p[1], lambda = name == "cu2" ? p[1] : p[2];
+        std::vector<JSON> rule;
+        if (cu)
+            rule.push_back(gate("p", {q[0]}, {p[3]}));
+        for (auto& instruction : std::vector<JSON>{
+                gate("p", {q[0]}, {(lambda + phi) / 2}), gate("p", {q[1]}, {(lambda - phi) / 2}), gate("cx", q),
+                gate("u3", {q[1]}, {-theta / 2, 0, -(phi + lambda) / 2}), gate("cx", q), gate("u3", {q[1]}, {theta / 2, phi, 0})})
+            rule.push_back(std::move(instruction));
+        return rule;
+    }
+    if (name == "ccx") {
+        expect(3, 0);
+        const int a = q[0], b = q[1], c = q[2];
+        return std::vector<JSON>{gate("h", {c}), gate("cx", {b, c}), gate("tdg", {c}), gate("cx", {a, c}), gate("t", {c}),
+                                 gate("cx", {b, c}), gate("tdg", {c}), gate("cx", {a, c}), gate("t", {b}), gate("t", {c}),
+                                 gate("h", {c}), gate("cx", {a, b}), gate("t", {a}), gate("tdg", {b}), gate("cx", {a, b})};
+    }
+    if (name == "ccz") {
+        expect(3, 0);
+        return std::vector<JSON>{gate("h", {q[2]}), gate("ccx", q), gate("h", {q[2]})};
+    }
+    if (name == "cswap") {
+        expect(3, 0);
+        return std::vector<JSON>{gate("cx", {q[2], q[1]}), gate("ccx", q), gate("cx", {q[2], q[1]})};
+    }
+    return std::nullopt;
+}
+
+// Into the basis gates, or into single-qubit gates and CX, which are resynthesized and lowered
+// once the circuit is routed. The gates of more than two qubits are decomposed when routed, even
+// if in the basis, as only pairs of qubits are coupled
+void translate(JSON&& instruction, const TranspilerOptions& options, std::vector<JSON>& out)
+{
+    const auto name = instruction.at("name").get<std::string>();
+    if (name == "id")
+        return;
+    if (name == "cif") {
+        std::vector<JSON> block;
+        for (auto& nested : instruction.at("instructions"))
+            translate(std::move(nested), options, block);
+        instruction["instructions"] = std::move(block);
+        out.push_back(std::move(instruction));
+        return;
+    }
+    const auto qubits_it = instruction.find("qubits");
+    if (qubits_it == instruction.end() || instruction.contains("instructions") ||
+        std::any_of(qubits_it->begin(), qubits_it->end(), [](const JSON& qubit) { return qubit.get<int>() < 0; }))
+        throw std::invalid_argument("Instruction " + name + " cannot be transpiled, communications are not supported.");
+    if (DIRECTIVES.contains(name)) {
+        out.push_back(std::move(instruction));
+        return;
+    }
+
+    const auto qubits = qubits_it->get<std::vector<int>>();
+    const bool routed = !options.coupling_map.empty();
+    if (name == "save_state" && routed)
+        throw std::invalid_argument("The saved states of a routed circuit would not follow the layout of its qubits.");
+    if ((in_basis(options, name) && (qubits.size() <= 2 || !routed)) || name == "cx") {
+        out.push_back(std::move(instruction));
+        return;
+    }
+
+    const auto params = params_of(instruction);
+    if (qubits.size() == 1) {
+        if (!matrix_of(name, params))
+            throw std::invalid_argument("Gate " + name + " is not in the basis gates and cannot be translated.");
+        out.push_back(std::move(instruction));
+        return;
+    }
+    auto rule = decompose(name, qubits, params);
+    if (!rule)
+        throw std::invalid_argument("Gate " + name + " is not in the basis gates and cannot be translated.");
+    for (auto& gate : *rule)
+        translate(std::move(gate), options, out);
+}
+
+// Qubits that an instruction needs at the same time, and whether two of them must be coupled
+struct Op {
+    std::vector<int> qubits;
+    bool coupled = false;
+};
+
+Op op_of(const JSON& instruction)
+{
+    Op op;
+    const auto& name = instruction.at("name").get_ref<const std::string&>();
+    if (name == "cif") {
+        bool multi_qubit = false;
+        for (const auto& nested : instruction.at("instructions")) {
+            const auto& qubits = nested.at("qubits");
+            multi_qubit = multi_qubit || (qubits.size() > 1 && !DIRECTIVES.contains(nested.at("name").get<std::string>()));
+            for (const auto& qubit : qubits) {
+                if (std::find(op.qubits.begin(), op.qubits.end(), qubit.get<int>()) == op.qubits.end())
+                    op.qubits.push_back(qubit.get<int>());
+            }
+        }
+        if (multi_qubit && op.qubits.size() > 2)
+            throw std::invalid_argument("Classically controlled blocks with multi-qubit gates on more than two qubits cannot be routed.");
+        op.coupled = multi_qubit;
+        return op;
+    }
+    op.qubits = instruction.at("qubits").get<std::vector<int>>();
+    op.coupled = op.qubits.size() == 2 && !DIRECTIVES.contains(name);
+    return op;
+}
+
+// SABRE routing of the instructions from a layout, forth or back. Returns the swaps it took and
+// leaves the final layout, and, if asked, the instructions and swaps in the order they run
+class Router {
+public:
+    struct Step {
+        std::size_t op;
+        int swap_a = -1, swap_b = -1; // Physical qubits of a swap, instead of an instruction
+    };
+
+    Router(const std::vector<Op>& ops, const std::vector<std::vector<int>>& distance,
+           const std::vector<std::vector<int>>& neighbours) :
+        ops_{ops}, distance_{distance}, neighbours_{neighbours}, n_physical_{static_cast<int>(distance.size())}
+    { }
+
+    std::size_t route(std::vector<int>& layout, const bool backwards, std::mt19937_64& rng, std::vector<Step>* steps) const
+    {
+        const std::size_t n = ops_.size();
+        auto op_at = [&](const std::size_t k) -> const Op& { return ops_[backwards ? n - 1 - k : k]; };
+
+        std::vector<int> inverse(n_physical_);
+        for (int q = 0; q < n_physical_; q++)
+            inverse[layout[q]] = q;
+        std::vector<std::deque<std::size_t>> pending(n_physical_);
+        for (std::size_t k = 0; k < n; k++) {
+            for (const int q : op_at(k).qubits)
+                pending[q].push_back(k);
+        }
+        std::vector<char> queued(n, 0);
+        std::vector<std::size_t> ready, front;
+        auto is_ready = [&](const std::size_t k) {
+            const auto& qubits = op_at(k).qubits;
+            return std::all_of(qubits.begin(), qubits.end(), [&](const int q) { return pending[q].front() == k; });
+        };
+        auto enqueue = [&](const std::size_t k) {
+            if (!queued[k] && is_ready(k)) {
+                queued[k] = 1;
+                ready.push_back(k);
+            }
+        };
+        for (std::size_t k = 0; k < n; k++) {
+            if (!op_at(k).qubits.empty())
+                enqueue(k);
+        }
+        auto gap = [&](const Op& op, const int a, const int b) {
+            auto physical = [&](const int q) { const int p = layout[q]; return p == a ? b : p == b ? a : p; };
+            return distance_[physical(op.qubits[0])][physical(op.qubits[1])];
+        };
+        auto executable = [&](const std::size_t k) { return !op_at(k).coupled || gap(op_at(k), -1, -1) == 1; };
+
+        std::vector<double> decay(n_physical_, 1.0);
+        std::size_t swaps = 0, stalled = 0;
+        auto apply_swap = [&](const int a, const int b) {
+            std::swap(inverse[a], inverse[b]);
+            layout[inverse[a]] = a;
+            layout[inverse[b]] = b;
+            decay[a] += DECAY_INCREMENT;
+            decay[b] += DECAY_INCREMENT;
+            if (steps)
+                steps->push_back({0, a, b});
+            if (++swaps % DECAY_RESET == 0)
+                std::fill(decay.begin(), decay.end(), 1.0);
+            stalled++;
+        };
+
+        while (true) {
+            while (!ready.empty()) {
+                const std::size_t k = ready.back();
+                ready.pop_back();
+                if (!executable(k)) {
+                    if (gap(op_at(k), -1, -1) >= UNREACHABLE)
+                        throw std::invalid_argument("The coupling map does not connect the qubits of a two-qubit gate.");
+                    front.push_back(k);
+                    continue;
+                }
+                if (steps)
+                    steps->push_back({backwards ? n - 1 - k : k});
+                for (const int q : op_at(k).qubits)
+                    pending[q].pop_front();
+                for (const int q : op_at(k).qubits) {
+                    if (!pending[q].empty())
+                        enqueue(pending[q].front());
+                }
+            }
+
+            const auto unblocked = std::partition(front.begin(), front.end(), [&](const std::size_t k) { return !executable(k); });
+            if (unblocked != front.end()) {
+                ready.insert(ready.end(), unblocked, front.end());
+                front.erase(unblocked, front.end());
+                std::fill(decay.begin(), decay.end(), 1.0);
+                stalled = 0;
+                continue;
+            }
+            if (front.empty())
+                break;
+
+            // Without progress for long, the closest gate is brought together along a shortest path
+            if (stalled > static_cast<std::size_t>(10 * n_physical_)) {
+                const auto closest = *std::min_element(front.begin(), front.end(), [&](const std::size_t i, const std::size_t j) {
+                    return gap(op_at(i), -1, -1) < gap(op_at(j), -1, -1);
+                });
+                const int target = layout[op_at(closest).qubits[1]];
+                while (distance_[layout[op_at(closest).qubits[0]]][target] > 1) {
+                    const int p = layout[op_at(closest).qubits[0]];
+                    for (const int next : neighbours_[p]) {
+                        if (distance_[next][target] == distance_[p][target] - 1) {
+                            apply_swap(p, next);
+                            break;
+                        }
+                    }
+                }
+                continue;
+            }
+
+            // Look-ahead on the next two-qubit gates of the qubits of the front
+            std::vector<std::size_t> extended;
+            for (const std::size_t k : front) {
+                for (const int q : op_at(k).qubits) {
+                    for (std::size_t i = 1; i < pending[q].size() && extended.size() < EXTENDED_SET_SIZE; i++) {
+                        const std::size_t next = pending[q][i];
+                        if (op_at(next).coupled && std::find(extended.begin(), extended.end(), next) == extended.end())
+                            extended.push_back(next);
+                    }
+                }
+            }
+
+            std::vector<std::pair<int, int>> best;
+            double best_score = std::numeric_limits<double>::infinity();
+            for (const std::size_t k : front) {
+                for (const int q : op_at(k).qubits) {
+                    const int a = layout[q];
+                    for (const int b : neighbours_[a]) {
+                        double front_cost = 0, extended_cost = 0;
+                        for (const std::size_t f : front)
+                            front_cost += gap(op_at(f), a, b);
+                        for (const std::size_t e : extended)
+                            extended_cost += gap(op_at(e), a, b);
+                        double score = front_cost / front.size();
+                        if (!extended.empty())
+                            score += EXTENDED_SET_WEIGHT * extended_cost / extended.size();
+                        score *= std::max(decay[a], decay[b]);
+                        const std::pair<int, int> swap = std::minmax(a, b);
+                        if (score < best_score - ANGLE_TOLERANCE) {
+                            best_score = score;
+                            best.assign(1, swap);
+                        } else if (score <= best_score + ANGLE_TOLERANCE && std::find(best.begin(), best.end(), swap) == best.end()) {
+                            best.push_back(swap);
+                        }
+                    }
+                }
+            }
+            const auto [a, b] = best[std::uniform_int_distribution<std::size_t>(0, best.size() - 1)(rng)];
+            apply_swap(a, b);
+        }
+        return swaps;
+    }
+
+private:
+    const std::vector<Op>& ops_;
+    const std::vector<std::vector<int>>& distance_;
+    const std::vector<std::vector<int>>& neighbours_;
+    int n_physical_;
+};
+
+// Visits the qubits of an instruction and of those it nests
+template <typename Instruction, typename Visitor>
+void for_each_qubit(Instruction& instruction, const Visitor& visit)
+{
+    if (auto qubits = instruction.find("qubits"); qubits != instruction.end()) {
+        for (auto& qubit : *qubits)
+            visit(qubit);
+    }
+    if (auto nested = instruction.find("instructions"); nested != instruction.end()) {
+        for (auto& gate : *nested)
+            for_each_qubit(gate, visit);
+    }
+}
+
+void map_qubits(JSON& instruction, const std::vector<int>& layout)
+{
+    for_each_qubit(instruction, [&](JSON& qubit) { qubit = layout[qubit.get<int>()]; });
+}
+
+struct Routing {
+    std::vector<int> layout; // Over every physical qubit, the idle ones after those of the circuit
+    std::vector<Router::Step> steps;
+    std::size_t swaps = 0;
+    std::vector<int> final_layout;
+};
+
+// The layout and swaps that route the instructions, the layout chosen by SABRE unless given:
+// each trial layout is refined by routing the circuit forth and back, taking the final layout
+// of each pass as the initial one of the next, and the one of fewest swaps is kept
+Routing plan_routing(const std::vector<Op>& ops, const TranspilerOptions& options, const int n_physical)
+{
+    std::vector<std::vector<int>> neighbours(n_physical);
+    for (const auto& edge : options.coupling_map) {
+        if (edge.size() != 2 || edge[0] == edge[1] || std::max(edge[0], edge[1]) >= n_physical || std::min(edge[0], edge[1]) < 0)
+            throw std::invalid_argument("The coupling map has pairs that are not of two physical qubits of the backend.");
+        for (const auto& [a, b] : {std::pair{edge[0], edge[1]}, std::pair{edge[1], edge[0]}}) {
+            if (std::find(neighbours[a].begin(), neighbours[a].end(), b) == neighbours[a].end())
+                neighbours[a].push_back(b);
+        }
+    }
+    std::vector<std::vector<int>> distance(n_physical, std::vector<int>(n_physical, UNREACHABLE));
+    for (int source = 0; source < n_physical; source++) {
+        std::deque<int> queue = {source};
+        distance[source][source] = 0;
+        while (!queue.empty()) {
+            const int p = queue.front();
+            queue.pop_front();
+            for (const int next : neighbours[p]) {
+                if (distance[source][next] == UNREACHABLE) {
+                    distance[source][next] = distance[source][p] + 1;
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+
+    const Router router(ops, distance, neighbours);
+    std::mt19937_64 rng(options.seed);
+
+    // Layouts over every physical qubit, the qubits after those of the circuit left idle
+    auto complete = [&](std::vector<int> layout) {
+        std::vector<char> used(n_physical, 0);
+        for (const int p : layout)
+            used[p] = 1;
+        for (int p = 0; p < n_physical; p++) {
+            if (!used[p])
+                layout.push_back(p);
+        }
+        return layout;
+    };
+
+    std::vector<int> layout;
+    if (!options.initial_layout.empty()) {
+        auto sorted = options.initial_layout;
+        std::sort(sorted.begin(), sorted.end());
+        if (static_cast<int>(sorted.size()) != options.n_qubits || std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end() ||
+            sorted.front() < 0 || sorted.back() >= n_physical)
+            throw std::invalid_argument("The initial layout must give a different physical qubit to each qubit of the circuit.");
+        layout = complete(options.initial_layout);
+    } else {
+        // The trivial layout is kept if it needs no swaps
+        std::vector<int> trivial(n_physical);
+        std::iota(trivial.begin(), trivial.end(), 0);
+        auto trial = trivial;
+        if (router.route(trial, false, rng, nullptr) == 0) {
+            layout = trivial;
+        } else {
+            // Dense layout, the physical qubits in the order a search reaches them from the best connected one
+            const int hub = static_cast<int>(std::max_element(neighbours.begin(), neighbours.end(), [](const auto& a, const auto& b) {
+                return a.size() < b.size();
+            }) - neighbours.begin());
+            std::vector<int> dense;
+            for (int p = 0; p < n_physical; p++) {
+                if (distance[hub][p] < UNREACHABLE)
+                    dense.push_back(p);
+            }
+            std::stable_sort(dense.begin(), dense.end(), [&](const int a, const int b) { return distance[hub][a] < distance[hub][b]; });
+            dense.resize(std::min<std::size_t>(dense.size(), options.n_qubits));
+
+            std::size_t fewest = std::numeric_limits<std::size_t>::max();
+            for (int t = 0; t < LAYOUT_TRIALS; t++) {
+                std::vector<int> candidate;
+                if (t == 0) {
+                    candidate = complete(dense);
+                } else {
+                    candidate = trivial;
+                    std::shuffle(candidate.begin(), candidate.end(), rng);
+                }
+                for (int i = 0; i < LAYOUT_ITERATIONS; i++) {
+                    router.route(candidate, false, rng, nullptr);
+                    router.route(candidate, true, rng, nullptr);
+                }
+                auto routed = candidate;
+                const auto swaps = router.route(routed, false, rng, nullptr);
+                if (swaps < fewest) {
+                    fewest = swaps;
+                    layout = candidate;
+                }
+            }
+        }
+    }
+
+    Routing routing;
+    routing.layout = layout;
+    routing.swaps = router.route(layout, false, rng, &routing.steps);
+    routing.final_layout = std::move(layout);
+    return routing;
+}
+
+// Routings of the last circuits transpiled, as the variational loops send the same circuit
+// with other parameters and its routing only depends on the qubits of its gates. Shared by the
+// workers of a vQPU and the threads of a client
+class RoutingCache {
+public:
+    std::optional<Routing> find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+            return std::nullopt;
+        it->second.last_used = ++clock_;
+        return it->second.routing;
+    }
+
+    void insert(std::string key, Routing routing)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.size() >= CAPACITY) {
+            entries_.erase(std::min_element(entries_.begin(), entries_.end(), [](const auto& a, const auto& b) {
+                return a.second.last_used < b.second.last_used;
+            }));
+        }
+        entries_.insert_or_assign(std::move(key), Entry{std::move(routing), ++clock_});
+    }
+
+private:
+    static constexpr std::size_t CAPACITY = 32;
+    struct Entry {
+        Routing routing;
+        std::uint64_t last_used;
+    };
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::uint64_t clock_ = 0;
+};
+
+RoutingCache& routing_cache()
+{
+    static RoutingCache cache;
+    return cache;
+}
+
+// What the routing depends on: the target, the layout and seed given, and the qubits of each
+// instruction, but not their names nor their parameters
+std::string routing_key(const std::vector<Op>& ops, const TranspilerOptions& options, const int n_physical)
+{
+    std::string key;
+    auto append = [&](const std::int64_t value) { key.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    append(n_physical);
+    append(options.n_qubits);
+    append(static_cast<std::int64_t>(options.seed));
+    append(options.initial_layout.size());
+    for (const int p : options.initial_layout)
+        append(p);
+    append(options.coupling_map.size());
+    for (const auto& edge : options.coupling_map) {
+        append(edge.size());
+        for (const int p : edge)
+            append(p);
+    }
+    for (const auto& op : ops) {
+        append(static_cast<std::int64_t>(op.qubits.size()) * 2 + op.coupled);
+        for (const int q : op.qubits)
+            append(q);
+    }
+    return key;
+}
+
+// The physical qubits of the circuit and the swaps that route it
+std::vector<JSON> route(std::vector<JSON>& circuit, const TranspilerOptions& options, const int n_physical, TranspilerReport& report)
+{
+    std::vector<Op> ops;
+    ops.reserve(circuit.size());
+    for (const auto& instruction : circuit)
+        ops.push_back(op_of(instruction));
+    auto key = routing_key(ops, options, n_physical);
+    auto routing = routing_cache().find(key);
+    report.cached_routing = routing.has_value();
+    if (!routing) {
+        routing = plan_routing(ops, options, n_physical);
+        routing_cache().insert(std::move(key), *routing);
+    }
+
+    report.initial_layout.assign(routing->layout.begin(), routing->layout.begin() + options.n_qubits);
+    report.swaps = routing->swaps;
+    report.final_layout.assign(routing->final_layout.begin(), routing->final_layout.begin() + options.n_qubits);
+
+    std::vector<JSON> routed;
+    routed.reserve(routing->steps.size());
+    auto current = routing->layout;
+    std::vector<int> inverse(n_physical);
+    for (int q = 0; q < n_physical; q++)
+        inverse[current[q]] = q;
+    for (const auto& step : routing->steps) {
+        if (step.swap_a >= 0) {
+            routed.push_back(gate("swap", {step.swap_a, step.swap_b}));
+            std::swap(inverse[step.swap_a], inverse[step.swap_b]);
+            current[inverse[step.swap_a]] = step.swap_a;
+            current[inverse[step.swap_b]] = step.swap_b;
+            continue;
+        }
+        JSON& instruction = circuit[step.op];
+        map_qubits(instruction, current);
+        routed.push_back(std::move(instruction));
+    }
+    // The instructions without qubits have nothing to wait for
+    for (auto& instruction : circuit) {
+        if (!instruction.is_null() && op_of(instruction).qubits.empty())
+            routed.push_back(std::move(instruction));
+    }
+    return routed;
+}
+
+// The two-qubit gates left outside the basis, CX and SWAP, into those of the basis, and those
+// on pairs coupled only the other way around reversed
+class Lowering {
+public:
+    explicit Lowering(const TranspilerOptions& options) : options_{options}
+    {
+        for (const auto& edge : options.coupling_map)
+            edges_.insert(key(edge[0], edge[1]));
+    }
+
+    void lower(JSON&& instruction, std::vector<JSON>& out) const
+    {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "cif") {
+            std::vector<JSON> block;
+            for (auto& nested : instruction.at("instructions"))
+                lower(std::move(nested), block);
+            instruction["instructions"] = std::move(block);
+            out.push_back(std::move(instruction));
+            return;
+        }
+        const auto& qubits = instruction.at("qubits");
+        if (qubits.size() != 2 || DIRECTIVES.contains(name)) {
+            out.push_back(std::move(instruction));
+            return;
+        }
+        const int a = qubits[0].get<int>(), b = qubits[1].get<int>();
+        const bool reversed = !edges_.empty() && !edges_.contains(key(a, b)) && edges_.contains(key(b, a)) && !SYMMETRIC.contains(name);
+
+        if (name == "swap" && !in_basis(options_, "swap")) {
+            for (const auto& [c, t] : {std::pair{a, b}, std::pair{b, a}, std::pair{a, b}})
+                lower(gate("cx", {c, t}), out);
+        } else if (name == "cx" && in_basis(options_, "cx")) {
+            if (reversed)
+                emit(out, {gate("h", {a}), gate("h", {b}), gate("cx", {b, a}), gate("h", {a}), gate("h", {b})});
+            else
+                out.push_back(std::move(instruction));
+        } else if (name == "cx" && in_basis(options_, "cz")) {
+            emit(out, {gate("h", {b}), gate("cz", {a, b}), gate("h", {b})});
+        } else if (name == "cx" && in_basis(options_, "ecr")) {
+            if (reversed)
+                emit(out, {gate("h", {a}), gate("sdg", {b}), gate("sx", {b}), gate("ecr", {b, a}), gate("h", {a}), gate("s", {a}), gate("h", {b})});
+            else
+                emit(out, {gate("x", {a}), gate("ecr", {a, b}), gate("s", {a}), gate("sx", {b})});
+        } else if (name == "cx") {
+            throw std::invalid_argument("The basis gates have no two-qubit gate to translate into: cx, cz or ecr.");
+        } else if (name == "ecr" && reversed) {
+            emit(out, {gate("h", {b}), gate("h", {a}), gate("ecr", {b, a}), gate("x", {b}), gate("h", {b}), gate("h", {a}), gate("x", {a})});
+        } else {
+            out.push_back(std::move(instruction));
+        }
+    }
+
+private:
+    static std::uint64_t key(const int a, const int b)
+    {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(a)) << 32) | static_cast<std::uint32_t>(b);
+    }
+
+    static void emit(std::vector<JSON>& out, std::vector<JSON>&& gates)
+    {
+        for (auto& gate : gates)
+            out.push_back(std::move(gate));
+    }
+
+    const TranspilerOptions& options_;
+    std::unordered_set<std::uint64_t> edges_;
+};
+
+double wrapped(double angle)
+{
+    angle = std::remainder(angle, 2 * PI);
+    return angle;
+}
+
+bool equal_up_to_phase(const Matrix2& a, const Matrix2& b)
+{
+    // |tr(a^dagger b)| is 2 only if they differ in a global phase
+    const Complex overlap = std::conj(a[0]) * b[0] + std::conj(a[1]) * b[1] + std::conj(a[2]) * b[2] + std::conj(a[3]) * b[3];
+    return std::abs(std::abs(overlap) - 2) < 1e-9;
+}
+
+// A single-qubit unitary as the fewest gates of the basis, from its ZYZ Euler angles, up to a
+// global phase
+std::vector<JSON> synthesize(const int qubit, const Matrix2& u, const TranspilerOptions& options)
+{
+    std::vector<JSON> out;
+    for (const auto& name : FIXED_GATES) {
+        if (in_basis(options, name) && equal_up_to_phase(*matrix_of(name, {}), u))
+            return {gate(name, {qubit})};
+    }
+
+    const double phase = std::arg(u[0] * u[3] - u[1] * u[2]) / 2;
+    const Complex unphase = std::polar(1.0, -phase);
+    const Complex v10 = u[2] * unphase, v11 = u[3] * unphase, v00 = u[0] * unphase;
+    const double theta = 2 * std::atan2(std::abs(v10), std::abs(v00));
+    const double sum = 2 * std::arg(v11), difference = 2 * std::arg(v10);
+    const double phi = (sum + difference) / 2, lambda = (sum - difference) / 2;
+    const bool no_theta = std::abs(wrapped(theta)) < ANGLE_TOLERANCE;
+
+    const std::string z_rotation = in_basis(options, "rz") ? "rz" : in_basis(options, "p") ? "p" : in_basis(options, "u1") ? "u1" : "";
+    auto add_z = [&](const double angle) {
+        if (std::abs(wrapped(angle)) > ANGLE_TOLERANCE)
+            out.push_back(gate(z_rotation, {qubit}, {wrapped(angle)}));
+    };
+
+    if ((in_basis(options, "u3") || in_basis(options, "u")) && !(no_theta && !z_rotation.empty())) {
+        out.push_back(gate(in_basis(options, "u3") ? "u3" : "u", {qubit}, {theta, phi, lambda}));
+    } else if (z_rotation.empty()) {
+        throw std::invalid_argument("The basis gates have no rotations to synthesize the single-qubit gates.");
+    } else if (no_theta) {
+        add_z(phi + lambda);
+    } else if (in_basis(options, "sx")) {
+        if (std::abs(theta - PI / 2) < ANGLE_TOLERANCE) {
+            add_z(lambda - PI / 2);
+            out.push_back(gate("sx", {qubit}));
+            add_z(phi + PI / 2);
+        } else {
+            add_z(lambda);
+            out.push_back(gate("sx", {qubit}));
+            add_z(theta + PI);
+            out.push_back(gate("sx", {qubit}));
+            add_z(phi + PI);
+        }
+    } else if (in_basis(options, "ry")) {
+        add_z(lambda);
+        out.push_back(gate("ry", {qubit}, {theta}));
+        add_z(phi);
+    } else if (in_basis(options, "rx")) {
+        add_z(lambda - PI / 2);
+        out.push_back(gate("rx", {qubit}, {theta}));
+        add_z(phi + PI / 2);
+    } else {
+        throw std::invalid_argument("The basis gates have no rotations to synthesize the single-qubit gates.");
+    }
+    return out;
+}
+
+// Each chain of single-qubit gates with any outside the basis becomes the synthesis of their
+// product, and those all in the basis are left as they are
+std::vector<JSON> resynthesize(std::vector<JSON>& circuit, const TranspilerOptions& options)
+{
+    struct Chain {
+        Matrix2 matrix = {1, 0, 0, 1};
+        std::vector<JSON> gates;
+        bool outside_basis = false;
+    };
+    std::vector<JSON> out;
+    out.reserve(circuit.size());
+    std::map<int, Chain> chains;
+
+    auto flush = [&](const int qubit) {
+        auto chain = chains.find(qubit);
+        if (chain == chains.end())
+            return;
+        if (chain->second.outside_basis) {
+            for (auto& gate : synthesize(qubit, chain->second.matrix, options))
+                out.push_back(std::move(gate));
+        } else {
+            for (auto& gate : chain->second.gates)
+                out.push_back(std::move(gate));
+        }
+        chains.erase(chain);
+    };
+    auto flush_all = [&]() {
+        while (!chains.empty())
+            flush(chains.begin()->first);
+    };
+
+    for (auto& instruction : circuit) {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "cif") {
+            flush_all();
+            instruction["instructions"] = resynthesize(instruction["instructions"].get_ref<JSON::array_t&>(), options);
+            out.push_back(std::move(instruction));
+            continue;
+        }
+        const auto qubits = instruction.at("qubits").get<std::vector<int>>();
+        if (qubits.size() == 1 && !DIRECTIVES.contains(name)) {
+            const auto params = params_of(instruction);
+            if (const auto matrix = matrix_of(name, params)) {
+                auto& chain = chains[qubits[0]];
+                chain.matrix = *matrix * chain.matrix;
+                chain.outside_basis = chain.outside_basis || !in_basis(options, name);
+                chain.gates.push_back(std::move(instruction));
+                continue;
+            }
+        }
+        for (const int qubit : qubits)
+            flush(qubit);
+        out.push_back(std::move(instruction));
+    }
+    flush_all();
+    return out;
+}
+
+// Renumbers the physical qubits that the instructions act on, in their order
+int compact(std::vector<JSON>& circuit, const int n_physical)
+{
+    std::vector<int> renumbered(n_physical, -1);
+    for (const auto& instruction : circuit)
+        for_each_qubit(instruction, [&](const JSON& qubit) { renumbered[qubit.get<int>()] = 0; });
+    int n_used = 0;
+    for (auto& index : renumbered) {
+        if (index == 0)
+            index = n_used++;
+    }
+    if (n_used == 0)
+        return n_physical;
+    for (auto& instruction : circuit)
+        map_qubits(instruction, renumbered);
+    return n_used;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+TranspilerReport transpile_circuit(std::vector<JSON>& circuit, const TranspilerOptions& options)
+{
+    TranspilerReport report;
+    report.gates_before = circuit.size();
+
+    int n_qubits = options.n_qubits;
+    for (const auto& instruction : circuit)
+        for_each_qubit(instruction, [&](const JSON& qubit) { n_qubits = std::max(n_qubits, qubit.get<int>() + 1); });
+    const int n_physical = options.n_physical_qubits > 0 ? options.n_physical_qubits : n_qubits;
+    if (n_qubits > n_physical)
+        throw std::invalid_argument("The circuit has " + std::to_string(n_qubits) + " qubits, more than the " +
+                                    std::to_string(n_physical) + " of the backend.");
+
+    std::vector<JSON> translated;
+    translated.reserve(circuit.size());
+    for (auto& instruction : circuit)
+        translate(std::move(instruction), options, translated);
+
+    TranspilerOptions routing = options;
+    routing.n_qubits = n_qubits;
+    report.n_qubits = n_qubits;
+    if (!options.coupling_map.empty()) {
+        translated = route(translated, routing, n_physical, report);
+        report.n_qubits = n_physical;
+    } else if (!options.initial_layout.empty()) {
+        if (static_cast<int>(options.initial_layout.size()) != n_qubits)
+            throw std::invalid_argument("The initial layout must give a physical qubit to each qubit of the circuit.");
+        for (auto& instruction : translated)
+            map_qubits(instruction, options.initial_layout);
+        report.initial_layout = report.final_layout = options.initial_layout;
+        report.n_qubits = std::max(n_physical, *std::max_element(options.initial_layout.begin(), options.initial_layout.end()) + 1);
+    }
+    if (report.initial_layout.empty()) {
+        report.initial_layout.resize(n_qubits);
+        std::iota(report.initial_layout.begin(), report.initial_layout.end(), 0);
+        report.final_layout = report.initial_layout;
+    }
+
+    const Lowering lowering(options);
+    std::vector<JSON> lowered;
+    lowered.reserve(translated.size());
+    for (auto& instruction : translated)
+        lowering.lower(std::move(instruction), lowered);
+    circuit = resynthesize(lowered, options);
+
+    if (options.compact_qubits)
+        report.n_qubits = compact(circuit, report.n_qubits);
+    report.gates_after = circuit.size();
+    return report;
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_set>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Target of the transpiler, that of the backend of a vQPU
+struct TranspilerOptions {
+    std::unordered_set<std::string> basis_gates; // Every gate is kept if empty
+    std::vector<std::vector<int>> coupling_map;  // Directed pairs of physical qubits, none for all to all
+    int n_qubits = 0;                            // Of the circuit
+    int n_physical_qubits = 0;                   // Of the backend, those of the circuit if 0
+    std::vector<int> initial_layout;             // Physical qubit of each qubit, chosen by the pass if empty
+    std::uint64_t seed = 0;                      // Of the random layouts tried
+    // Renumbers the physical qubits used in their order, so that the simulation takes no more
+    // than them. Not for noise models given per physical qubit
+    bool compact_qubits = false;
+};
+
+struct TranspilerReport {
+    std::size_t gates_before = 0;
+    std::size_t gates_after = 0;
+    std::size_t swaps = 0;
+    int n_qubits = 0;                // Of the transpiled circuit
+    std::vector<int> initial_layout; // Physical qubit of each qubit, before and after the swaps
+    std::vector<int> final_layout;
+    bool cached_routing = false;     // Layout and swaps reused from a circuit of the same structure
+
+    JSON to_json() const
+    {
+        return {{"gates_before", gates_before}, {"gates_after", gates_after}, {"swaps", swaps},
+                {"initial_layout", initial_layout}, {"final_layout", final_layout}, {"cached_routing", cached_routing}};
+    }
+};
+
+// Rewrites the instructions of a circuit into the basis gates and onto the coupling map of a
+// backend. The gates outside the basis are decomposed into CX and single-qubit gates, the two
+// qubit gates between qubits that are not coupled are brought together with SWAPs chosen by
+// SABRE (a layout refined by routing the circuit forth and back, then swaps scored by the
+// distance of the next gates), and each chain of single-qubit gates with any outside the basis
+// is resynthesized as a single rotation in the basis: U3, RZ-SX, RZ-RY or RZ-RX. Classically
+// controlled blocks are translated, and routed when their gates act on two qubits at most.
+// The routing of the last circuits is kept by their structure, the qubits of their gates, so
+// that those sent again with other parameters only redo the translation and resynthesis.
+// Throws std::invalid_argument for the gates it cannot translate, the communications and the
+// circuits that do not fit in the backend
+TranspilerReport transpile_circuit(std::vector<JSON>& circuit, const TranspilerOptions& options);
+
+} // End of cunqa namespace
@@ -3,12 +3,44 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include <unordered_set>
 
 #include <utils/json.hpp>
 
 namespace cunqa {
 namespace comm {
 
+// Messages and bytes that the channels of the process have sent and received, for the metrics
+// of the vQPU. Measurements sent in one frame count as one message
+struct ChannelTraffic {
+    std::atomic<std::uint64_t> sent_messages{0};
+    std::atomic<std::uint64_t> sent_bytes{0};
+    std::atomic<std::uint64_t> received_messages{0};
+    std::atomic<std::uint64_t> received_bytes{0};
+
+    void sent(const std::size_t bytes)
+    {
+        sent_messages.fetch_add(1, std::memory_order_relaxed);
+        sent_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void received(const std::size_t bytes)
+    {
+        received_messages.fetch_add(1, std::memory_order_relaxed);
+        received_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
+inline ChannelTraffic& channel_traffic()
+{
+    static ChannelTraffic traffic;
+    return traffic;
+}
+
 class ClassicalChannel {
 public:
     std::string endpoint;
@@ -17,18 +49,40 @@ public:
     ~ClassicalChannel();
 
     void publish();
+    // Only needed to connect ahead of time, as the sends connect to their target the first time
     void connect(const std::string& qpu_id);
     void send_info(const std::string& data, const std::string& target);
     std::string recv_info(const std::string& origin);
+    // Blocks until any of the origins sends info, and returns which one did along with it
+    std::pair<std::string, std::string> recv_info_any(const std::vector<std::string>& origins);
 
     void send_measure(const int& measurement, const std::string& target);
     int recv_measure(const std::string& origin);
+
+    // Several measurements in one binary frame. The receiver reads them as a stream, so a frame
+    // may be read in pieces, or several frames in one call
+    void send_measures(std::span<const std::uint8_t> measurements, const std::string& target);
+    void recv_measures(std::span<std::uint8_t> measurements, const std::string& origin);
+    // Reads nothing and returns false if the measurements have not all arrived yet
+    bool try_recv_measures(std::span<std::uint8_t> measurements, const std::string& origin);
     
 private:
     struct Impl;
     std::unique_ptr<Impl> pimpl_;
     JSON communications;
     std::string qpu_id;
+    // Targets already connected, which the threads that run the shots may send to at once
+    std::unordered_set<std::string> connected_;
+    std::mutex connected_mutex_;
+
+    void connect_once_(const std::string& target)
+    {
+        std::lock_guard lock(connected_mutex_);
+        if (!connected_.contains(target)) {
+            connect(target);
+            connected_.insert(target);
+        }
+    }
 };  
 
 } // End of comm namespace
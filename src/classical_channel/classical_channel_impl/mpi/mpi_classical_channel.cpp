@@ -1,108 +1,357 @@
+#include <span>
+#include <deque>
+#include <chrono>
 #include <string>
+#include <utility>
+#include <optional>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
 #include <mpi.h>
 
 #include "utils/helpers/net_functions.hpp"
 #include "classical_channel.hpp"
+#include "rendezvous.hpp"
+#include "../zmq/zmq_channel.hpp"
 #include "utils/json.hpp"
+#include "utils/helpers/trace.hpp"
+#include "utils/registry.hpp"
 
 #include "logger.hpp"
 
+namespace {
+
+// MPI matches the messages by source, tag and communicator, and the source rank already tells
+// the pairs apart, so each kind of traffic of a pair gets a tag of its own
+constexpr int INFO_SIZE_TAG = 1;
+constexpr int INFO_TAG = 2;
+constexpr int MEASURES_TAG = 3;
+
+// Largest measurement frame, so a receive can be posted before knowing what comes
+constexpr std::size_t MAX_FRAME = 4096;
+
+// MPI cannot wake the wait for ZMQ arrivals, so a recv_info_any with MPI origins checks them again this often
+constexpr std::chrono::milliseconds ANY_PROBE_INTERVAL{1};
+
+// Tasks of the same Slurm step share MPI_COMM_WORLD
+std::string mpi_world()
+{
+    const char* job_id = std::getenv("SLURM_JOB_ID");
+    const char* step_id = std::getenv("SLURM_STEP_ID");
+    return std::string(job_id ? job_id : "") + "." + (step_id ? step_id : "");
+}
+
+} // End of anonymous namespace
+
 namespace cunqa {
 namespace comm {
 
-struct ClassicalChannel::Impl
+// Peers raised in the same srun, with qraise --cc_mpi, talk through MPI, and the rest through ZMQ
+struct ClassicalChannel::Impl : ZmqChannel
 {
-    int mpi_size;
-    int mpi_rank;
+    bool mpi_enabled;
+    bool mpi_initialized_here = false;
+    int mpi_size = 1;
+    int mpi_rank = 0;
+    MPI_Comm mpi_comm = MPI_COMM_NULL; // Our own, so it never mixes with the MPI of the simulators
+    std::string world;
+    std::unordered_map<std::string, int> peer_ranks; // -1 for the peers reached through ZMQ
+
+    struct PendingSend {
+        std::vector<std::uint8_t> frame;
+        MPI_Request request;
+    };
+    std::deque<PendingSend> pending_sends;
 
-    Impl()
+    struct PostedRecv {
+        std::vector<std::uint8_t> frame = std::vector<std::uint8_t>(MAX_FRAME);
+        MPI_Request request = MPI_REQUEST_NULL;
+    };
+    std::unordered_map<int, PostedRecv> posted_recvs;
+    std::unordered_map<int, std::string> rank_streams; // Measurements received and not read yet
+
+    Impl(const std::string& id) :
+        ZmqChannel(id),
+        mpi_enabled{std::getenv("CUNQA_CC_MPI") != nullptr}
     {
-        MPI_Init(NULL, NULL);
-        MPI_Comm_size(MPI_COMM_WORLD, &(mpi_size));
-        MPI_Comm_rank(MPI_COMM_WORLD, &(mpi_rank));
-    
-        LOGGER_DEBUG("Communication channel with MPI configured.");
+        if (!mpi_enabled)
+            return;
+
+        int initialized;
+        MPI_Initialized(&initialized);
+        if (!initialized) {
+            MPI_Init(NULL, NULL);
+            mpi_initialized_here = true;
+        }
+        MPI_Comm_dup(MPI_COMM_WORLD, &mpi_comm);
+        MPI_Comm_size(mpi_comm, &mpi_size);
+        MPI_Comm_rank(mpi_comm, &mpi_rank);
+        world = mpi_world();
+
+        LOGGER_DEBUG("Communication channel with MPI configured, rank {} of {}.", mpi_rank, mpi_size);
     }
 
-    ~Impl() = default;
+    ~Impl()
+    {
+        if (!mpi_enabled)
+            return;
+
+        for (auto& pending : pending_sends)
+            MPI_Wait(&pending.request, MPI_STATUS_IGNORE);
+        for (auto& [rank, posted] : posted_recvs) {
+            if (posted.request != MPI_REQUEST_NULL) {
+                MPI_Cancel(&posted.request);
+                MPI_Wait(&posted.request, MPI_STATUS_IGNORE);
+            }
+        }
+        MPI_Comm_free(&mpi_comm);
+
+        int finalized;
+        MPI_Finalized(&finalized);
+        if (mpi_initialized_here && !finalized)
+            MPI_Finalize();
+    }
 
-    void send(const int& measurement, const std::string& target)
+    // Rank of the peer in our communicator, or -1 if it is outside it
+    int rank_of(const JSON& peer) const
     {
-        int target_int = std::atoi(target.c_str());
-        MPI_Send(&measurement, 1, MPI_INT, target_int, 1, MPI_COMM_WORLD);
-        
+        if (!mpi_enabled || !peer.contains("mpi_world") || peer.at("mpi_world").get<std::string>() != world)
+            return -1;
+        return peer.at("mpi_rank").get<int>();
     }
 
-    int recv(const std::string& origin)
+    // The origins connected to this channel, not the other way around, so the first message from
+    // each one looks up where it comes from
+    int origin_rank(JSON& communications, const std::string& origin)
     {
-        int measurement;
-        int origin_int = std::atoi(origin.c_str());
-        MPI_Recv(&measurement, 1, MPI_INT, origin_int, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        return measurement;
+        auto rank = peer_ranks.find(origin);
+        if (rank != peer_ranks.end())
+            return rank->second;
+
+        if (!mpi_enabled)
+            return peer_ranks[origin] = -1;
+
+        return peer_ranks[origin] = rank_of(peer_info(communications, origin));
     }
 
-    void send_str(const std::string& data, const std::string& target)
+    void send_str(const std::string& data, const int target)
     {
-        int target_int = std::atoi(target.c_str());
         int size = data.size();
-        MPI_Send(&size, 1, MPI_INT, target_int, 1, MPI_COMM_WORLD);
-        MPI_Send(&data, size, MPI_CHAR, target_int, 1, MPI_COMM_WORLD);
+        MPI_Send(&size, 1, MPI_INT, target, INFO_SIZE_TAG, mpi_comm);
+        MPI_Send(data.data(), size, MPI_CHAR, target, INFO_TAG, mpi_comm);
     }
 
-    std::string recv_str(const std::string& origin)
+    std::string recv_str(const int origin)
     {
-        int datasize;
-        std::string data;
-        int origin_int = (origin == "executor") ? (mpi_size - 1) : std::atoi(origin.c_str());
-        LOGGER_DEBUG("origin_int: {}", std::to_string(origin_int));
-        MPI_Recv(&datasize, 1, MPI_INT, origin_int, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Recv(&data, datasize, MPI_CHAR, origin_int, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        int size;
+        MPI_Recv(&size, 1, MPI_INT, origin, INFO_SIZE_TAG, mpi_comm, MPI_STATUS_IGNORE);
+        std::string data(size, '\0');
+        MPI_Recv(data.data(), size, MPI_CHAR, origin, INFO_TAG, mpi_comm, MPI_STATUS_IGNORE);
         return data;
     }
+
+    bool probe_str(const int origin)
+    {
+        int arrived;
+        MPI_Iprobe(origin, INFO_SIZE_TAG, mpi_comm, &arrived, MPI_STATUS_IGNORE);
+        return arrived;
+    }
+
+    // The frames go out with MPI_Isend, so the shot goes on while they travel. Their buffers
+    // live until MPI is done with them
+    void isend_measures(std::span<const std::uint8_t> measurements, const int target)
+    {
+        while (!pending_sends.empty()) {
+            int done;
+            MPI_Test(&pending_sends.front().request, &done, MPI_STATUS_IGNORE);
+            if (!done)
+                break;
+            pending_sends.pop_front();
+        }
+
+        while (!measurements.empty()) {
+            const std::size_t n = std::min(measurements.size(), MAX_FRAME);
+            auto& pending = pending_sends.emplace_back();
+            pending.frame.assign(measurements.begin(), measurements.begin() + n);
+            MPI_Isend(pending.frame.data(), n, MPI_UNSIGNED_CHAR, target, MEASURES_TAG, mpi_comm, &pending.request);
+            measurements = measurements.subspan(n);
+        }
+    }
+
+    // A receive per origin stays posted, so the next frame lands while the shot runs. Without
+    // wait, it stops at the first frame that has not arrived and reads nothing if they are short
+    bool irecv_measures(std::span<std::uint8_t> measurements, const int origin, const bool wait = true)
+    {
+        auto& stream = rank_streams[origin];
+        auto& posted = posted_recvs[origin];
+        if (posted.request == MPI_REQUEST_NULL)
+            MPI_Irecv(posted.frame.data(), MAX_FRAME, MPI_UNSIGNED_CHAR, origin, MEASURES_TAG, mpi_comm, &posted.request);
+
+        while (stream.size() < measurements.size()) {
+            MPI_Status status;
+            int framesize;
+            if (wait) {
+                MPI_Wait(&posted.request, &status);
+            } else {
+                int arrived;
+                MPI_Test(&posted.request, &arrived, &status);
+                if (!arrived)
+                    return false;
+            }
+            MPI_Get_count(&status, MPI_UNSIGNED_CHAR, &framesize);
+            stream.append(reinterpret_cast<const char*>(posted.frame.data()), framesize);
+            MPI_Irecv(posted.frame.data(), MAX_FRAME, MPI_UNSIGNED_CHAR, origin, MEASURES_TAG, mpi_comm, &posted.request);
+        }
+
+        std::memcpy(measurements.data(), stream.data(), measurements.size());
+        stream.erase(0, measurements.size());
+        return true;
+    }
 };
 
-ClassicalChannel::ClassicalChannel(const std::string& qpu_id) : 
+ClassicalChannel::ClassicalChannel(const std::string& qpu_id) :
     qpu_id{qpu_id},
-    pimpl_{std::make_unique<Impl>(qpu_id)} 
-{ 
-    endpoint = std::to_string(pimpl_->mpi_rank);
+    pimpl_{std::make_unique<Impl>(qpu_id)}
+{
+    endpoint = pimpl_->zmq_endpoint;
 }
 
 ClassicalChannel::~ClassicalChannel() = default;
 
-
+//-------------------------------------------------
+// Publish the endpoint for other processes to read
+//-------------------------------------------------
 void ClassicalChannel::publish()
 {
-    JSON endpoint = 
-    {
-        {"endpoint", endpoint}
-    };
-    write_on_file(endpoint, constants::COMM_FILEPATH, qpu_id);
+    JSON endpoint_json = { {"endpoint", endpoint} };
+    if (pimpl_->mpi_enabled) {
+        endpoint_json["mpi_world"] = pimpl_->world;
+        endpoint_json["mpi_rank"] = pimpl_->mpi_rank;
+    }
+    open_registry(constants::COMM_REGISTRY)->write(qpu_id, endpoint_json);
+    if (auto rendezvous = Rendezvous::of_job())
+        rendezvous->publish(qpu_id, endpoint_json);
 }
 
-void connect(const std::string& qpu_id)
+
+//--------------------------------------------------
+// Functions to stablish the other devices connected
+//--------------------------------------------------
+void ClassicalChannel::connect(const std::string& qpu_id)
 {
-    LOGGER_DEBUG("connect(const std::string& endpoint, const std::string& id) not implemented for MPI");
+    const auto& peer = peer_info(communications, qpu_id);
+    int rank = pimpl_->rank_of(peer);
+    pimpl_->peer_ranks[qpu_id] = rank;
+    if (rank == -1)
+        pimpl_->connect(peer.at("endpoint").get<std::string>(), qpu_id);
+    else
+        LOGGER_DEBUG("Messages to {} go through MPI, to rank {}.", qpu_id, rank);
 }
 
+//------------------------------------------------------------------------------------
+// Send and recv functions for arbitrary info (such as a whole circuit or an endpoint)
+//------------------------------------------------------------------------------------
 void ClassicalChannel::send_info(const std::string& data, const std::string& target)
 {
-    pimpl_->send_str(data, target);
+    ScopedSpan span("send_info", "channel", &target);
+    connect_once_(target);
+    auto rank = pimpl_->peer_ranks.find(target);
+    if (rank != pimpl_->peer_ranks.end() && rank->second != -1)
+        pimpl_->send_str(data, rank->second);
+    else
+        pimpl_->send(data, target);
+    channel_traffic().sent(data.size());
 }
 
 std::string ClassicalChannel::recv_info(const std::string& origin)
 {
-    return pimpl_->recv_str(origin);
+    ScopedSpan span("recv_info", "channel", &origin);
+    int rank = pimpl_->origin_rank(communications, origin);
+    auto data = rank == -1 ? pimpl_->recv(origin) : pimpl_->recv_str(rank);
+    channel_traffic().received(data.size());
+    return data;
+}
+
+std::pair<std::string, std::string> ClassicalChannel::recv_info_any(const std::vector<std::string>& origins)
+{
+    ScopedSpan span("recv_info_any", "channel");
+    bool any_mpi = std::any_of(origins.begin(), origins.end(), [this](const auto& origin) {
+        return pimpl_->origin_rank(communications, origin) != -1;
+    });
+    if (!any_mpi) {
+        auto received = pimpl_->recv_any(origins);
+        channel_traffic().received(received.second.size());
+        return received;
+    }
+
+    while (true) {
+        const auto seen = pimpl_->arrival_count();
+        for (const auto& origin : origins) {
+            int rank = pimpl_->origin_rank(communications, origin);
+            std::optional<std::string> data;
+            if (rank != -1 && pimpl_->probe_str(rank))
+                data = pimpl_->recv_str(rank);
+            else if (rank == -1)
+                data = pimpl_->try_recv(origin);
+            if (data) {
+                channel_traffic().received(data->size());
+                return {origin, std::move(*data)};
+            }
+        }
+        pimpl_->wait_arrival(seen, ANY_PROBE_INTERVAL);
+    }
+}
+
+//-----------------------------------------
+// Send and recv functions for measurements
+//-----------------------------------------
+void ClassicalChannel::send_measures(std::span<const std::uint8_t> measurements, const std::string& target)
+{
+    ScopedSpan span("send_measures", "channel", &target);
+    connect_once_(target);
+    auto rank = pimpl_->peer_ranks.find(target);
+    if (rank != pimpl_->peer_ranks.end() && rank->second != -1)
+        pimpl_->isend_measures(measurements, rank->second);
+    else
+        pimpl_->send_measures(measurements, target);
+    channel_traffic().sent(measurements.size());
+}
+
+void ClassicalChannel::recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    ScopedSpan span("recv_measures", "channel", &origin);
+    int rank = pimpl_->origin_rank(communications, origin);
+    if (rank == -1)
+        pimpl_->recv_measures(measurements, origin);
+    else
+        pimpl_->irecv_measures(measurements, rank);
+    channel_traffic().received(measurements.size());
 }
 
 void ClassicalChannel::send_measure(const int& measurement, const std::string& target)
 {
-    pimpl_->send(measurement, target);
+    const std::uint8_t byte = static_cast<std::uint8_t>(measurement);
+    send_measures({&byte, 1}, target);
+}
+
+bool ClassicalChannel::try_recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    int rank = pimpl_->origin_rank(communications, origin);
+    const bool received = rank == -1 ? pimpl_->try_recv_measures(measurements, origin)
+                                     : pimpl_->irecv_measures(measurements, rank, false);
+    if (received)
+        channel_traffic().received(measurements.size());
+    return received;
 }
 
 int ClassicalChannel::recv_measure(const std::string& origin)
 {
-    return pimpl_->recv(origin);
+    std::uint8_t byte;
+    recv_measures({&byte, 1}, origin);
+    return byte;
 }
 
 } // End of comm namespace
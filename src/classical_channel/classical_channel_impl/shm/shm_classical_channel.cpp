@@ -0,0 +1,180 @@
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "classical_channel/classical_channel.hpp"
+#include "classical_channel/rendezvous.hpp"
+#include "../zmq/zmq_channel.hpp"
+#include "shm_ring.hpp"
+
+#include "utils/json.hpp"
+#include "utils/helpers/trace.hpp"
+#include "utils/registry.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Measurements between QPUs of the same host go through shared memory rings, and everything
+// else, including the info messages of every peer, through ZMQ
+struct ClassicalChannel::Impl : ZmqChannel
+{
+    std::string shm_id; // Empty for the channels without id, that cannot name their rings
+    std::string hostname;
+    std::unordered_map<std::string, std::unique_ptr<ShmRing>> send_rings;
+    std::unordered_map<std::string, std::unique_ptr<ShmRing>> recv_rings;
+    std::unordered_set<std::string> remote_origins; // Reached through ZMQ
+
+    Impl(const std::string& id) :
+        ZmqChannel(id),
+        shm_id{id},
+        hostname{get_hostname()}
+    { }
+
+    bool is_local(const JSON& peer) const
+    {
+        return !shm_id.empty() && peer.contains("hostname") && peer.at("hostname").get<std::string>() == hostname;
+    }
+
+    static std::string ring_name(const std::string& sender, const std::string& receiver)
+    {
+        return "/cunqa_" + sender + "_to_" + receiver;
+    }
+
+    // Ring the measurements from the origin come through, or nullptr if they come through ZMQ.
+    // The origin connected to this channel, not the other way around, so the first measurements
+    // from it decide where the next ones come from
+    ShmRing* recv_ring(JSON& communications, const std::string& origin, const std::string& qpu_id)
+    {
+        auto ring = recv_rings.find(origin);
+        if (ring != recv_rings.end())
+            return ring->second.get();
+        if (remote_origins.contains(origin))
+            return nullptr;
+
+        if (is_local(peer_info(communications, origin))) {
+            auto& new_ring = recv_rings[origin];
+            new_ring = std::make_unique<ShmRing>(ring_name(origin, qpu_id));
+            return new_ring.get();
+        }
+        remote_origins.insert(origin);
+        return nullptr;
+    }
+};
+
+ClassicalChannel::ClassicalChannel(const std::string& qpu_id) : 
+    qpu_id{qpu_id},
+    pimpl_{std::make_unique<Impl>(qpu_id)} 
+{ 
+    endpoint = pimpl_->zmq_endpoint;
+}
+
+ClassicalChannel::~ClassicalChannel() = default;
+
+//-------------------------------------------------
+// Publish the endpoint for other processes to read
+//-------------------------------------------------
+void ClassicalChannel::publish()
+{
+    JSON endpoint_json = { {"endpoint", endpoint}, {"hostname", pimpl_->hostname} };
+    open_registry(constants::COMM_REGISTRY)->write(qpu_id, endpoint_json);
+    if (auto rendezvous = Rendezvous::of_job())
+        rendezvous->publish(qpu_id, endpoint_json);
+}
+
+
+//--------------------------------------------------
+// Functions to stablish the other devices connected
+//--------------------------------------------------
+void ClassicalChannel::connect(const std::string& qpu_id) 
+{
+    const auto& peer = peer_info(communications, qpu_id);
+
+    auto endpoint = peer.at("endpoint").get<std::string>();
+    pimpl_->connect(endpoint, qpu_id);
+
+    if (pimpl_->is_local(peer) && !pimpl_->send_rings.contains(qpu_id)) {
+        pimpl_->send_rings[qpu_id] = std::make_unique<ShmRing>(Impl::ring_name(this->qpu_id, qpu_id));
+        LOGGER_DEBUG("Measurements to {} go through shared memory.", qpu_id);
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Send and recv functions for arbitrary info (such as a whole circuit or an endpoint)
+//------------------------------------------------------------------------------------
+void ClassicalChannel::send_info(const std::string& data, const std::string& target)
+{
+    ScopedSpan span("send_info", "channel", &target);
+    connect_once_(target);
+    pimpl_->send(data, target);
+    channel_traffic().sent(data.size());
+}
+
+std::string ClassicalChannel::recv_info(const std::string& origin)
+{
+    ScopedSpan span("recv_info", "channel", &origin);
+    auto data = pimpl_->recv(origin);
+    channel_traffic().received(data.size());
+    return data;
+}
+
+std::pair<std::string, std::string> ClassicalChannel::recv_info_any(const std::vector<std::string>& origins)
+{
+    ScopedSpan span("recv_info_any", "channel");
+    auto received = pimpl_->recv_any(origins);
+    channel_traffic().received(received.second.size());
+    return received;
+}
+
+//-----------------------------------------
+// Send and recv functions for measurements
+//-----------------------------------------
+void ClassicalChannel::send_measures(std::span<const std::uint8_t> measurements, const std::string& target)
+{
+    ScopedSpan span("send_measures", "channel", &target);
+    connect_once_(target);
+    auto ring = pimpl_->send_rings.find(target);
+    if (ring != pimpl_->send_rings.end())
+        ring->second->push(measurements);
+    else
+        pimpl_->send_measures(measurements, target);
+    channel_traffic().sent(measurements.size());
+}
+
+void ClassicalChannel::recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    ScopedSpan span("recv_measures", "channel", &origin);
+    ShmRing* ring = pimpl_->recv_ring(communications, origin, qpu_id);
+    if (ring)
+        ring->pop(measurements);
+    else
+        pimpl_->recv_measures(measurements, origin);
+    channel_traffic().received(measurements.size());
+}
+
+bool ClassicalChannel::try_recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    ShmRing* ring = pimpl_->recv_ring(communications, origin, qpu_id);
+    if (!(ring ? ring->try_pop(measurements) : pimpl_->try_recv_measures(measurements, origin)))
+        return false;
+    channel_traffic().received(measurements.size());
+    return true;
+}
+
+void ClassicalChannel::send_measure(const int& measurement, const std::string& target)
+{
+    const std::uint8_t byte = static_cast<std::uint8_t>(measurement);
+    send_measures({&byte, 1}, target);
+}
+
+int ClassicalChannel::recv_measure(const std::string& origin)
+{
+    std::uint8_t byte;
+    recv_measures({&byte, 1}, origin);
+    return byte;
+}
+
+
+} // End of comm namespace
+} // End of cunqa namespace
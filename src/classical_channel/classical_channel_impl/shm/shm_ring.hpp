@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <span>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cunqa {
+namespace comm {
+
+// Single producer, single consumer byte ring of measurements in POSIX shared memory, one per sender
+// and receiver. Both ends open it with O_CREAT, so whichever comes first creates it, and the
+// zeroed pages of a new segment already are an empty ring.
+class ShmRing {
+public:
+    static constexpr std::size_t CAPACITY = 1 << 16;
+
+    ShmRing(const std::string& name) : name_{name}
+    {
+        int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd == -1)
+            throw std::runtime_error("Error opening the shared memory segment " + name_ + ".");
+
+        if (ftruncate(fd, sizeof(Layout)) == -1) {
+            close(fd);
+            throw std::runtime_error("Error sizing the shared memory segment " + name_ + ".");
+        }
+
+        void* address = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED)
+            throw std::runtime_error("Error mapping the shared memory segment " + name_ + ".");
+        layout_ = static_cast<Layout*>(address);
+    }
+
+    ~ShmRing()
+    {
+        munmap(layout_, sizeof(Layout));
+        shm_unlink(name_.c_str());
+    }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Copies as many bytes as fit at a time, publishing each piece with a single store
+    void push(std::span<const std::uint8_t> values)
+    {
+        auto tail = layout_->tail.load(std::memory_order_relaxed);
+        while (!values.empty()) {
+            Backoff backoff;
+            std::uint64_t free;
+            while ((free = CAPACITY - (tail - layout_->head.load(std::memory_order_acquire))) == 0)
+                backoff();
+
+            const std::size_t n = std::min<std::size_t>({values.size(), free, CAPACITY - tail % CAPACITY});
+            std::memcpy(layout_->slots + tail % CAPACITY, values.data(), n);
+            tail += n;
+            layout_->tail.store(tail, std::memory_order_release);
+            values = values.subspan(n);
+        }
+    }
+
+    void pop(std::span<std::uint8_t> values)
+    {
+        auto head = layout_->head.load(std::memory_order_relaxed);
+        while (!values.empty()) {
+            Backoff backoff;
+            std::uint64_t available;
+            while ((available = layout_->tail.load(std::memory_order_acquire) - head) == 0)
+                backoff();
+
+            const std::size_t n = std::min<std::size_t>({values.size(), available, CAPACITY - head % CAPACITY});
+            std::memcpy(values.data(), layout_->slots + head % CAPACITY, n);
+            head += n;
+            layout_->head.store(head, std::memory_order_release);
+            values = values.subspan(n);
+        }
+    }
+
+    // Pops nothing and returns false if there are less than the values asked for
+    bool try_pop(std::span<std::uint8_t> values)
+    {
+        const auto head = layout_->head.load(std::memory_order_relaxed);
+        if (layout_->tail.load(std::memory_order_acquire) - head < values.size())
+            return false;
+        pop(values);
+        return true;
+    }
+
+private:
+    // Head and tail on cache lines of their own, so the two ends do not invalidate each other
+    struct Layout {
+        alignas(64) std::atomic<std::uint64_t> head;
+        alignas(64) std::atomic<std::uint64_t> tail;
+        alignas(64) std::uint8_t slots[CAPACITY];
+    };
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "The ring needs address free atomics.");
+
+    // Spins first, as the other end is usually in the same shot, and sleeps after a while so a
+    // long wait does not take a whole core
+    struct Backoff {
+        unsigned spins = 0;
+        void operator()()
+        {
+            ++spins;
+            if (spins < 1024)
+                return;
+            else if (spins < 2048)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    };
+
+    std::string name_;
+    Layout* layout_;
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
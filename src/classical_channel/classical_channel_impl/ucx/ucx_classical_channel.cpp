@@ -0,0 +1,181 @@
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "classical_channel/classical_channel.hpp"
+#include "classical_channel/rendezvous.hpp"
+#include "../zmq/zmq_channel.hpp"
+#include "comm/comm_impl/ucx/ucx_worker.hpp"
+
+#include "utils/json.hpp"
+#include "utils/helpers/trace.hpp"
+#include "utils/registry.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Info and measurements go through UCX to the peers that published a UCX worker, over RDMA where
+// the nodes have it, and through ZMQ to the rest. The info messages large enough, as the circuits,
+// go by rendezvous, fetched from the buffer of the sender into the message queued for the
+// receiver. Both arrive to the inboxes of ZMQ, so the receiving side does not know the difference
+struct ClassicalChannel::Impl : ZmqChannel
+{
+    std::unique_ptr<UcxWorker<zmq::message_t>> ucx; // Null if UCX could not start
+    std::unordered_map<std::string, ucp_ep_h> ucx_eps;
+
+    Impl(const std::string& id) :
+        ZmqChannel(id)
+    {
+        try {
+            ucx = std::make_unique<UcxWorker<zmq::message_t>>(
+                [this](std::string origin, zmq::message_t message, ucp_ep_h) { deliver(origin, std::move(message)); });
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("{} The classical communications go through ZMQ.", e.what());
+        }
+    }
+
+    // Before the worker goes, and the inboxes it delivers to
+    ~Impl()
+    {
+        for (auto& [id, ep] : ucx_eps)
+            ucx->close(ep);
+        ucx.reset();
+    }
+
+    // Endpoint of the target, or nullptr if it is reached through ZMQ
+    ucp_ep_h ucx_ep(const std::string& target) const
+    {
+        auto ep = ucx_eps.find(target);
+        return ep == ucx_eps.end() ? nullptr : ep->second;
+    }
+
+    void send(const std::string& data, const std::string& target)
+    {
+        if (ucp_ep_h ep = ucx_ep(target))
+            ucx->send(ep, zmq_id, data.data(), data.size());
+        else
+            ZmqChannel::send(data, target);
+    }
+
+    void send_measures(std::span<const std::uint8_t> measurements, const std::string& target)
+    {
+        if (ucp_ep_h ep = ucx_ep(target))
+            ucx->send(ep, zmq_id, measurements.data(), measurements.size());
+        else
+            ZmqChannel::send_measures(measurements, target);
+    }
+};
+
+ClassicalChannel::ClassicalChannel(const std::string& qpu_id) :
+    qpu_id{qpu_id},
+    pimpl_{std::make_unique<Impl>(qpu_id)}
+{
+    endpoint = pimpl_->zmq_endpoint;
+}
+
+ClassicalChannel::~ClassicalChannel() = default;
+
+//-------------------------------------------------
+// Publish the endpoint for other processes to read
+//-------------------------------------------------
+void ClassicalChannel::publish()
+{
+    JSON endpoint_json = { {"endpoint", endpoint} };
+    if (pimpl_->ucx)
+        endpoint_json["ucx_address"] = pimpl_->ucx->address();
+    open_registry(constants::COMM_REGISTRY)->write(qpu_id, endpoint_json);
+    if (auto rendezvous = Rendezvous::of_job())
+        rendezvous->publish(qpu_id, endpoint_json);
+}
+
+
+//--------------------------------------------------
+// Functions to stablish the other devices connected
+//--------------------------------------------------
+void ClassicalChannel::connect(const std::string& qpu_id)
+{
+    const auto& peer = peer_info(communications, qpu_id);
+
+    auto endpoint = peer.at("endpoint").get<std::string>();
+    pimpl_->connect(endpoint, qpu_id);
+
+    if (pimpl_->ucx && peer.contains("ucx_address") && !pimpl_->ucx_eps.contains(qpu_id)) {
+        try {
+            pimpl_->ucx_eps[qpu_id] = pimpl_->ucx->connect(peer.at("ucx_address").get<std::string>());
+            LOGGER_DEBUG("Classical communications with {} go through UCX.", qpu_id);
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("{} The classical communications with {} go through ZMQ.", e.what(), qpu_id);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------------
+// Send and recv functions for arbitrary info (such as a whole circuit or an endpoint)
+//------------------------------------------------------------------------------------
+void ClassicalChannel::send_info(const std::string& data, const std::string& target)
+{
+    ScopedSpan span("send_info", "channel", &target);
+    connect_once_(target);
+    pimpl_->send(data, target);
+    channel_traffic().sent(data.size());
+}
+
+std::string ClassicalChannel::recv_info(const std::string& origin)
+{
+    ScopedSpan span("recv_info", "channel", &origin);
+    auto data = pimpl_->recv(origin);
+    channel_traffic().received(data.size());
+    return data;
+}
+
+std::pair<std::string, std::string> ClassicalChannel::recv_info_any(const std::vector<std::string>& origins)
+{
+    ScopedSpan span("recv_info_any", "channel");
+    auto received = pimpl_->recv_any(origins);
+    channel_traffic().received(received.second.size());
+    return received;
+}
+
+//-----------------------------------------
+// Send and recv functions for measurements
+//-----------------------------------------
+void ClassicalChannel::send_measures(std::span<const std::uint8_t> measurements, const std::string& target)
+{
+    ScopedSpan span("send_measures", "channel", &target);
+    connect_once_(target);
+    pimpl_->send_measures(measurements, target);
+    channel_traffic().sent(measurements.size());
+}
+
+void ClassicalChannel::recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    ScopedSpan span("recv_measures", "channel", &origin);
+    pimpl_->recv_measures(measurements, origin);
+    channel_traffic().received(measurements.size());
+}
+
+bool ClassicalChannel::try_recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+{
+    if (!pimpl_->try_recv_measures(measurements, origin))
+        return false;
+    channel_traffic().received(measurements.size());
+    return true;
+}
+
+void ClassicalChannel::send_measure(const int& measurement, const std::string& target)
+{
+    const std::uint8_t byte = static_cast<std::uint8_t>(measurement);
+    send_measures({&byte, 1}, target);
+}
+
+int ClassicalChannel::recv_measure(const std::string& origin)
+{
+    std::uint8_t byte;
+    recv_measures({&byte, 1}, origin);
+    return byte;
+}
+
+
+} // End of comm namespace
+} // End of cunqa namespace
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <span>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include "zmq.hpp"
+
+#include "utils/helpers/net_functions.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// ZMQ side of the classical channel: a ROUTER socket that receives from everyone and a DEALER
+// socket per target. Shared by the implementations that send, or fall back to, ZMQ.
+// A poller thread owns the ROUTER socket and moves each message, without copying it, to the
+// inbox of its origin, so a recv only waits on the inbox of the peer it reads from.
+struct ZmqChannel
+{
+    // Messages of one peer in arrival order. The measurements are read from them as a stream,
+    // so the front message may be partly read
+    struct Inbox {
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::deque<zmq::message_t> messages;
+        std::size_t read_offset = 0; // Bytes read from the front message
+        std::size_t available = 0;   // Bytes queued and not read yet
+    };
+
+    // How often the poller checks whether the channel is closing
+    static constexpr std::chrono::milliseconds POLL_TIMEOUT{100};
+
+    std::string zmq_endpoint;
+    std::string zmq_id;
+
+    zmq::context_t zmq_context;
+    std::unordered_map<std::string, zmq::socket_t> zmq_sockets;
+    zmq::socket_t zmq_comm_server;
+
+    std::mutex peers_mutex;
+    std::unordered_map<std::string, std::size_t> peer_handles; // Assigned at connect, or at the first message
+    std::vector<std::unique_ptr<Inbox>> inboxes;               // By peer handle
+
+    // Messages moved to any inbox, so a recv_any knows whether to look at the inboxes again
+    std::mutex arrivals_mutex;
+    std::condition_variable any_arrived;
+    std::uint64_t arrivals = 0;
+
+    std::atomic<bool> stopping = false;
+    std::thread poller;
+
+    ZmqChannel(const std::string& id)
+    {
+        //Endpoint part
+        auto IP = get_IP_address();
+        zmq_endpoint = "tcp://" + IP + ":*";
+
+        //Server part
+        zmq::socket_t qpu_server_socket_(zmq_context, zmq::socket_type::router);
+        qpu_server_socket_.bind(zmq_endpoint);
+
+        char endpoint[256];
+        size_t sz = sizeof(endpoint);
+        zmq_getsockopt(qpu_server_socket_, ZMQ_LAST_ENDPOINT, endpoint, &sz);
+        zmq_endpoint = std::string(endpoint);
+        zmq_id = id == "" ? zmq_endpoint : id;
+
+        zmq_comm_server = std::move(qpu_server_socket_);
+        poller = std::thread([this] { poll_(); });
+    }
+
+    ~ZmqChannel()
+    {
+        stopping = true;
+        if (poller.joinable())
+            poller.join();
+    }
+
+    std::size_t peer(const std::string& id)
+    {
+        std::lock_guard lock(peers_mutex);
+        auto [handle, inserted] = peer_handles.try_emplace(id, inboxes.size());
+        if (inserted)
+            inboxes.push_back(std::make_unique<Inbox>());
+        return handle->second;
+    }
+
+    // Inboxes are never removed, so the reference outlives the lock
+    Inbox& inbox(const std::size_t handle)
+    {
+        std::lock_guard lock(peers_mutex);
+        return *inboxes[handle];
+    }
+
+    void connect(const std::string& endpoint, const std::string& id)
+    {
+        if (zmq_sockets.find(id) == zmq_sockets.end()) {
+            zmq::socket_t tmp_client_socket(zmq_context, zmq::socket_type::dealer);
+            tmp_client_socket.setsockopt(ZMQ_IDENTITY, zmq_id.c_str(), zmq_id.size());
+            zmq_sockets[id] = std::move(tmp_client_socket);
+            zmq_sockets[id].connect(endpoint);
+            peer(id);
+        }
+    }
+
+    void send(const std::string& data, const std::string& target)
+    {
+        if (zmq_sockets.find(target) == zmq_sockets.end()) {
+            LOGGER_ERROR("No connections were established with endpoint {} trying to send. {}", target, data);
+            throw std::runtime_error("Error with endpoint connection.");
+        }
+        zmq::message_t message(data.begin(), data.end());
+
+        zmq_sockets[target].send(message, zmq::send_flags::none);
+
+    }
+
+    void send_measures(std::span<const std::uint8_t> measurements, const std::string& target)
+    {
+        if (zmq_sockets.find(target) == zmq_sockets.end()) {
+            LOGGER_ERROR("No connections were established with endpoint {} trying to send measurements.", target);
+            throw std::runtime_error("Error with endpoint connection.");
+        }
+        zmq::message_t message(measurements.data(), measurements.size());
+
+        zmq_sockets[target].send(message, zmq::send_flags::none);
+    }
+
+    std::string recv(const std::string& origin)
+    {
+        auto& box = inbox(peer(origin));
+        std::unique_lock lock(box.mutex);
+        box.arrived.wait(lock, [&box] { return !box.messages.empty(); });
+
+        return pop_info_(box);
+    }
+
+    std::optional<std::string> try_recv(const std::string& origin)
+    {
+        auto& box = inbox(peer(origin));
+        std::lock_guard lock(box.mutex);
+        if (box.messages.empty())
+            return std::nullopt;
+        return pop_info_(box);
+    }
+
+    // Next message of whichever origin sends first, with the origin it came from
+    std::pair<std::string, std::string> recv_any(const std::vector<std::string>& origins)
+    {
+        while (true) {
+            const auto seen = arrival_count();
+            for (const auto& origin : origins) {
+                if (auto data = try_recv(origin))
+                    return {origin, std::move(*data)};
+            }
+            wait_arrival(seen);
+        }
+    }
+
+    std::uint64_t arrival_count()
+    {
+        std::lock_guard lock(arrivals_mutex);
+        return arrivals;
+    }
+
+    // Until a message arrives after the count was seen, or the timeout expires
+    void wait_arrival(const std::uint64_t seen, const std::chrono::milliseconds timeout = std::chrono::milliseconds::max())
+    {
+        std::unique_lock lock(arrivals_mutex);
+        if (timeout == std::chrono::milliseconds::max())
+            any_arrived.wait(lock, [this, seen] { return arrivals != seen; });
+        else
+            any_arrived.wait_for(lock, timeout, [this, seen] { return arrivals != seen; });
+    }
+
+    // Fills the measurements with the next bytes from the origin, whatever the frames they came in
+    void recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+    {
+        auto& box = inbox(peer(origin));
+        std::unique_lock lock(box.mutex);
+        box.arrived.wait(lock, [&box, &measurements] { return box.available >= measurements.size(); });
+        read_(box, measurements);
+    }
+
+    // As recv_measures, but reads nothing and returns false if they have not all arrived yet
+    bool try_recv_measures(std::span<std::uint8_t> measurements, const std::string& origin)
+    {
+        auto& box = inbox(peer(origin));
+        std::lock_guard lock(box.mutex);
+        if (box.available < measurements.size())
+            return false;
+        read_(box, measurements);
+        return true;
+    }
+
+    // Moves a message to the inbox of its origin. Also for the implementations that receive
+    // through something else than the ROUTER socket
+    void deliver(const std::string& origin, zmq::message_t message)
+    {
+        auto& box = inbox(peer(origin));
+        {
+            std::lock_guard lock(box.mutex);
+            box.available += message.size();
+            box.messages.push_back(std::move(message));
+        }
+        box.arrived.notify_all();
+        {
+            std::lock_guard lock(arrivals_mutex);
+            arrivals++;
+        }
+        any_arrived.notify_all();
+    }
+
+private:
+    // With the lock of the inbox held, and a message in it
+    static std::string pop_info_(Inbox& box)
+    {
+        auto message = std::move(box.messages.front());
+        box.messages.pop_front();
+        std::string data(static_cast<const char*>(message.data()) + box.read_offset, message.size() - box.read_offset);
+        box.available -= data.size();
+        box.read_offset = 0;
+        return data;
+    }
+
+    // With the lock of the inbox held, and enough bytes in it
+    static void read_(Inbox& box, std::span<std::uint8_t> measurements)
+    {
+        box.available -= measurements.size();
+        while (!measurements.empty()) {
+            auto& front = box.messages.front();
+            const std::size_t n = std::min(measurements.size(), front.size() - box.read_offset);
+            std::memcpy(measurements.data(), static_cast<const std::uint8_t*>(front.data()) + box.read_offset, n);
+            measurements = measurements.subspan(n);
+
+            box.read_offset += n;
+            if (box.read_offset == front.size()) {
+                box.messages.pop_front();
+                box.read_offset = 0;
+            }
+        }
+    }
+
+    void poll_()
+    {
+        zmq::pollitem_t items[] = { {zmq_comm_server.handle(), 0, ZMQ_POLLIN, 0} };
+        try {
+            while (!stopping) {
+                zmq::poll(items, 1, POLL_TIMEOUT);
+                if (!(items[0].revents & ZMQ_POLLIN))
+                    continue;
+
+                zmq::message_t id;
+                zmq::message_t message;
+                [[maybe_unused]] auto ret1 = zmq_comm_server.recv(id, zmq::recv_flags::none);
+                [[maybe_unused]] auto ret2 = zmq_comm_server.recv(message, zmq::recv_flags::none);
+
+                deliver(id.to_string(), std::move(message));
+            }
+        } catch (const zmq::error_t& e) {
+            LOGGER_ERROR("The ZMQ poller of the classical channel stopped: {}", e.what());
+        }
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
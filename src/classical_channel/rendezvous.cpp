@@ -0,0 +1,213 @@
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <utility>
+#include <algorithm>
+#include "zmq.hpp"
+
+#include "rendezvous.hpp"
+#include "utils/constants.hpp"
+#include "utils/registry.hpp"
+#include "utils/helpers/net_functions.hpp"
+
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// How often the server checks whether the registry is closing
+constexpr std::chrono::milliseconds POLL_TIMEOUT{100};
+
+// Longest wait between two reads of the communications registry, while the registry is not there
+constexpr std::chrono::milliseconds MAX_BACKOFF{500};
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace comm {
+
+struct Rendezvous::Impl
+{
+    std::string job_id;
+    zmq::context_t context;
+    zmq::socket_t registry; // Only used by the server thread of the process that serves it
+    std::mutex client_mutex;
+    zmq::socket_t client;
+
+    std::atomic<bool> stopping = false;
+    std::thread server;
+
+    Impl(const std::string& job_id) : job_id{job_id}
+    {
+        const std::string key = job_id + "_rendezvous";
+
+        registry = zmq::socket_t(context, zmq::socket_type::router);
+        registry.bind("tcp://" + get_IP_address() + ":*");
+        char endpoint_chars[256];
+        size_t sz = sizeof(endpoint_chars);
+        zmq_getsockopt(registry, ZMQ_LAST_ENDPOINT, endpoint_chars, &sz);
+        std::string endpoint(endpoint_chars);
+
+        if (open_registry(constants::COMM_REGISTRY)->claim(key, {{"endpoint", endpoint}})) {
+            server = std::thread([this] { serve_(); });
+            LOGGER_DEBUG("Serving the rendezvous of job {} at {}.", job_id, endpoint);
+        } else {
+            registry.close();
+            endpoint = find_registry_(key);
+        }
+
+        client = zmq::socket_t(context, zmq::socket_type::req);
+        client.set(zmq::sockopt::linger, 0);
+        client.connect(endpoint);
+    }
+
+    ~Impl()
+    {
+        stopping = true;
+        if (server.joinable())
+            server.join();
+    }
+
+    // The file is read with a growing wait, as its owner claims it at its own start
+    static std::string find_registry_(const std::string& key)
+    {
+        auto communications_registry = open_registry(constants::COMM_REGISTRY);
+        std::chrono::milliseconds backoff{10};
+        while (true) {
+            JSON communications = communications_registry->read();
+            if (communications.contains(key))
+                return communications.at(key).at("endpoint").get<std::string>();
+
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min(2 * backoff, MAX_BACKOFF);
+        }
+    }
+
+    JSON request(const JSON& message)
+    {
+        std::lock_guard lock(client_mutex);
+        std::string payload = message.dump();
+        client.send(zmq::buffer(payload), zmq::send_flags::none);
+
+        zmq::message_t reply;
+        [[maybe_unused]] auto ret = client.recv(reply, zmq::recv_flags::none);
+        return JSON::parse(reply.to_string());
+    }
+
+    // The lookups and waits that cannot be answered yet wait for the publications that answer them
+    void serve_()
+    {
+        JSON entries = JSON::object();
+        std::vector<std::pair<std::string, JSON>> waiting; // Identity of the client and request
+
+        zmq::pollitem_t items[] = { {registry.handle(), 0, ZMQ_POLLIN, 0} };
+        try {
+            while (!stopping) {
+                zmq::poll(items, 1, POLL_TIMEOUT);
+                if (!(items[0].revents & ZMQ_POLLIN))
+                    continue;
+
+                // REQ clients send their identity, an empty delimiter and the request
+                zmq::message_t identity, delimiter, payload;
+                [[maybe_unused]] auto ret1 = registry.recv(identity, zmq::recv_flags::none);
+                [[maybe_unused]] auto ret2 = registry.recv(delimiter, zmq::recv_flags::none);
+                [[maybe_unused]] auto ret3 = registry.recv(payload, zmq::recv_flags::none);
+                JSON message = JSON::parse(payload.to_string());
+
+                if (message.at("op") == "publish") {
+                    entries[message.at("id").get<std::string>()] = message.at("info");
+                    reply_(identity.to_string(), JSON::object());
+                    std::erase_if(waiting, [&](const auto& pending) { return answer_(pending.first, pending.second, entries); });
+                } else if (!answer_(identity.to_string(), message, entries)) {
+                    waiting.push_back({identity.to_string(), message});
+                }
+            }
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("The rendezvous of job {} stopped: {}", job_id, e.what());
+        }
+    }
+
+    bool answer_(const std::string& identity, const JSON& message, const JSON& entries)
+    {
+        if (message.at("op") == "lookup") {
+            const auto& id = message.at("id").get<std::string>();
+            if (!entries.contains(id))
+                return false;
+            reply_(identity, entries.at(id));
+            return true;
+        }
+
+        const auto& prefix = message.at("prefix").get<std::string>();
+        JSON found = JSON::object();
+        for (const auto& [id, info] : entries.items()) {
+            if (id.starts_with(prefix))
+                found[id] = info;
+        }
+        if (found.size() < message.at("n").get<std::size_t>())
+            return false;
+        reply_(identity, found);
+        return true;
+    }
+
+    void reply_(const std::string& identity, const JSON& answer)
+    {
+        std::string payload = answer.dump();
+        registry.send(zmq::buffer(identity), zmq::send_flags::sndmore);
+        registry.send(zmq::message_t(), zmq::send_flags::sndmore);
+        registry.send(zmq::buffer(payload), zmq::send_flags::none);
+    }
+};
+
+Rendezvous::Rendezvous(const std::string& job_id) :
+    pimpl_{std::make_unique<Impl>(job_id)}
+{ }
+
+Rendezvous::~Rendezvous() = default;
+
+Rendezvous* Rendezvous::of_job()
+{
+    static std::unique_ptr<Rendezvous> rendezvous = [] {
+        const char* job_id = std::getenv("SLURM_JOB_ID");
+        return job_id ? std::unique_ptr<Rendezvous>(new Rendezvous(job_id)) : nullptr;
+    }();
+    return rendezvous.get();
+}
+
+bool Rendezvous::in_job(const std::string& id) const
+{
+    return id.substr(0, id.find('_')) == pimpl_->job_id;
+}
+
+void Rendezvous::publish(const std::string& id, const JSON& info)
+{
+    pimpl_->request({{"op", "publish"}, {"id", id}, {"info", info}});
+}
+
+JSON Rendezvous::lookup(const std::string& id)
+{
+    return pimpl_->request({{"op", "lookup"}, {"id", id}});
+}
+
+JSON Rendezvous::wait_for(const std::string& prefix, const std::size_t n)
+{
+    return pimpl_->request({{"op", "wait_for"}, {"prefix", prefix}, {"n", n}});
+}
+
+const JSON& peer_info(JSON& communications, const std::string& id)
+{
+    if (!communications.contains(id)) {
+        auto rendezvous = Rendezvous::of_job();
+        if (rendezvous && rendezvous->in_job(id))
+            communications[id] = rendezvous->lookup(id);
+        else
+            communications.update(open_registry(constants::COMM_REGISTRY)->read());
+    }
+    return communications.at(id);
+}
+
+} // End of comm namespace
+} // End of cunqa namespace
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Registry where the processes of a Slurm job exchange their endpoints. The first process of
+// the job to ask for it claims the "<job id>_rendezvous" key of the communications registry and
+// serves it, and the rest only read the registry until they find where it is
+class Rendezvous {
+public:
+    // Registry of the job, or nullptr outside of Slurm
+    static Rendezvous* of_job();
+
+    ~Rendezvous();
+
+    // Ids are "<job id>_<anything>"
+    bool in_job(const std::string& id) const;
+
+    void publish(const std::string& id, const JSON& info);
+
+    // Block until the id, or n ids starting with the prefix, are published
+    JSON lookup(const std::string& id);
+    JSON wait_for(const std::string& prefix, const std::size_t n);
+
+private:
+    Rendezvous(const std::string& job_id);
+
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+// Published info of a peer, cached in communications. The peers of this job are asked to its
+// registry and the rest looked up in the communications registry
+const JSON& peer_info(JSON& communications, const std::string& id);
+
+} // End of comm namespace
+} // End of cunqa namespace
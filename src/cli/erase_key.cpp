@@ -4,19 +4,21 @@
 #include <stdexcept>
 
 #include "utils/json.hpp"
+#include "utils/registry.hpp"
 
 using namespace cunqa;
 
 int main(int argc, char* argv[]) {
     try {
         if (argc != 3) {
-            std::cerr << "Error, two arguments have to be provided: " << argv[0] << " <job_id> <info_path>\n";
+            std::cerr << "Error, two arguments have to be provided: " << argv[0] << " <job_id> <registry_path>\n";
             return 1;
         }
 
         const std::string job_id = argv[1];
-        const std::string info_path = argv[2];
-        remove_from_file(info_path, job_id);
+        const std::string registry_path = argv[2];
+        // Not those of the jobs whose id starts with this one
+        open_registry(registry_path)->remove(job_id + "_");
 
         return 0;
     } catch (const std::exception& e) {
@@ -10,11 +10,17 @@
 #include <unordered_set>
 #include <ranges>
 #include <regex>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <algorithm>
 
 #include "argparse/argparse.hpp"
 #include "logger.hpp"
 #include "utils/constants.hpp"
 #include "utils/json.hpp"
+#include "utils/registry.hpp"
+#include "comm/client.hpp"
 
 using namespace std::literals;
 
@@ -24,14 +30,13 @@ struct CunqaArgs : public argparse::Args
     std::optional<std::vector<std::string>>& family = kwarg("fam,family_name", "Family name of the QPUs to be dropped.");
     bool &remove_logs                               = flag("rm, remove_logs", "Logs files qraise_XXXXXX will be deleted.");
     bool &all                                       = flag("all", "All qraise jobs will be dropped.");
+    std::optional<int>& shrink                      = kwarg("shrink", "Number of QPUs of the family (--fam) to drain instead of dropping it. They finish their tasks and take no more, and the jobs left with all their QPUs drained are dropped.");
+    int& timeout                                    = kwarg("timeout", "Seconds that the QPUs get to answer their queued tasks as unavailable and leave the registry before their jobs are cancelled. 0 cancels them right away.").set_default(10);
 };
 
 cunqa::JSON read_qpus_json() 
 {
-    std::ifstream in(cunqa::constants::QPUS_FILEPATH);
-    cunqa::JSON j;
-    in >> j;
-    return j;
+    return cunqa::open_registry(cunqa::constants::QPUS_REGISTRY)->read();
 }
 
 std::vector<std::string> get_qpus_ids(const cunqa::JSON& jobs)
@@ -51,6 +56,7 @@ std::vector<std::string> get_qpus_ids(const cunqa::JSON& jobs)
     return ids;
 }
 
+// Jobs of the families, that span several of them when they were grown with qraise --grow
 std::vector<std::string> find_family_id(const cunqa::JSON& qpus, std::vector<std::string> target_families) {
     std::vector<std::string> ids;
 
@@ -63,10 +69,9 @@ std::vector<std::string> find_family_id(const cunqa::JSON& qpus, std::vector<std
             if (itFam == entry.end() || itJob == entry.end()) continue;
 
             std::string fam = itFam->get<std::string>();
-            if (fam == target_family) {
-                ids.push_back(itJob->get<std::string>());
-                break;
-            }
+            std::string job = itJob->get<std::string>();
+            if (fam == target_family && std::find(ids.begin(), ids.end(), job) == ids.end())
+                ids.push_back(job);
         }
     }
 
@@ -86,14 +91,148 @@ void removeJobs(const std::vector<std::string>& job_ids, const bool& all = false
               << job_ids_str
               << "\033[0m" << "\n";
 
-    // In case the qpus.json is not correctly removed
+    // In case the epilog does not remove their entries from the registry
     if (all) {
-        auto left_jobs = read_qpus_json();
-        if(size(left_jobs)) {
-            std::ofstream ofs(cunqa::constants::QPUS_FILEPATH, std::ios::trunc);
-            ofs << "{}";
+        auto registry = cunqa::open_registry(cunqa::constants::QPUS_REGISTRY);
+        for (const auto& job_id : job_ids)
+            registry->remove(job_id + "_");
+    }
+}
+
+// QPUs in hpc mode only listen on their own node
+bool reachable(const cunqa::JSON& net)
+{
+    const char* nodename = std::getenv("SLURMD_NODENAME");
+    return net.value("mode", "") != "hpc" || net.value("nodename", "") == (nodename ? nodename : "login");
+}
+
+// Asks the QPUs of the jobs to answer the tasks they queued as unavailable, so their clients
+// send them elsewhere, and to leave the registry, and waits for them at most the timeout. The
+// jobs are cancelled afterwards anyway, with the QPUs that did not make it
+void drain_jobs(const std::vector<std::string>& job_ids, const int timeout)
+{
+    if (timeout <= 0)
+        return;
+    const auto of_jobs = [&job_ids](const cunqa::JSON& entry) {
+        return std::ranges::find(job_ids, entry.value("slurm_job_id", "")) != job_ids.end();
+    };
+
+    // Alive until the end, so that their requests go out
+    std::vector<std::unique_ptr<cunqa::comm::Client>> clients;
+    const std::string options = cunqa::JSON({{"reject", true}, {"exit", true}}).dump();
+    for (const auto& [id, entry] : read_qpus_json().items()) {
+        if (!entry.is_object() || !of_jobs(entry) || !entry.contains("net") || !reachable(entry.at("net")))
+            continue;
+        try {
+            auto client = std::make_unique<cunqa::comm::Client>();
+            client->connect(entry.at("net").at("endpoint").get<std::string>());
+            client->send_drain(options);
+            clients.push_back(std::move(client));
+        } catch (const std::exception& e) {
+            LOGGER_DEBUG("QPU {} not drained: {}", id, e.what());
+        }
+    }
+    if (clients.empty())
+        return;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    while (std::chrono::steady_clock::now() < deadline) {
+        const auto registered = read_qpus_json();
+        if (std::ranges::none_of(registered.items(), [&](const auto& item) { return of_jobs(item.value()); }))
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+    std::cerr << "\033[1;33m" << "Warning: " << "\033[0m" << "Some QPUs did not leave within " << timeout 
+              << " s, they are cancelled with the tasks they hold.\n";
+}
+
+struct DrainingQPU {
+    std::string id;
+    std::string job_id;
+    std::unique_ptr<cunqa::comm::Client> client;
+    bool drained = false;
+};
+
+// Tasks that the QPU still has queued or running, or nullopt if it does not answer in time
+std::optional<std::size_t> pending_tasks(cunqa::comm::FutureWrapper<cunqa::comm::Client> future)
+{
+    if (!future.wait_for(std::chrono::seconds(5)))
+        return std::nullopt;
+    const auto status = cunqa::JSON::parse(future.get());
+    return status.value("depth", std::size_t{0}) + status.value("running", std::size_t{0});
+}
+
+// Drains the newest QPUs of the family, waits until they finish the tasks they queued, and drops
+// the jobs left with all their QPUs drained. The drained QPUs of the jobs that keep others
+// taking tasks stay idle until their job ends
+int shrink_family(const cunqa::JSON& qpus, const std::string& family, const int n_qpus)
+{
+    std::vector<std::pair<std::string, cunqa::JSON>> candidates;
+    for (const auto& [key, entry] : qpus.items()) {
+        if (entry.value("family", "") == family && !entry.value("draining", false))
+            candidates.emplace_back(key, entry);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.second.value("ready_at", 0.0) > b.second.value("ready_at", 0.0);
+    });
+    if (candidates.size() < static_cast<std::size_t>(n_qpus))
+        std::cerr << "\033[1;33m" << "Warning: " << "\033[0m" << "The family " << family << " has "
+                  << candidates.size() << " QPUs taking tasks, all of them are drained.\n";
+    candidates.resize(std::min(candidates.size(), static_cast<std::size_t>(n_qpus)));
+
+    std::vector<DrainingQPU> draining;
+    for (const auto& [id, entry] : candidates) {
+        const auto& net = entry.at("net");
+        if (!reachable(net)) {
+            std::cerr << "\033[1;33m" << "Warning: " << "\033[0m" << "QPU " << id << " is not reachable from this node, it is not drained.\n";
+            continue;
+        }
+        DrainingQPU qpu{id, entry.value("slurm_job_id", ""), std::make_unique<cunqa::comm::Client>()};
+        qpu.client->connect(net.at("endpoint").get<std::string>());
+        if (!pending_tasks(qpu.client->send_drain())) {
+            std::cerr << "\033[1;33m" << "Warning: " << "\033[0m" << "QPU " << id << " does not answer, it is not drained.\n";
+            continue;
+        }
+        draining.push_back(std::move(qpu));
+    }
+    if (draining.empty())
+        return EXIT_FAILURE;
+
+    std::size_t left = draining.size();
+    std::cout << "Draining " << left << " QPU(s) of the family " << family << ".\n";
+    while (left > 0) {
+        for (auto& qpu : draining) {
+            if (qpu.drained)
+                continue;
+            const auto pending = pending_tasks(qpu.client->send_status());
+            if (pending && *pending == 0) {
+                qpu.drained = true;
+                left--;
+                std::cout << "QPU " << qpu.id << " drained.\n";
+            }
         }
+        if (left > 0)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    for (auto& qpu : draining)
+        qpu.client->disconnect();
+
+    std::vector<std::string> jobs;
+    const auto registered = read_qpus_json();
+    for (const auto& qpu : draining) {
+        if (std::find(jobs.begin(), jobs.end(), qpu.job_id) != jobs.end())
+            continue;
+        const bool all_drained = std::ranges::all_of(registered.items(), [&](const auto& item) {
+            return item.value().value("slurm_job_id", "") != qpu.job_id || item.value().value("draining", false);
+        });
+        if (all_drained)
+            jobs.push_back(qpu.job_id);
+        else
+            std::cout << "The drained QPUs of the job " << qpu.job_id << " stay idle until it ends, as others of it still take tasks.\n";
     }
+    if (!jobs.empty())
+        removeJobs(jobs);
+    return EXIT_SUCCESS;
 }
 
 // Function more general than needed to support future extension
@@ -132,14 +271,23 @@ int main(int argc, char* argv[])
 {
     auto args = argparse::parse<CunqaArgs>(argc, argv);
 
-    if (args.all) {
+    if (args.shrink.has_value()) {
+        if (!args.family.has_value() || args.family->size() != 1 || args.ids.has_value() || args.all || *args.shrink < 1) {
+            std::cerr << "\033[1;31m" << "Error: " << "\033[0m" 
+                      << "--shrink takes the positive number of QPUs to drain of a single family, given with --fam.\n";
+            return -1;
+        }
+        return shrink_family(read_qpus_json(), args.family->front(), *args.shrink);
+    } else if (args.all) {
         auto ids = get_qpus_ids(read_qpus_json());
 
-        if (size(ids))
+        if (size(ids)) {
+            drain_jobs(ids, args.timeout);
             removeJobs(ids, true);
             if (args.remove_logs) deleteLogFiles(ids);
-        else 
+        } else {
             return EXIT_FAILURE;
+        }
     } else if (args.ids.has_value() && !args.family.has_value()) {
         auto ids = get_qpus_ids(read_qpus_json());
 
@@ -147,10 +295,11 @@ int main(int argc, char* argv[])
         auto ids_rng = ids | std::views::filter([&](const std::string& id){ return keep.count(id); });
         auto filtered_ids = std::vector<std::string>(ids_rng.begin(), ids_rng.end());
 
-        if (size(filtered_ids)) 
+        if (size(filtered_ids)) {
+            drain_jobs(filtered_ids, args.timeout);
             removeJobs(filtered_ids);
             if (args.remove_logs) deleteLogFiles(filtered_ids);
-        else {
+        } else {
             std::cerr << "\033[1;33m" << "Warning: " << "\033[0m" 
                       << "No qraise jobs are currently running with the specified id.\n";
             return EXIT_FAILURE;
@@ -159,6 +308,7 @@ int main(int argc, char* argv[])
         auto ids = find_family_id(read_qpus_json(), args.family.value());
 
         if (size(ids)) {
+            drain_jobs(ids, args.timeout);
             removeJobs(ids);
             if (args.remove_logs) { deleteLogFiles(ids); }
         } else {
@@ -4,10 +4,16 @@
 #include <vector>
 #include <optional>
 #include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <chrono>
 #include <map>
 
 #include "utils/json.hpp"
 #include "utils/constants.hpp"
+#include "utils/registry.hpp"
+#include "comm/client.hpp"
 #include "argparse/argparse.hpp"
 #include "logger.hpp"
 
@@ -17,33 +23,160 @@ struct CunqaArgs : public argparse::Args
 {
     std::optional<std::string>& node     = arg("node", "Info about the QPUs on the selected node.");
     bool& my_node                        = flag("mynode", "Info about the QPUs on the current node.");
+    bool& stats                          = flag("stats", "Live load of each QPU: queue, running tasks, shots per second, memory and uptime.");
+    std::optional<double>& watch         = kwarg("watch", "Refresh the --stats table every given seconds.", /*implicit*/"2");
 
     void welcome() {
         std::cout << "Command to get information about the deployed QPUs." << "\n";
     }
 };
 
+namespace {
+
+using namespace cunqa;
+using Clock = std::chrono::steady_clock;
+
+// A QPU as the stats table shows it, with its client open along the refreshes
+struct QPUStats {
+    std::string id;
+    std::string node;
+    std::string endpoint;
+    std::unique_ptr<comm::Client> client;
+    std::optional<JSON> status;
+    std::uint64_t last_shots = 0;
+    Clock::time_point last_time;
+    double shots_per_second = 0;
+};
+
+std::string gigabytes(const std::uint64_t bytes)
+{
+    char text[16];
+    std::snprintf(text, sizeof(text), "%.1f", bytes / 1e9);
+    return text;
+}
+
+std::string duration(const double seconds)
+{
+    const auto total = static_cast<long>(seconds);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%ldd %02ld:%02ld:%02ld", total / 86400, total / 3600 % 24, total / 60 % 60, total % 60);
+    return text;
+}
+
+// Asks every QPU for its status, at most a second each, and takes the shots per second since
+// the last refresh, or since the QPU started on the first one
+void refresh(std::vector<QPUStats>& qpus)
+{
+    std::vector<std::optional<comm::FutureWrapper<comm::Client>>> futures(qpus.size());
+    for (std::size_t i = 0; i < qpus.size(); i++) {
+        if (qpus[i].client)
+            futures[i] = qpus[i].client->send_status();
+    }
+
+    const auto deadline = Clock::now() + std::chrono::seconds(1);
+    for (std::size_t i = 0; i < qpus.size(); i++) {
+        auto& qpu = qpus[i];
+        if (!futures[i])
+            continue;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        if (!futures[i]->wait_for(std::max(left, std::chrono::milliseconds(0)))) {
+            qpu.status.reset();
+            continue;
+        }
+
+        const auto now = Clock::now();
+        JSON status = JSON::parse(futures[i]->get());
+        const std::uint64_t shots = status.value("shots", std::uint64_t{0});
+        if (qpu.status && shots >= qpu.last_shots)
+            qpu.shots_per_second = (shots - qpu.last_shots) / std::chrono::duration<double>(now - qpu.last_time).count();
+        else
+            qpu.shots_per_second = status.value("uptime", 0.0) > 0 ? shots / status.value("uptime", 0.0) : 0.0;
+        qpu.last_shots = shots;
+        qpu.last_time = now;
+        qpu.status = std::move(status);
+    }
+}
+
+void print_stats(const std::vector<QPUStats>& qpus)
+{
+    std::printf("%-24s %-12s %7s %7s %10s %10s %19s %14s\n", "ID", "Node", "Queued", "Running",
+                "Shots/s", "ETA (s)", "Memory (GB)", "Uptime");
+    for (const auto& qpu : qpus) {
+        if (!qpu.status) {
+            std::printf("%-24s %-12s \033[33m%s\033[0m\n", qpu.id.c_str(), qpu.node.c_str(),
+                        qpu.client ? "not answering" : "not reachable from this node");
+            continue;
+        }
+        const JSON& status = *qpu.status;
+        const std::uint64_t limit = status.value("memory_limit_bytes", std::uint64_t{0});
+        const std::string memory = gigabytes(status.value("resident_bytes", std::uint64_t{0})) + " / " +
+                                   (limit > 0 ? gigabytes(limit) : "-") + " (" +
+                                   gigabytes(status.value("peak_resident_bytes", std::uint64_t{0})) + ")";
+        const std::size_t depth = status.value("depth", std::size_t{0});
+        // Hot spots in red: tasks waiting on every worker
+        const bool hot = depth > 0 && depth >= status.value("n_workers", std::size_t{1});
+        std::printf("%s%-24s %-12s %7zu %7zu %10.1f %10.1f %19s %14s%s\n", hot ? "\033[31m" : "",
+                    qpu.id.c_str(), qpu.node.c_str(), depth, status.value("running", std::size_t{0}),
+                    qpu.shots_per_second, status.value("eta", 0.0), memory.c_str(),
+                    duration(status.value("uptime", 0.0)).c_str(), hot ? "\033[0m" : "");
+    }
+}
+
+int show_stats(const JSON& qpus_json, const CunqaArgs& args)
+{
+    // QPUs in hpc mode only listen on their own node
+    const char* nodename = std::getenv("SLURMD_NODENAME");
+    std::vector<QPUStats> qpus;
+    for (const auto& [key, inner] : qpus_json.items()) {
+        const auto& net = inner.at("net");
+        QPUStats qpu;
+        qpu.id = key;
+        qpu.node = net.value("nodename", "");
+        if (args.node && qpu.node != *args.node)
+            continue;
+        if (net.value("mode", "") != "hpc" || qpu.node == (nodename ? nodename : "login")) {
+            qpu.endpoint = net.at("endpoint").get<std::string>();
+            qpu.client = std::make_unique<comm::Client>();
+            qpu.client->connect(qpu.endpoint);
+        }
+        qpus.push_back(std::move(qpu));
+    }
+
+    do {
+        refresh(qpus);
+        if (args.watch)
+            std::cout << "\033[H\033[2J";
+        print_stats(qpus);
+        std::cout << std::flush;
+        if (args.watch)
+            std::this_thread::sleep_for(std::chrono::duration<double>(std::max(0.1, *args.watch)));
+    } while (args.watch);
+
+    for (auto& qpu : qpus) {
+        if (qpu.client)
+            qpu.client->disconnect();
+    }
+    return 0;
+}
+
+} // End of anonymous namespace
+
 int main(int argc, char* argv[]) {
 
     const std::string indent = "    ";
 
     auto args = argparse::parse<CunqaArgs>(argc, argv);
 
-    std::ifstream file(cunqa::constants::QPUS_FILEPATH);
-    if (!file.is_open()) {
-        std::cerr << "\033[31mCould not open the QPUs info file! Check if there are deployed QPUs. \033[0m " << "\n";
-        return 1;
-    }
-
-    cunqa::JSON qpus_json;
-    file >> qpus_json;
-    file.close();
+    cunqa::JSON qpus_json = cunqa::open_registry(cunqa::constants::QPUS_REGISTRY)->read();
 
     if (qpus_json.empty()) {
         std::cerr << "\033[31mThere are not deployed QPUs!\033[0m" << "\n";
         return 1;
     }
 
+    if (args.stats || args.watch)
+        return show_stats(qpus_json, args);
+
     std::map<std::string, std::map<std::string, int>> family_counts_per_node;
     std::map<std::string, std::vector<std::string>> id_per_node;
     
@@ -66,6 +199,8 @@ int main(int argc, char* argv[]) {
             std::cout << indent << "family: " << qpus_json[id]["family"] << "\n";
             std::cout << indent << "Simulator: " << qpus_json[id]["backend"]["simulator"] << "\n";
             std::cout << indent << "Mode: " << qpus_json[id]["net"]["mode"] << "\n";
+            if (qpus_json[id].value("draining", false))
+                std::cout << indent << "Draining: it takes no more tasks" << "\n";
             
         }
     } else if (args.my_node) {
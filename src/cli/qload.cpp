@@ -0,0 +1,377 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "argparse/argparse.hpp"
+#include "comm/client.hpp"
+#include "utils/constants.hpp"
+#include "utils/json.hpp"
+#include "utils/registry.hpp"
+#include "utils/helpers/result_fields.hpp"
+#include "logger.hpp"
+
+using namespace std::literals;
+using Clock = std::chrono::steady_clock;
+
+struct CunqaArgs : public argparse::Args
+{
+    std::string& family_name          = kwarg("fam,family_name", "Family of the QPUs to load, all of them if empty.").set_default("");
+    int& clients                      = kwarg("clients", "Number of clients, spread over the QPUs; one per QPU if 0.").set_default(0);
+    int& concurrency                  = kwarg("c,concurrency", "Requests in flight at most per client.").set_default(1);
+    double& rate                      = kwarg("r,rate", "Requests per second sent by all the clients together, as fast as the concurrency allows if 0.").set_default(0);
+    double& duration                  = kwarg("d,duration", "Seconds sending requests.").set_default(10);
+    int& requests                     = kwarg("n,requests", "Requests sent at most, no limit if 0.").set_default(0);
+    int& qubits                       = kwarg("q,qubits", "Qubits of the circuits.").set_default(4);
+    int& depth                        = kwarg("depth", "Layers of gates of the circuits.").set_default(4);
+    int& shots                        = kwarg("s,shots", "Shots of each request.").set_default(100);
+    int& param_updates                = kwarg("param-updates", "Parameter updates sent after each circuit.").set_default(0);
+    std::optional<std::string>& mix   = kwarg("mix", "JSON file with a list of {\"weight\", \"qubits\", \"depth\", \"shots\", \"param_updates\"} to draw the circuits from.");
+    double& timeout                   = kwarg("timeout", "Seconds after which a request without result counts as lost.").set_default(60);
+    std::optional<std::string>& output = kwarg("o,output", "File where the report is written as JSON.");
+
+    void welcome() {
+        std::cout << "Command to measure the throughput and latencies of the deployed QPUs under load." << "\n";
+    }
+};
+
+namespace {
+
+using namespace cunqa;
+
+struct Workload {
+    double weight = 1;
+    int qubits;
+    int depth;
+    int shots;
+    int param_updates;
+};
+
+// The circuits load the tag of the request in X gates and then apply layers of gates that undo
+// themselves, so every shot measures the tag. A result with other counts was lost on the way
+// and another one took its place
+constexpr int MAX_TAG_BITS = 16;
+
+std::string circuit(const Workload& workload, const std::uint64_t tag, const std::vector<double>& angles)
+{
+    const int n = workload.qubits;
+    std::vector<JSON> instructions;
+    for (int qubit = 0; qubit < std::min(n, MAX_TAG_BITS); qubit++) {
+        if ((tag >> qubit) & 1)
+            instructions.push_back({{"name", "x"}, {"qubits", {qubit}}});
+    }
+    for (int layer = 0; layer < workload.depth; layer++) {
+        for (int qubit = 0; qubit < n; qubit++) {
+            const double angle = angles[layer * n + qubit];
+            instructions.push_back({{"name", "rx"}, {"qubits", {qubit}}, {"params", {angle}}});
+            instructions.push_back({{"name", "rx"}, {"qubits", {qubit}}, {"params", {-angle}}});
+        }
+        for (int qubit = layer % 2; qubit + 1 < n; qubit += 2) {
+            instructions.push_back({{"name", "cx"}, {"qubits", {qubit, qubit + 1}}});
+            instructions.push_back({{"name", "cx"}, {"qubits", {qubit, qubit + 1}}});
+        }
+    }
+    for (int qubit = 0; qubit < n; qubit++)
+        instructions.push_back({{"name", "measure"}, {"qubits", {qubit}}, {"clbits", {qubit}}});
+
+    JSON task = {
+        {"id", "qload_" + std::to_string(tag)},
+        {"instructions", instructions},
+        {"config", {
+            {"shots", workload.shots},
+            {"method", "automatic"},
+            {"avoid_parallelization", false},
+            {"num_qubits", n},
+            {"num_clbits", n},
+            {"device", {{"device_name", "CPU"}, {"target_devices", std::vector<int>()}}}
+        }},
+        {"sending_to", std::vector<std::string>()},
+        {"is_dynamic", false}
+    };
+    return task.dump();
+}
+
+std::string parameters(const Workload& workload, const std::vector<double>& angles)
+{
+    std::vector<double> params;
+    for (const double angle : angles) {
+        params.push_back(angle);
+        params.push_back(-angle);
+    }
+    return JSON({{"params", params}, {"shots", workload.shots}}).dump();
+}
+
+std::uint64_t outcome(const std::string& bitstring)
+{
+    if (bitstring.starts_with("0x"))
+        return std::stoull(bitstring.substr(2), nullptr, 16);
+    std::uint64_t value = 0;
+    for (const char bit : bitstring) {
+        if (bit == '0' || bit == '1')
+            value = (value << 1) | (bit == '1');
+    }
+    return value;
+}
+
+enum class Outcome { OK, ERROR, BUSY, MISMATCHED };
+
+Outcome check(const std::string& result, const std::uint64_t tag)
+{
+    try {
+        auto result_json = JSON::parse(result);
+        if (result_json.contains("ERROR"))
+            return result_json.value("busy", false) ? Outcome::BUSY : Outcome::ERROR;
+        for (const auto& [bitstring, count] : counts_of(result_json).items()) {
+            if (outcome(bitstring) != tag)
+                return Outcome::MISMATCHED;
+        }
+        return Outcome::OK;
+    } catch (const std::exception&) {
+        return Outcome::ERROR;
+    }
+}
+
+struct Stats {
+    std::uint64_t sent = 0;
+    std::uint64_t ok = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t busy = 0;
+    std::uint64_t mismatched = 0;
+    std::uint64_t lost = 0;
+    std::uint64_t shots = 0;
+    std::vector<double> circuit_latencies;
+    std::vector<double> parameter_latencies;
+
+    void merge(const Stats& other)
+    {
+        sent += other.sent; ok += other.ok; errors += other.errors; busy += other.busy;
+        mismatched += other.mismatched; lost += other.lost; shots += other.shots;
+        circuit_latencies.insert(circuit_latencies.end(), other.circuit_latencies.begin(), other.circuit_latencies.end());
+        parameter_latencies.insert(parameter_latencies.end(), other.parameter_latencies.begin(), other.parameter_latencies.end());
+    }
+};
+
+struct Pending {
+    comm::FutureWrapper<comm::Client> future;
+    Clock::time_point sent;
+    std::uint64_t tag;
+    int shots;
+    bool parameters;
+};
+
+struct LoadPlan {
+    std::vector<Workload> workloads;
+    int concurrency;
+    double client_rate; // Requests per second of each client, 0 for closed loop
+    Clock::time_point stop_sending;
+    int max_requests;
+    double timeout;
+};
+
+// Each client sends its requests and collects their results from a single thread, as the
+// futures of a client are not meant to be shared between threads
+void run_client(const std::string& endpoint, const LoadPlan& plan, std::atomic<std::uint64_t>& next_tag,
+                std::atomic<int>& requests_left, const unsigned seed, Stats& stats)
+{
+    comm::Client client;
+    client.connect(endpoint);
+
+    std::mt19937 rng(seed);
+    std::vector<double> weights;
+    for (const auto& workload : plan.workloads)
+        weights.push_back(workload.weight);
+    std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+    std::uniform_real_distribution<double> angle(0, 6.283185307179586);
+
+    std::vector<Pending> pending;
+    const Workload* workload = nullptr;
+    int updates_left = 0;
+    std::uint64_t tag = 0;
+    auto next_send = Clock::now();
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(plan.client_rate > 0 ? 1.0 / plan.client_rate : 0.0));
+
+    while (true) {
+        bool idle = true;
+        const auto now = Clock::now();
+        const bool sending = now < plan.stop_sending;
+        if (sending && static_cast<int>(pending.size()) < plan.concurrency && now >= next_send) {
+            if (plan.max_requests == 0 || requests_left.fetch_sub(1) > 0) {
+                // Parameter updates go to the last circuit of the client, so they keep its tag
+                const bool update = workload != nullptr && updates_left > 0;
+                if (!update) {
+                    workload = &plan.workloads[pick(rng)];
+                    updates_left = workload->param_updates;
+                    tag = next_tag++ % (std::uint64_t{1} << std::min(workload->qubits, MAX_TAG_BITS));
+                } else {
+                    updates_left--;
+                }
+                std::vector<double> angles(workload->depth * workload->qubits);
+                for (auto& value : angles)
+                    value = angle(rng);
+
+                auto sent = Clock::now();
+                auto future = update ? client.send_parameters(parameters(*workload, angles))
+                                     : client.send_circuit(circuit(*workload, tag, angles));
+                pending.push_back({std::move(future), sent, tag, workload->shots, update});
+                stats.sent++;
+                if (interval.count() > 0)
+                    next_send = std::max(next_send + interval, now - 10 * interval); // Catches up a short lag only
+                idle = false;
+            }
+        }
+
+        for (auto it = pending.begin(); it != pending.end();) {
+            if (it->future.ready()) {
+                const double latency = std::chrono::duration<double>(Clock::now() - it->sent).count();
+                switch (check(it->future.get(), it->tag)) {
+                    case Outcome::OK:
+                        stats.ok++;
+                        stats.shots += it->shots;
+                        (it->parameters ? stats.parameter_latencies : stats.circuit_latencies).push_back(latency);
+                        break;
+                    case Outcome::ERROR: stats.errors++; break;
+                    case Outcome::BUSY: stats.busy++; break;
+                    case Outcome::MISMATCHED: stats.mismatched++; break;
+                }
+                it = pending.erase(it);
+                idle = false;
+            } else if (std::chrono::duration<double>(Clock::now() - it->sent).count() > plan.timeout) {
+                it->future.cancel();
+                stats.lost++;
+                it = pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        const bool exhausted = plan.max_requests > 0 && requests_left.load() <= 0;
+        if ((!sending || exhausted) && pending.empty())
+            break;
+        if (idle)
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    client.disconnect();
+}
+
+JSON percentiles(std::vector<double> latencies)
+{
+    if (latencies.empty())
+        return JSON::object();
+    std::sort(latencies.begin(), latencies.end());
+    auto at = [&](const double q) { return latencies[static_cast<std::size_t>(q * (latencies.size() - 1))]; };
+    return {{"p50", at(0.5)}, {"p90", at(0.9)}, {"p99", at(0.99)}, {"max", latencies.back()}};
+}
+
+std::vector<Workload> read_workloads(const CunqaArgs& args)
+{
+    if (!args.mix)
+        return {{1, args.qubits, args.depth, args.shots, args.param_updates}};
+
+    std::ifstream file(*args.mix);
+    std::vector<Workload> workloads;
+    for (const auto& entry : JSON::parse(file)) {
+        workloads.push_back({
+            entry.value("weight", 1.0),
+            entry.value("qubits", args.qubits),
+            entry.value("depth", args.depth),
+            entry.value("shots", args.shots),
+            entry.value("param_updates", args.param_updates)
+        });
+    }
+    if (workloads.empty())
+        throw std::runtime_error("The mix has no circuits.");
+    return workloads;
+}
+
+} // End of anonymous namespace
+
+int main(int argc, char* argv[])
+{
+    auto args = argparse::parse<CunqaArgs>(argc, argv);
+
+    // QPUs in hpc mode only listen on their own node
+    const char* nodename = std::getenv("SLURMD_NODENAME");
+    std::vector<std::string> endpoints;
+    for (const auto& [key, qpu] : cunqa::open_registry(cunqa::constants::QPUS_REGISTRY)->read().items()) {
+        if (!args.family_name.empty() && qpu.value("family", "") != args.family_name)
+            continue;
+        const auto& net = qpu.at("net");
+        if (net.value("mode", "") == "hpc" && net.value("nodename", "") != (nodename ? nodename : "login"))
+            continue;
+        // Through the Unix domain socket of the QPUs of this node
+        const std::string local_endpoint = net.value("local_endpoint", "");
+        const bool same_node = !local_endpoint.empty() && nodename && net.value("nodename", "") == nodename;
+        endpoints.push_back(same_node ? local_endpoint : net.at("endpoint").get<std::string>());
+    }
+    if (endpoints.empty()) {
+        std::cerr << "\033[31mNo deployed QPUs to load" << (args.family_name.empty() ? "" : " in family " + args.family_name) << ".\033[0m\n";
+        return 1;
+    }
+
+    const int n_clients = args.clients > 0 ? args.clients : endpoints.size();
+    LoadPlan plan{
+        read_workloads(args),
+        std::max(1, args.concurrency),
+        args.rate / n_clients,
+        Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(args.duration)),
+        args.requests,
+        args.timeout
+    };
+
+    std::atomic<std::uint64_t> next_tag{1};
+    std::atomic<int> requests_left{args.requests};
+    std::vector<Stats> client_stats(n_clients);
+    std::vector<std::thread> clients;
+    const auto start = Clock::now();
+    for (int i = 0; i < n_clients; i++) {
+        clients.emplace_back([&, i]() {
+            try {
+                run_client(endpoints[i % endpoints.size()], plan, next_tag, requests_left, i + 1, client_stats[i]);
+            } catch (const std::exception& e) {
+                LOGGER_ERROR("Client {} stopped: {}", i, e.what());
+            }
+        });
+    }
+    for (auto& client : clients)
+        client.join();
+    const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Stats stats;
+    for (const auto& client : client_stats)
+        stats.merge(client);
+    std::vector<double> latencies = stats.circuit_latencies;
+    latencies.insert(latencies.end(), stats.parameter_latencies.begin(), stats.parameter_latencies.end());
+
+    JSON report = {
+        {"qpus", endpoints.size()},
+        {"clients", n_clients},
+        {"seconds", elapsed},
+        {"sent", stats.sent},
+        {"completed", stats.ok},
+        {"errors", stats.errors},
+        {"busy", stats.busy},
+        {"mismatched", stats.mismatched},
+        {"lost", stats.lost},
+        {"throughput", stats.ok / elapsed},
+        {"shots_per_second", stats.shots / elapsed},
+        {"latency", percentiles(latencies)},
+        {"circuit_latency", percentiles(stats.circuit_latencies)},
+        {"parameters_latency", percentiles(stats.parameter_latencies)}
+    };
+
+    std::cout << report.dump(4) << "\n";
+    if (args.output) {
+        std::ofstream file(*args.output);
+        file << report.dump(4) << "\n";
+    }
+    return stats.mismatched == 0 && stats.lost == 0 ? 0 : 2;
+}
@@ -2,6 +2,8 @@
 #include <fstream>
 #include <regex>
 #include <any>
+#include <vector>
+#include <algorithm>
 #include <filesystem> //debug
 
 #include <iostream>
@@ -13,10 +15,12 @@
 #include "qraise/args_qraise.hpp"
 #include "qraise/noise_model_conf_qraise.hpp"
 #include "qraise/simple_conf_qraise.hpp"
+#include "qraise/distributed_conf_qraise.hpp"
 #include "qraise/cc_conf_qraise.hpp"
 #include "qraise/qc_conf_qraise.hpp"
 #include "qraise/qmio_conf_qraise.hpp"
 #include "qraise/infrastructure_conf_qraise.hpp"
+#include "qraise/standby_conf_qraise.hpp"
 
 #include "logger.hpp"
 
@@ -29,11 +33,102 @@ int main(int argc, char* argv[])
 {
     auto args = argparse::parse<CunqaArgs>(argc, argv, true); //true ensures an error is raised if we feed qraise an unrecognized flag
 
+    // The job gets the environment of sbatch, and the logger of each QPU reads it when it starts
+    if (args.log_level.has_value()) {
+        const std::vector<std::string> levels = {"trace", "debug", "info", "warn", "error", "critical", "off"};
+        if (std::find(levels.begin(), levels.end(), *args.log_level) == levels.end()) {
+            LOGGER_ERROR("Unknown log level {}, it must be one of trace, debug, info, warn, error, critical or off.", *args.log_level);
+            return 1;
+        }
+        setenv("CUNQA_LOG_LEVEL", args.log_level->c_str(), 1);
+    }
+    if (!valid_gpus_per_qpu(args))
+        return 1;
+    if (args.gpus_per_qpu > 1)
+        setenv("CUNQA_GPUS_PER_QPU", std::to_string(args.gpus_per_qpu).c_str(), 1);
+    if (!valid_gpu_sharing(args))
+        return 1;
+    // The QPUs of a GPU find theirs from their rank, and refuse the tasks larger than their part of
+    // it. With MPS, the driver also holds each one to that memory and to its part of the SMs
+    if (args.gpu_sharing.has_value()) {
+        const std::string memory = std::to_string(gpu_memory_per_qpu_mb(args));
+        setenv("CUNQA_QPUS_PER_GPU", std::to_string(qpus_per_gpu(args)).c_str(), 1);
+        setenv("CUNQA_GPU_MEMORY", memory.c_str(), 1);
+        if (*args.gpu_sharing == "mps") {
+            std::string pinned;
+            for (int gpu = 0; gpu < n_gpus(args); gpu++)
+                pinned += (gpu > 0 ? "," : "") + std::to_string(gpu) + "=" + memory + "M";
+            setenv("CUDA_MPS_PINNED_DEVICE_MEM_LIMIT", pinned.c_str(), 1);
+            setenv("CUDA_MPS_ACTIVE_THREAD_PERCENTAGE", std::to_string(std::max(1, 100 / qpus_per_gpu(args))).c_str(), 1);
+        }
+    }
+    if (!valid_precision(args))
+        return 1;
+    if (args.precision.has_value())
+        setenv("CUNQA_PRECISION", args.precision->c_str(), 1);
+    if (args.trace)
+        setenv("CUNQA_TRACE", "1", 1);
+    if (args.prewarm)
+        setenv("CUNQA_PREWARM", "1", 1);
+    if (args.result_cache > 0)
+        setenv("CUNQA_RESULT_CACHE", std::to_string(args.result_cache).c_str(), 1);
+    if (args.result_cache_ttl > 0)
+        setenv("CUNQA_RESULT_CACHE_TTL", std::to_string(args.result_cache_ttl).c_str(), 1);
+    if (args.retained_states > 0)
+        setenv("CUNQA_RETAINED_STATES", std::to_string(args.retained_states).c_str(), 1);
+    if (args.retained_states_ttl > 0)
+        setenv("CUNQA_RETAINED_STATES_TTL", std::to_string(args.retained_states_ttl).c_str(), 1);
+    if (args.checkpoint_dir.has_value())
+        setenv("CUNQA_CHECKPOINT_DIR", args.checkpoint_dir->c_str(), 1);
+    if (args.circuit_store.has_value())
+        setenv("CUNQA_CIRCUIT_STORE", args.circuit_store->c_str(), 1);
+    if (args.circuit_store_cache > 0)
+        setenv("CUNQA_CIRCUIT_STORE_CACHE", std::to_string(args.circuit_store_cache).c_str(), 1);
+    if (args.huge_pages.has_value()) {
+        if (*args.huge_pages != "thp" && *args.huge_pages != "2M" && *args.huge_pages != "1G") {
+            LOGGER_ERROR("Unknown huge pages {}, they must be thp, 2M or 1G.", *args.huge_pages);
+            return 1;
+        }
+        setenv("CUNQA_HUGE_PAGES", args.huge_pages->c_str(), 1);
+    }
+    if (!valid_io_cores(args) || !valid_grow(args))
+        return 1;
+    if (args.io_cores > 0)
+        setenv("CUNQA_IO_CORES", std::to_string(args.io_cores).c_str(), 1);
+    if (args.zmq_io_threads > 0)
+        setenv("CUNQA_ZMQ_IO_THREADS", std::to_string(args.zmq_io_threads).c_str(), 1);
+    if (args.zmq_hwm > 0)
+        setenv("CUNQA_ZMQ_HWM", std::to_string(args.zmq_hwm).c_str(), 1);
+    if (args.zmq_tcp_buffer > 0)
+        setenv("CUNQA_ZMQ_TCP_BUFFER", std::to_string(1024 * args.zmq_tcp_buffer).c_str(), 1);
+    // Unless the user pinned the threads otherwise. The places of OpenMP would span the reserved
+    // cores too, so with them the threads stay within the CPUs of the thread that starts them
+    if (args.numa && args.io_cores == 0) {
+        setenv("OMP_PLACES", "cores", 0);
+        setenv("OMP_PROC_BIND", "close", 0);
+    }
+
+    // Taken at once from the standby pool, if it has enough of them. The job of the first one is
+    // printed as sbatch would, marked so that the clients do not wait for it to start
+    if (adopts_standby(args)) {
+        if (const auto job_id = adopt_standby(args)) {
+            std::cout << *job_id << ";standby" << std::endl;
+            return 0;
+        }
+    }
+
     pid_t pid = getpid();
     std::string tmp_filepath = "qraise_sbatch_tmp_" + std::to_string(pid) + ".sbatch"; 
+    // The script of a standby pool is kept to replenish it
+    if (args.standby) {
+        tmp_filepath = standby_script(standby_pool(args));
+        fs::create_directories(fs::path(tmp_filepath).parent_path());
+    }
     std::ofstream sbatchFile(tmp_filepath);
     try {
-        if (args.infrastructure.has_value()) {
+        if (args.standby) {
+            write_standby_sbatch(sbatchFile, args);
+        } else if (args.infrastructure.has_value()) {
             write_infrastructure_sbatch(sbatchFile, args);
         } else if (args.qmio) {
             write_qmio_sbatch(sbatchFile, args);
@@ -43,6 +138,8 @@ int main(int argc, char* argv[])
             write_cc_sbatch(sbatchFile, args);
         } else if (args.qc) {
             write_qc_sbatch(sbatchFile, args);
+        } else if (args.distributed.has_value()) {
+            write_distributed_sbatch(sbatchFile, args);
         } else {
             write_simple_sbatch(sbatchFile, args);
         }
@@ -54,10 +151,13 @@ int main(int argc, char* argv[])
     }
     sbatchFile.close();
 
-    // Executing and deleting the file
+    // Executing and deleting the file. The standby QPUs are a job array of a QPU per task
     std::string sbatch_cmd = "sbatch --parsable " + tmp_filepath;
+    if (args.standby)
+        sbatch_cmd = "sbatch --parsable --array=0-" + std::to_string(args.n_qpus - 1) + " " + tmp_filepath;
     auto sbatch_result = std::system(sbatch_cmd.c_str());
-    remove_tmp_files(tmp_filepath);
+    if (!args.standby)
+        remove_tmp_files(tmp_filepath);
     
     
     return sbatch_result;
@@ -12,6 +12,14 @@ struct CunqaArgs : public argparse::Args
     int& n_qpus                                         = kwarg("n,num_qpus", "Number of QPUs to be raised.").set_default(0);
     std::string& time                                   = kwarg("t,time", "Time for the QPUs to be raised.").set_default("");
     int& cores_per_qpu                                  = kwarg("c,cores-per-qpu", "Number of cores per QPU.").set_default(2);
+    int& workers_per_qpu                                = kwarg("w,workers-per-qpu", "Number of circuits each QPU simulates at the same time (no communications only).").set_default(1);
+    int& qpus_per_process                               = kwarg("qpus-per-process", "Number of QPUs each Slurm task hosts, sharing the simulator libraries and the noise model (no communications only).").set_default(1);
+    int& io_cores                                       = kwarg("io-cores", "Cores of each Slurm task reserved for the threads that receive the tasks of its QPUs, whose simulations take the rest.").set_default(0);
+    int& zmq_io_threads                                 = kwarg("zmq-io-threads", "Threads of the ZMQ context of each QPU that move the tasks and results through its sockets, 0 for the default of one.").set_default(0);
+    int& zmq_hwm                                        = kwarg("zmq-hwm", "Messages each QPU queues per client in its ZMQ socket before holding the next, 0 for the default of ZMQ.").set_default(0);
+    int& zmq_tcp_buffer                                 = kwarg("zmq-tcp-buffer", "KB of the kernel send and receive buffers of the TCP connections of each QPU, 0 for those of the OS.").set_default(0);
+    int& queue_depth                                    = kwarg("queue-depth", "Number of tasks each QPU queues at most before answering that it is busy, 0 for no limit.").set_default(0);
+    int& queue_memory                                   = kwarg("queue-memory", "MB of tasks each QPU queues at most before answering that it is busy, 0 for no limit.").set_default(0);
     std::optional<std::string>& partition               = kwarg("p,partition", "Partition requested for the QPUs.");
     std::optional<int>& mem_per_qpu                     = kwarg("mem,mem-per-qpu", "Memory given to each QPU in GB.").set_default(15);
     std::optional<std::size_t>& number_of_nodes         = kwarg("N,n_nodes", "Number of nodes.").set_default(1);
@@ -20,6 +28,7 @@ struct CunqaArgs : public argparse::Args
     std::optional<std::string>& backend                 = kwarg("b,backend", "Path to the backend config file.");
     std::optional<std::string>& noise_properties        = kwarg("noise-prop,noise-properties", "Path to the noise properties json file, only supported for simulator Aer.");
     std::string& simulator                              = kwarg("sim,simulator", "Simulator reponsible of running the simulations.").set_default("Aer");
+    std::optional<std::string>& precision               = kwarg("precision", "Precision, single or double, of the amplitudes of the tasks that do not choose one. The default of the simulator if not given.");
 
     std::optional<std::string>& fakeqmio                = kwarg("fq,fakeqmio", "Raise FakeQmio backend from calibration file.", /*implicit*/"last_calibrations");
     bool& no_thermal_relaxation                         = flag("no-thermal-relaxation", "Deactivate thermal relaxation on a noisy backend.").set_default("false");
@@ -27,12 +36,34 @@ struct CunqaArgs : public argparse::Args
     bool& no_gate_error                                 = flag("no-gate-error", "Deactivate gate error on a noisy backend.").set_default("false");
 
     std::string& family_name                            = kwarg("fam,family_name", "Name that identifies which QPUs were raised together.").set_default("default");
+    bool& grow                                          = flag("grow", "Add the QPUs to the running family given with --fam, as a new Slurm job (no communications only).");
     bool& co_located                                    = flag("co-located", "co-located mode. The user can connect with any deployed QPU.");
+    bool& standby                                       = flag("standby", "Raise the QPUs as a standby pool of their simulator, device, mode, cores and memory, which the qraise of plain QPUs of the same kind adopt at once. The pool raises a QPU for each one adopted.");
+    bool& no_standby                                    = flag("no-standby", "Raise new QPUs even if there are standby QPUs to adopt.");
     bool& cc                                            = flag("classical_comm", "Enable classical communications.");
     bool& qc                                            = flag("quantum_comm", "Enable quantum communications.");
+    bool& cc_mpi                                        = flag("cc_mpi", "Send the classical communications between the QPUs of the job through MPI (needs CUNQA compiled with USE_MPI_BTW_QPU).");
     std::optional<std::string>& infrastructure          = kwarg("infrastructure", "Path to a infrastructure of QPUs.");
     bool& qmio                                          = flag("qmio", "Deploy QMIO.").set_default(false);
     bool& gpu                                           = flag("gpu", "Run on GPU").set_default(false);
+    int& gpus_per_qpu                                   = kwarg("gpus-per-qpu", "Number of GPUs over which each QPU splits its statevector, with --gpu.").set_default(1);
+    std::optional<std::string>& gpu_sharing             = kwarg("gpu-sharing", "How several QPUs share a GPU, with --gpu: mps for the QPUs of a GPU through CUDA MPS, mig for a MIG slice per QPU.");
+    int& qpus_per_gpu                                   = kwarg("qpus-per-gpu", "Number of QPUs that share each GPU, with --gpu-sharing mps. 0 to take as many as fit with --gpu-qubits.").set_default(0);
+    int& gpu_qubits                                     = kwarg("gpu-qubits", "Qubits of the largest circuits of the QPUs, from which qraise packs them onto the GPUs, with --gpu-sharing.").set_default(0);
+    std::optional<std::string>& mig_profile             = kwarg("mig-profile", "Profile of the MIG slices (as 1g.5gb), the type of their Slurm gres, with --gpu-sharing mig.");
+    std::optional<int>& distributed                     = kwarg("dist,distributed", "Number of Slurm tasks, a power of two, that share the statevector of a single QuEST QPU.");
+    std::optional<std::string>& log_level               = kwarg("log-level", "Level of the logs of the QPUs: trace, debug, info, warn, error, critical or off.");
+    int& result_cache                                   = kwarg("result-cache", "Results of deterministic tasks (seeded, or of exact expectation values) that each QPU keeps to answer them again without simulating them, 0 for none.").set_default(0);
+    int& result_cache_ttl                               = kwarg("result-cache-ttl", "Seconds during which a cached result is used, 0 for no limit.").set_default(0);
+    int& retained_states                                = kwarg("retained-states", "Memory (in GB) that each QPU takes for the final states of the circuits run with retain, 0 for none.").set_default(0);
+    int& retained_states_ttl                            = kwarg("retained-states-ttl", "Seconds after its last use at which a retained state is dropped, 0 for no limit.").set_default(0);
+    std::optional<std::string>& checkpoint_dir          = kwarg("checkpoint-dir", "Directory where the QPUs keep the checkpoints of the tasks run with checkpoint, $STORE/.cunqa/checkpoints by default. One on the node-local disk is only seen by the QPUs of that node.");
+    std::optional<std::string>& circuit_store           = kwarg("circuit-store", "Directory of the circuits that the tasks send by their hash, $STORE/.cunqa/circuits by default. One in /dev/shm keeps them in the memory of the node.");
+    int& circuit_store_cache                            = kwarg("circuit-store-cache", "Circuits of the circuit store that each QPU keeps decoded, 8 by default.").set_default(0);
+    bool& prewarm                                       = flag("prewarm", "Run a small circuit on the simulator of each QPU before it registers, to initialize it.");
+    bool& numa                                          = flag("numa", "Bind the cores of each QPU to a NUMA domain and its memory to that domain, with the OpenMP threads pinned to the cores.");
+    std::optional<std::string>& huge_pages              = kwarg("huge-pages", "Pages of the statevectors of the QPUs: thp for transparent huge pages, 2M or 1G for those of hugetlbfs.");
+    bool& trace                                         = flag("trace", "Write a trace of the spans of each QPU and executor to $STORE/.cunqa/traces.");
 
     void welcome() {
         std::cout << "Welcome to qraise command, a command responsible for turning on the required QPUs.\n" << std::endl;
@@ -55,16 +55,15 @@ bool write_cc_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
     LOGGER_ERROR("CUNQA was not compiled with GPU support.");
     return false;
 #else
-    std::vector<std::string> simulators_with_gpu_support = {"Aer"};
-    if (std::find(simulators_with_gpu_support.begin(), simulators_with_gpu_support.end(), std::string(args.simulator)) == simulators_with_gpu_support.end()) {
-        LOGGER_ERROR("At this moment, only Aer supports GPU simulation");
+    if (!supports_gpu(std::string(args.simulator))) {
+        LOGGER_ERROR("{} was not compiled for GPU, only Aer (AER_GPU) and QuEST (QUEST_GPU) run on GPU.", std::string(args.simulator));
         return false;
     }
 
     sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
 
 #if GPU_ARCH == 75
-    sbatchFile << "#SBATCH --gres=gpu:t4\n";
+    sbatchFile << gpu_gres(args, "t4");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     } else {
@@ -72,7 +71,7 @@ bool write_cc_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
     }
 #elif GPU_ARCH == 80
     sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
-    sbatchFile << "#SBATCH --gres=gpu:a100:" << std::to_string(args.n_qpus) << "\n";
+    sbatchFile << gpu_gres(args, "a100");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     }
@@ -113,6 +112,7 @@ bool write_cc_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args)
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_MEM_PER_NODE SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::INSTALL_PATH) << "/bin/epilog.sh\n";
+    write_gpu_sharing(sbatchFile, args);
 
     return true;
 }
@@ -135,11 +135,17 @@ bool write_cc_run_command(std::ofstream& sbatchFile,const CunqaArgs& args)
         LOGGER_DEBUG("Qraise with classical communications and default CunqaSimulator backend. \n");
     }
 
-#ifdef USE_MPI_BTW_QPU
-    run_command =  "srun --mpi=pmix --task-epilog=$EPILOG_PATH setup_qpus " +  subcommand;
-#elif defined(USE_ZMQ_BTW_QPU)
-    run_command =  "srun --task-epilog=$EPILOG_PATH setup_qpus " +  subcommand;
+    if (args.cc_mpi) {
+#ifndef USE_MPI_BTW_QPU
+        LOGGER_ERROR("CUNQA was not compiled with MPI classical communications (USE_MPI_BTW_QPU).");
+        return false;
 #endif
+        // The channels of the QPUs read it, and all the QPUs share the MPI world of this srun
+        run_command =  "export CUNQA_CC_MPI=1\n";
+        run_command += "srun --mpi=pmix " + numa_binding(args) + "--task-epilog=$EPILOG_PATH setup_qpus " +  subcommand;
+    } else {
+        run_command =  "srun " + numa_binding(args) + "--task-epilog=$EPILOG_PATH setup_qpus " +  subcommand;
+    }
 
     sbatchFile << run_command;
 
@@ -157,7 +163,7 @@ void write_cc_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
         LOGGER_ERROR("Simulator {} is not available for classical communications simulation. Aborting. ", std::string(args.simulator));
         throw std::runtime_error("Error.");
 
-    } else if (exists_family_name(args.family_name, constants::QPUS_FILEPATH)) {
+    } else if (exists_family_name(args.family_name, constants::QPUS_REGISTRY)) {
         LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
         throw std::runtime_error("Bad family name.");
 
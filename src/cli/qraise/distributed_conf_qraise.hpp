@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+
+#include "argparse/argparse.hpp"
+#include "utils/constants.hpp"
+#include "args_qraise.hpp"
+#include "utils_qraise.hpp"
+#include "logger.hpp"
+
+
+namespace {
+using namespace cunqa;
+
+
+bool write_distributed_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    int n_tasks = args.distributed.value();
+    sbatchFile << "#SBATCH --ntasks=" << std::to_string(n_tasks) << "\n";
+    sbatchFile << "#SBATCH -c " << std::to_string(args.cores_per_qpu) << "\n";
+    sbatchFile << "#SBATCH -N " << std::to_string(args.number_of_nodes.value()) << "\n";
+    if (args.gpu)
+        sbatchFile << "#SBATCH --gpus-per-task=1\n";
+
+    if(args.partition.has_value())
+        sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
+
+    if (args.node_list.has_value()) {
+        sbatchFile << "#SBATCH --nodelist=";
+        int comma = 0;
+        for (auto& node_name : args.node_list.value()) {
+            if (comma > 0 ) {
+                sbatchFile << ",";
+            }
+            sbatchFile << node_name;
+            comma++;
+        }
+        sbatchFile << "\n";
+    }
+
+    // The memory of the QPU is split among all the cores of its tasks
+    if (args.mem_per_qpu.has_value()) {
+        int n_cores = n_tasks * args.cores_per_qpu;
+        int mem_per_core = (args.mem_per_qpu.value()/n_cores != 0) ? args.mem_per_qpu.value()/n_cores : 1;
+        sbatchFile << "#SBATCH --mem-per-cpu=" << std::to_string(mem_per_core) << "G\n";
+    }
+
+    return true;
+}
+
+bool write_distributed_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    sbatchFile << "#!/bin/bash\n";
+    sbatchFile << "#SBATCH --job-name=qraise \n";
+
+    if (!write_distributed_resources(sbatchFile, args)) {
+        LOGGER_ERROR("write_distributed_resources failed");
+        return false;
+    }
+
+    sbatchFile << "#SBATCH --time=" << args.time << "\n";
+    sbatchFile << "#SBATCH --output=qraise_%j\n\n";
+    sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_MEM_PER_NODE SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
+    sbatchFile << "EPILOG_PATH=" << std::string(constants::INSTALL_PATH) << "/bin/epilog.sh\n";
+
+    return true;
+}
+
+// All the tasks run setup_qpus: rank 0 serves the QPU and the others follow it through MPI
+bool write_distributed_run_command(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    JSON qpu_args = {{"distributed", true}};
+    std::string mode = args.co_located ? "co_located" : "hpc";
+
+    if (args.backend.has_value())
+        qpu_args["backend_path"] = std::string(args.backend.value());
+    if (args.queue_depth > 0)
+        qpu_args["max_queued_tasks"] = args.queue_depth;
+    if (args.queue_memory > 0)
+        qpu_args["max_queued_mb"] = args.queue_memory;
+
+    std::string subcommand = mode + " no_comm " + args.family_name + " Quest \'" + qpu_args.dump() + "\'";
+    sbatchFile << "srun " + numa_binding(args) + "--task-epilog=$EPILOG_PATH setup_qpus " + subcommand + "\n";
+
+    return true;
+}
+
+void write_distributed_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    int n_tasks = args.distributed.value();
+    if (args.time == "") {
+        LOGGER_ERROR("qraise needs the maximum time the vQPU will be raised (-t hh:mm:ss).");
+        throw std::runtime_error("Bad arguments.");
+
+    } else if (args.n_qpus != 1) {
+        LOGGER_ERROR("A distributed deployment raises a single vQPU, {} were requested.", args.n_qpus);
+        throw std::runtime_error("Bad number of QPUs.");
+
+    } else if (n_tasks < 2 || (n_tasks & (n_tasks - 1)) != 0) {
+        LOGGER_ERROR("QuEST distributes its statevector over a power of two of tasks, {} were requested.", n_tasks);
+        throw std::runtime_error("Bad number of tasks.");
+
+    } else if (std::string(args.simulator) != "Quest") {
+        LOGGER_ERROR("Only QuEST supports distributed vQPUs, {} was requested.", std::string(args.simulator));
+        throw std::runtime_error("Error.");
+
+    } else if (args.workers_per_qpu > 1) {
+        LOGGER_ERROR("Distributed vQPUs run with a single worker.");
+        throw std::runtime_error("Bad arguments.");
+
+    } else if (args.gpu && !supports_gpu(std::string(args.simulator))) {
+        LOGGER_ERROR("QuEST was not compiled for GPU, distributed vQPUs on GPU need CUNQA built with QUEST_GPU.");
+        throw std::runtime_error("Bad arguments.");
+
+    } else if (exists_family_name(args.family_name, constants::QPUS_REGISTRY)) {
+        LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
+        throw std::runtime_error("Bad family name.");
+
+    } else if (!write_distributed_sbatch_header(sbatchFile, args) || !write_distributed_run_command(sbatchFile, args)) {
+        LOGGER_ERROR("Error writing distributed sbatch file.");
+        throw std::runtime_error("Error.");
+    }
+}
+
+} // End namespace
@@ -123,7 +123,18 @@ void write_infrastructure_sbatch(std::ofstream& sbatchFile, const CunqaArgs& arg
 
         sbatchFile << "sleep 1\n";
 
-        sbatchFile << "srun --exclusive -n 1 -c " + std::to_string(group_cores) + " --mem=" + std::to_string(group_memory) + "G " + setup_executor + " " + simulator + " " + qc_group[0];
+        // The first QPU of the group tells over how many tasks its executor spreads the statevector
+        int executor_tasks = classical_resources.at("qpus").at(qc_group[0]).value("executor_tasks", 1);
+        if (executor_tasks == 1) {
+            sbatchFile << "srun --exclusive -n 1 -c " + std::to_string(group_cores) + " --mem=" + std::to_string(group_memory) + "G " + setup_executor + " " + simulator + " " + std::to_string(qc_group.size());
+        } else if (simulator != "Quest" || executor_tasks < 1 || (executor_tasks & (executor_tasks - 1)) != 0) {
+            LOGGER_ERROR("The executor of {} spreads its statevector over a power of two of tasks with QuEST, {} tasks with {} were requested.", qc_group[0], executor_tasks, simulator);
+            throw std::runtime_error("Bad number of executor tasks.");
+        } else {
+            int cores_per_task = std::max(1, group_cores / executor_tasks);
+            int mem_per_cpu = std::max(1, group_memory / (executor_tasks * cores_per_task));
+            sbatchFile << "srun --exclusive -n " + std::to_string(executor_tasks) + " -c " + std::to_string(cores_per_task) + " --mem-per-cpu=" + std::to_string(mem_per_cpu) + "G " + setup_executor + " " + simulator + " " + std::to_string(qc_group.size()) + " distributed";
+        }
     }
     //------------------------------------------------------
 
@@ -148,7 +159,7 @@ void write_infrastructure_sbatch(std::ofstream& sbatchFile, const CunqaArgs& arg
         backend_path = qpus.at(cc_qpu).at("backend").get<std::string>();
         qpus_path = R"({"backend_from_infrastructure":{")" + cc_qpu + "\":\"" + backend_path + R"("}})";
 
-        sbatchFile << "srun -n 1 -c " + std::to_string(qpu_cores) + " --mem=" + std::to_string(qpu_memory) + "G --task-epilog=$EPILOG_PATH " + setup_qpus + " co_located cc " + cc_qpu + " " + simulator + " \'" + qpus_path + "\'";
+        sbatchFile << "srun -n 1 -c " + std::to_string(qpu_cores) + " --mem=" + std::to_string(qpu_memory) + "G " + numa_domain_binding(classical_resources.at("qpus").at(cc_qpu)) + "--task-epilog=$EPILOG_PATH " + setup_qpus + " co_located cc " + cc_qpu + " " + simulator + " \'" + qpus_path + "\'";
 
         written_qpus.push_back(cc_qpu);
         n_cc_qpus++;    
@@ -177,7 +188,7 @@ void write_infrastructure_sbatch(std::ofstream& sbatchFile, const CunqaArgs& arg
         backend_path = properties.at("backend").get<std::string>();
         qpus_path = R"({"backend_from_infrastructure":{")" + name + "\":\"" + backend_path +  R"("}})" ;
 
-        sbatchFile << "srun -n 1 -c " + std::to_string(qpu_cores) + " --mem=" + std::to_string(qpu_memory) + "G --task-epilog=$EPILOG_PATH " + setup_qpus + " co_located no_comm "  + name + " " + simulator + " \'" + qpus_path + "\'"; 
+        sbatchFile << "srun -n 1 -c " + std::to_string(qpu_cores) + " --mem=" + std::to_string(qpu_memory) + "G " + numa_domain_binding(classical_resources.at("qpus").at(name)) + "--task-epilog=$EPILOG_PATH " + setup_qpus + " co_located no_comm "  + name + " " + simulator + " \'" + qpus_path + "\'"; 
         
     }
     //--------------------------------------------------
@@ -7,6 +7,7 @@
 #include "utils/constants.hpp"
 #include "logger.hpp"
 #include "args_qraise.hpp"
+#include "utils_qraise.hpp"
 
 
 namespace {
@@ -15,15 +16,15 @@ using namespace cunqa;
 
 bool write_noise_model_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
 {
-    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
-    sbatchFile << "#SBATCH -c " << std::to_string(args.cores_per_qpu) << "\n";
+    sbatchFile << "#SBATCH --ntasks=" << std::to_string(n_qpu_processes(args)) << "\n";
+    sbatchFile << "#SBATCH -c " << std::to_string(args.cores_per_qpu * args.qpus_per_process) << "\n";
     sbatchFile << "#SBATCH -N " << std::to_string(args.number_of_nodes.value()) << "\n";
     
     if(args.partition.has_value())
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     
     if (args.qpus_per_node.has_value()) {
-        sbatchFile << "#SBATCH --ntasks-per-node=" << std::to_string(args.qpus_per_node.value()) << "\n";
+        sbatchFile << "#SBATCH --ntasks-per-node=" << std::to_string((args.qpus_per_node.value() + args.qpus_per_process - 1) / args.qpus_per_process) << "\n";
     }
     
     if (args.node_list.has_value()) {
@@ -54,23 +55,22 @@ bool write_noise_model_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs&
     return false;
 #else
 
-    std::vector<std::string> simulators_with_gpu_support = {"Aer"};
-    if (std::find(simulators_with_gpu_support.begin(), simulators_with_gpu_support.end(), std::string(args.simulator)) == simulators_with_gpu_support.end()) {
-        LOGGER_ERROR("At this moment, only Aer supports GPU simulation");
+    if (!supports_gpu(std::string(args.simulator))) {
+        LOGGER_ERROR("{} was not compiled for GPU, only Aer (AER_GPU) and QuEST (QUEST_GPU) run on GPU.", std::string(args.simulator));
         return false;
     }
 
     sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
 
 #if GPU_ARCH == 75
-    sbatchFile << "#SBATCH --gres=gpu:t4\n";
+    sbatchFile << gpu_gres(args, "t4");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     } else {
         sbatchFile << "#SBATCH -p viz\n";
     }
 #elif GPU_ARCH == 80
-    sbatchFile << "#SBATCH --gres=gpu:a100:" << std::to_string(args.n_qpus) << "\n";
+    sbatchFile << gpu_gres(args, "a100");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     }
@@ -111,6 +111,7 @@ bool write_noise_model_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs&
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_MEM_PER_NODE SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::INSTALL_PATH) << "/bin/epilog.sh\n";
+    write_gpu_sharing(sbatchFile, args);
 
     return true;
 }
@@ -137,10 +138,16 @@ bool write_noise_model_run_command(std::ofstream& sbatchFile,const CunqaArgs& ar
                + R"(","thermal_relaxation":")" +  std::to_string(thermal_relaxation)
                + R"(","readout_error":")" +  std::to_string(readout_error)
                + R"(","gate_error":")" +  std::to_string(gate_error)
-               + R"(","fakeqmio":")" +  std::to_string(fakeqmio)+ R"("})" ;
+               + R"(","fakeqmio":")" +  std::to_string(fakeqmio)
+               + R"(","n_workers":)" + std::to_string(std::max(1, args.workers_per_qpu)) + R"(})" ;
+    if (args.qpus_per_process > 1) {
+        JSON qpu_args = JSON::parse(noise_properties);
+        add_qpus_per_process(qpu_args, args);
+        noise_properties = qpu_args.dump();
+    }
 
     subcommand = mode + " no_comm " + std::any_cast<std::string>(args.family_name) + " Aer \'" + noise_properties + "\'" + "\n";
-    run_command =  "srun --task-epilog=$EPILOG_PATH setup_qpus " + subcommand;
+    run_command =  "srun " + numa_binding(args) + "--task-epilog=$EPILOG_PATH setup_qpus " + subcommand;
 
     sbatchFile << run_command;
 
@@ -157,7 +164,7 @@ void write_noise_model_sbatch(std::ofstream& sbatchFile,const CunqaArgs& args)
         LOGGER_ERROR("Simulator {} is not available for noisy simulation. Aborting. ", std::string(args.simulator));
         throw std::runtime_error("Error.");
 
-    } else if (exists_family_name(args.family_name, constants::QPUS_FILEPATH)) {
+    } else if (!args.grow && exists_family_name(args.family_name, constants::QPUS_REGISTRY)) {
         LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
         throw std::runtime_error("Bad family name.");
 
@@ -165,6 +172,9 @@ void write_noise_model_sbatch(std::ofstream& sbatchFile,const CunqaArgs& args)
         LOGGER_ERROR("Personalized noise models not supported with classical/quantum communications schemes");
         throw std::runtime_error("Bad communication scheme.");
 
+    } else if (!valid_qpus_per_process(args)) {
+        throw std::runtime_error("Bad number of QPUs per process.");
+
     } else if (args.backend.has_value()) {
         LOGGER_WARN("Because noise properties were provided backend will be redefined according to them.");
 
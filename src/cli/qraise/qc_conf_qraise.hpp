@@ -3,6 +3,7 @@
 #include <string>
 #include <cmath>
 #include <vector>
+#include <optional>
 #include <algorithm>
 
 #include "argparse/argparse.hpp"
@@ -15,13 +16,31 @@
 namespace{
 using namespace cunqa;
 
+// Slurm tasks of the executor: one, or with --distributed as many as the ranks over which its
+// combined statevector is spread
+int executor_tasks(const CunqaArgs& args)
+{
+    return args.distributed.value_or(1);
+}
+
+// srun of the distributed executor, whose tasks split the cores and memory of a single one
+std::string distributed_executor_srun(const CunqaArgs& args, const int n_cores, const std::optional<int> memory, const std::string& gpus)
+{
+    const int n_tasks = executor_tasks(args);
+    const int cores_per_task = std::max(1, n_cores / n_tasks);
+    std::string srun = "srun --exclusive -n " + std::to_string(n_tasks) + " -c " + std::to_string(cores_per_task) + " ";
+    if (memory.has_value())
+        srun += "--mem-per-cpu=" + std::to_string(std::max(1, memory.value() / (n_tasks * cores_per_task))) + "G ";
+    return srun + gpus + "setup_executor " + args.simulator + " " + std::to_string(args.n_qpus) + " distributed\n";
+}
+
 
 bool write_qc_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
 {
-    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus + 1) << "\n";
+    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus + executor_tasks(args)) << "\n";
     int cores_per_qpu = std::ceil(
         static_cast<double>(args.n_qpus * (args.cores_per_qpu + 1)) / 
-        (args.n_qpus + 1)
+        (args.n_qpus + executor_tasks(args))
     );
     sbatchFile << "#SBATCH -c " << std::to_string(cores_per_qpu) << "\n";
     sbatchFile << "#SBATCH -N " << std::to_string(args.number_of_nodes.value()) << "\n";
@@ -62,13 +81,12 @@ bool write_qc_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
     return false;
 #else
 
-    std::vector<std::string> simulators_with_gpu_support = {"Aer"};
-    if (std::find(simulators_with_gpu_support.begin(), simulators_with_gpu_support.end(), std::string(args.simulator)) == simulators_with_gpu_support.end()) {
-        LOGGER_ERROR("At this moment, only Aer supports GPU simulation");
+    if (!supports_gpu(std::string(args.simulator))) {
+        LOGGER_ERROR("{} was not compiled for GPU, only Aer (AER_GPU) and QuEST (QUEST_GPU) run on GPU.", std::string(args.simulator));
         return false;
     }
 
-    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus + 1) << "\n";
+    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus + executor_tasks(args)) << "\n";
 
 #if GPU_ARCH == 75
     sbatchFile << "#SBATCH --gres=gpu:t4\n";
@@ -86,7 +104,7 @@ bool write_qc_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
 
     int cores_per_qpu = std::ceil(
         static_cast<double>(args.n_qpus * (args.cores_per_qpu + 1)) / 
-        (args.n_qpus + 1)
+        (args.n_qpus + executor_tasks(args))
     );
     sbatchFile << "#SBATCH -c " << std::to_string(cores_per_qpu) << "\n";
     if (args.mem_per_qpu.has_value()) {
@@ -130,10 +148,10 @@ bool write_qc_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args)
 bool write_qc_run_command(std::ofstream& sbatchFile,const CunqaArgs& args)
 {
     LOGGER_DEBUG("Inside write_qc_run_command");
-    #ifdef USE_MPI_BTW_QPU
+    if (args.cc_mpi) {
         LOGGER_ERROR("Quantum Communications are not supported with MPI.");
         return false;
-    #endif
+    }
 
     std::string run_command;
     std::string subcommand;
@@ -155,7 +173,11 @@ bool write_qc_run_command(std::ofstream& sbatchFile,const CunqaArgs& args)
 
         run_command =  "srun --exclusive  -n " + std::to_string(args.n_qpus) + " -c 1 --mem-per-cpu=1G --task-epilog=$EPILOG_PATH setup_qpus " +  subcommand + " &\n";
         // This is done to avoid run conditions in the IP publishing of the QPUs for the executor
-        run_command +=  "srun --exclusive  -n 1 -c " + std::to_string(simulator_n_cores) + " --mem=" + std::to_string(simulator_memory) + "G setup_executor " + args.simulator + " " + std::to_string(args.n_qpus) + "\n";
+        if (args.distributed.has_value()) {
+            run_command += distributed_executor_srun(args, simulator_n_cores, args.mem_per_qpu.has_value() ? std::optional<int>(simulator_memory) : std::nullopt, "");
+        } else {
+            run_command +=  "srun --exclusive  -n 1 -c " + std::to_string(simulator_n_cores) + " --mem=" + std::to_string(simulator_memory) + "G setup_executor " + args.simulator + " " + std::to_string(args.n_qpus) + "\n";
+        }
     } else {
 #if !COMPILATION_FOR_GPU
         LOGGER_ERROR("CUNQA was not compiled with GPU support.");
@@ -170,7 +192,12 @@ bool write_qc_run_command(std::ofstream& sbatchFile,const CunqaArgs& args)
         run_command =  "srun --exclusive  -n " + std::to_string(args.n_qpus) + " -c 1 --mem-per-cpu=1G --gres=gpu:0 --task-epilog=$EPILOG_PATH setup_qpus " +  subcommand + " &\n";
         // This is done to avoid run conditions in the IP publishing of the QPUs for the executor
         run_command += "sleep 1\n";
-        run_command +=  "srun --exclusive -n 1 -c " + std::to_string(simulator_n_cores) + " --mem=" + std::to_string(simulator_memory) + "G --gres=gpu:1 setup_executor " + args.simulator + " " + std::to_string(args.n_qpus) + "\n";
+        if (args.distributed.has_value()) {
+            // A GPU per rank, which exchange the statevector through CUDA-aware MPI
+            run_command += distributed_executor_srun(args, simulator_n_cores, args.mem_per_qpu.has_value() ? std::optional<int>(simulator_memory) : std::nullopt, "--gpus-per-task=1 ");
+        } else {
+            run_command +=  "srun --exclusive -n 1 -c " + std::to_string(simulator_n_cores) + " --mem=" + std::to_string(simulator_memory) + "G --gres=gpu:1 setup_executor " + args.simulator + " " + std::to_string(args.n_qpus) + "\n";
+        }
     }
 #endif //USE_ZMQ_BTW_QPU
 
@@ -190,7 +217,15 @@ void write_qc_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
         LOGGER_ERROR("Simulator {} is not available for quantum communications simulation. Aborting. ", std::string(args.simulator));
         throw std::runtime_error("Error.");
 
-    } else if (exists_family_name(args.family_name, constants::QPUS_FILEPATH)) {
+    } else if (args.distributed.has_value() && std::string(args.simulator) != "Quest") {
+        LOGGER_ERROR("Only QuEST spreads the statevector of the executor over several tasks, {} was requested.", std::string(args.simulator));
+        throw std::runtime_error("Error.");
+
+    } else if (args.distributed.has_value() && (args.distributed.value() < 2 || (args.distributed.value() & (args.distributed.value() - 1)) != 0)) {
+        LOGGER_ERROR("QuEST distributes its statevector over a power of two of tasks, {} were requested.", args.distributed.value());
+        throw std::runtime_error("Bad number of tasks.");
+
+    } else if (exists_family_name(args.family_name, constants::QPUS_REGISTRY)) {
         LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
         throw std::runtime_error("Bad family name.");
 
@@ -15,15 +15,15 @@ using namespace cunqa;
 
 bool write_simple_resources(std::ofstream& sbatchFile, const CunqaArgs& args)
 {
-    sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
-    sbatchFile << "#SBATCH -c " << std::to_string(args.cores_per_qpu) << "\n";
+    sbatchFile << "#SBATCH --ntasks=" << std::to_string(n_qpu_processes(args)) << "\n";
+    sbatchFile << "#SBATCH -c " << std::to_string(args.cores_per_qpu * args.qpus_per_process) << "\n";
     sbatchFile << "#SBATCH -N " << std::to_string(args.number_of_nodes.value()) << "\n";
     
     if(args.partition.has_value())
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     
     if (args.qpus_per_node.has_value()) {
-            sbatchFile << "#SBATCH --ntasks-per-node=" << std::to_string(args.qpus_per_node.value()) << "\n";
+            sbatchFile << "#SBATCH --ntasks-per-node=" << std::to_string((args.qpus_per_node.value() + args.qpus_per_process - 1) / args.qpus_per_process) << "\n";
     }
     
     if (args.node_list.has_value()) {
@@ -54,23 +54,22 @@ bool write_simple_gpu_resources(std::ofstream& sbatchFile, const CunqaArgs& args
     return false;
 #else
 
-    std::vector<std::string> simulators_with_gpu_support = {"Aer"};
-    if (std::find(simulators_with_gpu_support.begin(), simulators_with_gpu_support.end(), std::string(args.simulator)) == simulators_with_gpu_support.end()) {
-        LOGGER_ERROR("At this moment, only Aer supports GPU simulation");
+    if (!supports_gpu(std::string(args.simulator))) {
+        LOGGER_ERROR("{} was not compiled for GPU, only Aer (AER_GPU) and QuEST (QUEST_GPU) run on GPU.", std::string(args.simulator));
         return false;
     }
 
     sbatchFile << "#SBATCH --ntasks=" << std::to_string(args.n_qpus) << "\n";
 
 #if GPU_ARCH == 75
-    sbatchFile << "#SBATCH --gres=gpu:t4\n";
+    sbatchFile << gpu_gres(args, "t4");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     } else {
         sbatchFile << "#SBATCH -p viz\n";
     }    
 #elif GPU_ARCH == 80
-    sbatchFile << "#SBATCH --gres=gpu:a100:" << std::to_string(args.n_qpus) << "\n";
+    sbatchFile << gpu_gres(args, "a100");
     if(args.partition.has_value()) {
         sbatchFile << "#SBATCH --partition=" << args.partition.value() << "\n";
     }    
@@ -111,6 +110,7 @@ bool write_simple_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_MEM_PER_NODE SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::INSTALL_PATH) << "/bin/epilog.sh\n";
+    write_gpu_sharing(sbatchFile, args);
 
     return true;
 }
@@ -119,8 +119,7 @@ bool write_simple_run_command(std::ofstream& sbatchFile, const CunqaArgs& args)
 {
     std::string run_command;
     std::string subcommand;
-    std::string backend_path;
-    std::string backend;
+    JSON qpu_args;
     std::string mode = args.co_located ? "co_located" : "hpc";
 
     if (args.backend.has_value()) {
@@ -130,16 +129,26 @@ bool write_simple_run_command(std::ofstream& sbatchFile, const CunqaArgs& args)
             return false;
         } else {
             LOGGER_DEBUG("Qraise with no communications and personalized backend. \n");
-            backend_path = std::string(args.backend.value());
-            backend = R"({"backend_path":")" + backend_path + R"("})" ;
-            subcommand = mode + " no_comm " + args.family_name + " " + args.simulator + " \'" + backend + "\'" "\n";
-            run_command = "srun --task-epilog=$EPILOG_PATH setup_qpus " + subcommand;
+            qpu_args["backend_path"] = std::string(args.backend.value());
         }
-    } else {
-        subcommand = mode + " no_comm " + args.family_name + " " + args.simulator + "\n";
-        run_command = "srun --task-epilog=$EPILOG_PATH setup_qpus " + subcommand;
     }
 
+    if (args.workers_per_qpu > 1) {
+        if (args.workers_per_qpu > args.cores_per_qpu)
+            LOGGER_WARN("There are more workers per QPU ({}) than cores per QPU ({}).", args.workers_per_qpu, args.cores_per_qpu);
+        qpu_args["n_workers"] = args.workers_per_qpu;
+    }
+    if (args.queue_depth > 0)
+        qpu_args["max_queued_tasks"] = args.queue_depth;
+    if (args.queue_memory > 0)
+        qpu_args["max_queued_mb"] = args.queue_memory;
+    add_qpus_per_process(qpu_args, args);
+
+    subcommand = mode + " no_comm " + args.family_name + " " + args.simulator;
+    if (!qpu_args.empty())
+        subcommand += " \'" + qpu_args.dump() + "\'";
+    run_command = "srun " + numa_binding(args) + "--task-epilog=$EPILOG_PATH setup_qpus " + subcommand + "\n";
+
     sbatchFile << run_command;
 
     return true;
@@ -155,10 +164,17 @@ void write_simple_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
         LOGGER_ERROR("Simulator {} is not available for simple simulation. Aborting. ", std::string(args.simulator));
         throw std::runtime_error("Error.");
 
-    } else if (exists_family_name(args.family_name, constants::QPUS_FILEPATH)) {
+    } else if (!args.grow && exists_family_name(args.family_name, constants::QPUS_REGISTRY)) {
         LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
         throw std::runtime_error("Bad family name.");
         
+    } else if (args.workers_per_qpu < 1) {
+        LOGGER_ERROR("Each QPU needs at least one worker, {} were requested.", args.workers_per_qpu);
+        throw std::runtime_error("Bad number of workers.");
+
+    } else if (!valid_qpus_per_process(args)) {
+        throw std::runtime_error("Bad number of QPUs per process.");
+
     } else if (!write_simple_sbatch_header(sbatchFile, args) || !write_simple_run_command(sbatchFile, args)) {
         LOGGER_ERROR("Error writing simple sbatch file.");
         throw std::runtime_error("Error.");
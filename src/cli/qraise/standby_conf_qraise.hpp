@@ -0,0 +1,169 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <filesystem>
+
+#include "argparse/argparse.hpp"
+#include "utils/constants.hpp"
+#include "utils/json.hpp"
+#include "utils/registry.hpp"
+#include "args_qraise.hpp"
+#include "utils_qraise.hpp"
+#include "simple_conf_qraise.hpp"
+#include "logger.hpp"
+
+extern char** environ;
+
+namespace {
+using namespace cunqa;
+
+// Pool of the standby QPUs that a qraise of these arguments adopts: those of the same simulator,
+// device, mode, cores and memory
+std::string standby_pool(const CunqaArgs& args)
+{
+    std::string pool = args.simulator + (args.gpu ? "_gpu" : "_cpu") + (args.co_located ? "_co_located" : "_hpc")
+                     + "_" + std::to_string(args.cores_per_qpu) + "c";
+    if (args.mem_per_qpu.has_value())
+        pool += "_" + std::to_string(args.mem_per_qpu.value()) + "G";
+    return pool;
+}
+
+// Script of the pool, kept to raise more of its QPUs as they are adopted
+std::string standby_script(const std::string& pool)
+{
+    return constants::get_cunqa_path() + "/standby/" + pool + ".sbatch";
+}
+
+// Whether the QPUs asked for are plain ones without communications, which any standby QPU of
+// their pool serves as well
+bool adopts_standby(const CunqaArgs& args)
+{
+    return !args.no_standby && !args.standby && !args.grow && !args.cc && !args.qc && !args.cc_mpi
+        && !args.infrastructure.has_value() && !args.qmio && !args.distributed.has_value()
+        && !args.noise_properties.has_value() && !args.fakeqmio.has_value() && !args.backend.has_value()
+        && !args.precision.has_value() && !args.huge_pages.has_value() && !args.node_list.has_value()
+        && !args.partition.has_value() && !args.qpus_per_node.has_value()
+        && args.workers_per_qpu == 1 && args.qpus_per_process == 1 && args.gpus_per_qpu == 1 && !args.gpu_sharing.has_value() && args.io_cores == 0
+        && args.zmq_io_threads == 0 && args.zmq_hwm == 0 && args.zmq_tcp_buffer == 0
+        && args.queue_depth == 0 && args.queue_memory == 0 && args.result_cache == 0 && args.retained_states == 0
+        && !args.checkpoint_dir.has_value() && !args.circuit_store.has_value() && args.circuit_store_cache == 0 && !args.numa;
+}
+
+// Writes the script of a standby pool, a single QPU that sbatch raises once per task of a job
+// array. The environment that qraise set for the QPUs is written into the script, so that the
+// QPUs raised later to replenish the pool get it too
+void write_standby_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    if (args.n_qpus == 0 || args.time == "") {
+        LOGGER_ERROR("qraise needs two mandatory arguments:\n \t -n: number of vQPUs to be raised\n\t -t: maximum time vQPUs will be raised (hh:mm:ss)\n");
+        throw std::runtime_error("Bad arguments.");
+    } else if (args.family_name != "default" || args.cc || args.qc || args.grow || args.infrastructure.has_value()
+               || args.qmio || args.distributed.has_value() || args.noise_properties.has_value()
+               || args.fakeqmio.has_value() || args.backend.has_value() || args.qpus_per_process > 1) {
+        LOGGER_ERROR("Standby QPUs are plain QPUs without communications, that take the family of the qraise that adopts them.");
+        throw std::runtime_error("Bad arguments.");
+    }
+
+    CunqaArgs pool_args = args;
+    pool_args.n_qpus = 1;
+    pool_args.family_name = "standby_" + standby_pool(args);
+    if (std::find(constants::SUPPORTED_SIMPLE_SIMULATORS.begin(), constants::SUPPORTED_SIMPLE_SIMULATORS.end(), std::string(args.simulator)) == constants::SUPPORTED_SIMPLE_SIMULATORS.end()) {
+        LOGGER_ERROR("Simulator {} is not available for simple simulation. Aborting. ", std::string(args.simulator));
+        throw std::runtime_error("Error.");
+    } else if (!write_simple_sbatch_header(sbatchFile, pool_args)) {
+        LOGGER_ERROR("Error writing standby sbatch file.");
+        throw std::runtime_error("Error.");
+    }
+
+    sbatchFile << "export CUNQA_STANDBY=" << standby_pool(args) << "\n";
+    for (char** variable = environ; *variable != nullptr; variable++) {
+        const std::string assignment(*variable);
+        if ((assignment.starts_with("CUNQA_") || assignment.starts_with("OMP_")) && !assignment.starts_with("CUNQA_STANDBY="))
+            sbatchFile << "export " << assignment.substr(0, assignment.find('=')) << "='" << assignment.substr(assignment.find('=') + 1) << "'\n";
+    }
+    if (!write_simple_run_command(sbatchFile, pool_args)) {
+        LOGGER_ERROR("Error writing standby sbatch file.");
+        throw std::runtime_error("Error.");
+    }
+}
+
+// Raises n more QPUs of the pool in the background, without waiting for sbatch
+void replenish_standby(const std::string& pool, const int n_qpus)
+{
+    const auto script = standby_script(pool);
+    if (!std::filesystem::exists(script)) {
+        LOGGER_WARN("The script {} of the standby pool is gone, the pool is not replenished.", script);
+        return;
+    }
+    const std::string sbatch_cmd = "sbatch --parsable --array=0-" + std::to_string(n_qpus - 1) + " " + script + " > /dev/null 2>&1 &";
+    std::system(sbatch_cmd.c_str());
+}
+
+// Takes n standby QPUs of the pool of the arguments into their family, by changing their entries
+// in the registry, and returns the Slurm job of the first one. The newest QPUs are taken, those
+// with most time left. If there are not enough, those taken are given back and nothing is adopted
+std::optional<std::string> adopt_standby(const CunqaArgs& args)
+{
+    const std::string pool = standby_pool(args);
+    auto registry = open_registry(constants::QPUS_REGISTRY);
+    const JSON qpus = registry->read();
+
+    std::vector<std::pair<std::string, double>> candidates;
+    for (const auto& [id, entry] : qpus.items()) {
+        if (entry.is_object() && entry.value("standby", "") == pool && !entry.value("draining", false))
+            candidates.emplace_back(id, entry.value("ready_at", 0.0));
+    }
+    if (candidates.size() < static_cast<std::size_t>(args.n_qpus))
+        return std::nullopt;
+    if (args.family_name != "default" && exists_family_name(args.family_name, constants::QPUS_REGISTRY))
+        return std::nullopt;
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+    // Named after the job of the first one taken, as setup_qpus names the default families
+    std::string family = args.family_name;
+    std::string first_job;
+    const double adopted_at = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    std::vector<std::string> adopted;
+    for (const auto& [id, ready_at] : candidates) {
+        if (adopted.size() == static_cast<std::size_t>(args.n_qpus))
+            break;
+        const bool taken = registry->update(id, [&](JSON& entry) {
+            if (entry.value("standby", "") != pool || entry.value("draining", false))
+                return false;
+            if (family == "default")
+                family = entry.value("slurm_job_id", id.substr(0, id.find('_')));
+            if (first_job.empty())
+                first_job = entry.value("slurm_job_id", id.substr(0, id.find('_')));
+            entry.erase("standby");
+            entry["family"] = family;
+            entry["adopted_at"] = adopted_at;
+            return true;
+        });
+        if (taken)
+            adopted.push_back(id);
+    }
+
+    if (adopted.size() < static_cast<std::size_t>(args.n_qpus)) {
+        for (const auto& id : adopted) {
+            registry->update(id, [&](JSON& entry) {
+                entry["standby"] = pool;
+                entry["family"] = "standby_" + pool;
+                entry.erase("adopted_at");
+                return true;
+            });
+        }
+        LOGGER_DEBUG("Only {} standby QPUs of the pool {} were free, they are given back.", adopted.size(), pool);
+        return std::nullopt;
+    }
+
+    LOGGER_INFO("Adopted {} standby QPUs of the pool {} into the family {}, they keep the time left of their jobs.", adopted.size(), pool, family);
+    replenish_standby(pool, args.n_qpus);
+    return first_job;
+}
+
+} // End namespace
@@ -4,48 +4,293 @@
 #include <regex>
 #include <fstream>
 #include <cmath>
+#include <cstdint>
 #include <cstdio> // For popen, pclose
 #include <algorithm>
 #include <filesystem>
 
 #include "args_qraise.hpp"
+#include "utils/constants.hpp"
 #include "utils/json.hpp"
+#include "utils/registry.hpp"
+#include "utils/helpers/precision.hpp"
 #include "logger.hpp"
 
 namespace fs = std::filesystem;
 
 
-bool exists_family_name(const std::string& family, const std::string& info_path)
+bool exists_family_name(const std::string& family, const std::string& registry_path)
 {
-    std::ifstream file(info_path);
-    if (!file) {
+    for (const auto& [key, value] : cunqa::open_registry(registry_path)->read().items()) {
+        if (value.contains("family") && value["family"] == family)
+            return true;
+    }
+    return false;
+}
+
+// Slurm tasks that host the QPUs, each one up to qpus_per_process of them
+int n_qpu_processes(const CunqaArgs& args)
+{
+    return (args.n_qpus + args.qpus_per_process - 1) / args.qpus_per_process;
+}
+
+// Checks the QPUs per process, which only the QPUs without communications on CPU take
+bool valid_qpus_per_process(const CunqaArgs& args)
+{
+    if (args.qpus_per_process < 1) {
+        LOGGER_ERROR("Each process needs to host at least one QPU, {} were requested.", args.qpus_per_process);
         return false;
-    } else {
-        cunqa::JSON qpus_json;
-        try {
-            file >> qpus_json;
-            for (auto& [key, value] : qpus_json.items()) {
-                if (value["family"] == family) {
-                    return true;
-                } 
-            }
+    } else if (args.qpus_per_process > 1 && args.gpu) {
+        LOGGER_ERROR("Several QPUs per process are not supported on GPU, each QPU takes a GPU of its own.");
+        return false;
+    }
+    return true;
+}
+
+// Checks the cores reserved for the IO threads, which have to leave some to the simulations
+bool valid_io_cores(const CunqaArgs& args)
+{
+    if (args.io_cores < 0) {
+        LOGGER_ERROR("The cores reserved for the IO threads cannot be negative, {} were requested.", args.io_cores);
+        return false;
+    } else if (args.io_cores > 0 && args.io_cores >= args.cores_per_qpu * args.qpus_per_process) {
+        LOGGER_ERROR("--io-cores must leave some of the {} cores of each task to the simulations.", args.cores_per_qpu * args.qpus_per_process);
+        return false;
+    }
+    return true;
+}
+
+// Checks that the family to grow is running, and that its QPUs have no communications, whose
+// endpoints are only exchanged among the QPUs of a job
+bool valid_grow(const CunqaArgs& args)
+{
+    if (!args.grow)
+        return true;
+    if (args.family_name == "default") {
+        LOGGER_ERROR("--grow needs the name of the family, given with --fam, to which the QPUs are added.");
+        return false;
+    } else if (args.cc || args.qc || args.distributed.has_value() || args.infrastructure.has_value() || args.qmio) {
+        LOGGER_ERROR("Only families of QPUs without communications grow.");
+        return false;
+    } else if (!exists_family_name(args.family_name, cunqa::constants::QPUS_REGISTRY)) {
+        LOGGER_ERROR("There is no family {} to grow.", args.family_name);
+        return false;
+    }
+    return true;
+}
+
+// Arguments of setup_qpus for the QPUs per process, as the rank of each task tells which of the QPUs it hosts
+void add_qpus_per_process(JSON& qpu_args, const CunqaArgs& args)
+{
+    if (args.qpus_per_process > 1) {
+        qpu_args["qpus_per_process"] = args.qpus_per_process;
+        qpu_args["n_qpus"] = args.n_qpus;
+    }
+}
+
+// Simulators built to run on GPU, with the AER_GPU and QUEST_GPU options of CMake
+#ifndef CUNQA_AER_GPU
+#define CUNQA_AER_GPU 0
+#endif
+#ifndef CUNQA_QUEST_GPU
+#define CUNQA_QUEST_GPU 0
+#endif
+bool supports_gpu(const std::string& simulator)
+{
+    return (CUNQA_AER_GPU && simulator == "Aer") || (CUNQA_QUEST_GPU && simulator == "Quest");
+}
+
+// Checks the GPUs per QPU, that only the QPUs with a statevector of their own on GPU span
+bool valid_gpus_per_qpu(const CunqaArgs& args)
+{
+    if (args.gpus_per_qpu < 1) {
+        LOGGER_ERROR("Each QPU needs at least one GPU, {} were requested.", args.gpus_per_qpu);
+        return false;
+    } else if (args.gpus_per_qpu > 1 && !args.gpu) {
+        LOGGER_ERROR("--gpus-per-qpu needs --gpu.");
+        return false;
+    } else if (args.gpus_per_qpu > 1 && (args.qc || args.distributed.has_value())) {
+        LOGGER_ERROR("Several GPUs per QPU are not supported with quantum communications, and distributed QPUs take a GPU per task.");
+        return false;
+    }
+    return true;
+}
+
+// Memory in GB of each of the GPUs CUNQA was compiled for, T4 or A100, and 0 for the rest
+int gpu_memory_gb()
+{
+#if GPU_ARCH == 75
+    return 16;
+#elif GPU_ARCH == 80
+    return 40;
+#else
+    return 0;
+#endif
+}
+
+// Memory in GB of the MIG slices of a profile, the number before "gb" as in 1g.5gb, or 0
+int mig_memory_gb(const std::string& profile)
+{
+    std::smatch match;
+    if (std::regex_search(profile, match, std::regex(R"((\d+)gb)")))
+        return std::stoi(match[1]);
+    return 0;
+}
+
+// Device memory that each QPU sharing a GPU leaves to the CUDA context of its process
+constexpr std::uint64_t GPU_CONTEXT_MB = 512;
+
+// MB of the statevector of the largest circuits of the QPUs, in the precision they run
+std::uint64_t gpu_state_mb(const CunqaArgs& args)
+{
+    const std::string precision = args.precision.value_or(cunqa::supported_precisions(args.simulator).front());
+    return ((precision == "single" ? std::uint64_t{8} : std::uint64_t{16}) << args.gpu_qubits) >> 20;
+}
+
+// QPUs on each GPU: those asked with --qpus-per-gpu, or as many statevectors of --gpu-qubits as
+// fit in its memory along with their contexts, and a single one on each MIG slice
+int qpus_per_gpu(const CunqaArgs& args)
+{
+    if (args.gpu_sharing != "mps")
+        return 1;
+    int qpus = args.qpus_per_gpu;
+    if (qpus == 0 && args.gpu_qubits > 0)
+        qpus = static_cast<int>(std::uint64_t(gpu_memory_gb()) * 1024 / (gpu_state_mb(args) + GPU_CONTEXT_MB));
+    return std::clamp(qpus, 1, std::max(1, args.n_qpus));
+}
+
+// Device memory in MB of each QPU sharing a GPU, its part of the GPU or its MIG slice, that it
+// checks the tasks against. 0 when the QPUs do not share the GPUs
+std::uint64_t gpu_memory_per_qpu_mb(const CunqaArgs& args)
+{
+    if (args.gpu_sharing == "mig")
+        return std::uint64_t(mig_memory_gb(*args.mig_profile)) * 1024;
+    if (args.gpu_sharing == "mps")
+        return std::uint64_t(gpu_memory_gb()) * 1024 / qpus_per_gpu(args);
+    return 0;
+}
+
+// GPUs of the job: a MIG slice per QPU, one per --qpus-per-gpu QPUs with MPS, or else those of
+// each QPU
+int n_gpus(const CunqaArgs& args)
+{
+    if (args.gpu_sharing == "mig")
+        return args.n_qpus;
+    if (args.gpu_sharing == "mps")
+        return (args.n_qpus + qpus_per_gpu(args) - 1) / qpus_per_gpu(args);
+    return args.n_qpus * args.gpus_per_qpu;
+}
+
+// The --gres of the GPUs of the job, of the type of those CUNQA was compiled for, or of the
+// profile of the MIG slices
+std::string gpu_gres(const CunqaArgs& args, const std::string& type)
+{
+    return "#SBATCH --gres=gpu:" + (args.gpu_sharing == "mig" ? *args.mig_profile : type) + ":" + std::to_string(n_gpus(args)) + "\n";
+}
+
+// Checks the sharing of the GPUs, and that the largest circuits of the QPUs fit in their part
+bool valid_gpu_sharing(const CunqaArgs& args)
+{
+    if (!args.gpu_sharing.has_value()) {
+        if (args.qpus_per_gpu != 0 || args.gpu_qubits != 0 || args.mig_profile.has_value()) {
+            LOGGER_ERROR("--qpus-per-gpu, --gpu-qubits and --mig-profile need --gpu-sharing.");
             return false;
-        } catch (const std::exception& e) {
-            LOGGER_DEBUG("The qpus.json file was completely empty. An empty json will be written on it.");
-            file.close();
-            std::ofstream out(info_path);
-            if (!out) {
-                LOGGER_DEBUG("Impossible to open the empty qpus.json file to write on it. It will be deleted and created again");
-                std::remove(info_path.c_str());
-                out.open(info_path);
-                return false;  
-            }
-            out << "{ }";  
-            out.close();
+        }
+        return true;
+    }
+    if (*args.gpu_sharing != "mps" && *args.gpu_sharing != "mig") {
+        LOGGER_ERROR("Unknown GPU sharing {}, it must be mps or mig.", *args.gpu_sharing);
+        return false;
+    } else if (!args.gpu) {
+        LOGGER_ERROR("--gpu-sharing needs --gpu.");
+        return false;
+    } else if (args.gpus_per_qpu > 1 || args.qc || args.distributed.has_value() || args.infrastructure.has_value() || args.standby) {
+        LOGGER_ERROR("The QPUs that share a GPU take no more than a part of one, so GPU sharing is not supported with --gpus-per-qpu, quantum communications, distributed QPUs, infrastructures nor standby pools.");
+        return false;
+    } else if (args.qpus_per_gpu < 0 || args.gpu_qubits < 0 || args.gpu_qubits > 40) {
+        LOGGER_ERROR("--qpus-per-gpu and --gpu-qubits cannot be negative, nor the qubits more than 40.");
+        return false;
+    }
 
+    if (*args.gpu_sharing == "mig") {
+        if (!args.mig_profile.has_value() || mig_memory_gb(*args.mig_profile) == 0) {
+            LOGGER_ERROR("--gpu-sharing mig needs the --mig-profile of the slices, as 1g.5gb.");
+            return false;
+        } else if (args.qpus_per_gpu > 1) {
+            LOGGER_ERROR("Each QPU takes a MIG slice of its own, --qpus-per-gpu is for --gpu-sharing mps.");
             return false;
         }
+    } else {
+        if (args.mig_profile.has_value()) {
+            LOGGER_ERROR("--mig-profile is for --gpu-sharing mig.");
+            return false;
+        } else if (args.qpus_per_gpu == 0 && args.gpu_qubits == 0) {
+            LOGGER_ERROR("--gpu-sharing mps needs the --qpus-per-gpu, or the --gpu-qubits of the circuits to pack them.");
+            return false;
+        } else if (gpu_memory_gb() == 0) {
+            LOGGER_ERROR("The memory of the GPUs CUNQA was compiled for is unknown, so they cannot be shared.");
+            return false;
+        }
+    }
+
+    if (args.gpu_qubits > 0 && gpu_state_mb(args) + GPU_CONTEXT_MB > gpu_memory_per_qpu_mb(args)) {
+        LOGGER_ERROR("The statevector of {} qubits takes {} MB, more than the {} MB of GPU memory of each QPU.",
+                     args.gpu_qubits, gpu_state_mb(args), gpu_memory_per_qpu_mb(args) - std::min(gpu_memory_per_qpu_mb(args), GPU_CONTEXT_MB));
+        return false;
     }
+    return true;
+}
+
+// Starts the MPS daemon through which the QPUs that share a GPU run their kernels at once,
+// instead of taking turns on it. The pipes are those of the job, so that the jobs on a node do
+// not share a daemon, and it is stopped as the script ends. The GPUs of the job are all on the
+// node of the script, as their gres is counted per node
+void write_gpu_sharing(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    if (args.gpu_sharing != "mps")
+        return;
+    sbatchFile << "export CUDA_MPS_PIPE_DIRECTORY=/tmp/cunqa-mps-$SLURM_JOB_ID/pipe\n";
+    sbatchFile << "export CUDA_MPS_LOG_DIRECTORY=/tmp/cunqa-mps-$SLURM_JOB_ID/log\n";
+    sbatchFile << "mkdir -p $CUDA_MPS_PIPE_DIRECTORY $CUDA_MPS_LOG_DIRECTORY\n";
+    sbatchFile << "nvidia-cuda-mps-control -d\n";
+    sbatchFile << "trap 'echo quit | nvidia-cuda-mps-control; rm -rf /tmp/cunqa-mps-$SLURM_JOB_ID' EXIT\n";
+}
+
+// Checks the precision against those that the simulator runs
+bool valid_precision(const CunqaArgs& args)
+{
+    if (!args.precision.has_value())
+        return true;
+    if (*args.precision != "single" && *args.precision != "double") {
+        LOGGER_ERROR("Unknown precision {}, it must be single or double.", *args.precision);
+        return false;
+    } else if (!cunqa::supports_precision(args.simulator, *args.precision)) {
+        LOGGER_ERROR("{} does not run in {} precision, only in {}.", std::string(args.simulator), *args.precision,
+                     cunqa::supported_precisions(args.simulator).front());
+        return false;
+    } else if (args.infrastructure.has_value()) {
+        LOGGER_ERROR("--precision is not supported with an infrastructure, whose QPUs may run different simulators.");
+        return false;
+    }
+    return true;
+}
+
+// Options of srun that keep the cores of each task together and its memory next to them, so the
+// statevector is allocated on the NUMA domain that simulates it. Slurm knows the topology of the
+// node, which qraise does not see from the login node
+std::string numa_binding(const CunqaArgs& args)
+{
+    return args.numa ? "--cpu-bind=cores --mem-bind=local -m block:block " : "";
+}
+
+// A QPU of an infrastructure may name its NUMA domain in its classical resources, as "numa_domain"
+std::string numa_domain_binding(const JSON& qpu_resources)
+{
+    if (!qpu_resources.contains("numa_domain"))
+        return "";
+    const auto domain = std::to_string(qpu_resources.at("numa_domain").get<int>());
+    return "--cpu-bind=map_ldom:" + domain + " --mem-bind=map_ldom:" + domain
+           + " --export=ALL,OMP_PLACES=cores,OMP_PROC_BIND=close ";
 }
 
 void remove_tmp_files(const std::string filepath)
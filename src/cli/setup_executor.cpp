@@ -6,16 +6,12 @@
 #include <sstream>
 
 #include "qpu.hpp"
-#include "backends/simulators/CUNQA/cunqa_executor.hpp"
-#include "backends/simulators/AER/aer_executor.hpp"
-#include "backends/simulators/Munich/munich_executor.hpp"
-#include "backends/simulators/Maestro/maestro_executor.hpp"
-#include "backends/simulators/Qulacs/qulacs_executor.hpp"
-#include "backends/simulators/Qsim/qsim_executor.hpp"
-#include "backends/simulators/QuEST/quest_executor.hpp"
+#include "simulators.hpp"
+#include "backends/simulators/gpu_memory.hpp"
 
 #include "utils/json.hpp"
-#include "utils/helpers/murmur_hash.hpp"
+#include "utils/helpers/trace.hpp"
+#include "utils/helpers/net_functions.hpp"
 #include "logger.hpp"
 
 using namespace std::string_literals;
@@ -25,67 +21,42 @@ int main(int argc, char *argv[])
 {
     std::string sim_arg;
     std::size_t n_qpus;
-    if (argc == 3) {
+    // The tasks of the executor share the combined statevector of the QPUs
+    bool distributed = false;
+    if (argc == 3 || (argc == 4 && argv[3] == "distributed"s)) {
         sim_arg = argv[1];
         n_qpus = static_cast<size_t>(std::stoull(argv[2]));
+        distributed = argc == 4;
     } else {
         LOGGER_ERROR("Passing incorrect number of arguments.");
         return EXIT_FAILURE;
     }
+    const char* job_id = std::getenv("SLURM_JOB_ID");
+    cunqa::Trace::of_process().name_process("executor "s + (job_id != nullptr ? job_id : ""));
+    retain_gpu_memory(get_device().at("target_devices").get<std::vector<int>>());
 
-    switch(murmur::hash(sim_arg)) {
-        case murmur::hash("Aer"): 
-        {
-            LOGGER_DEBUG("Raising executor with Aer.");
-            AerExecutor executor(n_qpus);
-            executor.run();
-            break;
+    const bool built = BuiltSimulators::visit(sim_arg, [&]<typename Simulator>(std::type_identity<Simulator>) {
+        LOGGER_DEBUG("Raising executor with {}.", Simulator::name);
+        if constexpr (requires { typename Simulator::DistributedExecutor; }) {
+            if (distributed && std::string(std::getenv("SLURM_PROCID")) != "0") {
+                Simulator::DistributedExecutor::follow();
+                return;
+            } else if (distributed) {
+                typename Simulator::DistributedExecutor executor(n_qpus);
+                executor.run();
+                return;
+            }
         }
-        case murmur::hash("Munich"):
-        {
-            LOGGER_DEBUG("Raising executor with Munich.");
-            MunichExecutor executor(n_qpus);
-            executor.run();
-            break;
+        if (distributed) {
+            LOGGER_ERROR("Distributed executors are only supported with QuEST, not with {}.", Simulator::name);
+            std::exit(EXIT_FAILURE);
         }
-        case murmur::hash("Cunqa"):
-        {
-            LOGGER_DEBUG("Raising executor with Cunqa.");
-            CunqaExecutor executor(n_qpus);
-            executor.run();
-            break;
-        }
-        case murmur::hash("Maestro"):
-        {
-            LOGGER_DEBUG("Raising executor with Maestro.");
-            MaestroExecutor executor(n_qpus);
-            executor.run();
-            break;
-        }
-        case murmur::hash("Qulacs"):
-        {
-            LOGGER_DEBUG("Raising executor with Qulacs.");
-            QulacsExecutor executor(n_qpus);
-            executor.run();
-            break;
-        }
-        case murmur::hash("Qsim"):
-        {
-            LOGGER_DEBUG("Raising executor with Qsim.");
-            QsimExecutor executor(n_qpus);
-            executor.run();
-            break;
-        }
-        case murmur::hash("Quest"):
-        {
-            LOGGER_DEBUG("Raising executor with QuEST.");
-            QuestExecutor executor(n_qpus);
-            executor.run();
-            break;
-        }
-        default:
-            LOGGER_ERROR("Not a supported simulator: {}.", sim_arg);
-            return EXIT_FAILURE;
-    }     
+        typename Simulator::Executor executor(n_qpus);
+        executor.run();
+    });
+    if (!built) {
+        LOGGER_ERROR("Not a supported simulator: {}, or it was not built, see CUNQA_SIMULATORS.", sim_arg);
+        return EXIT_FAILURE;
+    }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
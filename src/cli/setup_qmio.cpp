@@ -3,8 +3,7 @@
 #include <iostream>
 #include <string>
 
-#include "comm/server.hpp"
-#include "utils/helpers/net_functions.hpp"
+#include "qmio_linker.hpp"
 #include "utils/json.hpp"
 #include "utils/constants.hpp"
 #include "logger.hpp"
@@ -13,7 +12,8 @@ using namespace cunqa;
 
 namespace {
 
-int set_up_linker(const std::string& family)
+// The Python linker, for those who set CUNQA_PYTHON_QMIO_LINKER
+int set_up_python_linker(const std::string& family)
 {
     std::string command = "python " + constants::INSTALL_PATH + "/cunqa/real_qpus/qmio_linker.py " + family;
     const char* c_command = command.c_str();
@@ -38,10 +38,21 @@ int main(int argc, char *argv[]) {
         family = std::getenv("SLURM_JOB_ID");
     }
     
-    int setup = set_up_linker(std::string(family));
-    
-    if (setup == 1) {
-        LOGGER_ERROR("An error occur in the qmio_linker.py.");
+    if (std::getenv("CUNQA_PYTHON_QMIO_LINKER") != nullptr) {
+        int setup = set_up_python_linker(std::string(family));
+        
+        if (setup == 1) {
+            LOGGER_ERROR("An error occur in the qmio_linker.py.");
+            return 1;
+        }
+        return 0;
+    }
+
+    try {
+        QMIOLinker linker(family);
+        linker.run();
+    } catch (const std::exception& e) {
+        LOGGER_ERROR("An error occurred in the QMIO linker: {}", e.what());
         return 1;
     }
 
@@ -4,81 +4,151 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+#include <filesystem>
 #include <fcntl.h>
 #include <sys/file.h>
 #include <unistd.h>
 
 #include "qpu.hpp"
+#include "utils/helpers/trace.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/cc_backend.hpp"
-#include "backends/simulators/AER/aer_simple_simulator.hpp"
-#include "backends/simulators/AER/aer_cc_simulator.hpp"
-#include "backends/simulators/AER/aer_qc_simulator.hpp"
-#include "backends/simulators/Munich/munich_simple_simulator.hpp"
-#include "backends/simulators/Munich/munich_cc_simulator.hpp"
-#include "backends/simulators/Munich/munich_qc_simulator.hpp"
-#include "backends/simulators/Maestro/maestro_simple_simulator.hpp"
-#include "backends/simulators/Maestro/maestro_cc_simulator.hpp"
-#include "backends/simulators/Maestro/maestro_qc_simulator.hpp"
-#include "backends/simulators/CUNQA/cunqa_simple_simulator.hpp"
-#include "backends/simulators/CUNQA/cunqa_cc_simulator.hpp"
-#include "backends/simulators/CUNQA/cunqa_qc_simulator.hpp"
-#include "backends/simulators/Qulacs/qulacs_simple_simulator.hpp"
-#include "backends/simulators/Qulacs/qulacs_cc_simulator.hpp"
-#include "backends/simulators/Qulacs/qulacs_qc_simulator.hpp"
-#include "backends/simulators/Qsim/qsim_simple_simulator.hpp"
-#include "backends/simulators/Qsim/qsim_cc_simulator.hpp"
-#include "backends/simulators/Qsim/qsim_qc_simulator.hpp"
-#include "backends/simulators/QuEST/quest_simple_simulator.hpp"
-#include "backends/simulators/QuEST/quest_cc_simulator.hpp"
-#include "backends/simulators/QuEST/quest_qc_simulator.hpp"
+#include "simulators.hpp"
+#include "backends/simulators/gpu_memory.hpp"
 
 #include "utils/constants.hpp"
 #include "utils/json.hpp"
 #include "utils/helpers/murmur_hash.hpp"
+#include "utils/helpers/net_functions.hpp"
 #include "logger.hpp"
 
 using namespace std::string_literals;
 using namespace cunqa;
 using namespace cunqa::sim;
 
-std::string generate_noise_instructions(const JSON& back_path_json, const std::string& family)
+std::string file_contents(const std::string& path)
 {
-    std::string backend_path;
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Cannot read " + path + ".");
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Newest calibration file of the QMIO, the one that noise_instructions.py takes by default
+std::string last_calibrations()
+{
+    const std::filesystem::path directory = "/opt/cesga/qmio/hpc/calibrations";
+    std::filesystem::path last;
+    std::filesystem::file_time_type last_time;
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        const auto name = entry.path().filename().string();
+        // YYYY_MM_DD__HH_MM_SS.json
+        if (name.size() != 25 || !name.ends_with(".json") || name.substr(10, 2) != "__")
+            continue;
+        if (last.empty() || entry.last_write_time() > last_time) {
+            last = entry.path();
+            last_time = entry.last_write_time();
+        }
+    }
+    if (last.empty())
+        throw std::runtime_error("No calibration files found in " + directory.string() + ".");
+    return last.string();
+}
+
+// Noise model of the calibrations with the errors asked for, generated by noise_instructions.py
+// only the first time and kept under $STORE/.cunqa/noise_models, named after the hash of the
+// calibrations, the backend and the errors. The first process to take the lock of the model
+// generates it, and the rest wait on the lock, instead of polling, until it is there
+JSON noisy_backend(const JSON& back_path_json, const std::string& family)
+{
+    std::string noise_properties_path = back_path_json.at("noise_properties_path").get<std::string>();
+    if (noise_properties_path == "last_calibrations")
+        noise_properties_path = last_calibrations();
+    const std::string backend_path = back_path_json.contains("backend_path") ? back_path_json.at("backend_path").get<std::string>() : "default";
+    const std::string errors = back_path_json.at("thermal_relaxation").get<std::string>() + " "
+                             + back_path_json.at("readout_error").get<std::string>() + " "
+                             + back_path_json.at("gate_error").get<std::string>();
+    const std::string fakeqmio = back_path_json.at("fakeqmio").get<std::string>();
+
+    const std::string contents = file_contents(noise_properties_path) + "\n"
+                               + (backend_path == "default" ? backend_path : file_contents(backend_path)) + "\n"
+                               + errors + " " + fakeqmio;
+    std::ostringstream key;
+    key << std::hex << std::setfill('0') 
+        << std::setw(8) << murmur::MurmurHash3_x86_32(contents.data(), contents.size(), 123321u)
+        << std::setw(8) << murmur::MurmurHash3_x86_32(contents.data(), contents.size(), 987654321u);
+
+    const auto directory = std::filesystem::path(get_cunqa_path()) / "noise_models";
+    std::filesystem::create_directories(directory);
+    const std::string model_path = (directory / (key.str() + ".json")).string();
 
-    if (back_path_json.contains("backend_path")){
-        LOGGER_DEBUG("backend_path provided");
-        backend_path=back_path_json.at("backend_path").get<std::string>();
+    const int lock = open((model_path + ".lock").c_str(), O_CREAT | O_RDWR, 0644);
+    if (lock == -1 || flock(lock, LOCK_EX) != 0)
+        throw std::runtime_error("Cannot lock the noise model " + model_path + ".");
+    if (!std::filesystem::exists(model_path)) {
+        LOGGER_DEBUG("Generating the noise model {}.", model_path);
+        const std::string command("python "s + constants::INSTALL_PATH + "/cunqa/qiskit_deps/noise_instructions.py "s
+                                  + noise_properties_path + " "s + backend_path + " "s + errors + " "s
+                                  + family + " "s + fakeqmio + " --output "s + model_path);
+        std::system(command.c_str());
     } else {
-        LOGGER_DEBUG("No backend_path provided, defining backend from noise_properties.");
-        backend_path = "default";
+        LOGGER_DEBUG("Reusing the noise model {}.", model_path);
     }
-    std::string command("python "s + constants::INSTALL_PATH + "/cunqa/qiskit_deps/noise_instructions.py "s
-                                   + back_path_json.at("noise_properties_path").get<std::string>() + " "s
-                                   + backend_path + " "s
-                                   + back_path_json.at("thermal_relaxation").get<std::string>() + " "s
-                                   + back_path_json.at("readout_error").get<std::string>() + " "s
-                                   + back_path_json.at("gate_error").get<std::string>() + " "s
-                                   + family + " "s
-                                   + back_path_json.at("fakeqmio").get<std::string>());
-                                   
-    std::system(command.c_str());
-    return "";
+    flock(lock, LOCK_UN);
+    close(lock);
+
+    if (!std::filesystem::exists(model_path))
+        throw std::runtime_error("The noise model could not be generated from " + noise_properties_path + ".");
+    std::ifstream f(model_path);
+    JSON backend_json = JSON::parse(f);
+    // The model is shared by every family, so the default backend is named after this one
+    if (backend_path == "default") {
+        const auto name = backend_json.at("name").get<std::string>();
+        backend_json["name"] = name.substr(0, name.find('_')) + "_" + family;
+    }
+    return backend_json;
 }
 
 template<typename Simulator, typename Config, typename BackendType>
 void turn_ON_QPU(
-    const JSON& backend_json, const std::string& mode, 
-    const std::string& name, const std::string& family, const std::string& comm
+    const JSON& backend_json, const QueueLimits& queue_limits, const std::string& mode, 
+    const std::string& name, const std::string& family, const std::string& comm,
+    const std::size_t n_workers = 1, const std::size_t n_qpus = 1
 )
 {
-    std::unique_ptr<Simulator> simulator = std::make_unique<Simulator>();
-    Config config;
-    config.set_basis_gates(get_basis_gates(simulator->get_name()));
-    if (!backend_json.empty())
-        config = backend_json;
-    QPU qpu(std::make_unique<BackendType>(config, std::move(simulator)), mode, name, family, comm);
-    qpu.turn_ON();
+    // The QPUs of a process share its libraries and what their simulators parse once per process,
+    // as the noise model, but each one listens on its own endpoint with its own workers
+    std::vector<std::unique_ptr<QPU>> qpus;
+    for (std::size_t q = 0; q < n_qpus; q++) {
+        // Each compute worker owns its simulator, so they never share state between executions
+        std::vector<std::unique_ptr<sim::Backend>> backends;
+        for (std::size_t i = 0; i < n_workers; i++) {
+            std::unique_ptr<Simulator> simulator = std::make_unique<Simulator>();
+            Config config;
+            config.set_basis_gates(get_basis_gates(simulator->get_name()));
+            if (!backend_json.empty())
+                config = backend_json;
+            backends.push_back(std::make_unique<BackendType>(config, std::move(simulator)));
+        }
+        const std::string qpu_name = n_qpus == 1 ? name : name + "_" + std::to_string(q);
+        qpus.push_back(std::make_unique<QPU>(std::move(backends), mode, qpu_name, family, comm, queue_limits));
+    }
+
+    if (qpus.size() == 1) {
+        qpus.front()->turn_ON();
+        return;
+    }
+    std::vector<std::thread> hosted;
+    for (auto& qpu : qpus)
+        hosted.emplace_back([&qpu]() { qpu->turn_ON(); });
+    for (auto& thread : hosted)
+        thread.join();
 }
 
 int main(int argc, char *argv[])
@@ -92,147 +162,91 @@ int main(int argc, char *argv[])
         family = std::getenv("SLURM_JOB_ID");
     std::string name = std::getenv("SLURM_JOB_ID") + "_"s 
                      + std::getenv("SLURM_TASK_PID");
+    Trace::of_process().name_process("QPU " + name);
     
     auto back_path_json = (argc == 6 ? JSON::parse(std::string(argv[5])) : JSON());
     JSON backend_json;
 
-    if (back_path_json.contains("noise_properties_path")) {
-        if (sim_arg != "Aer")
-            throw std::runtime_error("Noise is only available with AER at the moment.");
-        std::string fpath = get_cunqa_path() + "/tmp_noisy_backend_" + std::getenv("SLURM_JOB_ID") + ".json";
+    std::size_t n_workers = back_path_json.contains("n_workers") ? back_path_json.at("n_workers").get<std::size_t>() : 1;
+    if (n_workers == 0) {
+        LOGGER_ERROR("A QPU needs at least one compute worker.");
+        return EXIT_FAILURE;
+    } else if (n_workers > 1 && communications != "no_comm") {
+        // Communications simulators publish a single classical channel per vQPU
+        LOGGER_WARN("Several compute workers are only supported without communications; using one.");
+        n_workers = 1;
+    }
 
-        if (std::getenv("SLURM_PROCID") && std::string(std::getenv("SLURM_PROCID")) == "0") {
-            generate_noise_instructions(back_path_json, family);
-            LOGGER_DEBUG("Correctly created tmp noise intructions file.");
-        } else {
-            int fd = open(fpath.c_str(), O_RDONLY);
-            while (fd == -1 || flock(fd, LOCK_SH) != 0) {
-                if (fd != -1) close(fd);
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                fd = open(fpath.c_str(), O_RDONLY);
-            }
-            close(fd);
+    QueueLimits queue_limits;
+    queue_limits.max_tasks = back_path_json.value("max_queued_tasks", std::size_t{0});
+    queue_limits.max_bytes = back_path_json.value("max_queued_mb", std::size_t{0}) << 20;
+
+    // The tasks of the job share the statevector of a single QPU
+    bool distributed = back_path_json.contains("distributed") && back_path_json.at("distributed").get<bool>();
+    if (distributed && (sim_arg != "Quest" || communications != "no_comm")) {
+        LOGGER_ERROR("Distributed QPUs are only supported with QuEST and without communications.");
+        return EXIT_FAILURE;
+    } else if (distributed && n_workers > 1) {
+        // The QuEST calls are collective, so the ranks run one circuit at a time
+        LOGGER_WARN("Distributed QPUs run a single compute worker.");
+        n_workers = 1;
+    }
+
+    // The processes that host several QPUs take those of their rank, and the last one the rest
+    std::size_t n_qpus = 1;
+    if (const auto qpus_per_process = back_path_json.value("qpus_per_process", std::size_t{1}); qpus_per_process > 1) {
+        if (communications != "no_comm" || distributed) {
+            LOGGER_ERROR("Several QPUs per process are only supported without communications and not distributed.");
+            return EXIT_FAILURE;
         }
+        const std::size_t total = back_path_json.at("n_qpus").get<std::size_t>();
+        const std::size_t first = std::stoul(std::getenv("SLURM_PROCID")) * qpus_per_process;
+        n_qpus = first < total ? std::min(qpus_per_process, total - first) : 0;
+        if (n_qpus == 0)
+            return EXIT_SUCCESS;
+        LOGGER_DEBUG("Hosting {} QPUs in this process.", n_qpus);
+    }
 
-        std::ifstream f(fpath);
-        backend_json = JSON::parse(f);
+    if (back_path_json.contains("noise_properties_path")) {
+        if (sim_arg != "Aer")
+            throw std::runtime_error("Noise is only available with AER at the moment.");
+        backend_json = noisy_backend(back_path_json, family);
     } else if (back_path_json.contains("backend_path")) {
         std::ifstream f(back_path_json.at("backend_path").get<std::string>());
         backend_json = JSON::parse(f);
     }
 
-    switch(murmur::hash(communications)) {
-        case murmur::hash("no_comm"): 
-            LOGGER_DEBUG("Raising QPU without communications.");
-            switch(murmur::hash(sim_arg)) {
-                case murmur::hash("Aer"): 
-                    LOGGER_DEBUG("QPU going to turn on with AerSimpleSimulator.");
-                    turn_ON_QPU<AerSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Munich"):
-                    LOGGER_DEBUG("QPU going to turn on with MunichSimpleSimulator.");
-                    turn_ON_QPU<MunichSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Maestro"):
-                    LOGGER_DEBUG("QPU going to turn on with MaestroSimpleSimulator.");
-                    turn_ON_QPU<MaestroSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Cunqa"):
-                    LOGGER_DEBUG("QPU going to turn on with CunqaSimpleSimulator.");
-                    turn_ON_QPU<CunqaSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Qulacs"):
-                    LOGGER_DEBUG("QPU going to turn on with QulacsSimpleSimulator.");
-                    turn_ON_QPU<QulacsSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Qsim"):
-                    LOGGER_DEBUG("QPU going to turn on with QsimSimpleSimulator.");
-                    turn_ON_QPU<QsimSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                case murmur::hash("Quest"):
-                    LOGGER_DEBUG("QPU going to turn on with QuestSimpleSimulator.");
-                    turn_ON_QPU<QuestSimpleSimulator, SimpleConfig, SimpleBackend>(backend_json, mode, name, family, "no_comm");
-                    break;
-                default:
-                    LOGGER_ERROR("Simulator {} do not support simple simulation or does not exist.", sim_arg);
-                    return EXIT_FAILURE;
-            }
-            break;
-        case murmur::hash("cc"): 
-            LOGGER_DEBUG("Raising QPU with classical communications.");
-            switch(murmur::hash(sim_arg)) {
-                case murmur::hash("Aer"): 
-                    LOGGER_DEBUG("QPU going to turn on with AerCCSimulator.");
-                    turn_ON_QPU<AerCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Munich"): 
-                    LOGGER_DEBUG("QPU going to turn on with MunichCCSimulator.");
-                    turn_ON_QPU<MunichCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Maestro"):
-                    LOGGER_DEBUG("QPU going to turn on with MaestroCCSimulator.");
-                    turn_ON_QPU<MaestroCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Cunqa"): 
-                    LOGGER_DEBUG("QPU going to turn on with CunqaCCSimulator.");
-                    turn_ON_QPU<CunqaCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Qulacs"): 
-                    LOGGER_DEBUG("QPU going to turn on with QulacsCCSimulator.");
-                    turn_ON_QPU<QulacsCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Qsim"):
-                    LOGGER_DEBUG("QPU going to turn on with QsimCCSimulator.");
-                    turn_ON_QPU<QsimCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                case murmur::hash("Quest"):
-                    LOGGER_DEBUG("QPU going to turn on with QuestCCSimulator.");
-                    turn_ON_QPU<QuestCCSimulator, CCConfig, CCBackend>(backend_json, mode, name, family, "classical_comm");
-                    break;
-                default:
-                    LOGGER_ERROR("Simulator {} do not support classical communication simulation or does not exist.", sim_arg);
-                    return EXIT_FAILURE;
-            }
-            break;
-        case murmur::hash("qc"):
-            LOGGER_DEBUG("Raising QPU with quantum communications.");
-            switch(murmur::hash(sim_arg)) {
-                case murmur::hash("Aer"): 
-                    LOGGER_DEBUG("QPU going to turn on with AerQCSimulator.");
-                    turn_ON_QPU<AerQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Munich"): 
-                    LOGGER_DEBUG("QPU going to turn on with MunichQCSimulator.");
-                    turn_ON_QPU<MunichQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Maestro"):
-                    LOGGER_DEBUG("QPU going to turn on with MaestroQCSimulator.");
-                    turn_ON_QPU<MaestroQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Cunqa"): 
-                    LOGGER_DEBUG("QPU going to turn on with CunqaQCSimulator.");
-                    turn_ON_QPU<CunqaQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Qulacs"): 
-                    LOGGER_DEBUG("QPU going to turn on with QulacsQCSimulator.");
-                    turn_ON_QPU<QulacsQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Qsim"):
-                    LOGGER_DEBUG("QPU going to turn on with QsimQCSimulator."); 
-                    turn_ON_QPU<QsimQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                case murmur::hash("Quest"):
-                    LOGGER_DEBUG("QPU going to turn on with QuestQCSimulator.");
-                    turn_ON_QPU<QuestQCSimulator, QCConfig, QCBackend>(backend_json, mode, name, family, "quantum_comm");
-                    break;
-                default:
-                    LOGGER_ERROR("Simulator {} do not support quantum communication simulation or does not exist.", sim_arg);
-                    return EXIT_FAILURE;
+    if (communications != "no_comm" && communications != "cc" && communications != "qc") {
+        LOGGER_ERROR("No {} communication method available.", communications);
+        return EXIT_FAILURE;
+    }
+
+    retain_gpu_memory(get_device().at("target_devices").get<std::vector<int>>());
+
+    const bool built = BuiltSimulators::visit(sim_arg, [&]<typename Simulator>(std::type_identity<Simulator>) {
+        if (communications == "no_comm") {
+            LOGGER_DEBUG("Raising QPU without communications with {}.", Simulator::name);
+            if constexpr (requires { typename Simulator::Distributed; }) {
+                if (distributed && std::string(std::getenv("SLURM_PROCID")) != "0") {
+                    Simulator::Distributed::follow();
+                    return;
+                } else if (distributed) {
+                    turn_ON_QPU<typename Simulator::Distributed, SimpleConfig, SimpleBackend>(backend_json, queue_limits, mode, name, family, "no_comm");
+                    return;
+                }
             }
-            break;
-        default:
-            LOGGER_ERROR("No {} communication method available.", communications);
-            return EXIT_FAILURE;
+            turn_ON_QPU<typename Simulator::Simple, SimpleConfig, SimpleBackend>(backend_json, queue_limits, mode, name, family, "no_comm", n_workers, n_qpus);
+        } else if (communications == "cc") {
+            LOGGER_DEBUG("Raising QPU with classical communications with {}.", Simulator::name);
+            turn_ON_QPU<typename Simulator::CC, CCConfig, CCBackend>(backend_json, queue_limits, mode, name, family, "classical_comm");
+        } else {
+            LOGGER_DEBUG("Raising QPU with quantum communications with {}.", Simulator::name);
+            turn_ON_QPU<typename Simulator::QC, QCConfig, QCBackend>(backend_json, queue_limits, mode, name, family, "quantum_comm");
+        }
+    });
+    if (!built) {
+        LOGGER_ERROR("Simulator {} does not exist or was not built, see CUNQA_SIMULATORS.", sim_arg);
+        return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
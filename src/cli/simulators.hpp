@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string_view>
+#include <type_traits>
+
+// Only the simulators listed in CUNQA_SIMULATORS at configure time are compiled and linked into
+// setup_qpus and setup_executor, each one enabled by its CUNQA_WITH_<SIMULATOR> definition
+#ifdef CUNQA_WITH_AER
+#include "backends/simulators/AER/aer_simple_simulator.hpp"
+#include "backends/simulators/AER/aer_cc_simulator.hpp"
+#include "backends/simulators/AER/aer_qc_simulator.hpp"
+#include "backends/simulators/AER/aer_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_MUNICH
+#include "backends/simulators/Munich/munich_simple_simulator.hpp"
+#include "backends/simulators/Munich/munich_cc_simulator.hpp"
+#include "backends/simulators/Munich/munich_qc_simulator.hpp"
+#include "backends/simulators/Munich/munich_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_MAESTRO
+#include "backends/simulators/Maestro/maestro_simple_simulator.hpp"
+#include "backends/simulators/Maestro/maestro_cc_simulator.hpp"
+#include "backends/simulators/Maestro/maestro_qc_simulator.hpp"
+#include "backends/simulators/Maestro/maestro_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_CUNQA
+#include "backends/simulators/CUNQA/cunqa_simple_simulator.hpp"
+#include "backends/simulators/CUNQA/cunqa_cc_simulator.hpp"
+#include "backends/simulators/CUNQA/cunqa_qc_simulator.hpp"
+#include "backends/simulators/CUNQA/cunqa_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_QULACS
+#include "backends/simulators/Qulacs/qulacs_simple_simulator.hpp"
+#include "backends/simulators/Qulacs/qulacs_cc_simulator.hpp"
+#include "backends/simulators/Qulacs/qulacs_qc_simulator.hpp"
+#include "backends/simulators/Qulacs/qulacs_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_QSIM
+#include "backends/simulators/Qsim/qsim_simple_simulator.hpp"
+#include "backends/simulators/Qsim/qsim_cc_simulator.hpp"
+#include "backends/simulators/Qsim/qsim_qc_simulator.hpp"
+#include "backends/simulators/Qsim/qsim_executor.hpp"
+#endif
+#ifdef CUNQA_WITH_QUEST
+#include "backends/simulators/QuEST/quest_simple_simulator.hpp"
+#include "backends/simulators/QuEST/quest_cc_simulator.hpp"
+#include "backends/simulators/QuEST/quest_qc_simulator.hpp"
+#include "backends/simulators/QuEST/quest_distributed_simulator.hpp"
+#include "backends/simulators/QuEST/quest_executor.hpp"
+#include "backends/simulators/QuEST/quest_distributed_executor.hpp"
+#endif
+
+namespace cunqa {
+namespace sim {
+
+// The simulators of each communications mode of a simulator, and its executor, under the name
+// that qraise passes to setup_qpus and setup_executor
+#ifdef CUNQA_WITH_AER
+struct Aer {
+    static constexpr std::string_view name = "Aer";
+    using Simple = AerSimpleSimulator;
+    using CC = AerCCSimulator;
+    using QC = AerQCSimulator;
+    using Executor = AerExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_MUNICH
+struct Munich {
+    static constexpr std::string_view name = "Munich";
+    using Simple = MunichSimpleSimulator;
+    using CC = MunichCCSimulator;
+    using QC = MunichQCSimulator;
+    using Executor = MunichExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_MAESTRO
+struct Maestro {
+    static constexpr std::string_view name = "Maestro";
+    using Simple = MaestroSimpleSimulator;
+    using CC = MaestroCCSimulator;
+    using QC = MaestroQCSimulator;
+    using Executor = MaestroExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_CUNQA
+struct Cunqa {
+    static constexpr std::string_view name = "Cunqa";
+    using Simple = CunqaSimpleSimulator;
+    using CC = CunqaCCSimulator;
+    using QC = CunqaQCSimulator;
+    using Executor = CunqaExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_QULACS
+struct Qulacs {
+    static constexpr std::string_view name = "Qulacs";
+    using Simple = QulacsSimpleSimulator;
+    using CC = QulacsCCSimulator;
+    using QC = QulacsQCSimulator;
+    using Executor = QulacsExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_QSIM
+struct Qsim {
+    static constexpr std::string_view name = "Qsim";
+    using Simple = QsimSimpleSimulator;
+    using CC = QsimCCSimulator;
+    using QC = QsimQCSimulator;
+    using Executor = QsimExecutor;
+};
+#endif
+#ifdef CUNQA_WITH_QUEST
+struct Quest {
+    static constexpr std::string_view name = "Quest";
+    using Simple = QuestSimpleSimulator;
+    using CC = QuestCCSimulator;
+    using QC = QuestQCSimulator;
+    using Executor = QuestExecutor;
+    using Distributed = QuestDistributedSimulator;
+    using DistributedExecutor = QuestDistributedExecutor;
+};
+#endif
+
+template <typename... Simulators>
+struct SimulatorList {
+    // Calls f with the std::type_identity of the simulator with that name, if it was built
+    template <typename F>
+    static bool visit(std::string_view name, F&& f)
+    {
+        return ((Simulators::name == name && (f(std::type_identity<Simulators>{}), true)) || ...);
+    }
+};
+
+// Comma-separated list of the structs above, defined by CMake from CUNQA_SIMULATORS
+using BuiltSimulators = SimulatorList<CUNQA_SIMULATORS>;
+
+} // End of sim namespace
+} // End of cunqa namespace
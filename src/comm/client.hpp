@@ -4,31 +4,77 @@
 #include <fstream>
 #include <string_view>
 #include <memory>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <cstdlib>
 
 namespace cunqa {
 namespace comm {
 
+// Result of a request, received by the client in the background. As a std::future, it is valid
+// until its result is got
 template <typename T>
 class FutureWrapper {
 public: 
-    FutureWrapper(T * client) : client_{client} {};
+    FutureWrapper(T * client, const std::uint64_t request_id) : client_{client}, request_id_{request_id} {};
     
-    inline std::string get() { return client_->recv_results(); };
-    inline bool valid() { return true; };
+    inline std::string get() 
+    {
+        if (!valid_)
+            throw std::runtime_error("The result of this request was already obtained.");
+        valid_ = false;
+        return client_->recv_results(request_id_);
+    };
+    inline bool valid() const { return valid_; };
+    // Whether get would return without waiting
+    inline bool ready() { return valid_ && client_->results_ready(request_id_); };
+    inline bool wait_for(const std::chrono::milliseconds timeout) 
+    { 
+        return valid_ && client_->wait_results(request_id_, timeout); 
+    };
+    // Last intermediate result of a streaming request, empty if none arrived yet
+    inline std::string partial() { return valid_ ? client_->partial_results(request_id_) : std::string(); };
+    // The server sends the final result with what it has done so far
+    inline void stop() { if (valid_) client_->stop(request_id_); };
+    // The server drops the request if queued, or sends an error at the next chunk if streaming
+    inline void cancel() { if (valid_) client_->cancel(request_id_); };
 private:
     T * client_;
+    std::uint64_t request_id_;
+    bool valid_ = true;
 };
 
 class Client {
 public:
 
-    Client();
+    // Multiplexed clients share a single socket, and its receiver thread, with all the
+    // multiplexed clients of the process
+    Client(const bool multiplexed = false);
     ~Client();
 
     void connect(const std::string& endpoint);
+    // Through the local endpoint of the server instead, if it has one and runs on this node
+    void connect(const std::string& endpoint, const std::string& local_endpoint, const std::string& server_nodename)
+    {
+        // Outside Slurm every host is named "login", so the node cannot be told
+        const char* nodename = std::getenv("SLURMD_NODENAME");
+        const bool same_node = !local_endpoint.empty() && nodename && server_nodename == nodename;
+        connect(same_node ? local_endpoint : endpoint);
+    }
     FutureWrapper<Client> send_circuit(const std::string& circuit);
     FutureWrapper<Client> send_parameters(const std::string& parameters);
+    FutureWrapper<Client> send_status();
+    // Empty options keep the queued tasks; {"reject": true} answers them as unavailable instead,
+    // and {"exit": true} makes the vQPU deregister and leave once it has nothing left
+    FutureWrapper<Client> send_drain(const std::string& options = "");
     std::string recv_results();
+    std::string recv_results(const std::uint64_t request_id);
+    bool results_ready(const std::uint64_t request_id);
+    bool wait_results(const std::uint64_t request_id, const std::chrono::milliseconds timeout);
+    std::string partial_results(const std::uint64_t request_id);
+    void stop(const std::uint64_t request_id);
+    void cancel(const std::uint64_t request_id);
     void disconnect(const std::string& endpoint = "");
 
 private:
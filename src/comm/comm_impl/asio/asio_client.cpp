@@ -1,9 +1,16 @@
 
 #include <boost/asio.hpp>
+#include <poll.h>
 #include <iostream>
 #include <string>
+#include <mutex>
+#include <chrono>
+#include <array>
+#include <optional>
 
 #include "comm/client.hpp"
+#include "comm/request.hpp"
+#include "asio_frames.hpp"
 #include "logger.hpp"
 #include "utils/helpers/net_functions.hpp"
 
@@ -43,6 +50,8 @@ struct Client::Impl {
             tcp::resolver resolver{io_context_};
             auto boost_endpoint = resolver.resolve(ip, port);
             as::connect(socket_, boost_endpoint);
+            // The parameter updates are small messages that would otherwise wait for the ACK of the last one
+            socket_.set_option(tcp::no_delay(true));
             LOGGER_DEBUG("Client succesfully connected to endpoint {}", endpoint);
         } catch (const boost::system::system_error& e) {
             LOGGER_ERROR("Imposible to connect to endpoint {}. Server not available.", endpoint);
@@ -56,8 +65,9 @@ struct Client::Impl {
         auto data_length_network = htonl(data_length);
 
         try {
-            as::write(socket_, as::buffer(&data_length_network, sizeof(data_length_network))); 
-            as::write(socket_, as::buffer(data));
+            // Length and data in a single system call
+            const std::array<as::const_buffer, 2> buffers = {as::buffer(&data_length_network, sizeof(data_length_network)), as::buffer(data)};
+            as::write(socket_, buffers);
             LOGGER_DEBUG("Message sent.");
         } catch (const boost::system::system_error& e) {
             LOGGER_ERROR("Error sending the circuit.");
@@ -67,15 +77,13 @@ struct Client::Impl {
 
     std::string recv() 
     {
+        std::lock_guard lock(recv_mutex_);
         try {
-            uint32_t result_length_network;
-            as::read(socket_, as::buffer(&result_length_network, sizeof(result_length_network)));
-            uint32_t result_length = ntohl(result_length_network);
-
-            std::string result(result_length, '\0');
-            as::read(socket_, as::buffer(&result[0], result_length));
-            LOGGER_DEBUG("Result received: {}", result);
-            return result;
+            std::optional<std::string> result;
+            while (!(result = frames_.next()))
+                frames_.received(socket_.read_some(frames_.free_space()));
+            LOGGER_DEBUG("Result received: {}", *result);
+            return *result;
         } catch (const boost::system::system_error& e) {
             LOGGER_ERROR("Error receiving the circuit: {} (HINT: Check the circuit format and/or if QPUs are still up working.)", e.code().message());
         }
@@ -83,14 +91,34 @@ struct Client::Impl {
         return std::string("{}");
     }
 
+    // Results come in order, so the next one is ready once some of it has arrived
+    bool wait(const std::chrono::milliseconds timeout)
+    {
+        std::lock_guard lock(recv_mutex_);
+        try {
+            if (frames_.pending() || socket_.available() > 0)
+                return true;
+            pollfd fd{socket_.native_handle(), POLLIN, 0};
+            return ::poll(&fd, 1, static_cast<int>(timeout.count())) > 0;
+        } catch (const boost::system::system_error&) {
+            return true; // recv reports the error
+        }
+    }
+
     void disconnect()
     {
         socket_.close(); // Only a unique server per client
         socket_ = tcp::socket(socket_.get_executor());
+        frames_.clear();
     }
+
+private:
+    std::mutex recv_mutex_;
+    FrameBuffer frames_;
 };
 
-Client::Client() :
+// A socket per server, so there is nothing to multiplex
+Client::Client(const bool) :
     pimpl_{std::make_unique<Impl>()}
 { }
 
@@ -100,22 +128,56 @@ void Client::connect(const std::string& endpoint) {
     pimpl_->connect(endpoint);
 }
 
+// Asio results arrive in the same order the requests were sent, so no header travels with them
 FutureWrapper<Client> Client::send_circuit(const std::string& circuit) 
 { 
     pimpl_->send(circuit);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, RequestHeader::NO_REQUEST_ID); 
 }
 
 FutureWrapper<Client> Client::send_parameters(const std::string& parameters) 
 { 
     pimpl_->send(parameters);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, RequestHeader::NO_REQUEST_ID); 
+}
+
+// The status would arrive ahead of the results of the tasks queued, which Asio clients expect
+// in the order they sent them
+FutureWrapper<Client> Client::send_status() 
+{ 
+    throw std::runtime_error("Status queries are only supported with the ZMQ communications.");
+}
+
+FutureWrapper<Client> Client::send_drain(const std::string& options) 
+{ 
+    throw std::runtime_error("Draining is only supported with the ZMQ communications.");
 }
 
 std::string Client::recv_results() {
     return pimpl_->recv();
 }
 
+std::string Client::recv_results([[maybe_unused]] const std::uint64_t request_id) {
+    return pimpl_->recv();
+}
+
+bool Client::results_ready([[maybe_unused]] const std::uint64_t request_id) {
+    return pimpl_->wait(std::chrono::milliseconds{0});
+}
+
+bool Client::wait_results([[maybe_unused]] const std::uint64_t request_id, const std::chrono::milliseconds timeout) {
+    return pimpl_->wait(timeout);
+}
+
+// The Asio server sends no partial results, nor can it be interrupted
+std::string Client::partial_results([[maybe_unused]] const std::uint64_t request_id) {
+    return std::string();
+}
+
+void Client::stop([[maybe_unused]] const std::uint64_t request_id) { }
+
+void Client::cancel([[maybe_unused]] const std::uint64_t request_id) { }
+
 void Client::disconnect(const std::string& endpoint) {
     pimpl_->disconnect();
 }
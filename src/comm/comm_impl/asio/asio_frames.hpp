@@ -0,0 +1,75 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <arpa/inet.h>
+
+namespace cunqa {
+namespace comm {
+
+// Bytes received on a connection, holding the frames of a 4-byte length in network order and
+// its data. Each read takes as much as the socket has into the free space, so a small frame
+// comes with its length in a single read. The buffer grows to the largest frame and is reused
+class FrameBuffer {
+public:
+    static constexpr std::size_t MIN_READ = 64 * 1024;
+
+    // Room for at least MIN_READ more bytes, or for the rest of the frame being received
+    boost::asio::mutable_buffer free_space()
+    {
+        if (begin_ > 0) {
+            std::memmove(bytes_.data(), bytes_.data() + begin_, end_ - begin_);
+            end_ -= begin_;
+            begin_ = 0;
+        }
+        std::size_t needed = end_ + MIN_READ;
+        if (end_ >= sizeof(std::uint32_t))
+            needed = std::max<std::size_t>(needed, sizeof(std::uint32_t) + length_());
+        if (bytes_.size() < needed)
+            bytes_.resize(needed);
+        return boost::asio::buffer(bytes_.data() + end_, bytes_.size() - end_);
+    }
+
+    void received(const std::size_t n) { end_ += n; }
+
+    // Next complete frame, if any
+    std::optional<std::string> next()
+    {
+        if (end_ - begin_ < sizeof(std::uint32_t))
+            return std::nullopt;
+        const std::size_t length = length_();
+        if (end_ - begin_ - sizeof(std::uint32_t) < length)
+            return std::nullopt;
+
+        std::string frame(bytes_.data() + begin_ + sizeof(std::uint32_t), length);
+        begin_ += sizeof(std::uint32_t) + length;
+        if (begin_ == end_)
+            begin_ = end_ = 0;
+        return frame;
+    }
+
+    // Whether part of a frame is waiting to be taken
+    bool pending() const { return end_ > begin_; }
+
+    void clear() { begin_ = end_ = 0; }
+
+private:
+    std::vector<char> bytes_;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+
+    std::uint32_t length_() const
+    {
+        std::uint32_t length_network;
+        std::memcpy(&length_network, bytes_.data() + begin_, sizeof(length_network));
+        return ntohl(length_network);
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
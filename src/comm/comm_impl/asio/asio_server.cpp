@@ -1,8 +1,16 @@
 #include <boost/asio.hpp>
 #include <iostream>
 #include <string>
+#include <mutex>
+#include <deque>
+#include <array>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <unordered_map>
 
 #include "comm/server.hpp"
+#include "asio_frames.hpp"
 #include "logger.hpp"
 #include "utils/helpers/net_functions.hpp"
 #include "utils/constants.hpp"
@@ -15,106 +23,258 @@ namespace cunqa {
 namespace comm {
 
 struct Server::Impl {
+
+    // Length, in network order, and data of a result, written together with a single gather write
+    struct Framed {
+        std::uint32_t length_network;
+        std::string data;
+    };
+
+    // Connection of a client, identified by the server with the number of its connection. Its
+    // frames are read into a buffer of its own, and its results are written in order from the
+    // strand of the connection, so no two writes overlap
+    struct Connection : std::enable_shared_from_this<Connection> {
+        Impl& server;
+        tcp::socket socket;
+        as::strand<as::io_context::executor_type> strand;
+        std::string id;
+        FrameBuffer frames;
+        std::deque<Framed> results; // The first one is being written
+
+        Connection(Impl& server, tcp::socket socket, const std::string& id) :
+            server{server},
+            socket{std::move(socket)},
+            strand{as::make_strand(server.io_context_)},
+            id{id}
+        { }
+
+        void read()
+        {
+            socket.async_read_some(frames.free_space(), as::bind_executor(strand,
+                [self = shared_from_this()](const boost::system::error_code& error, const std::size_t n) {
+                    if (error)
+                        return self->closed(error);
+                    const auto arrived = std::chrono::steady_clock::now();
+                    self->frames.received(n);
+                    while (auto frame = self->frames.next())
+                        self->server.push({self->id, RequestHeader{}, std::move(*frame), arrived});
+                    self->read();
+                }));
+        }
+
+        // The QPU learns that the client left as if it had sent a "CLOSE"
+        void closed(const boost::system::error_code& error)
+        {
+            if (error == as::error::eof)
+                LOGGER_DEBUG("Client {} disconnected gracefully.", id);
+            else if (error != as::error::operation_aborted)
+                LOGGER_ERROR("Client {} connection lost: {}", id, error.message());
+            boost::system::error_code ignored;
+            socket.close(ignored);
+            server.forget(id);
+            server.push({id, RequestHeader{}, "CLOSE"s});
+        }
+
+        void send(Framed result)
+        {
+            as::post(strand, [self = shared_from_this(), result = std::move(result)]() mutable {
+                self->results.push_back(std::move(result));
+                if (self->results.size() == 1)
+                    self->write();
+            });
+        }
+
+        void write()
+        {
+            const Framed& result = results.front();
+            const std::array<as::const_buffer, 2> buffers = {as::buffer(&result.length_network, sizeof(result.length_network)), as::buffer(result.data)};
+            as::async_write(socket, buffers, as::bind_executor(strand,
+                [self = shared_from_this()](const boost::system::error_code& error, std::size_t) {
+                    if (error) {
+                        LOGGER_ERROR("Error sending the result to client {}: {}", self->id, error.message());
+                        self->results.clear();
+                        return;
+                    }
+                    self->results.pop_front();
+                    if (!self->results.empty())
+                        self->write();
+                }));
+        }
+    };
+
     as::io_context io_context_;
+    as::executor_work_guard<as::io_context::executor_type> work_;
     tcp::acceptor acceptor_;
-    tcp::socket socket_;
+    std::thread io_thread_;
+    bool accepting_ = false;
+    std::size_t n_connections_ = 0;
+
+    std::mutex connections_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Connection>> connections_;
+
+    std::mutex received_mutex_;
+    std::condition_variable received_condition_;
+    std::deque<ServerMessage> received_;
 
     std::string asio_endpoint;
 
     Impl(const std::string& ip) :
-        acceptor_{io_context_, tcp::endpoint{as::ip::address::from_string(ip), 0}},
-        socket_{acceptor_.get_executor()}
-    { 
+        work_{as::make_work_guard(io_context_)},
+        acceptor_{io_context_, tcp::endpoint{as::ip::make_address(ip), 0}}
+    {
         auto ep = acceptor_.local_endpoint();
         auto port = ep.port();
-        asio_endpoint = ip + ":" + std::to_string(port);  
+        asio_endpoint = ip + ":" + std::to_string(port);
+        io_thread_ = std::thread([this]() { io_context_.run(); });
+    }
+
+    ~Impl()
+    {
+        close();
     }
 
+    // The clients are accepted in the background from the first call on
     void accept()
     {
-        acceptor_.accept(socket_);
+        as::post(acceptor_.get_executor(), [this]() {
+            if (accepting_)
+                return;
+            accepting_ = true;
+            accept_next();
+        });
     }
 
-    std::string recv() 
+    void accept_next()
     {
-        try {
-            uint32_t data_length_network;
-            as::read(socket_, as::buffer(&data_length_network, sizeof(data_length_network)));
-            
-            uint32_t data_length = ntohl(data_length_network);
-            std::string data(data_length, '\0');
-            as::read(socket_, as::buffer(&data[0], data_length));
-            return data;
-        } catch (const boost::system::system_error& e) {
-            if (e.code() == boost::asio::error::eof) {
-                // Client closed the connection cleanly
-                LOGGER_DEBUG("Client disconnected gracefully.");
-                socket_.close(); 
-                return "CLOSE";
-            } else if (e.code() == boost::asio::error::connection_reset) {
-                LOGGER_ERROR("Client connection reset (forcible close).");
-                socket_.close(); 
-                return "CLOSE";
+        acceptor_.async_accept([this](const boost::system::error_code& error, tcp::socket socket) {
+            if (error == as::error::operation_aborted)
+                return;
+            if (error) {
+                LOGGER_ERROR("Error accepting a client: {}", error.message());
             } else {
-                LOGGER_ERROR("Error receiving the circuit.");
-                throw;
+                // The small messages of the parameter updates go out at once
+                boost::system::error_code ignored;
+                socket.set_option(tcp::no_delay(true), ignored);
+                const std::string id = "asio-" + std::to_string(n_connections_++);
+                auto connection = std::make_shared<Connection>(*this, std::move(socket), id);
+                {
+                    std::lock_guard lock(connections_mutex_);
+                    connections_[id] = connection;
+                }
+                LOGGER_DEBUG("Client {} connected.", id);
+                as::dispatch(connection->strand, [connection]() { connection->read(); });
             }
+            accept_next();
+        });
+    }
+
+    void push(ServerMessage message)
+    {
+        {
+            std::lock_guard lock(received_mutex_);
+            received_.push_back(std::move(message));
         }
+        received_condition_.notify_one();
+    }
 
-        return std::string();
+    void forget(const std::string& id)
+    {
+        std::lock_guard lock(connections_mutex_);
+        connections_.erase(id);
     }
 
-    void send(const std::string& result) 
+    ServerMessage recv()
     {
-        try {    
-            auto data_length = legacy_size_cast<uint32_t, std::size_t>(result.size());
-            auto data_length_network = htonl(data_length);
-
-            as::write(socket_, as::buffer(&data_length_network, sizeof(data_length_network))); 
-            as::write(socket_, as::buffer(result));
-        } catch (const boost::system::system_error& e) {
-            LOGGER_ERROR("Error sending the result.");
-            throw;
+        std::unique_lock lock(received_mutex_);
+        received_condition_.wait(lock, [this]() { return !received_.empty(); });
+        ServerMessage message = std::move(received_.front());
+        received_.pop_front();
+        return message;
+    }
+
+    void send(const std::string& result, const std::string& client_id)
+    {
+        std::shared_ptr<Connection> connection;
+        {
+            std::lock_guard lock(connections_mutex_);
+            auto found = connections_.find(client_id);
+            if (found != connections_.end())
+                connection = found->second;
+        }
+        if (!connection) {
+            LOGGER_DEBUG("Client {} left before its result was sent.", client_id);
+            return;
         }
+
+        auto data_length = legacy_size_cast<uint32_t, std::size_t>(result.size());
+        connection->send({htonl(data_length), result});
     }
 
     void close()
     {
-        this->socket_.close();
+        if (!io_thread_.joinable())
+            return;
+        as::post(acceptor_.get_executor(), [this]() {
+            boost::system::error_code ignored;
+            acceptor_.close(ignored);
+        });
+        {
+            std::lock_guard lock(connections_mutex_);
+            for (auto& [id, connection] : connections_)
+                as::post(connection->strand, [connection]() {
+                    boost::system::error_code ignored;
+                    connection->socket.close(ignored);
+                });
+        }
+        work_.reset();
+        io_context_.stop();
+        io_thread_.join();
+        std::lock_guard lock(connections_mutex_);
+        connections_.clear();
     }
 };
 
 Server::Server(const std::string& mode) :
     mode{mode},
     nodename{get_nodename()},
-    gpu{get_associated_gpu()},
+    device(get_device()),
     pimpl_{std::make_unique<Impl>(mode == "hpc" ? "127.0.0.1" : get_IP_address())}
-{ 
+{
     endpoint = pimpl_->asio_endpoint;
 }
 
 Server::~Server() = default;
 
-void Server::accept() 
+void Server::accept()
 {
     pimpl_->accept();
 }
 
-std::string Server::recv_data() 
-{ 
+// Each client has a connection of its own, whose number identifies it
+ServerMessage Server::recv_data()
+{
     return pimpl_->recv();
 }
 
-void Server::send_result(const std::string& result) 
-{ 
+void Server::send_result(const std::string& result, const ServerMessage& reply_to)
+{
     try {
-        pimpl_->send(result);
+        pimpl_->send(result, reply_to.client_id);
     } catch (const std::exception& e) {
         throw ServerException(e.what());
     }
 }
 
-void Server::close() 
+void Server::send_result(std::string&& result, const ServerMessage& reply_to)
+{
+    send_result(static_cast<const std::string&>(result), reply_to);
+}
+
+// Asio results carry no header, so the client could not tell a partial result from the final one
+void Server::send_partial_result([[maybe_unused]] const std::string& result, [[maybe_unused]] const ServerMessage& reply_to)
+{ }
+
+void Server::close()
 {
     pimpl_->close();
 }
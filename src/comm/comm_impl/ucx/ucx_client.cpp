@@ -0,0 +1,174 @@
+#include <string>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <condition_variable>
+
+#include "comm/client.hpp"
+#include "comm/request.hpp"
+#include "ucx_worker.hpp"
+#include "logger.hpp"
+
+using namespace std::string_literals;
+
+namespace cunqa {
+namespace comm {
+
+struct Client::Impl {
+    std::mutex results_mutex_;
+    std::condition_variable results_condition_;
+    std::deque<std::string> results_;
+    bool connected_ = false;
+
+    // After the state that its callbacks use
+    UcxWorker<std::string> worker_;
+    ucp_ep_h ep_ = nullptr;
+
+    Impl() :
+        worker_{[this](std::string, std::string result, ucp_ep_h) { push_(std::move(result)); }}
+    { }
+
+    ~Impl()
+    {
+        disconnect();
+    }
+
+    void connect(const std::string& endpoint)
+    {
+        try {
+            auto pos = endpoint.rfind(':');
+            const std::string ip = endpoint.substr(0, pos);
+            const auto port = static_cast<std::uint16_t>(std::stoi(endpoint.substr(pos + 1)));
+            ep_ = worker_.connect(ip, port);
+            std::lock_guard lock(results_mutex_);
+            connected_ = true;
+            LOGGER_DEBUG("Client succesfully connected to endpoint {}", endpoint);
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Imposible to connect to endpoint {}. Server not available.", endpoint);
+            throw;
+        }
+    }
+
+    // The server answers through the endpoint that the message comes with
+    void send(const std::string& data)
+    {
+        try {
+            worker_.send(ep_, {}, data.data(), data.size(), true);
+            LOGGER_DEBUG("Message sent.");
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Error sending the circuit: {}", e.what());
+        }
+    }
+
+    std::string recv()
+    {
+        std::unique_lock lock(results_mutex_);
+        results_condition_.wait(lock, [this]() { return !results_.empty() || !connected_; });
+        if (results_.empty()) {
+            LOGGER_ERROR("Error receiving the circuit: not connected (HINT: Check the circuit format and/or if QPUs are still up working.)");
+            return std::string("{}");
+        }
+        std::string result = std::move(results_.front());
+        results_.pop_front();
+        LOGGER_DEBUG("Result received: {}", result);
+        return result;
+    }
+
+    // Results come in order, so the next one is ready once it has arrived
+    bool wait(const std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock(results_mutex_);
+        return results_condition_.wait_for(lock, timeout, [this]() { return !results_.empty() || !connected_; });
+    }
+
+    void disconnect()
+    {
+        if (ep_) {
+            worker_.close(ep_); // Only a unique server per client
+            ep_ = nullptr;
+        }
+        {
+            std::lock_guard lock(results_mutex_);
+            results_.clear();
+            connected_ = false;
+        }
+        results_condition_.notify_all();
+    }
+
+private:
+    void push_(std::string result)
+    {
+        {
+            std::lock_guard lock(results_mutex_);
+            results_.push_back(std::move(result));
+        }
+        results_condition_.notify_all();
+    }
+};
+
+// An endpoint per server, so there is nothing to multiplex
+Client::Client(const bool) :
+    pimpl_{std::make_unique<Impl>()}
+{ }
+
+Client::~Client() = default;
+
+void Client::connect(const std::string& endpoint) {
+    pimpl_->connect(endpoint);
+}
+
+// UCX results arrive in the same order the requests were sent, so no header travels with them
+FutureWrapper<Client> Client::send_circuit(const std::string& circuit)
+{
+    pimpl_->send(circuit);
+    return FutureWrapper<Client>(this, RequestHeader::NO_REQUEST_ID);
+}
+
+FutureWrapper<Client> Client::send_parameters(const std::string& parameters)
+{
+    pimpl_->send(parameters);
+    return FutureWrapper<Client>(this, RequestHeader::NO_REQUEST_ID);
+}
+
+// As with Asio, the status would arrive ahead of the results of the tasks queued
+FutureWrapper<Client> Client::send_status()
+{
+    throw std::runtime_error("Status queries are only supported with the ZMQ communications.");
+}
+
+FutureWrapper<Client> Client::send_drain(const std::string& options)
+{
+    throw std::runtime_error("Draining is only supported with the ZMQ communications.");
+}
+
+std::string Client::recv_results() {
+    return pimpl_->recv();
+}
+
+std::string Client::recv_results([[maybe_unused]] const std::uint64_t request_id) {
+    return pimpl_->recv();
+}
+
+bool Client::results_ready([[maybe_unused]] const std::uint64_t request_id) {
+    return pimpl_->wait(std::chrono::milliseconds{0});
+}
+
+bool Client::wait_results([[maybe_unused]] const std::uint64_t request_id, const std::chrono::milliseconds timeout) {
+    return pimpl_->wait(timeout);
+}
+
+// The UCX server sends no partial results, nor can it be interrupted
+std::string Client::partial_results([[maybe_unused]] const std::uint64_t request_id) {
+    return std::string();
+}
+
+void Client::stop([[maybe_unused]] const std::uint64_t request_id) { }
+
+void Client::cancel([[maybe_unused]] const std::uint64_t request_id) { }
+
+void Client::disconnect([[maybe_unused]] const std::string& endpoint) {
+    pimpl_->disconnect();
+}
+
+} // End of comm namespace
+} // End of cunqa namespace
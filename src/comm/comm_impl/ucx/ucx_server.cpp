@@ -0,0 +1,168 @@
+#include <string>
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <unordered_map>
+
+#include "comm/server.hpp"
+#include "ucx_worker.hpp"
+#include "logger.hpp"
+#include "utils/helpers/net_functions.hpp"
+
+using namespace std::string_literals;
+
+namespace cunqa {
+namespace comm {
+
+// Each client connects to the listener of the vQPU with an endpoint of its own, whose number
+// identifies it. Its messages come with the endpoint to reply through, and the large circuits
+// and results go by rendezvous, without copies through the kernel
+struct Server::Impl {
+    std::mutex clients_mutex_;
+    std::unordered_map<ucp_ep_h, std::string> client_ids_;
+    std::unordered_map<std::string, ucp_ep_h> client_eps_;
+    std::size_t n_clients_ = 0;
+
+    std::mutex received_mutex_;
+    std::condition_variable received_condition_;
+    std::deque<ServerMessage> received_;
+
+    // After the state that its callbacks use
+    UcxWorker<std::string> worker_;
+    std::string ucx_endpoint;
+
+    Impl(const std::string& ip) :
+        worker_{[this](std::string, std::string data, ucp_ep_h reply_ep) { on_message_(std::move(data), reply_ep); }}
+    {
+        const auto port = worker_.listen(ip, [this](ucp_ep_h ep) { id_of_(ep); },
+                                             [this](ucp_ep_h ep) { on_disconnect_(ep); });
+        ucx_endpoint = ip + ":" + std::to_string(port);
+    }
+
+    ~Impl()
+    {
+        std::lock_guard lock(clients_mutex_);
+        for (auto& [ep, id] : client_ids_)
+            worker_.drop(ep);
+    }
+
+    ServerMessage recv()
+    {
+        std::unique_lock lock(received_mutex_);
+        received_condition_.wait(lock, [this]() { return !received_.empty(); });
+        ServerMessage message = std::move(received_.front());
+        received_.pop_front();
+        return message;
+    }
+
+    void send(const std::string& result, const std::string& client_id)
+    {
+        ucp_ep_h ep;
+        {
+            std::lock_guard lock(clients_mutex_);
+            auto found = client_eps_.find(client_id);
+            if (found == client_eps_.end()) {
+                LOGGER_DEBUG("Client {} left before its result was sent.", client_id);
+                return;
+            }
+            ep = found->second;
+        }
+        worker_.send(ep, {}, result.data(), result.size());
+    }
+
+private:
+    // Ids are given as the clients connect, or as their first message arrives
+    std::string id_of_(ucp_ep_h ep)
+    {
+        std::lock_guard lock(clients_mutex_);
+        auto [id, inserted] = client_ids_.try_emplace(ep);
+        if (inserted) {
+            id->second = "ucx-" + std::to_string(n_clients_++);
+            client_eps_[id->second] = ep;
+            LOGGER_DEBUG("Client {} connected.", id->second);
+        }
+        return id->second;
+    }
+
+    void push_(ServerMessage message)
+    {
+        {
+            std::lock_guard lock(received_mutex_);
+            received_.push_back(std::move(message));
+        }
+        received_condition_.notify_one();
+    }
+
+    void on_message_(std::string data, ucp_ep_h reply_ep)
+    {
+        if (!reply_ep) {
+            LOGGER_ERROR("Message of a client that cannot be answered, dropped.");
+            return;
+        }
+        push_({id_of_(reply_ep), RequestHeader{}, std::move(data), std::chrono::steady_clock::now()});
+    }
+
+    // The QPU learns that the client left as if it had sent a "CLOSE"
+    void on_disconnect_(ucp_ep_h ep)
+    {
+        std::string id;
+        {
+            std::lock_guard lock(clients_mutex_);
+            auto found = client_ids_.find(ep);
+            if (found == client_ids_.end())
+                return;
+            id = std::move(found->second);
+            client_ids_.erase(found);
+            client_eps_.erase(id);
+        }
+        LOGGER_DEBUG("Client {} disconnected.", id);
+        worker_.drop(ep);
+        push_({id, RequestHeader{}, "CLOSE"s});
+    }
+};
+
+Server::Server(const std::string& mode) :
+    mode{mode},
+    nodename{get_nodename()},
+    device(get_device()),
+    pimpl_{std::make_unique<Impl>(mode == "hpc" ? "127.0.0.1" : get_IP_address())}
+{
+    endpoint = pimpl_->ucx_endpoint;
+}
+
+Server::~Server() = default;
+
+// The listener accepts the clients from the start
+void Server::accept()
+{ }
+
+ServerMessage Server::recv_data()
+{
+    return pimpl_->recv();
+}
+
+void Server::send_result(const std::string& result, const ServerMessage& reply_to)
+{
+    try {
+        pimpl_->send(result, reply_to.client_id);
+    } catch (const std::exception& e) {
+        throw ServerException(e.what());
+    }
+}
+
+void Server::send_result(std::string&& result, const ServerMessage& reply_to)
+{
+    send_result(static_cast<const std::string&>(result), reply_to);
+}
+
+// As with Asio, the results carry no header to tell a partial result from the final one
+void Server::send_partial_result([[maybe_unused]] const std::string& result, [[maybe_unused]] const ServerMessage& reply_to)
+{ }
+
+void Server::close()
+{
+    pimpl_.reset();
+}
+
+} // End of comm namespace
+} // End of cunqa namespace
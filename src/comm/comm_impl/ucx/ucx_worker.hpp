@@ -0,0 +1,352 @@
+#pragma once
+
+#include <ucp/api/ucp.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+#include "logger.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Payloads from which the messages go by rendezvous: the receiver fetches them with RDMA from
+// the buffer of the sender, registered by UCX, straight into the buffer it hands to its handler
+constexpr std::size_t UCX_ZERO_COPY_THRESHOLD = 64 * 1024;
+
+// UCP context and worker of one side of a connection, with a thread that progresses it. Every
+// message is an active message whose header tells who sends it, and the handler gets it, from
+// the progress thread, in a Message of its own: a std::string or anything built from its size
+// that exposes data(), as a zmq::message_t
+template <typename Message>
+class UcxWorker {
+public:
+    // Header and message, and the endpoint to answer through if the sender asked for one
+    using Handler = std::function<void(std::string, Message, ucp_ep_h)>;
+    // New endpoints of a listener, and the endpoints whose peer left or failed
+    using EndpointHandler = std::function<void(ucp_ep_h)>;
+
+    explicit UcxWorker(Handler handler) : handler_{std::move(handler)}
+    {
+        ucp_params_t params{};
+        params.field_mask = UCP_PARAM_FIELD_FEATURES;
+        params.features = UCP_FEATURE_AM | UCP_FEATURE_WAKEUP;
+        ucp_config_t* config;
+        check_(ucp_config_read(nullptr, nullptr, &config), "read its configuration");
+        const ucs_status_t status = ucp_init(&params, config, &context_);
+        ucp_config_release(config);
+        check_(status, "initialize");
+
+        ucp_worker_params_t worker_params{};
+        worker_params.field_mask = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+        worker_params.thread_mode = UCS_THREAD_MODE_MULTI;
+        if (const ucs_status_t created = ucp_worker_create(context_, &worker_params, &worker_); created != UCS_OK) {
+            ucp_cleanup(context_);
+            check_(created, "create a worker");
+        }
+
+        ucp_am_handler_param_t am_params{};
+        am_params.field_mask = UCP_AM_HANDLER_PARAM_FIELD_ID | UCP_AM_HANDLER_PARAM_FIELD_CB |
+                               UCP_AM_HANDLER_PARAM_FIELD_ARG | UCP_AM_HANDLER_PARAM_FIELD_FLAGS;
+        am_params.id = AM_ID;
+        am_params.cb = &UcxWorker::on_message_;
+        am_params.arg = this;
+        am_params.flags = UCP_AM_FLAG_WHOLE_MSG;
+        check_(ucp_worker_set_am_recv_handler(worker_, &am_params), "set the message handler");
+
+        progress_thread_ = std::thread([this]() { progress_(); });
+    }
+
+    // The endpoints have to be closed before
+    ~UcxWorker()
+    {
+        stopping_ = true;
+        ucp_worker_signal(worker_);
+        progress_thread_.join();
+        if (listener_)
+            ucp_listener_destroy(listener_);
+        ucp_worker_destroy(worker_);
+        ucp_cleanup(context_);
+    }
+
+    UcxWorker(const UcxWorker&) = delete;
+    UcxWorker& operator=(const UcxWorker&) = delete;
+
+    // Accepts the clients that connect to the address, and returns the port it listens on
+    std::uint16_t listen(const std::string& ip, EndpointHandler on_connect, EndpointHandler on_disconnect)
+    {
+        on_connect_ = std::move(on_connect);
+        on_disconnect_ = std::move(on_disconnect);
+
+        sockaddr_in address = socket_address_(ip, 0);
+        ucp_listener_params_t params{};
+        params.field_mask = UCP_LISTENER_PARAM_FIELD_SOCK_ADDR | UCP_LISTENER_PARAM_FIELD_CONN_HANDLER;
+        params.sockaddr.addr = reinterpret_cast<const sockaddr*>(&address);
+        params.sockaddr.addrlen = sizeof(address);
+        params.conn_handler.cb = &UcxWorker::on_connection_;
+        params.conn_handler.arg = this;
+        check_(ucp_listener_create(worker_, &params, &listener_), "listen on " + ip);
+
+        ucp_listener_attr_t attributes{};
+        attributes.field_mask = UCP_LISTENER_ATTR_FIELD_SOCKADDR;
+        check_(ucp_listener_query(listener_, &attributes), "query the listener");
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&attributes.sockaddr)->sin_port);
+    }
+
+    // Endpoint to the listener of a server
+    ucp_ep_h connect(const std::string& ip, const std::uint16_t port)
+    {
+        sockaddr_in address = socket_address_(ip, port);
+        ucp_ep_params_t params{};
+        params.field_mask = UCP_EP_PARAM_FIELD_FLAGS | UCP_EP_PARAM_FIELD_SOCK_ADDR |
+                            UCP_EP_PARAM_FIELD_ERR_HANDLER | UCP_EP_PARAM_FIELD_ERR_HANDLING_MODE;
+        params.flags = UCP_EP_PARAMS_FLAGS_CLIENT_SERVER;
+        params.sockaddr.addr = reinterpret_cast<const sockaddr*>(&address);
+        params.sockaddr.addrlen = sizeof(address);
+        params.err_mode = UCP_ERR_HANDLING_MODE_PEER;
+        params.err_handler.cb = &UcxWorker::on_error_;
+        params.err_handler.arg = this;
+
+        ucp_ep_h ep;
+        check_(ucp_ep_create(worker_, &params, &ep), "connect to " + ip + ":" + std::to_string(port));
+        return ep;
+    }
+
+    // Endpoint to the worker of a peer, from the address that it published
+    ucp_ep_h connect(const std::string& worker_address)
+    {
+        const std::vector<std::uint8_t> bytes = from_hex_(worker_address);
+        ucp_ep_params_t params{};
+        params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS | UCP_EP_PARAM_FIELD_ERR_HANDLER |
+                            UCP_EP_PARAM_FIELD_ERR_HANDLING_MODE;
+        params.address = reinterpret_cast<const ucp_address_t*>(bytes.data());
+        params.err_mode = UCP_ERR_HANDLING_MODE_PEER;
+        params.err_handler.cb = &UcxWorker::on_error_;
+        params.err_handler.arg = this;
+
+        ucp_ep_h ep;
+        check_(ucp_ep_create(worker_, &params, &ep), "connect to a peer worker");
+        return ep;
+    }
+
+    // Address of the worker for the peers to connect to, in hexadecimal
+    std::string address() const
+    {
+        ucp_address_t* address;
+        std::size_t length;
+        check_(ucp_worker_get_address(worker_, &address, &length), "get the worker address");
+        std::string hex;
+        hex.reserve(2 * length);
+        for (std::size_t i = 0; i < length; i++) {
+            constexpr char DIGITS[] = "0123456789abcdef";
+            const auto byte = reinterpret_cast<const std::uint8_t*>(address)[i];
+            hex += DIGITS[byte >> 4];
+            hex += DIGITS[byte & 0xf];
+        }
+        ucp_worker_release_address(worker_, address);
+        return hex;
+    }
+
+    // Returns once the data can be reused, so it is sent from where it is
+    void send(ucp_ep_h ep, std::string_view header, const void* data, const std::size_t length, const bool ask_reply = false)
+    {
+        ucp_request_param_t params{};
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_FLAGS;
+        params.flags = 0;
+        if (ask_reply)
+            params.flags |= UCP_AM_SEND_FLAG_REPLY;
+        if (length >= UCX_ZERO_COPY_THRESHOLD)
+            params.flags |= UCP_AM_SEND_FLAG_RNDV;
+        wait_(ucp_am_send_nbx(ep, AM_ID, header.data(), header.size(), data, length, &params), "send a message");
+    }
+
+    // Flushes what was sent through the endpoint before closing it
+    void close(ucp_ep_h ep)
+    {
+        ucp_request_param_t params{};
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_FLAGS;
+        params.flags = 0;
+        try {
+            wait_(ucp_ep_close_nbx(ep, &params), "close an endpoint");
+        } catch (const std::exception& e) {
+            LOGGER_DEBUG("{}", e.what());
+        }
+    }
+
+    // Closes the endpoint of a peer that already failed, from the callbacks, which cannot wait
+    void drop(ucp_ep_h ep)
+    {
+        ucp_request_param_t params{};
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_FLAGS;
+        params.flags = UCP_EP_CLOSE_FLAG_FORCE;
+        void* request = ucp_ep_close_nbx(ep, &params);
+        if (UCS_PTR_IS_PTR(request))
+            ucp_request_free(request);
+    }
+
+private:
+    static constexpr unsigned AM_ID = 0;
+
+    // Message being fetched by rendezvous
+    struct PendingReceive {
+        UcxWorker* worker;
+        std::string header;
+        Message message;
+        ucp_ep_h reply_ep;
+    };
+
+    Handler handler_;
+    EndpointHandler on_connect_;
+    EndpointHandler on_disconnect_;
+    ucp_context_h context_ = nullptr;
+    ucp_worker_h worker_ = nullptr;
+    ucp_listener_h listener_ = nullptr;
+    std::atomic<bool> stopping_ = false;
+    std::thread progress_thread_;
+
+    static Message allocate_(const std::size_t length)
+    {
+        if constexpr (std::is_same_v<Message, std::string>)
+            return std::string(length, '\0');
+        else
+            return Message(length);
+    }
+
+    static void check_(const ucs_status_t status, const std::string& what)
+    {
+        if (status != UCS_OK)
+            throw std::runtime_error("UCX could not " + what + ": " + ucs_status_string(status));
+    }
+
+    static sockaddr_in socket_address_(const std::string& ip, const std::uint16_t port)
+    {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (inet_pton(AF_INET, ip.c_str(), &address.sin_addr) != 1)
+            throw std::runtime_error("UCX needs an IPv4 address, " + ip + " is not one.");
+        return address;
+    }
+
+    static std::vector<std::uint8_t> from_hex_(const std::string& hex)
+    {
+        std::vector<std::uint8_t> bytes(hex.size() / 2);
+        for (std::size_t i = 0; i < bytes.size(); i++)
+            bytes[i] = static_cast<std::uint8_t>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+        return bytes;
+    }
+
+    // The calling thread progresses the worker along with the progress thread until the request ends
+    void wait_(void* request, const std::string& what)
+    {
+        if (request == nullptr)
+            return;
+        if (UCS_PTR_IS_ERR(request))
+            check_(UCS_PTR_STATUS(request), what);
+
+        ucs_status_t status;
+        while ((status = ucp_request_check_status(request)) == UCS_INPROGRESS)
+            ucp_worker_progress(worker_);
+        ucp_request_free(request);
+        check_(status, what);
+    }
+
+    // Sleeps on the events of the worker between progresses, and ucp_worker_signal wakes it to stop
+    void progress_()
+    {
+        while (!stopping_) {
+            while (ucp_worker_progress(worker_) != 0) { }
+            const ucs_status_t status = ucp_worker_arm(worker_);
+            if (status == UCS_ERR_BUSY)
+                continue;
+            if (status != UCS_OK) {
+                LOGGER_ERROR("The UCX progress thread stopped: {}", ucs_status_string(status));
+                return;
+            }
+            ucp_worker_wait(worker_);
+        }
+    }
+
+    static ucs_status_t on_message_(void* arg, const void* header, std::size_t header_length, void* data,
+                                    std::size_t length, const ucp_am_recv_param_t* param)
+    {
+        auto* self = static_cast<UcxWorker*>(arg);
+        std::string origin(static_cast<const char*>(header), header_length);
+        ucp_ep_h reply_ep = (param->recv_attr & UCP_AM_RECV_ATTR_FIELD_REPLY_EP) ? param->reply_ep : nullptr;
+
+        if (!(param->recv_attr & UCP_AM_RECV_ATTR_FLAG_RNDV)) {
+            Message message = allocate_(length);
+            std::memcpy(message.data(), data, length);
+            self->handler_(std::move(origin), std::move(message), reply_ep);
+            return UCS_OK;
+        }
+
+        // The message is allocated in place before the fetch, so its data does not move
+        auto* pending = new PendingReceive{self, std::move(origin), allocate_(length), reply_ep};
+        ucp_request_param_t params{};
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA;
+        params.cb.recv_am = &UcxWorker::on_fetched_;
+        params.user_data = pending;
+        void* request = ucp_am_recv_data_nbx(self->worker_, data, pending->message.data(), length, &params);
+        if (UCS_PTR_IS_ERR(request)) {
+            LOGGER_ERROR("UCX could not fetch a message of {} bytes: {}", length, ucs_status_string(UCS_PTR_STATUS(request)));
+            delete pending;
+        } else if (request == nullptr) {
+            self->handler_(std::move(pending->header), std::move(pending->message), pending->reply_ep);
+            delete pending;
+        }
+        return UCS_OK;
+    }
+
+    static void on_fetched_(void* request, ucs_status_t status, std::size_t, void* user_data)
+    {
+        auto* pending = static_cast<PendingReceive*>(user_data);
+        if (status == UCS_OK)
+            pending->worker->handler_(std::move(pending->header), std::move(pending->message), pending->reply_ep);
+        else
+            LOGGER_ERROR("UCX could not fetch a message: {}", ucs_status_string(status));
+        delete pending;
+        ucp_request_free(request);
+    }
+
+    static void on_connection_(ucp_conn_request_h conn_request, void* arg)
+    {
+        auto* self = static_cast<UcxWorker*>(arg);
+        ucp_ep_params_t params{};
+        params.field_mask = UCP_EP_PARAM_FIELD_CONN_REQUEST | UCP_EP_PARAM_FIELD_ERR_HANDLER |
+                            UCP_EP_PARAM_FIELD_ERR_HANDLING_MODE;
+        params.conn_request = conn_request;
+        params.err_mode = UCP_ERR_HANDLING_MODE_PEER;
+        params.err_handler.cb = &UcxWorker::on_error_;
+        params.err_handler.arg = self;
+
+        ucp_ep_h ep;
+        if (const ucs_status_t status = ucp_ep_create(self->worker_, &params, &ep); status != UCS_OK) {
+            LOGGER_ERROR("UCX could not accept a client: {}", ucs_status_string(status));
+            return;
+        }
+        if (self->on_connect_)
+            self->on_connect_(ep);
+    }
+
+    static void on_error_(void* arg, ucp_ep_h ep, ucs_status_t status)
+    {
+        auto* self = static_cast<UcxWorker*>(arg);
+        LOGGER_DEBUG("UCX endpoint closed: {}", ucs_status_string(status));
+        if (self->on_disconnect_)
+            self->on_disconnect_(ep);
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
@@ -1,78 +1,571 @@
 #include "zmq.hpp"
 #include <iostream>
 #include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <cerrno>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <condition_variable>
 
 #include "comm/client.hpp"
+#include "comm/request.hpp"
+#include "comm/compression.hpp"
 #include "logger.hpp"
 
 
-namespace cunqa {
-namespace comm {
-    
-struct Client::Impl {
-    Impl() :
-        socket_{context_, zmq::socket_type::dealer}
-    { }
+namespace {
+using namespace cunqa;
+using namespace cunqa::comm;
 
-    ~Impl() 
+// One context, and so one ZMQ IO thread, for all the clients of the process. It is never
+// destroyed, so a client still alive at exit does not block the termination
+zmq::context_t& shared_context()
+{
+    static auto* context = new zmq::context_t();
+    return *context;
+}
+
+// Socket to the servers, owned by a receiver thread that stores each result until its future
+// asks for it, so results arrive while the caller does something else. ZMQ sockets are not
+// shared by threads, so requests and connections reach the receiver through an inproc pipe.
+// A DEALER talks to the servers of a single client, a ROUTER routes to many by endpoint.
+// The requests in flight to a server whose connection drops, or stops answering the heartbeats,
+// fail right away, as their results would never arrive
+class Connection {
+public:
+    // How often the requests to servers that a ROUTER is still connecting to are retried
+    static constexpr std::chrono::milliseconds RETRY_INTERVAL{1};
+    static constexpr std::chrono::milliseconds HEARTBEAT_INTERVAL{2000};
+    static constexpr std::chrono::milliseconds HEARTBEAT_TIMEOUT{10000};
+
+    Connection(const zmq::socket_type type) :
+        type_{type},
+        outbox_{shared_context(), zmq::socket_type::pair},
+        outbox_endpoint_{"inproc://client-outbox-" + std::to_string(reinterpret_cast<std::uintptr_t>(this))}
     {
-        socket_.close();
+        outbox_.bind(outbox_endpoint_);
+        receiver_ = std::thread([this] { receive_(); });
     }
 
-    void connect(const std::string& endpoint) 
+    ~Connection()
+    {
+        command_(Command::STOP, {});
+        receiver_.join();
+        outbox_.close();
+    }
+
+    // Servers are connected once, however many clients share them
+    void connect(const std::string& endpoint)
+    {
+        std::lock_guard lock(peers_mutex_);
+        if (peers_[endpoint]++ == 0)
+            command_(Command::CONNECT, {endpoint});
+    }
+
+    // An empty endpoint drops every server and the results not asked for yet
+    void disconnect(const std::string& endpoint)
+    {
+        std::lock_guard lock(peers_mutex_);
+        if (endpoint == "") {
+            peers_.clear();
+            command_(Command::DISCONNECT, {endpoint});
+            std::lock_guard results_lock(results_mutex_);
+            pending_results_.clear();
+            partial_results_.clear();
+            unmatched_results_.clear();
+            in_flight_.clear();
+            return;
+        }
+
+        auto peer = peers_.find(endpoint);
+        if (peer != peers_.end() && --peer->second == 0) {
+            peers_.erase(peer);
+            command_(Command::DISCONNECT, {endpoint});
+        }
+    }
+
+    // Large data is compressed for the servers that said they take it, so the first request to
+    // a server always goes as it is
+    std::uint64_t send(const std::string& target, const std::string& data, const RequestKind kind)
+    {
+        RequestHeader header{next_request_id_++, kind, COMPRESSION_SUPPORTED ? RequestHeader::ACCEPTS_COMPRESSED : std::uint8_t{0}};
+        std::optional<std::string> compressed;
+        if (takes_compressed_(target))
+            compressed = compress(data);
+        if (compressed)
+            header.flags |= RequestHeader::COMPRESSED;
+        {
+            std::lock_guard lock(results_mutex_);
+            in_flight_[header.id] = target;
+        }
+        command_(Command::SEND, {target, header.to_frame(), compressed ? *compressed : data});
+        return header.id;
+    }
+
+    // Stops and cancels carry no data, only the id of the request they are for
+    void control(const std::string& target, const std::uint64_t request_id, const RequestKind kind)
+    {
+        command_(Command::SEND, {target, RequestHeader{request_id, kind}.to_frame(), ""});
+    }
+
+    std::string partial(const std::uint64_t request_id)
+    {
+        std::lock_guard lock(results_mutex_);
+        auto it = partial_results_.find(request_id);
+        return it == partial_results_.end() ? std::string() : it->second;
+    }
+
+    std::string recv_next()
+    {
+        std::unique_lock lock(results_mutex_);
+        arrived_.wait(lock, [this] { return broken_ || !pending_results_.empty() || !unmatched_results_.empty(); });
+        if (!pending_results_.empty())
+            return pending_results_.extract(pending_results_.begin()).mapped();
+        return take_unmatched_();
+    }
+
+    std::string recv(const std::uint64_t request_id)
+    {
+        std::unique_lock lock(results_mutex_);
+        arrived_.wait(lock, [this, request_id] { return broken_ || has_result_(request_id); });
+        if (auto it = pending_results_.find(request_id); it != pending_results_.end())
+            return pending_results_.extract(it).mapped();
+        return take_unmatched_();
+    }
+
+    bool ready(const std::uint64_t request_id)
+    {
+        std::lock_guard lock(results_mutex_);
+        return broken_ || has_result_(request_id);
+    }
+
+    bool wait(const std::uint64_t request_id, const std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock(results_mutex_);
+        return arrived_.wait_for(lock, timeout, [this, request_id] { return broken_ || has_result_(request_id); });
+    }
+
+    // Results that nobody will ask for, as those of a client that is gone
+    void forget(const std::set<std::uint64_t>& request_ids)
     {
+        std::lock_guard lock(results_mutex_);
+        for (const auto& request_id : request_ids) {
+            pending_results_.erase(request_id);
+            partial_results_.erase(request_id);
+            in_flight_.erase(request_id);
+        }
+    }
+
+private:
+    enum class Command : char {
+        SEND,       // Frames: target, header and data
+        CONNECT,    // Frames: endpoint
+        DISCONNECT, // Frames: endpoint
+        STOP
+    };
+
+    zmq::socket_type type_;
+    zmq::socket_t outbox_; // Commands waiting for the receiver
+    std::string outbox_endpoint_;
+    std::mutex outbox_mutex_;
+    std::atomic<std::uint64_t> next_request_id_ = 1; // Unique among all the clients sharing the connection
+
+    std::mutex peers_mutex_;
+    std::unordered_map<std::string, std::size_t> peers_; // Clients connected to each server
+
+    std::mutex results_mutex_;
+    std::condition_variable arrived_;
+    std::map<std::uint64_t, std::string> pending_results_;
+    std::map<std::uint64_t, std::string> partial_results_; // Last one of each streaming request
+    std::deque<std::string> unmatched_results_; // From servers that do not send the request id
+    std::map<std::uint64_t, std::string> in_flight_; // Server of each request whose result is missing
+    bool broken_ = false; // The receiver failed, so the results still missing will never arrive
+
+    std::mutex compressing_mutex_;
+    std::unordered_set<std::string> compressing_; // Servers that take compressed data, by their routing id
+
+    std::thread receiver_;
+    std::size_t monitors_ = 0; // Sockets monitored so far, each one on its own endpoint
+
+    // A DEALER does not know which of its servers answers, so they all count as one
+    std::string routing_id_(const std::string& server) const
+    {
+        return type_ == zmq::socket_type::router ? server : std::string();
+    }
+
+    bool takes_compressed_(const std::string& server)
+    {
+        std::lock_guard lock(compressing_mutex_);
+        return compressing_.contains(routing_id_(server));
+    }
+
+    void command_(const Command command, std::initializer_list<std::string_view> frames)
+    {
+        std::lock_guard lock(outbox_mutex_);
         try {
-            socket_.connect(endpoint);
+            auto more = frames.size() == 0 ? zmq::send_flags::none : zmq::send_flags::sndmore;
+            outbox_.send(zmq::message_t(&command, sizeof(command)), more);
+            std::size_t i = 0;
+            for (const auto& frame : frames) {
+                more = ++i == frames.size() ? zmq::send_flags::none : zmq::send_flags::sndmore;
+                outbox_.send(zmq::message_t(frame.begin(), frame.end()), more);
+            }
+        } catch (const zmq::error_t& e) {
+            LOGGER_ERROR("Error sending the circuit: {}", e.what());
+        }
+    }
+
+    bool has_result_(const std::uint64_t request_id) const
+    {
+        return pending_results_.contains(request_id) || !unmatched_results_.empty();
+    }
+
+    std::string take_unmatched_()
+    {
+        if (unmatched_results_.empty())
+            return std::string("{}");
+        auto result = std::move(unmatched_results_.front());
+        unmatched_results_.pop_front();
+        return result;
+    }
+
+    zmq::socket_t open_socket_()
+    {
+        zmq::socket_t socket(shared_context(), type_);
+        // Otherwise a ROUTER drops the requests to the servers it is still connecting to
+        if (type_ == zmq::socket_type::router)
+            socket.set(zmq::sockopt::router_mandatory, true);
+        // A server that dies without closing its connections is noticed as well
+        socket.set(zmq::sockopt::heartbeat_ivl, static_cast<int>(HEARTBEAT_INTERVAL.count()));
+        socket.set(zmq::sockopt::heartbeat_timeout, static_cast<int>(HEARTBEAT_TIMEOUT.count()));
+        return socket;
+    }
+
+    // Pipe on which ZMQ reports the servers that the socket loses
+    zmq::socket_t monitor_(zmq::socket_t& socket)
+    {
+        const std::string endpoint = "inproc://client-monitor-" + std::to_string(reinterpret_cast<std::uintptr_t>(this)) +
+                                     "-" + std::to_string(monitors_++);
+        if (zmq_socket_monitor(socket.handle(), endpoint.c_str(), ZMQ_EVENT_DISCONNECTED) != 0)
+            throw zmq::error_t();
+        zmq::socket_t monitor(shared_context(), zmq::socket_type::pair);
+        monitor.connect(endpoint);
+        return monitor;
+    }
+
+    // The requests in flight to the server lost fail, unless no client is connected to it any more.
+    // Their results, if the server comes back, are dropped
+    std::optional<std::string> lost_(zmq::socket_t& monitor)
+    {
+        auto frames = recv_frames_(monitor);
+        if (frames.size() < 2)
+            return std::nullopt;
+        const std::string endpoint = frames[1].to_string();
+        std::lock_guard peers_lock(peers_mutex_);
+        if (!peers_.contains(endpoint))
+            return std::nullopt;
+
+        LOGGER_ERROR("Connection to the server at {} lost.", endpoint);
+        {
+            std::lock_guard lock(results_mutex_);
+            for (auto it = in_flight_.begin(); it != in_flight_.end(); ) {
+                if (it->second != endpoint) {
+                    ++it;
+                    continue;
+                }
+                partial_results_.erase(it->first);
+                pending_results_.insert_or_assign(it->first, "{\"ERROR\":\"Connection to the vQPU at " + endpoint +
+                                                  " lost before its result arrived.\",\"unavailable\":true}");
+                it = in_flight_.erase(it);
+            }
+        }
+        arrived_.notify_all();
+        return endpoint;
+    }
+
+    void receive_()
+    {
+        zmq::socket_t commands(shared_context(), zmq::socket_type::pair);
+        commands.connect(outbox_endpoint_);
+        auto socket = open_socket_();
+        std::deque<std::vector<zmq::message_t>> unsent;
+
+        try {
+            auto monitor = monitor_(socket);
+            while (true) {
+                zmq::pollitem_t items[] = {
+                    {socket.handle(), 0, ZMQ_POLLIN, 0},
+                    {commands.handle(), 0, ZMQ_POLLIN, 0},
+                    {monitor.handle(), 0, ZMQ_POLLIN, 0}
+                };
+                zmq::poll(items, 3, unsent.empty() ? std::chrono::milliseconds{-1} : RETRY_INTERVAL);
+
+                if (items[0].revents & ZMQ_POLLIN)
+                    store_(recv_reply_(socket));
+
+                if (items[2].revents & ZMQ_POLLIN) {
+                    // Nor are the requests to it that a ROUTER still retries sent any more
+                    if (auto endpoint = lost_(monitor); endpoint && type_ == zmq::socket_type::router)
+                        std::erase_if(unsent, [&](const auto& frames) { return frames[0].to_string() == *endpoint; });
+                }
+
+                if (items[1].revents & ZMQ_POLLIN) {
+                    auto frames = recv_frames_(commands);
+                    switch (static_cast<Command>(*frames[0].data<char>())) {
+                        case Command::STOP:
+                            return;
+                        case Command::CONNECT:
+                            connect_(socket, frames[1].to_string());
+                            break;
+                        case Command::DISCONNECT:
+                            if (frames[1].size() == 0) {
+                                monitor.close();
+                                socket.close();
+                                socket = open_socket_();
+                                monitor = monitor_(socket);
+                                unsent.clear();
+                            } else {
+                                disconnect_(socket, frames[1].to_string());
+                            }
+                            break;
+                        case Command::SEND:
+                            frames.erase(frames.begin());
+                            unsent.push_back(std::move(frames));
+                            break;
+                    }
+                }
+
+                while (!unsent.empty() && try_send_(socket, unsent.front()))
+                    unsent.pop_front();
+            }
+        } catch (const zmq::error_t& e) {
+            LOGGER_ERROR("Error receiving the circuit: {}", e.what());
+            {
+                std::lock_guard lock(results_mutex_);
+                broken_ = true;
+            }
+            arrived_.notify_all();
+        }
+    }
+
+    void connect_(zmq::socket_t& socket, const std::string& endpoint)
+    {
+        try {
+            // The ROUTER knows each server by its endpoint
+            if (type_ == zmq::socket_type::router)
+                socket.set(zmq::sockopt::connect_routing_id, endpoint);
+            socket.connect(endpoint);
             LOGGER_DEBUG("Client successfully connected to server at {}.", endpoint);
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Unable to connect to endpoint {}. Error: {}", endpoint, e.what());
-        } catch (const std::exception& e) {
-            LOGGER_ERROR("Trying to connect to a QPU located in a external node. {}", e.what());
-            throw;
         }
     }
 
-    void send(const std::string& data) 
+    void disconnect_(zmq::socket_t& socket, const std::string& endpoint)
     {
         try {
-            zmq::message_t message(data.begin(), data.end());
-            socket_.send(message, zmq::send_flags::none);
+            socket.disconnect(endpoint);
         } catch (const zmq::error_t& e) {
-            LOGGER_ERROR("Error sending the circuit: {}", e.what());
+            LOGGER_ERROR("Unable to disconnect from endpoint {}. Error: {}", endpoint, e.what());
         }
     }
 
-    std::string recv() 
+    // Whether the request left. A ROUTER refuses it while the server is still connecting
+    bool try_send_(zmq::socket_t& socket, std::vector<zmq::message_t>& frames)
     {
         try {
-            zmq::message_t reply;
-            auto size = socket_.recv(reply, zmq::recv_flags::none);
-            std::string result(static_cast<char*>(reply.data()), size.value());
-            return result;
+            if (type_ == zmq::socket_type::router)
+                socket.send(frames[0], zmq::send_flags::sndmore);
         } catch (const zmq::error_t& e) {
-            LOGGER_ERROR("Error receiving the circuit: {}", e.what());
+            if (e.num() == EHOSTUNREACH)
+                return false;
+            throw;
+        }
+        socket.send(frames[1], zmq::send_flags::sndmore);
+        socket.send(frames[2], zmq::send_flags::none);
+        return true;
+    }
+
+    std::vector<zmq::message_t> recv_frames_(zmq::socket_t& socket)
+    {
+        std::vector<zmq::message_t> frames;
+        do {
+            frames.emplace_back();
+            [[maybe_unused]] auto ret = socket.recv(frames.back(), zmq::recv_flags::none);
+        } while (frames.back().more());
+        return frames;
+    }
+
+    void store_(std::pair<RequestHeader, std::string>&& reply)
+    {
+        auto& [header, result] = reply;
+        {
+            std::lock_guard lock(results_mutex_);
+            if (header.kind == RequestKind::PARTIAL) {
+                partial_results_.insert_or_assign(header.id, std::move(result));
+                return;
+            }
+            if (header.id == RequestHeader::NO_REQUEST_ID) {
+                unmatched_results_.push_back(std::move(result));
+            } else if (in_flight_.erase(header.id) > 0) {
+                partial_results_.erase(header.id);
+                pending_results_.insert_or_assign(header.id, std::move(result));
+            }
+        }
+        arrived_.notify_all();
+    }
+
+    std::pair<RequestHeader, std::string> recv_reply_(zmq::socket_t& socket)
+    {
+        auto frames = recv_frames_(socket);
+        // A ROUTER gets the server first, and servers correlating requests send the header
+        std::size_t first = type_ == zmq::socket_type::router ? 1 : 0;
+
+        RequestHeader header;
+        if (frames.size() > first + 1)
+            header = RequestHeader::from_frame({frames[first].data<char>(), frames[first].size()});
+        if (header.flags & RequestHeader::ACCEPTS_COMPRESSED) {
+            std::lock_guard lock(compressing_mutex_);
+            compressing_.insert(routing_id_(first == 1 ? frames[0].to_string() : std::string()));
+        }
+        const auto& data = frames.back();
+        if (!(header.flags & RequestHeader::COMPRESSED))
+            return {header, std::string(data.data<char>(), data.size())};
+        try {
+            return {header, decompress({data.data<char>(), data.size()})};
+        } catch (const std::runtime_error& e) {
+            LOGGER_ERROR("Error decompressing the result: {}", e.what());
+            return {header, std::string("{\"ERROR\":\"") + e.what() + "\"}"};
+        }
+    }
+};
+
+// Connection shared by the multiplexed clients alive
+std::shared_ptr<Connection> multiplexed_connection()
+{
+    static std::mutex mutex;
+    static std::weak_ptr<Connection> shared;
+
+    std::lock_guard lock(mutex);
+    auto connection = shared.lock();
+    if (!connection) {
+        connection = std::make_shared<Connection>(zmq::socket_type::router);
+        shared = connection;
+    }
+    return connection;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+namespace comm {
+
+// A client owns its connection, or shares the multiplexed one, where it sends to the last
+// server it connected to
+struct Client::Impl {
+    Impl(const bool multiplexed) :
+        multiplexed_{multiplexed},
+        connection_{multiplexed ? multiplexed_connection() : std::make_shared<Connection>(zmq::socket_type::dealer)}
+    { }
+
+    ~Impl() 
+    {
+        if (multiplexed_)
+            disconnect("");
+    }
+
+    void connect(const std::string& endpoint) 
+    {
+        connection_->connect(endpoint);
+        std::lock_guard lock(mutex_);
+        endpoints_.push_back(endpoint);
+    }
+
+    std::uint64_t send(const std::string& data, const RequestKind kind) 
+    {
+        std::lock_guard lock(mutex_);
+        auto request_id = connection_->send(endpoints_.empty() ? "" : endpoints_.back(), data, kind);
+        outstanding_.insert(request_id);
+        return request_id;
+    }
+
+    std::string recv() 
+    {
+        std::optional<std::uint64_t> oldest;
+        {
+            std::lock_guard lock(mutex_);
+            if (!outstanding_.empty())
+                oldest = *outstanding_.begin();
         }
+        return oldest ? recv(*oldest) : connection_->recv_next();
+    }
+
+    std::string recv(const std::uint64_t request_id) 
+    {
+        auto result = connection_->recv(request_id);
+        std::lock_guard lock(mutex_);
+        outstanding_.erase(request_id);
+        return result;
+    }
+
+    bool ready(const std::uint64_t request_id) { return connection_->ready(request_id); }
+
+    std::string partial(const std::uint64_t request_id) { return connection_->partial(request_id); }
+
+    void control(const std::uint64_t request_id, const RequestKind kind)
+    {
+        std::lock_guard lock(mutex_);
+        connection_->control(endpoints_.empty() ? "" : endpoints_.back(), request_id, kind);
+    }
 
-        return std::string("{}");
+    bool wait(const std::uint64_t request_id, const std::chrono::milliseconds timeout) 
+    { 
+        return connection_->wait(request_id, timeout); 
     }
 
     void disconnect(const std::string& endpoint)
     {
+        std::lock_guard lock(mutex_);
         if (endpoint != "") {
-            socket_.disconnect(endpoint);
+            connection_->disconnect(endpoint);
+            std::erase(endpoints_, endpoint);
+            return;
+        }
+
+        if (multiplexed_) {
+            for (const auto& connected : endpoints_)
+                connection_->disconnect(connected);
+            connection_->forget(outstanding_);
         } else {
-            socket_.close();
-            socket_ = zmq::socket_t(context_, zmq::socket_type::dealer);
+            connection_->disconnect("");
         }
+        endpoints_.clear();
+        outstanding_.clear();
     }
 
-    zmq::context_t context_;
-    zmq::socket_t socket_;
+private:
+    bool multiplexed_;
+    std::shared_ptr<Connection> connection_;
+
+    std::mutex mutex_;
+    std::vector<std::string> endpoints_;
+    std::set<std::uint64_t> outstanding_; // Requests sent whose result was not received yet
 };
 
 
-Client::Client() :
-    pimpl_{std::make_unique<Impl>()}
+Client::Client(const bool multiplexed) :
+    pimpl_{std::make_unique<Impl>(multiplexed)}
 { }
 
 Client::~Client() = default;
@@ -83,20 +576,56 @@ void Client::connect(const std::string& endpoint) {
 
 FutureWrapper<Client> Client::send_circuit(const std::string& circuit) 
 { 
-    pimpl_->send(circuit);
-    return FutureWrapper<Client>(this); 
+    auto request_id = pimpl_->send(circuit, RequestKind::CIRCUIT);
+    return FutureWrapper<Client>(this, request_id); 
 }
 
 FutureWrapper<Client> Client::send_parameters(const std::string& parameters) 
 { 
-    pimpl_->send(parameters);
-    return FutureWrapper<Client>(this); 
+    auto request_id = pimpl_->send(parameters, RequestKind::PARAMETERS);
+    return FutureWrapper<Client>(this, request_id); 
+}
+
+FutureWrapper<Client> Client::send_status() 
+{ 
+    auto request_id = pimpl_->send("", RequestKind::STATUS);
+    return FutureWrapper<Client>(this, request_id); 
+}
+
+FutureWrapper<Client> Client::send_drain(const std::string& options) 
+{ 
+    auto request_id = pimpl_->send(options, RequestKind::DRAIN);
+    return FutureWrapper<Client>(this, request_id); 
 }
 
 std::string Client::recv_results() {
     return pimpl_->recv();
 }
 
+std::string Client::recv_results(const std::uint64_t request_id) {
+    return pimpl_->recv(request_id);
+}
+
+bool Client::results_ready(const std::uint64_t request_id) {
+    return pimpl_->ready(request_id);
+}
+
+bool Client::wait_results(const std::uint64_t request_id, const std::chrono::milliseconds timeout) {
+    return pimpl_->wait(request_id, timeout);
+}
+
+std::string Client::partial_results(const std::uint64_t request_id) {
+    return pimpl_->partial(request_id);
+}
+
+void Client::stop(const std::uint64_t request_id) {
+    pimpl_->control(request_id, RequestKind::STOP);
+}
+
+void Client::cancel(const std::uint64_t request_id) {
+    pimpl_->control(request_id, RequestKind::CANCEL);
+}
+
 void Client::disconnect(const std::string& endpoint) {
     pimpl_->disconnect(endpoint);
 }
@@ -1,22 +1,60 @@
 #include "zmq.hpp"
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+#include <unistd.h>
+#include <sys/un.h>
 
 #include "comm/server.hpp"
+#include "comm/compression.hpp"
 #include "logger.hpp"
 #include "utils/helpers/net_functions.hpp"
 
+namespace {
+
+// Setting of the ZMQ sockets of the vQPU that qraise passes in the environment, 0 if not given
+int zmq_setting(const char* name)
+{
+    const char* value = std::getenv(name);
+    return value != nullptr ? static_cast<int>(std::strtol(value, nullptr, 10)) : 0;
+}
+
+// The frame owns the result moved into it, which ZMQ frees once it has sent it
+void free_result(void*, void* hint)
+{
+    delete static_cast<std::string*>(hint);
+}
+
+} // End of anonymous namespace
+
 namespace cunqa {
 namespace comm {
 
 struct Server::Impl {
     zmq::context_t context_;
     zmq::socket_t socket_;
-    std::queue<std::string> rid_queue_;
+    std::mutex send_mutex_;
 
     std::string zmq_endpoint;
+    std::string ipc_endpoint;
 
+    // CUNQA_ZMQ_IO_THREADS threads of the context, one by default, CUNQA_ZMQ_HWM messages queued
+    // per client before ZMQ holds or drops them, 1000 by default, and CUNQA_ZMQ_TCP_BUFFER bytes
+    // of the kernel buffers of its connections, those of the OS by default
     Impl(const std::string& mode) :
+        context_{std::max(1, zmq_setting("CUNQA_ZMQ_IO_THREADS"))},
         socket_{context_, zmq::socket_type::router}
     {
+        if (const int hwm = zmq_setting("CUNQA_ZMQ_HWM"); hwm > 0) {
+            socket_.set(zmq::sockopt::sndhwm, hwm);
+            socket_.set(zmq::sockopt::rcvhwm, hwm);
+        }
+        if (const int buffer = zmq_setting("CUNQA_ZMQ_TCP_BUFFER"); buffer > 0) {
+            socket_.set(zmq::sockopt::sndbuf, buffer);
+            socket_.set(zmq::sockopt::rcvbuf, buffer);
+        }
         try {
             std::string ip = (mode == "hpc" ? "127.0.0.1"s : get_IP_address());
             socket_.bind("tcp://" + ip + ":*");
@@ -31,40 +69,73 @@ struct Server::Impl {
             LOGGER_ERROR("Error binding to endpoint: ", e.what());
             throw;
         }
+        bind_ipc_();
     }
 
-    std::string recv() 
+    ServerMessage recv() 
     { 
+        ServerMessage received;
         try {
             zmq::message_t identity;
             auto id_size = socket_.recv(identity, zmq::recv_flags::none);
-            std::string id_data(static_cast<char*>(identity.data()), id_size.value());
-            rid_queue_.push(id_data);
-
-            int more = 0;
-            size_t more_size = sizeof(more);
-            socket_.getsockopt(ZMQ_RCVMORE, &more, &more_size);
+            received.arrived = std::chrono::steady_clock::now();
+            received.client_id = std::string(static_cast<char*>(identity.data()), id_size.value());
 
             zmq::message_t message;
             auto size = socket_.recv(message, zmq::recv_flags::none);
-            std::string data(static_cast<char*>(message.data()), size.value());
-            return data;
+
+            // Clients correlating their requests send a header frame before the quantum task
+            if (message.more()) {
+                received.request = RequestHeader::from_frame({static_cast<char*>(message.data()), size.value()});
+                size = socket_.recv(message, zmq::recv_flags::none);
+            }
+            // Decompressed straight from the frame, or else copied once, with the room past its end
+            // that the parser of the quantum tasks needs to read it in place
+            const std::string_view frame(static_cast<const char*>(message.data()), size.value());
+            if (received.request.flags & RequestHeader::COMPRESSED) {
+                received.data = decompress(frame);
+            } else {
+                received.data.reserve(frame.size() + ServerMessage::DATA_PADDING);
+                received.data.assign(frame);
+            }
+            return received;
+        } catch (const std::runtime_error& e) {
+            LOGGER_ERROR("Error decompressing the data: {}", e.what());
+            received.data = "{}"s;
+            return received;
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error receiving data: {}", e.what());
-            return std::string("CLOSE");
+            received.data = "CLOSE"s;
+            return received;
         }
     }
 
-    void send(const std::string& result) 
+    void send(std::string result, const ServerMessage& reply_to) 
     {
+        // Only the clients that correlate their requests send the headers that tell whether
+        // they take compressed results, and the headers tell them that this server takes them too
+        RequestHeader header = reply_to.request;
+        header.flags = COMPRESSION_SUPPORTED ? RequestHeader::ACCEPTS_COMPRESSED : 0;
+        std::optional<std::string> compressed;
+        if (reply_to.request.flags & RequestHeader::ACCEPTS_COMPRESSED)
+            compressed = compress(result);
+        if (compressed) {
+            header.flags |= RequestHeader::COMPRESSED;
+            result = std::move(*compressed);
+        }
+        auto* data = new std::string(std::move(result));
+        zmq::message_t message(data->data(), data->size(), free_result, data);
+
+        // Several compute workers might answer at the same time, but ZMQ sockets are not thread safe
+        std::lock_guard<std::mutex> lock(send_mutex_);
         try {
-            zmq::message_t message(result.begin(), result.end());
-            //message.set_routing_id(rid_queue_.front());
-            std::string recvr_id = rid_queue_.front();
-            rid_queue_.pop();
-            zmq::message_t identity_frame(recvr_id.begin(), recvr_id.end());
+            zmq::message_t identity_frame(reply_to.client_id.begin(), reply_to.client_id.end());
 
             socket_.send(identity_frame, zmq::send_flags::sndmore);
+            if (header.id != RequestHeader::NO_REQUEST_ID) {
+                auto header_frame = header.to_frame();
+                socket_.send(zmq::message_t(header_frame.begin(), header_frame.end()), zmq::send_flags::sndmore);
+            }
             socket_.send(message, zmq::send_flags::none);
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error sending result: {}", e.what());
@@ -76,6 +147,28 @@ struct Server::Impl {
     {
         socket_.close();
     }
+
+private:
+    // The same socket also listens on a Unix domain socket, under the temporary directory of the
+    // job, so the clients of the node skip the loopback TCP. ZMQ removes the file as it closes
+    void bind_ipc_()
+    {
+        static std::atomic<unsigned> n_servers = 0;
+        const char* tmpdir = std::getenv("TMPDIR");
+        const std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/cunqa-" +
+                                 std::to_string(getpid()) + "-" + std::to_string(n_servers++) + ".sock";
+        if (path.size() >= sizeof(sockaddr_un::sun_path)) {
+            LOGGER_DEBUG("No local endpoint, the path {} is too long for a Unix domain socket.", path);
+            return;
+        }
+        try {
+            socket_.bind("ipc://" + path);
+            ipc_endpoint = "ipc://" + path;
+            LOGGER_DEBUG("Server bound to {}", ipc_endpoint);
+        } catch (const zmq::error_t& e) {
+            LOGGER_DEBUG("No local endpoint, could not bind to {}: {}", path, e.what());
+        }
+    }
 };
 
 Server::Server(const std::string& mode) :
@@ -85,6 +178,7 @@ Server::Server(const std::string& mode) :
     pimpl_{std::make_unique<Impl>(mode)}
 { 
     endpoint = pimpl_->zmq_endpoint;
+    local_endpoint = pimpl_->ipc_endpoint;
 }
 
 Server::~Server() = default;
@@ -94,20 +188,35 @@ void Server::accept()
     // ZMQ does not need to accept connection as Asio
 }
 
-std::string Server::recv_data() 
+ServerMessage Server::recv_data() 
 { 
     return pimpl_->recv();
 }
 
-void Server::send_result(const std::string& result) 
+void Server::send_result(const std::string& result, const ServerMessage& reply_to) 
+{ 
+    send_result(std::string(result), reply_to);
+}
+
+void Server::send_result(std::string&& result, const ServerMessage& reply_to) 
 { 
     try {
-        pimpl_->send(result);
+        pimpl_->send(std::move(result), reply_to);
     } catch (const std::exception& e) {
         throw ServerException(e.what());
     }
 }
 
+void Server::send_partial_result(const std::string& result, const ServerMessage& reply_to) 
+{ 
+    if (reply_to.request.id == RequestHeader::NO_REQUEST_ID)
+        return;
+
+    ServerMessage partial = reply_to;
+    partial.request.kind = RequestKind::PARTIAL;
+    send_result(std::string(result), partial);
+}
+
 void Server::close() 
 {
     pimpl_->close();
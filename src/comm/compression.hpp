@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#ifdef CUNQA_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cunqa {
+namespace comm {
+
+#ifdef CUNQA_ZSTD
+constexpr bool COMPRESSION_SUPPORTED = true;
+#else
+constexpr bool COMPRESSION_SUPPORTED = false;
+#endif
+
+// Smaller payloads, as most circuits and counts, are not worth the time to compress
+constexpr std::size_t COMPRESSION_THRESHOLD = 64 * 1024;
+// The fastest level: the JSON of the amplitudes and matrices shrinks well even at it
+constexpr int COMPRESSION_LEVEL = 1;
+
+// The data compressed with Zstandard, or nothing if it is too small or does not shrink
+inline std::optional<std::string> compress([[maybe_unused]] std::string_view data)
+{
+#ifdef CUNQA_ZSTD
+    if (data.size() < COMPRESSION_THRESHOLD)
+        return std::nullopt;
+    std::string compressed(ZSTD_compressBound(data.size()), '\0');
+    const std::size_t size = ZSTD_compress(compressed.data(), compressed.size(), data.data(), data.size(), COMPRESSION_LEVEL);
+    if (ZSTD_isError(size) || size >= data.size())
+        return std::nullopt;
+    compressed.resize(size);
+    return compressed;
+#else
+    return std::nullopt;
+#endif
+}
+
+inline std::string decompress([[maybe_unused]] std::string_view data)
+{
+#ifdef CUNQA_ZSTD
+    const auto content_size = ZSTD_getFrameContentSize(data.data(), data.size());
+    if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN)
+        throw std::runtime_error("The compressed message is not a Zstandard frame.");
+    std::string decompressed(content_size, '\0');
+    const std::size_t size = ZSTD_decompress(decompressed.data(), decompressed.size(), data.data(), data.size());
+    if (ZSTD_isError(size))
+        throw std::runtime_error(std::string("The compressed message could not be decompressed: ") + ZSTD_getErrorName(size));
+    decompressed.resize(size);
+    return decompressed;
+#else
+    throw std::runtime_error("A compressed message arrived, but CUNQA was built without zstd.");
+#endif
+}
+
+} // End of comm namespace
+} // End of cunqa namespace
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace cunqa {
+namespace comm {
+
+enum class RequestKind : std::uint8_t {
+    CIRCUIT,
+    PARAMETERS,
+    PARTIAL, // Intermediate result of a streaming request, sent by the server before the final one
+    STOP,    // Asks the server to finish the streaming request with the same id early
+    CANCEL,  // Asks the server to drop the request with the same id, queued or streaming
+    STATUS,  // Asks the server for the load of the vQPU, answered without queueing
+    DRAIN    // Asks the server to finish the tasks it queued and take no more, answered with its status
+};
+
+// Header travelling with every request and its result so the client can match results that
+// arrive out of order. An id equal to NO_REQUEST_ID marks peers that do not correlate requests.
+struct RequestHeader {
+    static constexpr std::uint64_t NO_REQUEST_ID = 0;
+
+    // Flags of the message
+    static constexpr std::uint8_t COMPRESSED = 1;         // Its data is compressed with Zstandard
+    static constexpr std::uint8_t ACCEPTS_COMPRESSED = 2; // Its sender takes compressed data back
+
+    std::uint64_t id = NO_REQUEST_ID;
+    RequestKind kind = RequestKind::CIRCUIT;
+    std::uint8_t flags = 0;
+
+    static constexpr std::size_t FRAME_SIZE = sizeof(std::uint64_t) + 2 * sizeof(std::uint8_t);
+    // Peers from before the flags send no flags byte
+    static constexpr std::size_t FRAME_SIZE_WITHOUT_FLAGS = FRAME_SIZE - sizeof(std::uint8_t);
+
+    std::string to_frame() const
+    {
+        std::string frame(FRAME_SIZE, '\0');
+        std::memcpy(frame.data(), &id, sizeof(id));
+        frame[sizeof(id)] = static_cast<char>(kind);
+        frame[sizeof(id) + 1] = static_cast<char>(flags);
+        return frame;
+    }
+
+    static RequestHeader from_frame(std::string_view frame)
+    {
+        RequestHeader header;
+        if (frame.size() != FRAME_SIZE && frame.size() != FRAME_SIZE_WITHOUT_FLAGS)
+            return header;
+        std::memcpy(&header.id, frame.data(), sizeof(header.id));
+        header.kind = static_cast<RequestKind>(frame[sizeof(header.id)]);
+        if (frame.size() == FRAME_SIZE)
+            header.flags = static_cast<std::uint8_t>(frame[sizeof(header.id) + 1]);
+        return header;
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <queue>
 #include <string>
 #include <vector>
 
+#include "comm/request.hpp"
 #include "backends/simple_backend.hpp"
 #include "utils/json.hpp"
 
@@ -22,19 +24,38 @@ public:
     }
 };
 
+// Message received by the server together with the identity of the client that sent it, so
+// that the result can be routed back to it regardless of the order in which results are ready.
+struct ServerMessage {
+    // Capacity that the transports leave past the end of the data, as simdjson reads up to 64
+    // bytes beyond it and would otherwise copy the quantum task into a padded buffer
+    static constexpr std::size_t DATA_PADDING = 64;
+
+    std::string client_id;
+    RequestHeader request;
+    std::string data;
+    std::chrono::steady_clock::time_point arrived{}; // When its first frame was read, if the server records it
+};
+
 class Server {
 public:
     std::string mode;
     std::string nodename;
     std::string endpoint;
+    std::string local_endpoint; // For the clients of the same node, empty if the transport has none
     JSON device;
 
     Server(const std::string& mode);
     ~Server();
 
+    // Starts taking the connections of the clients, for the transports that have them
     void accept();
-    std::string recv_data();
-    void send_result(const std::string& result);
+    ServerMessage recv_data();
+    void send_result(const std::string& result, const ServerMessage& reply_to);
+    // Takes the result over, so that the transports that can send its buffer without copying it
+    void send_result(std::string&& result, const ServerMessage& reply_to);
+    // Only reaches the clients that correlate their requests; for the rest it does nothing
+    void send_partial_result(const std::string& result, const ServerMessage& reply_to);
     void close();
 
 private:
@@ -46,14 +67,18 @@ private:
             {"mode", obj.mode}, 
             {"nodename", obj.nodename}, 
             {"endpoint", obj.endpoint},
-            {"device", obj.device}
+            {"device", obj.device},
+            {"encodings", {"json", "binary"}}
         };
+        if (!obj.local_endpoint.empty())
+            j["local_endpoint"] = obj.local_endpoint;
     }
 
     friend void from_json(const JSON& j, Server& obj) {
         j.at("mode").get_to(obj.mode);
         j.at("nodename").get_to(obj.nodename);
         j.at("endpoint").get_to(obj.endpoint);
+        obj.local_endpoint = j.value("local_endpoint", "");
         j.at("device").get_to(obj.device);
     }
 };
@@ -0,0 +1,54 @@
+#include <cctype>
+#include <charconv>
+
+#include "message_scheduler.hpp"
+
+namespace cunqa {
+
+int task_priority(std::string_view data, const int default_priority)
+{
+    // Parsing the whole task here would take twice as long as the worker that decodes it
+    constexpr std::string_view KEY = "\"priority\"";
+    auto position = data.find(KEY);
+    if (position == std::string_view::npos)
+        return default_priority;
+
+    position += KEY.size();
+    while (position < data.size() && (std::isspace(static_cast<unsigned char>(data[position])) || data[position] == ':'))
+        position++;
+    int priority = default_priority;
+    std::from_chars(data.data() + position, data.data() + data.size(), priority);
+    return priority;
+}
+
+void MessageScheduler::push(QueuedMessage queued)
+{
+    auto& queue = queues_[queued.message.client_id];
+    if (queue.empty())
+        turns_[queued.priority].push_back(queued.message.client_id);
+    queue.push_back(std::move(queued));
+    size_++;
+}
+
+QueuedMessage MessageScheduler::pop()
+{
+    auto level = turns_.begin();
+    const std::string client_id = std::move(level->second.front());
+    level->second.pop_front();
+    if (level->second.empty())
+        turns_.erase(level);
+
+    auto queue = queues_.find(client_id);
+    QueuedMessage queued = std::move(queue->second.front());
+    queue->second.pop_front();
+    size_--;
+
+    // The client waits for its next turn behind those of the priority of its next message
+    if (queue->second.empty())
+        queues_.erase(queue);
+    else
+        turns_[queue->second.front().priority].push_back(client_id);
+    return queued;
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+
+#include "comm/server.hpp"
+
+namespace cunqa {
+
+struct QueuedMessage {
+    comm::ServerMessage message;
+    std::chrono::steady_clock::time_point received;
+    int priority = 0;
+};
+
+// "priority" of the config of a task, read without parsing it. Parameter updates have no config
+// and take the priority of the circuit they update
+int task_priority(std::string_view data, const int default_priority = 0);
+
+// Queue of the messages of several clients. Each client has its own sub-queue, served in the
+// order it was filled, as parameters update the last circuit of the client. Among the clients
+// the one whose next message has the highest priority goes first, and those with equal
+// priorities take turns, so a long batch of one client does not starve the others
+class MessageScheduler {
+public:
+    void push(QueuedMessage queued);
+    QueuedMessage pop();
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+
+private:
+    std::unordered_map<std::string, std::deque<QueuedMessage>> queues_;
+    // Clients with queued messages by the priority of their next one, in turn order
+    std::map<int, std::deque<std::string>, std::greater<int>> turns_;
+    std::size_t size_ = 0;
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,101 @@
+#include "method_selector.hpp"
+
+#include <map>
+#include <cstdlib>
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+// Those that both the native stabilizer methods and the tableau of the other simulators run
+const std::unordered_set<std::string> CLIFFORD_GATES = {
+    "id", "x", "y", "z", "h", "s", "sdg", "sx", "sxdg", "cx", "cy", "cz", "swap"
+};
+
+// Those of the sparse statevector of CUNQA, which move or scale the populated basis states, and
+// those that may split each of them in two
+const std::unordered_set<std::string> PERMUTING_GATES = {
+    "id", "x", "y", "z", "s", "sdg", "t", "tdg", "cx", "cy", "cz", "swap", "rz", "p", "u1", "crz"
+};
+const std::unordered_set<std::string> BRANCHING_GATES = {"h", "sx", "sxdg", "rx", "ry", "crx", "cry"};
+
+// Instructions that any method runs and that do not change which one is the fastest
+const std::unordered_set<std::string> NEUTRAL_INSTRUCTIONS = {"measure", "barrier", "reset"};
+
+// Below this, the statevector is as fast as the matrix product state on any circuit
+constexpr int MPS_MIN_QUBITS = 26;
+// Up to this, a density matrix is cheaper than running the noise shot by shot
+constexpr int DENSITY_MATRIX_MAX_QUBITS = 12;
+// From this the statevector takes 256 MiB and a sweep of it costs more than a few thousand
+// populated states, which are at most 2^SPARSE_MAX_BRANCHING_GATES
+constexpr int SPARSE_MIN_QUBITS = 24;
+constexpr int SPARSE_MAX_BRANCHING_GATES = 12;
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+CircuitTraits circuit_traits(const std::vector<JSON>& circuit, const int n_qubits)
+{
+    CircuitTraits traits;
+    traits.n_qubits = n_qubits;
+    for (const auto& instruction : circuit) {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (NEUTRAL_INSTRUCTIONS.contains(name))
+            continue;
+
+        // Anything else, as the classically controlled gates or the communications, rules them out
+        if (!CLIFFORD_GATES.contains(name))
+            traits.clifford = false;
+        if (BRANCHING_GATES.contains(name))
+            traits.branching_gates++;
+        else if (!PERMUTING_GATES.contains(name))
+            traits.sparse = false;
+
+        const auto qubits = instruction.find("qubits");
+        if (qubits == instruction.end() || qubits->size() > 2 ||
+            (qubits->size() == 2 && std::abs((*qubits)[0].get<int>() - (*qubits)[1].get<int>()) != 1))
+            traits.nearest_neighbour = false;
+
+        if (!traits.clifford && !traits.nearest_neighbour && (!traits.sparse || traits.branching_gates > SPARSE_MAX_BRANCHING_GATES))
+            break;
+    }
+    return traits;
+}
+
+const std::vector<std::string>& supported_methods(const std::string& simulator)
+{
+    static const std::map<std::string, std::vector<std::string>> METHODS = {
+        {"Aer", {"stabilizer", "matrix_product_state", "density_matrix"}},
+        {"Maestro", {"stabilizer", "matrix_product_state"}},
+        // The stabilizer of the rest is the tableau of backends/simulators/stabilizer
+        {"Cunqa", {"stabilizer", "sparse"}},
+        {"Munich", {"stabilizer"}},
+        {"Qsim", {"stabilizer"}},
+        {"Qulacs", {"stabilizer"}},
+        {"Quest", {"stabilizer", "density_matrix"}}
+    };
+    static const std::vector<std::string> NONE;
+    const auto methods = METHODS.find(simulator);
+    return methods != METHODS.end() ? methods->second : NONE;
+}
+
+std::string select_method(const CircuitTraits& traits, const std::string& simulator, const bool noisy)
+{
+    const auto& methods = supported_methods(simulator);
+    auto supports = [&methods](const std::string& method) {
+        return std::find(methods.begin(), methods.end(), method) != methods.end();
+    };
+
+    if (noisy)
+        return traits.n_qubits <= DENSITY_MATRIX_MAX_QUBITS && supports("density_matrix") ? "density_matrix" : "statevector";
+    if (traits.clifford && supports("stabilizer"))
+        return "stabilizer";
+    if (traits.nearest_neighbour && traits.n_qubits >= MPS_MIN_QUBITS && supports("matrix_product_state"))
+        return "matrix_product_state";
+    if (traits.sparse && traits.branching_gates <= SPARSE_MAX_BRANCHING_GATES && traits.n_qubits >= SPARSE_MIN_QUBITS && supports("sparse"))
+        return "sparse";
+    return "statevector";
+}
+
+} // End of cunqa namespace
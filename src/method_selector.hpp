@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// What the selector looks at of a circuit, from a single pass over its instructions
+struct CircuitTraits {
+    bool clifford = true;          // Only gates that map Pauli strings to Pauli strings
+    bool nearest_neighbour = true; // Gates on one qubit, or on two consecutive ones
+    bool sparse = true;            // Only gates of the sparse statevector
+    int branching_gates = 0;       // Of them, those that may double the populated basis states
+    int n_qubits = 0;
+};
+
+CircuitTraits circuit_traits(const std::vector<JSON>& circuit, const int n_qubits);
+
+// Methods that the simulator runs, besides "statevector"
+const std::vector<std::string>& supported_methods(const std::string& simulator);
+
+// The fastest method of the simulator for a circuit sent with "method": "automatic". Clifford
+// circuits go to the stabilizer simulator and wide circuits of gates between neighbouring qubits
+// to the matrix product state one, and wide circuits with few gates that put qubits into
+// superposition to the sparse statevector, unless there is noise, under which the small circuits
+// go to the density matrix and any other to the statevector
+std::string select_method(const CircuitTraits& traits, const std::string& simulator, const bool noisy);
+
+} // End of cunqa namespace
@@ -0,0 +1,208 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <string_view>
+#include <unistd.h>
+#include "zmq.hpp"
+
+#include "metrics.hpp"
+#include "classical_channel/classical_channel.hpp"
+#include "utils/helpers/net_functions.hpp"
+#include "utils/helpers/memory_usage.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// Samples kept per stage for its quantiles
+constexpr std::size_t STAGE_WINDOW = 1024;
+
+std::string escaped(const std::string& value)
+{
+    std::string escaped;
+    for (const char c : value) {
+        if (c == '\\' || c == '"')
+            escaped += '\\';
+        escaped += c == '\n' ? 'n' : c;
+    }
+    return escaped;
+}
+
+class Exposition {
+public:
+    Exposition(const std::map<std::string, std::string>& labels)
+    {
+        for (const auto& [label, value] : labels)
+            labels_ += (labels_.empty() ? "" : ",") + label + "=\"" + escaped(value) + "\"";
+    }
+
+    void family(const std::string& name, const std::string& type, const std::string& help)
+    {
+        text_ << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+    }
+
+    template <typename T>
+    void sample(const std::string& name, const T value, const std::string& extra_labels = "")
+    {
+        text_ << name << "{" << labels_ << (extra_labels.empty() ? "" : ",") << extra_labels << "} " << value << "\n";
+    }
+
+    template <typename T>
+    void metric(const std::string& name, const std::string& type, const std::string& help, const T value)
+    {
+        family(name, type, help);
+        sample(name, value);
+    }
+
+    std::string str() const { return text_.str(); }
+
+private:
+    std::string labels_;
+    std::ostringstream text_;
+};
+
+double quantile(std::vector<double> samples, const double q)
+{
+    auto nth = samples.begin() + static_cast<std::size_t>(q * (samples.size() - 1));
+    std::nth_element(samples.begin(), nth, samples.end());
+    return *nth;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+void Metrics::observe(const StageTimings& timings)
+{
+    std::lock_guard lock(mutex_);
+    for (const auto& [stage, seconds] : timings.seconds()) {
+        auto& samples = stages_[stage];
+        if (samples.window.size() < STAGE_WINDOW)
+            samples.window.push_back(seconds);
+        else
+            samples.window[samples.next] = seconds;
+        samples.next = (samples.next + 1) % STAGE_WINDOW;
+        samples.sum += seconds;
+        samples.count++;
+    }
+}
+
+std::string Metrics::exposition(const std::map<std::string, std::string>& labels, const JSON& queue) const
+{
+    Exposition text(labels);
+    text.metric("cunqa_vqpu_queue_depth", "gauge", "Tasks queued on the vQPU.", queue.at("depth").get<std::size_t>());
+    text.metric("cunqa_vqpu_running_tasks", "gauge", "Tasks running on the vQPU.", queue.at("running").get<std::size_t>());
+    text.metric("cunqa_vqpu_task_seconds", "gauge", "Recent seconds per task of the workers.", queue.at("task_seconds").get<double>());
+    text.metric("cunqa_vqpu_requests_total", "counter", "Tasks received.", requests.load());
+    text.metric("cunqa_vqpu_refused_total", "counter", "Tasks refused because the queue was full.", refused.load());
+    text.metric("cunqa_vqpu_results_total", "counter", "Results sent.", results.load());
+    text.metric("cunqa_vqpu_errors_total", "counter", "Results sent that are errors.", errors.load());
+    text.metric("cunqa_vqpu_shots_total", "counter", "Shots of the tasks run.", shots.load());
+    text.metric("cunqa_vqpu_result_cache_hits_total", "counter", "Deterministic tasks answered from the result cache.", result_cache_hits.load());
+    text.metric("cunqa_vqpu_result_cache_misses_total", "counter", "Deterministic tasks looked up in the result cache and run.", result_cache_misses.load());
+    text.metric("cunqa_vqpu_received_bytes_total", "counter", "Bytes of the tasks received.", received_bytes.load());
+    text.metric("cunqa_vqpu_sent_bytes_total", "counter", "Bytes of the results sent.", sent_bytes.load());
+
+    const auto& traffic = comm::channel_traffic();
+    text.family("cunqa_vqpu_classical_messages_total", "counter", "Messages through the classical channel.");
+    text.sample("cunqa_vqpu_classical_messages_total", traffic.sent_messages.load(), "direction=\"sent\"");
+    text.sample("cunqa_vqpu_classical_messages_total", traffic.received_messages.load(), "direction=\"received\"");
+    text.family("cunqa_vqpu_classical_bytes_total", "counter", "Bytes through the classical channel.");
+    text.sample("cunqa_vqpu_classical_bytes_total", traffic.sent_bytes.load(), "direction=\"sent\"");
+    text.sample("cunqa_vqpu_classical_bytes_total", traffic.received_bytes.load(), "direction=\"received\"");
+
+    text.metric("cunqa_vqpu_statevector_bytes", "gauge", "Bytes of the states of the tasks running, "
+                "estimated from their qubits and method.", statevector_bytes.load());
+    text.metric("cunqa_vqpu_retained_state_bytes", "gauge", "Bytes of the states retained for later queries.",
+                retained_state_bytes.load());
+    text.metric("cunqa_vqpu_resident_memory_bytes", "gauge", "Resident memory of the vQPU process.", resident_bytes());
+    text.metric("cunqa_vqpu_peak_resident_memory_bytes", "gauge", "Highest resident memory of the vQPU process "
+                "while running a task.", peak_resident_bytes.load());
+    text.metric("cunqa_vqpu_memory_limit_bytes", "gauge", "Memory that the vQPU may use, zero if unlimited.",
+                memory_limit_bytes.load());
+
+    text.family("cunqa_vqpu_stage_seconds", "summary", "Seconds that the recent tasks spent in each stage.");
+    std::lock_guard lock(mutex_);
+    for (const auto& [stage, samples] : stages_) {
+        const std::string stage_label = "stage=\"" + escaped(stage) + "\"";
+        text.sample("cunqa_vqpu_stage_seconds", quantile(samples.window, 0.5), stage_label + ",quantile=\"0.5\"");
+        text.sample("cunqa_vqpu_stage_seconds", quantile(samples.window, 0.99), stage_label + ",quantile=\"0.99\"");
+        text.sample("cunqa_vqpu_stage_seconds_sum", samples.sum, stage_label);
+        text.sample("cunqa_vqpu_stage_seconds_count", samples.count, stage_label);
+    }
+    return text.str();
+}
+
+// A STREAM socket speaks raw TCP, enough for the plain GETs of the scrapers, so the endpoint
+// needs no HTTP library
+struct MetricsEndpoint::Impl {
+    zmq::context_t context_;
+    zmq::socket_t socket_;
+    std::string zmq_endpoint;
+
+    Impl(const std::string& mode) :
+        socket_{context_, zmq::socket_type::stream}
+    {
+        try {
+            std::string ip = (mode == "hpc" ? "127.0.0.1"s : get_IP_address());
+            socket_.bind("tcp://" + ip + ":*");
+
+            char endpoint[256];
+            size_t sz = sizeof(endpoint);
+            zmq_getsockopt(socket_, ZMQ_LAST_ENDPOINT, endpoint, &sz);
+            zmq_endpoint = std::string(endpoint);
+            LOGGER_DEBUG("Metrics bound to {}", endpoint);
+        } catch (const zmq::error_t& e) {
+            LOGGER_ERROR("Error binding the metrics endpoint: {}", e.what());
+            throw;
+        }
+    }
+
+    void serve(const std::function<std::string()>& scrape)
+    {
+        while (true) {
+            try {
+                zmq::message_t identity, request;
+                auto id_size = socket_.recv(identity, zmq::recv_flags::none);
+                auto size = socket_.recv(request, zmq::recv_flags::none);
+                // Empty frames tell that a connection opened or closed
+                if (size.value() == 0)
+                    continue;
+
+                std::string_view line(static_cast<const char*>(request.data()), size.value());
+                line = line.substr(0, line.find('\r'));
+                const bool scraped = line.starts_with("GET /metrics ") || line.starts_with("GET / ");
+                const std::string body = scraped ? scrape() : "Not found\n";
+                const std::string response = (scraped ? "HTTP/1.1 200 OK\r\n"s : "HTTP/1.1 404 Not Found\r\n"s) +
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                    "Connection: close\r\n\r\n" + body;
+
+                const std::string client(static_cast<const char*>(identity.data()), id_size.value());
+                socket_.send(zmq::message_t(client.begin(), client.end()), zmq::send_flags::sndmore);
+                socket_.send(zmq::message_t(response.begin(), response.end()), zmq::send_flags::none);
+                // An empty frame closes the connection
+                socket_.send(zmq::message_t(client.begin(), client.end()), zmq::send_flags::sndmore);
+                socket_.send(zmq::message_t(), zmq::send_flags::none);
+            } catch (const std::exception& e) {
+                LOGGER_ERROR("Error answering a scrape of the metrics, the endpoint keeps on serving: {}", e.what());
+            }
+        }
+    }
+};
+
+MetricsEndpoint::MetricsEndpoint(const std::string& mode) :
+    pimpl_{std::make_unique<Impl>(mode)}
+{
+    // tcp://<ip>:<port>
+    endpoint = "http://" + pimpl_->zmq_endpoint.substr(pimpl_->zmq_endpoint.find("://") + 3) + "/metrics";
+}
+
+MetricsEndpoint::~MetricsEndpoint() = default;
+
+void MetricsEndpoint::serve(const std::function<std::string()>& scrape)
+{
+    pimpl_->serve(scrape);
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "utils/helpers/stage_timings.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Counters and latencies of a vQPU, exposed in the text format of Prometheus. Rates, as the
+// requests or shots per second, are for the scraper to take from the counters
+class Metrics {
+public:
+    std::atomic<std::uint64_t> requests{0}; // Tasks received, refused ones included
+    std::atomic<std::uint64_t> refused{0};  // Because the queue was full
+    std::atomic<std::uint64_t> results{0};
+    std::atomic<std::uint64_t> errors{0};   // Results that are errors
+    std::atomic<std::uint64_t> shots{0};
+    std::atomic<std::uint64_t> result_cache_hits{0};   // Deterministic tasks answered from the cache
+    std::atomic<std::uint64_t> result_cache_misses{0};
+    std::atomic<std::uint64_t> received_bytes{0};
+    std::atomic<std::uint64_t> sent_bytes{0};
+    // Of the tasks running, estimated from their qubits and method
+    std::atomic<std::uint64_t> statevector_bytes{0};
+    std::atomic<std::uint64_t> retained_state_bytes{0}; // Of the states kept for later queries
+    std::atomic<std::uint64_t> peak_resident_bytes{0};
+    std::atomic<std::uint64_t> memory_limit_bytes{0};
+
+    void observe(const StageTimings& timings);
+    // The queue is the status of the queue of the vQPU, and the labels go on every sample
+    std::string exposition(const std::map<std::string, std::string>& labels, const JSON& queue) const;
+
+private:
+    // Latest samples of a stage, for its quantiles, along with the totals of all of them
+    struct StageSamples {
+        std::vector<double> window;
+        std::size_t next = 0;
+        double sum = 0;
+        std::uint64_t count = 0;
+    };
+    std::map<std::string, StageSamples> stages_;
+    mutable std::mutex mutex_;
+};
+
+// HTTP endpoint that answers the scrapes of Prometheus, on a port of its own
+class MetricsEndpoint {
+public:
+    std::string endpoint; // URL of the metrics
+
+    MetricsEndpoint(const std::string& mode);
+    ~MetricsEndpoint();
+
+    // Blocks answering every GET of /metrics with what scrape returns
+    void serve(const std::function<std::string()>& scrape);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,266 @@
+#include <map>
+#include <bit>
+#include <optional>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include "observables.hpp"
+#include "utils/helpers/result_fields.hpp"
+#include "backends/simulators/pauli_kernels.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// Basis in which each qubit is measured for a group of terms, 'Z' unless rotated
+using Basis = std::map<int, char>;
+
+// The masks of a term on a state of the qubits that its size spans
+sim::PauliMasks masks_of(const std::string& pauli, const std::size_t size)
+{
+    const auto masks = sim::pauli_masks(pauli);
+    if (std::bit_width(masks.flip | masks.phase) > std::bit_width(size - 1))
+        throw std::runtime_error("Pauli string " + pauli + " acts on more qubits than the state has.");
+    return masks;
+}
+
+// Qubit-wise commuting groups, filled greedily in the order of the terms
+std::vector<Basis> group_terms(const std::vector<Observable>& observables)
+{
+    std::vector<Basis> groups;
+    for (const auto& observable : observables) {
+        for (const auto& term : observable) {
+            const int n = term.pauli.size();
+            auto fits = [&](const Basis& basis) {
+                for (int qubit = 0; qubit < n; qubit++) {
+                    const char op = term.pauli[n - 1 - qubit];
+                    auto it = basis.find(qubit);
+                    if (op != 'I' && it != basis.end() && it->second != op)
+                        return false;
+                }
+                return true;
+            };
+
+            auto group = std::find_if(groups.begin(), groups.end(), fits);
+            if (group == groups.end())
+                group = groups.insert(groups.end(), Basis{});
+            for (int qubit = 0; qubit < n; qubit++) {
+                if (term.pauli[n - 1 - qubit] != 'I')
+                    (*group)[qubit] = term.pauli[n - 1 - qubit];
+            }
+        }
+    }
+    return groups;
+}
+
+bool measures_in_basis(const Basis& basis, const PauliTerm& term)
+{
+    const int n = term.pauli.size();
+    for (int qubit = 0; qubit < n; qubit++) {
+        const char op = term.pauli[n - 1 - qubit];
+        if (op != 'I' && basis.at(qubit) != op)
+            return false;
+    }
+    return true;
+}
+
+// The circuit with the measurements of the qubits of the basis rotated into it
+std::vector<JSON> rotated_circuit(const std::vector<JSON>& circuit, const Basis& basis, std::map<int, int>& clbit_of)
+{
+    std::vector<JSON> rotated;
+    rotated.reserve(circuit.size() + 2 * basis.size());
+    for (const auto& instruction : circuit) {
+        if (instruction.at("name") == "measure") {
+            const int qubit = instruction.at("qubits")[0];
+            clbit_of[qubit] = instruction.at("clbits")[0];
+            auto it = basis.find(qubit);
+            if (it != basis.end() && it->second == 'Y')
+                rotated.push_back({{"name", "sdg"}, {"qubits", {qubit}}});
+            if (it != basis.end() && it->second != 'Z')
+                rotated.push_back({{"name", "h"}, {"qubits", {qubit}}});
+        }
+        rotated.push_back(instruction);
+    }
+
+    for (const auto& [qubit, _] : basis) {
+        if (!clbit_of.contains(qubit))
+            throw std::runtime_error("Qubit " + std::to_string(qubit) + " of an observable is not measured.");
+    }
+    return rotated;
+}
+
+// Mean of the term over the counts of a circuit measured in a basis where it is diagonal
+double estimate(const JSON& counts, const PauliTerm& term, const std::map<int, int>& clbit_of)
+{
+    std::vector<int> clbits;
+    const int n = term.pauli.size();
+    for (int qubit = 0; qubit < n; qubit++) {
+        if (term.pauli[n - 1 - qubit] != 'I')
+            clbits.push_back(clbit_of.at(qubit));
+    }
+
+    double total = 0;
+    std::uint64_t shots = 0;
+    for (const auto& [bitstring, count_json] : counts.items()) {
+        const auto count = count_json.get<std::uint64_t>();
+        int parity = 0;
+        for (const int clbit : clbits)
+            parity ^= bitstring[bitstring.size() - 1 - clbit] == '1';
+        total += parity ? -static_cast<double>(count) : static_cast<double>(count);
+        shots += count;
+    }
+    return shots == 0 ? 0.0 : term.coefficient * total / shots;
+}
+
+JSON evaluate(const sim::Backend& backend, const QuantumTask& quantum_task, const std::vector<Observable>& observables)
+{
+    std::vector<double> values(observables.size(), 0.0);
+    const bool saves_state = std::any_of(quantum_task.circuit.begin(), quantum_task.circuit.end(),
+        [](const JSON& instruction) { return instruction.at("name") == "save_state"; });
+    if (saves_state) {
+        auto result = backend.execute(quantum_task);
+        if (result.contains("ERROR"))
+            return result;
+        if (auto state = saved_state(result)) {
+            for (std::size_t i = 0; i < observables.size(); i++)
+                values[i] = expectation_value(*state, observables[i]);
+            return {{"expectation_values", values}, {"method", "exact"}, {"time_taken", time_taken_of(result).get<double>()}};
+        }
+        LOGGER_DEBUG("The backend returned no state, so the observables are estimated from the counts.");
+    }
+
+    std::vector<std::vector<bool>> estimated;
+    for (const auto& observable : observables)
+        estimated.emplace_back(observable.size(), false);
+
+    double time_taken = 0;
+    for (const auto& basis : group_terms(observables)) {
+        std::map<int, int> clbit_of;
+        QuantumTask measured_task = quantum_task;
+        measured_task.circuit = rotated_circuit(quantum_task.circuit, basis, clbit_of);
+        if (measured_task.circuit.size() != quantum_task.circuit.size()) {
+            if (quantum_task.is_dynamic)
+                throw std::runtime_error("Observables with X or Y terms can only be estimated for circuits without "
+                                         "communications or classical conditions.");
+            // Its own id, so the circuit caches of the backends keep each rotation apart
+            measured_task.id += "_observables";
+            for (const auto& [qubit, op] : basis)
+                measured_task.id += "_" + std::string(1, op) + std::to_string(qubit);
+        }
+
+        auto result = backend.execute(measured_task);
+        if (result.contains("ERROR"))
+            return result;
+        time_taken += time_taken_of(result).get<double>();
+
+        // Each term is estimated in the first group that measures it
+        const auto& counts = counts_of(result);
+        for (std::size_t i = 0; i < observables.size(); i++) {
+            for (std::size_t j = 0; j < observables[i].size(); j++) {
+                if (!estimated[i][j] && measures_in_basis(basis, observables[i][j])) {
+                    values[i] += estimate(counts, observables[i][j], clbit_of);
+                    estimated[i][j] = true;
+                }
+            }
+        }
+    }
+    return {{"expectation_values", values}, {"method", "sampled"}, {"time_taken", time_taken}};
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+std::vector<Observable> read_observables(const JSON& observables)
+{
+    std::vector<Observable> read;
+    for (const auto& observable : observables) {
+        Observable terms;
+        if (observable.is_string()) {
+            terms.push_back({observable.get<std::string>(), 1.0});
+        } else {
+            for (const auto& term : observable)
+                terms.push_back({term.at(0).get<std::string>(), term.at(1).get<double>()});
+        }
+
+        for (const auto& term : terms) {
+            if (term.pauli.size() > 64 || term.pauli.find_first_not_of("IXYZ") != std::string::npos)
+                throw std::runtime_error("Invalid Pauli string " + term.pauli + " in the observables.");
+        }
+        read.push_back(std::move(terms));
+    }
+    return read;
+}
+
+std::optional<std::vector<std::complex<double>>> saved_state(const JSON& result)
+{
+    const JSON* amplitudes = nullptr;
+    if (result.contains("statevector")) {
+        amplitudes = &result.at("statevector");
+    } else if (result.contains("results") && result.at("results")[0].contains("metadata")) { // AER
+        const auto& metadata = result.at("results")[0].at("metadata");
+        if (metadata.contains("result_types")) {
+            for (const auto& [label, type] : metadata.at("result_types").items()) {
+                if (type == "save_statevector") {
+                    amplitudes = &result.at("results")[0].at("data").at(label);
+                    break;
+                }
+            }
+        }
+    }
+    if (amplitudes == nullptr || !amplitudes->is_array())
+        return std::nullopt;
+
+    std::vector<std::complex<double>> state;
+    state.reserve(amplitudes->size());
+    for (const auto& amplitude : *amplitudes)
+        state.emplace_back(amplitude.at(0).get<double>(), amplitude.at(1).get<double>());
+    return state;
+}
+
+double expectation_value(const std::vector<std::complex<double>>& state, const Observable& observable)
+{
+    const std::size_t n_qubits = std::bit_width(state.size()) - 1;
+    double value = 0;
+    for (const auto& term : observable)
+        value += term.coefficient * sim::pauli_expectation(state.data(), n_qubits, masks_of(term.pauli, state.size()));
+    return value;
+}
+
+void apply_observable(std::span<const std::complex<double>> state, std::span<std::complex<double>> out, const Observable& observable)
+{
+    const std::size_t n_qubits = std::bit_width(state.size()) - 1;
+    std::fill(out.begin(), out.end(), 0.0);
+    for (const auto& term : observable)
+        sim::add_pauli_term(state.data(), out.data(), n_qubits, masks_of(term.pauli, state.size()), term.coefficient);
+}
+
+JSON evaluate_observables(const sim::Backend& backend, QuantumTask& quantum_task)
+{
+    const auto observables = read_observables(quantum_task.config.at("observables"));
+    if (quantum_task.params_batch.empty())
+        return evaluate(backend, quantum_task, observables);
+
+    JSON results = JSON::array();
+    for (const auto& params : quantum_task.params_batch) {
+        quantum_task.assign_params(params);
+        results.push_back(evaluate(backend, quantum_task, observables));
+    }
+    return {{"batch", results}};
+}
+
+JSON evaluate_gradients(const sim::Backend& backend, QuantumTask& quantum_task)
+{
+    if (quantum_task.params_batch.empty())
+        return backend.execute_gradient(quantum_task);
+
+    JSON results = JSON::array();
+    for (const auto& params : quantum_task.params_batch) {
+        quantum_task.assign_params(params);
+        results.push_back(backend.execute_gradient(quantum_task));
+    }
+    return {{"batch", results}};
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <complex>
+#include <optional>
+
+#include "quantum_task.hpp"
+#include "backends/backend.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Pauli observables that the vQPU evaluates instead of returning the counts. They are given in
+// the "observables" field of the config, each as a Pauli string or a list of [pauli, coefficient]
+// terms. As in the bitstrings, the last character of a Pauli string acts on qubit 0
+struct PauliTerm {
+    std::string pauli;
+    double coefficient = 1.0;
+};
+using Observable = std::vector<PauliTerm>;
+
+std::vector<Observable> read_observables(const JSON& observables);
+
+// Exact <state|observable|state>, with the qubit i as the bit i of the index of the amplitudes
+double expectation_value(const std::vector<std::complex<double>>& state, const Observable& observable);
+
+// observable|state>, written into out, of the same size as the state
+void apply_observable(std::span<const std::complex<double>> state, std::span<std::complex<double>> out, const Observable& observable);
+
+// Statevector that the circuit saved with save_state, if the backend returns it
+std::optional<std::vector<std::complex<double>>> saved_state(const JSON& result);
+
+// Result {"expectation_values", "method", "time_taken"} of the observables of the config, or
+// {"batch": [...]} of them for a pending batch of parameters. They are exact when the circuit
+// saves its state, as the backends that return it; otherwise they are estimated from the counts,
+// running the circuit once per group of qubit-wise commuting terms with its measurements rotated
+JSON evaluate_observables(const sim::Backend& backend, QuantumTask& quantum_task);
+
+// Result {"expectation_values", "gradients", "method", "time_taken"} of the observables of the
+// config with "gradient", or {"batch": [...]} of them for a pending batch of parameters. The
+// gradient of each observable has the derivative by each parameter, in the order that the
+// updates give them, exact from the state of the backends that compute it
+JSON evaluate_gradients(const sim::Backend& backend, QuantumTask& quantum_task);
+
+} // End of cunqa namespace
@@ -0,0 +1,281 @@
+#include <regex>
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
+#include "zmq.hpp"
+
+#include "qmio_linker.hpp"
+#include "utils/constants.hpp"
+#include "utils/registry.hpp"
+#include "utils/helpers/pickle.hpp"
+#include "utils/helpers/json_to_qasm2.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+const std::string CALIBRATIONS_PATH = "/opt/cesga/qmio/hpc/calibrations";
+constexpr std::size_t DEFAULT_WINDOW = 4;
+
+// Latest calibration, the "YYYY_MM_DD__hh_mm_ss.json" file modified last
+std::string last_calibration()
+{
+    static const std::regex calibration_name(R"(\d{4}_\d{2}_\d{2}__\d{2}_\d{2}_\d{2}\.json)");
+    std::filesystem::path last;
+    std::filesystem::file_time_type last_time;
+    if (std::filesystem::is_directory(CALIBRATIONS_PATH)) {
+        for (const auto& entry : std::filesystem::directory_iterator(CALIBRATIONS_PATH)) {
+            if (!std::regex_match(entry.path().filename().string(), calibration_name))
+                continue;
+            const auto time = entry.last_write_time();
+            if (last.empty() || time > last_time) {
+                last = entry.path();
+                last_time = time;
+            }
+        }
+    }
+    if (last.empty())
+        throw std::runtime_error("No calibration files found");
+    LOGGER_DEBUG("Using latest calibration file: {}", last.string());
+    return last.string();
+}
+
+JSON qmio_backend()
+{
+    return {
+        {"name", "QMIOBackend"},
+        {"version", ""},
+        {"n_qubits", 32},
+        {"description", "Backend of real QMIO"},
+        {"coupling_map", {{0,1},{2,1},{2,3},{4,3},{5,4},{6,3},{6,12},{7,0},{7,9},{9,10},
+                          {11,10},{11,12},{13,21},{14,11},{14,18},{15,8},{15,16},{18,17},
+                          {18,19},{20,19},{22,21},{22,31},{23,20},{23,30},{24,17},{24,27},
+                          {25,16},{25,26},{26,27},{28,27},{28,29},{30,29},{30,31}}},
+        {"basis_gates", {"sx", "x", "rz", "ecr"}},
+        {"noise_properties_path", last_calibration()}
+    };
+}
+
+// Value of the Tket optimizations of the control server for an optimization level
+int optimization_value(const int optimization)
+{
+    switch (optimization)
+    {
+    case 0: return 1;
+    case 1: return 18;
+    case 2: return 30;
+    default:
+        throw std::runtime_error(std::to_string(optimization) + ": Not a valid Optimization Value");
+    }
+}
+
+// Compiler configuration of QAT that the control server reads, from the configuration of the task
+std::string run_config(const JSON& config)
+{
+    static const std::unordered_map<std::string, std::pair<int, int>> results_formats = {
+        {"binary_count", {1, 3}},
+        {"raw", {1, 2}},
+        {"binary", {2, 2}},
+        {"squash_binary_result_arrays", {2, 6}}
+    };
+    const auto res_format = config.value("res_format", std::string("binary_count"));
+    const auto format = results_formats.find(res_format);
+    if (format == results_formats.end())
+        throw std::runtime_error(res_format + ": Not a valid result format");
+    const auto [inline_processing, formatting] = format->second;
+
+    const JSON qat_config = {
+        {"$type", "<class 'qat.purr.compiler.config.CompilerConfig'>"},
+        {"$data", {
+            {"repeats", config.value("shots", 1024)},
+            {"repetition_period", config.value("repetition_period", JSON())},
+            {"results_format", {
+                {"$type", "<class 'qat.purr.compiler.config.QuantumResultsFormat'>"},
+                {"$data", {
+                    {"format", {{"$type", "<enum 'qat.purr.compiler.config.InlineResultsProcessing'>"}, {"$value", inline_processing}}},
+                    {"transforms", {{"$type", "<enum 'qat.purr.compiler.config.ResultsFormatting'>"}, {"$value", formatting}}}
+                }}
+            }},
+            {"metrics", {{"$type", "<enum 'qat.purr.compiler.config.MetricsType'>"}, {"$value", 6}}},
+            {"active_calibrations", JSON::array()},
+            {"optimizations", {{"$type", "<enum 'qat.purr.compiler.config.TketOptimizations'>"},
+                               {"$value", optimization_value(config.value("optimization", 0))}}}
+        }}
+    };
+    return qat_config.dump();
+}
+
+std::size_t window_size()
+{
+    const char* window = std::getenv("CUNQA_QMIO_WINDOW");
+    return window != nullptr ? std::max<std::size_t>(1, std::strtoul(window, nullptr, 10)) : DEFAULT_WINDOW;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+struct QMIOLinker::Impl {
+    zmq::context_t context;
+    // Wakes the thread that talks to the control server when a job is queued
+    zmq::socket_t inbox{context, zmq::socket_type::pair};
+    zmq::socket_t signal{context, zmq::socket_type::pair};
+};
+
+QMIOLinker::QMIOLinker(const std::string& family) :
+    server{std::make_unique<comm::Server>("co_located")},
+    family_{family},
+    name_{std::string(std::getenv("SLURM_JOB_ID")) + "_" + std::getenv("SLURM_TASK_PID")},
+    window_{window_size()},
+    pimpl_{std::make_unique<Impl>()}
+{
+    server->device = {{"device_name", "QPU"}, {"target_devices", {"QMIO"}}};
+    pimpl_->inbox.bind("inproc://qmio-linker");
+    pimpl_->signal.connect("inproc://qmio-linker");
+}
+
+QMIOLinker::~QMIOLinker() = default;
+
+void QMIOLinker::run()
+{
+    std::thread listen([this](){ this->recv_data_(); });
+    std::thread forward([this](){ this->forward_(); });
+
+    JSON qmio_config = *this;
+    open_registry(constants::QPUS_REGISTRY)->write(name_, qmio_config);
+    LOGGER_DEBUG("QMIO linker {} listening with a window of {} job(s).", name_, window_);
+
+    listen.join();
+    forward.join();
+}
+
+// The circuits are decoded, updated with the parameters and written as QASM here, while the
+// hardware runs the jobs in flight
+void QMIOLinker::recv_data_()
+{
+    server->accept();
+    while (true) {
+        auto message = server->recv_data();
+        if (message.request.kind == comm::RequestKind::STOP || message.request.kind == comm::RequestKind::CANCEL)
+            continue; // The jobs sent to the hardware run to the end
+        if (message.request.kind == comm::RequestKind::STATUS) {
+            JSON status = {{"name", name_}, {"device", server->device}, {"window", window_}};
+            {
+                std::lock_guard lock(mutex_);
+                status["queue"] = {{"queued_tasks", queued_.size()}, {"in_flight", in_flight_}};
+            }
+            server->send_result(status.dump(), message);
+            continue;
+        }
+        if (message.data == "CLOSE") {
+            quantum_tasks_.erase(message.client_id);
+            server->accept();
+            continue;
+        }
+
+        Job job{.message = std::move(message)};
+        try {
+            QuantumTask& quantum_task = quantum_tasks_[job.message.client_id];
+            quantum_task.update_circuit(job.message.data);
+            if (!quantum_task.tasks_batch.empty())
+                throw std::runtime_error("QMIO runs a single circuit per job, not batches of them.");
+            job.request = pickle_strings({json_to_qasm2(quantum_task.circuit, quantum_task.config), run_config(quantum_task.config)});
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Error preparing the task for QMIO: {}", e.what());
+            server->send_result(JSON({{"ERROR", e.what()}}).dump(), job.message);
+            continue;
+        }
+        job.message.data.clear();
+        {
+            std::lock_guard lock(mutex_);
+            queued_.push_back(std::move(job));
+        }
+        pimpl_->signal.send(zmq::message_t(), zmq::send_flags::none);
+    }
+}
+
+// Sends the queued jobs while less than the window are in flight, and returns the results in
+// the order that the control server answers them
+void QMIOLinker::forward_()
+{
+    zmq::socket_t qmio(pimpl_->context, zmq::socket_type::dealer);
+    const char* endpoint = std::getenv("ZMQ_SERVER");
+    if (endpoint == nullptr)
+        throw std::runtime_error("ZMQ_SERVER is not set, there is no QMIO control server to send the jobs to.");
+    qmio.connect(endpoint);
+
+    std::deque<Job> in_flight;
+    std::size_t signals = 0; // Jobs queued and not sent yet
+    while (true) {
+        zmq::pollitem_t items[] = {
+            {qmio.handle(), 0, ZMQ_POLLIN, 0},
+            {pimpl_->inbox.handle(), 0, ZMQ_POLLIN, 0}
+        };
+        zmq::poll(items, 2, std::chrono::milliseconds{-1});
+
+        if (items[1].revents & ZMQ_POLLIN) {
+            zmq::message_t signal;
+            (void)pimpl_->inbox.recv(signal, zmq::recv_flags::none);
+            signals++;
+        }
+
+        if (items[0].revents & ZMQ_POLLIN) {
+            // The REP of the control server answers with an empty delimiter before the reply
+            zmq::message_t delimiter, reply;
+            (void)qmio.recv(delimiter, zmq::recv_flags::none);
+            auto size = qmio.recv(reply, zmq::recv_flags::none);
+            Job job = std::move(in_flight.front());
+            in_flight.pop_front();
+            {
+                std::lock_guard lock(mutex_);
+                in_flight_ = in_flight.size();
+            }
+            const std::chrono::duration<double> time_taken = std::chrono::steady_clock::now() - job.sent;
+
+            JSON result;
+            try {
+                JSON qmio_reply = unpickle_json({static_cast<const char*>(reply.data()), size.value()});
+                result = {{"qmio_results", qmio_reply.at("results")}, {"time_taken", time_taken.count()}};
+            } catch (const std::exception& e) {
+                LOGGER_ERROR("Error reading the result of QMIO: {}", e.what());
+                result = {{"ERROR", std::string("An error occured in QMIO: ") + e.what()}};
+            }
+            try {
+                server->send_result(result.dump(), job.message);
+            } catch (const comm::ServerException& e) {
+                LOGGER_ERROR("There has happened an error sending the result, probably the client has had an error: {}", e.what());
+            }
+        }
+
+        while (signals > 0 && in_flight.size() < window_) {
+            Job job;
+            {
+                std::lock_guard lock(mutex_);
+                job = std::move(queued_.front());
+                queued_.pop_front();
+                in_flight_ = in_flight.size() + 1;
+            }
+            signals--;
+            job.sent = std::chrono::steady_clock::now();
+            qmio.send(zmq::message_t(), zmq::send_flags::sndmore);
+            qmio.send(zmq::message_t(job.request.begin(), job.request.end()), zmq::send_flags::none);
+            job.request.clear();
+            in_flight.push_back(std::move(job));
+        }
+    }
+}
+
+void to_json(JSON& j, const QMIOLinker& obj)
+{
+    JSON server_json = *(obj.server);
+    j = {
+        {"real_qpu", "QMIO"},
+        {"backend", qmio_backend()},
+        {"net", server_json},
+        {"name", "QMIO"},
+        {"family", obj.family_},
+        {"slurm_job_id", std::getenv("SLURM_JOB_ID")}
+    };
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+
+#include "comm/server.hpp"
+#include "quantum_task.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// vQPU in front of QMIO, the quantum computer of CESGA. The clients send it their tasks as to
+// any other vQPU, and it sends them as OpenQASM 2 to the control server of QMIO, whose address
+// is in the ZMQ_SERVER environment variable. Up to CUNQA_QMIO_WINDOW jobs (4 by default) are
+// in flight, so that the next one is already queued at the control server when the hardware
+// finishes the previous one. The control server answers them in order, as a REP socket does
+class QMIOLinker {
+public:
+    std::unique_ptr<comm::Server> server;
+
+    QMIOLinker(const std::string& family);
+    ~QMIOLinker();
+    void run();
+
+private:
+    struct Job {
+        comm::ServerMessage message;
+        std::string request; // Pickle of the QASM and the run configuration
+        std::chrono::steady_clock::time_point sent{};
+    };
+
+    std::string family_;
+    std::string name_;
+    std::size_t window_;
+    // Last circuit of each client, whose parameters the next messages update
+    std::unordered_map<std::string, QuantumTask> quantum_tasks_;
+    std::deque<Job> queued_;
+    std::size_t in_flight_ = 0;
+    std::mutex mutex_;
+    struct Impl;
+    std::unique_ptr<Impl> pimpl_;
+
+    void recv_data_();
+    void forward_();
+
+    friend void to_json(JSON& j, const QMIOLinker& obj);
+};
+
+} // End of cunqa namespace
@@ -1,53 +1,527 @@
+#include <bit>
 #include <string>
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <optional>
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "utils/constants.hpp"
+#include "utils/registry.hpp"
+#include "utils/helpers/result_writer.hpp"
+#include "utils/helpers/binary_states.hpp"
+#include "utils/helpers/stage_timings.hpp"
+#include "utils/helpers/perf_counters.hpp"
+#include "utils/helpers/memory_usage.hpp"
+#include "utils/helpers/precision.hpp"
+#include "utils/helpers/request_arena.hpp"
+#include "utils/helpers/result_fields.hpp"
+#include "utils/helpers/clbit_selection.hpp"
 #include "qpu.hpp"
+#include "observables.hpp"
+#include "method_selector.hpp"
 #include "logger.hpp"
 
 using namespace std::string_literals;
 
+namespace {
+
+const std::string CANCELLED = "Request cancelled.";
+const std::string DROPPED = "vQPU dropped before the task ran, it can be sent to another vQPU.";
+
+// vQPUs of the process still serving, which exits once the last of them leaves
+std::atomic<std::size_t> serving_qpus{0};
+
+std::vector<std::unique_ptr<cunqa::sim::Backend>> single_backend(std::unique_ptr<cunqa::sim::Backend> backend)
+{
+    std::vector<std::unique_ptr<cunqa::sim::Backend>> backends;
+    backends.push_back(std::move(backend));
+    return backends;
+}
+
+// Tasks with "stream_shots" run in chunks of that many shots, sending the counts so far after
+// each one. Partial results need the request id to be told apart from the final one
+bool streams(const cunqa::QuantumTask& quantum_task, const cunqa::comm::ServerMessage& message)
+{
+    return quantum_task.config.value("stream_shots", 0) > 0 && quantum_task.params_batch.empty() && quantum_task.tasks_batch.empty() &&
+           message.request.id != cunqa::comm::RequestHeader::NO_REQUEST_ID;
+}
+
+// Tasks with "checkpoint" run in chunks too, kept on disk after each one, see Checkpoints
+bool checkpoints(const cunqa::QuantumTask& quantum_task)
+{
+    return quantum_task.config.contains("checkpoint") && quantum_task.config.value("shots", 0) > 0 &&
+           quantum_task.params_batch.empty() && quantum_task.tasks_batch.empty();
+}
+
+// The requests that do not run the circuit of the client go through the stages of the vQPU as
+// tasks of their own. A batch of circuits takes the config of its first circuit for what concerns
+// the whole request, the largest register and all the shots, and a query on a retained state its
+// options, as the shots and the timings
+std::optional<cunqa::QuantumTask> detached_task(cunqa::QuantumTask& quantum_task)
+{
+    if (quantum_task.retained_query) {
+        cunqa::QuantumTask query;
+        query.config = *quantum_task.retained_query;
+        for (const auto& key : {"handle", "observables", "marginal", "amplitudes"})
+            query.config.erase(key);
+        query.retained_query = std::move(quantum_task.retained_query);
+        quantum_task.retained_query.reset();
+        return query;
+    }
+    if (quantum_task.tasks_batch.empty())
+        return std::nullopt;
+    cunqa::QuantumTask batch;
+    batch.config = quantum_task.tasks_batch.front().config;
+    int n_qubits = 0;
+    std::uint64_t shots = 0;
+    for (const auto& task : quantum_task.tasks_batch) {
+        n_qubits = std::max(n_qubits, task.config.value("num_qubits", 0));
+        shots += task.config.value("shots", 0);
+    }
+    batch.config["num_qubits"] = n_qubits;
+    batch.config["shots"] = shots;
+    batch.tasks_batch = std::move(quantum_task.tasks_batch);
+    return batch;
+}
+
+void accumulate_result(cunqa::JSON& total, const cunqa::JSON& chunk)
+{
+    auto& counts = cunqa::counts_of(total);
+    for (const auto& [bitstring, count] : cunqa::counts_of(chunk).items())
+        counts[bitstring] = counts.value(bitstring, 0) + count.get<int>();
+    auto& time_taken = cunqa::time_taken_of(total);
+    time_taken = time_taken.get<double>() + cunqa::time_taken_of(chunk).get<double>();
+}
+
+std::string gigabytes(const std::uint64_t bytes)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.2f", bytes / 1e9);
+    return text;
+}
+
+// Adds the amount to the gauge while it lives
+template <typename T>
+class InGauge {
+public:
+    InGauge(std::atomic<T>& gauge, const T amount) : gauge_{gauge}, amount_{amount} { gauge_ += amount_; }
+    ~InGauge() { gauge_ -= amount_; }
+private:
+    std::atomic<T>& gauge_;
+    const T amount_;
+};
+
+} // End of anonymous namespace
+
 namespace cunqa {
 
-QPU::QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode, 
+QPU::QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode,
          const std::string& name, const std::string& family, const std::string& comm) :
-    backend{std::move(backend)},
+    QPU(single_backend(std::move(backend)), mode, name, family, comm)
+{ }
+
+QPU::QPU(std::vector<std::unique_ptr<sim::Backend>> backends, const std::string& mode,
+         const std::string& name, const std::string& family, const std::string& comm,
+         const QueueLimits& queue_limits) :
+    backends{std::move(backends)},
     server{std::make_unique<comm::Server>(mode)},
-    name_{name},
+    workers_(this->backends.size()),
+    queue_limits_{queue_limits},
     family_{family},
-    comm_{comm}
-{ }
+    standby_{std::getenv("CUNQA_STANDBY") ? std::getenv("CUNQA_STANDBY") : ""},
+    name_{name},
+    comm_{comm},
+    metrics_endpoint_{std::make_unique<MetricsEndpoint>(mode)},
+    result_cache_{ResultCache::from_environment()},
+    retained_states_{RetainedStates::from_environment()},
+    checkpoints_{Checkpoints::from_environment()}
+{
+    if (this->backends.empty())
+        throw std::runtime_error("A QPU needs at least one backend to compute the results.");
 
-void QPU::turn_ON() 
+    const JSON backend_json = this->backends.front()->to_json();
+    simulator_ = backend_json.value("simulator", std::string());
+    for (const auto* key : {"noise_model", "noise_properties_path"}) {
+        const auto noise = backend_json.find(key);
+        noisy_ = noisy_ || (noise != backend_json.end() && noise->is_string() && !noise->get_ref<const std::string&>().empty());
+    }
+    const auto basis_gates = backend_json.value("basis_gates", std::vector<std::string>());
+    basis_gates_.insert(basis_gates.begin(), basis_gates.end());
+    if (const auto coupling_map = backend_json.find("coupling_map"); coupling_map != backend_json.end() && coupling_map->is_array())
+        coupling_map_ = coupling_map->get<std::vector<std::vector<int>>>();
+    n_backend_qubits_ = backend_json.value("n_qubits", 0);
+    // Checked by qraise against the simulator
+    const char* precision = std::getenv("CUNQA_PRECISION");
+    precision_ = precision ? precision : supported_precisions(simulator_).front();
+    memory_limit_ = memory_limit();
+    // Set by qraise, in MB, for the vQPUs that share a GPU
+    if (const char* gpu_memory = std::getenv("CUNQA_GPU_MEMORY"))
+        gpu_memory_limit_ = std::strtoull(gpu_memory, nullptr, 10) * 1024 * 1024;
+    metrics_.memory_limit_bytes = memory_limit_.value_or(0);
+}
+
+void QPU::turn_ON()
 {
-    std::thread listen([this](){this->recv_data_();});
-    std::thread compute([this](){this->compute_result_();});
+    // The simulators that size their threads from OMP_NUM_THREADS read it on each task
+    if (cores_.reserved())
+        setenv("OMP_NUM_THREADS", std::to_string(cores_.compute_cores()).c_str(), 1);
+    if (std::getenv("CUNQA_PREWARM") != nullptr)
+        prewarm_();
+    thread_policy_ = std::make_unique<ThreadPolicy>(ThreadPolicy::from_environment(worker_threads_()));
+    LOGGER_DEBUG("Each thread of the workers takes at least {} amplitudes of a state.", thread_policy_->amplitudes_per_thread());
+    baseline_bytes_ = resident_bytes();
+    started_ = std::chrono::steady_clock::now();
+    std::thread listen([this](){ cores_.pin_io(); this->recv_data_(); });
+    std::vector<std::thread> compute;
+    for (std::size_t worker_id = 0; worker_id < workers_.size(); worker_id++)
+        compute.emplace_back([this, worker_id](){ cores_.pin_compute(); this->compute_result_(worker_id); });
+    std::thread metrics([this](){ cores_.pin_io(); metrics_endpoint_->serve([this](){ return this->scrape_(); }); });
+    LOGGER_DEBUG("QPU {} turned on with {} compute worker(s).", name_, workers_.size());
 
+    ready_at_ = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    serving_qpus++;
     JSON qpu_config = *this;
-    write_on_file(qpu_config, constants::QPUS_FILEPATH, name_);
+    open_registry(constants::QPUS_REGISTRY)->write(name_, qpu_config);
 
     listen.join();
-    compute.join();
+    for (auto& worker_thread : compute)
+        worker_thread.join();
+    metrics.join();
+}
+
+// Runs a small circuit on every backend before the vQPU registers, so that the initializations
+// that the simulators do on their first circuit (GPU contexts, the QuEST environment...) are not
+// paid by the first task of a client
+void QPU::prewarm_()
+{
+    // Their executors are raised along with the vQPUs, and may not be listening yet
+    if (comm_ == "quantum_comm") {
+        LOGGER_DEBUG("QPUs with quantum communications are not prewarmed.");
+        return;
+    }
+
+    const std::string prewarm_task = JSON({
+        {"id", "prewarm"},
+        {"config", {{"shots", 1}, {"method", "automatic"}, {"avoid_parallelization", false},
+                    {"num_qubits", 2}, {"num_clbits", 2}, {"device", server->device}, {"seed", 0}}},
+        {"instructions", {
+            {{"name", "h"}, {"qubits", {0}}},
+            {{"name", "cx"}, {"qubits", {0, 1}}},
+            {{"name", "measure"}, {"qubits", {0}}, {"clbits", {0}}},
+            {{"name", "measure"}, {"qubits", {1}}, {"clbits", {1}}}
+        }},
+        {"sending_to", JSON::array()},
+        {"is_dynamic", false}
+    }).dump();
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> prewarming;
+    for (const auto& backend : backends) {
+        prewarming.emplace_back([&backend, &prewarm_task]() {
+            try {
+                const JSON result = backend->execute(QuantumTask(prewarm_task));
+                if (result.is_object() && result.contains("ERROR"))
+                    LOGGER_WARN("The prewarm circuit failed: {}", result.at("ERROR").dump());
+            } catch (const std::exception& e) {
+                LOGGER_WARN("The prewarm circuit failed: {}", e.what());
+            }
+        });
+    }
+    for (auto& thread : prewarming)
+        thread.join();
+    const std::chrono::duration<double> prewarm_time = std::chrono::steady_clock::now() - start;
+    LOGGER_DEBUG("QPU {} prewarmed in {} s.", name_, prewarm_time.count());
 }
 
-void QPU::compute_result_()
-{    
-    QuantumTask quantum_task_; 
-    while (true) 
+// The cores of the allocation, but those reserved for the IO threads, shared among the workers
+// instead of oversubscribing them
+int QPU::worker_threads_() const
+{
+#ifdef _OPENMP
+    const int cores = cores_.reserved() ? cores_.compute_cores() : omp_get_max_threads();
+    return std::max(1, cores / static_cast<int>(workers_.size()));
+#else
+    return 1;
+#endif
+}
+
+void QPU::compute_result_(const std::size_t worker_id)
+{
+    const int worker_threads = worker_threads_();
+#ifdef _OPENMP
+    if (workers_.size() > 1 || cores_.reserved())
+        omp_set_num_threads(worker_threads);
+#endif
+
+    Worker& worker = workers_[worker_id];
+    const auto& backend = backends[worker_id];
+    // Last circuit of each client, as the scheduler interleaves the messages of the clients
+    std::unordered_map<std::string, QuantumTask> quantum_tasks;
+    while (true)
     {
         std::unique_lock<std::mutex> lock(queue_mutex_);
-        queue_condition_.wait(lock, [this] { return !message_queue_.empty(); });
+        worker.queue_condition.wait(lock, [&worker] { return !worker.message_queue.empty(); });
 
-        while (!message_queue_.empty()) 
+        while (!worker.message_queue.empty())
         {
+            QueuedMessage queued = worker.message_queue.pop();
+            const comm::ServerMessage& message = queued.message;
+            if (message.data.compare("CLOSE"s) == 0) {
+                quantum_tasks.erase(message.client_id);
+                continue;
+            }
+            queued_tasks_--;
+            queued_bytes_ -= message.data.size();
+            lock.unlock();
+            const auto start = std::chrono::steady_clock::now();
+
+            QuantumTask& client_task = quantum_tasks[message.client_id];
+
             try {
-                std::string message = message_queue_.front();
-                message_queue_.pop();
-                lock.unlock();
-                
-                quantum_task_.update_circuit(message);
-                auto result = backend->execute(quantum_task_);
-                server->send_result(result.dump());
+                // Decoded even if dropped, as the next parameters of the client update this circuit
+                client_task.update_circuit(message.data);
+                std::optional<QuantumTask> detached = detached_task(client_task);
+                QuantumTask& quantum_task = detached ? *detached : client_task;
+                // Its final state is kept, so it runs as it is
+                const bool retains = quantum_task.config.value("retain", false) && quantum_task.params_batch.empty();
+                // The gradients are given by the parameters of the circuit sent, so it runs as it is too
+                const bool differentiates = quantum_task.config.contains("observables") && quantum_task.config.value("gradient", false);
+                const auto parsed = std::chrono::steady_clock::now();
+                // Before any pass over the circuit, which a task dropped would not need
+                std::optional<std::string> reason = dropped_(quantum_task, queued);
+
+                // Always recorded for the metrics, but only returned if the client asks for them
+                StageTimings timings;
+                const bool timed = quantum_task.config.value("timings", false);
+                StageTimings::Recording recording(&timings);
+                if (message.arrived != StageTimings::Clock::time_point{})
+                    timings.add("receive", message.arrived, queued.received);
+                timings.add("queue", queued.received, start);
+                timings.add("parse", start, parsed);
+
+                // Optimized on a copy, as the parameters that the client sends next are those of
+                // the circuit it sent. The batches of parameters go as they are for the same reason
+                std::optional<QuantumTask> optimized;
+                std::optional<OptimizerReport> optimization;
+                std::optional<TranspilerReport> transpilation;
+                auto prepared = parsed;
+
+                // Transpiled first, as the passes after it keep to the basis gates. The qubits
+                // are renumbered to those it uses but with noise, given per physical qubit
+                if (!reason && quantum_task.config.value("transpile", false) && quantum_task.params_batch.empty() && !detached && !retains && !differentiates) {
+                    optimized = quantum_task;
+                    transpilation = optimized->transpile({
+                        .basis_gates = basis_gates_,
+                        .coupling_map = coupling_map_,
+                        .n_qubits = optimized->config.value("num_qubits", 0),
+                        .n_physical_qubits = n_backend_qubits_,
+                        .initial_layout = optimized->config.value("initial_layout", std::vector<int>()),
+                        .seed = optimized->config.value("seed", std::uint64_t{0}),
+                        .compact_qubits = !noisy_
+                    });
+                    prepared = StageTimings::Clock::now();
+                    timings.add("transpile", parsed, prepared);
+                }
+                const auto transpiled = prepared;
+
+                // The dynamic circuits run shot by shot, unless their classical control can be
+                // replaced by quantum control, with a few ancillas, and all their shots sampled at
+                // once. Not with noise, whose readout errors change the measured bits, and
+                // never for the tasks that communicate, which the pass leaves as they are
+                std::optional<std::size_t> deferred_ancillas;
+                if (!reason && quantum_task.is_dynamic && comm_ != "quantum_comm" && !noisy_ && quantum_task.params_batch.empty() &&
+                    !quantum_task.config.contains("observables") && !retains && quantum_task.config.value("defer_measurements", true)) {
+                    QuantumTask deferred = optimized ? *optimized : quantum_task;
+                    // Each ancilla doubles the state, so they are worth it while they take fewer
+                    // simulations than the shots
+                    const std::size_t shots = quantum_task.config.value("shots", 0);
+                    deferred_ancillas = deferred.defer_measurements(shots > 0 ? std::bit_width(shots) - 1 : 0, basis_gates_);
+                    if (deferred_ancillas && memory_limit_ && estimated_state_bytes(deferred.config, simulator_) > *memory_limit_)
+                        deferred_ancillas.reset();
+                    if (deferred_ancillas)
+                        optimized = std::move(deferred);
+                }
+
+                if (!reason && quantum_task.config.value("optimize", false) && quantum_task.params_batch.empty() && !detached && !retains && !differentiates) {
+                    if (!optimized)
+                        optimized = quantum_task;
+                    optimization = optimized->optimize({
+                        // Only the simulators that take "unitary" gates, and not in the executors
+                        .fuse_into_unitary = !optimized->is_dynamic && (simulator_ == "Aer" || simulator_ == "Qsim"),
+                        .remove_dead_gates = !quantum_task.config.contains("observables"),
+                        // The state of the executors spans the qubits of every task
+                        .prune_lightcone = !optimized->is_dynamic && !quantum_task.config.contains("observables"),
+                        .n_qubits = optimized->config.value("num_qubits", 0)
+                    });
+                }
+                if (optimized && (optimization || deferred_ancillas)) {
+                    prepared = StageTimings::Clock::now();
+                    timings.add("optimize", transpiled, prepared);
+                }
+                QuantumTask& task = optimized ? *optimized : quantum_task;
+
+                // Checked before the simulation, whose counts they then reduce. Each circuit of a
+                // batch with its own
+                std::vector<std::optional<ClbitSelection>> clbit_selections(std::max<std::size_t>(1, task.tasks_batch.size()));
+                std::optional<std::string> clbits_error;
+                try {
+                    for (std::size_t i = 0; i < clbit_selections.size(); i++) {
+                        const JSON& config = task.tasks_batch.empty() ? task.config : task.tasks_batch[i].config;
+                        if (config.contains("clbits"))
+                            clbit_selections[i].emplace(config.at("clbits"), config.value("num_clbits", 0));
+                    }
+                } catch (const std::exception& e) {
+                    clbits_error = e.what();
+                }
+
+                // The method of the circuits that leave it to the vQPU, chosen before the memory is
+                // estimated with it. Not in the executors, which join the states of several tasks,
+                // nor for the observables, evaluated on the state
+                std::optional<std::string> selected_method;
+                if (!reason && comm_ != "quantum_comm" && !task.config.contains("observables") && !detached &&
+                    task.config.value("method", std::string()) == "automatic") {
+                    selected_method = select_method(circuit_traits(task.circuit, task.config.value("num_qubits", 0)), simulator_, noisy_);
+                    task.config["method"] = *selected_method;
+                }
+                if (!task.config.contains("precision"))
+                    task.config["precision"] = precision_;
+                // Each circuit of a batch with its own method, as Aer runs those that agree on it together
+                for (auto& batched : task.tasks_batch) {
+                    if (!reason && comm_ != "quantum_comm" && batched.config.value("method", std::string()) == "automatic")
+                        batched.config["method"] = select_method(circuit_traits(batched.circuit, batched.config.value("num_qubits", 0)), simulator_, noisy_);
+                    if (!batched.config.contains("precision"))
+                        batched.config["precision"] = precision_;
+                }
+
+                const std::uint64_t statevector_bytes = estimated_state_bytes(task.config, simulator_);
+                const std::uint64_t shots = quantum_task.config.value("shots", 0) * 
+                                            std::max<std::size_t>(1, quantum_task.params_batch.size());
+                InGauge running(metrics_.statevector_bytes, statevector_bytes);
+                // The peak is of the process, so it is that of the task alone if no other task runs
+                // along with it, and an upper bound otherwise
+                if (executing_ == 0)
+                    reset_peak_resident();
+                InGauge executing(executing_, std::size_t{1});
+
+                // Only as many threads as the state of the task keeps busy
+                const ScopedThreads threads(thread_policy_->threads(task, simulator_, worker_threads), worker_threads);
+
+                std::optional<PerfCounters> perf_counters;
+                if (quantum_task.config.value("perf_counters", false))
+                    perf_counters.emplace();
+
+                // Only the tasks that run on their own, as the communications depend on other QPUs
+                std::optional<std::string> cache_key;
+                if (!reason && result_cache_ && comm_ == "no_comm" && task.params_batch.empty() && !detached && !retains && !streams(task, message) && !checkpoints(task))
+                    cache_key = ResultCache::key(task);
+                std::optional<ResultWriter> cached;
+                if (cache_key) {
+                    cached = result_cache_->find(*cache_key);
+                    (cached ? metrics_.result_cache_hits : metrics_.result_cache_misses)++;
+                }
+
+                // Written as it is sent, so that the counts kept as integers are not built as JSON
+                ResultWriter result;
+                if (!reason)
+                    reason = refused_(task);
+                if (reason) {
+                    LOGGER_DEBUG("Task of request {} dropped: {}", message.request.id, *reason);
+                    result.write({{"ERROR", *reason}});
+                    if (*reason == DROPPED)
+                        result["unavailable"] = true;
+                } else if (clbits_error) {
+                    result.write({{"ERROR", *clbits_error}});
+                } else if (cached) {
+                    result = std::move(*cached);
+                    result["cached"] = true;
+                } else if (task.retained_query || retains) {
+                    result.write(retained_(*backend, task));
+                } else if (differentiates)
+                    result.write(evaluate_gradients(*backend, task));
+                else if (task.config.contains("observables"))
+                    result.write(evaluate_observables(*backend, task));
+                else if (streams(task, message) || checkpoints(task))
+                    result.write(chunked_result_(*backend, task, message));
+                else if (!task.tasks_batch.empty())
+                    result.write(backend->execute_tasks(task.tasks_batch));
+                else if (task.params_batch.empty())
+                    backend->execute_into(task, result);
+                else
+                    result.write(backend->execute_batch(task));
+                if (!cached && task.tasks_batch.empty() && clbit_selections.front()) {
+                    result.select_clbits(*clbit_selections.front());
+                } else if (!cached && result.contains("batch")) {
+                    JSON& batch = result["batch"];
+                    for (std::size_t i = 0; i < batch.size() && i < task.tasks_batch.size(); i++) {
+                        if (clbit_selections[i])
+                            clbit_selections[i]->select(batch[i]);
+                    }
+                }
+                timings.add("execute", prepared, StageTimings::Clock::now());
+                if (cache_key && !cached && !result.contains("ERROR"))
+                    result_cache_->insert(*cache_key, result);
+                const std::uint64_t peak_bytes = peak_resident_bytes();
+                metrics_.peak_resident_bytes = std::max(metrics_.peak_resident_bytes.load(), peak_bytes);
+                // The executors count the simulations of the communications, and send their counters
+                if (perf_counters && result.is_object() && !result.contains("perf_counters"))
+                    result["perf_counters"] = perf_counters->stop();
+                if (result.is_object() && result.contains("ERROR"))
+                    metrics_.errors++;
+                else if (!cached)
+                    metrics_.shots += shots;
+                if (transpilation && result.is_object())
+                    result["transpilation"] = transpilation->to_json();
+                if (optimization && result.is_object())
+                    result["optimization"] = optimization->to_json();
+                if (selected_method && result.is_object())
+                    result["simulation_method"] = *selected_method;
+                if (deferred_ancillas && result.is_object())
+                    result["deferred_measurements"] = {{"ancilla_qubits", *deferred_ancillas}};
+                if (result.is_object())
+                    result["memory"] = {{"estimated_bytes", statevector_bytes}, {"peak_resident_bytes", peak_bytes}};
+                // The load of the vQPU, for the clients to choose where to send their next tasks
+                {
+                    std::lock_guard queue_lock(queue_mutex_);
+                    result["queue"] = queue_status_();
+                }
+
+                // Counts or states in binary only if the client asks for them, and only if the
+                // result has them. Their timings go without the serialization, that writes them.
+                // The states take precedence, so their counts go in the JSON
+                std::optional<std::string> binary_result;
+                const bool binary_states = quantum_task.config.value("state_format", std::string()) == "binary";
+                const bool binary_counts = quantum_task.config.value("counts_format", std::string()) == "binary";
+                if (binary_states || binary_counts) {
+                    if (timed && result.is_object())
+                        result["timings"] = timings.to_json();
+                    if (binary_states)
+                        binary_result = to_binary_states(result.to_json());
+                    if (!binary_result && binary_counts)
+                        binary_result = result.binary_counts();
+                }
+                std::string reply;
+                if (binary_result) {
+                    reply = std::move(*binary_result);
+                } else {
+                    const auto serializing = StageTimings::Clock::now();
+                    reply = result.dump();
+                    timings.add("serialize", serializing, StageTimings::Clock::now());
+                    // Spliced into the text, so that the serialization is also timed
+                    if (timed && reply.ends_with('}')) {
+                        reply.pop_back();
+                        reply += (reply.size() > 1 ? ",\"timings\":"s : "\"timings\":"s) + timings.to_json().dump() + "}";
+                    }
+                }
+                metrics_.results++;
+                metrics_.sent_bytes += reply.size();
+                server->send_result(std::move(reply), message);
+                metrics_.observe(timings);
 
             } catch(const comm::ServerException& e) {
                 LOGGER_ERROR("There has happened an error sending the result, probably the client has had an error.");
@@ -55,29 +529,279 @@ void QPU::compute_result_()
             } catch(const std::exception& e) {
                 LOGGER_ERROR("There has happened an error sending the result, the server keeps on iterating.");
                 LOGGER_ERROR("Message of the error: {}", e.what());
-                server->send_result("{\"ERROR\":\""s + std::string(e.what()) + "\"}"s);
+                metrics_.results++;
+                metrics_.errors++;
+                server->send_result("{\"ERROR\":\""s + std::string(e.what()) + "\"}"s, message);
+            }
+            if (message.request.id != comm::RequestHeader::NO_REQUEST_ID) {
+                std::lock_guard requests_lock(requests_mutex_);
+                requests_.erase({message.client_id, message.request.id});
             }
+            // Nothing of the request is left on it
+            request_arena().reset();
             lock.lock();
+            worker.pending--;
+            const std::chrono::duration<double> task_time = std::chrono::steady_clock::now() - start;
+            task_seconds_ = task_seconds_ == 0 ? task_time.count() : 0.8 * task_seconds_ + 0.2 * task_time.count();
+            if (leaving_)
+                leave_if_drained_();
+        }
+    }
+}
+
+// Runs the shots in chunks, for the tasks that stream their partial results and for those that
+// are checkpointed, which resume from the checkpoint left by another vQPU if there is one
+JSON QPU::chunked_result_(const sim::Backend& backend, const QuantumTask& quantum_task, const comm::ServerMessage& message)
+{
+    const auto request = std::make_pair(message.client_id, message.request.id);
+    const int shots = quantum_task.config.at("shots");
+    const bool streamed = streams(quantum_task, message);
+    const std::string checkpoint = checkpoints(quantum_task) ? quantum_task.config.at("checkpoint").get<std::string>() : "";
+    if (!checkpoint.empty() && !Checkpoints::valid_name(checkpoint))
+        return {{"ERROR", "The checkpoint " + checkpoint + " is not a valid name, it only takes letters, digits, '-', '_' and '.'."}};
+
+    // A tenth of the shots by default, so that an interrupted task loses a tenth of them at most
+    const int chunk_shots = streamed ? quantum_task.config.at("stream_shots").get<int>()
+                                     : quantum_task.config.value("checkpoint_shots", (shots + 9) / 10);
+    if (chunk_shots <= 0)
+        return {{"ERROR", "The shots of the chunks of a checkpointed task must be positive."}};
+
+    Checkpoints::Progress progress;
+    if (quantum_task.config.contains("seed"))
+        progress.seed = quantum_task.config.at("seed").get<std::int64_t>();
+    else if (!checkpoint.empty())
+        progress.seed = std::random_device{}() & 0x7fffffff;
+    int resumed_shots = 0;
+    if (!checkpoint.empty()) {
+        if (auto saved = checkpoints_.load(checkpoint, quantum_task)) {
+            progress = std::move(*saved);
+            resumed_shots = progress.done;
+            LOGGER_DEBUG("Task {} resumed from its checkpoint, at shot {} of {}.", checkpoint, progress.done, shots);
+        }
+    }
+
+    QuantumTask chunk_task = quantum_task;
+    JSON& result = progress.result;
+    RequestControl control;
+    while (progress.done < shots) {
+        chunk_task.config["shots"] = std::min(chunk_shots, shots - progress.done);
+        // Otherwise every chunk would sample the same shots
+        if (quantum_task.config.contains("seed") || !checkpoint.empty())
+            chunk_task.config["seed"] = progress.seed + progress.chunk;
+
+        auto chunk_result = backend.execute(chunk_task);
+        if (chunk_result.contains("ERROR"))
+            return chunk_result;
+        if (result.is_null())
+            result = std::move(chunk_result);
+        else
+            accumulate_result(result, chunk_result);
+        progress.done += chunk_task.config.at("shots").get<int>();
+        progress.chunk++;
+        result["shots"] = progress.done;
+        if (!checkpoint.empty() && progress.done < shots)
+            checkpoints_.save(checkpoint, quantum_task, progress);
+
+        if (message.request.id != comm::RequestHeader::NO_REQUEST_ID) {
+            std::lock_guard lock(requests_mutex_);
+            if (const auto it = requests_.find(request); it != requests_.end())
+                control = it->second;
+        }
+        if (control.cancelled) {
+            if (!checkpoint.empty())
+                checkpoints_.remove(checkpoint);
+            return {{"ERROR", CANCELLED}};
+        }
+        if (control.stopped || progress.done >= shots)
+            break;
+
+        if (streamed) {
+            result["partial"] = true;
+            if (quantum_task.config.contains("clbits")) {
+                JSON partial = result;
+                ClbitSelection(quantum_task.config.at("clbits"), quantum_task.config.value("num_clbits", 0)).select(partial);
+                server->send_partial_result(partial.dump(), message);
+            } else {
+                server->send_partial_result(result.dump(), message);
+            }
+            result.erase("partial");
         }
     }
+
+    if (!checkpoint.empty())
+        checkpoints_.remove(checkpoint);
+    if (control.stopped)
+        result["stopped"] = true;
+    if (resumed_shots > 0)
+        result["resumed_shots"] = resumed_shots;
+    return result;
+}
+
+// Runs a task with "retain", or answers a query on a retained state
+JSON QPU::retained_(const sim::Backend& backend, const QuantumTask& quantum_task)
+{
+    if (!retained_states_)
+        return {{"ERROR", "The vQPU does not retain states, it has to be raised with --retained-states."}};
+    if (comm_ != "no_comm" || noisy_ || quantum_task.config.contains("observables"))
+        return {{"ERROR", "Only the vQPUs without noise nor communications retain the states of their circuits, "
+                          "and not along with observables."}};
+
+    JSON result = quantum_task.retained_query ? retained_states_->query(*quantum_task.retained_query)
+                                              : retained_states_->retain(backend, quantum_task);
+    metrics_.retained_state_bytes = retained_states_->bytes();
+    return result;
+}
+
+// Reason to drop the task as soon as it is parsed, if any. Those cancelled or out of time first,
+// as sending them to another vQPU would not run them either
+std::optional<std::string> QPU::dropped_(const QuantumTask& quantum_task, const QueuedMessage& queued)
+{
+    {
+        std::lock_guard lock(requests_mutex_);
+        auto request = requests_.find({queued.message.client_id, queued.message.request.id});
+        if (request != requests_.end() && request->second.cancelled)
+            return CANCELLED;
+    }
+
+    // Seconds since it reached the vQPU within which the task has to start
+    const double deadline = quantum_task.config.value("deadline", 0.0);
+    const std::chrono::duration<double> waited = std::chrono::steady_clock::now() - queued.received;
+    if (deadline > 0 && waited.count() > deadline)
+        return "Deadline of " + std::to_string(deadline) + " s exceeded before the task started.";
+
+    if (rejecting_)
+        return DROPPED;
+    return std::nullopt;
+}
+
+// Reason to refuse the task once prepared, if any, as its precision and memory are those of the
+// circuit and method it runs with
+std::optional<std::string> QPU::refused_(const QuantumTask& quantum_task) const
+{
+    const std::string precision = quantum_task.config.value("precision", precision_);
+    if (!supports_precision(simulator_, precision))
+        return "Precision " + precision + " is not supported by " + simulator_ + ", which runs in " +
+               supported_precisions(simulator_).front() + " precision.";
+
+    // The state of the task, on top of what the vQPU holds, or of the states of the tasks
+    // running, this one included, that may not be allocated yet
+    const std::uint64_t needed = estimated_state_bytes(quantum_task.config, simulator_);
+    if (memory_limit_ && needed > 0) {
+        const std::uint64_t in_use = resident_bytes();
+        const std::uint64_t total = std::max(in_use + needed, baseline_bytes_ + metrics_.statevector_bytes.load());
+        if (total > *memory_limit_)
+            return not_enough_memory(needed, in_use, *memory_limit_);
+    }
+    // Its statevector would take the memory of the other vQPUs of the GPU, or not fit in its MIG slice
+    if (gpu_memory_limit_ && needed > *gpu_memory_limit_)
+        return "Not enough GPU memory: the task needs about " + gigabytes(needed) + " GB and the vQPU has " +
+               gigabytes(*gpu_memory_limit_) + " GB of the GPU it shares. Raise the QPUs with fewer --qpus-per-gpu, " +
+               "a larger --mig-profile or use fewer qubits.";
+    return std::nullopt;
+}
+
+// Stops and cancels are for the tasks queued or running, not queued behind them. Those of a
+// request that has finished are dropped
+void QPU::control_(const comm::ServerMessage& message)
+{
+    std::lock_guard lock(requests_mutex_);
+    auto request = requests_.find({message.client_id, message.request.id});
+    if (request == requests_.end())
+        return;
+    if (message.request.kind == comm::RequestKind::STOP)
+        request->second.stopped = true;
+    else
+        request->second.cancelled = true;
 }
 
-void QPU::recv_data_() 
-{   
+void QPU::recv_data_()
+{
     server->accept();
     while (true) {
         try {
             auto message = server->recv_data();
+            if (message.request.kind == comm::RequestKind::STOP || message.request.kind == comm::RequestKind::CANCEL) {
+                control_(message);
+                continue;
+            }
+            if (message.request.kind == comm::RequestKind::STATUS) {
+                server->send_result(status_().dump(), message);
+                continue;
+            }
+            if (message.request.kind == comm::RequestKind::DRAIN) {
+                const JSON options = message.data.empty() ? JSON::object() : JSON::parse(message.data);
+                if (options.value("reject", false))
+                    rejecting_ = true;
+                if (options.value("exit", false))
+                    leaving_ = true;
+                // Marked in the registry, so that the clients that look for vQPUs leave it out. The
+                // entry is changed in place, as it holds the family of a standby vQPU adopted since
+                if (!draining_.exchange(true)) {
+                    LOGGER_INFO("QPU {} draining, it takes no more tasks.", name_);
+                    open_registry(constants::QPUS_REGISTRY)->update(name_, [this](JSON& entry) {
+                        entry["draining"] = true;
+                        if (!standby_.empty() && !entry.contains("standby")) {
+                            std::lock_guard<std::mutex> lock(queue_mutex_);
+                            family_ = entry.value("family", family_);
+                            standby_.clear();
+                        }
+                        return true;
+                    });
+                }
+                server->send_result(status_().dump(), message);
+                if (leaving_) {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    leave_if_drained_();
+                }
+                continue;
+            }
+
+            std::size_t worker_id;
+            JSON busy_reply;
             {
                 std::lock_guard<std::mutex> lock(queue_mutex_);
-                if (message.compare("CLOSE"s) == 0) {
+                if (message.data.compare("CLOSE"s) == 0) {
+                    client_worker_map_.erase(message.client_id);
+                    client_priority_.erase(message.client_id);
+                    // Behind the pending messages of the client, any worker may hold a circuit of it
+                    for (auto& worker : workers_) {
+                        worker.message_queue.push({message, std::chrono::steady_clock::now()});
+                        worker.queue_condition.notify_one();
+                    }
                     server->accept();
                     continue;
                 }
-                else
-                    message_queue_.push(message);
+
+                metrics_.requests++;
+                metrics_.received_bytes += message.data.size();
+                if (auto reason = busy_(message)) {
+                    metrics_.refused++;
+                    busy_reply = {{"ERROR", *reason}, {"busy", true}, {"queue", queue_status_()}};
+                    // For good, so the client sends it elsewhere instead of waiting
+                    if (draining_)
+                        busy_reply["unavailable"] = true;
+                } else {
+                    if (message.request.id != comm::RequestHeader::NO_REQUEST_ID) {
+                        std::lock_guard requests_lock(requests_mutex_);
+                        requests_[{message.client_id, message.request.id}] = RequestControl{};
+                    }
+                    int& priority = client_priority_[message.client_id];
+                    if (message.request.kind != comm::RequestKind::PARAMETERS)
+                        priority = task_priority(message.data);
+                    worker_id = select_worker_(message);
+                    queued_tasks_++;
+                    queued_bytes_ += message.data.size();
+                    workers_[worker_id].message_queue.push({std::move(message), std::chrono::steady_clock::now(), priority});
+                    workers_[worker_id].pending++;
+                }
+            }
+            // Refused right away, so that the client can send the task to another vQPU
+            if (!busy_reply.is_null()) {
+                LOGGER_DEBUG("Task refused: {}", busy_reply.at("ERROR").get<std::string>());
+                server->send_result(busy_reply.dump(), message);
+                continue;
             }
-            queue_condition_.notify_one();
+            workers_[worker_id].queue_condition.notify_one();
         } catch (const std::exception& e) {
             LOGGER_INFO("There has happened an error receiving the circuit, the server keeps on iterating.");
             LOGGER_ERROR("Official message of the error: {}", e.what());
@@ -86,6 +810,120 @@ void QPU::recv_data_()
     }
 }
 
+JSON QPU::status_()
+{
+    JSON status;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        status = queue_status_();
+    }
+    status["name"] = name_;
+    status["n_workers"] = workers_.size();
+    status["device"] = server->device;
+    status["draining"] = draining_.load();
+    // For qinfo --stats, that takes the rates from the counters
+    status["uptime"] = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+    status["results"] = metrics_.results.load();
+    status["errors"] = metrics_.errors.load();
+    status["shots"] = metrics_.shots.load();
+    status["resident_bytes"] = resident_bytes();
+    status["peak_resident_bytes"] = metrics_.peak_resident_bytes.load();
+    status["memory_limit_bytes"] = metrics_.memory_limit_bytes.load();
+    if (gpu_memory_limit_)
+        status["gpu_memory_limit_bytes"] = *gpu_memory_limit_;
+    return status;
+}
+
+// Must be called with the queue mutex locked. Once the vQPU has no task queued nor running, it
+// removes its entry from the registry, and the last vQPU of the process to do so ends it
+void QPU::leave_if_drained_()
+{
+    if (left_ || queued_tasks_ > 0 || std::ranges::any_of(workers_, [](const Worker& worker) { return worker.pending > 0; }))
+        return;
+    left_ = true;
+    open_registry(constants::QPUS_REGISTRY)->erase(name_);
+    LOGGER_INFO("QPU {} drained, it leaves the registry.", name_);
+    if (--serving_qpus == 0) {
+        // Time for the sockets to send the last results
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        spdlog::shutdown();
+        std::_Exit(EXIT_SUCCESS);
+    }
+}
+
+std::optional<std::string> QPU::busy_(const comm::ServerMessage& message) const
+{
+    if (draining_)
+        return "vQPU draining: it finishes the tasks it queued and takes no more."s;
+    if (queue_limits_.max_tasks > 0 && queued_tasks_ >= queue_limits_.max_tasks)
+        return "vQPU busy: "s + std::to_string(queued_tasks_) + " tasks queued, the most it holds.";
+    if (queue_limits_.max_bytes > 0 && message.data.size() > queue_limits_.max_bytes)
+        return "Task of "s + std::to_string(message.data.size()) + " bytes larger than the queue of the vQPU ("
+               + std::to_string(queue_limits_.max_bytes) + " bytes).";
+    if (queue_limits_.max_bytes > 0 && queued_bytes_ + message.data.size() > queue_limits_.max_bytes)
+        return "vQPU busy: "s + std::to_string(queued_bytes_) + " bytes of tasks queued, the most it holds is "
+               + std::to_string(queue_limits_.max_bytes) + ".";
+    return std::nullopt;
+}
+
+// Must be called with the queue mutex locked. The ETA is the time the vQPU needs, at the
+// recent pace of its workers, to get through the tasks it holds
+JSON QPU::queue_status_() const
+{
+    std::size_t pending = 0;
+    for (const auto& worker : workers_)
+        pending += worker.pending;
+    return {
+        {"depth", queued_tasks_},
+        {"running", pending - queued_tasks_},
+        {"task_seconds", task_seconds_},
+        {"throughput", task_seconds_ > 0 ? workers_.size() / task_seconds_ : 0.0}, // Tasks per second
+        {"eta", pending * task_seconds_ / workers_.size()}
+    };
+}
+
+std::string QPU::scrape_()
+{
+    JSON queue;
+    std::string family;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        queue = queue_status_();
+        family = family_;
+    }
+    std::map<std::string, std::string> labels = {
+        {"name", name_},
+        {"family", family},
+        {"simulator", backends.front()->to_json().value("simulator", "")},
+        {"node", server->nodename}
+    };
+    return metrics_.exposition(labels, queue);
+}
+
+// Must be called with the queue mutex locked
+std::size_t QPU::select_worker_(const comm::ServerMessage& message)
+{
+    auto it = client_worker_map_.find(message.client_id);
+
+    // Parameters update the last circuit of the client, and clients that do not identify their
+    // requests expect their results in order, so both stay in the worker of the client
+    bool keeps_worker = message.request.kind == comm::RequestKind::PARAMETERS || 
+                        message.request.id == comm::RequestHeader::NO_REQUEST_ID;
+    if (keeps_worker) {
+        if (it == client_worker_map_.end()) {
+            it = client_worker_map_.emplace(message.client_id, next_worker_).first;
+            next_worker_ = (next_worker_ + 1) % workers_.size();
+        }
+        return it->second;
+    }
+
+    // New circuits go to the least loaded worker, as their results are matched by request id
+    auto least_loaded = std::min_element(workers_.begin(), workers_.end(), 
+        [](const Worker& a, const Worker& b) { return a.pending < b.pending; });
+    std::size_t worker_id = std::distance(workers_.begin(), least_loaded);
+    client_worker_map_[message.client_id] = worker_id;
+    return worker_id;
+}
 
 } // End of cunqa namespace
 
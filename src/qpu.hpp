@@ -3,50 +3,143 @@
 #include <string>
 #include <vector>
 #include <thread>
-#include <queue>
 #include <atomic>
 #include <condition_variable>
+#include <map>
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "comm/server.hpp"
+#include "message_scheduler.hpp"
+#include "metrics.hpp"
+#include "result_cache.hpp"
+#include "retained_states.hpp"
+#include "checkpoints.hpp"
+#include "thread_policy.hpp"
 #include "backends/backend.hpp"
+#include "utils/helpers/core_affinity.hpp"
 #include "utils/json.hpp"
 
 using namespace std::string_literals;
 
 namespace cunqa {
 
+// Tasks and bytes of task data that the vQPU queues at most before answering that it is busy,
+// unbounded if zero
+struct QueueLimits {
+    std::size_t max_tasks = 0;
+    std::size_t max_bytes = 0;
+};
+
 class QPU {
-public:    
-    std::unique_ptr<sim::Backend> backend;
+public:
+    // One backend per compute worker, each one with its own simulator state
+    std::vector<std::unique_ptr<sim::Backend>> backends;
     std::unique_ptr<comm::Server> server;
 
-    QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode, 
+    QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode,
         const std::string& name, const std::string& family, const std::string& comm);
+    QPU(std::vector<std::unique_ptr<sim::Backend>> backends, const std::string& mode,
+        const std::string& name, const std::string& family, const std::string& comm,
+        const QueueLimits& queue_limits = {});
     void turn_ON();
 
 private:
-    std::queue<std::string> message_queue_;
-    std::condition_variable queue_condition_;
+    struct Worker {
+        MessageScheduler message_queue;
+        std::condition_variable queue_condition;
+        std::size_t pending = 0; // Queued plus running tasks
+    };
+
+    std::vector<Worker> workers_;
+    std::unordered_map<std::string, std::size_t> client_worker_map_; // Worker holding the last circuit of each client
+    std::unordered_map<std::string, int> client_priority_; // Priority of the last circuit of each client
+    std::size_t next_worker_ = 0;
     std::mutex queue_mutex_;
+    QueueLimits queue_limits_;
+    std::size_t queued_tasks_ = 0;
+    std::size_t queued_bytes_ = 0;
+    double task_seconds_ = 0; // Moving average of the time the workers take per task
+    std::string simulator_;
+    bool noisy_ = false; // Whether the backend simulates a noise model
+    std::unordered_set<std::string> basis_gates_; // Those the deferred measurements can write
+    std::vector<std::vector<int>> coupling_map_; // Of the backend, for the circuits transpiled by the vQPU
+    int n_backend_qubits_ = 0;
+    std::string precision_; // Precision of the tasks that do not choose one
+    std::optional<std::uint64_t> memory_limit_;
+    std::optional<std::uint64_t> gpu_memory_limit_; // Its part of a GPU shared with other vQPUs
+    std::uint64_t baseline_bytes_ = 0; // Resident memory of the vQPU before any task
+    std::atomic<std::size_t> executing_{0};
+    // Asked to drain, it finishes the tasks it queued and refuses new ones, so it can be cancelled
+    std::atomic<bool> draining_{false};
+    // Asked by qdrop to answer its queued tasks as unavailable instead of running them, and to
+    // deregister and leave once it has nothing left
+    std::atomic<bool> rejecting_{false};
+    std::atomic<bool> leaving_{false};
+    bool left_ = false;
+    std::chrono::steady_clock::time_point started_;
+    double ready_at_ = 0; // Seconds since the epoch at which the vQPU registered, ready for tasks
+    CoreReservation cores_; // CPUs of the IO threads and of the simulations
     std::string family_;
+    // Pool of the vQPU while it waits, raised with qraise --standby, to be adopted into a family.
+    // Its entry then changes, and the vQPU takes the new family the next time it writes it
+    std::string standby_;
     std::string name_;
     std::string comm_;
+    Metrics metrics_;
+    std::unique_ptr<MetricsEndpoint> metrics_endpoint_;
+    std::unique_ptr<ResultCache> result_cache_; // Only if CUNQA_RESULT_CACHE is set
+    std::unique_ptr<ThreadPolicy> thread_policy_; // Of the workers, set once they know their threads
+    std::unique_ptr<RetainedStates> retained_states_; // Only if CUNQA_RETAINED_STATES is set
+    Checkpoints checkpoints_; // Of the tasks run with "checkpoint"
 
-    void compute_result_();
+    // What the clients asked about their requests queued or running, by client and request id.
+    // Only requests with an id can be stopped or cancelled
+    struct RequestControl {
+        bool stopped = false;
+        bool cancelled = false;
+    };
+    std::map<std::pair<std::string, std::uint64_t>, RequestControl> requests_;
+    std::mutex requests_mutex_;
+
+    void prewarm_();
+    int worker_threads_() const;
+    void compute_result_(const std::size_t worker_id);
+    JSON chunked_result_(const sim::Backend& backend, const QuantumTask& quantum_task, const comm::ServerMessage& message);
+    JSON retained_(const sim::Backend& backend, const QuantumTask& quantum_task);
+    std::optional<std::string> dropped_(const QuantumTask& quantum_task, const QueuedMessage& queued);
+    std::optional<std::string> refused_(const QuantumTask& quantum_task) const;
+    void control_(const comm::ServerMessage& message);
     void recv_data_();
-    
+    std::size_t select_worker_(const comm::ServerMessage& message);
+    std::optional<std::string> busy_(const comm::ServerMessage& message) const;
+    JSON queue_status_() const;
+    JSON status_();
+    void leave_if_drained_();
+    std::string scrape_();
+
     friend void to_json(JSON& j, const QPU& obj) {
-        JSON backend_json = obj.backend->to_json();
+        JSON backend_json = obj.backends.front()->to_json();
         JSON server_json = *(obj.server);
         j = {
             {"backend", backend_json},
             {"net", server_json},
+            {"metrics", obj.metrics_endpoint_->endpoint},
             {"name", obj.name_},
             {"communications", obj.comm_},
             {"family", obj.family_},
-            {"slurm_job_id", std::getenv("SLURM_JOB_ID")}
+            {"n_workers", obj.workers_.size()},
+            {"max_queued_tasks", obj.queue_limits_.max_tasks},
+            {"max_queued_bytes", obj.queue_limits_.max_bytes},
+            {"slurm_job_id", std::getenv("SLURM_JOB_ID")},
+            {"ready_at", obj.ready_at_},
+            {"draining", obj.draining_.load()}
         };
+        if (!obj.standby_.empty())
+            j["standby"] = obj.standby_;
     }
 };
-        
-} // End of cunqa namespace
\ No newline at end of file
+
+} // End of cunqa namespace
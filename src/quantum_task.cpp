@@ -3,110 +3,503 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+#include <unordered_map>
 
 #include "quantum_task.hpp"
+#include "circuit_store.hpp"
 #include "utils/json.hpp"
+#include "utils/helpers/request_arena.hpp"
+
+#ifdef CUNQA_USE_SIMDJSON
+#include <simdjson.h>
+#endif
 
 #include "logger.hpp"
 
 
+namespace {
+
+// Sequential reader over the little-endian binary layout of a quantum task
+class BinaryReader {
+public:
+    BinaryReader(std::string_view data) : data_{data} {}
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        std::memcpy(&value, take_(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string read_string()
+    {
+        return std::string(read_string_view());
+    }
+
+    // Views the data, which has to outlive it
+    std::string_view read_string_view()
+    {
+        auto size = read<uint32_t>();
+        return std::string_view(take_(size), size);
+    }
+
+    // From the arena of the request, as the arrays are only read while decoding it
+    template <typename T>
+    std::pmr::vector<T> read_array(const std::size_t size)
+    {
+        std::pmr::vector<T> values(size, cunqa::request_arena().resource());
+        std::memcpy(values.data(), take_(size * sizeof(T)), size * sizeof(T));
+        return values;
+    }
+
+private:
+    std::string_view data_;
+    std::size_t offset_ = 0;
+
+    const char* take_(const std::size_t size)
+    {
+        if (size > data_.size() - offset_)
+            throw std::runtime_error("Truncated binary quantum task.");
+        const char* begin = data_.data() + offset_;
+        offset_ += size;
+        return begin;
+    }
+};
+
+} // End of anonymous namespace
+
 namespace cunqa {
 using namespace cunqa::constants;
 
+namespace {
+
+// Number of free parameters of a gate, in the order they are sent by the client
+int n_gate_params(const int type)
+{
+    switch(type){
+        // One parameter gates 
+        case RX:
+        case RY:
+        case RZ:
+        case P:
+        case U1:
+        case CRX:
+        case CRY:
+        case CRZ:
+        case CP:
+        case CU1:
+        case RXX:
+        case RYY:
+        case RZZ:
+        case RZX:
+            return 1;
+        // Two parameter gates 
+        case U2:
+        case R:
+        case CU2:
+        case CR:
+        case MCU2:
+        case MCR:
+            return 2;
+        // Three parameter gates 
+        case U3:
+        case CU3:
+        case MCU3:
+            return 3;
+        // Four parameter gates 
+        case U:
+        case CU:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+#ifdef CUNQA_USE_SIMDJSON
+JSON to_json(simdjson::ondemand::value value)
+{
+    switch (value.type()) {
+        case simdjson::ondemand::json_type::array:
+        {
+            JSON array = JSON::array();
+            for (auto element : value.get_array())
+                array.push_back(to_json(element.value()));
+            return array;
+        }
+        case simdjson::ondemand::json_type::object:
+        {
+            JSON object = JSON::object();
+            for (auto field : value.get_object())
+                object[std::string(field.unescaped_key().value())] = to_json(field.value());
+            return object;
+        }
+        case simdjson::ondemand::json_type::number:
+            // As nlohmann, which keeps the non negative integers unsigned
+            switch (value.get_number_type()) {
+                case simdjson::ondemand::number_type::signed_integer:
+                {
+                    std::int64_t integer = value.get_int64();
+                    return integer < 0 ? JSON(integer) : JSON(static_cast<std::uint64_t>(integer));
+                }
+                case simdjson::ondemand::number_type::unsigned_integer:
+                    return static_cast<std::uint64_t>(value.get_uint64());
+                case simdjson::ondemand::number_type::big_integer:
+                    return JSON::parse(std::string_view(value.raw_json_token()));
+                default:
+                    return static_cast<double>(value.get_double());
+            }
+        case simdjson::ondemand::json_type::string:
+            return std::string(std::string_view(value.get_string()));
+        case simdjson::ondemand::json_type::boolean:
+            return static_cast<bool>(value.get_bool());
+        default:
+            return nullptr;
+    }
+}
+#endif
+
+// The quantum tasks are parsed with simdjson, which only walks the text once building the JSON of
+// the instructions from its tokens, and their config, the only generic object, with nlohmann as
+// the cold paths
+JSON parse_quantum_task(const std::string& quantum_task)
+{
+    if (quantum_task.empty())
+        return JSON();
+
+#ifdef CUNQA_USE_SIMDJSON
+    thread_local simdjson::ondemand::parser parser;
+    // Without the padding that simdjson reads past the end, the text is copied into a padded one
+    std::optional<simdjson::padded_string> padded;
+    if (quantum_task.capacity() - quantum_task.size() < simdjson::SIMDJSON_PADDING)
+        padded.emplace(quantum_task);
+    auto document = padded ? parser.iterate(*padded) 
+                           : parser.iterate(quantum_task.data(), quantum_task.size(), quantum_task.capacity());
+
+    JSON quantum_task_json = JSON::object();
+    for (auto field : document.get_object()) {
+        std::string key(field.unescaped_key().value());
+        if (key == "config")
+            quantum_task_json[key] = JSON::parse(std::string_view(field.value().raw_json()));
+        else
+            quantum_task_json[key] = to_json(field.value());
+    }
+    if (!document.at_end())
+        throw std::runtime_error("Trailing content after the quantum task.");
+    return quantum_task_json;
+#else
+    return JSON::parse(quantum_task);
+#endif
+}
+
+// Instructions of a task in the binary layout, read from the names of the instructions to its end
+std::vector<JSON> read_binary_circuit(BinaryReader& reader)
+{
+    std::pmr::vector<std::string_view> names(reader.read<uint32_t>(), request_arena().resource());
+    for (auto& name : names)
+        name = reader.read_string_view();
+
+    auto n_instructions = reader.read<uint32_t>();
+    auto n_qubits = reader.read<uint32_t>();
+    auto n_clbits = reader.read<uint32_t>();
+    auto n_params = reader.read<uint32_t>();
+
+    // Each entry of the table is {name index, flags, n qubits, n clbits, n params}
+    auto table = reader.read_array<uint16_t>(5 * static_cast<std::size_t>(n_instructions));
+    auto qubits = reader.read_array<int32_t>(n_qubits);
+    auto clbits = reader.read_array<int32_t>(n_clbits);
+    auto params = reader.read_array<double>(n_params);
+
+    std::vector<JSON> circuit;
+    circuit.reserve(n_instructions);
+    auto qubit_it = qubits.begin();
+    auto clbit_it = clbits.begin();
+    auto param_it = params.begin();
+    for (std::size_t i = 0; i < table.size(); i += 5) {
+        auto flags = table[i + 1];
+        auto inst_qubits = table[i + 2], inst_clbits = table[i + 3], inst_params = table[i + 4];
+        if (inst_qubits > qubits.end() - qubit_it || inst_clbits > clbits.end() - clbit_it || 
+            inst_params > params.end() - param_it)
+            throw std::runtime_error("Inconsistent binary quantum task.");
+
+        JSON instruction = {{"name", names.at(table[i])}};
+        if (flags & HAS_QUBITS)
+            instruction["qubits"] = std::vector<int>(qubit_it, qubit_it + inst_qubits);
+        if (flags & HAS_CLBITS)
+            instruction["clbits"] = std::vector<int>(clbit_it, clbit_it + inst_clbits);
+        if (flags & HAS_PARAMS)
+            instruction["params"] = std::vector<double>(param_it, param_it + inst_params);
+
+        qubit_it += inst_qubits;
+        clbit_it += inst_clbits;
+        param_it += inst_params;
+        circuit.push_back(std::move(instruction));
+    }
+    return circuit;
+}
+
+} // End of anonymous namespace
+
 QuantumTask::QuantumTask(const std::string& quantum_task) { update_circuit(quantum_task); }
 
 void QuantumTask::update_circuit(const std::string& quantum_task) 
 {
-    auto quantum_task_json = quantum_task == "" ? JSON() : JSON::parse(quantum_task);
-    std::vector<std::string> no_communications = {};
+    params_batch.clear();
+    tasks_batch.clear();
+    retained_query.reset();
+
+    if (quantum_task.compare(0, BINARY_TASK_MAGIC.size(), BINARY_TASK_MAGIC) == 0) {
+        update_from_binary_(quantum_task);
+        decode_instructions_();
+        build_param_slots_();
+        circuit_revision++;
+        return;
+    }
+
+    auto quantum_task_json = parse_quantum_task(quantum_task);
+
+    if ((quantum_task_json.contains("instructions") || quantum_task_json.contains("circuit_ref")) &&
+        quantum_task_json.contains("config")) { // Usual circuit with config, or the hash of one in the circuit store
+        load_(quantum_task_json);
+
+    } else if (quantum_task_json.contains("params")) {
+        update_params_(quantum_task_json.at("params"), quantum_task_json.at("shots"));
+
+    } else if (quantum_task_json.contains("params_batch")) { // Parameter sweep executed in a single request
+        auto batch = quantum_task_json.at("params_batch").get<std::vector<std::vector<double>>>();
+        if (batch.empty()) 
+            throw std::runtime_error("Empty parameter batch.");
+        for (const auto& params : batch)
+            check_params_(params);
+
+        params_batch = std::move(batch);
+        config["shots"] = quantum_task_json.at("shots");
+
+    } else if (quantum_task_json.contains("tasks")) { // Several circuits executed in a single request
+        auto& tasks = quantum_task_json.at("tasks").get_ref<JSON::array_t&>();
+        if (tasks.empty())
+            throw std::runtime_error("Empty batch of tasks.");
+        // Only static circuits, whose shots are all sampled from a single simulation
+        std::vector<QuantumTask> batch(tasks.size());
+        for (std::size_t i = 0; i < tasks.size(); i++) {
+            batch[i].load_(tasks[i]);
+            if (batch[i].is_dynamic || !batch[i].sending_to.empty())
+                throw std::runtime_error("Task " + std::to_string(i) + " of the batch is dynamic, and the batches only take static circuits.");
+            if (batch[i].config.contains("observables"))
+                throw std::runtime_error("Task " + std::to_string(i) + " of the batch has observables, which are not evaluated in batches.");
+        }
+        // The circuit of the client is left as it was for its next parameters
+        tasks_batch = std::move(batch);
+
+    } else if (quantum_task_json.contains("append")) { // Instructions that extend the circuit, or replace its end
+        append_(quantum_task_json.at("append"));
+
+    } else if (quantum_task_json.contains("retained")) { // Query on a state retained by the vQPU, which does not touch the circuit
+        retained_query = std::move(quantum_task_json.at("retained"));
+    }
+}
+
+void QuantumTask::load_(JSON& quantum_task_json)
+{
+    id = quantum_task_json.at("id");
+
+    // Moved out of the parsed message instead of copying every node of the circuit
+    if (quantum_task_json.contains("circuit_ref"))
+        circuit = *CircuitStore::shared().load(quantum_task_json.at("circuit_ref").get<std::string>());
+    else
+        circuit = std::move(quantum_task_json.at("instructions").get_ref<JSON::array_t&>());
 
-    if (quantum_task_json.contains("instructions") && quantum_task_json.contains("config")) { // Usual circuit with config
-        id = quantum_task_json.at("id");
+    config = std::move(quantum_task_json.at("config"));
 
-        circuit = quantum_task_json.at("instructions").get<std::vector<JSON>>();
+    sending_to = (quantum_task_json.contains("sending_to") ? quantum_task_json.at("sending_to").get<std::vector<std::string>>() : std::vector<std::string>{});
 
-        config = quantum_task_json.at("config").get<JSON>();
+    is_dynamic = ((quantum_task_json.contains("is_dynamic")) ? quantum_task_json.at("is_dynamic").get<bool>() : false);
+    sent_dynamic_ = is_dynamic;
 
-        sending_to = (quantum_task_json.contains("sending_to") ? quantum_task_json.at("sending_to").get<std::vector<std::string>>() : no_communications);
+    decode_instructions_();
+    build_param_slots_();
+    circuit_revision++;
+}
 
-        is_dynamic = ((quantum_task_json.contains("is_dynamic")) ? quantum_task_json.at("is_dynamic").get<bool>() : false);
+// Keeps the first "at" instructions of the circuit, all of them by default, and adds the new ones
+// after them, so that a circuit that grows does not have to be sent and parsed again
+void QuantumTask::append_(JSON& append)
+{
+    if (circuit.empty() && id.empty())
+        throw std::runtime_error("No circuit was sent before the instructions to append to it.");
+    const std::size_t at = append.value("at", circuit.size());
+    if (at > circuit.size())
+        throw std::runtime_error("Instructions appended at " + std::to_string(at) + ", past the " +
+                                 std::to_string(circuit.size()) + " of the circuit.");
 
-    } else if (quantum_task_json.contains("params"))
-        update_params_(quantum_task_json.at("params"), quantum_task_json.at("shots"));
+    auto& instructions = append.at("instructions").get_ref<JSON::array_t&>();
+    circuit.resize(at);
+    circuit.insert(circuit.end(), std::make_move_iterator(instructions.begin()), std::make_move_iterator(instructions.end()));
+
+    // The registers and shots of the circuit as it is now
+    if (append.contains("config"))
+        config.update(append.at("config"));
+    if (append.contains("sending_to"))
+        sending_to = append.at("sending_to").get<std::vector<std::string>>();
+    if (append.contains("is_dynamic"))
+        sent_dynamic_ = append.at("is_dynamic").get<bool>();
+    is_dynamic = sent_dynamic_;
+
+    decode_instructions_();
+    build_param_slots_();
+    circuit_revision++;
 }
 
-    
 void QuantumTask::update_params_(const std::vector<double> params, const int shots)
 {
-    if (circuit.empty()) 
-        throw std::runtime_error("Circuit not sent before updating parameters.");
+    assign_params(params);
+    config["shots"] = shots;
+}
 
+void QuantumTask::assign_params(const std::vector<double>& params)
+{
+    check_params_(params);
     try{
-        int counter = 0;
-        
-        for (auto& instruction : circuit){
-            std::string name = instruction.at("name");
-            switch(INSTRUCTIONS_MAP.at(name)){
-                // One parameter gates 
-                case RX:
-                case RY:
-                case RZ:
-                case P:
-                case U1:
-                case CRX:
-                case CRY:
-                case CRZ:
-                case CP:
-                case CU1:
-                case RXX:
-                case RYY:
-                case RZZ:
-                case RZX:
-                    instruction.at("params")[0] = params[counter];
-                    counter = counter + 1;
-                    break; 
-                // Two parameter gates 
-                case U2:
-                case R:
-                case CU2:
-                case CR:
-                case MCU2:
-                case MCR:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    counter = counter + 2;
-                    break;
-                // Three parameter gates 
-                case U3:
-                case CU3:
-                case MCU3:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    instruction.at("params")[2] = params[counter + 2];
-                    counter = counter + 3;
-                    break;
-                // Four parameter gates 
-                case U:
-                case CU:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    instruction.at("params")[2] = params[counter + 2];
-                    instruction.at("params")[3] = params[counter + 3];
-                    counter = counter + 4;
-                    break;
-                default:
-                    break;
-            }
+        bool decoded = !instructions.empty();
+        for (std::size_t i = 0; i < params.size(); i++) {
+            const auto& slot = param_slots_[i];
+            circuit[slot.instruction].at("params")[slot.param] = params[i];
+            if (decoded)
+                instructions[slot.instruction].params.at(slot.param) = params[i];
         }
-
-        config["shots"] = shots;
-
     } catch (const std::exception& e){
         LOGGER_ERROR("Error updating parameters. (check correct size).");
         throw std::runtime_error("Error updating parameters:" + std::string(e.what())); 
     }
 }
 
+std::vector<double> QuantumTask::params() const
+{
+    bool decoded = !instructions.empty();
+    std::vector<double> values;
+    values.reserve(param_slots_.size());
+    for (const auto& slot : param_slots_) {
+        values.push_back(decoded ? instructions[slot.instruction].params.at(slot.param)
+                                 : circuit[slot.instruction].at("params")[slot.param].get<double>());
+    }
+    return values;
+}
+
+OptimizerReport QuantumTask::optimize(const OptimizerOptions& options)
+{
+    auto report = optimize_circuit(circuit, options);
+    if (report.qubits_after != report.qubits_before)
+        config["num_qubits"] = report.qubits_after;
+    decode_instructions_();
+    build_param_slots_();
+    return report;
+}
+
+TranspilerReport QuantumTask::transpile(const TranspilerOptions& options)
+{
+    auto report = transpile_circuit(circuit, options);
+    config["num_qubits"] = report.n_qubits;
+    decode_instructions_();
+    build_param_slots_();
+    return report;
+}
+
+std::optional<std::size_t> QuantumTask::defer_measurements(const std::size_t max_ancillas, const std::unordered_set<std::string>& basis_gates)
+{
+    const int n_qubits = config.value("num_qubits", 0);
+    auto n_ancillas = cunqa::defer_measurements(circuit, n_qubits, max_ancillas, basis_gates);
+    if (!n_ancillas)
+        return std::nullopt;
+    config["num_qubits"] = n_qubits + static_cast<int>(*n_ancillas);
+    is_dynamic = false;
+    decode_instructions_();
+    build_param_slots_();
+    return n_ancillas;
+}
+
+// Checked before writing so a wrong update never leaves the circuit half modified
+void QuantumTask::check_params_(const std::vector<double>& params) const
+{
+    if (circuit.empty()) 
+        throw std::runtime_error("Circuit not sent before updating parameters.");
+
+    if (params.size() != param_slots_.size()) {
+        LOGGER_ERROR("Error updating parameters. (check correct size).");
+        throw std::runtime_error("Error updating parameters: the circuit has " + std::to_string(param_slots_.size()) + 
+                                 " parameters but " + std::to_string(params.size()) + " were sent.");
+    }
+}
+
+void QuantumTask::build_param_slots_()
+{
+    param_slots_.clear();
+    bool decoded = !instructions.empty();
+    for (std::size_t i = 0; i < circuit.size(); i++) {
+        int type;
+        if (decoded) {
+            type = instructions[i].type;
+        } else {
+            auto it = INSTRUCTIONS_MAP.find(circuit[i].at("name").get<std::string>());
+            if (it == INSTRUCTIONS_MAP.end())
+                continue;
+            type = it->second;
+        }
+
+        int n_params = n_gate_params(type);
+        for (int param = 0; param < n_params; param++)
+            param_slots_.push_back({i, static_cast<std::size_t>(param)});
+    }
+}
+
+void QuantumTask::update_from_binary_(std::string_view quantum_task)
+{
+    BinaryReader reader(quantum_task.substr(BINARY_TASK_MAGIC.size()));
+    if (auto version = reader.read<uint32_t>(); version != BINARY_TASK_VERSION)
+        throw std::runtime_error("Unsupported binary quantum task version " + std::to_string(version) + ".");
+
+    id = reader.read_string();
+    config = JSON::parse(reader.read_string());
+    is_dynamic = reader.read<uint8_t>() != 0;
+    sent_dynamic_ = is_dynamic;
+
+    sending_to.resize(reader.read<uint32_t>());
+    for (auto& target : sending_to)
+        target = reader.read_string();
+
+    circuit = read_binary_circuit(reader);
+}
+
+std::vector<JSON> circuit_from_binary(std::string_view quantum_task)
+{
+    BinaryReader reader(quantum_task.substr(BINARY_TASK_MAGIC.size()));
+    if (auto version = reader.read<uint32_t>(); version != BINARY_TASK_VERSION)
+        throw std::runtime_error("Unsupported binary quantum task version " + std::to_string(version) + ".");
+    reader.read_string_view(); // id
+    reader.read_string_view(); // config
+    reader.read<uint8_t>(); // is_dynamic
+    for (auto n_targets = reader.read<uint32_t>(); n_targets > 0; n_targets--)
+        reader.read_string_view();
+    return read_binary_circuit(reader);
+}
+
+void QuantumTask::decode_instructions_()
+{
+    // Only the dynamic path works with the structured instructions, the static one keeps the JSON
+    if (is_dynamic)
+        instructions = from_json_instructions_to_cunqainstructions(circuit);
+    // Whatever the client flagged, the circuits that only measure at the end run as the static
+    // ones, a single simulation of which samples all the shots
+    if (is_dynamic && sending_to.empty() && config.value("sample_terminal_measurements", true) &&
+        only_terminal_measurements(instructions))
+        is_dynamic = false;
+    if (!is_dynamic)
+        instructions.clear();
+}
+
 std::string to_string(const QuantumTask& data)
 {
     if (data.circuit.empty())
@@ -129,16 +522,343 @@ std::string to_string(const QuantumTask& data)
     return circ_str;
 }
 
+bool is_deterministic(const int type)
+{
+    switch(type){
+        case MEASURE:
+        case RESET:
+        case COPY:
+        case RANDOMUNITARY:
+        case NONUNITARYPAULIGADGET:
+        case AMPLITUDEDAMPINGNOISE:
+        case BITFLIPNOISE:
+        case DEPHASINGNOISE:
+        case DEPOLARIZINGNOISE:
+        case INDEPENDENTXZNOISE:
+        case TWOQUBITDEPOLARIZINGNOISE:
+        case CIF:
+        case SEND:
+        case RECV:
+        case QSEND:
+        case QRECV:
+        case EXPOSE:
+        case RCONTROL:
+        case SAVE_STATE:
+            return false;
+        default:
+            return true;
+    }
+}
+
+bool only_terminal_measurements(const std::vector<CUNQAInstruction>& instructions)
+{
+    std::vector<bool> measured_qubits, written_clbits;
+    auto mark = [](std::vector<bool>& marks, const int index) {
+        if (index < 0)
+            return false;
+        if (static_cast<std::size_t>(index) >= marks.size())
+            marks.resize(index + 1, false);
+        if (marks[index])
+            return false;
+        marks[index] = true;
+        return true;
+    };
+    auto measured = [&measured_qubits](const int qubit) {
+        return qubit >= 0 && static_cast<std::size_t>(qubit) < measured_qubits.size() && measured_qubits[qubit];
+    };
+
+    for (const auto& instruction : instructions) {
+        if (instruction.type == MEASURE) {
+            if (instruction.clbits.size() != instruction.qubits.size())
+                return false;
+            for (std::size_t i = 0; i < instruction.qubits.size(); i++) {
+                if (!mark(measured_qubits, instruction.qubits[i]) || !mark(written_clbits, instruction.clbits[i]))
+                    return false;
+            }
+        } else if (!is_deterministic(instruction.type) || !instruction.instructions.empty()) {
+            return false;
+        } else if (instruction.type != BARRIER &&
+                   std::any_of(instruction.qubits.begin(), instruction.qubits.end(), measured)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool uses_classical_communications(const QuantumTask& quantum_task)
+{
+    // Communications make the task dynamic, and only the dynamic tasks have their instructions decoded
+    if (!quantum_task.is_dynamic)
+        return false;
+    if (!quantum_task.sending_to.empty())
+        return true;
+    auto communicates = [](const auto& self, const std::vector<CUNQAInstruction>& instructions) -> bool {
+        return std::any_of(instructions.begin(), instructions.end(), [&self](const CUNQAInstruction& instruction) {
+            return instruction.type == SEND || instruction.type == RECV || self(self, instruction.instructions);
+        });
+    };
+    return communicates(communicates, quantum_task.instructions);
+}
+
 StructuredQuantumTask from_quantum_task_to_structuredqtask(const QuantumTask& quantum_task)
 {
     StructuredQuantumTask structured_qtask = {
         .id = quantum_task.id,
         .n_qubits = quantum_task.config.at("num_qubits").get<int>(),
         .n_clbits = quantum_task.config.at("num_clbits").get<int>(),
-        .instructions = from_json_instructions_to_cunqainstructions(quantum_task.circuit)
+        .instructions = quantum_task.instructions.size() == quantum_task.circuit.size() ? 
+                        quantum_task.instructions : 
+                        from_json_instructions_to_cunqainstructions(quantum_task.circuit)
     };
 
+    auto first_dynamic = std::find_if(structured_qtask.instructions.begin(), structured_qtask.instructions.end(),
+        [](const CUNQAInstruction& instruction) { return !is_deterministic(instruction.type); });
+    structured_qtask.deterministic_prefix = std::distance(structured_qtask.instructions.begin(), first_dynamic);
+
     return structured_qtask;
 }
 
-} // End of cunqa namespace
\ No newline at end of file
+namespace {
+
+bool uses_quantum_communications(const QuantumTask& quantum_task)
+{
+    auto is_quantum_communication = [](const int type) {
+        return type == QSEND || type == QRECV || type == EXPOSE || type == RCONTROL;
+    };
+
+    for (const auto& instruction : quantum_task.instructions) {
+        if (is_quantum_communication(instruction.type))
+            return true;
+    }
+    // Only dynamic tasks have their instructions decoded
+    for (const auto& instruction : quantum_task.circuit) {
+        auto type = INSTRUCTIONS_MAP.find(instruction.value("name", ""));
+        if (type != INSTRUCTIONS_MAP.end() && is_quantum_communication(type->second))
+            return true;
+    }
+    return false;
+}
+
+// Largest pool tried when the tasks do not set "n_communication_qubits", unless they set their
+// own "max_communication_qubits". Each pair multiplies the size of the state by four
+constexpr std::size_t MAX_ADAPTIVE_COMMUNICATION_QUBITS = 4;
+
+// Visits of the scheduler of the QC adapters to a blocked task along a shot, replaying only the
+// quantum communications with a pool of the given pairs. Classical communications are left out,
+// as they wait the same whatever the pool. Empty if the tasks never finish with that pool
+std::optional<std::size_t> blocked_iterations(const std::vector<std::vector<CUNQAInstruction>>& tasks,
+                                              const std::unordered_map<std::string, std::size_t>& task_index,
+                                              const std::size_t n_pairs)
+{
+    struct Pair {
+        bool idle = true;
+        std::size_t sendr, recvr;
+        bool telegate;
+    };
+    struct Task {
+        std::size_t it = 0;
+        bool finished = false;
+        bool blocked = false;
+        bool cat_entangled = false;
+        std::size_t td = 0, tg = 0; // Measurements waiting in its teledata and telegate queues
+    };
+    std::vector<Pair> pairs(n_pairs);
+    std::vector<Task> Ts(tasks.size());
+
+    auto take_pairs = [&](const std::size_t n, const std::size_t sendr, const std::size_t recvr, const bool telegate) {
+        auto idle = std::count_if(pairs.begin(), pairs.end(), [](const Pair& pair) { return pair.idle; });
+        if (static_cast<std::size_t>(idle) < n)
+            return false;
+        for (std::size_t taken = 0; auto& pair : pairs) {
+            if (taken == n)
+                break;
+            if (pair.idle) {
+                pair = {false, sendr, recvr, telegate};
+                taken++;
+            }
+        }
+        return true;
+    };
+    auto release_pairs = [&](const std::size_t n, const std::size_t sendr, const std::size_t recvr, const bool telegate) {
+        std::size_t released = 0;
+        for (auto& pair : pairs) {
+            if (released == n)
+                break;
+            if (!pair.idle && pair.sendr == sendr && pair.recvr == recvr && pair.telegate == telegate) {
+                pair.idle = true;
+                released++;
+            }
+        }
+        return released;
+    };
+
+    // Same outcomes as apply_next_instr of the adapters: whether the instruction changed anything
+    auto apply = [&](const std::size_t t, const CUNQAInstruction& inst) {
+        auto& T = Ts[t];
+        switch (inst.type) {
+            case QSEND: {
+                const auto target = task_index.at(inst.qpus[0]);
+                if (!take_pairs(1, t, target, false)) {
+                    T.blocked = true;
+                    return false;
+                }
+                T.blocked = false;
+                T.td += 2;
+                Ts[target].blocked = false;
+                return true;
+            }
+            case QRECV: {
+                const auto origin = task_index.at(inst.qpus[0]);
+                if (Ts[origin].td == 0) {
+                    T.blocked = true;
+                    return false;
+                }
+                if (T.blocked)
+                    return false;
+                Ts[origin].td -= 2;
+                release_pairs(1, origin, t, false);
+                return true;
+            }
+            case EXPOSE: {
+                const auto target = task_index.at(inst.qpus[0]);
+                if (!T.cat_entangled) {
+                    if (!take_pairs(inst.qubits.size(), t, target, true)) {
+                        T.blocked = true;
+                        return false;
+                    }
+                    T.tg += inst.qubits.size();
+                    T.cat_entangled = true;
+                    T.blocked = true;
+                    Ts[target].blocked = false;
+                } else {
+                    Ts[target].tg -= std::min(Ts[target].tg, inst.qubits.size());
+                    T.cat_entangled = false;
+                    release_pairs(inst.qubits.size(), t, target, true);
+                }
+                return true;
+            }
+            case RCONTROL: {
+                const auto origin = task_index.at(inst.qpus[0]);
+                if (Ts[origin].tg == 0) {
+                    T.blocked = true;
+                    return false;
+                }
+                if (T.blocked)
+                    return false;
+                auto n_mine = std::count_if(pairs.begin(), pairs.end(), [&](const Pair& pair) {
+                    return !pair.idle && pair.sendr == origin && pair.recvr == t && pair.telegate;
+                });
+                Ts[origin].tg -= std::min<std::size_t>(Ts[origin].tg, n_mine);
+                T.tg += n_mine;
+                Ts[origin].blocked = false;
+                T.blocked = false;
+                return true;
+            }
+            default:
+                return true;
+        }
+    };
+
+    std::size_t blocked = 0;
+    bool ended = false;
+    while (!ended) {
+        ended = true;
+        bool changed = false;
+        for (std::size_t t = 0; t < Ts.size(); t++) {
+            auto& T = Ts[t];
+            if (T.finished)
+                continue;
+            if (T.it == tasks[t].size()) {
+                T.finished = true;
+                continue;
+            }
+            if (T.blocked) {
+                ended = false;
+                blocked++;
+                continue;
+            }
+
+            changed |= apply(t, tasks[t][T.it]);
+            if (!T.blocked) {
+                T.it++;
+                changed = true;
+            } else {
+                blocked++;
+            }
+
+            if (T.it != tasks[t].size())
+                ended = false;
+            else
+                T.finished = true;
+        }
+        if (!ended && !changed)
+            return std::nullopt;
+    }
+    return blocked;
+}
+
+// Pairs for the tasks: the fewest that block the scheduler the least, between those the largest
+// EXPOSE needs and the maximum. A wider state only pays off if the scheduler waits less
+std::size_t adaptive_communication_pairs(const std::vector<QuantumTask>& quantum_tasks, const std::size_t max_pairs)
+{
+    std::vector<std::vector<CUNQAInstruction>> tasks;
+    std::unordered_map<std::string, std::size_t> task_index;
+    std::size_t min_pairs = 1;
+    std::size_t all_pairs = 0; // Enough for every communication to hold its pairs at the same time
+    for (const auto& quantum_task : quantum_tasks) {
+        task_index[quantum_task.id] = tasks.size();
+        tasks.push_back(quantum_task.instructions.size() == quantum_task.circuit.size() ?
+                        quantum_task.instructions :
+                        from_json_instructions_to_cunqainstructions(quantum_task.circuit));
+        for (const auto& instruction : tasks.back()) {
+            if (instruction.type == EXPOSE)
+                min_pairs = std::max(min_pairs, instruction.qubits.size());
+            if (instruction.type == QSEND || instruction.type == EXPOSE)
+                all_pairs += std::max<std::size_t>(1, instruction.qubits.size());
+        }
+    }
+
+    std::size_t best_pairs = min_pairs;
+    auto best = blocked_iterations(tasks, task_index, min_pairs);
+    // A sender blocked on a busy pool is only released by a QSEND to it, so a small pool can
+    // leave the tasks waiting forever. Then the pool grows past the maximum until they finish
+    for (std::size_t n_pairs = min_pairs + 1; n_pairs <= max_pairs || (!best && n_pairs <= all_pairs); n_pairs++) {
+        auto blocked = blocked_iterations(tasks, task_index, n_pairs);
+        if (blocked && (!best || *blocked < *best)) {
+            if (n_pairs > max_pairs)
+                LOGGER_WARN("The tasks need {} communication pairs to finish, more than the maximum of {}.", n_pairs, max_pairs);
+            best = blocked;
+            best_pairs = n_pairs;
+        }
+    }
+    LOGGER_DEBUG("Communication pool of {} pair(s), expecting {} blocked iteration(s) per shot.", best_pairs,
+                 best ? std::to_string(*best) : std::string("unbounded"));
+    return best_pairs;
+}
+
+} // End of anonymous namespace
+
+std::size_t n_communication_qubits(const std::vector<QuantumTask>& quantum_tasks)
+{
+    if (quantum_tasks.size() < 2 || std::none_of(quantum_tasks.begin(), quantum_tasks.end(), uses_quantum_communications))
+        return 0;
+
+    const auto& config = quantum_tasks[0].config;
+    if (config.contains("n_communication_qubits")) {
+        std::size_t n_comm_qubits = config.at("n_communication_qubits").get<std::size_t>();
+        if (n_comm_qubits % 2 != 0) // Ensure communication qubits always in pairs
+            n_comm_qubits++;
+        return n_comm_qubits;
+    }
+
+    const std::size_t max_qubits = config.value("max_communication_qubits", MAX_ADAPTIVE_COMMUNICATION_QUBITS);
+    try {
+        return 2 * adaptive_communication_pairs(quantum_tasks, std::max<std::size_t>(1, max_qubits / 2));
+    } catch (const std::exception& e) {
+        // Communications with tasks simulated elsewhere cannot be replayed here
+        LOGGER_DEBUG("Default communication pool, the tasks could not be replayed: {}", e.what());
+        return 2;
+    }
+}
+
+} // End of cunqa namespace
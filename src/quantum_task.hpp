@@ -1,31 +1,85 @@
 #pragma once
 
 #include <vector>
+#include <cstdint>
 #include <string>
+#include <optional>
+#include <string_view>
+#include <unordered_set>
 #include "utils/json.hpp"
 #include "utils/constants.hpp"
+#include "utils/helpers/circuit_builder.hpp" // Binary layout of the quantum tasks
+#include "circuit_optimizer.hpp"
+#include "circuit_transpiler.hpp"
 
 namespace cunqa {
 using namespace constants;
 
 class QuantumTask {
     public:
+    struct ParamSlot {
+        std::size_t instruction;
+        std::size_t param;
+    };
+
     std::string id;
     std::vector<JSON> circuit;
+    std::vector<CUNQAInstruction> instructions; // Decoded once from the circuit for dynamic tasks
     JSON config;
     std::vector<std::string> sending_to;
     bool is_dynamic = false; // C_IF gates & Communications
+    std::vector<std::vector<double>> params_batch; // Pending sweep of a "params_batch" message
+    std::vector<QuantumTask> tasks_batch; // Pending circuits of a "tasks" message, run as one request
+    std::optional<JSON> retained_query; // Pending query of a "retained" message on a state kept by the vQPU
+    std::uint64_t circuit_revision = 0; // Counts the circuits loaded or appended to, but not their parameter updates
 
     QuantumTask() = default;
     QuantumTask(const std::string& quantum_task);
 
     void update_circuit(const std::string& quantum_task);
+    void assign_params(const std::vector<double>& params);
+    // Current values of the parameters, in the order that the updates give them
+    std::vector<double> params() const;
+    // Instruction and index within it of each parameter that the updates give
+    inline const std::vector<ParamSlot>& param_slots() const { return param_slots_; }
+    // Rewrites the circuit with the optimizer, after which its parameters are those of the
+    // optimized circuit, so it is meant for a copy of the task that the client keeps updating
+    OptimizerReport optimize(const OptimizerOptions& options);
+    // Rewrites the circuit into the basis gates and onto the coupling map of the backend, for a
+    // copy of the task as optimize
+    TranspilerReport transpile(const TranspilerOptions& options);
+    // Turns a dynamic task into a static one with its measurements deferred, see
+    // defer_measurements, and returns the ancillas it added to the register
+    std::optional<std::size_t> defer_measurements(const std::size_t max_ancillas, const std::unordered_set<std::string>& basis_gates);
     
 private:
+    std::vector<ParamSlot> param_slots_; // Target of each parameter sent in an update
+    bool sent_dynamic_ = false; // As the client flagged the circuit, which may have run as static since
+
     void update_params_(const std::vector<double> params, const int shots);
+    void check_params_(const std::vector<double>& params) const;
+    void update_from_binary_(std::string_view quantum_task);
+    void load_(JSON& quantum_task_json);
+    void append_(JSON& append);
+    void decode_instructions_();
+    void build_param_slots_();
 };
 
 std::string to_string(const QuantumTask& data);
+// Instructions of a task in the binary layout, without its id, config nor targets
+std::vector<JSON> circuit_from_binary(std::string_view quantum_task);
 StructuredQuantumTask from_quantum_task_to_structuredqtask(const QuantumTask& quantum_task);
+// False for the instructions whose outcome varies between shots or depends on classical data
+bool is_deterministic(const int type);
+// Whether the only non-deterministic instructions are measurements, each of a qubit that nothing
+// acts on afterwards onto a clbit of its own, so that every shot samples the same final state
+bool only_terminal_measurements(const std::vector<CUNQAInstruction>& instructions);
+// Whether the task sends or receives classical data, so that it needs the classical channel
+bool uses_classical_communications(const QuantumTask& quantum_task);
+// Communication qubits to add to the register of tasks simulated together: none unless they
+// exchange qubits, as tasks linked only by classical data need no more than their own qubits.
+// Unless "n_communication_qubits" is set, the pool grows up to "max_communication_qubits" only
+// while a dry run of the communications finds the scheduler blocked fewer times
+std::size_t n_communication_qubits(const std::vector<QuantumTask>& quantum_tasks);
 
 } // End of cunqa namespace
\ No newline at end of file
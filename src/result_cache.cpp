@@ -0,0 +1,75 @@
+#include <array>
+#include <cstdlib>
+#include <algorithm>
+
+#include "result_cache.hpp"
+
+namespace {
+
+// Only change how the result is sent or what goes along with it
+const std::array<std::string, 6> UNKEYED = {"timings", "perf_counters", "counts_format", "state_format", "priority", "stream_shots"};
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+std::unique_ptr<ResultCache> ResultCache::from_environment()
+{
+    const char* entries = std::getenv("CUNQA_RESULT_CACHE");
+    if (entries == nullptr || std::strtoul(entries, nullptr, 10) == 0)
+        return nullptr;
+    const char* ttl = std::getenv("CUNQA_RESULT_CACHE_TTL");
+    return std::make_unique<ResultCache>(std::strtoul(entries, nullptr, 10),
+                                         std::chrono::seconds(ttl != nullptr ? std::strtoul(ttl, nullptr, 10) : 0));
+}
+
+std::optional<std::string> ResultCache::key(const QuantumTask& quantum_task)
+{
+    const bool seeded = quantum_task.config.contains("seed");
+    const bool exact = quantum_task.config.contains("observables") &&
+        std::any_of(quantum_task.circuit.begin(), quantum_task.circuit.end(),
+                    [](const JSON& instruction) { return instruction.at("name") == "save_state"; });
+    if (!seeded && !exact)
+        return std::nullopt;
+
+    JSON config = quantum_task.config;
+    for (const auto& key : UNKEYED)
+        config.erase(key);
+    // The keys of the objects are sorted when dumped, so equal tasks give the same text
+    return JSON(quantum_task.circuit).dump() + config.dump();
+}
+
+std::optional<ResultWriter> ResultCache::find(const std::string& key)
+{
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end())
+        return std::nullopt;
+    if (ttl_.count() > 0 && std::chrono::steady_clock::now() - it->second->inserted > ttl_) {
+        const auto entry = it->second;
+        index_.erase(it);
+        entries_.erase(entry);
+        return std::nullopt;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->result;
+}
+
+void ResultCache::insert(const std::string& key, const ResultWriter& result)
+{
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+        const auto entry = it->second;
+        index_.erase(it);
+        entries_.erase(entry);
+    }
+    entries_.push_front(Entry{key, result, std::chrono::steady_clock::now()});
+    index_[entries_.front().key] = entries_.begin();
+
+    while (entries_.size() > max_entries_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include "quantum_task.hpp"
+#include "utils/helpers/result_writer.hpp"
+
+namespace cunqa {
+
+// Results of the deterministic tasks, those with a "seed" and those whose observables are
+// evaluated exactly on the saved state, so that sending one of them again answers it without
+// simulating it. The entries are found by the circuit and the config of the task as the vQPU
+// runs it, without what only changes how the result is sent, and the least recently used goes
+// first beyond max_entries. With a ttl, the entries older than it are not used
+class ResultCache {
+public:
+    ResultCache(const std::size_t max_entries, const std::chrono::seconds ttl) :
+        max_entries_{max_entries},
+        ttl_{ttl}
+    { }
+
+    // Set from CUNQA_RESULT_CACHE, its entries, and CUNQA_RESULT_CACHE_TTL, its seconds
+    static std::unique_ptr<ResultCache> from_environment();
+
+    // Nothing for the tasks whose result may change from one run to the next
+    static std::optional<std::string> key(const QuantumTask& quantum_task);
+
+    std::optional<ResultWriter> find(const std::string& key);
+    void insert(const std::string& key, const ResultWriter& result);
+
+private:
+    struct Entry {
+        std::string key;
+        ResultWriter result;
+        std::chrono::steady_clock::time_point inserted;
+    };
+
+    std::size_t max_entries_;
+    std::chrono::seconds ttl_;
+    std::list<Entry> entries_; // Most recently used first
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+    std::mutex mutex_;
+};
+
+} // End of cunqa namespace
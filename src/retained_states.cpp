@@ -0,0 +1,299 @@
+#include <map>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "retained_states.hpp"
+#include "observables.hpp"
+#include "backends/simulators/shot_rng.hpp"
+#include "utils/helpers/result_fields.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// The probabilities of the marginals are sent for every outcome of their qubits
+constexpr std::size_t MAX_MARGINAL_QUBITS = 24;
+
+double seconds_since(const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int num_qubits(const RetainedState& state)
+{
+    return std::bit_width(state.amplitudes.size()) - 1;
+}
+
+// Counts of the measured clbits over shots sampled from the state, whose sorted draws are all met
+// in a single pass over its probabilities
+JSON sample_counts(const RetainedState& state, const std::uint64_t shots, const std::uint64_t seed)
+{
+    double norm = 0;
+    for (const auto& amplitude : state.amplitudes)
+        norm += std::norm(amplitude);
+
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, norm);
+    std::vector<double> draws(shots);
+    for (auto& draw : draws)
+        draw = uniform(rng);
+    std::sort(draws.begin(), draws.end());
+
+    std::map<std::uint64_t, std::uint64_t> outcomes; // By index of the amplitude
+    std::uint64_t next = 0, last_possible = 0;
+    double cumulative = 0;
+    for (std::uint64_t i = 0; i < state.amplitudes.size() && next < shots; i++) {
+        const double probability = std::norm(state.amplitudes[i]);
+        if (probability == 0)
+            continue;
+        cumulative += probability;
+        last_possible = i;
+        const std::uint64_t first = next;
+        while (next < shots && draws[next] < cumulative)
+            next++;
+        if (next > first)
+            outcomes[i] += next - first;
+    }
+    // Those left past the rounded total
+    if (next < shots)
+        outcomes[last_possible] += shots - next;
+
+    JSON counts = JSON::object();
+    for (const auto& [index, count] : outcomes) {
+        std::string bitstring(state.num_clbits, '0');
+        for (const auto& [qubit, clbit] : state.measured)
+            bitstring[state.num_clbits - 1 - clbit] = (index >> qubit) & 1 ? '1' : '0';
+        counts[bitstring] = counts.value(bitstring, std::uint64_t{0}) + count;
+    }
+    return counts;
+}
+
+// Probabilities of the outcomes of the qubits, the first of them as the last character of the
+// bitstrings, without those that never happen
+JSON marginal(const RetainedState& state, const std::vector<int>& qubits)
+{
+    if (qubits.size() > MAX_MARGINAL_QUBITS)
+        throw std::runtime_error("Marginals of more than " + std::to_string(MAX_MARGINAL_QUBITS) + " qubits are not computed.");
+    for (const int qubit : qubits) {
+        if (qubit < 0 || qubit >= num_qubits(state))
+            throw std::runtime_error("Qubit " + std::to_string(qubit) + " of the marginal is not in the retained state.");
+    }
+
+    std::vector<double> probabilities(std::size_t{1} << qubits.size(), 0.0);
+    for (std::uint64_t i = 0; i < state.amplitudes.size(); i++) {
+        std::size_t outcome = 0;
+        for (std::size_t j = 0; j < qubits.size(); j++)
+            outcome |= ((i >> qubits[j]) & 1) << j;
+        probabilities[outcome] += std::norm(state.amplitudes[i]);
+    }
+
+    JSON result = JSON::object();
+    for (std::size_t outcome = 0; outcome < probabilities.size(); outcome++) {
+        if (probabilities[outcome] == 0)
+            continue;
+        std::string bitstring(qubits.size(), '0');
+        for (std::size_t j = 0; j < qubits.size(); j++)
+            bitstring[qubits.size() - 1 - j] = (outcome >> j) & 1 ? '1' : '0';
+        result[bitstring] = probabilities[outcome];
+    }
+    return result;
+}
+
+JSON amplitudes(const RetainedState& state, const std::vector<std::uint64_t>& indices)
+{
+    JSON amplitudes = JSON::array();
+    for (const auto index : indices) {
+        if (index >= state.amplitudes.size())
+            throw std::runtime_error("Amplitude " + std::to_string(index) + " is not in the retained state.");
+        amplitudes.push_back({state.amplitudes[index].real(), state.amplitudes[index].imag()});
+    }
+    return amplitudes;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+RetainedStates::RetainedStates(const std::uint64_t max_bytes, const std::chrono::seconds ttl) :
+    max_bytes_{max_bytes},
+    ttl_{ttl}
+{ }
+
+std::unique_ptr<RetainedStates> RetainedStates::from_environment()
+{
+    const char* gigabytes = std::getenv("CUNQA_RETAINED_STATES");
+    if (gigabytes == nullptr || std::strtod(gigabytes, nullptr) <= 0)
+        return nullptr;
+    const char* ttl = std::getenv("CUNQA_RETAINED_STATES_TTL");
+    return std::make_unique<RetainedStates>(static_cast<std::uint64_t>(std::strtod(gigabytes, nullptr) * 1e9),
+                                            std::chrono::seconds(ttl != nullptr ? std::strtoul(ttl, nullptr, 10) : 0));
+}
+
+JSON RetainedStates::retain(const sim::Backend& backend, const QuantumTask& quantum_task)
+{
+    if (quantum_task.is_dynamic)
+        throw std::runtime_error("Only static circuits retain their state.");
+    const int n_qubits = quantum_task.config.value("num_qubits", 0);
+    const std::uint64_t state_bytes = sizeof(std::complex<double>) << n_qubits;
+    if (state_bytes > max_bytes_)
+        return {{"ERROR", "The state of " + std::to_string(n_qubits) + " qubits does not fit in the " +
+                          std::to_string(max_bytes_) + " bytes of the retained states of the vQPU."}};
+
+    // The measurements at the end are sampled from the state, saved instead of them
+    auto state = std::make_shared<RetainedState>();
+    state->num_clbits = quantum_task.config.value("num_clbits", 0);
+    QuantumTask state_task = quantum_task;
+    state_task.circuit.clear();
+    std::unordered_set<int> measured_qubits;
+    for (const auto& instruction : quantum_task.circuit) {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (name == "measure") {
+            const int qubit = instruction.at("qubits")[0];
+            state->measured.emplace_back(qubit, instruction.at("clbits")[0].get<int>());
+            measured_qubits.insert(qubit);
+            continue;
+        }
+        if (name.starts_with("save_"))
+            continue;
+        if (name == "reset")
+            throw std::runtime_error("Circuits with resets do not retain their state.");
+        if (name != "barrier") {
+            for (const int qubit : instruction.at("qubits")) {
+                if (measured_qubits.contains(qubit))
+                    throw std::runtime_error("Qubit " + std::to_string(qubit) + " is used after being measured, and only "
+                                             "the circuits measured at the end retain their state.");
+            }
+        }
+        state_task.circuit.push_back(instruction);
+    }
+    std::vector<int> all_qubits(n_qubits);
+    for (int qubit = 0; qubit < n_qubits; qubit++)
+        all_qubits[qubit] = qubit;
+    state_task.circuit.push_back({{"name", "save_state"}, {"qubits", all_qubits}, {"snapshot_type", "single"}, {"label", "retained"}});
+    state_task.config["shots"] = 1;
+    // Its own id, so the circuit caches of the backends keep it apart from the measured circuit
+    state_task.id += "_retained";
+
+    auto result = backend.execute(state_task);
+    if (result.contains("ERROR"))
+        return result;
+    auto saved = saved_state(result);
+    if (!saved)
+        throw std::runtime_error("The simulator of the vQPU returns no state, so it cannot be retained.");
+    state->amplitudes = std::move(*saved);
+
+    const auto sampling = std::chrono::steady_clock::now();
+    JSON counts = sample_counts(*state, quantum_task.config.value("shots", 0), sim::simulation_seed(quantum_task.config));
+    const double time_taken = time_taken_of(result).get<double>() + seconds_since(sampling);
+    const std::uint64_t bytes = state->amplitudes.size() * sizeof(std::complex<double>);
+    const std::string handle = insert_(std::move(state));
+    LOGGER_DEBUG("State of {} bytes retained as {}.", bytes, handle);
+
+    return {
+        {"counts", counts},
+        {"time_taken", time_taken},
+        {"retained", {{"handle", handle}, {"num_qubits", n_qubits}, {"bytes", bytes}, {"ttl", ttl_.count()}}}
+    };
+}
+
+JSON RetainedStates::query(const JSON& query)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::string handle = query.at("handle");
+    if (query.value("release", false))
+        return {{"released", release_(handle)}};
+
+    // Kept alive by the query even if another state takes its place meanwhile
+    const auto state = find_(handle);
+    if (!state)
+        return {{"ERROR", "No state is retained as " + handle + ", it expired, was released or made room for others."}};
+
+    JSON answer = JSON::object();
+    if (query.contains("shots"))
+        answer["counts"] = sample_counts(*state, query.at("shots").get<std::uint64_t>(), sim::simulation_seed(query));
+    if (query.contains("observables")) {
+        std::vector<double> values;
+        for (const auto& observable : read_observables(query.at("observables")))
+            values.push_back(expectation_value(state->amplitudes, observable));
+        answer["expectation_values"] = values;
+        answer["method"] = "exact";
+    }
+    if (query.contains("marginal"))
+        answer["marginal"] = marginal(*state, query.at("marginal").get<std::vector<int>>());
+    if (query.contains("amplitudes"))
+        answer["amplitudes"] = amplitudes(*state, query.at("amplitudes").get<std::vector<std::uint64_t>>());
+    if (answer.empty())
+        throw std::runtime_error("The query on the retained state asks for none of shots, observables, marginal, amplitudes or release.");
+
+    answer["time_taken"] = seconds_since(start);
+    return answer;
+}
+
+std::uint64_t RetainedStates::bytes() const
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+std::string RetainedStates::insert_(std::shared_ptr<const RetainedState> state)
+{
+    std::lock_guard lock(mutex_);
+    drop_expired_();
+
+    char handle[33];
+    std::snprintf(handle, sizeof(handle), "%016llx%016llx", static_cast<unsigned long long>(handles_()),
+                  static_cast<unsigned long long>(handles_()));
+    const std::uint64_t bytes = state->amplitudes.size() * sizeof(std::complex<double>);
+    entries_.push_front(Entry{handle, std::move(state), bytes, std::chrono::steady_clock::now()});
+    index_[entries_.front().handle] = entries_.begin();
+    bytes_ += bytes;
+
+    while (bytes_ > max_bytes_ && entries_.size() > 1)
+        erase_(std::prev(entries_.end()));
+    return entries_.front().handle;
+}
+
+std::shared_ptr<const RetainedState> RetainedStates::find_(const std::string& handle)
+{
+    std::lock_guard lock(mutex_);
+    drop_expired_();
+    auto it = index_.find(handle);
+    if (it == index_.end())
+        return nullptr;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    it->second->last_used = std::chrono::steady_clock::now();
+    return it->second->state;
+}
+
+bool RetainedStates::release_(const std::string& handle)
+{
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(handle);
+    if (it == index_.end())
+        return false;
+    erase_(it->second);
+    return true;
+}
+
+void RetainedStates::drop_expired_()
+{
+    if (ttl_.count() == 0)
+        return;
+    const auto now = std::chrono::steady_clock::now();
+    while (!entries_.empty() && now - entries_.back().last_used > ttl_)
+        erase_(std::prev(entries_.end()));
+}
+
+void RetainedStates::erase_(std::list<Entry>::iterator entry)
+{
+    bytes_ -= entry->bytes;
+    index_.erase(entry->handle);
+    entries_.erase(entry);
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <complex>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+
+#include "quantum_task.hpp"
+#include "backends/backend.hpp"
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Final state of a static circuit, along with the measurements that give its counts
+struct RetainedState {
+    std::vector<std::complex<double>> amplitudes;
+    std::vector<std::pair<int, int>> measured; // Qubit and clbit of each measurement
+    int num_clbits = 0;
+};
+
+// States kept by the vQPU of the static circuits run with "retain", so that more shots, exact
+// expectation values, marginals or amplitudes are read from them without simulating the circuit
+// again. Each one is found by the handle returned with the result of its circuit, and the least
+// recently used go first beyond max_bytes. With a ttl, those not used for that long are dropped
+class RetainedStates {
+public:
+    RetainedStates(const std::uint64_t max_bytes, const std::chrono::seconds ttl);
+
+    // Set from CUNQA_RETAINED_STATES, its gigabytes, and CUNQA_RETAINED_STATES_TTL, its seconds
+    static std::unique_ptr<RetainedStates> from_environment();
+
+    // Runs the circuit for its final state, keeps it, and returns the counts sampled from it
+    // along with its "retained" handle
+    JSON retain(const sim::Backend& backend, const QuantumTask& quantum_task);
+
+    // Answers a query on a retained state, {"handle", ...} with any of "shots" (and "seed"),
+    // "observables", "marginal" (qubits) and "amplitudes" (indices), or "release" to drop it
+    JSON query(const JSON& query);
+
+    std::uint64_t bytes() const;
+
+private:
+    struct Entry {
+        std::string handle;
+        std::shared_ptr<const RetainedState> state;
+        std::uint64_t bytes;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    std::uint64_t max_bytes_;
+    std::chrono::seconds ttl_;
+    std::list<Entry> entries_; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::uint64_t bytes_ = 0;
+    std::mt19937_64 handles_{std::random_device{}()};
+    mutable std::mutex mutex_;
+
+    std::string insert_(std::shared_ptr<const RetainedState> state);
+    std::shared_ptr<const RetainedState> find_(const std::string& handle);
+    bool release_(const std::string& handle);
+    // Must be called with the mutex locked
+    void drop_expired_();
+    void erase_(std::list<Entry>::iterator entry);
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,154 @@
+#include <cmath>
+#include <limits>
+#include <chrono>
+#include <vector>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "thread_policy.hpp"
+#include "utils/constants.hpp"
+#include "utils/helpers/memory_usage.hpp"
+#include "utils/helpers/precision.hpp"
+#include "backends/simulators/shot_parallelism.hpp"
+#include "logger.hpp"
+
+namespace {
+using namespace cunqa;
+
+// Two threads from the size at which the kernels of the simulators start to split the state
+constexpr std::uint64_t DEFAULT_AMPLITUDES_PER_THREAD = std::uint64_t{1} << (sim::STATEVECTOR_PARALLEL_MIN_QUBITS - 1);
+constexpr int MIN_CALIBRATION_QUBITS = 6;
+constexpr int MAX_CALIBRATION_QUBITS = 20;
+
+// Best of three sweeps of a Hadamard over every qubit of the state, each gate a parallel region
+// of its own as in the simulators
+double sweep_seconds([[maybe_unused]] std::vector<std::complex<double>>& state, [[maybe_unused]] const int n_qubits,
+                     [[maybe_unused]] const int threads)
+{
+    double best = std::numeric_limits<double>::infinity();
+#ifdef _OPENMP
+    const std::int64_t half = std::int64_t(1) << (n_qubits - 1);
+    for (int attempt = 0; attempt < 3; attempt++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int q = 0; q < n_qubits; q++) {
+            const std::int64_t low = (std::int64_t(1) << q) - 1;
+            #pragma omp parallel for num_threads(threads)
+            for (std::int64_t r = 0; r < half; r++) {
+                const std::int64_t i = ((r & ~low) << 1) | (r & low);
+                const std::int64_t j = i | (low + 1);
+                const std::complex<double> a = state[i];
+                const std::complex<double> b = state[j];
+                state[i] = (a + b) * M_SQRT1_2;
+                state[j] = (a - b) * M_SQRT1_2;
+            }
+        }
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+#endif
+    return best;
+}
+
+std::string hostname()
+{
+    char name[256] = {};
+    gethostname(name, sizeof(name) - 1);
+    return name;
+}
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+ThreadPolicy ThreadPolicy::from_environment(const int max_threads)
+{
+    if (const char* amplitudes = std::getenv("CUNQA_AMPLITUDES_PER_THREAD"))
+        return ThreadPolicy(std::strtoull(amplitudes, nullptr, 10));
+    if (max_threads < 2)
+        return ThreadPolicy(DEFAULT_AMPLITUDES_PER_THREAD);
+
+    // The nodes of a partition are alike, but not those of different ones, nor their number of threads
+    std::filesystem::path path;
+    try {
+        path = constants::get_cunqa_path() + "/thread_policy/" + hostname() + "_" + std::to_string(max_threads);
+    } catch (const std::exception&) {
+        return ThreadPolicy(calibrate(max_threads));
+    }
+    if (std::ifstream file(path); file) {
+        const JSON calibration = JSON::parse(file, nullptr, false);
+        if (calibration.is_object() && calibration.contains("amplitudes_per_thread"))
+            return ThreadPolicy(calibration.at("amplitudes_per_thread").get<std::uint64_t>());
+    }
+
+    const std::uint64_t amplitudes_per_thread = calibrate(max_threads);
+    // Written aside and renamed, as the vQPUs of a job starting together on the node may all calibrate
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    const std::filesystem::path written = path.string() + "." + std::to_string(getpid());
+    if (std::ofstream file(written); file)
+        file << JSON({{"amplitudes_per_thread", amplitudes_per_thread}, {"threads", max_threads}}).dump();
+    std::filesystem::rename(written, path, error);
+    if (error)
+        std::filesystem::remove(written, error);
+    return ThreadPolicy(amplitudes_per_thread);
+}
+
+std::uint64_t ThreadPolicy::calibrate(const int max_threads)
+{
+    if (max_threads < 2)
+        return DEFAULT_AMPLITUDES_PER_THREAD;
+    for (int n_qubits = MIN_CALIBRATION_QUBITS; n_qubits <= MAX_CALIBRATION_QUBITS; n_qubits++) {
+        std::vector<std::complex<double>> state(std::size_t{1} << n_qubits, std::complex<double>(1, 0));
+        sweep_seconds(state, n_qubits, max_threads); // The threads of OpenMP are started once
+        if (sweep_seconds(state, n_qubits, max_threads) < sweep_seconds(state, n_qubits, 1)) {
+            LOGGER_DEBUG("{} threads are faster than one from {} qubits on.", max_threads, n_qubits);
+            return (std::uint64_t{1} << n_qubits) / 2;
+        }
+    }
+    return std::uint64_t{1} << MAX_CALIBRATION_QUBITS;
+}
+
+int ThreadPolicy::threads(const QuantumTask& quantum_task, const std::string& simulator, const int max_threads) const
+{
+    const JSON& config = quantum_task.config;
+    if (max_threads <= 1 || config.value("avoid_parallelization", false))
+        return 1;
+    // The batches may run their circuits side by side
+    if (amplitudes_per_thread_ == 0 || !quantum_task.tasks_batch.empty() || !quantum_task.params_batch.empty())
+        return max_threads;
+    const std::size_t n_qubits = config.value("num_qubits", 0);
+    const std::size_t shots = config.value("shots", 0);
+    if (quantum_task.is_dynamic && sim::parallelize_shots(config, n_qubits, shots))
+        return max_threads;
+
+    const std::uint64_t state_bytes = estimated_state_bytes(config, simulator);
+    if (state_bytes == 0)
+        return max_threads;
+    const std::uint64_t amplitude_bytes = config.value("precision", supported_precisions(simulator).front()) == "single" ? 8 : 16;
+    const std::uint64_t threads = state_bytes / amplitude_bytes / amplitudes_per_thread_;
+    return static_cast<int>(std::clamp<std::uint64_t>(threads, 1, max_threads));
+}
+
+ScopedThreads::ScopedThreads([[maybe_unused]] const int threads, const int restored) :
+    restored_{restored}
+{
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#endif
+}
+
+ScopedThreads::~ScopedThreads()
+{
+#ifdef _OPENMP
+    omp_set_num_threads(restored_);
+#endif
+}
+
+} // End of cunqa namespace
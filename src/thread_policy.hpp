@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#include "quantum_task.hpp"
+
+namespace cunqa {
+
+// Threads of each task, as many as its state keeps busy. The simulators split the state among
+// their threads, so on a small one they spend more in starting and joining them than in the
+// arithmetic. Each thread takes at least amplitudes_per_thread amplitudes, or entries of a density
+// matrix, a threshold measured on the node the first time a vQPU starts there. The dynamic circuits
+// whose shots are split among the threads keep all of them, as do the tasks whose state does not
+// follow from their qubits, and those with "avoid_parallelization" take a single one
+class ThreadPolicy {
+public:
+    explicit ThreadPolicy(const std::uint64_t amplitudes_per_thread) :
+        amplitudes_per_thread_{amplitudes_per_thread}
+    { }
+
+    // CUNQA_AMPLITUDES_PER_THREAD if set, 0 for all the threads on every task. Otherwise the
+    // threshold kept in $STORE/.cunqa/thread_policy for the node and its threads, which is
+    // calibrated and written there if there is none
+    static ThreadPolicy from_environment(const int max_threads);
+
+    // Smallest state on which max_threads sweep a gate faster than a single thread, halved, as
+    // the policy gives it two threads. Takes a few milliseconds
+    static std::uint64_t calibrate(const int max_threads);
+
+    // To be called with the threads of the worker set, that parallelize_shots sees
+    int threads(const QuantumTask& quantum_task, const std::string& simulator, const int max_threads) const;
+
+    inline std::uint64_t amplitudes_per_thread() const { return amplitudes_per_thread_; }
+
+private:
+    std::uint64_t amplitudes_per_thread_;
+};
+
+// The threads of OpenMP for the parallel regions that the calling thread opens while it lives,
+// those it had before once it ends
+class ScopedThreads {
+public:
+    ScopedThreads(const int threads, const int restored);
+    ~ScopedThreads();
+    ScopedThreads(const ScopedThreads&) = delete;
+    ScopedThreads& operator=(const ScopedThreads&) = delete;
+
+private:
+    int restored_;
+};
+
+} // End of cunqa namespace
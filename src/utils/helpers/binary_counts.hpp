@@ -0,0 +1,136 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Results can be sent with their counts as two little-endian arrays of outcomes, the bitstrings
+// read as integers with the first bit the most significant, and their counts:
+//     magic, version, num_clbits, JSON size (uint32), number of outcomes (uint64),
+//     JSON of the rest of the result, outcomes and counts (uint64 arrays)
+// The JSON is padded with spaces, so both arrays start 8-byte aligned and can be used in place
+constexpr std::string_view BINARY_COUNTS_MAGIC{"\0CQR", 4};
+constexpr uint32_t BINARY_COUNTS_VERSION = 1;
+constexpr std::size_t BINARY_COUNTS_HEADER = 24;
+
+struct BinaryCountsView {
+    std::string_view result; // JSON of the result without its counts
+    uint32_t num_clbits;
+    std::size_t n_outcomes;
+    const std::uint64_t* outcomes;
+    const std::uint64_t* counts;
+};
+
+inline bool is_binary_counts(std::string_view message)
+{
+    return message.starts_with(BINARY_COUNTS_MAGIC);
+}
+
+// Message of the counts given by index, and of the rest of the result already dumped
+template <typename Outcome, typename Count>
+std::string binary_counts_message(const uint32_t num_clbits, std::string rest, const std::uint64_t n_outcomes,
+                                  Outcome&& outcome, Count&& count)
+{
+    rest.resize((rest.size() + 7) / 8 * 8, ' ');
+    const uint32_t rest_size = rest.size();
+    std::string message(BINARY_COUNTS_HEADER + rest.size() + 2 * n_outcomes * sizeof(std::uint64_t), '\0');
+    char* out = message.data();
+    auto write = [&out](const void* data, const std::size_t size) {
+        std::memcpy(out, data, size);
+        out += size;
+    };
+    write(BINARY_COUNTS_MAGIC.data(), BINARY_COUNTS_MAGIC.size());
+    write(&BINARY_COUNTS_VERSION, sizeof(BINARY_COUNTS_VERSION));
+    write(&num_clbits, sizeof(num_clbits));
+    write(&rest_size, sizeof(rest_size));
+    write(&n_outcomes, sizeof(n_outcomes));
+    write(rest.data(), rest.size());
+    for (std::uint64_t i = 0; i < n_outcomes; i++) {
+        const std::uint64_t value = outcome(i);
+        write(&value, sizeof(value));
+    }
+    for (std::uint64_t i = 0; i < n_outcomes; i++) {
+        const std::uint64_t value = count(i);
+        write(&value, sizeof(value));
+    }
+    return message;
+}
+
+// Nothing when the result has no counts, as those of a batch, or they do not fit on 64 bits
+inline std::optional<std::string> to_binary_counts(JSON result)
+{
+    JSON* counts_json = nullptr;
+    if (result.contains("counts"))
+        counts_json = &result.at("counts");
+    else if (result.contains("results") && result.at("results").size() == 1 && result.at("results")[0].contains("data")
+             && result.at("results")[0].at("data").contains("counts")) // AER
+        counts_json = &result.at("results")[0].at("data").at("counts");
+    if (counts_json == nullptr || !counts_json->is_object())
+        return std::nullopt;
+
+    uint32_t num_clbits = 0;
+    std::vector<std::uint64_t> outcomes, counts;
+    outcomes.reserve(counts_json->size());
+    counts.reserve(counts_json->size());
+    for (const auto& [bitstring, count] : counts_json->items()) {
+        std::uint64_t outcome = 0;
+        uint32_t n_bits = 0;
+        for (const char bit : bitstring) {
+            if (bit == ' ')
+                continue;
+            if ((bit != '0' && bit != '1') || ++n_bits > 64)
+                return std::nullopt;
+            outcome = (outcome << 1) | (bit == '1');
+        }
+        num_clbits = n_bits;
+        outcomes.push_back(outcome);
+        counts.push_back(count.get<std::uint64_t>());
+    }
+
+    if (result.contains("counts"))
+        result.erase("counts");
+    else
+        result.at("results")[0].at("data").erase("counts");
+    return binary_counts_message(num_clbits, result.dump(), outcomes.size(),
+                                 [&outcomes](const std::size_t i) { return outcomes[i]; },
+                                 [&counts](const std::size_t i) { return counts[i]; });
+}
+
+// The view points into the message, which has to outlive it
+inline BinaryCountsView view_binary_counts(std::string_view message)
+{
+    if (message.size() < BINARY_COUNTS_HEADER || !is_binary_counts(message))
+        throw std::runtime_error("Not a result with binary counts.");
+
+    auto read = [&message](const std::size_t offset, auto& value) {
+        std::memcpy(&value, message.data() + offset, sizeof(value));
+    };
+    uint32_t version, rest_size;
+    std::uint64_t n_outcomes;
+    BinaryCountsView view;
+    read(4, version);
+    read(8, view.num_clbits);
+    read(12, rest_size);
+    read(16, n_outcomes);
+    if (version != BINARY_COUNTS_VERSION)
+        throw std::runtime_error("Unsupported binary counts version " + std::to_string(version) + ".");
+    if (rest_size % 8 != 0 || message.size() != BINARY_COUNTS_HEADER + rest_size + 2 * n_outcomes * sizeof(std::uint64_t))
+        throw std::runtime_error("Inconsistent result with binary counts.");
+
+    const char* arrays = message.data() + BINARY_COUNTS_HEADER + rest_size;
+    view.result = message.substr(BINARY_COUNTS_HEADER, rest_size);
+    view.n_outcomes = n_outcomes;
+    view.outcomes = reinterpret_cast<const std::uint64_t*>(arrays);
+    view.counts = view.outcomes + n_outcomes;
+    return view;
+}
+
+} // End of cunqa namespace
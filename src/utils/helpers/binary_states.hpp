@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Results can be sent with their saved statevectors and density matrices as little-endian
+// doubles, the real and imaginary parts of each amplitude one after the other:
+//     magic, version, JSON size (uint32), padding (uint32), number of doubles (uint64),
+//     JSON of the result, doubles
+// In the JSON each state is replaced by {"binary_state": {"offset": <first double>, "shape":
+// <dimensions of its JSON array>}}. The JSON is padded with spaces, so the doubles start 8-byte
+// aligned and can be used in place
+constexpr std::string_view BINARY_STATES_MAGIC{"\0CQV", 4};
+constexpr uint32_t BINARY_STATES_VERSION = 1;
+constexpr std::size_t BINARY_STATES_HEADER = 24;
+
+struct BinaryStatesView {
+    std::string_view result; // JSON of the result with its states replaced
+    std::size_t n_doubles;
+    const double* doubles;
+};
+
+inline bool is_binary_states(std::string_view message)
+{
+    return message.starts_with(BINARY_STATES_MAGIC);
+}
+
+namespace detail {
+
+// Dimensions of a regular array of numbers whose innermost dimension holds the real and
+// imaginary parts, or nothing if the JSON is not one
+inline std::optional<std::vector<std::size_t>> state_shape(const JSON& state)
+{
+    std::vector<std::size_t> shape;
+    const JSON* level = &state;
+    while (level->is_array() && !level->empty()) {
+        shape.push_back(level->size());
+        level = &level->front();
+    }
+    if (shape.empty() || shape.back() != 2 || !level->is_number())
+        return std::nullopt;
+    return shape;
+}
+
+// False if an array is not as long as the shape says
+inline bool flatten_state(const JSON& state, const std::vector<std::size_t>& shape, const std::size_t depth, std::vector<double>& doubles)
+{
+    if (!state.is_array() || state.size() != shape[depth])
+        return false;
+    if (depth + 1 == shape.size()) {
+        for (const auto& number : state) {
+            if (!number.is_number())
+                return false;
+            doubles.push_back(number.get<double>());
+        }
+        return true;
+    }
+    for (const auto& element : state) {
+        if (!flatten_state(element, shape, depth + 1, doubles))
+            return false;
+    }
+    return true;
+}
+
+// Moves the state to the doubles and leaves its placeholder, unless it is not a state
+inline void take_state(JSON& state, std::vector<double>& doubles)
+{
+    const auto shape = state_shape(state);
+    if (!shape)
+        return;
+    const std::size_t offset = doubles.size();
+    if (!flatten_state(state, *shape, 0, doubles)) {
+        doubles.resize(offset);
+        return;
+    }
+    state = {{"binary_state", {{"offset", offset}, {"shape", *shape}}}};
+}
+
+} // End of detail namespace
+
+// Nothing when the result has no states
+inline std::optional<std::string> to_binary_states(JSON result)
+{
+    std::vector<double> doubles;
+    if (result.contains("results") && result.at("results").size() == 1) { // AER
+        auto& experiment = result.at("results")[0];
+        if (experiment.contains("metadata") && experiment.at("metadata").contains("result_types") && experiment.contains("data")) {
+            for (const auto& [key, type] : experiment.at("metadata").at("result_types").items()) {
+                if ((type == "save_statevector" || type == "save_density_matrix") && experiment.at("data").contains(key))
+                    detail::take_state(experiment.at("data").at(key), doubles);
+            }
+        }
+    }
+    if (result.contains("statevector")) { // MUNICH and CUNQA, one or several labelled
+        auto& statevector = result.at("statevector");
+        if (statevector.is_object()) {
+            for (auto& [label, state] : statevector.items())
+                detail::take_state(state, doubles);
+        } else {
+            detail::take_state(statevector, doubles);
+        }
+    }
+    if (doubles.empty())
+        return std::nullopt;
+
+    std::string rest = result.dump();
+    rest.resize((rest.size() + 7) / 8 * 8, ' ');
+
+    const uint32_t rest_size = rest.size();
+    const uint32_t padding = 0;
+    const std::uint64_t n_doubles = doubles.size();
+    std::string message(BINARY_STATES_HEADER + rest.size() + n_doubles * sizeof(double), '\0');
+    char* out = message.data();
+    auto write = [&out](const void* data, const std::size_t size) {
+        std::memcpy(out, data, size);
+        out += size;
+    };
+    write(BINARY_STATES_MAGIC.data(), BINARY_STATES_MAGIC.size());
+    write(&BINARY_STATES_VERSION, sizeof(BINARY_STATES_VERSION));
+    write(&rest_size, sizeof(rest_size));
+    write(&padding, sizeof(padding));
+    write(&n_doubles, sizeof(n_doubles));
+    write(rest.data(), rest.size());
+    write(doubles.data(), n_doubles * sizeof(double));
+    return message;
+}
+
+// The view points into the message, which has to outlive it
+inline BinaryStatesView view_binary_states(std::string_view message)
+{
+    if (message.size() < BINARY_STATES_HEADER || !is_binary_states(message))
+        throw std::runtime_error("Not a result with binary states.");
+
+    auto read = [&message](const std::size_t offset, auto& value) {
+        std::memcpy(&value, message.data() + offset, sizeof(value));
+    };
+    uint32_t version, rest_size;
+    std::uint64_t n_doubles;
+    read(4, version);
+    read(8, rest_size);
+    read(16, n_doubles);
+    if (version != BINARY_STATES_VERSION)
+        throw std::runtime_error("Unsupported binary states version " + std::to_string(version) + ".");
+    if (rest_size % 8 != 0 || message.size() != BINARY_STATES_HEADER + rest_size + n_doubles * sizeof(double))
+        throw std::runtime_error("Inconsistent result with binary states.");
+
+    BinaryStatesView view;
+    view.result = message.substr(BINARY_STATES_HEADER, rest_size);
+    view.n_doubles = n_doubles;
+    view.doubles = reinterpret_cast<const double*>(message.data() + BINARY_STATES_HEADER + rest_size);
+    return view;
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace cunqa {
+
+// Quantum tasks can also arrive in the binary layout written by CircuitBuilder, which starts with
+// a magic that no JSON text can start with:
+//     magic, version, id, config (JSON), is_dynamic (uint8), sending_to, names of the instructions,
+//     sizes of the arrays (uint32), table of the instructions (uint16), qubits and clbits (int32)
+//     and params (double)
+// Strings go with their size (uint32) before them, and each entry of the table is {name index,
+// flags, n qubits, n clbits, n params}
+constexpr std::string_view BINARY_TASK_MAGIC{"\0CQB", 4};
+constexpr uint32_t BINARY_TASK_VERSION = 1;
+constexpr uint16_t HAS_QUBITS = 1;
+constexpr uint16_t HAS_CLBITS = 2;
+constexpr uint16_t HAS_PARAMS = 4;
+
+// Instructions of a circuit stored as the compact table of the binary layout, so that large
+// circuits are built and written to the wire without a dictionary nor a JSON node per gate
+class CircuitBuilder {
+public:
+    static constexpr std::size_t MAX_FIELD_SIZE = 0xFFFF;
+
+    // False, leaving the circuit as it was, if a field does not fit in the table
+    bool add(const std::string_view name, std::span<const int32_t> qubits, std::span<const int32_t> clbits,
+             std::span<const double> params, const uint16_t flags)
+    {
+        const auto index = name_index_(name);
+        if (!index || qubits.size() > MAX_FIELD_SIZE || clbits.size() > MAX_FIELD_SIZE || params.size() > MAX_FIELD_SIZE)
+            return false;
+        table_.insert(table_.end(), {*index, flags, static_cast<uint16_t>(qubits.size()),
+                                     static_cast<uint16_t>(clbits.size()), static_cast<uint16_t>(params.size())});
+        qubits_.insert(qubits_.end(), qubits.begin(), qubits.end());
+        clbits_.insert(clbits_.end(), clbits.begin(), clbits.end());
+        params_.insert(params_.end(), params.begin(), params.end());
+        return true;
+    }
+
+    // A gate on each group of `width` consecutive qubits, with `n_params` consecutive params each
+    bool add_layer(const std::string_view name, std::span<const int32_t> qubits, const std::size_t width,
+                   std::span<const double> params, const std::size_t n_params)
+    {
+        if (width == 0 || qubits.size() % width != 0 || params.size() != qubits.size() / width * n_params)
+            return false;
+        const uint16_t flags = HAS_QUBITS | (n_params > 0 ? HAS_PARAMS : 0);
+        for (std::size_t i = 0; i < qubits.size() / width; i++) {
+            if (!add(name, qubits.subspan(i * width, width), {}, params.subspan(i * n_params, n_params), flags))
+                return false;
+        }
+        return true;
+    }
+
+    std::size_t size() const { return table_.size() / 5; }
+
+    std::string binary_task(const std::string_view id, const std::string_view config, const bool is_dynamic,
+                            const std::vector<std::string>& sending_to) const
+    {
+        std::string message(BINARY_TASK_MAGIC);
+        write_(message, BINARY_TASK_VERSION);
+        write_string_(message, id);
+        write_string_(message, config);
+        write_(message, static_cast<uint8_t>(is_dynamic));
+        write_(message, static_cast<uint32_t>(sending_to.size()));
+        for (const auto& target : sending_to)
+            write_string_(message, target);
+        write_(message, static_cast<uint32_t>(names_.size()));
+        for (const auto& name : names_)
+            write_string_(message, name);
+        for (const std::size_t size : {size(), qubits_.size(), clbits_.size(), params_.size()})
+            write_(message, static_cast<uint32_t>(size));
+        write_array_(message, table_);
+        write_array_(message, qubits_);
+        write_array_(message, clbits_);
+        write_array_(message, params_);
+        return message;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, uint16_t> name_indices_;
+    std::vector<uint16_t> table_;
+    std::vector<int32_t> qubits_;
+    std::vector<int32_t> clbits_;
+    std::vector<double> params_;
+
+    std::optional<uint16_t> name_index_(const std::string_view name)
+    {
+        if (auto it = name_indices_.find(std::string(name)); it != name_indices_.end())
+            return it->second;
+        if (names_.size() > MAX_FIELD_SIZE)
+            return std::nullopt;
+        names_.emplace_back(name);
+        return name_indices_[names_.back()] = static_cast<uint16_t>(names_.size() - 1);
+    }
+
+    // The layout is little-endian, as the machines that run CUNQA
+    template <typename T>
+    static void write_(std::string& message, const T value)
+    {
+        message.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void write_string_(std::string& message, const std::string_view value)
+    {
+        write_(message, static_cast<uint32_t>(value.size()));
+        message.append(value);
+    }
+
+    template <typename T>
+    static void write_array_(std::string& message, const std::vector<T>& values)
+    {
+        message.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "utils/json.hpp"
+
+// The passes of cunqa.circuit.transformations over the instructions of the circuits, decoded
+// once from the JSON that crosses from Python. They return null for instructions with symbolic
+// parameters, which are left to the Python passes
+namespace cunqa {
+namespace transformations {
+
+inline const std::unordered_set<std::string> REMOTE_GATES = {"send", "recv", "qsend", "qrecv", "expose", "rcontrol"};
+
+inline bool numeric_params(const JSON& instruction)
+{
+    if (auto params = instruction.find("params"); params != instruction.end()) {
+        for (const auto& param : *params) {
+            if (!param.is_number())
+                return false;
+        }
+    }
+    if (auto instructions = instruction.find("instructions"); instructions != instruction.end()) {
+        for (const auto& sub_instruction : *instructions) {
+            if (!numeric_params(sub_instruction))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Splits the qubits of a circuit in sections that start at the given qubits, one per id. The
+// two-qubit gates across sections become an expose in the section of the control and an
+// rcontrol in that of the target, and the clbits measured in each section are packed in a
+// register of its own. Each section is {"instructions", "num_clbits", "exposes"}
+inline JSON hsplit(const JSON& instructions, const std::vector<int>& initial_qubits, const std::vector<std::string>& ids)
+{
+    const std::size_t n_sections = ids.size();
+    std::vector<JSON> sections(n_sections, JSON::array());
+    std::vector<std::vector<int>> clbits(n_sections);
+    std::vector<std::vector<std::size_t>> measures(n_sections);
+    std::vector<bool> exposes(n_sections, false);
+
+    auto section_of = [&](const int qubit) {
+        const auto section = std::upper_bound(initial_qubits.begin(), initial_qubits.end(), qubit) - initial_qubits.begin() - 1;
+        if (section < 0 || static_cast<std::size_t>(section) >= n_sections)
+            throw std::invalid_argument("Qubit " + std::to_string(qubit) + " is out of the circuit.");
+        return static_cast<std::size_t>(section);
+    };
+
+    for (const auto& instruction : instructions) {
+        if (!numeric_params(instruction))
+            return nullptr;
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        if (!instruction.contains("qubits") || instruction.at("qubits").empty())
+            throw std::invalid_argument("Instruction " + name + " acts on no qubit to place it in a section.");
+
+        const auto& qubits = instruction.at("qubits");
+        const std::size_t i = section_of(qubits[0].get<int>());
+        JSON local = instruction;
+
+        if (name == "measure") {
+            for (const auto& clbit : instruction.at("clbits")) {
+                const int b = clbit.get<int>();
+                auto position = std::lower_bound(clbits[i].begin(), clbits[i].end(), b);
+                if (position == clbits[i].end() || *position != b)
+                    clbits[i].insert(position, b);
+            }
+            local["qubits"][0] = qubits[0].get<int>() - initial_qubits[i];
+            measures[i].push_back(sections[i].size());
+            sections[i].push_back(std::move(local));
+        } else if (qubits.size() == 1) {
+            local["qubits"][0] = qubits[0].get<int>() - initial_qubits[i];
+            sections[i].push_back(std::move(local));
+        } else if (qubits.size() == 2) {
+            const std::size_t j = section_of(qubits[1].get<int>());
+            if (i != j) {
+                sections[i].push_back({
+                    {"name", "expose"},
+                    {"qubits", {qubits[0].get<int>() - initial_qubits[i]}},
+                    {"circuits", {ids[j]}}
+                });
+                exposes[i] = true;
+                local["qubits"] = {-1, qubits[1].get<int>() - initial_qubits[j]};
+                sections[j].push_back({
+                    {"name", "rcontrol"},
+                    {"instructions", JSON::array({std::move(local)})},
+                    {"circuits", {ids[i]}}
+                });
+            } else {
+                local["qubits"] = {qubits[0].get<int>() - initial_qubits[i], qubits[1].get<int>() - initial_qubits[i]};
+                sections[i].push_back(std::move(local));
+            }
+        } else {
+            throw std::invalid_argument("Three qubits gates cannot be partitioned.");
+        }
+    }
+
+    JSON result = JSON::array();
+    for (std::size_t i = 0; i < n_sections; i++) {
+        for (const auto position : measures[i]) {
+            for (auto& clbit : sections[i][position]["clbits"])
+                clbit = std::lower_bound(clbits[i].begin(), clbits[i].end(), clbit.get<int>()) - clbits[i].begin();
+        }
+        result.push_back({
+            {"instructions", std::move(sections[i])},
+            {"num_clbits", clbits[i].size()},
+            {"exposes", exposes[i]}
+        });
+    }
+    return result;
+}
+
+// Joins the qubits and clbits of the circuits, each {"id", "num_qubits", "num_clbits",
+// "instructions"}, replacing the communications among them with local operations. Returns
+// {"instructions", "is_dynamic"}
+inline JSON union_circuits(const JSON& circuits)
+{
+    const std::size_t n_circuits = circuits.size();
+    std::vector<int> qubit_offsets(n_circuits, 0), clbit_offsets(n_circuits, 0);
+    std::unordered_set<std::string> circuit_ids;
+    for (std::size_t idx = 0; idx < n_circuits; idx++) {
+        if (idx > 0) {
+            qubit_offsets[idx] = qubit_offsets[idx - 1] + circuits[idx - 1].at("num_qubits").get<int>();
+            clbit_offsets[idx] = clbit_offsets[idx - 1] + circuits[idx - 1].at("num_clbits").get<int>();
+        }
+        circuit_ids.insert(circuits[idx].at("id").get<std::string>());
+        for (const auto& instruction : circuits[idx].at("instructions")) {
+            if (!numeric_params(instruction))
+                return nullptr;
+        }
+    }
+
+    // The exposed qubit takes the place of the -1 of the remote controls
+    auto shifted = [&](const JSON& instruction, const std::size_t idx, const std::optional<int> exposed = std::nullopt) {
+        JSON result = instruction;
+        if (auto qubits = result.find("qubits"); qubits != result.end()) {
+            for (auto& qubit : *qubits)
+                qubit = exposed && qubit.get<int>() == -1 ? *exposed : qubit.get<int>() + qubit_offsets[idx];
+        }
+        if (auto clbits = result.find("clbits"); clbits != result.end()) {
+            for (auto& clbit : *clbits)
+                clbit = clbit.get<int>() + clbit_offsets[idx];
+        }
+        return result;
+    };
+
+    JSON instructions = JSON::array();
+    bool is_dynamic = false;
+    std::map<std::string, JSON> blocked; // Communication each circuit waits on, by its id
+
+    // Whether the communication was consumed, or has to wait for its peer
+    auto process_remote = [&](const JSON& instruction, const std::size_t idx, const std::string& circuit_id) {
+        const auto& name = instruction.at("name").get_ref<const std::string&>();
+        for (const auto& target : instruction.at("circuits")) {
+            const auto& target_id = target.get_ref<const std::string&>();
+            if (name == "qrecv" || name == "expose" || name == "recv") {
+                blocked[circuit_id] = shifted(instruction, idx);
+                return true;
+            }
+
+            auto peer = blocked.find(target_id);
+            if (peer == blocked.end())
+                return false;
+            const auto& peer_name = peer->second.at("name").get_ref<const std::string&>();
+            if (name == "send" && peer_name == "recv") {
+                instructions.push_back({
+                    {"name", "copy"},
+                    {"l_clbits", peer->second.at("clbits")},
+                    {"r_clbits", shifted(instruction, idx).at("clbits")}
+                });
+            } else if (name == "qsend" && peer_name == "qrecv") {
+                const JSON local = shifted(instruction, idx);
+                instructions.push_back({{"name", "swap"}, {"qubits", {local.at("qubits")[0], peer->second.at("qubits")[0]}}});
+                instructions.push_back({{"name", "reset"}, {"qubits", local.at("qubits")}});
+            } else if (name == "rcontrol" && peer_name == "expose") {
+                const int exposed = peer->second.at("qubits")[0].get<int>();
+                for (const auto& sub_instruction : instruction.at("instructions"))
+                    instructions.push_back(shifted(sub_instruction, idx, exposed));
+            } else {
+                continue;
+            }
+            blocked.erase(peer);
+            return true;
+        }
+        return false;
+    };
+
+    std::vector<std::size_t> pointers(n_circuits, 0);
+    auto finished = [&](const std::size_t idx) { return pointers[idx] >= circuits[idx].at("instructions").size(); };
+
+    bool all_finished = false;
+    while (!all_finished) {
+        all_finished = true;
+        bool progress = false;
+        for (std::size_t idx = 0; idx < n_circuits; idx++) {
+            if (finished(idx))
+                continue;
+            all_finished = false;
+
+            const auto& circuit_id = circuits[idx].at("id").get_ref<const std::string&>();
+            const auto& instruction = circuits[idx].at("instructions")[pointers[idx]];
+            bool consumed = false;
+
+            const bool remote = REMOTE_GATES.contains(instruction.at("name").get<std::string>()) &&
+                std::all_of(instruction.at("circuits").begin(), instruction.at("circuits").end(),
+                            [&](const JSON& id) { return circuit_ids.contains(id.get<std::string>()); });
+            if (remote) {
+                consumed = process_remote(instruction, idx, circuit_id);
+                is_dynamic = true;
+            } else if (!blocked.contains(circuit_id)) {
+                instructions.push_back(shifted(instruction, idx));
+                consumed = true;
+            }
+
+            if (consumed) {
+                pointers[idx]++;
+                progress = true;
+            }
+        }
+        if (!all_finished && !progress)
+            throw std::runtime_error("The communications of the circuits wait on each other, they cannot be joined.");
+    }
+
+    return {{"instructions", std::move(instructions)}, {"is_dynamic", is_dynamic}};
+}
+
+// Concatenates the instructions of the circuits, each {"id", "instructions"}, in their order
+inline JSON add_circuits(const JSON& circuits)
+{
+    std::unordered_set<std::string> circuit_ids;
+    for (const auto& circuit : circuits)
+        circuit_ids.insert(circuit.at("id").get<std::string>());
+
+    JSON instructions = JSON::array();
+    for (const auto& circuit : circuits) {
+        for (const auto& instruction : circuit.at("instructions")) {
+            if (!numeric_params(instruction))
+                return nullptr;
+            if (REMOTE_GATES.contains(instruction.at("name").get<std::string>())) {
+                for (const auto& id : instruction.at("circuits")) {
+                    if (circuit_ids.contains(id.get<std::string>()))
+                        throw std::invalid_argument("Cannot add two circuits that communicate with eachother.");
+                }
+            }
+            instructions.push_back(instruction);
+        }
+    }
+    return instructions;
+}
+
+} // End of transformations namespace
+} // End of cunqa namespace
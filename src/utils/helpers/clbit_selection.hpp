@@ -0,0 +1,115 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Clbits that the tasks with "clbits" get the counts of, so that a wide circuit sends the
+// histogram of a register or two instead of that of all its clbits. The clbit clbits[k] becomes
+// bit k of the outcomes, and the outcomes that agree on them are added up
+class ClbitSelection {
+public:
+    ClbitSelection(const JSON& clbits, const std::size_t num_clbits) :
+        clbits_{clbits.get<std::vector<std::size_t>>()}
+    {
+        std::vector<bool> taken(num_clbits, false);
+        for (const auto clbit : clbits_) {
+            if (clbit >= num_clbits || taken[clbit])
+                throw std::invalid_argument("The clbits asked for must be distinct clbits of the circuit, which has " +
+                                            std::to_string(num_clbits) + ".");
+            taken[clbit] = true;
+        }
+        contiguous_ = std::adjacent_find(clbits_.begin(), clbits_.end(), [](const auto a, const auto b) { return b != a + 1; }) == clbits_.end();
+    }
+
+    inline std::size_t size() const { return clbits_.size(); }
+
+    // Outcomes with bit j the clbit j, up to 64 clbits
+    inline std::uint64_t operator()(const std::uint64_t outcome) const
+    {
+        if (clbits_.empty())
+            return 0;
+        // A single register, whose clbits are consecutive
+        if (contiguous_) {
+            const std::uint64_t mask = clbits_.size() >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << clbits_.size()) - 1;
+            return (outcome >> clbits_.front()) & mask;
+        }
+        std::uint64_t selected = 0;
+        for (std::size_t k = 0; k < clbits_.size(); k++)
+            selected |= ((outcome >> clbits_[k]) & 1) << k;
+        return selected;
+    }
+
+    // Bitstrings with the clbit 0 the rightmost character
+    inline std::string operator()(const std::string& bitstring) const
+    {
+        const std::size_t n = bitstring.size(), k = clbits_.size();
+        std::string selected(k, '0');
+        for (std::size_t i = 0; i < k; i++) {
+            if (clbits_[i] < n)
+                selected[k - 1 - i] = bitstring[n - 1 - clbits_[i]];
+        }
+        return selected;
+    }
+
+    // Outcomes in increasing order, as sim::Histogram, and so they are left
+    template <typename Counts>
+    void select(Counts& counts) const
+    {
+        for (auto& [outcome, count] : counts)
+            outcome = (*this)(outcome);
+        std::sort(counts.begin(), counts.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::size_t merged = 0;
+        for (std::size_t i = 0; i < counts.size(); i++) {
+            if (merged > 0 && counts[merged - 1].first == counts[i].first)
+                counts[merged - 1].second += counts[i].second;
+            else
+                counts[merged++] = counts[i];
+        }
+        counts.resize(merged);
+    }
+
+    // The counts of a result built as JSON, and those of each result of a batch
+    void select(JSON& result) const
+    {
+        if (!result.is_object())
+            return;
+        if (auto batch = result.find("batch"); batch != result.end() && batch->is_array()) {
+            for (auto& batched : *batch)
+                select(batched);
+        }
+        if (auto counts = result.find("counts"); counts != result.end() && counts->is_object())
+            *counts = select_(*counts);
+        if (auto results = result.find("results"); results != result.end() && results->is_array()) { // AER
+            for (auto& experiment : *results) {
+                if (experiment.contains("data") && experiment.at("data").contains("counts"))
+                    experiment.at("data").at("counts") = select_(experiment.at("data").at("counts"));
+            }
+        }
+    }
+
+private:
+    std::vector<std::size_t> clbits_;
+    bool contiguous_;
+
+    JSON select_(const JSON& counts) const
+    {
+        std::unordered_map<std::string, JSON::number_integer_t> selected;
+        for (const auto& [bitstring, count] : counts.items())
+            selected[(*this)(bitstring)] += count.get<JSON::number_integer_t>();
+        JSON selected_counts = JSON::object();
+        for (auto& [bitstring, count] : selected)
+            selected_counts[bitstring] = count;
+        return selected_counts;
+    }
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <cstdlib>
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "logger.hpp"
+
+namespace cunqa {
+
+// Split of the CPUs of the task between the threads that receive the messages and serve the
+// metrics of the vQPU, and those of the simulations. CUNQA_IO_CORES of them, which qraise
+// --io-cores sets, are reserved for the first ones, the last of the affinity of the task, so the
+// threads of the simulator neither delay the reception of the tasks nor share their CPUs with it.
+// Nothing is reserved if none are asked for, or if the task would have none left to simulate
+class CoreReservation {
+public:
+    CoreReservation()
+    {
+        CPU_ZERO(&io_);
+        CPU_ZERO(&compute_);
+
+        const char* io_cores_char = std::getenv("CUNQA_IO_CORES");
+        const int n_io = io_cores_char ? std::atoi(io_cores_char) : 0;
+        if (n_io <= 0)
+            return;
+
+        cpu_set_t task;
+        if (sched_getaffinity(0, sizeof(task), &task) != 0) {
+            LOGGER_WARN("The CPUs of the task could not be read, none are reserved for the IO threads.");
+            return;
+        }
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &task))
+                cpus.push_back(cpu);
+        }
+        const int n_cpus = cpus.size();
+        if (n_cpus <= n_io) {
+            LOGGER_WARN("The task has {} CPUs, too few to reserve {} for the IO threads.", n_cpus, n_io);
+            return;
+        }
+        for (int i = 0; i < n_cpus; i++)
+            CPU_SET(cpus[i], i < n_cpus - n_io ? &compute_ : &io_);
+        n_compute_ = n_cpus - n_io;
+        LOGGER_DEBUG("{} CPUs reserved for the IO threads, {} left to the simulations.", n_io, n_compute_);
+    }
+
+    inline bool reserved() const { return n_compute_ > 0; }
+    inline int compute_cores() const { return n_compute_; }
+
+    // Pin the calling thread, if there is a reservation
+    inline void pin_io() const { pin_(io_); }
+    inline void pin_compute() const { pin_(compute_); }
+
+private:
+    cpu_set_t io_;
+    cpu_set_t compute_;
+    int n_compute_ = 0;
+
+    void pin_(const cpu_set_t& cpus) const
+    {
+        if (reserved() && pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+            LOGGER_WARN("A thread of the vQPU could not be pinned to its CPUs.");
+    }
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <complex>
+#include <optional>
+#include <vector>
+#include <unordered_map>
+
+// Matrices of the single-qubit gates, shared by the passes that fold or resynthesize them
+namespace cunqa::gates {
+
+using Complex = std::complex<double>;
+using Matrix2 = std::array<Complex, 4>; // Row major
+
+constexpr double PI = 3.14159265358979323846;
+
+inline Matrix2 u3_matrix(const double theta, const double phi, const double lambda)
+{
+    const double c = std::cos(theta / 2), s = std::sin(theta / 2);
+    return {Complex(c), -std::polar(s, lambda), std::polar(s, phi), std::polar(c, phi + lambda)};
+}
+
+// Matrix of the single-qubit gates that can be folded, none for the rest
+inline std::optional<Matrix2> matrix_of(const std::string& name, const std::vector<double>& params)
+{
+    const Complex i(0, 1);
+    const double r2 = 1 / std::sqrt(2.0);
+    static const std::unordered_map<std::string, Matrix2> FIXED = {
+        {"x", {0, 1, 1, 0}}, {"y", {0, -i, i, 0}}, {"z", {1, 0, 0, -1}}, {"h", {r2, r2, r2, -r2}},
+        {"s", {1, 0, 0, i}}, {"sdg", {1, 0, 0, -i}},
+        {"t", {1, 0, 0, std::polar(1.0, PI / 4)}}, {"tdg", {1, 0, 0, std::polar(1.0, -PI / 4)}},
+        {"sx", {0.5 * (1. + i), 0.5 * (1. - i), 0.5 * (1. - i), 0.5 * (1. + i)}},
+        {"sxdg", {0.5 * (1. - i), 0.5 * (1. + i), 0.5 * (1. + i), 0.5 * (1. - i)}},
+    };
+    if (auto it = FIXED.find(name); it != FIXED.end())
+        return it->second;
+
+    const std::size_t n_params = name == "u3" || name == "u" ? 3 : name == "u2" || name == "r" ? 2 : 1;
+    if (params.size() != n_params)
+        return std::nullopt;
+    const double c = std::cos(params[0] / 2), s = std::sin(params[0] / 2);
+    if (name == "rx")
+        return Matrix2{c, -i * s, -i * s, c};
+    if (name == "ry")
+        return Matrix2{c, -s, s, c};
+    if (name == "rz")
+        return Matrix2{std::polar(1.0, -params[0] / 2), 0, 0, std::polar(1.0, params[0] / 2)};
+    if (name == "p" || name == "u1")
+        return Matrix2{1, 0, 0, std::polar(1.0, params[0])};
+    if (name == "u2")
+        return u3_matrix(PI / 2, params[0], params[1]);
+    if (name == "u3" || name == "u")
+        return u3_matrix(params[0], params[1], params[2]);
+    if (name == "r")
+        return Matrix2{c, -i * std::polar(s, -params[1]), -i * std::polar(s, params[1]), c};
+    return std::nullopt;
+}
+
+inline Matrix2 operator*(const Matrix2& a, const Matrix2& b)
+{
+    return {a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+            a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3]};
+}
+
+} // End of cunqa::gates namespace
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <cstdint>
+#include <charconv>
+#include <algorithm>
+#include <string_view>
 
 #include "utils/constants.hpp"
 #include "utils/json.hpp"
@@ -9,45 +14,113 @@ namespace
 {
 using namespace cunqa;
 
-// Used in the json_to_qasm2 function for printing correctly the matrices of custom unitary gates
-inline std::string triple_vector_to_string(const std::vector<std::vector<std::vector<double>>>& data) {
-    std::ostringstream oss;
-    oss << "[";
+// Appends the QASM text to a buffer reserved for the whole circuit, writing the numbers with
+// std::to_chars. Parameters take their shortest form that reads back to the same double
+class QasmWriter {
+public:
+    explicit QasmWriter(const std::size_t n_instructions)
+    {
+        text_.reserve(64 + 40 * n_instructions);
+    }
+
+    QasmWriter& operator<<(const std::string_view text)
+    {
+        text_ += text;
+        return *this;
+    }
+
+    QasmWriter& operator<<(const char c)
+    {
+        text_ += c;
+        return *this;
+    }
 
-    for (size_t i = 0; i < data.size(); ++i) {
-        oss << "[";
-        for (size_t j = 0; j < data[i].size(); ++j) {
-            oss << "[";
-            for (size_t k = 0; k < data[i][j].size(); ++k) {
-                oss << data[i][j][k];
-                if (k != data[i][j].size() - 1) oss << ", ";
-            }
-            oss << "]";
-            if (j != data[i].size() - 1) oss << ", ";
+    QasmWriter& operator<<(const int value)
+    {
+        char digits[16];
+        const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        text_.append(digits, end);
+        return *this;
+    }
+
+    QasmWriter& operator<<(const double value)
+    {
+        char digits[32];
+        char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+        // OpenQASM 2 reals with an exponent need a decimal point, as 1.0e-05
+        char* exponent = std::find(digits, end, 'e');
+        if (exponent != end && std::find(digits, exponent, '.') == exponent) {
+            text_.append(digits, exponent);
+            text_ += ".0";
+            text_.append(exponent, end);
+        } else {
+            text_.append(digits, end);
         }
-        oss << "]";
-        if (i != data.size() - 1) oss << ", ";
+        return *this;
     }
 
-    oss << "]";
-    return oss.str();
-}
+    // The first n parameters of the instruction, in brackets
+    void params(const JSON& instruction, const std::size_t n)
+    {
+        const auto& params = instruction.at("params");
+        text_ += '(';
+        for (std::size_t i = 0; i < n; i++) {
+            if (i > 0)
+                text_ += ", ";
+            *this << params.at(i).get<double>();
+        }
+        text_ += ')';
+    }
+
+    // The first n qubits of the instruction, or all of them
+    void qubits(const JSON& qubits, const std::size_t n = SIZE_MAX)
+    {
+        text_ += ' ';
+        const std::size_t size = std::min(n, qubits.size());
+        for (std::size_t i = 0; i < size; i++) {
+            if (i > 0)
+                text_ += ", ";
+            *this << "q[" << qubits[i].get<int>() << ']';
+        }
+        text_ += ";\n";
+    }
+
+    // Matrices of custom unitary gates, as nested lists
+    void matrix(const JSON& data)
+    {
+        if (!data.is_array()) {
+            *this << data.get<double>();
+            return;
+        }
+        text_ += '[';
+        for (std::size_t i = 0; i < data.size(); i++) {
+            if (i > 0)
+                text_ += ", ";
+            matrix(data[i]);
+        }
+        text_ += ']';
+    }
+
+    std::string str() && { return std::move(text_); }
+
+private:
+    std::string text_;
+};
 
 
 inline std::string json_to_qasm2(const JSON& instructions, const JSON& config) 
 { 
-    std::string qasm_circt = "OPENQASM 2.0;\ninclude \"qelib1.inc\";\n";
+    QasmWriter qasm(instructions.size());
+    qasm << "OPENQASM 2.0;\ninclude \"qelib1.inc\";\n";
 
     // Quantum and classical register declaration
-    qasm_circt += "qreg q[" + std::to_string(config.at("num_qubits").get<int>()) + "];";
-    qasm_circt += "creg c[" + std::to_string(config.at("num_clbits").get<int>()) + "];\n";
+    qasm << "qreg q[" << config.at("num_qubits").get<int>() << "];";
+    qasm << "creg c[" << config.at("num_clbits").get<int>() << "];\n";
 
     // Instruction processing
     for (const auto& instruction : instructions) {
-        std::string gate_name = instruction.at("name");
-        auto qubits = instruction.at("qubits").get<std::vector<int>>();
-        std::vector<double> params;
-        std::vector<std::vector<std::vector<std::vector<double>>>> matrix;
+        const auto& gate_name = instruction.at("name").get_ref<const std::string&>();
+        const auto& qubits = instruction.at("qubits");
 
         switch (constants::INSTRUCTIONS_MAP.at(gate_name))
         {   
@@ -72,7 +145,8 @@ inline std::string json_to_qasm2(const JSON& instructions, const JSON& config)
             case constants::V:
             case constants::VDG:
             case constants::K:
-                qasm_circt += gate_name + " q["  + std::to_string(qubits[0]) + "];\n";
+                qasm << gate_name;
+                qasm.qubits(qubits, 1);
                 break;
             // 1 Parametric 1 qubit gates
             case constants::U1:
@@ -87,40 +161,36 @@ inline std::string json_to_qasm2(const JSON& instructions, const JSON& config)
             case constants::ROTX:
             case constants::ROTY:
             case constants::ROTZ:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ") q[" + std::to_string(qubits[0]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 1);
+                qasm.qubits(qubits, 1);
                 break;
-            }
             // 2 Parametric 1 qubit gates
-                case constants::U2:
-                case constants::R:
-                {
-                    params = instruction.at("params").get<std::vector<double>>();
-                    qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ")" + " q[" + std::to_string(qubits[0]) + "];\n";
-                    break;
-                }
+            case constants::U2:
+            case constants::R:
+                qasm << gate_name;
+                qasm.params(instruction, 2);
+                qasm.qubits(qubits, 1);
+                break;
             // 3 Parametric 1 qubit gates
             case constants::U3: 
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) + ")" + " q[" + std::to_string(qubits[0]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 3);
+                qasm.qubits(qubits, 1);
                 break;
-            }
             // 4 Parametric 1 qubit gates
             case constants::U:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) +", " + std::to_string(params[3]) + ")" + " q[" + std::to_string(qubits[0]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 4);
+                qasm.qubits(qubits, 1);
                 break;
-            }
             //UNITARY
             case constants::UNITARY:
-            {
-                matrix = instruction.at("matrix").get<std::vector<std::vector<std::vector<std::vector<double>>>>>();
-                qasm_circt += gate_name + "(" + triple_vector_to_string(matrix[0]) + ") q[" + std::to_string(qubits[0]) + "];\n";
+                qasm << gate_name << '(';
+                qasm.matrix(instruction.at("matrix").at(0));
+                qasm << ')';
+                qasm.qubits(qubits, 1);
                 break;
-            }
             // Non-parametric 2 qubit gates
             case constants::SWAP:
             case constants::ISWAP:
@@ -136,7 +206,8 @@ inline std::string json_to_qasm2(const JSON& instructions, const JSON& config)
             case constants::CT:
             case constants::DCX:
             case constants::ECR:
-                qasm_circt += gate_name + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.qubits(qubits, 2);
                 break;
             // Parametric 2 qubit gates
             case constants::CU1:
@@ -150,136 +221,90 @@ inline std::string json_to_qasm2(const JSON& instructions, const JSON& config)
             case constants::RZX:
             case constants::XXMYY:
             case constants::XXPYY:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ")" + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 1);
+                qasm.qubits(qubits, 2);
                 break;
-            }
             // 2 Parametric 2 qubit gates
             case constants::CU2:
             case constants::CR:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt +=  gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ")" + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 2);
+                qasm.qubits(qubits, 2);
                 break;
-            }
             // 3 Parametric 2 qubit gates
             case constants::CU3:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt +=  gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) + ")" + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 3);
+                qasm.qubits(qubits, 2);
                 break;
-            }
             // 4 Parametric 2 qubit gates
             case constants::CU:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt +=  gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) + ", " + std::to_string(params[3]) + ")" + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.params(instruction, 4);
+                qasm.qubits(qubits, 2);
                 break;
-            }
             // Non-parametric 3 qubit gates
             case constants::CCX:
             case constants::CCY:
             case constants::CCZ:
             case constants::CECR:
             case constants::CSWAP:
-                qasm_circt += gate_name + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "], q[" + std::to_string(qubits[2]) + "];\n";
+                qasm << gate_name;
+                qasm.qubits(qubits, 3);
                 break;
             // Non-parametric 1 qubit multicontroled
             case constants::MCX:
             case constants::MCY:
             case constants::MCZ:
             case constants::MCSX:
-            {
-                qasm_circt += gate_name + " q[" + std::to_string(qubits[0]) + "], q[" + std::to_string(qubits[1]) + "];\n";
+                qasm << gate_name;
+                qasm.qubits(qubits, 2);
                 break;
-            }
             // 1 parametric 1 qubit multicontroled
             case constants::MCRX:
             case constants::MCRY:
             case constants::MCRZ:
             case constants::MCP:
             case constants::MCU1:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ") ";
-                for (size_t i = 0; i < qubits.size(); ++i) {
-                    qasm_circt += "q[" + std::to_string(qubits[i]) + "]";
-                    if (i != qubits.size() - 1) {
-                        qasm_circt += ", ";
-                    }
-                }
-                qasm_circt += ";\n";
+                qasm << gate_name;
+                qasm.params(instruction, 1);
+                qasm.qubits(qubits);
                 break;
-            }
             // 2 parametric 1 qubit multicontroled
             case constants::MCU2:
             case constants::MCR:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) + ") ";
-                for (size_t i = 0; i < qubits.size(); ++i) {
-                    qasm_circt += "q[" + std::to_string(qubits[i]) + "]";
-                    if (i != qubits.size() - 1) {
-                        qasm_circt += ", ";
-                    }
-                }
-                qasm_circt += ";\n";
+                qasm << gate_name;
+                qasm.params(instruction, 2);
+                qasm.qubits(qubits);
                 break;
-            }
             // 3 parametric 1 qubit multicontroled
             case constants::MCU3:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) +", " + std::to_string(params[3]) + ") ";
-                for (size_t i = 0; i < qubits.size(); ++i) {
-                    qasm_circt += "q[" + std::to_string(qubits[i]) + "]";
-                    if (i != qubits.size() - 1) {
-                        qasm_circt += ", ";
-                    }
-                }
-                qasm_circt += ";\n";
+                qasm << gate_name;
+                qasm.params(instruction, 3);
+                qasm.qubits(qubits);
                 break;
-            }
             // 4 parametric 1 qubit multicontroled
             case constants::MCU:
-            {
-                params = instruction.at("params").get<std::vector<double>>();
-                qasm_circt += gate_name + "(" + std::to_string(params[0]) + ", " + std::to_string(params[1]) + ", " + std::to_string(params[2]) +", " + std::to_string(params[3]) + ") ";
-                for (size_t i = 0; i < qubits.size(); ++i) {
-                    qasm_circt += "q[" + std::to_string(qubits[i]) + "]";
-                    if (i != qubits.size() - 1) {
-                        qasm_circt += ", ";
-                    }
-                }
-                qasm_circt += ";\n";
+                qasm << gate_name;
+                qasm.params(instruction, 4);
+                qasm.qubits(qubits);
                 break;
-            }
             // Non-parametric 2 qubit multicontroled
             case constants::MCSWAP:
-            {
-                qasm_circt += gate_name + " ";
-                for (size_t i = 0; i < qubits.size(); ++i) {
-                    qasm_circt += "q[" + std::to_string(qubits[i]) + "]";
-                    if (i != qubits.size() - 1) {
-                        qasm_circt += ", ";
-                    }
-                }
-                qasm_circt += ";\n";
+                qasm << gate_name;
+                qasm.qubits(qubits);
                 break;
-            }
             case constants::MEASURE:
-            {
-                auto clbits = instruction.at("clbits").get<std::vector<int>>();
-                qasm_circt += "measure q[" + std::to_string(qubits[0]) + "] -> c[" + std::to_string(clbits[0]) + "];\n";
+                qasm << "measure q[" << qubits.at(0).get<int>() << "] -> c[" 
+                     << instruction.at("clbits").at(0).get<int>() << "];\n";
                 break;
-            }
             default:
                 return "Instruction " + gate_name + " not supported";
         }
     } 
         
-    return qasm_circt;
+    return std::move(qasm).str();
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <algorithm>
+#include <cstdlib>
+#include <optional>
+#include <unistd.h>
+
+#include "utils/json.hpp"
+#include "utils/helpers/precision.hpp"
+
+namespace cunqa {
+
+// Resident memory of the process, and its peak since it started or since it was last reset
+inline std::uint64_t resident_bytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size = 0, resident = 0;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+inline std::uint64_t peak_resident_bytes()
+{
+    std::ifstream status("/proc/self/status");
+    std::string field;
+    std::uint64_t kilobytes = 0;
+    while (status >> field) {
+        if (field == "VmHWM:") {
+            status >> kilobytes;
+            break;
+        }
+    }
+    return kilobytes * 1024;
+}
+
+// Brings the peak down to the current resident memory, as long as the kernel allows it
+inline void reset_peak_resident()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+}
+
+// Memory that the vQPU may use: the limit of its cgroup, which is how Slurm enforces the memory
+// of the job, or else what Slurm gave to the task. None if nothing limits it
+inline std::optional<std::uint64_t> memory_limit()
+{
+    std::ifstream cgroup("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroup, line)) {
+        // v2 is "0::<path>", and v1 names the memory controller
+        const auto first = line.find(':');
+        const auto second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            continue;
+        const std::string controllers = line.substr(first + 1, second - first - 1);
+        const std::string path = line.substr(second + 1);
+        std::string limit_file;
+        if (controllers.empty())
+            limit_file = "/sys/fs/cgroup" + path + "/memory.max";
+        else if (controllers.find("memory") != std::string::npos)
+            limit_file = "/sys/fs/cgroup/memory" + path + "/memory.limit_in_bytes";
+        else
+            continue;
+
+        std::ifstream file(limit_file);
+        std::string limit;
+        // "max" in v2, and close to 2^63 in v1, when unlimited
+        if (file >> limit && limit != "max") {
+            const std::uint64_t bytes = std::strtoull(limit.c_str(), nullptr, 10);
+            if (bytes > 0 && bytes < (std::uint64_t{1} << 62))
+                return bytes;
+        }
+    }
+
+    const char* mem_per_cpu = std::getenv("SLURM_MEM_PER_CPU");
+    const char* cpus = std::getenv("SLURM_CPUS_PER_TASK");
+    if (mem_per_cpu != nullptr)
+        return std::strtoull(mem_per_cpu, nullptr, 10) * (cpus != nullptr ? std::atoi(cpus) : 1) * 1024 * 1024;
+    if (const char* mem_per_node = std::getenv("SLURM_MEM_PER_NODE"))
+        return std::strtoull(mem_per_node, nullptr, 10) * 1024 * 1024;
+    return std::nullopt;
+}
+
+// Error of a state of the given bytes that does not fit in the memory of the vQPU, of which
+// in_use is taken
+inline std::string not_enough_memory(const std::uint64_t needed, const std::uint64_t in_use, const std::uint64_t limit)
+{
+    auto gigabytes = [](const std::uint64_t bytes) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f", bytes / 1e9);
+        return std::string(text);
+    };
+    return "Not enough memory: the task needs about " + gigabytes(needed) + " GB and the vQPU has " +
+           gigabytes(limit - std::min(limit, in_use)) + " GB free of its " + gigabytes(limit) +
+           " GB. Raise the QPUs with more --mem-per-qpu or use fewer qubits.";
+}
+
+// Bytes that the state of the simulation of a task takes, from its qubits, the method and the
+// precision of the simulator. Zero when its size does not follow from the qubits, as for the
+// decision diagrams of Munich, the stabilizers, the sparse statevector or an MPS without a
+// maximum bond dimension, and capped at 2^62, beyond any memory, so that the estimates of several
+// tasks add up
+inline std::uint64_t estimated_state_bytes(const JSON& config, const std::string& simulator)
+{
+    const int n_qubits = config.value("num_qubits", 0);
+    if (simulator == "Munich" || n_qubits <= 0)
+        return 0;
+    const std::uint64_t amplitude_bytes = config.value("precision", supported_precisions(simulator).front()) == "single" ? 8 : 16;
+
+    constexpr std::uint64_t TOO_LARGE = std::uint64_t{1} << 62;
+    const std::string method = config.value("method", std::string("statevector"));
+    if (method == "density_matrix" || method == "unitary")
+        return n_qubits <= 29 ? amplitude_bytes << (2 * n_qubits) : TOO_LARGE;
+    if (method == "matrix_product_state") {
+        const std::uint64_t bond = config.value("matrix_product_state_max_bond_dimension", 0);
+        return bond < (std::uint64_t{1} << 20) ? n_qubits * 2 * bond * bond * amplitude_bytes : TOO_LARGE;
+    }
+    if (method.find("stabilizer") != std::string::npos || method == "sparse")
+        return 0;
+    return n_qubits <= 58 ? amplitude_bytes << n_qubits : TOO_LARGE;
+}
+
+} // End of cunqa namespace
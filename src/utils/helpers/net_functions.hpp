@@ -5,7 +5,10 @@
 #include <string>
 #include <set>
 #include <vector>
+#include <algorithm>
 #include <cstring>
+#include <cctype>
+#include <cstdlib>
 #include <dirent.h>
 
 #include <ifaddrs.h>
@@ -195,6 +198,10 @@ inline std::string get_IP_address() {
 
 // Auxiliary GPU functions
 
+// The GPUs of the task among CUDA_VISIBLE_DEVICES, CUNQA_GPUS_PER_QPU consecutive ones from its
+// rank on the node, over which the simulators that span several GPUs split the statevector. The
+// CUNQA_QPUS_PER_GPU consecutive ranks that share a GPU through MPS take the same one, and the
+// ranks beyond the GPUs wrap around them instead of all falling onto the first
 inline JSON get_device() {
     JSON device = {
         {"device_name", "CPU"},
@@ -210,13 +217,36 @@ inline JSON get_device() {
     std::string envStr(visible_devices);
     std::stringstream ss(envStr);
     std::string token;
-    std::vector<int> available_gpus;
+    std::vector<std::string> available_gpus;
     while (std::getline(ss, token, ',')) {
-        available_gpus.push_back(std::stoi(token));
+        if (!token.empty())
+            available_gpus.push_back(token);
+    }
+    if (available_gpus.empty()) {
+        return device;
     }
 
-    const char* slurm_procid = std::getenv("SLURM_PROCID");
-    int index = std::stoi(slurm_procid);
-    device["target_devices"].push_back(available_gpus[index]);
+    const char* gpus_per_qpu_char = std::getenv("CUNQA_GPUS_PER_QPU");
+    std::size_t gpus_per_qpu = gpus_per_qpu_char ? std::max(1, std::stoi(gpus_per_qpu_char)) : 1;
+    gpus_per_qpu = std::min(gpus_per_qpu, available_gpus.size());
+    const char* qpus_per_gpu_char = std::getenv("CUNQA_QPUS_PER_GPU");
+    const std::size_t qpus_per_gpu = qpus_per_gpu_char ? std::max(1, std::stoi(qpus_per_gpu_char)) : 1;
+
+    // Slurm may leave every GPU of the node visible to each task, or only those of the task
+    const char* slurm_id = std::getenv("SLURM_LOCALID") ? std::getenv("SLURM_LOCALID") : std::getenv("SLURM_PROCID");
+    const std::size_t group = slurm_id ? std::stoi(slurm_id) / qpus_per_gpu : 0;
+    std::size_t first = (group * gpus_per_qpu) % available_gpus.size();
+    if (first + gpus_per_qpu > available_gpus.size())
+        first = 0;
+
+    // MIG slices and GPUs given by their UUID are not ordinals. A process only sees the first MIG
+    // slice among those visible, so the task keeps its own alone, which is then its device 0
+    if (!std::all_of(available_gpus[first].begin(), available_gpus[first].end(), ::isdigit)) {
+        setenv("CUDA_VISIBLE_DEVICES", available_gpus[first].c_str(), 1);
+        device["target_devices"].push_back(0);
+        return device;
+    }
+    for (std::size_t i = first; i < first + gpus_per_qpu; i++)
+        device["target_devices"].push_back(std::stoi(available_gpus[i]));
     return device;
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+namespace cunqa {
+
+// Expressions of the parameters of a circuit, lowered once by cunqa.circuit.parameter into a
+// tape of postfix operations over a stack, so that binding new values to their free symbols is a
+// single pass over it instead of a symbolic substitution per parameter. Each STORE pops the value
+// of the next parameter of the circuit
+class ParamTape {
+public:
+    enum Opcode : int {
+        CONST = 0, // Pushes value
+        SYMBOL = 1, // Pushes the value of the free symbol arg
+        ADD = 2, // Pops arg operands and pushes their sum
+        MUL = 3, // Pops arg operands and pushes their product
+        POW = 4, // Pops the exponent and the base
+        FUNC = 5, // Applies the function arg to the top of the stack
+        STORE = 6 // Pops the value of the next parameter
+    };
+    enum Function : int {
+        SIN = 0, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH, EXP, LOG, ABS
+    };
+
+    struct Operation {
+        int opcode;
+        int arg;
+        double value;
+    };
+
+    ParamTape(std::vector<Operation> operations, const std::size_t n_symbols) :
+        operations_{std::move(operations)},
+        n_symbols_{n_symbols}
+    {
+        // Checked once, so that evaluate does not check the stack on each operation
+        std::size_t depth = 0;
+        for (const auto& operation : operations_) {
+            switch (operation.opcode) {
+                case CONST:
+                    depth++;
+                    break;
+                case SYMBOL:
+                    if (operation.arg < 0 || static_cast<std::size_t>(operation.arg) >= n_symbols_)
+                        throw std::invalid_argument("Symbol " + std::to_string(operation.arg) + " of the tape out of range.");
+                    depth++;
+                    break;
+                case ADD:
+                case MUL:
+                    if (operation.arg < 1 || static_cast<std::size_t>(operation.arg) > depth)
+                        throw std::invalid_argument("Operation of the tape with missing operands.");
+                    depth -= operation.arg - 1;
+                    break;
+                case POW:
+                    if (depth < 2)
+                        throw std::invalid_argument("Power of the tape with missing operands.");
+                    depth--;
+                    break;
+                case FUNC:
+                    if (depth < 1 || operation.arg < SIN || operation.arg > ABS)
+                        throw std::invalid_argument("Function of the tape unknown or without operand.");
+                    break;
+                case STORE:
+                    if (depth != 1)
+                        throw std::invalid_argument("Parameter of the tape that does not reduce to a single value.");
+                    depth--;
+                    n_params_++;
+                    break;
+                default:
+                    throw std::invalid_argument("Unknown opcode " + std::to_string(operation.opcode) + " in the tape.");
+            }
+            max_depth_ = std::max(max_depth_, depth);
+        }
+        if (depth != 0)
+            throw std::invalid_argument("Tape with values left after its last parameter.");
+    }
+
+    std::size_t n_symbols() const { return n_symbols_; }
+    std::size_t n_params() const { return n_params_; }
+
+    // Values of the parameters for those of the free symbols, in the order of the tape
+    void evaluate(const double* symbols, double* params) const
+    {
+        std::vector<double> stack(max_depth_);
+        std::size_t top = 0;
+        for (const auto& operation : operations_) {
+            switch (operation.opcode) {
+                case CONST:
+                    stack[top++] = operation.value;
+                    break;
+                case SYMBOL:
+                    stack[top++] = symbols[operation.arg];
+                    break;
+                case ADD:
+                {
+                    double sum = 0;
+                    for (int i = 0; i < operation.arg; i++)
+                        sum += stack[--top];
+                    stack[top++] = sum;
+                    break;
+                }
+                case MUL:
+                {
+                    double product = 1;
+                    for (int i = 0; i < operation.arg; i++)
+                        product *= stack[--top];
+                    stack[top++] = product;
+                    break;
+                }
+                case POW:
+                {
+                    const double exponent = stack[--top];
+                    stack[top - 1] = std::pow(stack[top - 1], exponent);
+                    break;
+                }
+                case FUNC:
+                    stack[top - 1] = apply_(operation.arg, stack[top - 1]);
+                    break;
+                case STORE:
+                    *params++ = stack[--top];
+                    break;
+            }
+        }
+    }
+
+    std::vector<double> evaluate(const std::vector<double>& symbols) const
+    {
+        if (symbols.size() != n_symbols_)
+            throw std::invalid_argument("The tape takes " + std::to_string(n_symbols_) + " symbols, not " + std::to_string(symbols.size()) + ".");
+        std::vector<double> params(n_params_);
+        evaluate(symbols.data(), params.data());
+        return params;
+    }
+
+private:
+    std::vector<Operation> operations_;
+    std::size_t n_symbols_;
+    std::size_t n_params_ = 0;
+    std::size_t max_depth_ = 0;
+
+    static double apply_(const int function, const double x)
+    {
+        switch (function) {
+            case SIN: return std::sin(x);
+            case COS: return std::cos(x);
+            case TAN: return std::tan(x);
+            case ASIN: return std::asin(x);
+            case ACOS: return std::acos(x);
+            case ATAN: return std::atan(x);
+            case SINH: return std::sinh(x);
+            case COSH: return std::cosh(x);
+            case TANH: return std::tanh(x);
+            case EXP: return std::exp(x);
+            case LOG: return std::log(x);
+            default: return std::abs(x);
+        }
+    }
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include "utils/json.hpp"
+
+#ifdef CUNQA_PERF_COUNTERS
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace cunqa {
+
+// Hardware counters of the simulation of a task, returned in the "perf_counters" field of its
+// result when its config sets "perf_counters" and CUNQA is built with CUNQA_PERF_COUNTERS. They
+// count the thread that simulates and the threads it starts while counting, in user space, so
+// the kernel must allow it (perf_event_paranoid of 2 or less). The memory bandwidth is estimated
+// from the last-level cache misses, a cache line each, which tells the bound of a simulation
+// apart without the uncore counters, that need privileges
+class PerfCounters {
+public:
+    using Clock = std::chrono::steady_clock;
+
+#ifdef CUNQA_PERF_COUNTERS
+    PerfCounters()
+    {
+        for (std::size_t i = 0; i < EVENTS.size(); i++) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = EVENTS[i];
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+        for (const int fd : fds_) {
+            if (fd != -1) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+        start_ = Clock::now();
+    }
+
+    ~PerfCounters()
+    {
+        for (const int fd : fds_) {
+            if (fd != -1)
+                close(fd);
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Stops the counters and returns their values. The counters that the CPU or the kernel
+    // do not allow are left out
+    JSON stop()
+    {
+        const double seconds = std::chrono::duration<double>(Clock::now() - start_).count();
+        std::array<std::int64_t, EVENTS.size()> values;
+        for (std::size_t i = 0; i < fds_.size(); i++) {
+            values[i] = -1;
+            if (fds_[i] == -1)
+                continue;
+            ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+            std::uint64_t value;
+            if (read(fds_[i], &value, sizeof(value)) == sizeof(value))
+                values[i] = static_cast<std::int64_t>(value);
+        }
+
+        JSON counters = {{"seconds", seconds}};
+        for (std::size_t i = 0; i < NAMES.size(); i++) {
+            if (values[i] != -1)
+                counters[NAMES[i]] = values[i];
+        }
+        if (values[0] > 0 && values[1] != -1)
+            counters["instructions_per_cycle"] = static_cast<double>(values[1]) / values[0];
+        if (values[2] != -1 && seconds > 0)
+            counters["memory_bandwidth_gbs"] = values[2] * CACHE_LINE_BYTES / seconds / 1e9;
+        return counters;
+    }
+
+private:
+    static constexpr std::array<std::uint64_t, 3> EVENTS = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    static constexpr std::array<const char*, 3> NAMES = {"cycles", "instructions", "llc_misses"};
+    static constexpr double CACHE_LINE_BYTES = 64.0;
+
+    std::array<int, EVENTS.size()> fds_;
+    Clock::time_point start_;
+#else
+    JSON stop() { return {{"ERROR", "CUNQA was built without CUNQA_PERF_COUNTERS"}}; }
+#endif
+};
+
+} // End of cunqa namespace
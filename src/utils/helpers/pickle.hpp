@@ -0,0 +1,186 @@
+#pragma once
+
+#include <bit>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// The QMIO control server speaks Python pickles. Only what goes through it is covered: the
+// requests, a tuple of strings, and the replies, made of dicts, lists, tuples, strings, numbers,
+// booleans and None, which are read as JSON. Any other object, as a numpy array, is an error
+
+// Pickle, of protocol 2, of a tuple of strings
+inline std::string pickle_strings(const std::vector<std::string>& strings)
+{
+    std::string pickle = "\x80\x02";
+    pickle += '(';
+    for (const auto& string : strings) {
+        const auto size = static_cast<std::uint32_t>(string.size());
+        char size_bytes[4];
+        for (int i = 0; i < 4; i++)
+            size_bytes[i] = static_cast<char>((size >> (8 * i)) & 0xff);
+        pickle += 'X';
+        pickle.append(size_bytes, 4);
+        pickle += string;
+    }
+    pickle += "t.";
+    return pickle;
+}
+
+// Value of a pickle as JSON, with the keys that are not strings dumped into them and the tuples
+// as arrays
+inline JSON unpickle_json(std::string_view pickle)
+{
+    std::size_t position = 0;
+    auto take = [&](const std::size_t n) {
+        if (position + n > pickle.size())
+            throw std::runtime_error("Truncated pickle.");
+        const std::string_view bytes = pickle.substr(position, n);
+        position += n;
+        return bytes;
+    };
+    auto little_endian = [&](const std::size_t n) {
+        const auto bytes = take(n);
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < n; i++)
+            value |= static_cast<std::uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+        return value;
+    };
+    auto key_of = [](const JSON& key) { return key.is_string() ? key.get<std::string>() : key.dump(); };
+
+    std::vector<JSON> stack;
+    std::vector<std::size_t> marks;
+    std::unordered_map<std::uint64_t, JSON> memo;
+    // Memoized values still on the stack, where the dicts and lists are filled after being
+    // memoized, so they are copied into the memo when they leave it
+    std::vector<std::pair<std::size_t, std::uint64_t>> on_stack;
+    auto settle = [&](const std::size_t size) {
+        while (!on_stack.empty() && on_stack.back().first >= size) {
+            memo[on_stack.back().second] = stack[on_stack.back().first];
+            on_stack.pop_back();
+        }
+    };
+    auto memoize = [&](const std::uint64_t id) {
+        if (stack.empty())
+            throw std::runtime_error("Malformed pickle.");
+        memo[id] = stack.back();
+        on_stack.emplace_back(stack.size() - 1, id);
+    };
+    auto recall = [&](const std::uint64_t id) {
+        for (const auto& [position, memoized] : on_stack) {
+            if (memoized == id)
+                return stack[position];
+        }
+        return memo.at(id);
+    };
+    auto pop = [&]() {
+        if (stack.empty())
+            throw std::runtime_error("Malformed pickle.");
+        settle(stack.size() - 1);
+        JSON value = std::move(stack.back());
+        stack.pop_back();
+        return value;
+    };
+    auto pop_mark = [&]() {
+        if (marks.empty() || marks.back() > stack.size())
+            throw std::runtime_error("Malformed pickle.");
+        settle(marks.back());
+        std::vector<JSON> items(std::make_move_iterator(stack.begin() + marks.back()), std::make_move_iterator(stack.end()));
+        stack.resize(marks.back());
+        marks.pop_back();
+        return items;
+    };
+    auto sequence = [](std::vector<JSON> items) {
+        JSON array = JSON::array();
+        for (auto& item : items)
+            array.push_back(std::move(item));
+        return array;
+    };
+
+    while (true) {
+        const auto opcode = static_cast<unsigned char>(take(1)[0]);
+        switch (opcode)
+        {
+        case 0x80: take(1); break;                       // PROTO
+        case 0x95: take(8); break;                       // FRAME
+        case '.': return pop();                          // STOP
+        case '(': marks.push_back(stack.size()); break;  // MARK
+        case 'N': stack.emplace_back(nullptr); break;
+        case 0x88: stack.emplace_back(true); break;
+        case 0x89: stack.emplace_back(false); break;
+        case 'K': stack.emplace_back(little_endian(1)); break;
+        case 'M': stack.emplace_back(little_endian(2)); break;
+        case 'J': stack.emplace_back(static_cast<std::int32_t>(little_endian(4))); break;
+        case 0x8a: {                                     // LONG1, little-endian two's complement
+            const auto n = little_endian(1);
+            if (n > 8)
+                throw std::runtime_error("Integer of the pickle beyond 64 bits.");
+            std::uint64_t value = n > 0 ? little_endian(n) : 0;
+            if (n > 0 && n < 8 && (value >> (8 * n - 1)) & 1)
+                value |= ~std::uint64_t(0) << (8 * n);
+            stack.emplace_back(static_cast<std::int64_t>(value));
+            break;
+        }
+        case 'G': {                                      // BINFLOAT, big-endian
+            const auto bytes = take(8);
+            std::uint64_t bits = 0;
+            for (const char byte : bytes)
+                bits = (bits << 8) | static_cast<unsigned char>(byte);
+            stack.emplace_back(std::bit_cast<double>(bits));
+            break;
+        }
+        case 0x8c: stack.emplace_back(std::string(take(little_endian(1)))); break; // SHORT_BINUNICODE
+        case 'X': stack.emplace_back(std::string(take(little_endian(4)))); break;  // BINUNICODE
+        case 0x8d: stack.emplace_back(std::string(take(little_endian(8)))); break; // BINUNICODE8
+        case '}': stack.emplace_back(JSON::object()); break;
+        case ']': stack.emplace_back(JSON::array()); break;
+        case ')': stack.emplace_back(JSON::array()); break;
+        case 0x85: stack.emplace_back(sequence({pop()})); break;
+        case 0x86: { JSON b = pop(), a = pop(); stack.emplace_back(sequence({std::move(a), std::move(b)})); break; }
+        case 0x87: { JSON c = pop(), b = pop(), a = pop(); stack.emplace_back(sequence({std::move(a), std::move(b), std::move(c)})); break; }
+        case 't': stack.emplace_back(sequence(pop_mark())); break;
+        case 'l': stack.emplace_back(sequence(pop_mark())); break;
+        case 'a': { JSON item = pop(); if (stack.empty()) throw std::runtime_error("Malformed pickle."); stack.back().push_back(std::move(item)); break; }
+        case 'e': {
+            auto items = pop_mark();
+            if (stack.empty())
+                throw std::runtime_error("Malformed pickle.");
+            for (auto& item : items)
+                stack.back().push_back(std::move(item));
+            break;
+        }
+        case 's': {
+            JSON value = pop(), key = pop();
+            if (stack.empty())
+                throw std::runtime_error("Malformed pickle.");
+            stack.back()[key_of(key)] = std::move(value);
+            break;
+        }
+        case 'u': {
+            auto items = pop_mark();
+            if (stack.empty() || items.size() % 2 != 0)
+                throw std::runtime_error("Malformed pickle.");
+            for (std::size_t i = 0; i < items.size(); i += 2)
+                stack.back()[key_of(items[i])] = std::move(items[i + 1]);
+            break;
+        }
+        case 0x94: memoize(memo.size()); break; // MEMOIZE
+        case 'q': memoize(little_endian(1)); break;
+        case 'r': memoize(little_endian(4)); break;
+        case 'h': stack.push_back(recall(little_endian(1))); break;
+        case 'j': stack.push_back(recall(little_endian(4))); break;
+        default:
+            throw std::runtime_error("Unsupported pickle opcode " + std::to_string(opcode) + ".");
+        }
+    }
+}
+
+} // End of cunqa namespace
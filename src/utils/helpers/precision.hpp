@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// QuEST runs in the precision it was built with, single with the QUEST_SINGLE_PRECISION option of CMake
+#ifndef CUNQA_QUEST_SINGLE_PRECISION
+#define CUNQA_QUEST_SINGLE_PRECISION 0
+#endif
+
+namespace cunqa {
+
+// Precisions of the amplitudes that each simulator runs, "single" or "double", its default
+// first. Aer and Qsim take either one per task, QuEST only the one it was built with, and the
+// rest of the simulators only run in double precision
+inline std::vector<std::string> supported_precisions(const std::string& simulator)
+{
+    if (simulator == "Aer")
+        return {"double", "single"};
+    if (simulator == "Qsim")
+        return {"single", "double"};
+    if (simulator == "Quest")
+        return {CUNQA_QUEST_SINGLE_PRECISION ? "single" : "double"};
+    return {"double"};
+}
+
+inline bool supports_precision(const std::string& simulator, const std::string& precision)
+{
+    const auto precisions = supported_precisions(simulator);
+    return std::find(precisions.begin(), precisions.end(), precision) != precisions.end();
+}
+
+} // End of cunqa namespace
@@ -1,550 +1,413 @@
 #pragma once
 
-#include <iostream>
+#include <cmath>
+#include <cctype>
+#include <numeric>
 #include <string>
 #include <string_view>
-#include <sstream>
 #include <vector>
-#include <regex>
+#include <istream>
+#include <stdexcept>
+#include <charconv>
+#include <unordered_map>
 
 #include "utils/json.hpp"
 
 namespace
 {
 using namespace cunqa;
-using AddersFn = void(*)(std::string_view, JSON&, JSON&);
 constexpr double PI = 3.141592653589793;
-const std::string PI_STR = "pi";
 
-void found_and_replace_pi(std::string& s) {
-    const std::string pi_val = std::to_string(PI);
+// Qubits of the gates that the IR knows, any other statement is skipped. Their parameters are
+// taken as written, as "u" and "cu" have three in qelib1.inc and four in the IR
+const std::unordered_map<std::string_view, int> QASM2_GATES {
+    {"x", 1}, {"y", 1}, {"z", 1}, {"h", 1}, {"s", 1}, {"sdg", 1}, {"sx", 1}, {"sxdg", 1},
+    {"sy", 1}, {"sydg", 1}, {"sz", 1}, {"szdg", 1}, {"t", 1}, {"tdg", 1}, {"p0", 1}, {"p1", 1},
+    {"u1", 1}, {"p", 1}, {"rx", 1}, {"ry", 1}, {"rz", 1}, {"u2", 1}, {"r", 1}, {"u3", 1}, {"u", 1},
 
-    size_t pos = 0;
-    while ((pos = s.find(PI_STR, pos)) != std::string::npos) {
-        s.replace(pos, PI_STR.length(), pi_val);
-        pos += pi_val.length();
-    }
-}
+    {"ecr", 2}, {"swap", 2}, {"cx", 2}, {"cy", 2}, {"cz", 2}, {"csx", 2}, {"csy", 2}, {"csz", 2},
+    {"ct", 2}, {"cp", 2}, {"cu1", 2}, {"crx", 2}, {"cry", 2}, {"crz", 2}, {"rxx", 2}, {"ryy", 2},
+    {"rzz", 2}, {"rzx", 2}, {"cu2", 2}, {"cr", 2}, {"cu3", 2}, {"cu", 2},
 
-double eval_simple_expr(const std::string& expr) {
-    std::stringstream ss(expr);
-    double result;
-    ss >> result;
+    {"cecr", 3}, {"cswap", 3}, {"ccx", 3}, {"ccy", 3}, {"ccz", 3}, {"ccyz", 3},
+};
 
-    char op;
-    double value;
+// Constant expression of a gate parameter: numbers, pi, + - * / ^, unary minus, parentheses
+// and the functions of OpenQASM 2, evaluated in double precision
+class ExpressionParser {
+public:
+    explicit ExpressionParser(std::string_view text) : text_{text} { }
 
-    while (ss >> op >> value) {
-        if (op == '*') result *= value;
-        else if (op == '/') result /= value;
+    double parse()
+    {
+        const double value = sum_();
+        skip_spaces_();
+        if (pos_ != text_.size())
+            throw std::runtime_error("Unexpected '" + std::string(text_.substr(pos_)) + "' in the parameter " + std::string(text_) + ".");
+        return value;
     }
-    return result;
-}
-
-std::string_view get_inst_name(std::string_view line) 
-{
-    auto end = line.find_first_of(" (");
-    return line.substr(0, end);
-}
 
+private:
+    std::string_view text_;
+    std::size_t pos_ = 0;
 
-void add_qreg_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json)
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_of(" \t\r", p1);
-    auto p3 = sv_inst.find_first_not_of(" \t\r", p2);
-    auto p4 = sv_inst.find('[', p3);
-    auto p5 = sv_inst.find(']', p4);
+    void skip_spaces_()
+    {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_])))
+            pos_++;
+    }
 
-    int num_qubits = circuit_json["num_qubits"];
-    int num_qregs = std::stoi(std::string(sv_inst.substr(p4+1, p5-p4-1)));
+    bool accept_(const char c)
+    {
+        skip_spaces_();
+        if (pos_ < text_.size() && text_[pos_] == c) {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
 
-    std::vector<int> qreg_indexes(num_qregs);
-    std::iota(qreg_indexes.begin(), qreg_indexes.end(), num_qubits);
-    circuit_json["quantum_registers"][std::string(sv_inst.substr(p3, p4-p3))] = qreg_indexes;
+    double sum_()
+    {
+        double value = product_();
+        while (true) {
+            if (accept_('+'))
+                value += product_();
+            else if (accept_('-'))
+                value -= product_();
+            else
+                return value;
+        }
+    }
 
-    circuit_json["num_qubits"] = circuit_json.value("num_qubits", 0) + num_qregs;
+    double product_()
+    {
+        double value = unary_();
+        while (true) {
+            if (accept_('*'))
+                value *= unary_();
+            else if (accept_('/'))
+                value /= unary_();
+            else
+                return value;
+        }
+    }
 
-}
+    double unary_()
+    {
+        if (accept_('-'))
+            return -unary_();
+        if (accept_('+'))
+            return unary_();
+        return power_();
+    }
 
-void add_creg_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json)
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_of(" \t\r", p1);
-    auto p3 = sv_inst.find_first_not_of(" \t\r", p2);
-    auto p4 = sv_inst.find('[', p3);
-    auto p5 = sv_inst.find(']', p4);
+    // Right associative, and tighter than the unary minus of its exponent only
+    double power_()
+    {
+        const double base = primary_();
+        if (accept_('^'))
+            return std::pow(base, unary_());
+        return base;
+    }
 
-    int num_clbits = circuit_json["num_clbits"];
-    int num_cregs = std::stoi(std::string(sv_inst.substr(p4+1, p5-p4-1)));
+    double primary_()
+    {
+        skip_spaces_();
+        if (accept_('(')) {
+            const double value = sum_();
+            if (!accept_(')'))
+                throw std::runtime_error("Missing ')' in the parameter " + std::string(text_) + ".");
+            return value;
+        }
+        if (pos_ < text_.size() && (std::isdigit(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '.'))
+            return number_();
+
+        const std::size_t start = pos_;
+        while (pos_ < text_.size() && std::isalnum(static_cast<unsigned char>(text_[pos_])))
+            pos_++;
+        const std::string_view name = text_.substr(start, pos_ - start);
+        if (name == "pi")
+            return PI;
+        if (name.empty() || !accept_('('))
+            throw std::runtime_error("Unknown '" + std::string(name) + "' in the parameter " + std::string(text_) + ".");
+        const double argument = sum_();
+        if (!accept_(')'))
+            throw std::runtime_error("Missing ')' in the parameter " + std::string(text_) + ".");
+        if (name == "sin") return std::sin(argument);
+        if (name == "cos") return std::cos(argument);
+        if (name == "tan") return std::tan(argument);
+        if (name == "exp") return std::exp(argument);
+        if (name == "ln") return std::log(argument);
+        if (name == "sqrt") return std::sqrt(argument);
+        throw std::runtime_error("Unknown function " + std::string(name) + " in the parameter " + std::string(text_) + ".");
+    }
 
-    std::vector<int> creg_indexes(num_cregs);
-    std::iota(creg_indexes.begin(), creg_indexes.end(), num_clbits);
-    circuit_json["classical_registers"][std::string(sv_inst.substr(p3, p4-p3))] = creg_indexes;
+    double number_()
+    {
+        double value;
+        const auto [end, error] = std::from_chars(text_.data() + pos_, text_.data() + text_.size(), value);
+        if (error != std::errc())
+            throw std::runtime_error("Wrong number in the parameter " + std::string(text_) + ".");
+        pos_ = end - text_.data();
+        return value;
+    }
+};
 
-    circuit_json["num_clbits"] = circuit_json.value("num_clbits", 0) + num_cregs;
-}
+// Parses OpenQASM 2 statement by statement, as its text arrives, into the instructions of the
+// IR. Only the statement being read is kept, so a file can be streamed in chunks. Registers are
+// resolved to their first bit once per operand, and whole-register operands are broadcast
+class Qasm2Parser {
+public:
+    Qasm2Parser()
+    {
+        instructions_ = JSON::array();
+    }
 
-void add_meas_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json)
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\n\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_not_of(" \t\n\r", p1);
-    auto p3 = sv_inst.find('[', p2);
-    if (p3 == std::string_view::npos) {
-        p3 = sv_inst.find_first_not_of(" \t\r", p2);
-        auto p4 = sv_inst.find(' ', p3);
-        auto p5 = sv_inst.find('>', p4);
-        auto p6 = sv_inst.find_first_not_of(" \t\r", p5+1);
-        auto p7 = sv_inst.find(';', p6);
-        
-        int counter = 0;
-        for (auto& qindex : circuit_json["quantum_registers"][std::string(sv_inst.substr(p3, p4-p3))]) {
-            aux_json["name"] = "measure";
-            aux_json["qubits"] = {qindex};
-            aux_json["clbits"] = {circuit_json["classical_registers"]
-                                        [std::string(sv_inst.substr(p6, p7-p6))][counter]};
-
-            circuit_json["instructions"].push_back(aux_json);
-            counter++;
-            
-            aux_json.clear();
+    void feed(std::string_view chunk)
+    {
+        for (const char c : chunk) {
+            if (in_comment_) {
+                in_comment_ = c != '\n';
+                continue;
+            }
+            if (c == '/' && !statement_.empty() && statement_.back() == '/') {
+                statement_.pop_back();
+                in_comment_ = true;
+                continue;
+            }
+            // Bodies of gate definitions and opaque gates are not part of the IR
+            if (c == '{') {
+                depth_++;
+                continue;
+            }
+            if (c == '}') {
+                depth_--;
+                statement_.clear();
+                continue;
+            }
+            if (depth_ > 0)
+                continue;
+            if (c == ';') {
+                statement_end_();
+                statement_.clear();
+            } else {
+                statement_ += c;
+            }
         }
+    }
 
-    } else {
-        auto p4 = sv_inst.find(']', p3);
-        auto p5 = sv_inst.find('>', p4);
-        auto p6 = sv_inst.find_first_not_of(" \t\r", p5+1);
-        auto p7 = sv_inst.find('[', p6);
-        auto p8 = sv_inst.find(']', p7);
-
-        aux_json["qubits"] = {
-            circuit_json["quantum_registers"][std::string(sv_inst.substr(p2, p3-p2))]
-            [
-                std::stoi(std::string(sv_inst.substr(p3+1, p4-p3-1)))
-            ]
-        };
-
-        aux_json["clbits"] = {
-            circuit_json["classical_registers"][std::string(sv_inst.substr(p6, p7-p6))]
-            [
-                std::stoi(std::string(sv_inst.substr(p7+1, p8-p7-1)))
-            ]
+    JSON finish()
+    {
+        JSON quantum_registers, classical_registers;
+        for (const auto& reg : qregs_)
+            quantum_registers[reg.name] = indexes_(reg);
+        for (const auto& reg : cregs_)
+            classical_registers[reg.name] = indexes_(reg);
+        return {
+            {"instructions", std::move(instructions_)},
+            {"num_qubits", num_qubits_},
+            {"num_clbits", num_clbits_},
+            {"quantum_registers", std::move(quantum_registers)},
+            {"classical_registers", std::move(classical_registers)}
         };
-
-        circuit_json["instructions"].push_back(aux_json);
     }
 
-    
-    aux_json.clear();
-}
-
-void add_1q0p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_not_of(" \t\r", p1);
-    auto p3 = sv_inst.find('[', p2);
-    auto p4 = sv_inst.find(']', p3);
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p2, p3-p2))]
-        [
-            std::stoi(std::string(sv_inst.substr(p3+1, p4-p3-1)))
-        ]};
-
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
-}
+private:
+    struct Register {
+        std::string name;
+        int first;
+        int size;
+    };
+    // An operand is a bit of a register, or the whole of it when its index is -1
+    struct Operand {
+        const Register* reg;
+        int index;
+    };
 
-void add_1q1p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(")", p1);
-    auto p3 = sv_inst.find_first_not_of(" \t\r", p2+1);
-    auto p4 = sv_inst.find('[', p3);
-    auto p5 = sv_inst.find(']', p4);
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p3, p4-p3))]
-        [
-            std::stoi(std::string(sv_inst.substr(p4+1, p5-p4-1)))
-        ]};
-    
-    std::string param_str = std::string(sv_inst.substr(p1+1, p2-p1-1));
-    found_and_replace_pi(param_str);
-    double param = eval_simple_expr(param_str);
-
-    aux_json["params"] = {param};
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
-}
+    JSON instructions_;
+    std::vector<Register> qregs_;
+    std::vector<Register> cregs_;
+    int num_qubits_ = 0;
+    int num_clbits_ = 0;
+    std::string statement_;
+    int depth_ = 0;
+    bool in_comment_ = false;
 
-void add_1q2p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(",", p1);
-    auto p3 = sv_inst.find(")", p2);
-    auto p4 = sv_inst.find_first_not_of(" \t\r", p3+1);
-    auto p5 = sv_inst.find('[', p4);
-    auto p6 = sv_inst.find(']', p5);
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p4, p5-p4))]
-        [
-            std::stoi(std::string(sv_inst.substr(p5+1, p6-p5-1)))
-        ]};
-
-    std::vector<std::string> params_str = {std::string(sv_inst.substr(p1+1, p2-p1-1)), 
-                                        std::string(sv_inst.substr(p2+1, p3-p2-1))};
-    std::vector<double> params(2);
-    int counter = 0;
-    for (auto& param_str : params_str) {
-        found_and_replace_pi(param_str);
-        params[counter] = eval_simple_expr(param_str);
-        counter++;
+    static std::string_view trim_(std::string_view text)
+    {
+        const auto first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string_view::npos)
+            return {};
+        const auto last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
     }
-    aux_json["params"] = params;
-
-    circuit_json["instructions"].push_back(aux_json);
 
-    aux_json.clear();
-}
-
-void add_1q3p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(",", p1);
-    auto p3 = sv_inst.find(",", p2);
-    auto p4 = sv_inst.find(")", p3);
-    auto p5 = sv_inst.find_first_not_of(" \t\r", p4+1);
-    auto p6 = sv_inst.find('[', p5);
-    auto p7 = sv_inst.find(']', p6);
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p5, p6-p5))]
-        [
-            std::stoi(std::string(sv_inst.substr(p6+1, p7-p6-1)))
-        ]};
-
-    std::vector<std::string> params_str = {std::string(sv_inst.substr(p1+1, p2-p1-1)), 
-                                        std::string(sv_inst.substr(p2+1, p3-p2-1)),
-                                        std::string(sv_inst.substr(p3+1, p4-p3-1))};
-    std::vector<double> params(3);
-    int counter = 0;
-    for (auto& param_str : params_str) {
-        found_and_replace_pi(param_str);
-        params[counter] = eval_simple_expr(param_str);
-        counter++;
+    static int to_int_(std::string_view text)
+    {
+        text = trim_(text);
+        int value;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc() || end != text.data() + text.size())
+            throw std::runtime_error("Wrong index " + std::string(text) + ".");
+        return value;
     }
-    aux_json["params"] = params;
 
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
-
-}
+    static std::vector<int> indexes_(const Register& reg)
+    {
+        std::vector<int> indexes(reg.size);
+        std::iota(indexes.begin(), indexes.end(), reg.first);
+        return indexes;
+    }
 
-void add_2q0p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_not_of(" \t\r", p1);
-    auto p3 = sv_inst.find('[', p2);
-    auto p4 = sv_inst.find(']', p3);
-    auto p5 = sv_inst.find(',', p4);
-    auto p6 = sv_inst.find_first_not_of(" \t\r", p5+1);
-    auto p7 = sv_inst.find('[', p6);
-    auto p8 = sv_inst.find(']', p7);
-
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p2, p3-p2))]
-        [
-            std::stoi(std::string(sv_inst.substr(p3+1, p4-p3-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p6, p7-p6))]
-        [
-            std::stoi(std::string(sv_inst.substr(p7+1, p8-p7-1)))
-        ]};
-
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
-}
+    static const Register* find_(const std::vector<Register>& registers, std::string_view name)
+    {
+        for (const auto& reg : registers) {
+            if (reg.name == name)
+                return &reg;
+        }
+        throw std::runtime_error("Unknown register " + std::string(name) + ".");
+    }
 
-void add_2q1p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(")", p1);
-    auto p3 = sv_inst.find_first_not_of(" \t\r", p2+1);
-    auto p4 = sv_inst.find('[', p3);
-    auto p5 = sv_inst.find(']', p4);
-    auto p6 = sv_inst.find(',', p5);
-    auto p7 = sv_inst.find_first_not_of(" \t\r", p6+1);
-    auto p8 = sv_inst.find('[', p7);
-    auto p9 = sv_inst.find(']', p8);
-
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p3, p4-p3))]
-        [
-            std::stoi(std::string(sv_inst.substr(p4+1, p5-p4-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p7, p8-p7))]
-        [
-            std::stoi(std::string(sv_inst.substr(p8+1, p9-p8-1)))
-        ]};
-
-    std::string param_str = std::string(sv_inst.substr(p1+1, p2-p1-1));
-    found_and_replace_pi(param_str);
-    double param = eval_simple_expr(param_str);
-    aux_json["params"] = {param};
-
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
+    static Operand operand_(const std::vector<Register>& registers, std::string_view text)
+    {
+        text = trim_(text);
+        const auto bracket = text.find('[');
+        if (bracket == std::string_view::npos)
+            return {find_(registers, text), -1};
+        const Register* reg = find_(registers, trim_(text.substr(0, bracket)));
+        const int index = to_int_(text.substr(bracket + 1, text.find(']', bracket) - bracket - 1));
+        if (index < 0 || index >= reg->size)
+            throw std::runtime_error("Index " + std::to_string(index) + " out of register " + reg->name + ".");
+        return {reg, index};
+    }
 
-}
+    // Operands split at the commas outside brackets
+    static std::vector<std::string_view> split_(std::string_view text)
+    {
+        std::vector<std::string_view> parts;
+        std::size_t start = 0;
+        int nesting = 0;
+        for (std::size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '(' || text[i] == '[')
+                nesting++;
+            else if (text[i] == ')' || text[i] == ']')
+                nesting--;
+            else if (text[i] == ',' && nesting == 0) {
+                parts.push_back(text.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+        if (!trim_(text.substr(start)).empty())
+            parts.push_back(text.substr(start));
+        return parts;
+    }
 
-void add_2q2p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(",", p1);
-    auto p3 = sv_inst.find(")", p2);
-    auto p4 = sv_inst.find_first_not_of(" \t\r", p3+1);
-    auto p5 = sv_inst.find('[', p4);
-    auto p6 = sv_inst.find(']', p5);
-    auto p7 = sv_inst.find(',', p6);
-    auto p8 = sv_inst.find_first_not_of(" \t\r", p7+1);
-    auto p9 = sv_inst.find('[', p8);
-    auto p10 = sv_inst.find(']', p9);
-
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p4, p5-p4))]
-        [
-            std::stoi(std::string(sv_inst.substr(p5+1, p6-p5-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p8, p9-p8))]
-        [
-            std::stoi(std::string(sv_inst.substr(p9+1, p10-p9-1)))
-        ]};
-        
-    std::vector<std::string> params_str = {std::string(sv_inst.substr(p1+1, p2-p1-1)), 
-                                        std::string(sv_inst.substr(p2+1, p3-p2-1))};
-    std::vector<double> params(2);
-    int counter = 0;
-    for (auto& param_str : params_str) {
-        found_and_replace_pi(param_str);
-        params[counter] = eval_simple_expr(param_str);
-        counter++;
+    void declare_(std::string_view declaration, std::vector<Register>& registers, int& n_bits)
+    {
+        const auto bracket = declaration.find('[');
+        const int size = to_int_(declaration.substr(bracket + 1, declaration.find(']', bracket) - bracket - 1));
+        registers.push_back({std::string(trim_(declaration.substr(0, bracket))), n_bits, size});
+        n_bits += size;
     }
-    aux_json["params"] = params;
 
-    circuit_json["instructions"].push_back(aux_json);
+    void statement_end_()
+    {
+        const std::string_view statement = trim_(statement_);
+        const auto name_end = statement.find_first_of(" \t\r\n(");
+        const std::string_view name = statement.substr(0, name_end);
+        if (name_end == std::string_view::npos)
+            return;
+        std::string_view rest = statement.substr(name_end);
+
+        if (name == "qreg")
+            return declare_(rest, qregs_, num_qubits_);
+        if (name == "creg")
+            return declare_(rest, cregs_, num_clbits_);
+        if (name == "measure")
+            return measure_(rest);
+
+        const auto gate = QASM2_GATES.find(name);
+        if (gate == QASM2_GATES.end())
+            return;
+
+        std::vector<double> params;
+        rest = trim_(rest);
+        if (!rest.empty() && rest.front() == '(') {
+            std::size_t close = 0;
+            for (int nesting = 0; close < rest.size(); close++) {
+                if (rest[close] == '(')
+                    nesting++;
+                else if (rest[close] == ')' && --nesting == 0)
+                    break;
+            }
+            for (const auto& param : split_(rest.substr(1, close - 1)))
+                params.push_back(ExpressionParser(param).parse());
+            rest = rest.substr(std::min(close + 1, rest.size()));
+        }
+        std::vector<Operand> operands;
+        for (const auto& operand : split_(rest))
+            operands.push_back(operand_(qregs_, operand));
+        if (static_cast<int>(operands.size()) != gate->second)
+            throw std::runtime_error("Gate " + std::string(name) + " acts on " + std::to_string(gate->second) + " qubit(s).");
+
+        broadcast_(operands, [&](const std::vector<int>& qubits) {
+            JSON instruction = {{"name", std::string(name)}, {"qubits", qubits}};
+            if (!params.empty())
+                instruction["params"] = params;
+            instructions_.push_back(std::move(instruction));
+        });
+    }
 
-    aux_json.clear();
-}
+    void measure_(std::string_view operands)
+    {
+        const auto arrow = operands.find("->");
+        if (arrow == std::string_view::npos)
+            throw std::runtime_error("Measure without '->'.");
+        const Operand qubit = operand_(qregs_, operands.substr(0, arrow));
+        const Operand clbit = operand_(cregs_, operands.substr(arrow + 2));
+
+        const int size = qubit.index == -1 ? qubit.reg->size : 1;
+        for (int i = 0; i < size; i++) {
+            const int q = qubit.reg->first + (qubit.index == -1 ? i : qubit.index);
+            const int c = clbit.reg->first + (clbit.index == -1 ? i : clbit.index);
+            instructions_.push_back({{"name", "measure"}, {"qubits", {q}}, {"clbits", {c}}});
+        }
+    }
 
-void add_2q3p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
-{
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find('(', p0);
-    auto p2 = sv_inst.find(",", p1);
-    auto p3 = sv_inst.find(",", p2);
-    auto p4 = sv_inst.find(")", p3);
-    auto p5 = sv_inst.find_first_not_of(" \t\r", p4+1);
-    auto p6 = sv_inst.find('[', p5);
-    auto p7 = sv_inst.find(']', p6);
-    auto p8 = sv_inst.find(',', p7);
-    auto p9 = sv_inst.find_first_not_of(" \t\r", p8+1);
-    auto p10 = sv_inst.find('[', p9);
-    auto p11 = sv_inst.find(']', p10);
-
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p5, p6-p5))]
-        [
-            std::stoi(std::string(sv_inst.substr(p6+1, p7-p6-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p9, p10-p9))]
-        [
-            std::stoi(std::string(sv_inst.substr(p10+1, p11-p10-1)))
-        ]};
-        
-    std::vector<std::string> params_str = {std::string(sv_inst.substr(p1+1, p2-p1-1)), 
-                                        std::string(sv_inst.substr(p2+1, p3-p2-1)),
-                                        std::string(sv_inst.substr(p3+1, p4-p3-1))};
-    std::vector<double> params(3);
-    int counter = 0;
-    for (auto& param_str : params_str) {
-        found_and_replace_pi(param_str);
-        params[counter] = eval_simple_expr(param_str);
-        counter++;
+    // Once per bit of the whole registers among the operands, all of the same size
+    template <typename Emit>
+    static void broadcast_(const std::vector<Operand>& operands, Emit&& emit)
+    {
+        int size = 1;
+        for (const auto& operand : operands) {
+            if (operand.index == -1)
+                size = operand.reg->size;
+        }
+        std::vector<int> qubits(operands.size());
+        for (int i = 0; i < size; i++) {
+            for (std::size_t j = 0; j < operands.size(); j++)
+                qubits[j] = operands[j].reg->first + (operands[j].index == -1 ? i : operands[j].index);
+            emit(qubits);
+        }
     }
-    aux_json["params"] = params;
+};
 
-    circuit_json["instructions"].push_back(aux_json);
+} // End namespace
 
-    aux_json.clear();
+inline JSON qasm2_to_json(const std::string& circuit_qasm)
+{
+    Qasm2Parser parser;
+    parser.feed(circuit_qasm);
+    return parser.finish();
 }
 
-void add_3q0p_instruction(std::string_view sv_inst, JSON& circuit_json, JSON& aux_json) 
+// Without holding the whole text in memory, for large files
+inline JSON qasm2_to_json(std::istream& circuit_qasm)
 {
-    auto p0 = sv_inst.find_first_not_of(" \t\r");
-    auto p1 = sv_inst.find(' ', p0);
-    auto p2 = sv_inst.find_first_not_of(" \t\r", p1);
-    auto p3 = sv_inst.find('[', p2);
-    auto p4 = sv_inst.find(']', p3);
-    auto p5 = sv_inst.find(',', p4);
-    auto p6 = sv_inst.find_first_not_of(" \t\r", p5+1);
-    auto p7 = sv_inst.find('[', p6);
-    auto p8 = sv_inst.find(']', p7);
-    auto p9 = sv_inst.find(',', p8);
-    auto p10 = sv_inst.find_first_not_of(" \t\r", p9+1);
-    auto p11 = sv_inst.find('[', p10);
-    auto p12 = sv_inst.find(']', p11);
-
-
-    aux_json["name"] = std::string(sv_inst.substr(p0, p1-p0));
-    aux_json["qubits"] = 
-        {circuit_json["quantum_registers"][std::string(sv_inst.substr(p2, p3-p2))]
-        [
-            std::stoi(std::string(sv_inst.substr(p3+1, p4-p3-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p6, p7-p6))]
-        [
-            std::stoi(std::string(sv_inst.substr(p7+1, p8-p7-1)))
-        ],
-        circuit_json["quantum_registers"][std::string(sv_inst.substr(p10, p11-p10))]
-        [
-            std::stoi(std::string(sv_inst.substr(p11+1, p12-p11-1)))
-        ]};
-
-    circuit_json["instructions"].push_back(aux_json);
-
-    aux_json.clear();
+    Qasm2Parser parser;
+    std::string chunk(1 << 16, '\0');
+    while (circuit_qasm.read(chunk.data(), chunk.size()) || circuit_qasm.gcount() > 0)
+        parser.feed(std::string_view(chunk.data(), circuit_qasm.gcount()));
+    return parser.finish();
 }
-
-
-
-std::unordered_map<std::string_view, AddersFn> add_instruction {
-    {"qreg", add_qreg_instruction},
-    {"creg", add_creg_instruction},
-
-    {"measure", add_meas_instruction},
-
-    {"x", add_1q0p_instruction},
-    {"y", add_1q0p_instruction},
-    {"z", add_1q0p_instruction},
-    {"h", add_1q0p_instruction},
-    {"s", add_1q0p_instruction},
-    {"sdg", add_1q0p_instruction},
-    {"sx", add_1q0p_instruction},
-    {"sxdg", add_1q0p_instruction},
-    {"sy", add_1q0p_instruction},
-    {"sydg", add_1q0p_instruction},
-    {"sz", add_1q0p_instruction},
-    {"szdg", add_1q0p_instruction},
-    {"t", add_1q0p_instruction},
-    {"tdg", add_1q0p_instruction},
-    {"p0", add_1q0p_instruction},
-    {"p1", add_1q0p_instruction},
-
-    {"u1", add_1q1p_instruction},
-    {"p", add_1q1p_instruction},
-    {"rx", add_1q1p_instruction},
-    {"ry", add_1q1p_instruction},
-    {"rz", add_1q1p_instruction},
-
-    {"u2", add_1q2p_instruction},
-    {"r", add_1q2p_instruction},
-
-    {"u3", add_1q3p_instruction},
-    {"u", add_1q2p_instruction},
-
-    {"ecr", add_2q0p_instruction},
-    {"swap", add_2q0p_instruction},
-    {"cx", add_2q0p_instruction},
-    {"cy", add_2q0p_instruction},
-    {"cz", add_2q0p_instruction},
-    {"csx", add_2q0p_instruction},
-    {"csy", add_2q0p_instruction},
-    {"csz", add_2q0p_instruction},
-    {"ct", add_2q0p_instruction},
-
-    {"cp", add_2q1p_instruction},
-    {"cu1", add_2q1p_instruction},
-    {"crx", add_2q1p_instruction},
-    {"cry", add_2q1p_instruction},
-    {"crz", add_2q1p_instruction},
-    {"rxx", add_2q1p_instruction},
-    {"ryy", add_2q1p_instruction},
-    {"rzz", add_2q1p_instruction},
-    {"rzx", add_2q1p_instruction},
-
-    {"cu2", add_2q2p_instruction},
-    {"cr", add_2q2p_instruction},
-
-    {"cu3", add_2q3p_instruction},
-    {"cu", add_2q3p_instruction},
-
-    {"cecr", add_3q0p_instruction},
-    {"cswap", add_3q0p_instruction},
-    {"ccx", add_3q0p_instruction},
-    {"ccy", add_3q0p_instruction},
-    {"ccyz", add_3q0p_instruction},
-
-};
-
-} // End namespace
-
-JSON qasm2_to_json(const std::string& circuit_qasm) {
-
-    JSON circuit_json = 
-    {
-        {"instructions", std::vector<JSON>()},
-        {"num_qubits", 0},
-        {"num_clbits", 0},
-        {"quantum_registers", JSON()},
-        {"classical_registers", JSON()}
-    };
-    JSON aux_json;
-
-    size_t start = 0;
-    size_t end;
-    std::string inst;
-    std::string_view sv_inst;
-    std::string_view sv_inst_name;
-    while ((end = circuit_qasm.find('\n', start)) != std::string::npos) 
-    {
-        inst = circuit_qasm.substr(start, end - start);
-        sv_inst = inst;
-        sv_inst_name = get_inst_name(sv_inst);
-        auto it = add_instruction.find(sv_inst_name);
-        if (it != add_instruction.end()) {
-            it->second(sv_inst, circuit_json, aux_json);
-        }
-        start = end + 1;
-    }
-
-    return circuit_json;
-}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <optional>
+#include <memory_resource>
+
+namespace cunqa {
+
+// Monotonic arena of the thread that decodes and runs a request, for the data that does not
+// outlive it. Nothing is freed until reset() after the request, and the buffer grows to the
+// largest request seen, so in the steady state the requests take no memory from the heap
+class RequestArena {
+public:
+    static constexpr std::size_t INITIAL_BYTES = std::size_t(1) << 16;
+
+    RequestArena() : buffer_(INITIAL_BYTES) { rebuild_(); }
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    inline std::pmr::memory_resource* resource() { return &*resource_; }
+
+    // Frees everything at once, and grows the buffer if the request overflowed it
+    void reset()
+    {
+        resource_.reset();
+        if (upstream_.used > 0)
+            buffer_ = std::vector<std::byte>(buffer_.size() + upstream_.used);
+        rebuild_();
+    }
+
+private:
+    // The heap, counting the bytes that did not fit in the buffer
+    struct CountingResource : std::pmr::memory_resource {
+        std::size_t used = 0;
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            used += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    std::vector<std::byte> buffer_;
+    CountingResource upstream_;
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+
+    void rebuild_()
+    {
+        upstream_.used = 0;
+        resource_.emplace(buffer_.data(), buffer_.size(), &upstream_);
+    }
+};
+
+// Arena of the calling thread
+inline RequestArena& request_arena()
+{
+    thread_local RequestArena arena;
+    return arena;
+}
+
+} // End of cunqa namespace
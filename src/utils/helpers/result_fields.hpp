@@ -0,0 +1,33 @@
+#pragma once
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Fields common to the results of every simulator, which AER keeps in its first experiment
+
+inline JSON& counts_of(JSON& result)
+{
+    if (result.contains("counts"))
+        return result.at("counts");
+    return result.at("results")[0].at("data").at("counts"); // AER
+}
+
+inline const JSON& counts_of(const JSON& result)
+{
+    return counts_of(const_cast<JSON&>(result));
+}
+
+inline JSON& time_taken_of(JSON& result)
+{
+    if (result.contains("time_taken"))
+        return result.at("time_taken");
+    return result.at("results")[0].at("time_taken"); // AER
+}
+
+inline const JSON& time_taken_of(const JSON& result)
+{
+    return time_taken_of(const_cast<JSON&>(result));
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <optional>
+#include <charconv>
+
+#include "utils/json.hpp"
+#include "binary_counts.hpp"
+#include "clbit_selection.hpp"
+
+namespace cunqa {
+
+// Result of a task as it is written into the reply. The backends that keep their counts as
+// integers hand them over as they are, outcome and shots with bit j of each outcome the clbit j,
+// and they are written straight into the JSON text or the binary counts, without an object of
+// bitstrings in between. The rest of the result, small, is kept as JSON. The backends that
+// build the whole result as JSON write it as it is
+class ResultWriter {
+public:
+    // Outcomes in increasing order, as a sim::Histogram
+    using Counts = std::vector<std::pair<std::uint64_t, std::size_t>>;
+
+    inline void counts(Counts counts, const std::size_t num_clbits)
+    {
+        if (result_.is_object())
+            result_.erase("counts");
+        counts_ = std::move(counts);
+        num_clbits_ = num_clbits;
+    }
+
+    // Only the counts of the clbits of the selection, however they were written
+    inline void select_clbits(const ClbitSelection& selection)
+    {
+        if (counts_) {
+            selection.select(*counts_);
+            num_clbits_ = selection.size();
+        }
+        selection.select(result_);
+    }
+
+    // Members of a result built as JSON, over those already written
+    inline void write(JSON result)
+    {
+        if (result_.is_null() && !counts_) {
+            result_ = std::move(result);
+            return;
+        }
+        if (counts_ && result.is_object() && result.contains("counts"))
+            counts_.reset();
+        result_.update(result);
+    }
+
+    inline JSON& operator[](const std::string& key) { return result_[key]; }
+    inline bool is_object() const { return counts_ || result_.is_object(); }
+    inline bool contains(const std::string& key) const
+    {
+        return (counts_ && key == "counts") || (result_.is_object() && result_.contains(key));
+    }
+
+    // The whole result, with the counts as bitstrings, for what needs it as JSON
+    JSON to_json() const
+    {
+        if (!counts_)
+            return result_;
+        JSON result = result_.is_null() ? JSON::object() : result_;
+        JSON& counts = result["counts"] = JSON::object();
+        std::string bits;
+        for (const auto& [outcome, count] : *counts_)
+            counts[bitstring(outcome, bits)] = count;
+        return result;
+    }
+
+    // The same text as to_json().dump(), with the counts first
+    std::string dump() const
+    {
+        if (!counts_)
+            return result_.dump();
+
+        std::string text = "{\"counts\":{";
+        text.reserve(text.size() + counts_->size() * (num_clbits_ + 8));
+        std::string bits;
+        char digits[24];
+        for (const auto& [outcome, count] : *counts_) {
+            if (text.back() != '{')
+                text += ',';
+            text += '"';
+            text += bitstring(outcome, bits);
+            text += "\":";
+            text.append(digits, std::to_chars(digits, digits + sizeof(digits), count).ptr);
+        }
+        text += '}';
+        const std::string rest = result_.is_null() ? "{}" : result_.dump();
+        if (rest.size() > 2)
+            text += ',' + rest.substr(1);
+        else
+            text += '}';
+        return text;
+    }
+
+    // Nothing when the result has no counts or they do not fit on 64 bits, as in to_binary_counts()
+    std::optional<std::string> binary_counts() const
+    {
+        if (!counts_)
+            return to_binary_counts(result_);
+        const auto& counts = *counts_;
+        if (num_clbits_ > 64 && !counts.empty())
+            return std::nullopt;
+        return binary_counts_message(counts.empty() ? 0 : num_clbits_, result_.is_null() ? "{}" : result_.dump(), counts.size(),
+                                     [&counts](const std::size_t i) { return counts[i].first; },
+                                     [&counts](const std::size_t i) { return counts[i].second; });
+    }
+
+private:
+    JSON result_;
+    std::optional<Counts> counts_;
+    std::size_t num_clbits_ = 0;
+
+    // Clbit 0 is the rightmost character
+    inline const std::string& bitstring(const std::uint64_t outcome, std::string& bits) const
+    {
+        bits.assign(num_clbits_, '0');
+        for (std::size_t i = 0; i < num_clbits_ && i < 64; i++)
+            bits[num_clbits_ - 1 - i] = ((outcome >> i) & 1) ? '1' : '0';
+        return bits;
+    }
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <map>
+#include <chrono>
+#include <string>
+
+#include "utils/json.hpp"
+#include "utils/helpers/trace.hpp"
+
+namespace cunqa {
+
+// Seconds that a request spends in each stage on the vQPU, returned in the "timings" field of
+// its result when its config sets "timings" and added to the metrics of the vQPU. The QPU times
+// the stages around the backend and the adapters time those inside it, on the thread of the
+// worker running the task. With tracing on, the stages are also spans of the trace
+class StageTimings {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void add(const std::string& stage, const double seconds) { seconds_[stage] += seconds; }
+    void add(const std::string& stage, const Clock::time_point start, const Clock::time_point end)
+    {
+        add(stage, std::chrono::duration<double>(end - start).count());
+        Trace::of_process().span(stage.c_str(), "stage", start, end);
+    }
+    JSON to_json() const { return seconds_; }
+    const std::map<std::string, double>& seconds() const { return seconds_; }
+
+    // Timings of the task that the calling thread runs, null outside of the tasks
+    static StageTimings*& current()
+    {
+        thread_local StageTimings* timings = nullptr;
+        return timings;
+    }
+
+    // Makes the timings the current ones of the thread while it lives
+    class Recording {
+    public:
+        Recording(StageTimings* timings) : previous_{current()} { current() = timings; }
+        ~Recording() { current() = previous_; }
+    private:
+        StageTimings* previous_;
+    };
+
+private:
+    std::map<std::string, double> seconds_;
+};
+
+// Adds the time until the end of the scope to the stage of the current timings, if any, and
+// traces it even without them, as in the executors
+class ScopedStage {
+public:
+    ScopedStage(const char* stage) :
+        timings_{StageTimings::current()},
+        traced_{Trace::enabled()},
+        stage_{stage},
+        start_{timings_ != nullptr || traced_ ? StageTimings::Clock::now() : StageTimings::Clock::time_point{}}
+    { }
+    ~ScopedStage()
+    {
+        if (timings_ != nullptr)
+            timings_->add(stage_, start_, StageTimings::Clock::now());
+        else if (traced_)
+            Trace::of_process().span(stage_, "stage", start_, StageTimings::Clock::now());
+    }
+
+private:
+    StageTimings* timings_;
+    bool traced_;
+    const char* stage_;
+    StageTimings::Clock::time_point start_;
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <filesystem>
+#include <unistd.h>
+
+#include "utils/json.hpp"
+#include "utils/constants.hpp"
+
+namespace cunqa {
+
+// Spans of the process in the Chrome trace-event format, which Perfetto also reads, written
+// to $STORE/.cunqa/traces only if CUNQA_TRACE is set (qraise --trace). Times are microseconds
+// since the start of the Slurm job, and the offset of each file to the epoch goes with it, so
+// that the files of several jobs and nodes are merged into one timeline (cunqa.traces)
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Trace& of_process()
+    {
+        static Trace trace;
+        return trace;
+    }
+
+    static bool enabled() { return of_process().file_.is_open(); }
+
+    // Names the process in the timeline, as "QPU <id>" or "executor <job>"
+    void name_process(const std::string& name)
+    {
+        if (!enabled())
+            return;
+        write_({{"name", "process_name"}, {"ph", "M"}, {"pid", pid_}, {"tid", thread_id_()},
+                {"args", {{"name", name}, {"clock_offset_us", offset_us_}}}});
+    }
+
+    void span(const char* name, const char* category, const Clock::time_point start, const Clock::time_point end,
+              JSON args = nullptr)
+    {
+        if (!enabled())
+            return;
+        JSON event = {{"name", name}, {"cat", category}, {"ph", "X"}, {"pid", pid_}, {"tid", thread_id_()},
+                      {"ts", to_us_(start)}, {"dur", std::chrono::duration<double, std::micro>(end - start).count()}};
+        if (!args.is_null())
+            event["args"] = std::move(args);
+        write_(event);
+    }
+
+    ~Trace()
+    {
+        std::lock_guard lock(mutex_);
+        if (file_.is_open())
+            file_ << buffer_ << "\n]\n";
+    }
+
+private:
+    std::mutex mutex_;
+    std::ofstream file_;
+    std::string buffer_;
+    Clock::time_point last_flush_;
+    bool first_ = true;
+    int pid_ = getpid();
+    std::int64_t offset_us_ = 0; // Epoch of the start of the job
+    Clock::time_point zero_;     // The start of the job on the steady clock
+
+    // The events are written in blocks, and a vQPU killed with its job loses at most the last
+    // block. The file stays readable without its closing bracket
+    static constexpr std::size_t FLUSH_BYTES = 1 << 16;
+    static constexpr auto FLUSH_PERIOD = std::chrono::milliseconds(200);
+
+    Trace()
+    {
+        if (std::getenv("CUNQA_TRACE") == nullptr)
+            return;
+
+        const auto now = std::chrono::system_clock::now();
+        const auto steady_now = Clock::now();
+        if (const char* start = std::getenv("SLURM_JOB_START_TIME"))
+            offset_us_ = std::atoll(start) * 1000000;
+        zero_ = steady_now - (std::chrono::duration_cast<Clock::duration>(now.time_since_epoch()) -
+                              std::chrono::microseconds(offset_us_));
+        last_flush_ = steady_now;
+
+        const char* job_id = std::getenv("SLURM_JOB_ID");
+        const char* proc_id = std::getenv("SLURM_PROCID");
+        const auto directory = std::filesystem::path(constants::get_cunqa_path()) / "traces";
+        std::filesystem::create_directories(directory);
+        file_.open(directory / (std::string(job_id != nullptr ? job_id : "nojob") + "_" +
+                                (proc_id != nullptr ? proc_id : "0") + "_" + std::to_string(pid_) + ".json"));
+        file_ << "[\n";
+    }
+
+    std::int64_t to_us_(const Clock::time_point time) const
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time - zero_).count();
+    }
+
+    // Threads numbered in the order they first trace, shorter in the timeline than their ids
+    static int thread_id_()
+    {
+        static std::atomic<int> next{0};
+        thread_local int id = next++;
+        return id;
+    }
+
+    void write_(const JSON& event)
+    {
+        std::string line = event.dump();
+        std::lock_guard lock(mutex_);
+        buffer_ += (first_ ? "" : ",\n") + line;
+        first_ = false;
+        const auto now = Clock::now();
+        if (buffer_.size() >= FLUSH_BYTES || now - last_flush_ >= FLUSH_PERIOD) {
+            file_ << buffer_ << std::flush;
+            buffer_.clear();
+            last_flush_ = now;
+        }
+    }
+};
+
+// Traces the time until the end of the scope. The arguments are only built if tracing is on
+class ScopedSpan {
+public:
+    ScopedSpan(const char* name, const char* category, const std::string* peer = nullptr) :
+        enabled_{Trace::enabled()},
+        name_{name},
+        category_{category},
+        peer_{peer},
+        start_{enabled_ ? Trace::Clock::now() : Trace::Clock::time_point{}}
+    { }
+    ~ScopedSpan()
+    {
+        if (enabled_)
+            Trace::of_process().span(name_, category_, start_, Trace::Clock::now(),
+                                     peer_ != nullptr ? JSON{{"peer", *peer_}} : JSON(nullptr));
+    }
+
+private:
+    bool enabled_;
+    const char* name_;
+    const char* category_;
+    const std::string* peer_;
+    Trace::Clock::time_point start_;
+};
+
+} // End of cunqa namespace
@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,48 +12,38 @@
 
 namespace {
 
-    int open_file(const std::string& filename)
-    {
-        int fd = open(filename.c_str(), O_RDWR | O_CREAT, 0666);
-        if (fd == -1) {
-            perror("open");
-            throw std::runtime_error("Failed to open file: " + filename);
+    // Writers of the file take turns through its lockfile, and readers do not wait for them
+    class Lockfile {
+    public:
+        Lockfile(const std::string& filename) : path_{filename + ".lock"}
+        {
+            while ((fd_ = open(path_.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644)) == -1) {
+                if (errno != EEXIST)
+                    throw std::runtime_error("Failed to create lockfile: " + std::string(strerror(errno)));
+                usleep(1000);
+            }
         }
 
-        return fd;
-    }
-
-    enum class LockMode { Read, Write };
-
-    struct flock lock(const int& fd, const LockMode& mode)
-    {
-        struct flock fl;
-        fl.l_type = (mode == LockMode::Write) ? F_WRLCK : F_RDLCK;
-        fl.l_whence = SEEK_SET;
-        fl.l_start = 0;
-        fl.l_len = 0; // Lock entire file
-
-        if (fcntl(fd, F_SETLKW, &fl) == -1) {
-            perror("fcntl - lock");
-            throw std::runtime_error("Failed to acquire file lock");
+        ~Lockfile()
+        {
+            close(fd_);
+            unlink(path_.c_str());
         }
-        return fl;
-    }
 
-    void unlock(const int& fd, struct flock& fl)
+    private:
+        std::string path_;
+        int fd_;
+    };
+
+    cunqa::JSON read_json(const std::string& filename)
     {
-        if (fsync(fd) == -1) {
-            perror("fsync");
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            if (errno == ENOENT)
+                return cunqa::JSON::object();
+            throw std::runtime_error("Failed to open file: " + filename);
         }
 
-        fl.l_type = F_UNLCK;
-        if (fcntl(fd, F_SETLK, &fl) == -1)
-            perror("fcntl - unlock");
-    }
-
-    cunqa::JSON read_json(const int& fd) 
-    {
-        lseek(fd, 0, SEEK_SET);
         std::string content;
         {
             constexpr size_t BUF_SIZE = 4096;
@@ -61,6 +52,7 @@ namespace {
             while ((n = read(fd, buf, BUF_SIZE)) > 0) {
                 content.append(buf, n);
             }
+            close(fd);
             if (n == -1) {
                 perror("read");
                 throw std::runtime_error("Failed reading file");
@@ -78,22 +70,49 @@ namespace {
         return j;
     }
 
-    void write_json(const int& fd, const cunqa::JSON& j)
+    // Written aside and renamed over the file, so a reader finds either the old or the new
+    // content, never a partial one, without taking any lock
+    void write_json(const std::string& filename, const cunqa::JSON& j)
     {
+        const std::string tmp = filename + "." + std::to_string(getpid()) + ".tmp";
         std::string output = j.dump(4);
-        if (ftruncate(fd, 0) == -1) {
-            perror("ftruncate");
-            throw std::runtime_error("Failed to truncate file");
+
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1) {
+            perror("open");
+            throw std::runtime_error("Failed to open file: " + tmp);
         }
 
-        lseek(fd, 0, SEEK_SET);
         ssize_t written = write(fd, output.c_str(), output.size());
-        if (written < 0 || static_cast<size_t>(written) != output.size()) {
+        bool ok = written >= 0 && static_cast<size_t>(written) == output.size() && fsync(fd) == 0;
+        close(fd);
+        if (!ok || rename(tmp.c_str(), filename.c_str()) == -1) {
             perror("write");
+            unlink(tmp.c_str());
             throw std::runtime_error("Failed to write complete JSON");
         }
     }
 
+// Writes the entry under the lockfile, unless it is there already and it must not be overwritten
+bool write_entry(const cunqa::JSON& local_data, const std::string &filename, const std::string &id, const bool overwrite)
+{
+    try {
+        Lockfile lockfile(filename);
+        auto j = read_json(filename);
+
+        bool written = overwrite || !j.contains(id);
+        if (written) {
+            j[id] = local_data;
+            write_json(filename, j);
+        }
+        return written;
+    } catch (const std::exception &e) {
+        throw std::runtime_error(
+            "Error writing JSON safely using atomic lock.\nSystem message: " +
+            std::string(e.what()));
+    }
+}
+
 } // End of anonymous namespace
 
 
@@ -101,67 +120,45 @@ namespace cunqa {
 
 JSON read_file(const std::string &filename)
 {
-    int fd = -1;
     try {
-        fd = open_file(filename);
-        auto fl = lock(fd, LockMode::Read);
-        auto j = read_json(fd);
-        unlock(fd, fl);
-        close(fd);
-        return j;
+        return read_json(filename);
     } catch (const std::exception &e) {
-        if (fd != -1) close(fd);
-        std::string msg =
-            "Error reading JSON safely using POSIX (fcntl) locks.\nSystem message: ";
+        std::string msg = "Error reading JSON.\nSystem message: ";
         throw std::runtime_error(msg + e.what());
     }
-
-    return {};
 }
 
 void write_on_file(JSON local_data, const std::string &filename, const std::string &id)
 {
-    const std::string lockfile = filename + ".lock";
-    int lock_fd = -1;
-    int fd = -1;
-
-    while (true) {
-        lock_fd = open(lockfile.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0644);
-        if (lock_fd != -1) break;
-        if (errno != EEXIST)
-            throw std::runtime_error("Failed to create lockfile: " + std::string(strerror(errno)));
-        usleep(1000);
-    }
-
-    try {
-        fd = open_file(filename);
-
-        auto j = read_json(fd);
+    write_entry(local_data, filename, id, true);
+}
 
-        j[id] = local_data;
+bool claim_on_file(const JSON& local_data, const std::string &filename, const std::string &id)
+{
+    return write_entry(local_data, filename, id, false);
+}
 
-        write_json(fd, j);
-        fsync(fd);
-        close(fd);
-        close(lock_fd);
-        unlink(lockfile.c_str());
+bool update_on_file(const std::string &filename, const std::string &id, const std::function<bool(JSON&)>& change)
+{
+    try {
+        Lockfile lockfile(filename);
+        auto j = read_json(filename);
+        if (!j.contains(id) || !change(j[id]))
+            return false;
+        write_json(filename, j);
+        return true;
     } catch (const std::exception &e) {
-        if (fd != -1) close(fd);
-        close(lock_fd);
-        unlink(lockfile.c_str());
-        throw std::runtime_error(
-            "Error writing JSON safely using atomic lock.\nSystem message: " +
-            std::string(e.what()));
+        std::string msg =
+            "Error writing JSON safely using atomic lock.\nSystem message: ";
+        throw std::runtime_error(msg + e.what());
     }
 }
 
 void remove_from_file(const std::string &filename, const std::string &rm_key)
 {
-    int fd = -1;
     try {
-        fd = open_file(filename);
-        auto fl = lock(fd, LockMode::Write);
-        auto j = read_json(fd);
+        Lockfile lockfile(filename);
+        auto j = read_json(filename);
 
         // Filter: keep entries which JOB_ID is not the one attached 
         JSON out = JSON::object();
@@ -173,13 +170,24 @@ void remove_from_file(const std::string &filename, const std::string &rm_key)
             }
         }
 
-        write_json(fd, out);
-        unlock(fd, fl);
-        close(fd);
+        write_json(filename, out);
+    } catch (const std::exception &e) {
+        std::string msg =
+            "Error writing JSON safely using atomic lock.\nSystem message: ";
+        throw std::runtime_error(msg + e.what());
+    }
+}
+
+void erase_from_file(const std::string &filename, const std::string &id)
+{
+    try {
+        Lockfile lockfile(filename);
+        auto j = read_json(filename);
+        if (j.erase(id) > 0)
+            write_json(filename, j);
     } catch (const std::exception &e) {
-        if (fd != -1) close(fd);
         std::string msg =
-            "Error writing JSON safely using POSIX (fcntl) locks.\nSystem message: ";
+            "Error writing JSON safely using atomic lock.\nSystem message: ";
         throw std::runtime_error(msg + e.what());
     }
 }
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <functional>
+
 #include <nlohmann/json.hpp>
 
 namespace cunqa {
     using JSON = nlohmann::json;
     JSON read_file(const std::string &filename);
     void write_on_file(JSON local_data, const std::string &filename, const std::string& suffix = "");
+    // Writes the entry only if there is none with the same id, and returns whether it did
+    bool claim_on_file(const JSON& local_data, const std::string &filename, const std::string &id);
+    // Changes the entry, if there is one and the change does not decline it, and returns whether it did
+    bool update_on_file(const std::string &filename, const std::string &id, const std::function<bool(JSON&)>& change);
     void remove_from_file(const std::string &filename, const std::string &key);
+    void erase_from_file(const std::string &filename, const std::string &id);
 }
 
@@ -1,4 +1,6 @@
 #include <string>
+#include <cstdlib>
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include "logger.hpp"
@@ -7,11 +9,23 @@ using namespace std::literals;
 
 std::shared_ptr<spdlog::logger> logger;
 
+// Messages the vQPU keeps waiting to be written before dropping the oldest ones
+constexpr std::size_t LOG_QUEUE_SIZE = 8192;
+
 __attribute__((constructor)) void initializeLogger() {
-    // QClient logger initialization
+    // QPU logger initialization
     std::string id = std::getenv("SLURM_JOB_ID") + "_"s + std::getenv("SLURM_PROCID");
     std::string qpu_name = "qpu_logger_"s + id;
-    logger = spdlog::stdout_color_mt(qpu_name);
-    logger->set_level(spdlog::level::debug);
+
+    // The console is written by a thread of its own, so the requests and the simulations only
+    // format their messages and never wait for the lock of the console
+    spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+    logger = spdlog::stdout_color_mt<spdlog::async_factory_nonblock>(qpu_name);
     logger->set_pattern("(%D %r) [QPU "s + id + "] %^%l: %v %$ %oms"s);
-}
\ No newline at end of file
+    logger->flush_on(spdlog::level::err);
+    std::atexit([]() { spdlog::shutdown(); }); // Writes what is still queued
+
+    // Set by qraise --log-level, which the job passes to the vQPUs
+    auto level = std::getenv("CUNQA_LOG_LEVEL");
+    logger->set_level(level != nullptr ? spdlog::level::from_str(level) : spdlog::level::debug);
+}
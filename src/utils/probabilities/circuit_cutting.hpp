@@ -0,0 +1,151 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+#include "process_counts.hpp"
+
+// Reconstruction of the distribution of a cut circuit from those of its fragments. Each cut is
+// replaced by a sum over labels, each one with its coefficient, and a fragment holds, for every
+// assignment of labels to the cuts it takes part in, the quasi-probabilities of its output bits:
+//     P(x) = sum over assignments a of  prod_c coefficient_c(a_c) * prod_f tensor_f(a|f)[x|f]
+
+// A fragment and the entries of its tensor, one after another, each one of 2^output_bits.size()
+// values. The label of the first cut is the fastest index of the entries
+struct CutFragmentTensor {
+    std::vector<int> cuts;
+    std::vector<int> output_bits; // Bit of the reconstructed distribution of each of its output bits
+    std::span<const double> tensor;
+};
+
+// Quasi-probabilities of the output bits of a fragment variant, from its counts as integer
+// outcomes. Each count is weighed by the parity of its sign bits, so the measurements of the cuts
+// give expectation values instead of probabilities
+std::vector<double> foldCutCounts(
+    std::span<const std::uint64_t> outcomes,
+    std::span<const std::uint64_t> counts,
+    const std::vector<int>& output_bits,
+    const std::vector<int>& sign_bits
+) {
+    if (outcomes.size() != counts.size()) {
+        throw std::invalid_argument("Outcomes and counts differ in length");
+    }
+    std::uint64_t sign_mask = 0;
+    for (int bit : sign_bits)
+        sign_mask |= std::uint64_t{1} << bit;
+
+    std::uint64_t all_shots = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i)
+        all_shots += counts[i];
+    if (all_shots == 0) {
+        throw std::invalid_argument("The fragment has no counts");
+    }
+
+    BitGather gather(output_bits);
+    std::vector<double> probs(std::size_t{1} << output_bits.size(), 0.0);
+    accumulateBins(probs, outcomes.size(), [&](std::vector<double>& bins, std::size_t i) {
+        const double count = static_cast<double>(counts[i]);
+        bins[gather(outcomes[i])] += (std::popcount(outcomes[i] & sign_mask) & 1) ? -count : count;
+    });
+
+    const double inv_shots = 1.0 / static_cast<double>(all_shots);
+    for (auto& prob : probs)
+        prob *= inv_shots;
+    return probs;
+}
+
+// The contraction runs in parallel over the outcomes x, each one summing the terms of the
+// assignments whose coefficients are not zero
+std::vector<double> reconstructCutProbs(
+    const std::vector<CutFragmentTensor>& fragments,
+    const std::vector<std::vector<double>>& coefficients, // Of each label of each cut
+    int num_bits
+) {
+    if (num_bits < 0 || num_bits > 40) {
+        throw std::invalid_argument("The reconstructed distribution takes from 0 to 40 bits");
+    }
+
+    // Every bit of the distribution comes from a single fragment
+    std::vector<int> covered(num_bits, 0);
+    std::vector<std::size_t> strides(fragments.size() * coefficients.size(), 0);
+    for (std::size_t f = 0; f < fragments.size(); ++f) {
+        const auto& fragment = fragments[f];
+        std::size_t entries = 1;
+        for (int cut : fragment.cuts) {
+            if (cut < 0 || static_cast<std::size_t>(cut) >= coefficients.size()) {
+                throw std::invalid_argument("Fragment with an unknown cut");
+            }
+            strides[f * coefficients.size() + cut] = entries << fragment.output_bits.size();
+            entries *= coefficients[cut].size();
+        }
+        for (int bit : fragment.output_bits) {
+            if (bit < 0 || bit >= num_bits || covered[bit]++) {
+                throw std::invalid_argument("Output bits out of range or in several fragments");
+            }
+        }
+        if (fragment.tensor.size() != entries << fragment.output_bits.size()) {
+            throw std::invalid_argument("Tensor of a fragment not matching its cuts and output bits");
+        }
+    }
+    for (int bit = 0; bit < num_bits; ++bit) {
+        if (!covered[bit]) {
+            throw std::invalid_argument("Bit of the distribution not given by any fragment");
+        }
+    }
+
+    // Weight of every assignment, and the entry of each fragment for it
+    std::vector<double> weights;
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> labels(coefficients.size(), 0);
+    while (true) {
+        double weight = 1.0;
+        for (std::size_t c = 0; c < coefficients.size(); ++c)
+            weight *= coefficients[c][labels[c]];
+        if (weight != 0.0) {
+            weights.push_back(weight);
+            for (std::size_t f = 0; f < fragments.size(); ++f) {
+                std::size_t offset = 0;
+                for (int cut : fragments[f].cuts)
+                    offset += labels[cut] * strides[f * coefficients.size() + cut];
+                offsets.push_back(offset);
+            }
+        }
+
+        std::size_t c = 0;
+        while (c < labels.size() && ++labels[c] == coefficients[c].size())
+            labels[c++] = 0;
+        if (c == labels.size())
+            break;
+    }
+
+    std::vector<BitGather> gathers;
+    for (const auto& fragment : fragments)
+        gathers.emplace_back(fragment.output_bits);
+
+    const std::size_t n_fragments = fragments.size();
+    const std::size_t n_outcomes = std::size_t{1} << num_bits;
+    std::vector<double> probs(n_outcomes);
+#pragma omp parallel if(n_outcomes * weights.size() >= PARALLEL_MIN_ITEMS)
+    {
+        std::vector<std::size_t> local(n_fragments);
+#pragma omp for schedule(static)
+        for (std::size_t x = 0; x < n_outcomes; ++x) {
+            for (std::size_t f = 0; f < n_fragments; ++f)
+                local[f] = gathers[f](x);
+
+            double prob = 0.0;
+            for (std::size_t t = 0; t < weights.size(); ++t) {
+                const std::size_t* offset = &offsets[t * n_fragments];
+                double term = weights[t];
+                for (std::size_t f = 0; f < n_fragments && term != 0.0; ++f)
+                    term *= fragments[f].tensor[offset[f] + local[f]];
+                prob += term;
+            }
+            probs[x] = prob;
+        }
+    }
+    return probs;
+}
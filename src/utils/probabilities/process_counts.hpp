@@ -1,70 +1,262 @@
+#pragma once
+
 #include <vector>
 #include <map>
 #include <string>
 #include <cctype>
 #include <cmath>
 #include <algorithm>
-#include <iostream>
-#include <iomanip>
-#include <random>
+#include <unordered_map>
+#include <span>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// The counts are processed as integer outcomes, the bitstrings read as integers with the first
+// bit the most significant. The functions on string keys only convert them, except for
+// bitstrings of more than 64 bits
+
+// Widths up to this are histogrammed on dense arrays, and wider ones on hash maps
+constexpr int DENSE_MAX_BITS = 24;
+// Fewer items than this are not worth the threads
+constexpr std::size_t PARALLEL_MIN_ITEMS = 1 << 16;
+
+struct IntCounts {
+    std::vector<std::uint64_t> outcomes; // Ascending
+    std::vector<std::uint64_t> counts;
+};
+
+// Gathers the bits at the given positions, the first one into bit 0. PEXT does it in a single
+// instruction when the positions ascend
+class BitGather {
+public:
+    BitGather(const std::vector<int>& positions) : positions_{positions}
+    {
+        ascending_ = std::is_sorted(positions.begin(), positions.end()) &&
+                     std::adjacent_find(positions.begin(), positions.end()) == positions.end();
+        for (int position : positions)
+            mask_ |= std::uint64_t{1} << position;
+        contiguous_ = ascending_ && (mask_ & (mask_ + (mask_ & -mask_))) == 0;
+    }
+
+    std::uint64_t operator()(const std::uint64_t value) const
+    {
+#ifdef __BMI2__
+        if (ascending_)
+            return _pext_u64(value, mask_);
+#endif
+        if (contiguous_)
+            return (value & mask_) >> std::countr_zero(mask_);
+
+        std::uint64_t gathered = 0;
+        for (std::size_t i = 0; i < positions_.size(); ++i)
+            gathered |= ((value >> positions_[i]) & 1) << i;
+        return gathered;
+    }
+
+private:
+    std::vector<int> positions_;
+    std::uint64_t mask_ = 0;
+    bool ascending_;
+    bool contiguous_;
+};
+
+// Calls add(bins, i) for every i < n, in parallel with a private copy of the bins per thread when
+// there are enough items and few bins compared to them
+template <typename T, typename Add>
+void accumulateBins(std::vector<T>& bins, const std::size_t n, Add add)
+{
+    if (n < PARALLEL_MIN_ITEMS || bins.size() > n / 8) {
+        for (std::size_t i = 0; i < n; ++i)
+            add(bins, i);
+        return;
+    }
+
+#pragma omp parallel
+    {
+        std::vector<T> local(bins.size(), T{});
+#pragma omp for nowait
+        for (std::size_t i = 0; i < n; ++i)
+            add(local, i);
+#pragma omp critical
+        for (std::size_t j = 0; j < bins.size(); ++j)
+            bins[j] += local[j];
+    }
+}
+
+// Sums the counts of equal outcomes of the given width, dropping those never seen
+template <typename Outcome>
+IntCounts histogramOutcomes(
+    const std::size_t n,
+    Outcome outcome,
+    std::span<const std::uint64_t> counts,
+    const int width
+) {
+    IntCounts histogram;
+    if (width <= DENSE_MAX_BITS) {
+        std::vector<std::uint64_t> dense(std::size_t{1} << width, 0);
+        accumulateBins(dense, n, [&](std::vector<std::uint64_t>& bins, std::size_t i) {
+            bins[outcome(i)] += counts[i];
+        });
+        for (std::size_t value = 0; value < dense.size(); ++value) {
+            if (dense[value] != 0) {
+                histogram.outcomes.push_back(value);
+                histogram.counts.push_back(dense[value]);
+            }
+        }
+        return histogram;
+    }
+
+    std::unordered_map<std::uint64_t, std::uint64_t> sparse;
+    for (std::size_t i = 0; i < n; ++i)
+        sparse[outcome(i)] += counts[i];
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> sorted(sparse.begin(), sparse.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto& [value, count] : sorted) {
+        histogram.outcomes.push_back(value);
+        histogram.counts.push_back(count);
+    }
+    return histogram;
+}
+
+// Integer counterpart of marginalizeCountsByRegions, with num_bits bits per outcome and the
+// first region on the most significant ones
+std::vector<IntCounts> marginalizeOutcomesByRegions(
+    std::span<const std::uint64_t> outcomes,
+    std::span<const std::uint64_t> counts,
+    const int num_bits,
+    const std::vector<int>& region_sizes
+) {
+    if (outcomes.size() != counts.size()) {
+        throw std::invalid_argument("Outcomes and counts differ in length");
+    }
+
+    std::vector<IntCounts> results;
+    results.reserve(region_sizes.size());
+    int pos = 0;
+    for (int region_size : region_sizes) {
+        const int shift = num_bits - pos - region_size;
+        if (region_size < 0 || shift < 0) {
+            throw std::invalid_argument("Region sizes exceed the bitstring length");
+        }
+        const std::uint64_t mask = region_size >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << region_size) - 1;
+        results.push_back(histogramOutcomes(outcomes.size(), [&](std::size_t i) {
+            return (outcomes[i] >> shift) & mask;
+        }, counts, region_size));
+        pos += region_size;
+    }
+    return results;
+}
+
+// Sums the histograms of outcomes of num_bits bits of several results, as those of the shards of
+// a job whose shots were split among vQPUs
+IntCounts mergeOutcomes(
+    const std::vector<std::span<const std::uint64_t>>& outcomes,
+    const std::vector<std::span<const std::uint64_t>>& counts,
+    const int num_bits
+) {
+    if (outcomes.size() != counts.size()) {
+        throw std::invalid_argument("Outcomes and counts differ in length");
+    }
+    if (num_bits < 0 || num_bits > 64) {
+        throw std::invalid_argument("Outcomes of more than 64 bits cannot be merged as integers");
+    }
+
+    std::size_t n = 0;
+    for (std::size_t s = 0; s < outcomes.size(); ++s) {
+        if (outcomes[s].size() != counts[s].size()) {
+            throw std::invalid_argument("Outcomes and counts differ in length");
+        }
+        n += outcomes[s].size();
+    }
+    std::vector<std::uint64_t> all_outcomes, all_counts;
+    all_outcomes.reserve(n);
+    all_counts.reserve(n);
+    for (std::size_t s = 0; s < outcomes.size(); ++s) {
+        all_outcomes.insert(all_outcomes.end(), outcomes[s].begin(), outcomes[s].end());
+        all_counts.insert(all_counts.end(), counts[s].begin(), counts[s].end());
+    }
+    return histogramOutcomes(n, [&](std::size_t i) { return all_outcomes[i]; }, all_counts, num_bits);
+}
 
 // Given a counts dictionary, marginalize counts on the selected regions. Example:
-// {"1100": 501, "0100": 499} with region_sizes = [2 2] woudl result in 
+// {"1100": 501, "0100": 499} with region_sizes = [2 2] woudl result in
 // {"11": 501, "01": 499} and {"00": 1000}
 // multiple registers bitstrings, eg "00 10", are also processed correctly, as spaces are ignored
 std::vector<std::map<std::string, int>> marginalizeCountsByRegions(
     const std::map<std::string, int>& counts,
-    const std::vector<int>& region_sizes, 
+    const std::vector<int>& region_sizes,
     const bool check_lenght = false
 ) {
-    if (check_lenght){
-        // Validate that region sizes sum to the bitstring length
+    // Keys without spaces
+    std::vector<std::string> clean_keys;
+    clean_keys.reserve(counts.size());
+    for (const auto& [key, count] : counts) {
+        std::string clean_key;
+        std::copy_if(key.begin(), key.end(), std::back_inserter(clean_key), [](char c) { return !std::isspace(c); });
+        clean_keys.push_back(std::move(clean_key));
+    }
+
     int total_length = 0;
     for (int size : region_sizes) {
         total_length += size;
     }
-    
-    // Get the bitstring length (removing spaces)
-    int bitstring_length = 0;
-    if (!counts.empty()) {
-        const std::string& first_key = counts.begin()->first;
-        for (char c : first_key) {
-            if (!std::isspace(c)) {
-                bitstring_length++;
-            }
-        }
-    }
-    
-    if (bitstring_length != total_length) {
+    const int bitstring_length = clean_keys.empty() ? 0 : clean_keys.front().size();
+    if (check_lenght && bitstring_length != total_length) {
         throw std::invalid_argument(
             "Region sizes do not sum to bitstring length"
         );
     }
-    }
-    
+
     // Create a result vector with one map per region
     std::vector<std::map<std::string, int>> results(region_sizes.size());
-    
-    // Process each bitstring and its count
-    for (const auto& [key, count] : counts) {
-        // Remove spaces from the key
-        std::string clean_key;
-        for (char c : key) {
-            if (!std::isspace(c)) {
-                clean_key += c;
+
+    bool as_integers = bitstring_length <= 64 && total_length <= bitstring_length;
+    for (const auto& clean_key : clean_keys)
+        as_integers = as_integers && static_cast<int>(clean_key.size()) == bitstring_length;
+
+    if (!as_integers) {
+        // Substrings of each key, for widths that do not fit an integer
+        std::size_t key_idx = 0;
+        for (const auto& [key, count] : counts) {
+            const std::string& clean_key = clean_keys[key_idx++];
+            int pos = 0;
+            for (size_t region_idx = 0; region_idx < region_sizes.size(); ++region_idx) {
+                int region_size = region_sizes[region_idx];
+                std::string region = clean_key.substr(pos, region_size);
+                results[region_idx][region] += count;
+                pos += region_size;
             }
         }
-        
-        // Extract regions and update results
-        int pos = 0;
-        for (size_t region_idx = 0; region_idx < region_sizes.size(); ++region_idx) {
-            int region_size = region_sizes[region_idx];
-            std::string region = clean_key.substr(pos, region_size);
-            results[region_idx][region] += count;
-            pos += region_size;
+        return results;
+    }
+
+    std::vector<std::uint64_t> outcomes, values;
+    outcomes.reserve(counts.size());
+    values.reserve(counts.size());
+    std::size_t key_idx = 0;
+    for (const auto& [key, count] : counts) {
+        outcomes.push_back(clean_keys[key_idx].empty() ? 0 : std::stoull(clean_keys[key_idx], nullptr, 2));
+        values.push_back(count);
+        ++key_idx;
+    }
+
+    auto regions = marginalizeOutcomesByRegions(outcomes, values, bitstring_length, region_sizes);
+    for (size_t region_idx = 0; region_idx < region_sizes.size(); ++region_idx) {
+        const int region_size = region_sizes[region_idx];
+        for (size_t i = 0; i < regions[region_idx].outcomes.size(); ++i) {
+            std::string region(region_size, '0');
+            for (int bit = 0; bit < region_size; ++bit) {
+                if ((regions[region_idx].outcomes[i] >> bit) & 1)
+                    region[region_size - 1 - bit] = '1';
+            }
+            results[region_idx][region] += regions[region_idx].counts[i];
         }
     }
-    
     return results;
 }
 
@@ -86,76 +278,68 @@ std::vector<double> recombineProbs(
         }
     }
 
+    int short_num_qubits = partial.size();
     if (per_qubit) {
-        int short_num_qubits = partial.size();
         std::vector<double> new_probs(2 * short_num_qubits, 0.0);
 
-        // Iterate through all bitstrings
-        for (int base_ten_bitstring = 0; base_ten_bitstring < static_cast<int>(probs.size()); ++base_ten_bitstring) {
+        // Each bitstring adds its probability to the bit it has on every qubit in the partial list
+        accumulateBins(new_probs, probs.size(), [&](std::vector<double>& bins, std::size_t base_ten_bitstring) {
             double prob = probs[base_ten_bitstring];
-
-            // For each qubit in the partial list
             for (int i = 0; i < short_num_qubits; ++i) {
-                int i_qubit = partial[i];
-                // Extract bit at position i_qubit using bitwise operation
-                int zero_one = (base_ten_bitstring >> i_qubit) & 1;
-                new_probs[i * 2 + zero_one] += prob;
+                int zero_one = (base_ten_bitstring >> partial[i]) & 1;
+                bins[i * 2 + zero_one] += prob;
             }
-        }
-        
+        });
+
         return new_probs;
 
     } else {
         // Probabilities of partial bitstrings
-        int short_num_qubits = partial.size();
-        int num_short_bitstrings = 1 << short_num_qubits;
-        std::vector<double> short_bitstring_probs(num_short_bitstrings, 0.0);
+        std::vector<double> short_bitstring_probs(std::size_t{1} << short_num_qubits, 0.0);
 
-        // Iterate through all bitstrings
-        for (int base_ten_bitstring = 0; base_ten_bitstring < static_cast<int>(probs.size()); ++base_ten_bitstring) {
-            double prob = probs[base_ten_bitstring];
-
-            // Extract the partial bitstring using bitwise operations
-            int shortened_bitstring = 0;
-            for (int i = 0; i < short_num_qubits; ++i) {
-                int i_qubit = partial[i];
-                int bit = (base_ten_bitstring >> i_qubit) & 1;
-                shortened_bitstring |= (bit << i);
-            }
-
-            short_bitstring_probs[shortened_bitstring] += prob;
-        }
+        // The partial bitstring gathers the bits of the partial list
+        BitGather shorten(partial);
+        accumulateBins(short_bitstring_probs, probs.size(), [&](std::vector<double>& bins, std::size_t base_ten_bitstring) {
+            bins[shorten(base_ten_bitstring)] += probs[base_ten_bitstring];
+        });
 
         return short_bitstring_probs;
     }
 }
 
+// Same as below, for histograms with the outcomes as integers, as the binary counts of a result
 std::vector<double> countsToProbs(
-    const std::map<std::string, int>& counts,
+    std::span<const std::uint64_t> outcomes,
+    std::span<const std::uint64_t> counts,
+    int num_qubits,
     bool per_qubit = false,
     const std::vector<int>* partial = nullptr
 ) {
-    // Get number of qubits from first key
-    int num_qubits = counts.begin()->first.length();
-    int num_bitstrings = 1 << num_qubits; // 2^num_qubits
+    if (outcomes.size() != counts.size()) {
+        throw std::invalid_argument("Outcomes and counts differ in length");
+    }
+    const std::size_t num_bitstrings = std::size_t{1} << num_qubits; // 2^num_qubits
 
-    // Convert string-based counts to integer-based for faster access
-    std::vector<int> count_array(num_bitstrings, 0);
-    for (const auto& [key, value] : counts) {
-        int bitstring_int = std::stoi(key, nullptr, 2);
-        count_array[bitstring_int] = value;
+    std::vector<std::uint64_t> count_array(num_bitstrings, 0);
+    for (std::size_t i = 0; i < outcomes.size(); ++i) {
+        if (outcomes[i] >= num_bitstrings) {
+            throw std::invalid_argument("Outcome out of range for the number of qubits");
+        }
+        count_array[outcomes[i]] += counts[i];
     }
 
     // Calculate total shots
-    unsigned int all_shots = 0;
-    for (int i = 0; i < num_bitstrings; ++i) {
-        all_shots += count_array[i];
+    std::uint64_t all_shots = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        all_shots += counts[i];
     }
 
     // Calculate probabilities
     std::vector<double> probs(num_bitstrings);
-    for (int i = 0; i < num_bitstrings; ++i) {
-        probs[i] = static_cast<double>(count_array[i]) / all_shots;
+    const double inv_shots = 1.0 / static_cast<double>(all_shots);
+#pragma omp parallel for simd if(num_bitstrings >= PARALLEL_MIN_ITEMS)
+    for (std::size_t i = 0; i < num_bitstrings; ++i) {
+        probs[i] = static_cast<double>(count_array[i]) * inv_shots;
     }
 
     // Apply recombination if needed
@@ -165,3 +349,23 @@ std::vector<double> countsToProbs(
 
     return probs;
 }
+
+std::vector<double> countsToProbs(
+    const std::map<std::string, int>& counts,
+    bool per_qubit = false,
+    const std::vector<int>* partial = nullptr
+) {
+    // Get number of qubits from first key
+    int num_qubits = counts.begin()->first.length();
+
+    // Convert string-based counts to integer-based for faster access
+    std::vector<std::uint64_t> outcomes, values;
+    outcomes.reserve(counts.size());
+    values.reserve(counts.size());
+    for (const auto& [key, value] : counts) {
+        outcomes.push_back(std::stoull(key, nullptr, 2));
+        values.push_back(value);
+    }
+
+    return countsToProbs(outcomes, values, num_qubits, per_qubit, partial);
+}
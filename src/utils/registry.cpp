@@ -0,0 +1,166 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <filesystem>
+
+#include "registry.hpp"
+
+namespace {
+using namespace cunqa;
+namespace fs = std::filesystem;
+
+// Every entry in a single JSON file, rewritten whole on each write
+class FileRegistry : public Registry {
+public:
+    FileRegistry(const std::string& path) : filename_{path + ".json"} { }
+
+    JSON read() override { return read_file(filename_); }
+    void write(const std::string& id, const JSON& entry) override { write_on_file(entry, filename_, id); }
+    bool claim(const std::string& id, const JSON& entry) override { return claim_on_file(entry, filename_, id); }
+    bool update(const std::string& id, const std::function<bool(JSON&)>& change) override { return update_on_file(filename_, id, change); }
+    void remove(const std::string& prefix) override { remove_from_file(filename_, prefix); }
+    void erase(const std::string& id) override { erase_from_file(filename_, id); }
+
+private:
+    std::string filename_;
+};
+
+// An "<id>.json" file per entry. Entries are written to a hidden temporary file and then renamed,
+// or linked when claimed, so a reader only finds complete entries. An entry being updated is
+// renamed aside first, which only one process achieves, and the readers miss it meanwhile
+class DirRegistry : public Registry {
+public:
+    DirRegistry(const std::string& path) : dir_{path} { }
+
+    JSON read() override
+    {
+        JSON entries = JSON::object();
+        std::error_code ec;
+        for (const auto& file : fs::directory_iterator(dir_, ec)) {
+            const auto name = file.path().filename().string();
+            if (name.starts_with(".") || file.path().extension() != ".json")
+                continue;
+
+            // The entry may be removed at the same time, and it is then skipped
+            std::ifstream in(file.path());
+            std::string content{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+            try {
+                entries[file.path().stem().string()] = JSON::parse(content);
+            } catch (const JSON::parse_error&) { }
+        }
+        return entries;
+    }
+
+    void write(const std::string& id, const JSON& entry) override
+    {
+        const auto tmp = write_tmp_(id, entry);
+        if (rename(tmp.c_str(), entry_path_(id).c_str()) == -1) {
+            unlink(tmp.c_str());
+            throw std::runtime_error("Failed to write the registry entry " + id + ": " + strerror(errno));
+        }
+    }
+
+    bool claim(const std::string& id, const JSON& entry) override
+    {
+        const auto tmp = write_tmp_(id, entry);
+        int ret = link(tmp.c_str(), entry_path_(id).c_str());
+        int link_errno = errno;
+        unlink(tmp.c_str());
+
+        if (ret == -1 && link_errno != EEXIST)
+            throw std::runtime_error("Failed to claim the registry entry " + id + ": " + strerror(link_errno));
+        return ret == 0;
+    }
+
+    bool update(const std::string& id, const std::function<bool(JSON&)>& change) override
+    {
+        const auto entry_path = entry_path_(id);
+        const auto taken = dir_ / ("." + id + "." + std::to_string(getpid()) + ".taken");
+        if (rename(entry_path.c_str(), taken.c_str()) == -1)
+            return false;
+
+        JSON entry;
+        try {
+            std::ifstream in(taken);
+            entry = JSON::parse(std::string{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()});
+        } catch (const JSON::parse_error&) {
+            rename(taken.c_str(), entry_path.c_str());
+            return false;
+        }
+        if (!change(entry)) {
+            rename(taken.c_str(), entry_path.c_str());
+            return false;
+        }
+        try {
+            write(id, entry);
+        } catch (...) {
+            rename(taken.c_str(), entry_path.c_str());
+            throw;
+        }
+        unlink(taken.c_str());
+        return true;
+    }
+
+    void remove(const std::string& prefix) override
+    {
+        std::error_code ec;
+        for (const auto& file : fs::directory_iterator(dir_, ec)) {
+            if (file.path().filename().string().starts_with(prefix))
+                fs::remove(file.path(), ec);
+        }
+    }
+
+    void erase(const std::string& id) override
+    {
+        std::error_code ec;
+        fs::remove(entry_path_(id), ec);
+    }
+
+private:
+    fs::path dir_;
+
+    fs::path entry_path_(const std::string& id) const { return dir_ / (id + ".json"); }
+
+    fs::path write_tmp_(const std::string& id, const JSON& entry)
+    {
+        fs::create_directories(dir_);
+        const auto tmp = dir_ / ("." + id + "." + std::to_string(getpid()) + ".tmp");
+        const std::string output = entry.dump(4);
+
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd == -1)
+            throw std::runtime_error("Failed to open file: " + tmp.string());
+
+        ssize_t written = ::write(fd, output.c_str(), output.size());
+        bool ok = written >= 0 && static_cast<size_t>(written) == output.size() && fsync(fd) == 0;
+        close(fd);
+        if (!ok) {
+            unlink(tmp.c_str());
+            throw std::runtime_error("Failed to write complete JSON");
+        }
+        return tmp;
+    }
+};
+
+} // End of anonymous namespace
+
+namespace cunqa {
+
+std::unique_ptr<Registry> open_registry(const std::string& path)
+{
+    const char* backend = std::getenv("CUNQA_REGISTRY");
+    if (!backend || std::string(backend) == "dir")
+        return std::make_unique<DirRegistry>(path);
+    if (std::string(backend) == "file")
+        return std::make_unique<FileRegistry>(path);
+
+    throw std::runtime_error("Unknown registry backend: " + std::string(backend));
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <functional>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Entries, "<job id>_<anything>", that the QPUs and the classical channels publish. The backend is
+// chosen with the CUNQA_REGISTRY environment variable:
+//   - "dir" (default): a directory with a file per entry, so each write costs the same whatever
+//     the number of entries and readers never wait for the writers.
+//   - "file": every entry in a single JSON file, as CUNQA used to keep them. The writers take
+//     turns through a lockfile and rename the new content over the file, so readers take no lock.
+class Registry {
+public:
+    virtual ~Registry() = default;
+
+    virtual JSON read() = 0;
+    virtual void write(const std::string& id, const JSON& entry) = 0;
+    // Writes the entry only if there is none with the same id, and returns whether it did
+    virtual bool claim(const std::string& id, const JSON& entry) = 0;
+    // Changes the entry, if there is one, unless the change declines it by returning false, and
+    // returns whether it did. The changes of an entry from several processes happen one at a time
+    virtual bool update(const std::string& id, const std::function<bool(JSON&)>& change) = 0;
+    // Removes the entries whose id starts with the prefix, as those of a job
+    virtual void remove(const std::string& prefix) = 0;
+    // Removes the entry with exactly that id, as a vQPU that leaves
+    virtual void erase(const std::string& id) = 0;
+};
+
+// Registry at the path, without extension: the directory itself, or the path plus ".json"
+std::unique_ptr<Registry> open_registry(const std::string& path);
+
+} // End of cunqa namespace
@@ -623,3 +623,43 @@ def test_quantum_control_context_rejects_remote_ops_inside_block():
     with pytest.raises(RuntimeError):
         with control.expose(0, target) as (rqubit, subcircuit):
             subcircuit.recv(0, "OTHER")  # forbidden by __exit__
+
+
+def test_layer_adds_a_gate_per_qubit_with_its_param():
+    circuit = CunqaCircuit(3)
+
+    circuit.layer("rz", params=np.array([0.1, 0.2, 0.3]))
+
+    assert circuit.instructions == [
+        {"name": "rz", "qubits": [0], "params": [0.1]},
+        {"name": "rz", "qubits": [1], "params": [0.2]},
+        {"name": "rz", "qubits": [2], "params": [0.3]},
+    ]
+    assert circuit.params == []
+
+
+def test_layer_of_two_qubit_gates():
+    circuit = CunqaCircuit(4)
+
+    circuit.layer("cx", qubits=[[0, 1], [2, 3]])
+
+    assert circuit.instructions == [{"name": "cx", "qubits": [0, 1]}, {"name": "cx", "qubits": [2, 3]}]
+
+
+def test_layer_with_wrong_number_of_params_raises():
+    circuit = CunqaCircuit(2)
+
+    with pytest.raises(ValueError):
+        circuit.layer("rx", params=[0.1, 0.2, 0.3])
+    with pytest.raises(ValueError):
+        circuit.layer("notagate")
+
+
+def test_add_instruction_numeric_params_skip_sympify(monkeypatch):
+    circuit = CunqaCircuit(1)
+    monkeypatch.setattr(circuit_mod, "sympify", Mock(side_effect=AssertionError("sympify called")))
+
+    circuit.rx(0.5, 0)
+
+    assert circuit.instructions == [{"name": "rx", "qubits": [0], "params": [0.5]}]
+
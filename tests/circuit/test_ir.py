@@ -12,6 +12,7 @@ else:
 # tests/test_to_ir.py
 
 import copy
+import struct
 import pytest
 import numpy as np
 from unittest.mock import Mock
@@ -196,3 +197,50 @@ def test_to_ir_quantumcircuit_if_else_without_else_is_supported(monkeypatch):
     # Your code should mark it as dynamic and inline the subcircuit instructions.
     assert ir["is_dynamic"] is True
     assert ir["instructions"][0]["instructions"][0]["name"] == "x"
+
+
+# --- to_binary_task ---
+
+def _binary_quantum_task(instructions):
+    return {
+        "id": "c1",
+        "config": {"shots": 10, "num_qubits": 2, "num_clbits": 1},
+        "instructions": instructions,
+        "sending_to": [],
+        "is_dynamic": False,
+    }
+
+
+def test_to_binary_task_encodes_instruction_table_and_arrays():
+    task = _binary_quantum_task([
+        {"name": "h", "qubits": [0]},
+        {"name": "rx", "qubits": [1], "params": [0.5]},
+        {"name": "h", "qubits": [1]},
+        {"name": "measure", "qubits": [0], "clbits": [0]},
+    ])
+
+    data = mod_ir.to_binary_task(task)
+
+    assert data.startswith(mod_ir.BINARY_TASK_MAGIC)
+    # Repeated names are stored once in the name table
+    assert data.count(b"rx") == 1 and data.count(b"measure") == 1
+    # Qubits, clbits and parameters are the trailing little-endian arrays
+    assert data.endswith(
+        struct.pack("<5i", 0, 1, 1, 0, 0) + struct.pack("<d", 0.5)
+    )
+
+
+def test_to_binary_task_returns_none_for_non_table_instructions():
+    task = _binary_quantum_task([
+        {"name": "cif", "clbits": [0], "instructions": [{"name": "x", "qubits": [0]}]}
+    ])
+
+    assert mod_ir.to_binary_task(task) is None
+
+
+def test_to_binary_task_returns_none_for_matrix_params():
+    task = _binary_quantum_task([
+        {"name": "unitary", "qubits": [0], "params": [[[[1, 0], [0, 0]], [[0, 0], [1, 0]]]]}
+    ])
+
+    assert mod_ir.to_binary_task(task) is None
@@ -9,8 +9,10 @@ else:
     HOME = os.getenv("HOME")
     sys.path.insert(0, HOME)
 
-from sympy import symbols, Symbol
-from cunqa.circuit.parameter import Param
+import math
+import pytest
+from sympy import symbols, Symbol, Function, sin, exp, sqrt, pi
+from cunqa.circuit.parameter import Param, lower_params
 
 
 def test_initialization_sets_expr_and_none_value():
@@ -100,3 +102,44 @@ def test_overwriting_value_with_assign_value():
 
     p.assign_value(10)
     assert p.value == 10
+
+
+def _run_tape(operations, values):
+    """Reference interpreter of the tapes that cunqa.qclient.ParamTape evaluates."""
+    functions = [math.sin, math.cos, math.tan, math.asin, math.acos, math.atan,
+                 math.sinh, math.cosh, math.tanh, math.exp, math.log, abs]
+    stack, params = [], []
+    for opcode, arg, value in operations:
+        if opcode == 0:
+            stack.append(value)
+        elif opcode == 1:
+            stack.append(values[arg])
+        elif opcode in (2, 3):
+            operands = [stack.pop() for _ in range(arg)]
+            stack.append(sum(operands) if opcode == 2 else math.prod(operands))
+        elif opcode == 4:
+            exponent = stack.pop()
+            stack.append(stack.pop() ** exponent)
+        elif opcode == 5:
+            stack.append(functions[arg](stack.pop()))
+        else:
+            params.append(stack.pop())
+    return params
+
+
+def test_lower_params_evaluates_as_sympy():
+    x, y = symbols("x y")
+    params = [Param(2 * x - y / 3), Param(sin(x) * exp(y) + sqrt(x)), Param(pi / 2 + x ** 2)]
+
+    tape = lower_params(params, ["x", "y"])
+
+    for param, value in zip(params, _run_tape(tape, [0.7, -1.3])):
+        assert value == pytest.approx(float(param.expr.subs({x: 0.7, y: -1.3})))
+
+
+def test_lower_params_of_unknown_functions_raises():
+    x = Symbol("x")
+
+    with pytest.raises(NotImplementedError):
+        lower_params([Param(Function("f")(x))], ["x"])
+
@@ -10,6 +10,7 @@ else:
     sys.path.insert(0, HOME)
 
 import copy
+import json
 import pytest
 
 import cunqa.circuit.transformations as part_mod
@@ -276,3 +277,41 @@ def test_add_concatenates_instructions_and_sets_shape_and_id():
         {"name": "x", "qubits": [0]},
         {"name": "measure", "qubits": [1], "clbits": [2]},
     ]
+
+
+class FakeNativeTranspiler:
+    """Stands for the native module, recording what transpile passes to it."""
+
+    def __init__(self):
+        self.args = None
+
+    def transpile_instructions(self, instructions, *args):
+        self.args = args
+        return json.dumps({
+            "instructions": [{"name": "rz", "qubits": [3], "params": [1.0]}],
+            "num_qubits": 5,
+            "report": {"swaps": 0}
+        })
+
+
+def test_transpile_passes_the_backend_to_the_native_pass(monkeypatch):
+    native = FakeNativeTranspiler()
+    monkeypatch.setattr(part_mod, "_qclient", native)
+    circuit = FakeCircuit(num_qubits=2, num_clbits=1, id="A")
+    circuit.add_instructions({"name": "h", "qubits": [0]})
+    backend = {"basis_gates": ["rz", "sx", "ecr"], "coupling_map": [[0, 1]], "n_qubits": 5}
+
+    out = part_mod.transpile(circuit, backend, initial_layout=[3, 4], seed=7)
+
+    assert native.args == (["rz", "sx", "ecr"], [[0, 1]], 2, 5, [3, 4], 7)
+    assert out.num_qubits == 5
+    assert out.num_clbits == 1
+    assert out.id == "A_transpiled"
+    assert out.instructions == [{"name": "rz", "qubits": [3], "params": [1.0]}]
+
+
+def test_transpile_without_native_module_raises(monkeypatch):
+    monkeypatch.setattr(part_mod, "_qclient", None)
+
+    with pytest.raises(ValueError):
+        part_mod.transpile(FakeCircuit(num_qubits=1), {"basis_gates": ["u3"]})
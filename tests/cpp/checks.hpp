@@ -0,0 +1,141 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <exception>
+#include <functional>
+
+#include "utils/json.hpp"
+
+// Checks of the C++ tests. Each test file registers its cases with TEST_CASE and runs them from
+// main with run_cases(), which reports the failed ones and returns the exit code for ctest
+namespace cunqa {
+namespace test {
+
+struct Case {
+    const char* name;
+    std::function<void()> run;
+};
+
+inline std::vector<Case>& cases()
+{
+    static std::vector<Case> registered;
+    return registered;
+}
+
+inline bool register_case(const char* name, std::function<void()> run)
+{
+    cases().push_back({name, std::move(run)});
+    return true;
+}
+
+struct CheckFailed : std::exception {
+    std::string message;
+    explicit CheckFailed(std::string message) : message{std::move(message)} {}
+    const char* what() const noexcept override { return message.c_str(); }
+};
+
+inline int run_cases()
+{
+    int failed = 0;
+    for (const auto& test_case : cases()) {
+        try {
+            test_case.run();
+            std::printf("PASSED %s\n", test_case.name);
+        } catch (const std::exception& e) {
+            std::printf("FAILED %s\n    %s\n", test_case.name, e.what());
+            failed++;
+        }
+    }
+    std::printf("%zu cases, %d failed\n", cases().size(), failed);
+    return failed == 0 ? 0 : 1;
+}
+
+// Everything written to std::cerr while it lives
+class CerrCapture {
+public:
+    CerrCapture() : previous_{std::cerr.rdbuf(captured_.rdbuf())} {}
+    ~CerrCapture() { std::cerr.rdbuf(previous_); }
+
+    std::string str() const { return captured_.str(); }
+
+private:
+    std::ostringstream captured_;
+    std::streambuf* previous_;
+};
+
+inline std::size_t occurrences(const std::string& text, const std::string& pattern)
+{
+    std::size_t n = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + pattern.size()))
+        n++;
+    return n;
+}
+
+// Quantum task in the JSON layout that the clients send
+inline std::string quantum_task(const std::string& id, const std::vector<JSON>& instructions, const int n_qubits,
+                                const int n_clbits, const int shots, const JSON& extra_config = JSON::object())
+{
+    JSON config = {
+        {"shots", shots},
+        {"method", "statevector"},
+        {"num_qubits", n_qubits},
+        {"num_clbits", n_clbits},
+        {"seed", 1234}
+    };
+    config.update(extra_config);
+    JSON task = {
+        {"id", id},
+        {"instructions", instructions},
+        {"config", config},
+        {"is_dynamic", true}
+    };
+    return task.dump();
+}
+
+inline JSON gate(const std::string& name, const std::vector<int>& qubits, const std::vector<double>& params = {})
+{
+    JSON instruction = {{"name", name}, {"qubits", qubits}};
+    if (!params.empty())
+        instruction["params"] = params;
+    return instruction;
+}
+
+inline JSON measure(const int qubit, const int clbit)
+{
+    return {{"name", "measure"}, {"qubits", {qubit}}, {"clbits", {clbit}}};
+}
+
+} // End of test namespace
+} // End of cunqa namespace
+
+#define CUNQA_CONCAT_(a, b) a##b
+#define CUNQA_CONCAT(a, b) CUNQA_CONCAT_(a, b)
+
+#define TEST_CASE(name)                                                                            \
+    static void name();                                                                            \
+    static const bool CUNQA_CONCAT(name, _registered) = cunqa::test::register_case(#name, name);  \
+    static void name()
+
+#define CHECK(condition)                                                                           \
+    do {                                                                                           \
+        if (!(condition))                                                                          \
+            throw cunqa::test::CheckFailed(std::string(__FILE__) + ":" + std::to_string(__LINE__) \
+                                           + ": CHECK(" #condition ") failed");                   \
+    } while (false)
+
+#define CHECK_EQ(actual, expected)                                                                 \
+    do {                                                                                           \
+        const auto& actual_ = (actual);                                                            \
+        const auto& expected_ = (expected);                                                        \
+        if (!(actual_ == expected_)) {                                                             \
+            std::ostringstream message_;                                                           \
+            message_ << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected ")"    \
+                     << " failed, " << cunqa::JSON(actual_).dump() << " != "                      \
+                     << cunqa::JSON(expected_).dump();                                             \
+            throw cunqa::test::CheckFailed(message_.str());                                        \
+        }                                                                                          \
+    } while (false)
@@ -0,0 +1,155 @@
+#include <string>
+#include <vector>
+
+#include "quantum_task.hpp"
+#include "backends/simulators/CUNQA/cunqa_adapters/cunqa_simulator_adapter.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+using namespace cunqa::test;
+
+namespace {
+
+constexpr int SHOTS = 64;
+
+// Tasks simulated together, as the QC executor does, and their counts by task
+JSON simulate_dynamic(const std::vector<std::string>& tasks, const bool allows_qc = true)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& task : tasks)
+        quantum_tasks.emplace_back(task);
+    CunqaSimulatorAdapter simulator(CunqaComputationAdapter(std::move(quantum_tasks)));
+    const JSON result = simulator.simulate(nullptr, allows_qc);
+    if (result.contains("ERROR"))
+        throw std::runtime_error(result.at("ERROR").get<std::string>());
+    return result.at("id_counts");
+}
+
+} // End of anonymous namespace
+
+// The exposed qubits go back to |+> once the remote control ends, so each one needs the Z of
+// its own pair
+TEST_CASE(test_expose_several_qubits_corrects_each_qubit)
+{
+    const auto a = quantum_task("a", {
+        gate("h", {0}), gate("h", {1}),
+        {{"name", "expose"}, {"qubits", {0, 1}}, {"qpus", {"b"}}},
+        gate("h", {0}), gate("h", {1}),
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS, {{"n_communication_qubits", 4}});
+    const auto b = quantum_task("b", {
+        {{"name", "rcontrol"}, {"qpus", {"a"}}, {"instructions", {gate("x", {0})}}},
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("a"), JSON({{"00", SHOTS}}));
+    CHECK_EQ(counts.at("b"), JSON({{"1", SHOTS}}));
+}
+
+// The label of an exposed qubit can be the operand of any gate in the block of the remote control,
+// not only of the controlled ones. The SWAP leaves the |1> of the copy on b
+TEST_CASE(test_rcontrol_label_in_swap_resolves_to_pair)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}),
+        {{"name", "expose"}, {"qubits", {0}}, {"qpus", {"b"}}},
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS, {{"n_communication_qubits", 2}});
+    const auto b = quantum_task("b", {
+        {{"name", "rcontrol"}, {"qpus", {"a"}}, {"instructions", {gate("swap", {-1, 0})}}},
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("a"), JSON({{"01", SHOTS}}));
+    CHECK_EQ(counts.at("b"), JSON({{"1", SHOTS}}));
+}
+
+// |-> only survives the teleportation if the X follows the measurement of the entangled qubit
+// and the Z the one of the sent qubit
+TEST_CASE(test_qrecv_teleported_minus_state_measures_one_in_x_basis)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}), gate("h", {0}),
+        {{"name", "qsend"}, {"qubits", {0}}, {"qpus", {"b"}}}
+    }, 1, 1, SHOTS, {{"n_communication_qubits", 2}});
+    const auto b = quantum_task("b", {
+        {{"name", "qrecv"}, {"qubits", {0}}, {"qpus", {"a"}}},
+        gate("h", {0}),
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("b"), JSON({{"1", SHOTS}}));
+}
+
+// b is visited first, so its RECV blocks before a has sent anything and only the SEND can unblock it
+TEST_CASE(test_recv_before_send_with_quantum_communications_unblocks)
+{
+    const auto b = quantum_task("b", {
+        {{"name", "recv"}, {"clbits", {0}}, {"qpus", {"a"}}}
+    }, 1, 1, SHOTS);
+    const auto a = quantum_task("a", {
+        gate("x", {0}),
+        measure(0, 0),
+        {{"name", "send"}, {"clbits", {0}}, {"qpus", {"b"}}}
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({b, a});
+
+    CHECK_EQ(counts.at("b"), JSON({{"1", SHOTS}}));
+}
+
+// A barrier only orders the circuit, so the dynamic simulation goes past it without complaint
+TEST_CASE(test_barrier_is_skipped)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}),
+        gate("barrier", {0, 1}),
+        gate("cx", {0, 1}),
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    JSON counts;
+    std::string errors;
+    {
+        CerrCapture capture;
+        counts = simulate_dynamic({a});
+        errors = capture.str();
+    }
+
+    CHECK_EQ(occurrences(errors, "not suported"), 0u);
+    CHECK_EQ(counts.at("a"), JSON({{"11", SHOTS}}));
+}
+
+// The simulation goes on without an instruction it does not know, and says so once instead of at
+// every shot
+TEST_CASE(test_unsupported_instruction_is_reported_once)
+{
+    const auto a = quantum_task("a", {
+        gate("rxx", {0, 1}, {0.5}),
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    JSON counts;
+    std::string errors;
+    {
+        CerrCapture capture;
+        counts = simulate_dynamic({a});
+        errors = capture.str();
+    }
+
+    CHECK_EQ(occurrences(errors, "Instruction that failed: rxx"), 1u);
+    CHECK_EQ(counts.at("a"), JSON({{"00", SHOTS}}));
+}
+
+int main()
+{
+    return run_cases();
+}
@@ -0,0 +1,67 @@
+#include <string>
+#include <vector>
+
+#include "quantum_task.hpp"
+#include "backends/simulators/Maestro/maestro_adapters/maestro_simulator_adapter.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+using namespace cunqa::test;
+
+namespace {
+
+constexpr int SHOTS = 64;
+
+// Tasks simulated together, as the QC executor does, and their counts by task
+JSON simulate_dynamic(const std::vector<std::string>& tasks, const bool allows_qc = true)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& task : tasks)
+        quantum_tasks.emplace_back(task);
+    MaestroSimulatorAdapter simulator(MaestroComputationAdapter(std::move(quantum_tasks)));
+    const JSON result = simulator.simulate(nullptr, allows_qc);
+    if (result.contains("ERROR"))
+        throw std::runtime_error(result.at("ERROR").get<std::string>());
+    return result.at("id_counts");
+}
+
+} // End of anonymous namespace
+
+// The Toffoli was applied as a controlled phase whose angle was the index of the target
+TEST_CASE(test_ccx_flips_target_when_both_controls_are_set)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}), gate("x", {1}),
+        gate("ccx", {0, 1, 2}),
+        measure(0, 0), measure(1, 1), measure(2, 2)
+    }, 3, 3, SHOTS);
+
+    const JSON counts = simulate_dynamic({a});
+
+    CHECK_EQ(counts.at("a"), JSON({{"111", SHOTS}}));
+}
+
+// RESET took the qubit of the task as a qubit of the whole state, so b reset the qubit of a
+TEST_CASE(test_reset_takes_task_offset)
+{
+    const auto a = quantum_task("a", {
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+    const auto b = quantum_task("b", {
+        gate("x", {0}),
+        gate("reset", {0}),
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("a"), JSON({{"0", SHOTS}}));
+    CHECK_EQ(counts.at("b"), JSON({{"0", SHOTS}}));
+}
+
+int main()
+{
+    return run_cases();
+}
@@ -0,0 +1,60 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "quantum_task.hpp"
+#include "backends/simulators/Munich/munich_adapters/munich_simulator_adapter.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+using namespace cunqa::test;
+
+namespace {
+
+constexpr int SHOTS = 64;
+
+// Tasks simulated together, as the QC executor does, and the whole result
+JSON simulate_dynamic(const std::vector<std::string>& tasks, const bool allows_qc = true)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& task : tasks)
+        quantum_tasks.emplace_back(task);
+    MunichSimulatorAdapter simulator(std::make_unique<QuantumComputationAdapter>(std::move(quantum_tasks)));
+    const JSON result = simulator.simulate(nullptr, allows_qc);
+    if (result.contains("ERROR"))
+        throw std::runtime_error(result.at("ERROR").get<std::string>());
+    return result;
+}
+
+} // End of anonymous namespace
+
+// The tasks were visited in the order of a hash map. In the order given a sends before b
+// receives, so b only waits for the qubit, while the other way round it also waits for the clbit
+TEST_CASE(test_tasks_are_visited_in_order)
+{
+    const auto a = quantum_task("a", {
+        {{"name", "send"}, {"clbits", {0}}, {"qpus", {"b"}}},
+        gate("x", {0}),
+        {{"name", "qsend"}, {"qubits", {0}}, {"qpus", {"b"}}}
+    }, 1, 1, SHOTS, {{"n_communication_qubits", 2}});
+    const auto b = quantum_task("b", {
+        {{"name", "recv"}, {"clbits", {0}}, {"qpus", {"a"}}},
+        {{"name", "qrecv"}, {"qubits", {0}}, {"qpus", {"a"}}},
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON a_first = simulate_dynamic({a, b});
+    const JSON b_first = simulate_dynamic({b, a});
+
+    CHECK_EQ(a_first.at("id_counts").at("b"), JSON({{"1", SHOTS}}));
+    CHECK_EQ(a_first.at("scheduler").at("blocked_iterations"), SHOTS);
+    CHECK_EQ(b_first.at("id_counts").at("b"), JSON({{"1", SHOTS}}));
+    CHECK_EQ(b_first.at("scheduler").at("blocked_iterations"), 2 * SHOTS);
+}
+
+int main()
+{
+    return run_cases();
+}
@@ -0,0 +1,134 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+
+#include "qpu.hpp"
+#include "comm/client.hpp"
+#include "backends/backend.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::test;
+
+namespace {
+
+// Backend whose first execution waits until the test lets it go, so that the tasks sent meanwhile
+// stay queued in the vQPU
+class HeldBackend : public sim::Backend {
+public:
+    JSON execute(const QuantumTask& quantum_task) const override
+    {
+        std::unique_lock lock(mutex_);
+        executions_++;
+        changed_.notify_all();
+        changed_.wait(lock, [this] { return released_; });
+        return {{"counts", {{"00", quantum_task.config.value("shots", 0)}}}, {"time_taken", 0.0}};
+    }
+
+    JSON to_json() const override
+    {
+        return {{"simulator", "Cunqa"}, {"basis_gates", {"h", "x", "sx", "rz", "cx"}}, {"n_qubits", 2}};
+    }
+
+    void wait_until_running() const
+    {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [this] { return executions_ > 0; });
+    }
+
+    void release() const
+    {
+        std::lock_guard lock(mutex_);
+        released_ = true;
+        changed_.notify_all();
+    }
+
+    int executions() const
+    {
+        std::lock_guard lock(mutex_);
+        return executions_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    mutable std::condition_variable changed_;
+    mutable int executions_ = 0;
+    mutable bool released_ = false;
+};
+
+// vQPU of a single worker on a held backend, serving until the process ends. Each case takes a new
+// one, as it holds its backend until the case releases it
+struct ServingQPU {
+    const HeldBackend* backend;
+    comm::Client client;
+
+    explicit ServingQPU(const std::string& name)
+    {
+        auto held = std::make_unique<HeldBackend>();
+        backend = held.get();
+        auto* qpu = new QPU(std::move(held), "hpc", name, "tests", "no_comm");
+        client.connect(qpu->server->endpoint);
+        std::thread([qpu]() { qpu->turn_ON(); }).detach();
+    }
+};
+
+const std::vector<JSON> BELL = {gate("h", {0}), gate("cx", {0, 1}), measure(0, 0), measure(1, 1)};
+const JSON PREPARED = {{"transpile", true}, {"optimize", true}};
+
+} // End of anonymous namespace
+
+// Dropped as soon as it is parsed, so neither the transpiler nor the optimizer report on it
+TEST_CASE(test_cancelled_task_is_dropped_before_the_passes)
+{
+    ServingQPU serving("test_qpu_cancelled");
+    auto running = serving.client.send_circuit(quantum_task("running", BELL, 2, 2, 10));
+    serving.backend->wait_until_running();
+
+    auto cancelled = serving.client.send_circuit(quantum_task("cancelled", BELL, 2, 2, 10, PREPARED));
+    cancelled.cancel();
+    // Answered after the cancel, which the vQPU reads in order
+    serving.client.send_status().get();
+    serving.backend->release();
+
+    const JSON result = JSON::parse(cancelled.get());
+    CHECK_EQ(result.value("ERROR", std::string()), std::string("Request cancelled."));
+    CHECK(!result.contains("transpilation"));
+    CHECK(!result.contains("optimization"));
+    CHECK(JSON::parse(running.get()).contains("counts"));
+    CHECK_EQ(serving.backend->executions(), 1);
+}
+
+TEST_CASE(test_expired_task_is_dropped_before_the_passes)
+{
+    ServingQPU serving("test_qpu_expired");
+    auto running = serving.client.send_circuit(quantum_task("running", BELL, 2, 2, 10));
+    serving.backend->wait_until_running();
+
+    JSON config = PREPARED;
+    config["deadline"] = 0.001;
+    auto expired = serving.client.send_circuit(quantum_task("expired", BELL, 2, 2, 10, config));
+    serving.client.send_status().get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    serving.backend->release();
+
+    const JSON result = JSON::parse(expired.get());
+    CHECK(result.value("ERROR", std::string()).starts_with("Deadline of"));
+    CHECK(!result.contains("transpilation"));
+    CHECK(!result.contains("optimization"));
+    CHECK(JSON::parse(running.get()).contains("counts"));
+    CHECK_EQ(serving.backend->executions(), 1);
+}
+
+int main()
+{
+    // Without waiting for the vQPUs, which never return from turn_ON
+    const int exit_code = run_cases();
+    std::fflush(stdout);
+    std::_Exit(exit_code);
+}
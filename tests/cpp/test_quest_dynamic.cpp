@@ -0,0 +1,107 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "quantum_task.hpp"
+#include "backends/simulators/QuEST/quest_adapters/quest_simulator_adapter.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+using namespace cunqa::test;
+
+namespace {
+
+constexpr int SHOTS = 64;
+
+// Tasks simulated together, as the QC executor does, and their counts by task
+JSON simulate_dynamic(const std::vector<std::string>& tasks, const bool allows_qc = true)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& task : tasks)
+        quantum_tasks.emplace_back(task);
+    QuestSimulatorAdapter simulator(QuestComputationAdapter(std::move(quantum_tasks)));
+    const JSON result = simulator.simulate(nullptr, allows_qc);
+    if (result.contains("ERROR"))
+        throw std::runtime_error(result.at("ERROR").get<std::string>());
+    return result.at("id_counts");
+}
+
+} // End of anonymous namespace
+
+// QuEST threw on any instruction it did not know, barriers included
+TEST_CASE(test_barrier_is_skipped)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}),
+        gate("barrier", {0, 1}),
+        gate("cx", {0, 1}),
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    const JSON counts = simulate_dynamic({a});
+
+    CHECK_EQ(counts.at("a"), JSON({{"11", SHOTS}}));
+}
+
+// RESET reinitialized the whole state instead of its own qubit
+TEST_CASE(test_reset_leaves_other_qubits)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}), gate("x", {1}), gate("x", {2}),
+        gate("reset", {1}),
+        measure(0, 0), measure(1, 1), measure(2, 2)
+    }, 3, 3, SHOTS);
+
+    const JSON counts = simulate_dynamic({a});
+
+    CHECK_EQ(counts.at("a"), JSON({{"101", SHOTS}}));
+}
+
+// The controlled gadgets took the qubits of the task as qubits of the whole state. In b the
+// gadget turns the |+> of its target into |->, but only if it is controlled by the |1> of b
+TEST_CASE(test_controlled_phase_gadget_takes_task_offset)
+{
+    const auto a = quantum_task("a", {
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+    const auto b = quantum_task("b", {
+        gate("x", {0}), gate("h", {1}),
+        gate("cphasegadget", {0, 1}, {M_PI}),
+        gate("h", {1}),
+        measure(0, 0), measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("a"), JSON({{"0", SHOTS}}));
+    CHECK_EQ(counts.at("b"), JSON({{"11", SHOTS}}));
+}
+
+// QuEST refuses the instructions it does not know before the first shot, so one in a branch that
+// is never taken still fails the simulation
+TEST_CASE(test_unsupported_instruction_is_refused_before_the_first_shot)
+{
+    const auto a = quantum_task("a", {
+        measure(0, 0),
+        {{"name", "cif"}, {"clbits", {0}}, {"operation", "and"}, {"condition", 1},
+         {"instructions", {gate("rxx", {0, 1}, {0.5})}}},
+        measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    bool refused = false;
+    try {
+        simulate_dynamic({a});
+    } catch (const std::invalid_argument&) {
+        refused = true;
+    }
+
+    CHECK(refused);
+}
+
+int main()
+{
+    return run_cases();
+}
@@ -0,0 +1,115 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "quantum_task.hpp"
+#include "backends/simulators/Qulacs/qulacs_adapters/qulacs_simulator_adapter.hpp"
+
+#include "checks.hpp"
+
+using namespace cunqa;
+using namespace cunqa::sim;
+using namespace cunqa::test;
+
+// Objects allocated with new and not deleted yet, along the whole test
+static std::atomic<long> live_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        live_allocations++;
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p == nullptr)
+        return;
+    live_allocations--;
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace {
+
+constexpr int SHOTS = 64;
+
+// Tasks simulated together, as the QC executor does, and their counts by task
+JSON simulate_dynamic(const std::vector<std::string>& tasks, const bool allows_qc = true)
+{
+    std::vector<QuantumTask> quantum_tasks;
+    for (const auto& task : tasks)
+        quantum_tasks.emplace_back(task);
+    QulacsSimulatorAdapter simulator(QulacsComputationAdapter(std::move(quantum_tasks)));
+    const JSON result = simulator.simulate(nullptr, allows_qc);
+    if (result.contains("ERROR"))
+        throw std::runtime_error(result.at("ERROR").get<std::string>());
+    return result.at("id_counts");
+}
+
+} // End of anonymous namespace
+
+// The noise gates took the qubit of the task as a qubit of the whole state, so the certain flip
+// of b landed on the qubit of a
+TEST_CASE(test_noise_takes_task_offset)
+{
+    const auto a = quantum_task("a", {
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+    const auto b = quantum_task("b", {
+        gate("bitflipnoise", {0}, {1.0}),
+        measure(0, 0)
+    }, 1, 1, SHOTS);
+
+    const JSON counts = simulate_dynamic({a, b});
+
+    CHECK_EQ(counts.at("a"), JSON({{"0", SHOTS}}));
+    CHECK_EQ(counts.at("b"), JSON({{"1", SHOTS}}));
+}
+
+// Qulacs returns its gates as raw pointers, which the dynamic simulation has to free after
+// applying them. The first run fills the caches, so the next two have to end with as many live
+// objects as each other
+TEST_CASE(test_gates_are_freed)
+{
+    const auto a = quantum_task("a", {
+        gate("h", {0}), gate("cx", {0, 1}),
+        measure(0, 0),
+        gate("rz", {1}, {0.5}), gate("x", {1}),
+        measure(1, 1)
+    }, 2, 2, SHOTS);
+
+    simulate_dynamic({a});
+    simulate_dynamic({a});
+    const long after_second = live_allocations;
+    simulate_dynamic({a});
+    const long after_third = live_allocations;
+
+    CHECK_EQ(after_third, after_second);
+}
+
+// The Pauli string after the measurements needs the qubits in order, so the swap of the
+// deterministic prefix has to run. The engine of the prefix relabelled it instead, as the prefix
+// alone has no Pauli string, and the |1> was measured where the swap had not taken it
+TEST_CASE(test_prefix_swap_runs_when_task_needs_ordered_qubits)
+{
+    const auto a = quantum_task("a", {
+        gate("x", {0}), gate("swap", {0, 1}),
+        measure(0, 0), measure(1, 1),
+        {{"name", "paulistr"}, {"qubits", {0, 1}}, {"paulistr", "ZZ"}}
+    }, 2, 2, SHOTS, {{"shot_branching", false}});
+
+    const JSON counts = simulate_dynamic({a});
+
+    CHECK_EQ(counts.at("a"), JSON({{"10", SHOTS}}));
+}
+
+int main()
+{
+    return run_cases();
+}
@@ -254,6 +254,31 @@ def test_transpiler_routing_for_non_adjacent_qubits(fakeqmio_backend):
                 for edge in coupling_set
             ), f"Interaction {interaction} is not routable"
 
+def test_transpiler_reuses_template_for_same_structure(fakeqmio_backend, monkeypatch):
+    """Test that a circuit with the same gates but other parameters is not transpiled again"""
+    import cunqa.qiskit_deps.transpiler as transpiler_module
+
+    calls = []
+    qiskit_transpile = transpiler_module.transpile
+    monkeypatch.setattr(transpiler_module, "transpile", lambda *args, **kwargs: calls.append(1) or qiskit_transpile(*args, **kwargs))
+    monkeypatch.setattr(transpiler_module, "_transpiled_templates", type(transpiler_module._transpiled_templates)())
+
+    def ansatz(theta):
+        qc = QuantumCircuit(3)
+        qc.rx(theta, 0)
+        qc.cx(0, 2)
+        qc.rz(2 * theta, 2)
+        qc.measure_all()
+        return qc
+
+    first = transpiler(ansatz(0.3), fakeqmio_backend, seed=1)
+    second = transpiler(ansatz(1.1), fakeqmio_backend, seed=1)
+
+    assert len(calls) == 1
+    assert not second.parameters
+    assert first.count_ops() == second.count_ops()
+    assert first != second
+
 # Helper function for previous test
 def is_routable_interaction(interaction, coupling_map):
     """
@@ -119,8 +119,8 @@ def test_init_binds_connects_writes_config(monkeypatch):
 
     monkeypatch.setattr(qmio_linked_mod, "_get_IP", Mock(return_value="10.1.2.3"))
     monkeypatch.setattr(qmio_linked_mod, "_get_qmio_config", Mock(return_value={"cfg":1}))
-    write_json = Mock()
-    monkeypatch.setattr(qmio_linked_mod, "write_json", write_json)
+    write_registry_entry = Mock()
+    monkeypatch.setattr(qmio_linked_mod, "write_registry_entry", write_registry_entry)
     monkeypatch.setattr(qmio_linked_mod, "ZMQ_ENDPOINT", "tcp://127.0.0.1:5555")
     monkeypatch.setenv("SLURM_JOB_ID", "393219")
     monkeypatch.setenv("SLURM_TASK_PID", "7")
@@ -132,7 +132,7 @@ def test_init_binds_connects_writes_config(monkeypatch):
     assert linker.port == 43210
     assert linker.endpoint == "tcp://10.1.2.3:43210"
     req_socket.connect.assert_called_once_with("tcp://127.0.0.1:5555")
-    write_json.assert_called_once_with(qmio_linked_mod.QPUS_FILEPATH, {"393219_7": {"cfg":1}})
+    write_registry_entry.assert_called_once_with(qmio_linked_mod.QPUS_REGISTRY, "393219_7", {"cfg":1})
 
 
 def test_run_starts_two_threads(monkeypatch):
@@ -0,0 +1,103 @@
+# test_cutting.py
+
+import os, sys
+from unittest.mock import Mock
+import numpy as np
+import pytest
+
+IN_GITHUB_ACTIONS = os.getenv("GITHUB_ACTIONS") == "true"
+
+if IN_GITHUB_ACTIONS:
+    sys.path.insert(0, os.getcwd())
+else:
+    HOME = os.getenv("HOME")
+    sys.path.insert(0, HOME)
+
+from cunqa.circuit import CunqaCircuit
+from cunqa.cutting import plan_cuts
+
+
+def chain(num_qubits):
+    circuit = CunqaCircuit(num_qubits, num_qubits)
+    for q in range(num_qubits):
+        circuit.h(q)
+    for q in range(num_qubits - 1):
+        circuit.cx(q, q + 1)
+    circuit.measure(list(range(num_qubits)), list(range(num_qubits)))
+    return circuit
+
+
+def deterministic(outcome):
+    result = Mock()
+    result.counts_arrays = (np.array([outcome], dtype=np.uint64), np.array([100], dtype=np.uint64))
+    return result
+
+
+def test_fragments_fit_in_max_qubits():
+    plan = plan_cuts(chain(8), max_qubits=3)
+
+    assert plan.num_fragments == 3
+    assert all(width <= 3 for width in plan.fragment_qubits)
+    assert plan.num_cuts == 2
+
+
+def test_gate_cut_has_five_variants_per_side():
+    plan = plan_cuts(chain(4), max_qubits=2)
+
+    assert plan.num_cuts == 1
+    assert plan.num_variants == 10
+    assert len(plan.variants()) == 10
+    assert sum(variant.is_dynamic for variant in plan.variants()) == 2
+
+
+def test_other_gates_are_wire_cut_into_a_fragment_with_room():
+    circuit = CunqaCircuit(4, 4)
+    circuit.swap(1, 2)
+    circuit.measure([0, 1, 2, 3], [0, 1, 2, 3])
+
+    plan = plan_cuts(circuit, max_qubits=3, sections=[[0, 1], [2, 3]])
+
+    assert plan.num_cuts == 1
+    assert sorted(plan.fragment_qubits) == [2, 3]
+    assert plan.num_variants == 3 + 4
+
+
+def test_wire_cut_without_room_raises():
+    circuit = CunqaCircuit(4, 4)
+    circuit.swap(1, 2)
+    circuit.measure([0, 1, 2, 3], [0, 1, 2, 3])
+
+    with pytest.raises(ValueError):
+        plan_cuts(circuit, max_qubits=2)
+
+
+def test_gates_after_measurements_raise():
+    circuit = CunqaCircuit(2, 2)
+    circuit.measure(0, 0)
+    circuit.h(0)
+
+    with pytest.raises(ValueError):
+        plan_cuts(circuit, max_qubits=1)
+
+
+def test_reconstruction_of_gate_cut():
+    # CZ on |00> leaves it as it is, and every variant measures 0
+    circuit = CunqaCircuit(2, 2)
+    circuit.cz(0, 1)
+    circuit.measure([0, 1], [0, 1])
+    plan = plan_cuts(circuit, max_qubits=1)
+
+    probs = plan.reconstruct([deterministic(0) for _ in range(plan.num_variants)])
+
+    assert np.allclose(probs, [1, 0, 0, 0])
+
+
+def test_reconstruction_of_marginal():
+    circuit = CunqaCircuit(2, 2)
+    circuit.x(1)
+    circuit.measure([0, 1], [0, 1])
+    plan = plan_cuts(circuit, max_qubits=1)
+
+    probs = plan.reconstruct([deterministic(0), deterministic(1)], clbits=[1])
+
+    assert np.allclose(probs, [0, 1])
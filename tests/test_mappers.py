@@ -58,6 +58,22 @@ def test_qjobmapper_call_correctly(monkeypatch):
     assert gathered_with["qjobs"] == [q1, q2, q3]
     assert out == ["cost(result-q1)", "cost(result-q2)", "cost(result-q3)"]
 
+def test_qjobmapper_call_batches_population_larger_than_qjobs():
+    q1, q2 = Mock(), Mock()
+    q1.upgrade_parameters_batch = Mock()
+    q2.upgrade_parameters_batch = Mock()
+    q1.result_batch = ["r0", "r2", "r4"]
+    q2.result_batch = ["r1", "r3"]
+    mapper = QJobMapper([q1, q2])
+
+    population = [[0.0], [1.0], [2.0], [3.0], [4.0]]
+    out = mapper(lambda result: f"cost({result})", population)
+
+    q1.upgrade_parameters_batch.assert_called_once_with([[0.0], [2.0], [4.0]])
+    q2.upgrade_parameters_batch.assert_called_once_with([[1.0], [3.0]])
+    q1.upgrade_parameters.assert_not_called()
+    assert out == [f"cost(r{i})" for i in range(5)]
+
 # ------------------------
 # QPUCircuitMapper tests
 # ------------------------
@@ -136,6 +152,30 @@ def test_qpucircuitmapper_call_runs_circuits_round_robin_and_maps_results(monkey
     assert out == [f"cost=result({j})" for j in gathered_jobs["jobs"]]
 
 
+def test_qpucircuitmapper_sends_jobs_to_the_least_loaded_qpus(monkeypatch):
+    from qiskit import QuantumCircuit
+    from types import SimpleNamespace
+
+    circuit = QuantumCircuit(1)
+    monkeypatch.setattr(circuit, "assign_parameters", lambda params: f"assembled({params})")
+
+    # a is busy for 3 s more than b, and both take a second per task
+    qpu_a = SimpleNamespace(queue={"depth": 3, "running": 1, "task_seconds": 1.0, "eta": 4.0})
+    qpu_b = SimpleNamespace(queue={"depth": 0, "running": 1, "task_seconds": 1.0, "eta": 1.0})
+    mapper = QPUCircuitMapper([qpu_a, qpu_b], circuit)
+
+    run_calls = []
+    def fake_run(circuit_assembled, qpu, **run_params):
+        run_calls.append(qpu)
+        return circuit_assembled
+    monkeypatch.setattr(mappers_mod, "run", fake_run)
+    monkeypatch.setattr(mappers_mod, "gather", lambda jobs: list(jobs))
+
+    mapper(lambda result: result, [[0.1]] * 5)
+
+    assert run_calls == [qpu_b, qpu_b, qpu_b, qpu_a, qpu_b]
+
+
 def test_qpucircuitmapper_call_wraps_qiskiterror_as_runtimeerror(monkeypatch):
     from qiskit import QuantumCircuit
     from qiskit.exceptions import QiskitError
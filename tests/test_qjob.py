@@ -84,6 +84,36 @@ def test_qjob_init_default_run_config(
     logger_mock.warning.assert_called_once()
 
 
+
+def test_qjob_init_normalizes_observables(qclient_mock, circuit_ir, default_device):
+    class SparsePauliOpLike:
+        def to_list(self):
+            return [("XX", 0.5 + 0j), ("ZI", 1)]
+
+    job = QJob(qclient_mock, default_device, circuit_ir, observables=["ZZ", SparsePauliOpLike()])
+
+    assert job._quantum_task["config"]["observables"] == ["ZZ", [["XX", 0.5], ["ZI", 1.0]]]
+
+def test_qjob_init_selects_the_clbits_of_the_registers(qclient_mock, circuit_ir, default_device):
+    circuit_ir["classical_registers"] = {"a": [0, 1], "b": [2], "c": [3, 4]}
+    circuit_ir["num_clbits"] = 5
+
+    job = QJob(qclient_mock, default_device, circuit_ir, registers=["c", "a"])
+
+    assert job._quantum_task["config"]["clbits"] == [0, 1, 3, 4]
+    assert "registers" not in job._quantum_task["config"]
+    assert job._cregisters == {"a": [0, 1], "c": [2, 3]}
+
+def test_qjob_init_selects_the_clbits(qclient_mock, circuit_ir, default_device):
+    job = QJob(qclient_mock, default_device, circuit_ir, clbits=[1])
+
+    assert job._quantum_task["config"]["clbits"] == [1]
+    assert job._cregisters == {"clbits": [0]}
+
+def test_qjob_init_rejects_unknown_registers(qclient_mock, circuit_ir, default_device):
+    with pytest.raises(ValueError):
+        QJob(qclient_mock, default_device, circuit_ir, registers=["d"])
+
 def test_qjob_init_overrides_run_config(qclient_mock, circuit_ir, default_device):
     job = QJob(
         qclient_mock, 
@@ -141,6 +171,103 @@ def test_result_fetches_once_and_caches(
     future_mock.get.assert_not_called()
 
 
+def test_result_with_binary_counts(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    future_mock = Mock(name="FutureWrapper")
+    outcomes, counts = Mock(name="outcomes"), Mock(name="counts")
+    future_mock.get.return_value = (json.dumps({"time_taken": 0.1}), outcomes, counts, 2)
+
+    result_mock = Mock(return_value=Mock(name="Result"))
+    monkeypatch.setattr(qjob_mod, "Result", result_mock)
+
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = future_mock
+    job.result
+
+    args, kwargs = result_mock.call_args
+    assert args[0] == {"time_taken": 0.1}
+    assert kwargs["binary_counts"] == (outcomes, counts, 2)
+
+
+def test_result_with_binary_states(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    future_mock = Mock(name="FutureWrapper")
+    doubles = Mock(name="doubles")
+    future_mock.get.return_value = (json.dumps({"time_taken": 0.1}), doubles)
+
+    result_mock = Mock(return_value=Mock(name="Result"))
+    monkeypatch.setattr(qjob_mod, "Result", result_mock)
+
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = future_mock
+    job.result
+
+    args, kwargs = result_mock.call_args
+    assert args[0] == {"time_taken": 0.1}
+    assert kwargs["binary_states"] is doubles
+    assert kwargs["binary_counts"] is None
+
+
+def test_partial_result_of_a_streaming_job(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    future_mock = Mock(name="FutureWrapper")
+    future_mock.partial.return_value = json.dumps({"counts": {"00": 5}, "shots": 5, "partial": True})
+    result_mock = Mock(return_value=Mock(name="Result"))
+    monkeypatch.setattr(qjob_mod, "Result", result_mock)
+
+    job = QJob(qclient_mock, default_device, circuit_ir, stream_shots=5)
+    job._future = future_mock
+
+    assert job.partial_result is result_mock.return_value
+    args, _ = result_mock.call_args
+    assert args[0]["shots"] == 5
+
+    future_mock.partial.return_value = None
+    assert job.partial_result is None
+
+
+def test_stop_asks_the_future_once_submitted(qclient_mock, circuit_ir, default_device):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    with pytest.raises(RuntimeError):
+        job.stop()
+
+    job._future = Mock(name="FutureWrapper")
+    job.stop()
+    job._future.stop.assert_called_once()
+
+
+def test_cancel_asks_the_future_once_submitted(qclient_mock, circuit_ir, default_device):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    with pytest.raises(RuntimeError):
+        job.cancel()
+
+    job._future = Mock(name="FutureWrapper")
+    job.cancel()
+    job._future.cancel.assert_called_once()
+
+
+def test_cancel_after_the_result_arrived_does_nothing(qclient_mock, circuit_ir, default_device):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = Mock(name="FutureWrapper")
+    job._updated = True
+    job.cancel()
+    job._future.cancel.assert_not_called()
+
+
+def test_queue_is_that_of_the_last_result_read(qclient_mock, circuit_ir, default_device):
+    queue = {"depth": 2, "running": 1, "task_seconds": 0.5, "eta": 1.5}
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    assert job.queue is None
+
+    job._future = Mock(name="FutureWrapper")
+    job._future.get.return_value = json.dumps({"counts": {"0": 1}, "time_taken": 0.1, "queue": queue})
+    job.result
+    assert job.queue == queue
+
+
 def test_result_with_no_future(qclient_mock, circuit_ir, default_device):
     with pytest.raises(RuntimeError) as _:
         job = QJob(qclient_mock, default_device, circuit_ir)
@@ -216,6 +343,54 @@ def test_submit_without_param_values_does_not_call_assign(
     assign_mock.assert_not_called()
 
 
+def test_submit_sends_binary_task_when_enabled(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    monkeypatch.setattr(qjob_mod, "to_binary_task", lambda task: b"binary_task")
+
+    job = QJob(qclient_mock, default_device, circuit_ir, binary_task=True)
+    job.submit()
+
+    qclient_mock.send_circuit.assert_called_once_with(b"binary_task")
+
+
+def test_submit_falls_back_to_json_when_binary_not_possible(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    monkeypatch.setattr(qjob_mod, "to_binary_task", lambda task: None)
+    monkeypatch.setattr(
+        "cunqa.qjob.json.dumps",
+        lambda obj, default=None: "serialized_task"
+    )
+
+    job = QJob(qclient_mock, default_device, circuit_ir, binary_task=True)
+    job.submit()
+
+    qclient_mock.send_circuit.assert_called_once_with("serialized_task")
+
+
+def test_submit_sends_the_hash_of_the_stored_circuit(qclient_mock, circuit_ir, default_device, tmp_path):
+    job = QJob(qclient_mock, default_device, circuit_ir, binary_task=True, circuit_store=str(tmp_path))
+    job.submit()
+
+    (message,), _ = qclient_mock.send_circuit.call_args
+    task = json.loads(message)
+    assert "instructions" not in task and "circuit_store" not in task["config"]
+    assert os.listdir(tmp_path) == [task["circuit_ref"]]
+
+
+def test_store_circuit_writes_each_circuit_once(tmp_path):
+    from cunqa.circuit.ir import store_circuit
+
+    instructions = [{"name": "h", "qubits": [0]}, {"name": "unitary", "qubits": [0], "params": [[[[1, 0], [0, 0]], [[0, 0], [1, 0]]]]}]
+    ref = store_circuit(instructions, str(tmp_path))
+
+    assert store_circuit(instructions, str(tmp_path)) == ref
+    assert os.listdir(tmp_path) == [ref]
+    assert json.loads((tmp_path / ref).read_text()) == instructions
+    assert store_circuit(instructions[:1], str(tmp_path)) != ref
+
+
 def test_submit_twice_logs_error(
     qclient_mock, logger_mock, circuit_ir, default_device
 ):
@@ -391,6 +566,225 @@ def test_multiple_consecutive_upgrades(qjob_instance, qclient_mock):
     assert qclient_mock.send_parameters.call_count == 3
     assert qjob_instance.assign_parameters_.call_count == 3
 
+# ------------------------------------
+# QJob.upgrade_parameters_batch method
+# ------------------------------------
+
+def _submitted_qjob(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = Mock()
+    job._updated = True # Result of the circuit already obtained
+    job._params = []
+    job.assign_parameters_ = Mock(side_effect=lambda values: setattr(job, "_params", list(values)))
+    return job
+
+
+def test_upgrade_parameters_batch_sends_single_message(qclient_mock, default_device, circuit_ir):
+    job = _submitted_qjob(qclient_mock, default_device, circuit_ir)
+
+    job.upgrade_parameters_batch([[0.1, 0.2], [0.3, 0.4]], shots=10)
+
+    (message,), _ = qclient_mock.send_parameters.call_args
+    assert json.loads(message) == {"params_batch": [[0.1, 0.2], [0.3, 0.4]], "shots": 10}
+    assert job._is_batch is True and job._updated is False
+
+
+def test_upgrade_parameters_batch_without_circuit_raises(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+
+    with pytest.raises(RuntimeError):
+        job.upgrade_parameters_batch([[0.1]])
+
+
+def test_result_batch_returns_one_result_per_parameter_set(
+    monkeypatch, qclient_mock, default_device, circuit_ir
+):
+    job = _submitted_qjob(qclient_mock, default_device, circuit_ir)
+    future = Mock()
+    future.get.return_value = json.dumps({"batch": [{"counts": {"0": 1}}, {"counts": {"1": 1}}]})
+    qclient_mock.send_parameters.return_value = future
+    result_mock = Mock(side_effect=lambda res, circ_id, registers: res["counts"])
+    monkeypatch.setattr(qjob_mod, "Result", result_mock)
+
+    job.upgrade_parameters_batch([[0.1], [0.2]])
+
+    assert job.result_batch == [{"0": 1}, {"1": 1}]
+    assert job.result_batch == [{"0": 1}, {"1": 1}]
+    future.get.assert_called_once()
+
+
+def test_result_after_batch_raises(qclient_mock, default_device, circuit_ir):
+    job = _submitted_qjob(qclient_mock, default_device, circuit_ir)
+    job.upgrade_parameters_batch([[0.1]])
+
+    with pytest.raises(RuntimeError):
+        job.result
+
+
+# ------------------------
+# submit_batch
+# ------------------------
+
+def test_submit_batch_sends_all_tasks_in_one_message(qclient_mock, default_device, circuit_ir):
+    jobs = [QJob(qclient_mock, default_device, circuit_ir, shots=10) for _ in range(3)]
+
+    qjob_mod.submit_batch(jobs)
+
+    (message,), _ = qclient_mock.send_circuit.call_args
+    tasks = json.loads(message)["tasks"]
+    assert len(tasks) == 3 and qclient_mock.send_circuit.call_count == 1
+    assert tasks[0] == json.loads(json.dumps(jobs[0]._quantum_task, default=encoder))
+
+
+def test_submit_batch_splits_the_reply_among_the_jobs(
+    monkeypatch, qclient_mock, default_device, circuit_ir
+):
+    future = Mock()
+    future.get.return_value = json.dumps({
+        "batch": [{"counts": {"0": 1}}, {"counts": {"1": 1}}], "queue": {"depth": 0}
+    })
+    qclient_mock.send_circuit.return_value = future
+    monkeypatch.setattr(qjob_mod, "Result", Mock(side_effect=lambda res, **kwargs: Mock(
+        counts=res["counts"], queue=res["queue"]
+    )))
+    jobs = [QJob(qclient_mock, default_device, circuit_ir) for _ in range(2)]
+
+    qjob_mod.submit_batch(jobs)
+
+    assert [job.result.counts for job in jobs] == [{"0": 1}, {"1": 1}]
+    assert jobs[1].queue == {"depth": 0}
+    future.get.assert_called_once()
+
+
+def test_submit_batch_error_is_that_of_every_job(
+    monkeypatch, qclient_mock, default_device, circuit_ir
+):
+    future = Mock()
+    future.get.return_value = json.dumps({"ERROR": "Empty batch of tasks."})
+    qclient_mock.send_circuit.return_value = future
+    monkeypatch.setattr(qjob_mod, "Result", Mock(side_effect=lambda res, **kwargs: Mock(
+        error=res["ERROR"], queue=None
+    )))
+    jobs = [QJob(qclient_mock, default_device, circuit_ir) for _ in range(2)]
+
+    qjob_mod.submit_batch(jobs)
+
+    assert [job.result.error for job in jobs] == ["Empty batch of tasks."] * 2
+
+
+def test_submit_batch_of_several_vqpus_raises(default_device, circuit_ir):
+    jobs = [QJob(Mock(), default_device, circuit_ir) for _ in range(2)]
+
+    with pytest.raises(ValueError):
+        qjob_mod.submit_batch(jobs)
+
+
+def test_upgrade_parameters_of_a_batched_job_raises(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    qjob_mod.submit_batch([job])
+
+    with pytest.raises(RuntimeError):
+        job.upgrade_parameters([0.1])
+
+
+# ------------------------
+# QJob.upgrade_circuit
+# ------------------------
+
+def test_upgrade_circuit_sends_the_new_instructions_only(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job.submit()
+    grown = dict(circuit_ir, num_qubits=4, instructions=circuit_ir["instructions"] + [{"name": "x", "qubits": [3]}])
+
+    job.upgrade_circuit(grown, shots=50)
+
+    (message,), _ = qclient_mock.send_circuit.call_args
+    append = json.loads(message)["append"]
+    assert append["at"] == 1 and append["instructions"] == [{"name": "x", "qubits": [3]}]
+    assert append["config"] == {"num_qubits": 4, "num_clbits": 2, "shots": 50}
+    assert job._quantum_task["instructions"] == grown["instructions"]
+
+
+def test_upgrade_circuit_replaces_from_the_first_change(qclient_mock, default_device, circuit_ir):
+    circuit_ir["instructions"] = [{"name": "h", "qubits": [0]}, {"name": "x", "qubits": [1]}]
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job.submit()
+    changed = dict(circuit_ir, instructions=[{"name": "h", "qubits": [0]}, {"name": "y", "qubits": [1]}])
+
+    job.upgrade_circuit(changed)
+
+    (message,), _ = qclient_mock.send_circuit.call_args
+    append = json.loads(message)["append"]
+    assert append["at"] == 1 and append["instructions"] == [{"name": "y", "qubits": [1]}]
+    assert "shots" not in append["config"]
+
+
+def test_upgrade_circuit_without_circuit_raises(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+
+    with pytest.raises(RuntimeError):
+        job.upgrade_circuit(circuit_ir)
+
+
+# ------------------------
+# QJob.retained
+# ------------------------
+
+def _retained_state(monkeypatch, qclient_mock, default_device, circuit_ir, answer):
+    monkeypatch.setattr(qjob_mod, "Result", Mock(side_effect=lambda res, **kwargs: Mock(
+        retained=res.get("retained"), counts=res.get("counts"), queue=None
+    )))
+    job = QJob(qclient_mock, default_device, circuit_ir, retain=True)
+    job._future = Mock(get=Mock(return_value=json.dumps({
+        "counts": {"00": 10}, "retained": {"handle": "ab12", "num_qubits": 3, "bytes": 128, "ttl": 0}
+    })))
+    qclient_mock.send_circuit.return_value = Mock(get=Mock(return_value=json.dumps(answer)))
+    return job.retained
+
+
+def test_retained_queries_send_the_handle(monkeypatch, qclient_mock, default_device, circuit_ir):
+    state = _retained_state(monkeypatch, qclient_mock, default_device, circuit_ir,
+                            {"expectation_values": [0.5], "method": "exact", "time_taken": 0.0})
+
+    assert state.handle == "ab12" and state.num_qubits == 3
+    assert state.expectation_values("ZZI") == [0.5]
+    (message,), _ = qclient_mock.send_circuit.call_args
+    assert json.loads(message) == {"retained": {"handle": "ab12", "observables": ["ZZI"]}}
+
+
+def test_retained_sample_gives_a_result(monkeypatch, qclient_mock, default_device, circuit_ir):
+    state = _retained_state(monkeypatch, qclient_mock, default_device, circuit_ir,
+                            {"counts": {"11": 7}, "time_taken": 0.0})
+
+    assert state.sample(7, seed=3).counts == {"11": 7}
+    (message,), _ = qclient_mock.send_circuit.call_args
+    assert json.loads(message)["retained"] == {"handle": "ab12", "shots": 7, "seed": 3}
+
+
+def test_retained_amplitudes_are_complex(monkeypatch, qclient_mock, default_device, circuit_ir):
+    state = _retained_state(monkeypatch, qclient_mock, default_device, circuit_ir,
+                            {"amplitudes": [[0.5, -0.5]], "time_taken": 0.0})
+
+    assert state.amplitudes([3]) == [complex(0.5, -0.5)]
+
+
+def test_retained_query_error_raises(monkeypatch, qclient_mock, default_device, circuit_ir):
+    state = _retained_state(monkeypatch, qclient_mock, default_device, circuit_ir,
+                            {"ERROR": "No state is retained as ab12."})
+
+    with pytest.raises(RuntimeError):
+        state.marginal([0])
+
+
+def test_retained_of_a_job_without_it_raises(monkeypatch, qclient_mock, default_device, circuit_ir):
+    monkeypatch.setattr(qjob_mod, "Result", Mock(side_effect=lambda res, **kwargs: Mock(retained=None, queue=None)))
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = Mock(get=Mock(return_value=json.dumps({"counts": {"00": 10}})))
+
+    with pytest.raises(RuntimeError):
+        job.retained
+
+
 # ------------------------
 # assign_parameters_
 # ------------------------
@@ -493,6 +887,39 @@ def test_assign_parameters_dict_mixed_params(
     param2.eval.assert_not_called()
 
 
+def test_assign_parameters_with_every_symbol_uses_the_binder(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    binder = Mock(symbols=["phi", "theta"])
+    binder.bind.return_value = [0.5, 0.25]
+    monkeypatch.setattr(qjob_mod, "ParamBinder", Mock(return_value=binder))
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._params = [Mock(), Mock()]
+
+    job.assign_parameters_({"theta": 0.1, "phi": 0.2})
+    job.assign_parameters_({"theta": 0.3, "phi": 0.4})
+
+    qjob_mod.ParamBinder.assert_called_once()
+    job._params[0].assign_value.assert_called_with(0.5)
+    job._params[1].assign_value.assert_called_with(0.25)
+    job._params[0].eval.assert_not_called()
+
+
+def test_assign_parameters_without_binder_falls_back_to_sympy(
+    monkeypatch, qclient_mock, circuit_ir, default_device
+):
+    monkeypatch.setattr(qjob_mod, "ParamBinder", Mock(side_effect=NotImplementedError("f(x)")))
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    param = Mock()
+    param.variables = [Mock()]
+    param.variables[0].name = "theta"
+    job._params = [param]
+
+    job.assign_parameters_({"theta": 0.1})
+
+    param.eval.assert_called_once_with({"theta": 0.1})
+
+
 # ------------------------
 # gather
 # ------------------------
@@ -515,3 +942,79 @@ def test_gather_returns_list_of_results(monkeypatch):
 def test_gather_with_non_iterable_raises():
     with pytest.raises(AttributeError) as _:
         _ = gather(None)
+
+
+# ------------------------
+# done / wait / as_completed
+# ------------------------
+
+def _submitted_job(qclient_mock, default_device, circuit_ir, future):
+    qclient_mock.send_circuit.return_value = future
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job.submit()
+    return job
+
+
+def test_done_asks_the_future_without_waiting(qclient_mock, default_device, circuit_ir):
+    future = Mock(name="FutureWrapper")
+    future.ready.return_value = False
+    job = _submitted_job(qclient_mock, default_device, circuit_ir, future)
+
+    assert job.done() is False
+    future.ready.return_value = True
+    assert job.done() is True
+    future.get.assert_not_called()
+
+
+def test_done_before_submit_raises(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    with pytest.raises(RuntimeError):
+        job.done()
+
+
+def test_wait_with_timeout_forwards_it(qclient_mock, default_device, circuit_ir):
+    future = Mock(name="FutureWrapper")
+    future.wait_for.return_value = False
+    job = _submitted_job(qclient_mock, default_device, circuit_ir, future)
+
+    assert job.wait(0.5) is False
+    future.wait_for.assert_called_once_with(0.5)
+
+
+def test_wait_without_timeout_waits_in_slices(qclient_mock, default_device, circuit_ir):
+    future = Mock(name="FutureWrapper")
+    future.wait_for.side_effect = [False, False, True]
+    job = _submitted_job(qclient_mock, default_device, circuit_ir, future)
+
+    assert job.wait() is True
+    assert future.wait_for.call_count == 3
+
+
+def test_as_completed_yields_in_completion_order():
+    finished = set()
+    qjobs = [Mock(name=f"qjob{i}") for i in range(3)]
+    for qjob in qjobs:
+        qjob.done.side_effect = lambda qjob=qjob: qjob in finished
+
+    # Each wait lets the jobs finish in reverse order
+    order = list(reversed(qjobs))
+    def finish_next(_):
+        finished.add(order.pop(0))
+    for qjob in qjobs:
+        qjob.wait.side_effect = finish_next
+
+    assert list(qjob_mod.as_completed(qjobs)) == list(reversed(qjobs))
+
+
+def test_as_completed_times_out():
+    qjob = Mock(name="qjob")
+    qjob.done.return_value = False
+
+    with pytest.raises(TimeoutError):
+        list(qjob_mod.as_completed([qjob], timeout=0.01))
+    assert qjob.wait.called
+
+
+def test_as_completed_with_no_jobs_raises():
+    with pytest.raises(AttributeError):
+        list(qjob_mod.as_completed([]))
@@ -1,4 +1,4 @@
-import os, sys
+import os, sys, json
 from unittest.mock import Mock, patch, mock_open
 import pytest
 
@@ -28,7 +28,7 @@ def test_init_connects_when_endpoint_is_ok():
                   device={"device_name": "CPU", "target_devices": []}, 
                   family="f", 
                   endpoint=endpoint)
-    QClientMock.assert_called_once_with()
+    QClientMock.assert_called_once_with(multiplexed=False)
     qclient_instance.connect.assert_called_once_with(endpoint)
     assert qpu.id == 1
     assert qpu._backend is backend
@@ -47,9 +47,32 @@ def test_init_raises_when_endpoint_is_bad():
                 device={"device_name": "CPU", "target_devices": []}, 
                 family="f", 
                 endpoint=endpoint)
-    QClientMock.assert_called_once_with()
+    QClientMock.assert_called_once_with(multiplexed=False)
     qclient_instance.connect.assert_called_once_with(endpoint)
 
+def test_init_multiplexes_the_client_when_requested(monkeypatch):
+    monkeypatch.setenv("CUNQA_MULTIPLEXED_CLIENT", "1")
+    with patch.object(qpu_mod, "QClient") as QClientMock:
+        QPU(id=1, 
+            backend=Mock(name="Backend"), 
+            device={"device_name": "CPU", "target_devices": []}, 
+            family="f", 
+            endpoint="tcp://endpoint")
+    QClientMock.assert_called_once_with(multiplexed=True)
+
+def test_init_passes_the_local_endpoint_when_published():
+    with patch.object(qpu_mod, "QClient") as QClientMock:
+        qclient_instance = Mock()
+        QClientMock.return_value = qclient_instance
+        QPU(id=1, 
+            backend=Mock(name="Backend"), 
+            device={"device_name": "CPU", "target_devices": []}, 
+            family="f", 
+            endpoint="tcp://127.0.0.1:5555",
+            local_endpoint="ipc:///tmp/cunqa-1-0.sock",
+            nodename="c7-1")
+    qclient_instance.connect.assert_called_once_with("tcp://127.0.0.1:5555", "ipc:///tmp/cunqa-1-0.sock", "c7-1")
+
 def test_init_connects_with_qmioclient_when_device_is_qpu(monkeypatch):
     backend = Mock()
     endpoint = "tcp://endpoint"
@@ -102,6 +125,7 @@ def test_execute_creates_qjob_submits_and_returns_without_param(monkeypatch, qpu
         qpu._qclient, 
         {"device_name": "CPU", "target_devices": []},
         circuit, 
+        binary_task=False,
         **run_parameters
     )
     qjob_instance.submit.assert_called_once_with(None)
@@ -119,6 +143,7 @@ def test_execute_creates_qjob_and_submits_with_var_values(monkeypatch, qpu):
         qpu._qclient,
         qpu._device,
         circuit,
+        binary_task=False,
         shots=100
     )
     qjob_instance.submit.assert_called_once_with(param_values)
@@ -312,10 +337,132 @@ def test_run_passes_param_values_to_execute(monkeypatch):
     assert result is job
 
 
+def test_run_least_loaded_sends_the_circuits_to_the_least_loaded_qpus(monkeypatch):
+    circuits_ir = {c: {"id": c, "instructions": [{"name": "x"}], "sending_to": []} for c in ["c1", "c2", "c3"]}
+    monkeypatch.setattr(qpu_mod, "to_ir", Mock(side_effect=lambda circuit: circuits_ir[circuit]))
+
+    busy, idle = Mock(name="Busy"), Mock(name="Idle")
+    busy.id, idle.id = 1, 2
+    busy.status.return_value = {"depth": 9, "running": 1, "task_seconds": 1.0, "eta": 10.0}
+    idle.status.return_value = {"depth": 0, "running": 0, "task_seconds": 1.0, "eta": 0.0}
+
+    run(["c1", "c2", "c3"], [busy, idle], dispatch="least_loaded", shots=10)
+
+    assert idle.execute.call_count == 3
+    busy.execute.assert_not_called()
+
+def test_run_least_loaded_rejects_circuits_with_communications(monkeypatch):
+    circuit_ir = {"id": "c1", "instructions": [], "sending_to": ["c2"]}
+    monkeypatch.setattr(qpu_mod, "to_ir", Mock(return_value=circuit_ir))
+
+    with pytest.raises(ValueError):
+        run("c1", [Mock(name="QPU")], dispatch="least_loaded")
+
+def test_run_sharded_splits_the_shots_with_a_seed_per_qpu(monkeypatch):
+    circuit_ir = {"id": "c1", "instructions": [{"name": "x"}], "sending_to": []}
+    monkeypatch.setattr(qpu_mod, "to_ir", Mock(return_value=circuit_ir))
+    qpus = [Mock(name=f"QPU{i}") for i in range(3)]
+    for i, qpu in enumerate(qpus):
+        qpu.id = i
+
+    qjob = run("c1", qpus, dispatch="sharded", shots=10, seed=7, method="sv")
+
+    calls = [qpu.execute.call_args for qpu in qpus]
+    assert [call.kwargs["shots"] for call in calls] == [4, 3, 3]
+    assert len({call.kwargs["seed"] for call in calls}) == 3
+    assert all(call.kwargs["method"] == "sv" for call in calls)
+    assert [call.args[0]["id"] for call in calls] == [("c1", 0), ("c1", 1), ("c1", 2)]
+    assert [shard["shots"] for shard in qjob._shards] == [4, 3, 3]
+
+    # The same seed gives the same shards
+    again = run("c1", qpus, dispatch="sharded", shots=10, seed=7)
+    assert [shard["seed"] for shard in again._shards] == [call.kwargs["seed"] for call in calls]
+
+def test_run_sharded_rejects_circuits_with_communications(monkeypatch):
+    circuit_ir = {"id": "c1", "instructions": [], "sending_to": ["c2"]}
+    monkeypatch.setattr(qpu_mod, "to_ir", Mock(return_value=circuit_ir))
+
+    with pytest.raises(ValueError):
+        run("c1", [Mock(name="QPU")], dispatch="sharded")
+
+def test_run_sharded_rejects_checkpoint(monkeypatch):
+    circuit_ir = {"id": "c1", "instructions": [{"name": "x"}], "sending_to": []}
+    monkeypatch.setattr(qpu_mod, "to_ir", Mock(return_value=circuit_ir))
+    qpu = Mock(name="QPU")
+
+    with pytest.raises(ValueError):
+        run("c1", [qpu], dispatch="sharded", checkpoint="job")
+    qpu.execute.assert_not_called()
+
+
+# ------------------------
+# least_loaded and QPU.status tests
+# ------------------------
+from cunqa.qpu import least_loaded
+
+def test_least_loaded_takes_turns_without_status():
+    qpus = [object(), object()]
+    assert least_loaded(qpus, 3) == [qpus[0], qpus[1], qpus[0]]
+
+def test_least_loaded_gives_more_jobs_to_faster_qpus():
+    slow, fast = Mock(name="Slow"), Mock(name="Fast")
+    slow.status.return_value = {"depth": 0, "running": 0, "task_seconds": 2.0, "eta": 0.0}
+    fast.status.return_value = {"depth": 0, "running": 0, "task_seconds": 0.5, "eta": 0.0}
+
+    assigned = least_loaded([slow, fast], 5)
+
+    assert assigned.count(fast) == 4
+    assert assigned.count(slow) == 1
+
+def test_least_loaded_uses_the_last_queue_without_refresh():
+    qpu_a, qpu_b = Mock(name="A"), Mock(name="B")
+    qpu_a.queue = {"depth": 0, "running": 0, "task_seconds": 1.0, "eta": 5.0}
+    qpu_b.queue = {"depth": 0, "running": 0, "task_seconds": 1.0, "eta": 0.0}
+
+    assert least_loaded([qpu_a, qpu_b], 1, refresh=False) == [qpu_b]
+    qpu_a.status.assert_not_called()
+
+def test_least_loaded_skips_draining_qpus():
+    draining, taking = Mock(name="Draining"), Mock(name="Taking")
+    draining.status.return_value = {"depth": 0, "running": 0, "task_seconds": 1.0, "eta": 0.0, "draining": True}
+    taking.status.return_value = {"depth": 5, "running": 1, "task_seconds": 1.0, "eta": 6.0, "draining": False}
+
+    assert least_loaded([draining, taking], 2) == [taking, taking]
+
+def _qpu_with_status_future(future):
+    with patch.object(qpu_mod, "QClient") as QClientMock:
+        QClientMock.return_value.send_status.return_value = future
+        return QPU(id=1, 
+                   backend=Mock(name="Backend"), 
+                   device={"device_name": "CPU", "target_devices": []}, 
+                   family="f", 
+                   endpoint="tcp://endpoint")
+
+def test_status_queries_the_vqpu():
+    status = {"depth": 1, "running": 1, "task_seconds": 0.5, "eta": 1.0, "name": "q", "n_workers": 1}
+    future = Mock(name="FutureWrapper")
+    future.wait_for.return_value = True
+    future.get.return_value = json.dumps(status)
+    qpu = _qpu_with_status_future(future)
+
+    assert qpu.status(timeout=2.0) == status
+    future.wait_for.assert_called_once_with(2.0)
+    assert qpu.queue == status
+
+def test_status_is_none_when_the_vqpu_does_not_answer():
+    future = Mock(name="FutureWrapper")
+    future.wait_for.return_value = False
+    qpu = _qpu_with_status_future(future)
+
+    assert qpu.status() is None
+
+
 # ------------------------
 # qraise tests
 # ------------------------
 from cunqa.qpu import qraise
+import cunqa.utils.registry as registry_mod
+from cunqa.utils.registry import write_registry_entry
 
 def _subprocess_run_side_effect_ok(job_id="12345"):
     """
@@ -341,11 +488,10 @@ def _subprocess_run_side_effect_ok(job_id="12345"):
 def test_qraise_builds_command_and_returns_job_id_without_family(monkeypatch):
     n, t = 1, "00:10:00"
 
-    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: True)
-    monkeypatch.setattr("builtins.open", mock_open())
+    monkeypatch.setattr(qpu_mod, "init_registry", Mock())
 
     load_mock = Mock(return_value={"12345-0": {}})
-    monkeypatch.setattr(qpu_mod.json, "load", load_mock)
+    monkeypatch.setattr(qpu_mod, "read_registry", load_mock)
 
     run_mock = Mock()
     run_mock.side_effect = _subprocess_run_side_effect_ok("12345")
@@ -376,11 +522,10 @@ def test_qraise_builds_full_command_with_all_options_and_family_tuple_return(mon
     n, t = 2, "01:00:00"
     family = "my_family"
 
-    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: True)
-    monkeypatch.setattr("builtins.open", mock_open())
+    monkeypatch.setattr(qpu_mod, "init_registry", Mock())
 
     load_mock = Mock(return_value={"54321-0": {}, "54321-1": {}})
-    monkeypatch.setattr(qpu_mod.json, "load", load_mock)
+    monkeypatch.setattr(qpu_mod, "read_registry", load_mock)
 
     run_mock = Mock()
     run_mock.side_effect = _subprocess_run_side_effect_ok("54321")
@@ -434,18 +579,73 @@ def test_qraise_builds_full_command_with_all_options_and_family_tuple_return(mon
     assert result == family
 
 
-# --- QPUS_FILEPATH creation ---
+@pytest.fixture
+def qraise_mocks(monkeypatch):
+    """
+    Mocks the registry and subprocess.run of a qraise. The returned function takes the number
+    of vQPUs, registers that many under the job and gives the mock of subprocess.run.
+    """
+    def _install(n, job_id="12345"):
+        monkeypatch.setattr(qpu_mod, "init_registry", Mock())
+        monkeypatch.setattr(qpu_mod, "read_registry", Mock(return_value={f"{job_id}-{i}": {} for i in range(n)}))
+        run_mock = Mock(side_effect=_subprocess_run_side_effect_ok(job_id))
+        monkeypatch.setattr(qpu_mod.subprocess, "run", run_mock)
+        return run_mock
+    return _install
+
+
+@pytest.mark.parametrize("n, kwargs, expected_flags", [
+    (1, {"cores_per_qpu": 8, "workers_per_qpu": 4}, "--cores-per-qpu=8 --workers-per-qpu=4"),
+    (1, {"queue_depth": 100, "queue_memory": 512}, "--queue-depth=100 --queue-memory=512"),
+    (1, {"simulator": "Aer", "precision": "single"}, "--simulator=Aer --precision=single"),
+    (2, {"cores_per_qpu": 8, "numa": True}, "--cores-per-qpu=8 --numa"),
+    (1, {"simulator": "Qsim", "huge_pages": "2M"}, "--simulator=Qsim --huge-pages=2M"),
+    (1, {"cores_per_qpu": 8, "io_cores": 1}, "--cores-per-qpu=8 --io-cores=1"),
+    (1, {"zmq_io_threads": 2, "zmq_hwm": 64, "zmq_tcp_buffer": 4096}, "--zmq-io-threads=2 --zmq-hwm=64 --zmq-tcp-buffer=4096"),
+    (1, {"checkpoint_dir": "/scratch/checkpoints"}, "--checkpoint-dir=/scratch/checkpoints"),
+    (1, {"circuit_store": "/dev/shm/circuits", "circuit_store_cache": 4}, "--circuit-store=/dev/shm/circuits --circuit-store-cache=4"),
+    (8, {"gpu": True, "gpu_sharing": "mps", "gpu_qubits": 28}, "--gpu --gpu-sharing=mps --gpu-qubits=28"),
+    (1, {"simulator": "Quest", "distributed": 4}, "--simulator=Quest --distributed=4"),
+    (2, {"classical_comm": True, "cc_mpi": True}, "--classical_comm --cc_mpi"),
+])
+def test_qraise_adds_flags_when_given(qraise_mocks, n, kwargs, expected_flags):
+    t = "00:10:00"
+    run_mock = qraise_mocks(n)
+
+    qraise(n, t, co_located=False, **kwargs)
+
+    (cmd_str,), _ = run_mock.call_args_list[0]
+    assert cmd_str == f"qraise -n {n} -t {t} {expected_flags}"
+
+
+def test_qraise_adds_grow_when_requested(qraise_mocks):
+    n, t = 2, "00:10:00"
+    run_mock = qraise_mocks(n)
 
-def test_qraise_creates_qpus_file_if_not_exists(monkeypatch):
-    n, t = 1, "00:05:00"
+    result = qraise(n, t, family="elastic", grow=True, co_located=False)
+
+    (cmd_str,), _ = run_mock.call_args_list[0]
+    assert cmd_str == f"qraise -n {n} -t {t} --family_name=elastic --grow"
+    assert result == "elastic"
 
-    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: False)
 
-    m_open = mock_open()
-    monkeypatch.setattr("builtins.open", m_open)
+def test_qraise_grow_needs_the_family(monkeypatch):
+    run_mock = Mock()
+    monkeypatch.setattr(qpu_mod.subprocess, "run", run_mock)
+
+    with pytest.raises(ValueError):
+        qraise(1, "00:10:00", grow=True)
+    run_mock.assert_not_called()
+
 
-    load_mock = Mock(return_value={"99999-0": {}})
-    monkeypatch.setattr(qpu_mod.json, "load", load_mock)
+# --- QPUS_REGISTRY creation ---
+
+def test_qraise_initialises_the_qpus_registry(monkeypatch):
+    n, t = 1, "00:05:00"
+
+    init_mock = Mock()
+    monkeypatch.setattr(qpu_mod, "init_registry", init_mock)
+    monkeypatch.setattr(qpu_mod, "read_registry", Mock(return_value={"99999-0": {}}))
 
     run_mock = Mock()
     run_mock.side_effect = _subprocess_run_side_effect_ok("99999")
@@ -453,36 +653,70 @@ def test_qraise_creates_qpus_file_if_not_exists(monkeypatch):
 
     result = qraise(n, t)
 
-    # Ensure file initialisation "{}" was written
-    m_open.assert_any_call(qpu_mod.QPUS_FILEPATH, "w")
-    handle = m_open()
-    handle.write.assert_called_once_with("{}")
-
+    init_mock.assert_called_once_with(qpu_mod.QPUS_REGISTRY)
     assert result == "99999"
 
 
-# --- JSON decode retry logic ---
-
-def test_qraise_retries_on_jsondecodeerror_until_valid_json(monkeypatch):
+@pytest.mark.parametrize("backend", ["dir", "file"])
+def test_qraise_creates_qpus_registry_if_not_exists(monkeypatch, tmp_path, backend):
     n, t = 1, "00:05:00"
+    registry = str(tmp_path / "qpus")
+
+    monkeypatch.setenv("CUNQA_REGISTRY", backend)
+    monkeypatch.setattr(qpu_mod, "QPUS_REGISTRY", registry)
+    monkeypatch.setattr(qpu_mod, "read_registry", Mock(return_value={"99999-0": {}}))
+    monkeypatch.setattr(qpu_mod.subprocess, "run", Mock(side_effect=_subprocess_run_side_effect_ok("99999")))
+
+    qraise(n, t)
+
+    if backend == "dir":
+        assert os.path.isdir(registry)
+    else:
+        with open(registry + ".json") as f:
+            assert json.load(f) == {}
 
-    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: True)
-    monkeypatch.setattr("builtins.open", mock_open())
+
+# --- Registry polling ---
+
+def test_qraise_waits_until_all_qpus_are_registered(monkeypatch):
+    n, t = 2, "00:05:00"
+
+    monkeypatch.setattr(qpu_mod, "init_registry", Mock())
+    monkeypatch.setattr(qpu_mod.time, "sleep", Mock())
 
     run_mock = Mock()
     run_mock.side_effect = _subprocess_run_side_effect_ok("77777")
     monkeypatch.setattr(qpu_mod.subprocess, "run", run_mock)
 
-    # mock de json.load con primer intento que lanza JSONDecodeError y segundo que va bien
-    decode_error = qpu_mod.json.JSONDecodeError("bad json", "{}", 0)
-    load_mock = Mock(side_effect=[decode_error, {"77777-0": {}}])
-    monkeypatch.setattr(qpu_mod.json, "load", load_mock)
+    load_mock = Mock(side_effect=[{}, {"77777_0": {}}, {"77777_0": {}, "77777_1": {}}])
+    monkeypatch.setattr(qpu_mod, "read_registry", load_mock)
     result = qraise(n, t)
 
-    assert load_mock.call_count >= 2
+    assert load_mock.call_count == 3
     assert result == "77777"
 
 
+def test_qraise_retries_on_corrupt_registry_until_valid(monkeypatch, tmp_path):
+    n, t = 1, "00:05:00"
+    registry = str(tmp_path / "qpus")
+
+    monkeypatch.setenv("CUNQA_REGISTRY", "file")
+    monkeypatch.setattr(registry_mod, "_parsed", {})
+    monkeypatch.setattr(qpu_mod, "QPUS_REGISTRY", registry)
+    monkeypatch.setattr(qpu_mod.subprocess, "run", Mock(side_effect=_subprocess_run_side_effect_ok("88888")))
+    with open(registry + ".json", "w") as f:
+        f.write('{"88888-0": ')  # A writer cut short
+
+    # The vQPU registers while qraise waits
+    sleep_mock = Mock(side_effect=lambda _: write_registry_entry(registry, "88888-0", {}))
+    monkeypatch.setattr(qpu_mod.time, "sleep", sleep_mock)
+
+    result = qraise(n, t)
+
+    assert sleep_mock.call_count == 1
+    assert result == "88888"
+
+
 # --- subprocess error handling ---
 
 def test_qraise_raises_runtimeerror_on_subprocess_error(monkeypatch):
@@ -496,8 +730,7 @@ def test_qraise_raises_runtimeerror_on_subprocess_error(monkeypatch):
         stderr="boom",
     )
 
-    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: True)
-    monkeypatch.setattr("builtins.open", mock_open())
+    monkeypatch.setattr(qpu_mod, "init_registry", Mock())
 
     run_mock = Mock(return_value=completed)
     monkeypatch.setattr(qpu_mod.subprocess, "run", run_mock)
@@ -560,18 +793,43 @@ def test_qdrop_multiple_families(monkeypatch):
 # ------------------------
 from cunqa.qpu import get_QPUs
 
+def test_qdrop_shrinks_a_family(monkeypatch):
+    """With shrink, qdrop should call: ['qdrop', '--fam=family', '--shrink=n']."""
+    called = {}
+
+    def fake_run(cmd, *args, **kwargs):
+        called["cmd"] = cmd
+
+    monkeypatch.setattr(qpu_mod.subprocess, "run", fake_run)
+    qdrop("famA", shrink=2)
+
+    assert called["cmd"] == ["qdrop", "--fam=famA", "--shrink=2"]
+
+
+def test_qdrop_shrinks_a_single_family(monkeypatch):
+    monkeypatch.setattr(qpu_mod.subprocess, "run", Mock())
+
+    with pytest.raises(ValueError):
+        qdrop(["famA", "famB"], shrink=2)
+
+
+def test_qdrop_with_timeout(monkeypatch):
+    """With timeout, qdrop should call: ['qdrop', '--fam=family', '--timeout=t']."""
+    called = {}
+
+    def fake_run(cmd, *args, **kwargs):
+        called["cmd"] = cmd
+
+    monkeypatch.setattr(qpu_mod.subprocess, "run", fake_run)
+    qdrop("famA", timeout=0)
+
+    assert called["cmd"] == ["qdrop", "--fam=famA", "--timeout=0"]
+
 def _mock_qpus_json(monkeypatch, qpus_dict: dict):
     """
-    Make get_QPUs read QPU info from `qpus_dict` instead of a real file.
-    We:
-      - mock `open` in the module where get_QPUs is defined
-      - mock `json.load` in that same module to just return our dict
+    Make get_QPUs read QPU info from `qpus_dict` instead of a real registry.
     """
-    monkeypatch.setattr("builtins.open", mock_open())
-    monkeypatch.setattr("os.open", lambda path, flags, mode: 123)
-    os_close_mock = Mock()
-    monkeypatch.setattr("os.close", os_close_mock)
-    monkeypatch.setattr(qpu_mod.json, "load", lambda f: qpus_dict)
+    monkeypatch.setattr(qpu_mod, "read_registry", lambda registry: qpus_dict)
 
 
 @pytest.fixture
@@ -648,6 +906,7 @@ def test_login_node_co_located(
         device={"device_name": "QPU", "target_devices": ["QMIO"]}, 
         family="fam-A",
         endpoint="tcp://node-1:1234",
+        encodings=None,
     )
 
 
@@ -697,6 +956,7 @@ def test_hpc_without_family_filter(
         device={"device_name": "QPU", "target_devices": ["QMIO"]}, 
         family="fam-A",
         endpoint="tcp://node-1:1234",
+        encodings=None,
     )
 
 
@@ -829,4 +1089,55 @@ def test_co_located_with_family_filter(monkeypatch, qpu_mock):
     assert qpu_mock.call_args.kwargs["id"] == "qpu-2"
     assert qpu_mock.call_args.kwargs["family"] == "fam-B"
     assert qpu_mock.call_args.kwargs["backend"] == "backend-B"
-    
+
+
+def _registry_entry(family, endpoint, draining=False):
+    return {
+        "backend": "backend-" + family,
+        "family": family,
+        "draining": draining,
+        "net": {
+            "device": {"device_name": "CPU", "target_devices": []},
+            "nodename": "node-1",
+            "endpoint": endpoint,
+            "mode": "co_located",
+        },
+    }
+
+
+def test_get_qpus_leaves_out_draining_qpus(monkeypatch, qpu_mock):
+    _mock_qpus_json(
+        monkeypatch,
+        {
+            "1_0": _registry_entry("elastic", "tcp://node-1:1000"),
+            "1_1": _registry_entry("elastic", "tcp://node-1:1001", draining=True),
+        },
+    )
+    monkeypatch.setenv("SLURMD_NODENAME", "node-1")
+
+    qpus = get_QPUs(co_located=True, family="elastic")
+
+    assert len(qpus) == 1
+    assert qpu_mock.call_args.kwargs["id"] == "1_0"
+
+
+from cunqa.qpu import refresh_QPUs
+
+def test_refresh_qpus_keeps_the_known_and_adds_the_new(monkeypatch, qpu_mock):
+    _mock_qpus_json(
+        monkeypatch,
+        {
+            "1_0": _registry_entry("elastic", "tcp://node-1:1000"),
+            "1_1": _registry_entry("elastic", "tcp://node-1:1001", draining=True),
+            "2_0": _registry_entry("elastic", "tcp://node-1:2000"),
+        },
+    )
+    monkeypatch.setenv("SLURMD_NODENAME", "node-1")
+    kept, drained = Mock(name="Kept"), Mock(name="Drained")
+    kept.id, drained.id = "1_0", "1_1"
+
+    qpus = refresh_QPUs([kept, drained], co_located=True, family="elastic")
+
+    assert qpus == [kept, qpu_mock.return_value]
+    qpu_mock.assert_called_once()
+    assert qpu_mock.call_args.kwargs["id"] == "2_0"
@@ -0,0 +1,124 @@
+# test_registry.py
+
+import os, sys
+import json
+import pytest
+
+IN_GITHUB_ACTIONS = os.getenv("GITHUB_ACTIONS") == "true"
+
+if IN_GITHUB_ACTIONS:
+    sys.path.insert(0, os.getcwd())
+else:
+    HOME = os.getenv("HOME")
+    sys.path.insert(0, HOME)
+
+import cunqa.utils.registry as registry_mod
+from cunqa.utils.registry import init_registry, read_registry, write_registry_entry
+
+
+@pytest.fixture(params=["dir", "file"])
+def registry(request, tmp_path, monkeypatch):
+    monkeypatch.setenv("CUNQA_REGISTRY", request.param)
+    monkeypatch.setattr(registry_mod, "_parsed", {})
+    path = str(tmp_path / "qpus")
+    init_registry(path)
+    return path
+
+
+def test_written_entries_are_read(registry):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    write_registry_entry(registry, "1_1", {"family": "b"})
+
+    assert read_registry(registry) == {"1_0": {"family": "a"}, "1_1": {"family": "b"}}
+
+
+def test_read_takes_no_lockfile(registry):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    # A writer holding the lock does not block the readers
+    open(registry + ".json.lock", "w").close()
+
+    assert read_registry(registry) == {"1_0": {"family": "a"}}
+
+
+def test_unchanged_registry_is_not_parsed_again(registry, monkeypatch):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    read_registry(registry)
+
+    def fail(*args, **kwargs):
+        raise AssertionError("parsed again")
+    monkeypatch.setattr(registry_mod.json, "load", fail)
+
+    assert read_registry(registry) == {"1_0": {"family": "a"}}
+
+
+def test_replaced_entry_is_read_again(registry):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    read_registry(registry)
+    write_registry_entry(registry, "1_0", {"family": "b"})
+
+    assert read_registry(registry) == {"1_0": {"family": "b"}}
+
+
+def test_no_temporary_files_are_left(registry, tmp_path):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+
+    leftovers = [name for root, _, names in os.walk(tmp_path) for name in names if name.endswith(".tmp")]
+    assert leftovers == []
+
+
+def test_init_creates_the_registry(registry):
+    backend = os.getenv("CUNQA_REGISTRY")
+
+    if backend == "dir":
+        assert os.path.isdir(registry)
+    else:
+        with open(registry + ".json") as f:
+            assert json.load(f) == {}
+    assert read_registry(registry) == {}
+
+
+def test_init_keeps_an_existing_registry(registry):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    init_registry(registry)
+
+    assert read_registry(registry) == {"1_0": {"family": "a"}}
+
+
+def _corrupt(registry, content):
+    """Leaves an entry, or the whole registry file, with the given content, as a writer cut short."""
+    if os.getenv("CUNQA_REGISTRY") == "dir":
+        path = os.path.join(registry, "1_1.json")
+    else:
+        path = registry + ".json"
+    with open(path, "w") as f:
+        f.write(content)
+
+
+@pytest.mark.parametrize("content", ['{"family": "a"', "", "not json"])
+def test_read_tolerates_a_partial_or_corrupt_registry(registry, content):
+    write_registry_entry(registry, "1_0", {"family": "a"})
+    _corrupt(registry, content)
+
+    entries = read_registry(registry)
+
+    # The entries of a directory that are intact are still read
+    if os.getenv("CUNQA_REGISTRY") == "dir":
+        assert entries == {"1_0": {"family": "a"}}
+    else:
+        assert entries == {}
+
+
+def test_read_recovers_once_the_registry_is_valid_again(registry):
+    _corrupt(registry, '{"family": ')
+    read_registry(registry)
+
+    write_registry_entry(registry, "1_1", {"family": "b"})
+
+    assert read_registry(registry)["1_1"] == {"family": "b"}
+
+
+@pytest.mark.parametrize("backend", ["dir", "file"])
+def test_read_of_a_missing_registry_is_empty(tmp_path, monkeypatch, backend):
+    monkeypatch.setenv("CUNQA_REGISTRY", backend)
+
+    assert read_registry(str(tmp_path / "missing")) == {}
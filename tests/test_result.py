@@ -1,6 +1,7 @@
 # test_result.py
 
 import os, sys
+import numpy as np
 import pytest
 
 IN_GITHUB_ACTIONS = os.getenv("GITHUB_ACTIONS") == "true"
@@ -11,7 +12,7 @@ else:
     HOME = os.getenv("HOME")
     sys.path.insert(0, HOME)
 
-from cunqa.result import Result
+from cunqa.result import Result, QPUBusyError, QPUUnavailableError
 
 
 def test_result_init_raises_on_none():
@@ -26,6 +27,60 @@ def test_result_init_raises_on_error_key():
     with pytest.raises(RuntimeError) as excinfo:
         Result({"ERROR": "no backend"}, circ_id="c1", registers={"c": [0]})
 
+def test_result_init_raises_busy_error_with_the_queue():
+    queue = {"depth": 8, "running": 1, "task_seconds": 0.5, "eta": 4.5}
+    with pytest.raises(QPUBusyError) as excinfo:
+        Result({"ERROR": "vQPU busy", "busy": True, "queue": queue}, circ_id="c", registers={})
+    assert excinfo.value.queue == queue
+
+def test_result_init_raises_unavailable_error_for_a_leaving_qpu():
+    with pytest.raises(QPUUnavailableError):
+        Result({"ERROR": "vQPU dropped", "unavailable": True}, circ_id="c", registers={})
+    # Still a refusal, for those that retry on the busy ones
+    with pytest.raises(QPUBusyError):
+        Result({"ERROR": "vQPU draining", "busy": True, "unavailable": True}, circ_id="c", registers={})
+
+
+def test_queue_of_the_result():
+    queue = {"depth": 0, "running": 1, "task_seconds": 0.5, "eta": 0.5}
+    result = Result({"counts": {"0": 1}, "time_taken": 0.1, "queue": queue}, circ_id="c", registers={})
+    assert result.queue == queue
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).queue is None
+
+
+def test_timings_of_the_result():
+    timings = {"queue": 0.001, "parse": 0.0001, "execute": 0.02, "simulate": 0.019}
+    result = Result({"counts": {"0": 1}, "time_taken": 0.1, "timings": timings}, circ_id="c", registers={})
+    assert result.timings == timings
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).timings is None
+
+
+def test_simulation_method_of_the_result():
+    result = Result({"counts": {"0": 1}, "time_taken": 0.1, "simulation_method": "stabilizer"}, circ_id="c", registers={})
+    assert result.simulation_method == "stabilizer"
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).simulation_method is None
+
+
+def test_deferred_measurements_of_the_result():
+    result = Result({"counts": {"0": 1}, "time_taken": 0.1, "deferred_measurements": {"ancilla_qubits": 1}}, circ_id="c", registers={})
+    assert result.deferred_measurements == {"ancilla_qubits": 1}
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).deferred_measurements is None
+
+
+def test_convergence_of_the_result():
+    convergence = {"shots": 3000, "standard_error": 0.0091, "converged": True}
+    result = Result({"counts": {"0": 3000}, "time_taken": 0.1, "convergence": convergence}, circ_id="c", registers={})
+    assert result.convergence == convergence
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).convergence is None
+
+
+def test_retained_of_the_result():
+    retained = {"handle": "ab12", "num_qubits": 2, "bytes": 64, "ttl": 0}
+    result = Result({"counts": {"0": 1}, "time_taken": 0.1, "retained": retained}, circ_id="c", registers={})
+    assert result.retained == retained
+    assert Result({"counts": {"0": 1}, "time_taken": 0.1}, circ_id="c", registers={}).retained is None
+
+
 def test_counts_from_results_key():
     result_dict = {
         "results": [
@@ -59,6 +114,87 @@ def test_counts_with_empty_registers():
     assert r.counts == {"00111": 23}
 
 
+def test_counts_from_binary_counts():
+    # Outcomes 1 and 6 of three bits, with their counts sent apart from the result
+    binary_counts = (np.array([1, 6], dtype=np.uint64), np.array([40, 60], dtype=np.uint64), 3)
+    r = Result({"time_taken": 0.5}, circ_id="circF", registers={"c": [0, 1, 2]}, 
+               binary_counts=binary_counts)
+
+    outcomes, counts = r.counts_arrays
+    assert outcomes.tolist() == [1, 6]
+    assert counts.tolist() == [40, 60]
+    assert r.counts == {"001": 40, "110": 60}
+
+
+def test_merge_shards_adds_up_the_counts(monkeypatch):
+    import types
+    from collections import Counter
+    from cunqa.result import merge_shards
+
+    def merge_counts(outcomes, counts, num_bits):
+        total = Counter()
+        for o, c in zip(outcomes, counts):
+            total.update(dict(zip(o.tolist(), c.tolist())))
+        keys = sorted(total)
+        return np.array(keys, dtype=np.uint64), np.array([total[k] for k in keys], dtype=np.uint64)
+    monkeypatch.setitem(sys.modules, "cunqa.counts_and_probs", types.SimpleNamespace(merge_counts=merge_counts))
+
+    binary = Result({"time_taken": 0.5}, circ_id="circS", registers={"c": [0, 1, 2]}, 
+                    binary_counts=(np.array([1, 6], dtype=np.uint64), np.array([40, 60], dtype=np.uint64), 3))
+    json_counts = Result({"counts": {"110": 30, "000": 70}, "time_taken": 0.8}, circ_id="circS", registers={"c": [0, 1, 2]})
+    shards = [{"qpu": "qpu_0", "shots": 100, "seed": 1}, {"qpu": "qpu_1", "shots": 100, "seed": 2}]
+
+    merged = merge_shards([binary, json_counts], "circS", {"c": [0, 1, 2]}, shards)
+    assert merged.counts == {"000": 70, "001": 40, "110": 90}
+    assert merged.time_taken == 0.8
+    assert [shard["time_taken"] for shard in merged.shards] == [0.5, 0.8]
+
+
+def test_counts_arrays_without_binary_counts():
+    r = Result({"counts": {"0": 1}, "time_taken": 1.0}, circ_id="circG", registers={"c": [0]})
+    assert r.counts_arrays is None
+
+
+def test_statevector_from_binary_states_views_the_doubles():
+    # Two amplitudes of a one-qubit state, (0.6, 0) and (0, 0.8), sent apart from the result
+    doubles = np.array([0.6, 0.0, 0.0, 0.8])
+    result_dict = {"counts": {"0": 1}, "time_taken": 0.5, 
+                   "statevector": {"binary_state": {"offset": 0, "shape": [2, 2]}}}
+    r = Result(result_dict, circ_id="circS", registers={"c": [0]}, binary_states=doubles)
+
+    statevector = r.statevector
+    assert np.allclose(statevector.ravel(), [0.6, 0.8j])
+    assert np.shares_memory(statevector, doubles)
+    assert r.counts == {"0": 1}
+
+
+def test_expectation_values_and_time_taken():
+    r = Result({"expectation_values": [1.0, -0.5], "method": "sampled", "time_taken": 0.2}, 
+               circ_id="circH", registers={"c": [0]})
+    assert r.expectation_values == [1.0, -0.5]
+    assert r.time_taken == 0.2
+
+
+def test_expectation_values_raises_without_observables():
+    r = Result({"counts": {"0": 1}, "time_taken": 1.0}, circ_id="circI", registers={"c": [0]})
+    with pytest.raises(RuntimeError) as _:
+        _ = r.expectation_values
+
+
+def test_gradients():
+    r = Result({"expectation_values": [0.5], "gradients": [[-0.25, 0.0]], "method": "adjoint", 
+                "time_taken": 0.1}, circ_id="circG", registers={"c": [0]})
+    assert r.expectation_values == [0.5]
+    assert r.gradients == [[-0.25, 0.0]]
+
+
+def test_gradients_raises_without_gradient():
+    r = Result({"expectation_values": [1.0], "method": "exact", "time_taken": 0.1}, 
+               circ_id="circG", registers={"c": [0]})
+    with pytest.raises(RuntimeError) as _:
+        _ = r.gradients
+
+
 def test_counts_raises_on_unknown_format():
     # Missing both "results" and "counts"
     r = Result({"foo": "bar"}, circ_id="circE", registers={"c": [0]})